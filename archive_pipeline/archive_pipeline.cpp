@@ -0,0 +1,85 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "archive_pipeline.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "archive_generated.h"
+#include "fplbase/file_utilities.h"
+
+namespace fplbase {
+
+// See schemas/archive.fbs.
+static const size_t kArchiveHeaderSize = 8;
+static const size_t kArchiveContentsAlignment = 16;
+
+static size_t AlignArchiveOffset(size_t offset) {
+  return (offset + kArchiveContentsAlignment - 1) &
+         ~(kArchiveContentsAlignment - 1);
+}
+
+int RunArchivePipeline(const ArchivePipelineArgs& args) {
+  // Entries must be sorted by name, so the runtime can binary search them.
+  std::vector<std::string> names = args.input_files;
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+
+  // Read all files, and lay out their contents.
+  std::string contents;
+  flatbuffers::FlatBufferBuilder fbb;
+  std::vector<flatbuffers::Offset<archivedef::Entry>> entries;
+  for (const auto& name : names) {
+    std::string path = name;
+    if (!args.base_dir.empty()) {
+      path = args.base_dir;
+      if (path.back() != '/' && path.back() != '\\') {
+        path += '/';
+      }
+      path += name;
+    }
+    std::string file;
+    if (!fplbase::LoadFileRaw(path.c_str(), &file)) {
+      printf("Unable to load file: %s\n", path.c_str());
+      return 1;
+    }
+    contents.resize(AlignArchiveOffset(contents.size()), '\0');
+    entries.push_back(archivedef::CreateEntry(
+        fbb, fbb.CreateString(name), contents.size(), file.size()));
+    contents.append(file);
+  }
+  auto archive_fb = archivedef::CreateArchive(fbb, fbb.CreateVector(entries));
+  archivedef::FinishArchiveBuffer(fbb, archive_fb);
+
+  // Header, index, padding, then the contents.
+  std::string archive(kArchiveHeaderSize, '\0');
+  flatbuffers::WriteScalar(&archive[0], static_cast<uint32_t>(fbb.GetSize()));
+  archive.append(reinterpret_cast<const char*>(fbb.GetBufferPointer()),
+                 fbb.GetSize());
+  archive.resize(AlignArchiveOffset(archive.size()), '\0');
+  archive.append(contents);
+
+  if (!fplbase::SaveFile(args.output_file.c_str(), archive)) {
+    printf("Could not open %s for writing.\n", args.output_file.c_str());
+    return 1;
+  }
+
+  // Success.
+  return 0;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,34 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef FPLBASE_ARCHIVE_PIPELINE_H_
+#define FPLBASE_ARCHIVE_PIPELINE_H_
+
+#include <string>
+#include <vector>
+
+namespace fplbase {
+
+struct ArchivePipelineArgs {
+  std::vector<std::string> input_files;  /// Names of the files to pack.
+  std::string base_dir;                  /// Directory to read them from.
+  std::string output_file;               /// The output fplarchive file.
+};
+
+int RunArchivePipeline(const ArchivePipelineArgs& args);
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_ARCHIVE_PIPELINE_H_
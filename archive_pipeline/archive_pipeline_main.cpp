@@ -0,0 +1,84 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdio.h>
+
+#include "archive_pipeline.h"
+
+static bool ParseArchivePipelineArgs(int argc, char** argv,
+                                     fplbase::ArchivePipelineArgs* args) {
+  bool valid_args = true;
+
+  // Last parameter is used as the output file.
+  if (argc > 1) {
+    args->output_file = std::string(argv[argc - 1]);
+  } else {
+    valid_args = false;
+  }
+
+  // Parse switches.
+  for (int i = 1; i < argc - 1; ++i) {
+    const std::string arg = argv[i];
+
+    // -b switch
+    if (arg == "-b" || arg == "--base-dir") {
+      if (i < argc - 2) {
+        ++i;
+        args->base_dir = std::string(argv[i]);
+      } else {
+        valid_args = false;
+      }
+
+      // options must come before the input files
+    } else if (arg[0] == '-') {
+      printf("Unknown parameter: %s\n", arg.c_str());
+      valid_args = false;
+
+      // all other (non-empty) arguments are files to pack
+    } else if (arg != "") {
+      args->input_files.push_back(arg);
+    }
+
+    if (!valid_args) break;
+  }
+
+  if (args->input_files.empty()) {
+    valid_args = false;
+  }
+
+  // Print usage.
+  if (!valid_args) {
+    printf(
+        "Usage: archive_pipeline [-b BASE_DIR] FILE... OUTPUT_FILE\n"
+        "\n"
+        "Pipeline to pack files into a single fplarchive file, to be loaded\n"
+        "with fplbase::FileArchive. Each FILE is stored under its name as\n"
+        "given, which is the name it is later loaded with.\n"
+        "\n"
+        "Options:\n"
+        "  -b, --base-dir BASE_DIR  Read each FILE from BASE_DIR/FILE.\n");
+  }
+
+  return valid_args;
+}
+
+int main(int argc, char** argv) {
+  // Parse the command line arguments.
+  fplbase::ArchivePipelineArgs args;
+  if (!ParseArchivePipelineArgs(argc, argv, &args)) {
+    return 1;
+  }
+  return fplbase::RunArchivePipeline(args);
+}
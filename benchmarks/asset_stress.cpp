@@ -0,0 +1,344 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A synthetic workload for AssetManager and AsyncLoader at scale: queues tens
+// of thousands of small fake textures, meshes and file assets, served from
+// memory, and reports
+//   - the cost of queueing, finding and aborting assets,
+//   - load throughput, and how long each kind of asset waited to be
+//     finalized (TryFinalize() fairness),
+//   - main-thread TryFinalize() time per frame,
+//   - peak and per-asset memory,
+//   - the renderer's startup phases, up to the first asset.
+// Runs on the headless backend, since finalizing makes GL resources.
+//
+// Takes:
+//   --textures=N, --meshes=N, --files=N  How many of each asset to load.
+//                                        10000 of each by default.
+//   --aborts=N       Textures to queue and then unload before they load.
+//   --threads=N      Loader threads. 0, the default, picks for the machine.
+//   --budget_ms=F    The TryFinalize() budget per frame. 4 by default.
+//   --texture_size=N The side of each texture, in pixels. 8 by default.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "benchmark_flags.h"
+#include "flatbuffers/flatbuffers.h"
+#include "fplbase/asset_manager.h"
+#include "fplbase/file_utilities.h"
+#include "fplbase/renderer.h"
+#include "mesh_generated.h"
+
+namespace {
+
+int num_textures = 10000;
+int num_meshes = 10000;
+int num_files = 10000;
+int num_aborts = 10000;
+int num_threads = 0;
+double budget_ms = 4.0;
+int texture_size = 8;
+
+// File contents, by name prefix. Every asset of a kind shares its contents,
+// so the workload itself barely adds to the memory measured.
+std::string texture_file;
+std::string mesh_file;
+std::string other_file;
+
+const char kTexturePrefix[] = "tex/";
+const char kMeshPrefix[] = "mesh/";
+
+double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Resident memory right now, in bytes.
+size_t CurrentRss() {
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (!statm) return 0;
+  unsigned long pages = 0, resident = 0;
+  const int read = fscanf(statm, "%lu %lu", &pages, &resident);
+  fclose(statm);
+  return read == 2 ? resident * static_cast<size_t>(sysconf(_SC_PAGESIZE))
+                   : 0;
+}
+
+// The most memory ever resident, in bytes.
+size_t PeakRss() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+// An uncompressed 32 bit TGA.
+std::string MakeTexture(int side) {
+  std::string tga(18, '\0');
+  tga[2] = 2;  // Uncompressed true color.
+  tga[12] = static_cast<char>(side & 0xff);
+  tga[13] = static_cast<char>(side >> 8);
+  tga[14] = static_cast<char>(side & 0xff);
+  tga[15] = static_cast<char>(side >> 8);
+  tga[16] = 32;
+  tga[17] = 8;  // Alpha bits.
+  tga.append(static_cast<size_t>(side) * side * 4, '\x80');
+  return tga;
+}
+
+// A mesh of one quad, without surfaces, so it needs no material files.
+std::string MakeMesh() {
+  const fplbase::Vec3 positions[] = {
+      fplbase::Vec3(0, 0, 0), fplbase::Vec3(1, 0, 0), fplbase::Vec3(1, 1, 0),
+      fplbase::Vec3(0, 1, 0)};
+  flatbuffers::FlatBufferBuilder fbb;
+  auto surfaces =
+      fbb.CreateVector(std::vector<flatbuffers::Offset<meshdef::Surface>>());
+  auto positions_offset = fbb.CreateVectorOfStructs(positions, 4);
+  meshdef::MeshBuilder builder(fbb);
+  builder.add_surfaces(surfaces);
+  builder.add_positions(positions_offset);
+  fbb.Finish(builder.Finish());
+  return std::string(reinterpret_cast<const char *>(fbb.GetBufferPointer()),
+                     fbb.GetSize());
+}
+
+// Called from the loader threads, so only reads.
+bool LoadFakeFile(const char *filename, std::string *dest) {
+  if (strncmp(filename, kTexturePrefix, sizeof(kTexturePrefix) - 1) == 0) {
+    *dest = texture_file;
+  } else if (strncmp(filename, kMeshPrefix, sizeof(kMeshPrefix) - 1) == 0) {
+    *dest = mesh_file;
+  } else {
+    *dest = other_file;
+  }
+  return true;
+}
+
+std::string Name(const char *prefix, int i, const char *extension) {
+  char name[64];
+  snprintf(name, sizeof(name), "%s%06d.%s", prefix, i, extension);
+  return name;
+}
+
+double Percentile(std::vector<double> values, double fraction) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  const size_t i = static_cast<size_t>(fraction * (values.size() - 1));
+  return values[i];
+}
+
+// Times `count` calls of `func(i)`, and prints the cost of each.
+template <typename F>
+double TimeEach(const char *what, int count, const F &func) {
+  const double start = Now();
+  for (int i = 0; i < count; ++i) func(i);
+  const double seconds = Now() - start;
+  printf("%-28s %8d in %9.3f ms, %8.3f us each\n", what, count,
+         seconds * 1000.0, count ? seconds * 1e6 / count : 0.0);
+  return seconds;
+}
+
+void TakeIntFlag(const char *name, int *argc, char **argv, int *value) {
+  std::string text;
+  if (TakeFlag(name, argc, argv, &text)) {
+    *value = std::max(0, atoi(text.c_str()));
+  }
+}
+
+// The queue and finalize waits of one kind of asset, from its load stats.
+struct KindStats {
+  KindStats()
+      : count(0),
+        queue_time(0),
+        max_queue_time(0),
+        wait_time(0),
+        max_wait_time(0),
+        finalize_time(0) {}
+  int count;
+  double queue_time;
+  double max_queue_time;
+  double wait_time;
+  double max_wait_time;
+  double finalize_time;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  TakeIntFlag("--textures", &argc, argv, &num_textures);
+  TakeIntFlag("--meshes", &argc, argv, &num_meshes);
+  TakeIntFlag("--files", &argc, argv, &num_files);
+  TakeIntFlag("--aborts", &argc, argv, &num_aborts);
+  TakeIntFlag("--threads", &argc, argv, &num_threads);
+  TakeIntFlag("--texture_size", &argc, argv, &texture_size);
+  std::string value;
+  if (TakeFlag("--budget_ms", &argc, argv, &value)) {
+    budget_ms = atof(value.c_str());
+  }
+  if (argc > 1) {
+    fprintf(stderr, "Unknown argument: %s\n", argv[1]);
+    return 1;
+  }
+
+  fplbase::Renderer renderer;
+  if (!renderer.Initialize(mathfu::vec2i(64, 64), "fplbase_asset_stress")) {
+    fprintf(stderr, "Renderer initialization failed: %s\n",
+            renderer.last_error().c_str());
+    return 1;
+  }
+  texture_file = MakeTexture(std::max(1, texture_size));
+  mesh_file = MakeMesh();
+  other_file.assign(256, 'x');
+  fplbase::SetLoadFileFunction(LoadFakeFile);
+
+  const int total = num_textures + num_meshes + num_files;
+  printf("%d textures (%dx%d), %d meshes, %d files\n", num_textures,
+         texture_size, texture_size, num_meshes, num_files);
+
+  {
+    fplbase::AssetManager assets(renderer);
+    assets.SetNumLoaderThreads(num_threads);
+    std::vector<std::string> texture_names, mesh_names, file_names;
+    for (int i = 0; i < num_textures; ++i) {
+      texture_names.push_back(Name(kTexturePrefix, i, "tga"));
+    }
+    for (int i = 0; i < num_meshes; ++i) {
+      mesh_names.push_back(Name(kMeshPrefix, i, "fplmesh"));
+    }
+    for (int i = 0; i < num_files; ++i) {
+      file_names.push_back(Name("file/", i, "bin"));
+    }
+    const size_t base_rss = CurrentRss();
+
+    // Queueing, and finding what's queued.
+    TimeEach("LoadTexture (queue)", num_textures, [&](int i) {
+      assets.LoadTexture(texture_names[i].c_str(), fplbase::kFormat8888,
+                         fplbase::kTextureFlagsLoadAsync);
+    });
+    TimeEach("LoadMesh (queue)", num_meshes, [&](int i) {
+      assets.LoadMesh(mesh_names[i].c_str(), true);
+    });
+    TimeEach("LoadFileAsset (sync)", num_files, [&](int i) {
+      assets.LoadFileAsset(file_names[i].c_str());
+    });
+    TimeEach("FindTexture (name)", num_textures, [&](int i) {
+      assets.FindTexture(texture_names[i].c_str());
+    });
+    std::vector<fplbase::AssetId> texture_ids(texture_names.begin(),
+                                              texture_names.end());
+    TimeEach("FindTexture (AssetId)", num_textures, [&](int i) {
+      assets.FindTexture(texture_ids[i]);
+    });
+    TimeEach("FindMesh (name)", num_meshes, [&](int i) {
+      assets.FindMesh(mesh_names[i].c_str());
+    });
+
+    // Loading, finalizing a budget's worth each frame.
+    std::vector<double> frame_ms;
+    int pending = 0;
+    const double load_start = Now();
+    assets.StartLoadingTextures();
+    for (;;) {
+      const double frame_start = Now();
+      const bool done = assets.TryFinalize(budget_ms, &pending);
+      frame_ms.push_back((Now() - frame_start) * 1000.0);
+      if (done) break;
+      // Leave the loader threads the rest of a 60Hz frame, as a game
+      // would while rendering.
+      const double left = 1.0 / 60.0 - (Now() - frame_start);
+      if (left > 0) usleep(static_cast<useconds_t>(left * 1e6));
+    }
+    const double load_seconds = Now() - load_start;
+    const int async_assets = num_textures + num_meshes;
+    printf("Loaded %d async assets in %.3f s, %.0f assets/s, %zu frames\n",
+           async_assets, load_seconds,
+           load_seconds > 0 ? async_assets / load_seconds : 0.0,
+           frame_ms.size());
+    const double mean_ms =
+        frame_ms.empty()
+            ? 0.0
+            : std::accumulate(frame_ms.begin(), frame_ms.end(), 0.0) /
+                  frame_ms.size();
+    printf("TryFinalize per frame: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, "
+           "max %.3f ms (budget %.1f ms)\n",
+           mean_ms, Percentile(frame_ms, 0.5), Percentile(frame_ms, 0.99),
+           Percentile(frame_ms, 1.0), budget_ms);
+
+    std::map<std::string, KindStats> kinds;
+    assets.ForEachLoadStats([&kinds](const char *type, const std::string &,
+                                     const fplbase::AssetLoadStats &stats) {
+      KindStats &kind = kinds[type];
+      ++kind.count;
+      kind.queue_time += stats.queue_time;
+      kind.max_queue_time = std::max(kind.max_queue_time, stats.queue_time);
+      kind.wait_time += stats.wait_time;
+      kind.max_wait_time = std::max(kind.max_wait_time, stats.wait_time);
+      kind.finalize_time += stats.finalize_time;
+    });
+    for (auto it = kinds.begin(); it != kinds.end(); ++it) {
+      const KindStats &kind = it->second;
+      if (!kind.count) continue;
+      printf("%-8s %6d: queued mean %8.3f ms max %8.3f ms, waited to "
+             "finalize mean %8.3f ms max %8.3f ms, finalize %.3f us each\n",
+             it->first.c_str(), kind.count,
+             kind.queue_time * 1000.0 / kind.count,
+             kind.max_queue_time * 1000.0,
+             kind.wait_time * 1000.0 / kind.count,
+             kind.max_wait_time * 1000.0,
+             kind.finalize_time * 1e6 / kind.count);
+    }
+
+    std::string startup;
+    renderer.DumpStartupTimes(&startup);
+    printf("Startup:\n%s", startup.c_str());
+
+    const size_t loaded_rss = CurrentRss();
+    const size_t grown = loaded_rss - std::min(base_rss, loaded_rss);
+    printf("Memory: %.1f MB more resident, %.0f bytes per asset; "
+           "textures %zu bytes, meshes %zu bytes of GPU memory\n",
+           grown / 1e6, total ? static_cast<double>(grown) / total : 0.0,
+           assets.texture_memory_used(), assets.mesh_memory_used());
+
+    // Aborting: queue while the loader is stopped, so every job is still
+    // waiting, then unload in reverse order.
+    assets.StopLoadingTextures();
+    std::vector<std::string> abort_names;
+    for (int i = 0; i < num_aborts; ++i) {
+      abort_names.push_back(Name("tex/abort_", i, "tga"));
+      assets.LoadTexture(abort_names.back().c_str(), fplbase::kFormat8888,
+                         fplbase::kTextureFlagsLoadAsync);
+    }
+    TimeEach("UnloadTexture (abort)", num_aborts, [&](int i) {
+      assets.UnloadTexture(abort_names[num_aborts - 1 - i].c_str());
+    });
+
+    TimeEach("ClearAllAssets", 1, [&](int) { assets.ClearAllAssets(); });
+  }
+  printf("Peak resident memory: %.1f MB\n", PeakRss() / 1e6);
+
+  fplbase::SetLoadFileFunction(nullptr);
+  renderer.ShutDown();
+  return 0;
+}
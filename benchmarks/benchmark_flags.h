@@ -0,0 +1,40 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_BENCHMARK_FLAGS_H
+#define FPLBASE_BENCHMARK_FLAGS_H
+
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+// Command line flags shared by the benchmark executables, which take their
+// own flags out of argv before handing the rest to e.g. Google Benchmark.
+
+// Takes `--name=value` out of argv, if present.
+inline bool TakeFlag(const char *name, int *argc, char **argv,
+                     std::string *value) {
+  const size_t length = strlen(name);
+  for (int i = 1; i < *argc; ++i) {
+    if (strncmp(argv[i], name, length) == 0 && argv[i][length] == '=') {
+      *value = argv[i] + length + 1;
+      std::copy(argv + i + 1, argv + *argc, argv + i);
+      --*argc;
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif  // FPLBASE_BENCHMARK_FLAGS_H
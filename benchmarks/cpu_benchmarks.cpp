@@ -0,0 +1,346 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks of the CPU-side hot paths: mesh parsing and processing,
+// pixel conversion, image decoding and shader preprocessing.
+//
+// Besides the usual Google Benchmark flags, takes:
+//   --min_size=N, --max_size=N  The range of element counts (vertices, pixels,
+//                               shader lines) to measure at. Sizes step by 4x.
+//   --png=FILE, --webp=FILE     The images to decode. The sample assets by
+//                               default.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "benchmark_flags.h"
+#include "flatbuffers/flatbuffers.h"
+#include "fplbase/allocator.h"
+#include "fplbase/file_utilities.h"
+#include "fplbase/internal/pixel_conversion.h"
+#include "fplbase/mesh.h"
+#include "fplbase/preprocessor.h"
+#include "fplbase/texture.h"
+#include "mathfu/glsl_mappings.h"
+#include "mesh_generated.h"
+
+using fplbase::Mesh;
+using mathfu::AffineTransform;
+
+namespace {
+
+int64_t min_size = 1 << 8;
+int64_t max_size = 1 << 18;
+std::string png_file =
+    FPLBASE_BENCHMARK_SAMPLES_DIR "/mesh/rawassets/bird_d.png";
+std::string webp_file =
+    FPLBASE_BENCHMARK_SAMPLES_DIR "/mesh/assets/meshes/bird_d.webp";
+
+// Vertex layout for Mesh::ComputeNormalsTangents().
+struct NormalMappedVertex {
+  mathfu::vec3_packed pos;
+  mathfu::vec2_packed tc;
+  mathfu::vec3_packed norm;
+  mathfu::vec4_packed tangent;
+};
+
+// A square grid of about `count` vertices, and the indices of its triangles.
+void MakeGrid(int64_t count, std::vector<NormalMappedVertex> *vertices,
+              std::vector<uint32_t> *indices) {
+  const int side =
+      std::max(2, static_cast<int>(sqrt(static_cast<double>(count))));
+  vertices->resize(side * side);
+  for (int y = 0; y < side; ++y) {
+    for (int x = 0; x < side; ++x) {
+      NormalMappedVertex &v = (*vertices)[y * side + x];
+      const float u = static_cast<float>(x) / (side - 1);
+      const float w = static_cast<float>(y) / (side - 1);
+      mathfu::vec3(u, w, 0.1f * sinf(10.0f * u) * cosf(10.0f * w)).Pack(&v.pos);
+      mathfu::vec2(u, w).Pack(&v.tc);
+    }
+  }
+  indices->clear();
+  for (int y = 0; y + 1 < side; ++y) {
+    for (int x = 0; x + 1 < side; ++x) {
+      const uint32_t i = y * side + x;
+      const uint32_t quad[6] = {i, i + 1, i + side, i + 1, i + side + 1,
+                                i + side};
+      indices->insert(indices->end(), quad, quad + 6);
+    }
+  }
+}
+
+void BM_ParseInterleavedVertexData(benchmark::State &state) {
+  // A non-interleaved MeshDef, which is the case that has to interleave.
+  std::vector<NormalMappedVertex> grid;
+  std::vector<uint32_t> indices;
+  MakeGrid(state.range(0), &grid, &indices);
+  std::vector<fplbase::Vec3> positions, normals;
+  std::vector<fplbase::Vec4> tangents;
+  std::vector<fplbase::Vec2> texcoords;
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    positions.push_back(fplbase::Vec3(it->pos.data[0], it->pos.data[1],
+                                      it->pos.data[2]));
+    normals.push_back(fplbase::Vec3(0, 0, 1));
+    tangents.push_back(fplbase::Vec4(1, 0, 0, 1));
+    texcoords.push_back(fplbase::Vec2(it->tc.data[0], it->tc.data[1]));
+  }
+  flatbuffers::FlatBufferBuilder fbb;
+  auto material = fbb.CreateString("material");
+  auto indices32 = fbb.CreateVector(indices);
+  meshdef::SurfaceBuilder surface_builder(fbb);
+  surface_builder.add_indices32(indices32);
+  surface_builder.add_material(material);
+  auto surface = surface_builder.Finish();
+  auto surfaces = fbb.CreateVector(&surface, 1);
+  auto positions_offset = fbb.CreateVectorOfStructs(positions);
+  auto normals_offset = fbb.CreateVectorOfStructs(normals);
+  auto tangents_offset = fbb.CreateVectorOfStructs(tangents);
+  auto texcoords_offset = fbb.CreateVectorOfStructs(texcoords);
+  meshdef::MeshBuilder builder(fbb);
+  builder.add_surfaces(surfaces);
+  builder.add_positions(positions_offset);
+  builder.add_normals(normals_offset);
+  builder.add_tangents(tangents_offset);
+  builder.add_texcoords(texcoords_offset);
+  fbb.Finish(builder.Finish());
+  const void *meshdef_buffer = fbb.GetBufferPointer();
+
+  for (auto _ : state) {
+    Mesh::InterleavedVertexData ivd;
+    Mesh::ParseInterleavedVertexData(meshdef_buffer, &ivd);
+    benchmark::DoNotOptimize(ivd.vertex_data);
+  }
+  state.SetItemsProcessed(state.iterations() * grid.size());
+}
+
+void BM_ComputeNormalsTangents(benchmark::State &state) {
+  std::vector<NormalMappedVertex> vertices;
+  std::vector<uint32_t> indices;
+  MakeGrid(state.range(0), &vertices, &indices);
+  for (auto _ : state) {
+    Mesh::ComputeNormalsTangents(vertices.data(), indices.data(),
+                                 static_cast<int>(vertices.size()),
+                                 static_cast<int>(indices.size()));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * vertices.size());
+}
+
+void BM_GatherShaderTransforms(benchmark::State &state) {
+  // Bone indices are bytes, so meshes have at most 255 bones.
+  const size_t num_bones =
+      static_cast<size_t>(std::min<int64_t>(state.range(0), 255));
+  std::vector<AffineTransform> defaults(num_bones);
+  std::vector<uint8_t> parents(num_bones);
+  std::vector<uint8_t> shader_bones(num_bones);
+  for (size_t i = 0; i < num_bones; ++i) {
+    defaults[i] = mathfu::mat4::ToAffineTransform(
+        mathfu::mat4::FromTranslationVector(
+            mathfu::vec3(static_cast<float>(i), 1.0f, 2.0f)));
+    parents[i] = static_cast<uint8_t>(i == 0 ? 0xFF : (i - 1) / 2);
+    shader_bones[i] = static_cast<uint8_t>(i);
+  }
+  Mesh mesh;
+  mesh.SetBones(defaults.data(), parents.data(), nullptr, num_bones,
+                shader_bones.data(), num_bones);
+  std::vector<AffineTransform> shader_transforms(num_bones);
+  for (auto _ : state) {
+    mesh.GatherShaderTransforms(defaults.data(), shader_transforms.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * num_bones);
+}
+
+void BM_Convert8888To5551(benchmark::State &state) {
+  const size_t num_pixels = static_cast<size_t>(state.range(0));
+  std::vector<uint8_t> src(num_pixels * 4);
+  for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<uint8_t>(i * 7);
+  std::vector<uint16_t> dest(num_pixels);
+  for (auto _ : state) {
+    fplbase::Convert8888To5551(src.data(), dest.data(), num_pixels);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * src.size());
+}
+
+void BM_Convert888To565(benchmark::State &state) {
+  const size_t num_pixels = static_cast<size_t>(state.range(0));
+  std::vector<uint8_t> src(num_pixels * 3);
+  for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<uint8_t>(i * 7);
+  std::vector<uint16_t> dest(num_pixels);
+  for (auto _ : state) {
+    fplbase::Convert888To565(src.data(), dest.data(), num_pixels);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * src.size());
+}
+
+void BM_UnpackImage(benchmark::State &state, bool webp) {
+  const std::string &filename = webp ? webp_file : png_file;
+  std::string file;
+  if (!fplbase::LoadFile(filename.c_str(), &file)) {
+    state.SkipWithError(("can't load " + filename).c_str());
+    return;
+  }
+  int64_t pixels = 0;
+  for (auto _ : state) {
+    mathfu::vec2i size;
+    fplbase::TextureFormat format;
+    uint8_t *image =
+        webp ? fplbase::Texture::UnpackWebP(file.data(), file.size(),
+                                            mathfu::kOnes2f,
+                                            fplbase::kTextureFlagsNone,
+                                            &size, &format)
+             : fplbase::Texture::UnpackPng(file.data(), file.size(),
+                                           mathfu::kOnes2f,
+                                           fplbase::kTextureFlagsNone,
+                                           &size, &format);
+    if (!image) {
+      state.SkipWithError(("can't decode " + filename).c_str());
+      return;
+    }
+    pixels += size.x * size.y;
+    fplbase::FreeMemory(image, fplbase::kAllocationTextureStaging);
+  }
+  state.SetItemsProcessed(pixels);
+  state.SetBytesProcessed(state.iterations() * file.size());
+}
+
+// In-memory files for the shader benchmarks.
+std::map<std::string, std::string> shader_files;
+
+bool LoadShaderFile(const char *filename, std::string *dest) {
+  auto it = shader_files.find(filename);
+  if (it == shader_files.end()) return false;
+  *dest = it->second;
+  return true;
+}
+
+// A shader of about `lines` lines, a quarter of them in 8 #included files.
+std::string MakeShader(int64_t lines) {
+  static const int kNumIncludes = 8;
+  const int64_t included_lines = lines / 4;
+  std::string shader = "#version 100\n";
+  std::string body = "void main() {\n";
+  for (int64_t i = 0; i < lines; ++i) {
+    const std::string line = "  color += texture2D(texture_unit_0, uv * " +
+                             std::to_string(i) + ".0);\n";
+    if (i < included_lines) {
+      const int include = static_cast<int>(i * kNumIncludes / included_lines);
+      const std::string name = "include" + std::to_string(include) + ".glslh";
+      if (shader_files[name].empty()) {
+        shader += "#include \"" + name + "\"\n";
+      }
+      shader_files[name] += line;
+    } else {
+      body += line;
+    }
+  }
+  return shader + body + "}\n";
+}
+
+void BM_LoadFileWithDirectives(benchmark::State &state, bool cold) {
+  shader_files.clear();
+  shader_files["shader.glslf"] = MakeShader(state.range(0));
+  const fplbase::LoadFileFunction previous =
+      fplbase::SetLoadFileFunction(LoadShaderFile);
+  static const char *const kDefines[] = {"SHADOWS", "FOG", nullptr};
+  std::string result, error;
+  for (auto _ : state) {
+    if (cold) fplbase::ClearShaderIncludeCache();
+    if (!fplbase::LoadFileWithDirectives("shader.glslf", &result, kDefines,
+                                         &error)) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * result.size());
+  fplbase::SetLoadFileFunction(previous);
+}
+
+void BM_PlatformSanitizeShaderSource(benchmark::State &state,
+                                     fplbase::ShaderProfile profile) {
+  shader_files.clear();
+  const std::string source = MakeShader(state.range(0));
+  static const char *const kDefines[] = {"SHADOWS", "FOG", nullptr};
+  std::string result;
+  for (auto _ : state) {
+    fplbase::PlatformSanitizeShaderSource(source.c_str(), kDefines, profile,
+                                          &result);
+  }
+  state.SetBytesProcessed(state.iterations() * source.size());
+}
+
+// Measures `b` at each size from --min_size to --max_size.
+void Sized(benchmark::internal::Benchmark *b) {
+  b->RangeMultiplier(4)->Range(min_size, max_size);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string value;
+  if (TakeFlag("--min_size", &argc, argv, &value)) {
+    min_size = std::max<int64_t>(1, atoll(value.c_str()));
+  }
+  if (TakeFlag("--max_size", &argc, argv, &value)) {
+    max_size = std::max<int64_t>(min_size, atoll(value.c_str()));
+  }
+  TakeFlag("--png", &argc, argv, &png_file);
+  TakeFlag("--webp", &argc, argv, &webp_file);
+
+  benchmark::RegisterBenchmark("ParseInterleavedVertexData",
+                               BM_ParseInterleavedVertexData)
+      ->Apply(Sized);
+  benchmark::RegisterBenchmark("ComputeNormalsTangents",
+                               BM_ComputeNormalsTangents)
+      ->Apply(Sized);
+  benchmark::RegisterBenchmark("GatherShaderTransforms",
+                               BM_GatherShaderTransforms)
+      ->RangeMultiplier(4)
+      ->Range(std::min<int64_t>(min_size, 255),
+              std::min<int64_t>(max_size, 255));
+  benchmark::RegisterBenchmark("Convert8888To5551", BM_Convert8888To5551)
+      ->Apply(Sized);
+  benchmark::RegisterBenchmark("Convert888To565", BM_Convert888To565)
+      ->Apply(Sized);
+  benchmark::RegisterBenchmark("UnpackImage/png", BM_UnpackImage, false);
+  benchmark::RegisterBenchmark("UnpackWebP", BM_UnpackImage, true);
+  benchmark::RegisterBenchmark("LoadFileWithDirectives/cold",
+                               BM_LoadFileWithDirectives, true)
+      ->Apply(Sized);
+  benchmark::RegisterBenchmark("LoadFileWithDirectives/cached",
+                               BM_LoadFileWithDirectives, false)
+      ->Apply(Sized);
+  benchmark::RegisterBenchmark("PlatformSanitizeShaderSource/core",
+                               BM_PlatformSanitizeShaderSource,
+                               fplbase::kShaderProfileCore)
+      ->Apply(Sized);
+  benchmark::RegisterBenchmark("PlatformSanitizeShaderSource/es",
+                               BM_PlatformSanitizeShaderSource,
+                               fplbase::kShaderProfileEs)
+      ->Apply(Sized);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,304 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks of the renderer's draw paths, on the headless backend: draws per
+// second for Render(), RenderSubMesh(), instanced Render() and RenderArray(),
+// the cost of render state changes between draws, and texture upload
+// bandwidth.
+//
+// Each iteration submits a batch and then waits for the GPU with glFinish(),
+// so times include both driver overhead and GPU work. On drivers without a
+// display, run with EGL_PLATFORM=surfaceless, or let the backend fall back to
+// it.
+//
+// Besides the usual Google Benchmark flags, takes:
+//   --width=N, --height=N  The size of the offscreen surface. 256x256 by
+//                          default, so fill rate doesn't dominate.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "benchmark_flags.h"
+#include "fplbase/glplatform.h"
+#include "fplbase/instance_buffer.h"
+#include "fplbase/mesh.h"
+#include "fplbase/render_utils.h"
+#include "fplbase/renderer.h"
+#include "fplbase/texture.h"
+#include "mathfu/glsl_mappings.h"
+
+using fplbase::Attribute;
+using fplbase::Mesh;
+using fplbase::Renderer;
+
+namespace {
+
+mathfu::vec2i surface_size(256, 256);
+Renderer *renderer = nullptr;
+fplbase::Shader *shader = nullptr;
+fplbase::Shader *instanced_shader = nullptr;
+
+const char kVertexShader[] =
+    "attribute vec4 aPosition;\n"
+    "uniform mat4 model_view_projection;\n"
+    "void main() { gl_Position = model_view_projection * aPosition; }\n";
+
+const char kInstancedVertexShader[] =
+    "attribute vec4 aPosition;\n"
+    "attribute vec4 aInstanceTransform0;\n"
+    "attribute vec4 aInstanceTransform1;\n"
+    "attribute vec4 aInstanceTransform2;\n"
+    "uniform mat4 model_view_projection;\n"
+    "void main() {\n"
+    "  vec4 p = vec4(dot(aInstanceTransform0, aPosition),\n"
+    "                dot(aInstanceTransform1, aPosition),\n"
+    "                dot(aInstanceTransform2, aPosition), 1.0);\n"
+    "  gl_Position = model_view_projection * p;\n"
+    "}\n";
+
+const char kFragmentShader[] =
+    "void main() { gl_FragColor = vec4(0.0, 1.0, 0.0, 0.5); }\n";
+
+const Attribute kFormat[] = {fplbase::kPosition3f, fplbase::kEND};
+const Attribute kInstanceFormat[] = {fplbase::kInstanceTransform3x4f,
+                                     fplbase::kEND};
+
+// The number of submeshes in the RenderSubMesh() mesh.
+const int kSubMeshes = 8;
+
+// A small quad, so the benchmarks measure the cost of a draw rather than of
+// filling pixels. Meshes made from it have no materials, so are drawn with
+// ignore_material.
+const float kQuad[] = {-0.01f, -0.01f, 0.0f, 0.01f, -0.01f, 0.0f,
+                       0.01f,  0.01f,  0.0f, -0.01f, 0.01f, 0.0f};
+const uint16_t kQuadIndices[] = {0, 1, 2, 0, 2, 3};
+
+// Starts each benchmark from the same render state.
+void ResetState() {
+  renderer->SetBlendMode(fplbase::kBlendModeOff);
+  renderer->SetDepthFunction(fplbase::kDepthFunctionDisabled);
+  renderer->SetCulling(fplbase::kCullingModeNone);
+  renderer->set_model_view_projection(mathfu::mat4::Identity());
+  renderer->SetShader(shader);
+}
+
+// Reports the renderer's own counts of the work done since `start`.
+void ReportCounters(benchmark::State &state,
+                    const fplbase::RenderCounters &start) {
+  const fplbase::RenderCounters &end = renderer->current_render_counters();
+  const double iterations = static_cast<double>(state.iterations());
+  state.counters["draws"] = (end.draw_calls - start.draw_calls) / iterations;
+  state.counters["state_changes"] =
+      (end.state_changes - start.state_changes) / iterations;
+}
+
+// Draws one mesh `state.range(0)` times per iteration.
+void BM_Render(benchmark::State &state) {
+  Mesh mesh(kQuad, 4, 3 * sizeof(float), kFormat);
+  mesh.AddIndices(kQuadIndices, 6, nullptr);
+  const int draws = static_cast<int>(state.range(0));
+  ResetState();
+  const fplbase::RenderCounters start = renderer->current_render_counters();
+  for (auto _ : state) {
+    for (int i = 0; i < draws; ++i) renderer->Render(&mesh, true);
+    glFinish();
+  }
+  ReportCounters(state, start);
+  state.SetItemsProcessed(state.iterations() * draws);
+}
+
+// As BM_Render, but draws each submesh of a mesh in turn.
+void BM_RenderSubMesh(benchmark::State &state) {
+  Mesh mesh(kQuad, 4, 3 * sizeof(float), kFormat);
+  for (int i = 0; i < kSubMeshes; ++i) {
+    mesh.AddIndices(kQuadIndices, 6, nullptr);
+  }
+  const int draws = static_cast<int>(state.range(0));
+  ResetState();
+  const fplbase::RenderCounters start = renderer->current_render_counters();
+  for (auto _ : state) {
+    for (int i = 0; i < draws; ++i) {
+      renderer->RenderSubMesh(&mesh, i % kSubMeshes, true);
+    }
+    glFinish();
+  }
+  ReportCounters(state, start);
+  state.SetItemsProcessed(state.iterations() * draws);
+}
+
+// Fills, uploads and draws `state.range(0)` instances each iteration, as a
+// game would each frame.
+void BM_RenderInstanced(benchmark::State &state) {
+  if (renderer->feature_level() < fplbase::kFeatureLevel30) {
+    state.SkipWithError("instancing needs feature level 3.0");
+    return;
+  }
+  Mesh mesh(kQuad, 4, 3 * sizeof(float), kFormat);
+  mesh.AddIndices(kQuadIndices, 6, nullptr);
+  fplbase::InstanceBuffer instances(kInstanceFormat);
+  const size_t count = static_cast<size_t>(state.range(0));
+  ResetState();
+  renderer->SetShader(instanced_shader);
+  const fplbase::RenderCounters start = renderer->current_render_counters();
+  for (auto _ : state) {
+    instances.Clear();
+    float *transforms = static_cast<float *>(instances.Add(count));
+    for (size_t i = 0; i < count; ++i) {
+      float *t = transforms + 12 * i;
+      const float x = static_cast<float>(i % 64) / 32.0f - 1.0f;
+      const float y = static_cast<float>(i / 64 % 64) / 32.0f - 1.0f;
+      const float row[12] = {1, 0, 0, x, 0, 1, 0, y, 0, 0, 1, 0};
+      memcpy(t, row, sizeof(row));
+    }
+    instances.Upload();
+    renderer->Render(&mesh, instances, true);
+    glFinish();
+  }
+  ReportCounters(state, start);
+  state.SetItemsProcessed(state.iterations() * count);
+  state.SetBytesProcessed(state.iterations() * count *
+                          instances.instance_size());
+}
+
+// Streams `state.range(0)` vertices from client memory with RenderArray().
+void BM_RenderArray(benchmark::State &state) {
+  const int quads = std::max(1, static_cast<int>(state.range(0)) / 6);
+  std::vector<float> vertices;
+  vertices.reserve(quads * 6 * 3);
+  for (int q = 0; q < quads; ++q) {
+    for (int i = 0; i < 6; ++i) {
+      const float *v = kQuad + 3 * kQuadIndices[i];
+      vertices.insert(vertices.end(), v, v + 3);
+    }
+  }
+  const int vertex_count = quads * 6;
+  ResetState();
+  const fplbase::RenderCounters start = renderer->current_render_counters();
+  for (auto _ : state) {
+    fplbase::RenderArray(Mesh::kTriangles, vertex_count, kFormat,
+                         3 * sizeof(float), vertices.data());
+    glFinish();
+  }
+  ReportCounters(state, start);
+  state.SetItemsProcessed(state.iterations() * vertex_count);
+  state.SetBytesProcessed(state.iterations() * vertices.size() *
+                          sizeof(float));
+}
+
+// As BM_Render, but changes blend, depth and cull state before each draw.
+// The difference from BM_Render is the cost of the state changes.
+void BM_StateChanges(benchmark::State &state) {
+  Mesh mesh(kQuad, 4, 3 * sizeof(float), kFormat);
+  mesh.AddIndices(kQuadIndices, 6, nullptr);
+  const int draws = static_cast<int>(state.range(0));
+  ResetState();
+  const fplbase::RenderCounters start = renderer->current_render_counters();
+  for (auto _ : state) {
+    for (int i = 0; i < draws; ++i) {
+      const bool odd = (i & 1) != 0;
+      renderer->SetBlendMode(odd ? fplbase::kBlendModeAlpha
+                                 : fplbase::kBlendModeOff);
+      renderer->SetDepthFunction(odd ? fplbase::kDepthFunctionLess
+                                     : fplbase::kDepthFunctionDisabled);
+      renderer->SetCulling(odd ? fplbase::kCullingModeBack
+                               : fplbase::kCullingModeNone);
+      renderer->Render(&mesh, true);
+    }
+    glFinish();
+  }
+  ReportCounters(state, start);
+  state.SetItemsProcessed(state.iterations() * draws);
+}
+
+// Replaces the whole of a `state.range(0)` square RGBA texture each
+// iteration, through Texture::UpdateTexture().
+void BM_TextureUpload(benchmark::State &state) {
+  const int side = static_cast<int>(state.range(0));
+  const mathfu::vec2i size(side, side);
+  std::vector<uint8_t> pixels(side * side * 4, 0x80);
+  fplbase::Texture texture(nullptr, fplbase::kFormat8888,
+                           fplbase::kTextureFlagsNone);
+  texture.LoadFromMemory(pixels.data(), size, fplbase::kFormat8888);
+  for (auto _ : state) {
+    texture.UpdateTexture(0, fplbase::kFormat8888, 0, 0, side, side,
+                          pixels.data());
+    glFinish();
+  }
+  state.SetBytesProcessed(state.iterations() * pixels.size());
+}
+
+// Draw batch sizes: from a single draw, dominated by glFinish(), to enough
+// draws to measure throughput.
+void Batched(benchmark::internal::Benchmark *b) {
+  b->RangeMultiplier(8)->Range(1, 4096)->Unit(benchmark::kMicrosecond);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string value;
+  if (TakeFlag("--width", &argc, argv, &value)) {
+    surface_size.x = std::max(1, atoi(value.c_str()));
+  }
+  if (TakeFlag("--height", &argc, argv, &value)) {
+    surface_size.y = std::max(1, atoi(value.c_str()));
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+  Renderer the_renderer;
+  if (!the_renderer.Initialize(surface_size, "fplbase_renderer_benchmarks")) {
+    fprintf(stderr, "Renderer initialization failed: %s\n",
+            the_renderer.last_error().c_str());
+    return 1;
+  }
+  renderer = &the_renderer;
+  shader = renderer->CompileAndLinkShader(kVertexShader, kFragmentShader);
+  instanced_shader =
+      renderer->CompileAndLinkShader(kInstancedVertexShader, kFragmentShader);
+  if (!shader || !instanced_shader) {
+    fprintf(stderr, "Shader compilation failed: %s\n",
+            renderer->last_error().c_str());
+    return 1;
+  }
+  fprintf(stderr, "GL_RENDERER: %s\nGL_VERSION: %s\n",
+          glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+  benchmark::RegisterBenchmark("Render", BM_Render)->Apply(Batched);
+  benchmark::RegisterBenchmark("RenderSubMesh", BM_RenderSubMesh)
+      ->Apply(Batched);
+  benchmark::RegisterBenchmark("RenderInstanced", BM_RenderInstanced)
+      ->Apply(Batched);
+  benchmark::RegisterBenchmark("RenderArray", BM_RenderArray)
+      ->RangeMultiplier(8)
+      ->Range(6, 6 << 12)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("StateChanges", BM_StateChanges)
+      ->Apply(Batched);
+  benchmark::RegisterBenchmark("TextureUpload", BM_TextureUpload)
+      ->RangeMultiplier(4)
+      ->Range(64, 2048)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RunSpecifiedBenchmarks();
+
+  delete instanced_shader;
+  delete shader;
+  renderer->ShutDown();
+  return 0;
+}
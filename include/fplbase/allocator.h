@@ -0,0 +1,116 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef FPLBASE_ALLOCATOR_H
+#define FPLBASE_ALLOCATOR_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <functional>
+
+namespace fplbase {
+
+/// @brief What a buffer allocated by the library is used for, passed to the
+/// functions set by `SetAllocator()` so they can route e.g. each kind to its
+/// own pool or budget.
+enum AllocationCategory {
+  /// Decoded or converted pixels waiting to be uploaded, including the buffers
+  /// returned by `Texture::Unpack*()`.
+  kAllocationTextureStaging,
+  /// Vertex and bone data loaded from a mesh file.
+  kAllocationMeshStaging,
+  /// Short-lived buffers freed before the call that made them returns, such as
+  /// decoder and resampler scratch memory.
+  kAllocationTransient,
+  kAllocationCategoryCount
+};
+
+/// @brief Called by `AllocateMemory()`. Must return memory aligned like
+/// `malloc()` does, or `nullptr` on failure. Called from any thread.
+typedef std::function<void *(size_t size, AllocationCategory category)>
+    AllocateFunction;
+
+/// @brief Called by `FreeMemory()`, with the category the memory was allocated
+/// under. Never called with `nullptr`. Called from any thread.
+typedef std::function<void(void *ptr, AllocationCategory category)>
+    FreeFunction;
+
+/// @brief Set the functions used for the buffers the library allocates.
+/// @details Buffers must be freed by the function matching the one that
+/// allocated them, so call this before loading anything, e.g. at the start of
+/// `main()`, and don't change it while any are still alive.
+/// @param[in] allocate_function The function used by `AllocateMemory()`.
+/// @param[in] free_function The function used by `FreeMemory()`.
+/// @note If either function is nullptr, both go back to `malloc()` and
+/// `free()`, which is the default.
+void SetAllocator(AllocateFunction allocate_function,
+                  FreeFunction free_function);
+
+/// @brief Whether `SetAllocator()` replaced `malloc()` and `free()`.
+bool HasCustomAllocator();
+
+/// @brief Allocates `size` bytes with the function set by `SetAllocator()`.
+/// @return Returns `nullptr` if the memory couldn't be allocated.
+void *AllocateMemory(size_t size, AllocationCategory category);
+
+/// @brief Frees memory from `AllocateMemory()` with the same `category`.
+/// Does nothing for `nullptr`.
+void FreeMemory(void *ptr, AllocationCategory category);
+
+/// @brief Like `AllocateMemory()`, but aligned to `kAllocationAlignment`, as
+/// needed by the SIMD types of mathfu.
+/// @note Free it with `FreeAlignedMemory()`, not `FreeMemory()`.
+void *AllocateAlignedMemory(size_t size, AllocationCategory category);
+
+/// @brief Frees memory from `AllocateAlignedMemory()`.
+void FreeAlignedMemory(void *ptr, AllocationCategory category);
+
+/// @brief The alignment of `AllocateAlignedMemory()`, in bytes.
+static const size_t kAllocationAlignment = 16;
+
+/// @brief A standard allocator on top of `AllocateMemory()`, so containers
+/// can hold their elements in memory of a given category.
+template <typename T, AllocationCategory kCategory>
+class CategoryAllocator {
+ public:
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind {
+    typedef CategoryAllocator<U, kCategory> other;
+  };
+
+  CategoryAllocator() {}
+  template <typename U>
+  CategoryAllocator(const CategoryAllocator<U, kCategory> &) {}
+
+  T *allocate(size_t n) {
+    void *ptr = AllocateMemory(n * sizeof(T), kCategory);
+    assert(ptr || !n);
+    return static_cast<T *>(ptr);
+  }
+  void deallocate(T *ptr, size_t) { FreeMemory(ptr, kCategory); }
+
+  template <typename U>
+  bool operator==(const CategoryAllocator<U, kCategory> &) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const CategoryAllocator<U, kCategory> &) const {
+    return false;
+  }
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_ALLOCATOR_H
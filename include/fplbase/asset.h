@@ -20,12 +20,14 @@
 namespace fplbase {
 
 class AssetManager;
+template <typename T>
+class AssetHandle;
 
 /// @class Asset
 /// @brief Base class of all assets that _may_ be managed by Assetmanager.
 class Asset {
  public:
-  Asset() : refcount_(1) {}
+  Asset() : refcount_(1), num_handles_(0) {}
   virtual ~Asset() {}
 
   /// @brief indicate there is an additional owner of this asset.
@@ -36,15 +38,72 @@ class Asset {
   /// asset deleted by the last one.
   void IncreaseRefCount() { refcount_++; }
 
+  /// @brief Whether any AssetHandle currently refers to this asset.
+  /// The AssetManager never evicts an asset while it has handles.
+  bool HasHandles() const { return num_handles_ > 0; }
+
  private:
   // This is private, since only the AssetManager can delete assets.
   friend class AssetManager;
+  template <typename T>
+  friend class AssetHandle;
   int DecreaseRefCount() {
     assert(refcount_ > 0);
     return --refcount_;
   };
 
   int refcount_;
+  int num_handles_;
+};
+
+/// @class AssetHandle
+/// @brief A reference counted pointer to an asset.
+///
+/// While any handle to an asset is alive, the AssetManager will not evict it
+/// to stay within its memory budget (see AssetManager::SetMemoryBudget()).
+/// Hold on to a handle for assets you keep using without looking them up
+/// through the AssetManager again, e.g. the textures of the current level.
+///
+/// Handles don't own the asset: release them before unloading it with any of
+/// the AssetManager::Unload*() functions. Main thread only.
+template <typename T>
+class AssetHandle {
+ public:
+  AssetHandle() : asset_(nullptr) {}
+  explicit AssetHandle(T *asset) : asset_(asset) { Acquire(); }
+  AssetHandle(const AssetHandle &other) : asset_(other.asset_) { Acquire(); }
+  ~AssetHandle() { Release(); }
+
+  AssetHandle &operator=(const AssetHandle &other) {
+    Reset(other.asset_);
+    return *this;
+  }
+
+  /// @brief Make this handle refer to `asset` instead, which may be null.
+  void Reset(T *asset = nullptr) {
+    if (asset == asset_) return;
+    Release();
+    asset_ = asset;
+    Acquire();
+  }
+
+  /// @brief The asset this handle refers to, or nullptr.
+  T *get() const { return asset_; }
+  T *operator->() const { return asset_; }
+  T &operator*() const { return *asset_; }
+  explicit operator bool() const { return asset_ != nullptr; }
+
+ private:
+  void Acquire() {
+    if (asset_) asset_->num_handles_++;
+  }
+  void Release() {
+    if (!asset_) return;
+    assert(asset_->num_handles_ > 0);
+    asset_->num_handles_--;
+  }
+
+  T *asset_;
 };
 
 }  // namespace fplbase
@@ -0,0 +1,99 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_ASSET_ID_H
+#define FPLBASE_ASSET_ID_H
+
+#include <cstdint>
+#include <string>
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_asset_manager
+/// @{
+
+namespace internal {
+
+static const uint64_t kFnv1aOffsetBasis = 0xcbf29ce484222325ULL;
+static const uint64_t kFnv1aPrime = 0x100000001b3ULL;
+
+// 64-bit FNV-1a, written recursively so it can be evaluated at compile time.
+inline constexpr uint64_t HashAssetName(const char *name,
+                                        uint64_t hash = kFnv1aOffsetBasis) {
+  return *name ? HashAssetName(name + 1,
+                               (hash ^ static_cast<uint8_t>(*name)) *
+                                   kFnv1aPrime)
+               : hash;
+}
+
+// 0 marks an empty AssetId (and an empty slot in an AssetMap).
+inline constexpr uint64_t NonZeroHash(uint64_t hash) {
+  return hash ? hash : 1;
+}
+
+}  // namespace internal
+
+/// @class AssetId
+/// @brief Hashed name of an asset, for fast lookups in the AssetManager.
+///
+/// Compute an AssetId once from an asset's path and reuse it, rather than
+/// looking the asset up by string every frame. The hash of a string literal
+/// is computed at compile time:
+///
+///     static constexpr AssetId kHudTexture("textures/hud.webp");
+///     Texture *hud = asset_manager.FindTexture(kHudTexture);
+///
+/// An AssetId keeps a pointer to the name it was created from, so that
+/// AssetManager can load the asset if it hasn't been loaded yet. The name
+/// must outlive the AssetId.
+class AssetId {
+ public:
+  /// @brief Creates an empty AssetId, that matches no asset.
+  constexpr AssetId() : hash_(0), name_(nullptr) {}
+
+  /// @brief Creates the AssetId for the asset with the given name.
+  /// @param name The asset's file name (or alias). Must outlive the AssetId.
+  constexpr explicit AssetId(const char *name)
+      : hash_(internal::NonZeroHash(internal::HashAssetName(name))),
+        name_(name) {}
+
+  /// @brief Creates the AssetId for the asset with the given name.
+  /// @param name The asset's file name (or alias). Must outlive the AssetId.
+  explicit AssetId(const std::string &name)
+      : hash_(internal::NonZeroHash(internal::HashAssetName(name.c_str()))),
+        name_(name.c_str()) {}
+
+  /// @brief The hash of the name, never 0 unless the AssetId is empty.
+  constexpr uint64_t hash() const { return hash_; }
+
+  /// @brief The name the AssetId was created from, or nullptr if empty.
+  constexpr const char *name() const { return name_; }
+
+  /// @brief Whether this AssetId was created from a name.
+  constexpr bool valid() const { return hash_ != 0; }
+
+  bool operator==(const AssetId &rhs) const { return hash_ == rhs.hash_; }
+  bool operator!=(const AssetId &rhs) const { return hash_ != rhs.hash_; }
+  bool operator<(const AssetId &rhs) const { return hash_ < rhs.hash_; }
+
+ private:
+  uint64_t hash_;
+  const char *name_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_ASSET_ID_H
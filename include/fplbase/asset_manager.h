@@ -15,13 +15,17 @@
 #ifndef FPLBASE_ASSET_MANAGER_H
 #define FPLBASE_ASSET_MANAGER_H
 
-#include <map>
+#include <list>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "fplbase/config.h"  // Must come first.
 
+#include "fplbase/asset_id.h"
 #include "fplbase/async_loader.h"
 #include "fplbase/fpl_common.h"
+#include "fplbase/internal/asset_map.h"
 #include "fplbase/renderer.h"
 #include "fplbase/texture_atlas.h"
 
@@ -38,7 +42,36 @@ class FileAsset : public AsyncAsset {
   virtual bool Finalize();
   virtual bool IsValid();
  public:
+  FileAsset() : mapped_data_(nullptr), mapped_size_(0) {}
+  virtual ~FileAsset();
+
+  /// @brief Map the file with MapFile() instead of copying it into `contents`.
+  ///
+  /// Falls back to LoadFile() for files MapFile() can't open, such as
+  /// compressed APK entries, and while a function set with
+  /// SetLoadFileFunction() is in use.
+  ///
+  /// @param filename The file to map.
+  /// @return Returns false if the file couldn't be mapped or loaded.
+  bool LoadMapped(const char *filename);
+
+  /// @brief The file's contents, whether mapped or copied into `contents`.
+  const uint8_t *data() const {
+    return mapped_data_ ? mapped_data_
+                        : reinterpret_cast<const uint8_t *>(contents.data());
+  }
+
+  /// @brief The size of the file's contents, in bytes.
+  size_t size() const {
+    return mapped_data_ ? static_cast<size_t>(mapped_size_) : contents.size();
+  }
+
+  /// @brief The file's contents, unless they were mapped by LoadMapped().
   std::string contents;
+
+ private:
+  const uint8_t *mapped_data_;
+  int32_t mapped_size_;
 };
 
 /// @class AssetManager
@@ -71,10 +104,19 @@ class AssetManager {
   /// @return Returns the shader, or nullptr if not previously loaded.
   Shader *FindShader(const char *basename);
 
+  /// @brief Returns a previously loaded shader object.
+  ///
+  /// @param id The AssetId of the shader's name (or alias).
+  /// @return Returns the shader, or nullptr if not previously loaded.
+  Shader *FindShader(const AssetId &id);
+
   /// @brief Loads and returns a shader object.
   ///
   /// Loads a shader if it hasn't been loaded already, by appending .glslv
   /// and .glslf to the basename, compiling and linking them.
+  /// A basename ending in .fplshader instead names a file from
+  /// shader_pipeline, whose variant with the shader's defines is compiled
+  /// without preprocessing it again.
   /// If this returns nullptr, the error can be found in Renderer::last_error().
   ///
   /// @param basename The name of the shader.
@@ -83,6 +125,16 @@ class AssetManager {
   Shader *LoadShader(const char *basename, bool async = false,
                      const char *alias = nullptr);
 
+  /// @brief Loads and returns a shader object.
+  ///
+  /// Works like LoadShader (above), but finds an already loaded shader
+  /// without hashing its name again.
+  ///
+  /// @param id The AssetId of the shader's basename.
+  /// @param async A boolean to indicate whether to load asynchronously or not.
+  /// @return Returns the loaded shader, or nullptr if there was an error.
+  Shader *LoadShader(const AssetId &id, bool async = false);
+
   /// @brief Loads and returns a shader object with pre-defined identifiers.
   ///
   /// Works like LoadShader (above), but takes in a set of \#define variables.
@@ -128,6 +180,12 @@ class AssetManager {
   /// @return Returns the texture, or nullptr if not previously loaded.
   Texture *FindTexture(const char *filename);
 
+  /// @brief Returns a previously created texture.
+  ///
+  /// @param id The AssetId of the texture's file name.
+  /// @return Returns the texture, or nullptr if not previously loaded.
+  Texture *FindTexture(const AssetId &id);
+
   /// @brief Queue loading a texture if it hasn't been loaded already.
   ///
   /// If async, queues a texture for loading if it hasn't been loaded already,
@@ -136,14 +194,60 @@ class AssetManager {
   /// If async, the returned texture isn't usable until TryFinalize() succeeds
   /// and the id is non-zero.
   ///
+  /// If the texture is already waiting in the async queue with a lower
+  /// priority, it is moved up to `priority`.
+  ///
   /// @param filename The name of the texture to load.
   /// @param format The texture format, defaults to kFormatAuto.
   /// @param flags The texture flags, by default loads textures async.
+  /// @param priority Load priority when async. See AsyncLoadPriority.
   /// @return Returns an unloaded texture object. If not async, may also
   ///         return null to signal and error.
   Texture *LoadTexture(const char *filename, TextureFormat format = kFormatAuto,
                        TextureFlags flags = kTextureFlagsUseMipMaps |
-                                            kTextureFlagsLoadAsync);
+                                            kTextureFlagsLoadAsync,
+                       int priority = kLoadPriorityNormal);
+
+  /// @brief Queue loading a texture if it hasn't been loaded already.
+  ///
+  /// Works like LoadTexture (above), but finds an already loaded texture
+  /// without hashing its name again.
+  ///
+  /// @param id The AssetId of the texture's file name.
+  /// @param format The texture format, defaults to kFormatAuto.
+  /// @param flags The texture flags, by default loads textures async.
+  /// @param priority Load priority when async. See AsyncLoadPriority.
+  /// @return Returns an unloaded texture object. If not async, may also
+  ///         return null to signal and error.
+  Texture *LoadTexture(const AssetId &id, TextureFormat format = kFormatAuto,
+                       TextureFlags flags = kTextureFlagsUseMipMaps |
+                                            kTextureFlagsLoadAsync,
+                       int priority = kLoadPriorityNormal);
+
+  /// @brief Queue loading a cube map made of 6 separate face files, if it
+  /// hasn't been loaded already.
+  ///
+  /// If async, the faces are loaded and decoded in parallel on the loader
+  /// threads, and each is uploaded, and freed, as soon as TryFinalize() finds
+  /// it ready, so peak memory is bounded by the faces in flight instead of a
+  /// whole 1x6 strip. The texture is finalized with its last face. Otherwise
+  /// the faces are loaded one after the other. Cube maps loaded this way
+  /// aren't counted against the texture memory budget, since they can't be
+  /// reloaded from a single file.
+  ///
+  /// @param name The name to find the cube map by, e.g. with FindTexture().
+  /// @param face_filenames The files of the +X, -X, +Y, -Y, +Z and -Z faces,
+  /// each square and all of the same size and format.
+  /// @param format The texture format, defaults to kFormatAuto.
+  /// @param flags The texture flags, by default loads textures async.
+  /// kTextureFlagsIsCubeMap is implied, and kTextureFlagsStreamMips ignored.
+  /// @param priority Load priority when async. See AsyncLoadPriority.
+  /// @return Returns an unloaded texture object.
+  Texture *LoadCubeMap(const char *name, const char *const face_filenames[6],
+                       TextureFormat format = kFormatAuto,
+                       TextureFlags flags = kTextureFlagsUseMipMaps |
+                                            kTextureFlagsLoadAsync,
+                       int priority = kLoadPriorityNormal);
 
   /// @brief Start loading all previously queued textures.
   ///
@@ -158,6 +262,99 @@ class AssetManager {
   /// StartLoadingTextures.
   void StopLoadingTextures();
 
+  /// @brief Set the number of threads used to load assets asynchronously.
+  ///
+  /// Must be called while no textures are loading, i.e. before
+  /// StartLoadingTextures() or after StopLoadingTextures().
+  ///
+  /// @param num_threads The number of loader threads. Values less than 1
+  /// select AsyncLoader::DefaultNumWorkerThreads().
+  void SetNumLoaderThreads(int num_threads) {
+    loader_.set_num_worker_threads(num_threads);
+  }
+
+  /// @brief Change the priority of an asset waiting in the async queue.
+  ///
+  /// Unlike LoadTexture() and LoadMesh(), this can also lower the priority.
+  ///
+  /// @param asset The texture, mesh or shader to move in the queue.
+  /// @param priority The new priority. See AsyncLoadPriority.
+  /// @return Returns true if the asset was still waiting to be loaded.
+  bool Reprioritize(AsyncAsset *asset, int priority) {
+    return loader_.Reprioritize(asset, priority);
+  }
+
+  /// @brief Limit the GPU memory used by textures and meshes.
+  ///
+  /// When over budget, TryFinalize() frees the least recently used textures
+  /// and meshes until back under budget. Evicted assets stay valid objects,
+  /// and are queued for reloading through the async loader the next time
+  /// they are looked up with Find*() or Load*().
+  ///
+  /// An asset counts as used whenever it, or a mesh or material containing
+  /// it, is looked up. Assets looked up since the last call to TryFinalize(),
+  /// and assets with an AssetHandle (including the textures of a mesh with a
+  /// handle), are never evicted. Hold handles to assets you keep rendering
+  /// without looking them up every frame. Reloading requires the loader to
+  /// be running, see StartLoadingTextures().
+  ///
+  /// Finer mips of kTextureFlagsStreamMips textures are only streamed in
+  /// while they fit in the texture budget.
+  ///
+  /// @param texture_bytes The texture budget in bytes, or 0 for no limit.
+  /// @param mesh_bytes The mesh budget in bytes, or 0 for no limit.
+  void SetMemoryBudget(size_t texture_bytes, size_t mesh_bytes) {
+    texture_residency_.budget = texture_bytes;
+    mesh_residency_.budget = mesh_bytes;
+  }
+
+  /// @brief The estimated GPU memory used by loaded textures, in bytes.
+  size_t texture_memory_used() const { return texture_residency_.bytes_used; }
+
+  /// @brief The estimated GPU memory used by loaded meshes, in bytes.
+  size_t mesh_memory_used() const { return mesh_residency_.bytes_used; }
+
+  /// @brief The GPU memory allocated by all objects of a category, whether
+  /// loaded through this AssetManager or not, with its high-water mark.
+  ///
+  /// Comparing it against texture_memory_used() and mesh_memory_used() shows
+  /// how much is held outside of the managed assets, e.g. by leaked objects.
+  const GpuMemoryStats &gpu_memory(GpuMemoryCategory category) const {
+    return RendererBase::Get()->gpu_memory(category);
+  }
+
+  /// @brief Start recording which textures, materials and meshes get loaded.
+  ///
+  /// Records every LoadTexture(), LoadMaterial() and LoadMesh() call that
+  /// creates a new asset, with its flags, in order. Save the recording with
+  /// SaveLoadManifest(), e.g. after a level has loaded, and pass it to
+  /// PrefetchManifest() on the next launch. Clears any previous recording.
+  void StartRecordingLoads();
+
+  /// @brief Stop recording loads. The recording is kept until the next
+  /// StartRecordingLoads().
+  void StopRecordingLoads() { recording_loads_ = false; }
+
+  /// @brief Write the loads recorded since StartRecordingLoads() to a
+  /// .fplmanifest file.
+  ///
+  /// @param filename The file to write.
+  /// @return Returns false if the file couldn't be written.
+  bool SaveLoadManifest(const char *filename) const;
+
+  /// @brief Queue all the assets in a .fplmanifest file for loading.
+  ///
+  /// Call at startup, so the asset files load while the rest of the engine
+  /// initializes, instead of one at a time as game code asks for them.
+  /// Later Load*() calls for the same assets return the queued ones. Textures
+  /// and meshes are queued asynchronously as they were recorded, so call
+  /// StartLoadingTextures() and TryFinalize() as usual. Materials are loaded
+  /// right away (their textures as recorded).
+  ///
+  /// @param filename The manifest written by SaveLoadManifest().
+  /// @return Returns false if the manifest couldn't be loaded.
+  bool PrefetchManifest(const char *filename);
+
   /// @brief Check for the status of async loading resources.
   ///
   /// Call this repeatedly until it returns true, which signals all resources
@@ -168,6 +365,18 @@ class AssetManager {
   /// @return Returns true when all resources have been loaded & finalized.
   bool TryFinalize();
 
+  /// @brief Check for the status of async loading resources, within a budget.
+  ///
+  /// Works like TryFinalize(), but spends at most about `budget_ms`
+  /// milliseconds turning loaded resources into OpenGL resources, to avoid
+  /// frame hitches. Call once per frame until it returns true.
+  ///
+  /// @param budget_ms The time, in milliseconds, that may be spent finalizing.
+  /// @param num_pending If not null, receives the number of resources that are
+  /// still loading or waiting to be finalized.
+  /// @return Returns true when all resources have been loaded & finalized.
+  bool TryFinalize(double budget_ms, int *num_pending = nullptr);
+
   /// @brief Deletes the previously loaded texture.
   ///
   /// Deletes the texture and removes it from the material manager. Any
@@ -184,6 +393,12 @@ class AssetManager {
   /// @return Returns the material, or nullptr if not previously loaded.
   Material *FindMaterial(const char *filename);
 
+  /// @brief Returns a previously loaded material.
+  ///
+  /// @param id The AssetId of the material's file name.
+  /// @return Returns the material, or nullptr if not previously loaded.
+  Material *FindMaterial(const AssetId &id);
+
   /// @brief Loads and returns a material object.
   ///
   /// Loads a material, which is a compiled FlatBuffer file with
@@ -195,6 +410,15 @@ class AssetManager {
   /// @return Returns the loaded material, or nullptr if there was an error.
   Material *LoadMaterial(const char *filename, bool async_resources = false);
 
+  /// @brief Loads and returns a material object.
+  ///
+  /// Works like LoadMaterial (above), but finds an already loaded material
+  /// without hashing its name again.
+  ///
+  /// @param id The AssetId of the material's file name.
+  /// @return Returns the loaded material, or nullptr if there was an error.
+  Material *LoadMaterial(const AssetId &id, bool async_resources = false);
+
   /// @brief Deletes the previously loaded material.
   ///
   /// Deletes all OpenGL textures contained in this material, and removes the
@@ -211,14 +435,39 @@ class AssetManager {
   /// @return Returns the mesh, or nullptr if not previously loaded.
   Mesh *FindMesh(const char *filename);
 
+  /// @brief Returns a previously loaded mesh.
+  ///
+  /// @param id The AssetId of the mesh's file name.
+  /// @return Returns the mesh, or nullptr if not previously loaded.
+  Mesh *FindMesh(const AssetId &id);
+
   /// @brief Loads and returns a mesh object.
   ///
   /// Loads a mesh, which is a compiled FlatBuffer file with root Mesh.
   /// If this returns nullptr, the error can be found in Renderer::last_error().
   ///
+  /// If async, the mesh and the textures of its embedded materials are queued
+  /// with `priority`. If the mesh is already waiting in the async queue with a
+  /// lower priority, it is moved up to `priority`.
+  ///
   /// @param filename The name of the mesh.
+  /// @param async A boolean to indicate whether to load asynchronously or not.
+  /// @param priority Load priority when async. See AsyncLoadPriority.
+  /// @return
+  Mesh *LoadMesh(const char *filename, bool async = false,
+                 int priority = kLoadPriorityNormal);
+
+  /// @brief Loads and returns a mesh object.
+  ///
+  /// Works like LoadMesh (above), but finds an already loaded mesh without
+  /// hashing its name again.
+  ///
+  /// @param id The AssetId of the mesh's file name.
+  /// @param async A boolean to indicate whether to load asynchronously or not.
+  /// @param priority Load priority when async. See AsyncLoadPriority.
   /// @return
-  Mesh *LoadMesh(const char *filename, bool async = false);
+  Mesh *LoadMesh(const AssetId &id, bool async = false,
+                 int priority = kLoadPriorityNormal);
 
   /// @brief Deletes the previously loaded mesh.
   ///
@@ -236,6 +485,13 @@ class AssetManager {
   /// @return Pointer to the texture atlas if found, nullptr otherwise.
   TextureAtlas *FindTextureAtlas(const char *filename);
 
+  /// @brief Look up a previously loaded texture atlas.
+  ///
+  /// @param id The AssetId of the texture atlas file name.
+  ///
+  /// @return Pointer to the texture atlas if found, nullptr otherwise.
+  TextureAtlas *FindTextureAtlas(const AssetId &id);
+
   /// @brief Loads a texture atlas.
   ///
   /// Loads a texture atlas, which is a compiled FlatBuffer file containing a
@@ -267,10 +523,20 @@ class AssetManager {
   /// @return Pointer to the file asset if found, nullptr otherwise.
   FileAsset *FindFileAsset(const char *filename);
 
+  /// @brief Look up a previously loaded file asset.
+  ///
+  /// @param id The AssetId of the file asset's file name.
+  ///
+  /// @return Pointer to the file asset if found, nullptr otherwise.
+  FileAsset *FindFileAsset(const AssetId &id);
+
   /// @brief Loads a file asset.
   ///
+  /// @param filename Name of the file to load.
+  /// @param map_file Map the file rather than copying it, see
+  /// FileAsset::LoadMapped(). Access the contents with FileAsset::data().
   /// @return nullptr on error.
-  FileAsset *LoadFileAsset(const char *filename);
+  FileAsset *LoadFileAsset(const char *filename, bool map_file = false);
 
   /// @brief Delete a file asset and remove it from the asset manager.
   ///
@@ -294,24 +560,57 @@ class AssetManager {
   /// OpenGL context to still be alive.
   void ClearAllAssets();
 
+  /// @brief Map mesh files into memory rather than copying them, see
+  /// Mesh::set_map_file(). Applies to meshes loaded afterwards.
+  void SetMapMeshFiles(bool map_files) { map_mesh_files_ = map_files; }
+
   /// @brief Set a scaling factor to apply when loading texture materials.
   ///
   /// By setting the scaling factor, an application save a memory footprint
   /// on low RAM devices.
   void SetTextureScale(const mathfu::vec2 &scale) { texture_scale_ = scale; }
 
-  /// @brief Reset global defines and set dirty flags of all shaders.
+  /// @brief Reset global defines and set dirty flags of the shaders they
+  /// affect.
+  ///
+  /// This will cause the affected shaders to be reloaded in the next frame
+  /// they are being used. Shaders whose source doesn't mention any of the
+  /// changed defines are left as they are.
   ///
-  /// This will cause all shaders be reloaded in the next frame it is being
-  /// used.
+  /// @param defines_to_add See Shader::UpdateGlobalDefines().
+  /// @param defines_to_omit See Shader::UpdateGlobalDefines().
+  /// @param async If true, the affected shaders are instead reloaded on the
+  /// loader threads, and compiled in TryFinalize() (in the background, where
+  /// the driver supports it). They keep rendering with their old defines
+  /// until then, and switch to the new program at once when it's ready. This
+  /// needs StartLoadingTextures() and TryFinalize(), like async loads.
   void ResetGlobalShaderDefines(
       const std::vector<std::string> &defines_to_add,
-      const std::vector<std::string> &defines_to_omit);
+      const std::vector<std::string> &defines_to_omit, bool async = false);
 
   /// @brief Foreach shader with a specific define.
   void ForEachShaderWithDefine(const char *define,
                                const std::function<void(Shader *)> &func);
 
+  /// @brief Callback for ForEachLoadStats().
+  /// @param type The kind of asset: "texture", "mesh", "shader" or "file".
+  /// @param name The name the asset was loaded under.
+  /// @param stats The timings and sizes of its last load.
+  typedef std::function<void(const char *type, const std::string &name,
+                             const AssetLoadStats &stats)>
+      LoadStatsFn;
+
+  /// @brief Calls `func` with the load stats of every finalized texture,
+  /// mesh, shader and file asset.
+  void ForEachLoadStats(const LoadStatsFn &func) const;
+
+  /// @brief Appends the load stats of all finalized assets to `csv`.
+  ///
+  /// Writes a header line, then one line per asset with its type, name, the
+  /// durations of AssetLoadStats in milliseconds, and the byte sizes. Save it
+  /// with SaveFile() to compare load times across builds or levels.
+  void DumpLoadStats(std::string *csv) const;
+
  private:
   Shader *LoadShaderHelper(const char *basename,
                            const std::vector<std::string> &local_defines,
@@ -323,26 +622,143 @@ class AssetManager {
   // It gets passed a blank asset that we take ownership of, and the map it
   // should go into if all succeeds.
   template <typename T>
-  T *LoadOrQueue(T *asset, std::map<std::string, T *> &asset_map, bool async,
-                 const char *alias) {
-    asset_map[alias != nullptr ? alias : asset->filename()] = asset;
+  T *LoadOrQueue(T *asset, AssetMap<T> &asset_map, bool async,
+                 const char *alias, int priority = kLoadPriorityNormal) {
+    const std::string &name = alias != nullptr ? alias : asset->filename();
+    asset_map.Insert(AssetId(name), name, asset);
     if (async) {
-      loader_.QueueJob(asset);
+      loader_.QueueJob(asset, priority);
     } else {
       asset->LoadNow();
     }
     return asset;
   }
 
+  // Moves an already queued asset ahead if `priority` is higher than its own.
+  void RaisePriority(AsyncAsset *asset, int priority) {
+    if (!asset->IsFinalized() && priority > asset->load_priority()) {
+      loader_.Reprioritize(asset, priority);
+    }
+  }
+
+  // The loaded textures or meshes, in least recently used order, for
+  // evicting them when over the memory budget.
+  template <typename T>
+  struct ResidentSet {
+    struct Entry {
+      T *asset;
+      size_t size;
+      unsigned int last_use;
+    };
+    typedef std::list<Entry> List;
+
+    ResidentSet() : budget(0), bytes_used(0) {}
+
+    List lru;  // Most recently used first.
+    std::unordered_map<const T *, typename List::iterator> entries;
+    std::unordered_set<const T *> evicted;
+    size_t budget;
+    size_t bytes_used;
+  };
+
+  // When `asset` finalizes, record it as resident in `set`.
+  template <typename T>
+  void TrackResidency(T *asset, ResidentSet<T> *set);
+  // Marks `asset` as used, and queues it for reloading if it was evicted.
+  template <typename T>
+  void Touch(T *asset, ResidentSet<T> *set);
+  // Stops tracking `asset`, e.g. when it is unloaded.
+  template <typename T>
+  void ForgetResidency(T *asset, ResidentSet<T> *set);
+  template <typename T>
+  void ClearResidency(ResidentSet<T> *set);
+  // Evicts least recently used assets until `set` is within its budget.
+  template <typename T>
+  void EvictOverBudget(ResidentSet<T> *set);
+  // Frees the GPU resources of an asset, but not the asset itself.
+  void Evict(Texture *texture) {
+    StopMipStreaming(texture);
+    texture->Delete();
+  }
+  static void Evict(Mesh *mesh) { mesh->Unload(); }
+  void TouchTexture(Texture *texture) { Touch(texture, &texture_residency_); }
+  // Returns the texture with the given name, creating and queueing it if it
+  // doesn't exist yet. Called by loader threads, from Mesh::Load().
+  Texture *PrefetchTexture(const char *filename, TextureFormat format,
+                           TextureFlags flags, int priority,
+                           const mathfu::vec2 &scale);
+  // Adds the textures created by PrefetchTexture() to texture_map_.
+  // Call with prefetch_mutex_ held, on the main thread.
+  void RegisterPrefetchedTextures();
+  void TouchMaterial(Material *material);
+  void TouchMesh(Mesh *mesh);
+  // Returns the material made of `def`, embedded in a mesh, creating it if no
+  // other surface has one with the same contents yet.
+  Material *LoadEmbeddedMaterial(const matdef::Material *def,
+                                 const TextureLoaderFn &load_texture_fn);
+  // Called from TryFinalize(), once per frame.
+  void EnforceMemoryBudget();
+  // Collects finished TextureMipStreams, and queues new ones for textures
+  // that need finer mips. Called from TryFinalize(), once per frame.
+  void StreamMips();
+  // Aborts the mip streaming of `texture`, if any.
+  void StopMipStreaming(Texture *texture);
+  // Deletes the TextureCubeMapFaces of cube maps that finished loading.
+  // Called from TryFinalize(), once per frame.
+  void CollectCubeMapFaces();
+  // Aborts the loading of the faces of `texture`, if any.
+  void StopCubeMapLoading(Texture *texture);
+
+  // A Load*() call recorded by StartRecordingLoads().
+  struct RecordedLoad {
+    enum Type { kTexture, kMaterial, kMesh };
+    Type type;
+    std::string name;
+    TextureFormat format;
+    TextureFlags flags;
+    int priority;
+    bool async;
+  };
+  void RecordLoad(RecordedLoad::Type type, const char *name, bool async,
+                  int priority, TextureFormat format = kFormatAuto,
+                  TextureFlags flags = kTextureFlagsNone);
+
   Renderer &renderer_;
-  std::map<std::string, Shader *> shader_map_;
-  std::map<std::string, Texture *> texture_map_;
-  std::map<std::string, TextureAtlas *> texture_atlas_map_;
-  std::map<std::string, Material *> material_map_;
-  std::map<std::string, Mesh *> mesh_map_;
-  std::map<std::string, FileAsset *> file_map_;
+  AssetMap<Shader> shader_map_;
+  AssetMap<Texture> texture_map_;
+  AssetMap<TextureAtlas> texture_atlas_map_;
+  AssetMap<Material> material_map_;
+  // Materials loaded from files, by Material::ContentKey(), so files with the
+  // same contents share one. Each file name in material_map_ that shares it
+  // holds a reference.
+  std::unordered_map<std::string, Material *> material_contents_;
+  // Materials embedded in meshes, by Material::ContentKey(). Shared by all
+  // surfaces with the same contents, and deleted by ClearAllAssets().
+  std::unordered_map<std::string, Material *> embedded_materials_;
+  AssetMap<Mesh> mesh_map_;
+  AssetMap<FileAsset> file_map_;
   AsyncLoader loader_;
   mathfu::vec2 texture_scale_;
+  bool map_mesh_files_;
+  ResidentSet<Texture> texture_residency_;
+  ResidentSet<Mesh> mesh_residency_;
+  // Incremented by every TryFinalize(), to tell what was used since the last.
+  unsigned int use_epoch_;
+  // Guards texture_index_ and prefetched_, which loader threads use too.
+  fplutil::Mutex prefetch_mutex_;
+  // All textures in texture_map_, plus those in prefetched_, by AssetId hash.
+  std::unordered_map<uint64_t, Texture *> texture_index_;
+  // Textures created by loader threads, not yet added to texture_map_.
+  std::vector<Texture *> prefetched_;
+  // The mip being streamed into each kTextureFlagsStreamMips texture.
+  std::unordered_map<Texture *, TextureMipStream *> mip_streams_;
+  // The faces of each cube map still loading from LoadCubeMap().
+  std::unordered_map<Texture *, std::vector<TextureCubeMapFace *>>
+      cube_map_faces_;
+
+  // Loads recorded since StartRecordingLoads().
+  bool recording_loads_;
+  std::vector<RecordedLoad> recorded_loads_;
 
   std::vector<std::string> defines_to_add_;
   std::vector<std::string> defines_to_omit_;
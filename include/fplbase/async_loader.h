@@ -16,6 +16,7 @@
 #define FPLBASE_ASYNC_LOADER_H
 
 #include <stdint.h>
+#include <atomic>
 #include <deque>
 #include <functional>
 #include <string>
@@ -23,6 +24,7 @@
 
 #include "fplbase/config.h"  // Must come first.
 #include "fplbase/asset.h"
+#include "fplbase/internal/mpsc_queue.h"
 
 #ifdef FPLBASE_BACKEND_STDLIB
 #include <mutex>
@@ -39,8 +41,66 @@ namespace fplbase {
 typedef void *Thread;
 typedef void *Mutex;
 typedef void *Semaphore;
+typedef void *ConditionVariable;
 
 class AsyncLoader;
+class AsyncUploader;
+class Environment;
+struct AsyncLoadJob;
+
+/// @brief Suggested priorities for AsyncLoader::QueueJob().
+///
+/// Any int can be used as a priority. Queued assets with a higher priority
+/// are loaded before those with a lower one, and assets with equal priority
+/// are loaded in the order they were queued.
+enum AsyncLoadPriority {
+  kLoadPriorityLow = -100,
+  kLoadPriorityNormal = 0,
+  kLoadPriorityHigh = 100,
+  kLoadPriorityCritical = 200,
+};
+
+/// @brief Where the time went while loading an AsyncAsset, and how much data
+/// it loaded. Durations are in seconds.
+///
+/// The AsyncLoader records the queue, load and finalize times of every asset.
+/// The I/O and decode split, and the byte sizes, are filled in by the assets
+/// that report them from their Load(), e.g. Texture and Mesh.
+struct AssetLoadStats {
+  AssetLoadStats()
+      : queue_time(0),
+        load_time(0),
+        wait_time(0),
+        io_time(0),
+        decode_time(0),
+        finalize_time(0),
+        upload_time(0),
+        file_bytes(0),
+        decoded_bytes(0) {}
+
+  /// @brief From AsyncLoader::QueueJob() until a loader thread picked it up.
+  double queue_time;
+  /// @brief Duration of Load(), on a loader thread. Includes io_time and
+  /// decode_time.
+  double load_time;
+  /// @brief Time spent reading (or mapping) files within Load().
+  double io_time;
+  /// @brief Time spent decoding the file contents within Load().
+  double decode_time;
+  /// @brief From the end of Load() until Finalize() was called: waiting for
+  /// the next AsyncLoader::TryFinalize(), and for any load dependencies.
+  double wait_time;
+  /// @brief Duration of Finalize(), on the main thread, up to its finalize
+  /// callbacks. For textures and meshes this is mostly the upload to the GPU.
+  double finalize_time;
+  /// @brief Duration of Upload(), on the upload thread, if the asset was
+  /// uploaded there. See AsyncLoader::StartUploadThread().
+  double upload_time;
+  /// @brief Bytes read from files by Load().
+  size_t file_bytes;
+  /// @brief Bytes of decoded data Load() handed to Finalize(), if known.
+  size_t decoded_bytes;
+};
 
 /// @class AsyncResource
 /// @brief Any resource that can be loaded asynchronously should inherit from
@@ -51,7 +111,12 @@ class AsyncAsset : public Asset {
   typedef std::function<void()> AssetFinalizedCallback;
 
   /// @brief Default constructor for an empty AsyncAsset.
-  AsyncAsset() : data_(nullptr), finalized_(false) {}
+  AsyncAsset()
+      : data_(nullptr),
+        load_priority_(kLoadPriorityNormal),
+        load_job_(nullptr),
+        finalize_start_(-1.0),
+        finalized_(false) {}
 
   /// @brief Construct an AsyncAsset with a given file name.
   /// @param[in] filename A C-string corresponding to the name of the asset
@@ -60,6 +125,9 @@ class AsyncAsset : public Asset {
       : filename_(filename),
         data_(nullptr),
         finalize_callbacks_(0),
+        load_priority_(kLoadPriorityNormal),
+        load_job_(nullptr),
+        finalize_start_(-1.0),
         finalized_(false) {}
 
   /// @brief AsyncAsset destructor.
@@ -68,10 +136,11 @@ class AsyncAsset : public Asset {
   /// @brief Override with the actual loading behavior.
   ///
   /// Load should perform the actual loading of filename_, and store the
-  /// result in data_, or nullptr upon failure. It is called on the loader
-  /// thread, so should not access any program state outside of this object.
-  /// Since there will be only one loader thread, any libraries called by Load
-  /// need not be MT-safe as long as they're not also called by the main thread.
+  /// result in data_, or nullptr upon failure. It is called on one of the
+  /// loader threads, so should not access any program state outside of this
+  /// object. Several assets may be loading at the same time on different
+  /// threads, so any libraries called by Load must be MT-safe, unless
+  /// AsyncLoader::set_num_worker_threads(1) is used.
   virtual void Load() = 0;
 
   /// @brief Override with converting the data into the resource.
@@ -81,6 +150,26 @@ class AsyncAsset : public Asset {
   /// Should check if data_ is null.
   virtual bool Finalize() = 0;
 
+  /// @brief Override to start work Finalize() depends on, without waiting for
+  /// it, e.g. a shader compile the driver does in the background.
+  ///
+  /// Called on the main thread before Finalize(), once any load dependencies
+  /// are finalized, and again on each AsyncLoader::TryFinalize() until it
+  /// returns true. Only then is Finalize() called.
+  virtual bool PrepareFinalize() { return true; }
+
+  /// @brief Override to create the GPU objects for data_ off the main thread.
+  ///
+  /// Called after Load() on the loader's upload thread, which has a GL
+  /// context shared with the renderer's, if AsyncLoader::StartUploadThread()
+  /// was called. Finalize() is still called on the main thread afterwards,
+  /// once the GPU is done with the upload. Objects that can't be shared
+  /// between contexts, e.g. vertex array objects, must be left to Finalize().
+  /// If the asset is aborted before Finalize(), the destructor must free what
+  /// Upload() created.
+  /// @return Returns true if it uploaded anything.
+  virtual bool Upload() { return false; }
+
   /// @brief Whether this object has been loaded and finalized. This does not
   /// signal success or not -- check IsValid for that.
   bool IsFinalized() const { return finalized_; }
@@ -93,12 +182,11 @@ class AsyncAsset : public Asset {
   ///
   /// Not used by the loader thread, should be called on the main thread.
   /// @return Returns false on failure.
-  bool LoadNow() {
-    Load();
-    bool ok = data_ != nullptr;
-    // Call this even if data_ is null, to enforce Finalize() checking for it.
-    return Finalize() && ok;
-  }
+  bool LoadNow();
+
+  /// @brief Timings and sizes of the last load of this asset. Valid once
+  /// finalized.
+  const AssetLoadStats &load_stats() const { return load_stats_; }
 
   /// @brief Sets the filename that should be loaded.
   ///
@@ -113,6 +201,9 @@ class AsyncAsset : public Asset {
   /// @return Returns the filename.
   const std::string &filename() const { return filename_; }
 
+  /// @brief The priority this asset was last queued or reprioritized with.
+  int load_priority() const { return load_priority_; }
+
   /// @brief Adds a callback to be called when the asset is finalized.
   ///
   /// Add a callback so logic can be executed when an asset is done loading.
@@ -130,19 +221,34 @@ class AsyncAsset : public Asset {
   }
 
  protected:
-  /// @brief Calls app callbacks when an asset is ready to be used.
+  /// @brief Defer Finalize() until `dependency` has been finalized.
   ///
-  /// This should be called by descendants as soon as they are finalized.
-  void CallFinalizeCallback() {
-    auto callbacks = finalize_callbacks_;
-    finalize_callbacks_.clear();
-    for (auto it = callbacks.begin();
-         it != callbacks.end(); ++it) {
-      (*it)();
+  /// Call from Load(), e.g. for textures that Load() queued for loading, so
+  /// this asset is finalized only once they are ready. Dependencies must stay
+  /// alive until this asset has been finalized.
+  void AddLoadDependency(AsyncAsset *dependency) {
+    load_dependencies_.push_back(dependency);
+  }
+
+  /// @brief Whether all dependencies added by AddLoadDependency() are done.
+  ///
+  /// Dependencies that are not queued for loading at all (e.g. aborted ones)
+  /// don't hold up this asset. Main thread only.
+  bool LoadDependenciesFinalized() const {
+    for (auto it = load_dependencies_.begin(); it != load_dependencies_.end();
+         ++it) {
+      if (!(*it)->finalized_ && (*it)->load_job_) return false;
     }
-    finalized_ = true;
+    return true;
   }
 
+  /// @brief Calls app callbacks when an asset is ready to be used.
+  ///
+  /// This should be called by descendants as soon as they are finalized.
+  /// Records `load_stats_.finalize_time` first, since a callback may delete
+  /// the asset.
+  void CallFinalizeCallback();
+
   /// @brief The resource file name.
   std::string filename_;
   /// @brief The resource data.
@@ -150,10 +256,60 @@ class AsyncAsset : public Asset {
 
   /// @brief List of callbacks to be invoked when the asset is finalized.
   std::vector<AssetFinalizedCallback> finalize_callbacks_;
+  /// @brief Assets that must be finalized before this one. See
+  /// AddLoadDependency().
+  std::vector<AsyncAsset *> load_dependencies_;
+  /// @brief Filled in while loading. Load() may add to io_time, decode_time
+  /// and the byte sizes.
+  AssetLoadStats load_stats_;
+  /// @brief Where this asset sits in the load queue. See AsyncLoadPriority.
+  int load_priority_;
+  /// @brief The loader's record for this asset while it is queued, loading,
+  /// or waiting to be finalized. Lets AsyncLoader abort it in constant time.
+  AsyncLoadJob *load_job_;
+  /// @brief When the loader called Finalize(), until CallFinalizeCallback()
+  /// records the finalize time; negative otherwise.
+  double finalize_start_;
   /// @brief Whether the asset has been finalized.
   bool finalized_;
 
   friend class AsyncLoader;
+  friend class AsyncUploader;
+  friend class AssetManager;
+};
+
+/// @brief An entry in the AsyncLoader queues.
+///
+/// Queue entries are owned by the loader, not by the asset, so an asset can
+/// be aborted (and deleted) without searching the queues. Its entry is simply
+/// marked as aborted and skipped once it reaches the front of its queue.
+/// Internal to AsyncLoader.
+struct AsyncLoadJob : public MpscNode {
+  enum State { kQueued, kLoading, kLoaded };
+
+  explicit AsyncLoadJob(AsyncAsset *res, int priority)
+      : asset(res), priority(priority), state(kQueued),
+        delete_when_loaded(false), queued_at(0), loaded_at(0),
+        upload_fence(nullptr) {}
+
+  /// @brief The asset to load, or nullptr if the job was aborted.
+  AsyncAsset *asset;
+  /// @brief Copy of the asset's load priority, used for queue ordering.
+  int priority;
+  /// @brief Which of the loader's stages the job is in. Written by the worker
+  /// threads without holding the loader's lock.
+  std::atomic<State> state;
+  /// @brief Set when the asset was aborted while loading, and should be
+  /// deleted instead of finalized.
+  bool delete_when_loaded;
+  /// @brief GetTimeInSeconds() when the job was queued.
+  double queued_at;
+  /// @brief GetTimeInSeconds() when the asset's Load() returned, or its
+  /// Upload(), if it was uploaded on the upload thread.
+  double loaded_at;
+  /// @brief GL sync object the GPU signals once the asset's Upload() has
+  /// completed, or nullptr.
+  void *upload_fence;
 };
 
 /// @class AsyncLoader
@@ -168,28 +324,55 @@ class AsyncLoader {
   /// Call this any number of times before StartLoading.
   ///
   /// @param res The resource to queue for loading.
-  void QueueJob(AsyncAsset *res);
+  /// @param priority Queued resources with higher priorities are loaded first.
+  /// See AsyncLoadPriority.
+  void QueueJob(AsyncAsset *res, int priority = kLoadPriorityNormal);
+
+  /// @brief Changes the priority of a resource that is waiting to be loaded.
+  ///
+  /// Moves the resource to its new place in the queue, behind any other
+  /// resources of the same priority. Resources that are already loading or
+  /// loaded are unaffected.
+  ///
+  /// @param res The resource to move in the queue.
+  /// @param priority The new priority. See AsyncLoadPriority.
+  /// @return Returns true if the resource was found in the queue.
+  bool Reprioritize(AsyncAsset *res, int priority);
 
   /// @brief Aborts any pending operations for the given asset.
   ///
-  /// If the given asset is currently loading, this blocks until it is complete.
-  /// If it has not yet been loaded, this removes it from the queue.
+  /// Call on the main thread only, like TryFinalize().
+  /// If the given asset is currently loading, this blocks until its Load()
+  /// returns. Other worker threads carry on loading in the meantime.
+  /// If it has not yet been loaded, or has not been finalized yet, it is
+  /// removed from the loader in constant time. Once this returns, the loader
+  /// no longer refers to the asset.
   ///
   /// @param res The resource to abort performing any operations on.
   void AbortJob(AsyncAsset *res);
 
-  /// @brief Launches the loading thread for the previously queued jobs.
+  /// @brief Aborts any pending operations for the given asset, and deletes it.
+  ///
+  /// Call on the main thread only, like TryFinalize().
+  /// Never blocks. If the given asset is currently loading, the loader takes
+  /// ownership and deletes it from TryFinalize() once its Load() returns,
+  /// instead of finalizing it. Otherwise it is deleted right away.
+  ///
+  /// @param res The resource to abort and delete.
+  void AbortJobAndDelete(AsyncAsset *res);
+
+  /// @brief Launches the loading threads for the previously queued jobs.
   void StartLoading();
 
-  /// @brief Pause the loading thread for previously queued jobs.
+  /// @brief Pause the loading threads for previously queued jobs.
   ///
-  /// Blocks until only the current job is finished loading. You can resume
+  /// Blocks until only the current jobs are finished loading. You can resume
   /// loading assets by calling StartLoading().
   void PauseLoading();
 
-  /// @brief Ends the loading thread when all jobs are done.
+  /// @brief Ends the loading threads when all jobs are done.
   ///
-  /// Cleans-up the background loading thread once all jobs have been completed.
+  /// Cleans-up the background loading threads once all jobs have been completed.
   /// You can restart with StartLoading() if you like.
   void StopLoadingWhenComplete();
 
@@ -203,10 +386,59 @@ class AsyncLoader {
   /// @return Returns true once the queue is empty.
   bool TryFinalize();
 
+  /// @brief Finalize resources that have finished loading, within a budget.
+  ///
+  /// Works like TryFinalize(), but stops calling Finalize once `budget_ms`
+  /// milliseconds have been spent. At least one resource is finalized per
+  /// call if any are ready, so loading always makes progress. The remaining
+  /// resources are finalized on subsequent calls.
+  ///
+  /// @param budget_ms The time, in milliseconds, that may be spent finalizing.
+  /// @param num_pending If not null, receives the number of jobs that are
+  /// still queued, loading, or waiting to be finalized.
+  /// @return Returns true once the queue is empty.
+  bool TryFinalize(double budget_ms, int *num_pending = nullptr);
+
   /// @brief Shuts down the loader after completing all pending loads.
   void Stop();
 
+  /// @brief Sets the number of worker threads used to load assets.
+  ///
+  /// Assets are loaded in parallel on this many threads. Finalize() is still
+  /// only ever called on the main thread, from TryFinalize(). Only takes
+  /// effect the next time the loader threads are started, so call this before
+  /// StartLoading(), or after Stop().
+  ///
+  /// @param num_threads The number of worker threads. Values less than 1
+  /// select the default, which is the number of CPU cores minus one (for the
+  /// main / render thread), and at least one.
+  void set_num_worker_threads(int num_threads);
+
+  /// @brief The number of worker threads that StartLoading() launches.
+  int num_worker_threads() const { return num_worker_threads_; }
+
+  /// @brief The default number of worker threads for this machine.
+  static int DefaultNumWorkerThreads();
+
+  /// @brief Starts a thread that calls AsyncAsset::Upload() after Load(),
+  /// with a GL context shared with the renderer's.
+  ///
+  /// Moves the GPU uploads of e.g. textures off the main thread, leaving
+  /// Finalize() little to do. Call on the main thread, with the renderer's
+  /// context current, before StartLoading() or after Stop().
+  ///
+  /// @param environment The renderer's environment, to share a context with.
+  /// @return Returns false if the environment can't create a shared context.
+  /// Assets are then uploaded by Finalize() as usual.
+  bool StartUploadThread(Environment *environment);
+
+  /// @brief Ends the upload thread once it has uploaded all loaded assets.
+  /// Call before StartLoading() or after Stop(). Stop() also calls this.
+  void StopUploadThread();
+
  private:
+  friend class AsyncUploader;
+
 #ifdef FPLBASE_BACKEND_SDL
   void Lock(const std::function<void()> &body);
   template <typename T>
@@ -219,24 +451,60 @@ class AsyncLoader {
 
   void LoaderWorker();
   static int LoaderThread(void *user_data);
-
-  std::deque<AsyncAsset *> queue_, done_;
-  AsyncAsset *loading_;
-  int num_pending_requests_;
+  // Inserts into queue_ according to job->priority. Hold the lock.
+  void InsertJob(AsyncLoadJob *job);
+  // Detaches `res` from its job, leaving the job in its queue to be skipped.
+  // Hold the lock, and don't call this for jobs that are loading.
+  void DetachJob(AsyncAsset *res);
+  // Deletes all job records, e.g. when the loader is destroyed.
+  void DeleteJobs();
+  // Takes the next job from done_. Main thread only.
+  AsyncLoadJob *PopDone();
+  // Calls Load() on the asset of a job taken off queue_, then hands the job to
+  // the main thread. Loader threads only.
+  void LoadJob(AsyncLoadJob *job);
+  // Moves a job that has loaded (and uploaded) to kLoaded, wakes AbortJob() if
+  // it's waiting for it, and hands it to the main thread. Loader and upload
+  // threads only.
+  void FinishJob(AsyncLoadJob *job);
+  // Finalizes the asset of a loaded job (unless aborted) and deletes the job.
+  // Returns false once the time is past `end_time`. Main thread only.
+  bool FinalizeJob(AsyncLoadJob *job, double end_time);
+  // Whether a loaded job can be finalized now, rather than wait for its load
+  // dependencies, or for AsyncAsset::PrepareFinalize(). Main thread only.
+  static bool ReadyToFinalize(AsyncLoadJob *job);
+
+  // Jobs waiting to be loaded. A nullptr tells one worker thread to exit.
+  std::deque<AsyncLoadJob *> queue_;
+  // Jobs waiting to be finalized. The workers push to this without taking the
+  // lock, and only the main thread pops from it, so TryFinalize() never
+  // contends with the workers.
+  MpscQueue done_;
+  // Loaded jobs waiting for their dependencies to finalize. Main thread only.
+  std::vector<AsyncLoadJob *> waiting_;
+  std::atomic<int> num_pending_requests_;
+  int num_worker_threads_;
+  // Uploads loaded assets before they go to done_, if started.
+  AsyncUploader *uploader_;
 #ifdef FPLBASE_BACKEND_SDL
-  // Keep handle to the worker thread around so that we can wait for it to
+  // Keep handles to the worker threads around so that we can wait for them to
   // finish before destroying the class.
-  Thread worker_thread_;
+  std::vector<Thread> worker_threads_;
 
-  // This lock protects ALL state in this class, i.e. the two vectors.
+  // This lock protects queue_.
   Mutex mutex_;
 
-  // Kick-off the worker thread when a new job arrives.
+  // Kick-off the worker threads when a new job arrives.
   Semaphore job_semaphore_;
+
+  // Signalled whenever a job moves to kLoaded, for AbortJob().
+  ConditionVariable loaded_cv_;
 #elif defined(FPLBASE_BACKEND_STDLIB)
-  std::thread worker_thread_;
+  std::vector<std::thread> worker_threads_;
   std::mutex mutex_;
   std::condition_variable job_cv_;
+  // Signalled whenever a job moves to kLoaded, for AbortJob().
+  std::condition_variable loaded_cv_;
 #else
 #error Need to define FPLBASE_BACKEND_XXX
 #endif
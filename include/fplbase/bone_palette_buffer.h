@@ -0,0 +1,102 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_BONE_PALETTE_BUFFER_H
+#define FPLBASE_BONE_PALETTE_BUFFER_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/handles.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_mesh
+/// @{
+
+/// @class BonePaletteBuffer
+/// @brief A uniform buffer holding the bone palettes of many skinned mesh
+/// instances, for shaders on OpenGL ES 3.0 / OpenGL 3.0 and up.
+///
+/// Uniform arrays of bone transforms are limited by
+/// RendererBase::max_vertex_uniform_components(), and are uploaded again each
+/// time the shader is set. A shader that declares the uniform block
+///
+///     layout(std140) uniform BonePalette {
+///       vec4 bone_palette[3 * MAX_BONES];
+///     };
+///
+/// reads its bone transforms from this buffer instead, three vec4s to a bone,
+/// as in the `bone_transforms` uniform. The block can be as large as
+/// GL_MAX_UNIFORM_BLOCK_SIZE (at least 16KB, so 341 bones).
+///
+/// Each frame, Clear() the buffer, Add() each instance's palette, Upload()
+/// it once, and then Renderer::SetBonePalette() before setting the shader
+/// for each draw. Palettes that are added together can be drawn
+/// instanced: instance `i` of a mesh with `n` shader bones can read its
+/// transforms from `bone_palette[3 * (n * gl_InstanceID + bone) + row]`.
+class BonePaletteBuffer {
+ public:
+  BonePaletteBuffer();
+  ~BonePaletteBuffer();
+
+  /// @brief Remove all palettes, to start a new frame. Keeps the GPU buffer.
+  void Clear();
+
+  /// @brief Append bone transforms to the buffer.
+  ///
+  /// @param transforms The shader transforms, from
+  ///        Mesh::GatherShaderTransforms(). One or more palettes.
+  /// @param count The number of transforms.
+  /// @return Returns the byte offset of the first transform, to pass to
+  ///         Renderer::SetBonePalette(). Offsets are aligned for
+  ///         glBindBufferRange.
+  size_t Add(const mathfu::AffineTransform *transforms, size_t count);
+
+  /// @brief Copy all palettes added since Clear() to the GPU, growing the
+  /// buffer if needed. Call once all palettes are added, before rendering.
+  void Upload();
+
+  /// @brief The uniform buffer. Invalid until the first Upload().
+  BufferHandle buffer() const { return buffer_; }
+
+  /// @brief The number of bytes added since Clear().
+  size_t size() const { return staging_.size() * sizeof(mathfu::vec4); }
+
+  /// @brief The GPU memory allocated, in bytes.
+  size_t gpu_memory_size() const { return capacity_; }
+
+  /// @brief The uniform block binding point used for `BonePalette` blocks.
+  static const unsigned int kBinding = 0;
+
+ private:
+  BonePaletteBuffer(const BonePaletteBuffer &);
+  BonePaletteBuffer &operator=(const BonePaletteBuffer &);
+
+  // Three vec4s per transform, padded between palettes for alignment.
+  std::vector<mathfu::vec4_packed> staging_;
+  BufferHandle buffer_;
+  size_t capacity_;
+  // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, in vec4s.
+  size_t alignment_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_BONE_PALETTE_BUFFER_H
@@ -0,0 +1,175 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_COMMAND_LIST_H
+#define FPLBASE_COMMAND_LIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/handles.h"
+#include "fplbase/render_state.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_renderer
+/// @{
+
+class Material;
+class Mesh;
+class RenderTarget;
+class Renderer;
+class Shader;
+
+/// @class CommandList
+/// @brief Draw commands recorded on any thread, to be replayed on the thread
+/// that owns the graphics context.
+///
+/// Recording makes no graphics API calls, so worker threads can each fill
+/// their own list in parallel, doing the scene traversal and uniform packing,
+/// and the render thread then replays the lists in order, only making the
+/// API calls. A list must not be recorded and replayed at the same time.
+///
+/// Commands are packed into one byte stream, with values copied in, so
+/// what's recorded needn't outlive recording. Meshes, shaders, materials and
+/// render targets are referenced, so must stay valid until replayed. Look up
+/// uniform handles with Shader::FindUniform() on the render thread ahead of
+/// time, since that calls the graphics API.
+class CommandList {
+ public:
+  CommandList() : num_bone_transforms_(0), num_bone_dual_quaternions_(0) {}
+
+  /// @brief See Renderer::SetRenderState().
+  void SetRenderState(const RenderState &render_state);
+
+  /// @brief See RenderTarget::SetAsRenderTarget().
+  void SetRenderTarget(const RenderTarget *target);
+
+  /// @brief See Renderer::ClearFrameBuffer().
+  void ClearFrameBuffer(const mathfu::vec4 &color);
+
+  /// @brief See Renderer::ClearDepthBuffer().
+  void ClearDepthBuffer();
+
+  /// @brief See Renderer::set_model_view_projection().
+  void SetModelViewProjection(const mathfu::mat4 &model_view_projection);
+
+  /// @brief See Renderer::set_model().
+  void SetModel(const mathfu::mat4 &model);
+
+  /// @brief See Renderer::set_color().
+  void SetColor(const mathfu::vec4 &color);
+
+  /// @brief See Renderer::set_light_pos().
+  void SetLightPos(const mathfu::vec3 &light_pos);
+
+  /// @brief See Renderer::set_camera_pos().
+  void SetCameraPos(const mathfu::vec3 &camera_pos);
+
+  /// @brief See Renderer::SetBoneTransforms(). The transforms are copied.
+  void SetBoneTransforms(const mathfu::AffineTransform *bone_transforms,
+                         int num_bones);
+
+  /// @brief See Renderer::SetBoneDualQuaternions(). The dual quaternions are
+  /// copied.
+  void SetBoneDualQuaternions(const mathfu::vec4_packed *bone_dual_quaternions,
+                              int num_bones);
+
+  /// @brief See Renderer::SetShader(). Sends the standard uniforms as set by
+  /// the commands before it.
+  void SetShader(const Shader *shader);
+
+  /// @brief See Shader::SetUniform(). Comes after the SetShader() of
+  /// `shader`. The value is copied.
+  void SetUniform(Shader *shader, UniformHandle uniform, const float *value,
+                  size_t num_components);
+
+  /// @brief See Material::Set().
+  void SetMaterial(Material *material);
+
+  /// @brief See Renderer::Render().
+  void Render(Mesh *mesh, bool ignore_material = false, size_t instances = 1,
+              size_t lod = 0);
+
+  /// @brief See Renderer::RenderSubMesh().
+  void RenderSubMesh(Mesh *mesh, size_t submesh, bool ignore_material = false,
+                     size_t instances = 1, size_t lod = 0);
+
+  /// @brief Make the recorded calls, in order. Must be called on the thread
+  /// that owns the graphics context. The list is left as it is, to replay
+  /// again or Clear().
+  void Replay(Renderer &renderer) const;
+
+  /// @brief Forget all commands, keeping the memory for the next recording.
+  void Clear();
+
+  /// @brief Returns true if nothing's been recorded.
+  bool empty() const { return commands_.empty(); }
+
+  /// @brief The size of the recorded commands, in bytes.
+  size_t size() const { return commands_.size(); }
+
+ private:
+  enum Command {
+    kSetRenderState,
+    kSetRenderTarget,
+    kClearFrameBuffer,
+    kClearDepthBuffer,
+    kSetModelViewProjection,
+    kSetModel,
+    kSetColor,
+    kSetLightPos,
+    kSetCameraPos,
+    kSetBoneTransforms,
+    kSetBoneDualQuaternions,
+    kSetShader,
+    kSetUniform,
+    kSetMaterial,
+    kRender,
+    kRenderSubMesh,
+  };
+
+  void Begin(Command command) { Append(static_cast<uint8_t>(command)); }
+
+  template <typename T>
+  void Append(const T &value) {
+    Append(&value, sizeof(value));
+  }
+
+  void Append(const void *data, size_t size) {
+    if (size == 0) return;
+    const size_t offset = commands_.size();
+    commands_.resize(offset + size);
+    memcpy(&commands_[offset], data, size);
+  }
+
+  void AppendMatrix(const mathfu::mat4 &matrix);
+
+  std::vector<uint8_t> commands_;
+  // Totals over the bone commands, so Replay() can unpack each kind into one
+  // array that lasts until it returns.
+  size_t num_bone_transforms_;
+  size_t num_bone_dual_quaternions_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_COMMAND_LIST_H
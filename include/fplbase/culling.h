@@ -0,0 +1,117 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_CULLING_H
+#define FPLBASE_CULLING_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_mesh
+/// @{
+
+class Mesh;
+
+/// @class Frustum
+/// @brief The six clip planes of a view frustum, for testing bounding boxes
+/// against.
+///
+/// The planes are taken straight from the rows of the transform, so boxes
+/// are tested in the transform's input space, without transforming them.
+class Frustum {
+ public:
+  /// @brief Extract the planes of the visible region of clip space.
+  ///
+  /// @param model_view_projection Transforms the boxes that will be tested
+  ///        into clip space.
+  explicit Frustum(const mathfu::mat4 &model_view_projection);
+
+  /// @brief Whether any part of an axis aligned box may be visible.
+  ///
+  /// Conservative: boxes near the frustum's corners may be reported as
+  /// visible when they aren't.
+  ///
+  /// @param min_position The box's minimum corner.
+  /// @param max_position The box's maximum corner.
+  /// @return Returns false if the box is entirely outside one of the planes.
+  bool IntersectsBox(const mathfu::vec3 &min_position,
+                     const mathfu::vec3 &max_position) const {
+    const mathfu::vec4 center((max_position + min_position) * 0.5f, 1.0f);
+    const mathfu::vec4 extent((max_position - min_position) * 0.5f, 0.0f);
+    for (int i = 0; i < kNumPlanes; ++i) {
+      if (mathfu::vec4::DotProduct(planes_[i], center) <
+          -mathfu::vec4::DotProduct(abs_planes_[i], extent)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static const int kNumPlanes = 6;
+
+  MATHFU_DEFINE_CLASS_SIMD_AWARE_NEW_DELETE
+
+ private:
+  mathfu::vec4 planes_[kNumPlanes];
+  // The planes with their components made positive, to project a box's
+  // extent onto each plane's normal with one dot product.
+  mathfu::vec4 abs_planes_[kNumPlanes];
+};
+
+/// @brief A mesh placed in the world, to cull.
+struct CullInstance {
+  CullInstance() : mesh(nullptr), world_transform(nullptr) {}
+  CullInstance(Mesh *mesh, const mathfu::mat4 *world_transform)
+      : mesh(mesh), world_transform(world_transform) {}
+
+  Mesh *mesh;
+  /// Transforms the mesh's vertices into world space.
+  const mathfu::mat4 *world_transform;
+};
+
+/// @brief A submesh that may be visible.
+struct VisibleSubmesh {
+  /// The index of the mesh in the array passed to CullSubmeshes().
+  size_t instance;
+  /// The submesh to pass to Renderer::RenderSubMesh().
+  size_t submesh;
+};
+
+/// @brief Find the submeshes that may be visible.
+///
+/// Tests each mesh's bounds against the view frustum, then the bounds of
+/// each submesh of the meshes that pass. See Mesh::submesh_min_position().
+/// Meshes that aren't loaded yet are skipped.
+///
+/// @param view_projection Transforms world space into clip space.
+/// @param instances The meshes to cull.
+/// @param num_instances The length of `instances`.
+/// @param visible Set to the submeshes that may be visible, in the order of
+///        `instances`.
+/// @return Returns the number of visible submeshes.
+size_t CullSubmeshes(const mathfu::mat4 &view_projection,
+                     const CullInstance *instances, size_t num_instances,
+                     std::vector<VisibleSubmesh> *visible);
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_CULLING_H
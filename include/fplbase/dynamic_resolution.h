@@ -0,0 +1,146 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_DYNAMIC_RESOLUTION_H
+#define FPLBASE_DYNAMIC_RESOLUTION_H
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/render_target.h"
+#include "fplbase/utilities.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+class Renderer;
+
+/// @file
+/// @addtogroup fplbase_render_target
+/// @{
+
+/// @class DynamicResolution
+/// @brief Renders the scene at a resolution that adapts to the GPU's load,
+/// and upscales it to the screen, to hold a steady frame rate.
+///
+/// Each frame, draw the scene between BeginScene() and EndScene(), and pass
+/// the frame's measured GPU time (e.g. GpuProfiler::frame_milliseconds()), or
+/// failing that its frame time, to Update(). When frames take longer than the
+/// target frame time, the scale of the render size is lowered, and when they
+/// have room to spare it's raised again, a step at a time.
+///
+/// On Android, Update() also polls GetThermalStatus() about once a second.
+/// The more the device is throttling, the lower the scale is capped, so a
+/// phone that heats up over a long session renders fewer pixels before it
+/// starts missing frames.
+///
+/// The scene is drawn into the bottom left corner of a render target the size
+/// of the screen, so changing the scale never reallocates it. EndScene()
+/// blits that corner to the screen with linear filtering, which needs
+/// kFeatureLevel30. On lower feature levels the scene is drawn straight to
+/// the screen and the scale stays at 1.
+class DynamicResolution {
+ public:
+  /// @brief The number of seconds between polls of GetThermalStatus().
+  static const double kThermalPollInterval;
+
+  DynamicResolution();
+  ~DynamicResolution();
+
+  /// @brief Sets the frame time to fit the GPU time into, in seconds. 1/60th
+  /// by default.
+  void set_target_frame_time(double seconds) { target_frame_time_ = seconds; }
+  double target_frame_time() const { return target_frame_time_; }
+
+  /// @brief Sets the lowest and highest scale of the render size, relative
+  /// to the screen size. 0.5 and 1 by default.
+  void set_scale_range(float min_scale, float max_scale);
+  float min_scale() const { return min_scale_; }
+  float max_scale() const { return max_scale_; }
+
+  /// @brief Sets the texture and depth formats of the render target.
+  void set_formats(RenderTargetTextureFormat texture_format,
+                   DepthStencilFormat depth_stencil_format) {
+    texture_format_ = texture_format;
+    depth_stencil_format_ = depth_stencil_format;
+  }
+
+  /// @brief Whether Update() polls GetThermalStatus(). True by default.
+  void set_poll_thermal_status(bool poll) { poll_thermal_status_ = poll; }
+
+  /// @brief Sets the thermal status to cap the scale for, e.g. from a
+  /// platform callback when polling is turned off.
+  void set_thermal_status(ThermalStatus status) { thermal_status_ = status; }
+  ThermalStatus thermal_status() const { return thermal_status_; }
+
+  /// @brief Adjust the scale for the next frame.
+  ///
+  /// @param gpu_time The GPU time of a recent frame in seconds, or its frame
+  /// time if the GPU time isn't known. Values of 0 or less are ignored.
+  /// @param now The current time, for the thermal status polls.
+  void Update(double gpu_time, double now);
+
+  /// @brief Make the scaled render target the current render target, and
+  /// set the viewport to the scaled size.
+  ///
+  /// @param renderer The renderer to draw the scene with.
+  void BeginScene(Renderer &renderer);
+
+  /// @brief Upscale the scene drawn since BeginScene() to the screen, and
+  /// leave the screen as the current render target.
+  void EndScene(Renderer &renderer);
+
+  /// @brief The scale of the render size, relative to the screen size.
+  float scale() const { return scale_; }
+
+  /// @brief The highest scale allowed at the current thermal status.
+  float scale_cap() const;
+
+  /// @brief The size the last BeginScene() rendered at.
+  const mathfu::vec2i &render_size() const { return render_size_; }
+
+  /// @brief The render target the scene is drawn into, or nullptr if it is
+  /// drawn straight to the screen.
+  const RenderTarget *render_target() const {
+    return target_.initialized() ? &target_ : nullptr;
+  }
+
+  /// @brief The size of the area of a render target of `screen_size` that
+  /// is drawn into at `scale`, rounded to whole blocks of 8 pixels, so small
+  /// changes in scale don't move the edges of the image every frame.
+  static mathfu::vec2i ScaledSize(const mathfu::vec2i &screen_size,
+                                  float scale);
+
+ private:
+  DynamicResolution(const DynamicResolution &);
+  DynamicResolution &operator=(const DynamicResolution &);
+
+  double target_frame_time_;
+  float min_scale_;
+  float max_scale_;
+  float scale_;
+  // Smoothed ratio of GPU time to the target frame time.
+  double load_;
+  bool poll_thermal_status_;
+  ThermalStatus thermal_status_;
+  double next_thermal_poll_;
+  RenderTargetTextureFormat texture_format_;
+  DepthStencilFormat depth_stencil_format_;
+  RenderTarget target_;
+  mathfu::vec2i render_size_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_DYNAMIC_RESOLUTION_H
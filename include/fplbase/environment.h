@@ -75,6 +75,32 @@ class Environment {
 
   mathfu::vec2i GetViewportSize() const;
 
+  // The display's refresh rate in Hz, or 0 if it isn't known.
+  int GetRefreshRate() const;
+
+  // Present a frame every `interval` vsyncs, where the backend can wait on
+  // vsync in its buffer swap. Returns false if it can't.
+  bool SetSwapInterval(int interval);
+
+  // Make the rendering context current on the calling thread, or if `current`
+  // is false, release it from the calling thread so another thread can make
+  // it current. Returns false if the backend doesn't own a context it can
+  // move between threads.
+  bool MakeContextCurrent(bool current);
+
+  // Create a context that shares objects with the rendering context, for a
+  // worker thread to create textures and buffers on. Call on the thread the
+  // rendering context is current on. Returns nullptr if the backend can't.
+  void *CreateSharedContext();
+
+  // Make `shared_context` current on the calling thread, or if it's nullptr,
+  // release the calling thread's shared context.
+  bool MakeSharedContextCurrent(void *shared_context);
+
+  // Destroy a context from CreateSharedContext(), once it's not current on
+  // any thread.
+  void DestroySharedContext(void *shared_context);
+
   FeatureLevel feature_level() const { return feature_level_; }
 
   const mathfu::vec2i &window_size() const { return window_size_; }
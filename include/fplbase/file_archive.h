@@ -0,0 +1,109 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef FPLBASE_FILE_ARCHIVE_H
+#define FPLBASE_FILE_ARCHIVE_H
+
+#include <stdint.h>
+#include <string>
+
+#include "fplbase/file_utilities.h"
+
+namespace archivedef {
+struct Archive;
+}
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_utilities
+/// @{
+
+/// @class FileArchive
+/// @brief Read-only access to many files packed into a single archive.
+///
+/// Archives are built by archive_pipeline (see `schemas/archive.fbs` for the
+/// layout). The whole archive is mapped into memory with MapFile() when
+/// opened, so loading a file from it costs a binary search and page faults,
+/// rather than opening and reading a file.
+///
+/// To serve all loads from an archive, with the files not in it loaded as
+/// before:
+///
+///     FileArchive archive;
+///     archive.Open("assets.fplarchive");
+///     LoadFileFunction fallback = SetLoadFileFunction(nullptr);
+///     SetLoadFileFunction(archive.CreateLoadFileFunction(fallback));
+///
+/// After Open(), all const methods are safe to call from any thread, e.g.
+/// from the AsyncLoader threads.
+class FileArchive {
+ public:
+  FileArchive();
+
+  /// @brief Unmaps the archive. See Close().
+  ~FileArchive();
+
+  /// @brief Map an archive into memory, closing any archive open before.
+  /// @param[in] filename The archive file to open.
+  /// @return Returns `false` if the archive couldn't be mapped or is invalid.
+  bool Open(const char *filename);
+
+  /// @brief Unmap the archive.
+  /// @note Pointers returned by Find(), and functions created by
+  /// CreateLoadFileFunction(), must no longer be used.
+  void Close();
+
+  /// @brief Whether an archive is open.
+  bool is_open() const { return index_ != nullptr; }
+
+  /// @brief Look up a file in the archive, without copying it.
+  /// @param[in] name The name of the file, as passed to LoadFile().
+  /// @param[out] data Receives a pointer to the file's contents, which stays
+  /// valid until the archive is closed.
+  /// @param[out] size Receives the size of the file, in bytes.
+  /// @return Returns `false` if the file is not in the archive.
+  bool Find(const char *name, const uint8_t **data, size_t *size) const;
+
+  /// @brief Copy a file from the archive into a string.
+  /// @param[in] name The name of the file, as passed to LoadFile().
+  /// @param[out] dest Receives the file's contents.
+  /// @return Returns `false` if the file is not in the archive.
+  bool LoadFile(const char *name, std::string *dest) const;
+
+  /// @brief Create a function for SetLoadFileFunction() that loads files from
+  /// this archive.
+  /// @param[in] fallback Called for files that are not in the archive. May be
+  /// nullptr, to only load files from the archive.
+  /// @return Returns a function that refers to this archive, so the archive
+  /// must stay open for as long as the function is in use.
+  LoadFileFunction CreateLoadFileFunction(
+      const LoadFileFunction &fallback) const;
+
+ private:
+  FileArchive(const FileArchive &);
+  FileArchive &operator=(const FileArchive &);
+
+  const uint8_t *mapping_;
+  int32_t mapping_size_;
+  const archivedef::Archive *index_;
+  const uint8_t *contents_;
+  size_t contents_size_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_FILE_ARCHIVE_H
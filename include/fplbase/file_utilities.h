@@ -15,6 +15,7 @@
 #ifndef FPLBASE_FILE_UTILITIES_H
 #define FPLBASE_FILE_UTILITIES_H
 
+#include <stdint.h>
 #include <functional>
 #include <string>
 
@@ -29,6 +30,11 @@ namespace fplbase {
 typedef std::function<bool(const char *filename, std::string *dest)>
     LoadFileFunction;
 
+/// @brief Called by `ReadFileChunks()` with each chunk of the file read.
+/// @return Return `false` to stop reading.
+typedef std::function<bool(const uint8_t *data, size_t size)>
+    FileChunkFunction;
+
 /// @brief Checks if a file exists.
 /// @param[in] filename A UTF-8 C-string representing the file to check.
 /// @return Returns `true` if the file exists, false otherwise.
@@ -52,6 +58,24 @@ bool LoadFileRaw(const char *filename, std::string *dest);
 /// not present, but can also mean there was a read error).
 bool LoadFile(const char *filename, std::string *dest);
 
+/// @brief Reads a file a chunk at a time, rather than loading all of it.
+/// @details Lets the caller consume the start of a file while the rest is
+/// still being read, without holding all of it in memory. When
+/// `SetLoadFileFunction()` is in use, the file is loaded with `LoadFile()`
+/// instead, and passed on as a single chunk.
+/// @param[in] filename A UTF-8 C-string representing the file to read.
+/// @param[in] chunk_size The most bytes to pass to `chunk_function` at once.
+/// @param[in] chunk_function Called with each chunk, in order.
+/// @return Returns `false` if the file couldn't be read, or if
+/// `chunk_function` stopped reading.
+bool ReadFileChunks(const char *filename, size_t chunk_size,
+                    const FileChunkFunction &chunk_function);
+
+/// @brief Like `ReadFileChunks()`, but always reads from the file system,
+/// ignoring `SetLoadFileFunction()`.
+bool ReadFileChunksRaw(const char *filename, size_t chunk_size,
+                       const FileChunkFunction &chunk_function);
+
 /// @brief Set the function called by `LoadFile()`.
 /// @param[in] load_file_function The function to be used by `LoadFile()` to
 /// read files.
@@ -60,6 +84,70 @@ bool LoadFile(const char *filename, std::string *dest);
 /// @return Returns the function previously set by `LoadFileFunction()`.
 LoadFileFunction SetLoadFileFunction(LoadFileFunction load_file_function);
 
+/// @brief Whether `SetLoadFileFunction()` replaced `LoadFileRaw()`.
+/// @details Files may then come from somewhere other than the file system
+/// (e.g. an archive), so they must not be opened directly.
+/// @return Returns `true` if `LoadFile()` doesn't call `LoadFileRaw()`.
+bool HasCustomLoadFileFunction();
+
+/// @brief The number of calls to `SetLoadFileFunction()` so far.
+/// @details Caches of loaded files compare this to tell when the files may
+/// read differently, e.g. from an archive. Thread-safe.
+uint32_t LoadFileFunctionGeneration();
+
+/// @brief Take a buffer for LoadFile() from the file buffer pool.
+/// @details Buffers returned with `ReleaseFileBuffer()` keep their capacity,
+/// so loading into them again doesn't allocate as long as the file fits.
+/// This keeps streaming assets from churning the heap. Thread-safe.
+/// @note Functions set with `SetLoadFileFunction()` only benefit if they
+/// `assign()` or `resize()` the destination, rather than replacing it.
+/// @param[in] min_capacity Prefer a buffer that can hold this many bytes.
+/// If 0, the largest free buffer is returned.
+/// @return Returns an empty buffer. Never `nullptr`.
+std::string *AcquireFileBuffer(size_t min_capacity = 0);
+
+/// @brief Return a buffer taken with `AcquireFileBuffer()` to the pool.
+/// @details If that puts the pool over its limits, its smallest buffers
+/// are freed.
+/// @param[in] buffer The buffer to return. May be `nullptr`.
+void ReleaseFileBuffer(std::string *buffer);
+
+/// @brief Limit the memory held by free buffers in the file buffer pool.
+/// @param[in] max_buffers The most free buffers to keep.
+/// @param[in] max_bytes The most bytes of capacity to keep in free buffers.
+void SetFileBufferPoolLimits(size_t max_buffers, size_t max_bytes);
+
+/// @class PooledFileBuffer
+/// @brief Holds a buffer from `AcquireFileBuffer()`, and releases it when
+/// destroyed.
+///
+///     PooledFileBuffer file;
+///     if (LoadFile(filename, file.get())) Parse(file->c_str());
+class PooledFileBuffer {
+ public:
+  explicit PooledFileBuffer(size_t min_capacity = 0)
+      : buffer_(AcquireFileBuffer(min_capacity)) {}
+  ~PooledFileBuffer() { ReleaseFileBuffer(buffer_); }
+
+  std::string *get() const { return buffer_; }
+  std::string *operator->() const { return buffer_; }
+  std::string &operator*() const { return *buffer_; }
+
+  /// @brief Stop holding the buffer, so it isn't released on destruction.
+  /// Pass it to `ReleaseFileBuffer()` when done with it instead.
+  std::string *Release() {
+    std::string *buffer = buffer_;
+    buffer_ = nullptr;
+    return buffer;
+  }
+
+ private:
+  PooledFileBuffer(const PooledFileBuffer &);
+  PooledFileBuffer &operator=(const PooledFileBuffer &);
+
+  std::string *buffer_;
+};
+
 /// @brief Save a string to a file, overwriting the existing contents.
 /// @param[in] filename A UTF-8 C-string representing the file to save to.
 /// @param[in] data A const reference to a `std::string` containing the data
@@ -74,8 +162,31 @@ bool SaveFile(const char *filename, const std::string &data);
 /// @param[in] size The size of the `data` array to write to the file specified
 /// by `filename`.
 /// @return Returns `false` if the file could not be written.
+/// @note With `SetWriteBehind()` on, the write is queued instead, so this
+/// returns `true`, and `FlushWrites()` reports whether it failed.
 bool SaveFile(const char *filename, const void *data, size_t size);
 
+/// @brief Like `SaveFile()`, but always writes it now, ignoring
+/// `SetWriteBehind()`.
+bool SaveFileRaw(const char *filename, const void *data, size_t size);
+
+/// @brief Turn write-behind of `SaveFile()`, `SavePreferences()` and
+/// `SavePreference()` on or off.
+/// @details With it on, they copy the data and return, and a background thread
+/// does the write, so saving doesn't stall the frame. Writes to the same file
+/// or key that are still queued are replaced, so only the latest is written.
+/// `LoadFile()`, `LoadPreferences()` and `LoadPreference()` see the queued
+/// data until it's written, but mapping the file doesn't.
+/// Call `FlushWrites()` when the app is paused, since it may be killed
+/// without further notice, and turn it off before shutting down, which writes
+/// whatever is still queued.
+/// @note Don't call this from more than one thread at once.
+void SetWriteBehind(bool enabled);
+
+/// @brief Wait for the writes queued by `SetWriteBehind()` to finish.
+/// @return Returns `false` if any write failed since the last call.
+bool FlushWrites();
+
 /// @brief Search and change to a given directory.
 /// @param binary_dir A C-string corresponding to the current directory
 /// to start searching from.
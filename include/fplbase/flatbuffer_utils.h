@@ -17,6 +17,10 @@
 
 #include "fplbase/config.h"  // Must come first.
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 #include "common_generated.h"
 #include "mathfu/constants.h"
 #include "mathfu/glsl_mappings.h"
@@ -172,6 +176,46 @@ inline mathfu::AffineTransform LoadAffine(const Mat3x4* m) {
 #endif
 }
 
+/// @brief Converts an array of Mat3x4s, e.g. the bone transforms of a mesh.
+///
+/// Works like LoadAffine() on each element, but when the types are
+/// equivalent the whole array is copied at once.
+///
+/// @param m The first of `count` contiguous Flatbuffer Mat3x4s, e.g. from
+///        `reinterpret_cast<const Mat3x4 *>(vector->Data())`.
+/// @param count The number of matrices to convert.
+/// @param out Receives `count` converted matrices.
+inline void LoadAffines(const Mat3x4* m, size_t count,
+                        mathfu::AffineTransform* out) {
+#if FPLBASE_FLATBUFFER_AND_MATHFU_PACKED_TYPES_EQUIVALENT
+  static_assert(sizeof(Mat3x4) == sizeof(mathfu::AffineTransform),
+                "Mat3x4 and AffineTransform must have the same layout.");
+  if (count) memcpy(out, m, count * sizeof(*m));
+#else
+  for (size_t i = 0; i < count; ++i) out[i] = LoadAffine(m + i);
+#endif
+}
+
+/// @brief Copies an array of structs into every `stride` bytes of `dest`,
+/// e.g. one attribute of a non-interleaved mesh into an interleaved vertex
+/// buffer.
+///
+/// Interleave each attribute in turn, advancing `dest` by the attribute's
+/// size, rather than copying vertex by vertex: each pass is then a simple
+/// loop of fixed-size copies the compiler can unroll.
+///
+/// @param src The first of `count` contiguous structs.
+/// @param count The number of structs to copy.
+/// @param stride The byte distance between consecutive structs in `dest`.
+/// @param dest Where the first struct goes.
+template <typename T>
+inline void InterleaveStructs(const T* src, size_t count, size_t stride,
+                              uint8_t* dest) {
+  for (size_t i = 0; i < count; ++i, dest += stride) {
+    memcpy(dest, src + i, sizeof(T));
+  }
+}
+
 /// @}
 }  // namespace fplbase
 
@@ -0,0 +1,119 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_FRAME_PACER_H
+#define FPLBASE_FRAME_PACER_H
+
+#include "fplbase/config.h"  // Must come first.
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_renderer
+/// @{
+
+/// @brief The steady frame rates a FramePacer can hold frames to.
+enum FramePacing {
+  /// Start each frame as soon as the last one is presented.
+  kFramePacingOff = 0,
+  kFramePacing30Hz = 30,
+  kFramePacing60Hz = 60,
+  kFramePacing90Hz = 90,
+};
+
+/// @class FramePacer
+/// @brief Lines up the start of each frame with a vsync.
+///
+/// Fed the times of vsyncs with OnVsync(), it keeps track of the display's
+/// refresh period and phase. BeginFrame() then picks the vsync the next frame
+/// should start on: the next one, or with a FramePacing, the one a whole
+/// number of refresh periods after the last frame start. Holding frames to
+/// the same number of vsyncs each, rather than presenting them whenever
+/// they're ready, keeps frame times from alternating between, e.g., 16ms and
+/// 33ms on a game that can't quite keep 60Hz.
+///
+/// predicted_present_time() is when the frame will reach the screen, which is
+/// the time animation should use to look smooth.
+///
+/// RendererBase keeps one, fed from RendererBase::AdvanceFrame(). Times are in
+/// seconds, on the clock of GetTimeInSeconds().
+class FramePacer {
+ public:
+  FramePacer();
+
+  /// @brief Sets the frame rate to hold frames to.
+  ///
+  /// Rates above the display's refresh rate run at the refresh rate.
+  void set_pacing(FramePacing pacing) { pacing_ = pacing; }
+  FramePacing pacing() const { return pacing_; }
+
+  /// @brief Sets how many refresh periods after it is submitted a frame
+  /// reaches the screen, on top of the periods it's given to render.
+  /// Depends on the compositor; 1 by default.
+  void set_present_latency(int vsyncs) { present_latency_ = vsyncs; }
+  int present_latency() const { return present_latency_; }
+
+  /// @brief Sets the display's nominal refresh period, if known, for before
+  /// OnVsync() has measured it.
+  void set_vsync_period(double period);
+
+  /// @brief Record that a vsync happened at `time`.
+  ///
+  /// Vsyncs may be skipped, e.g. when only the end of a buffer swap that
+  /// waits for every second vsync is known.
+  void OnVsync(double time);
+
+  /// @brief Choose when the next frame starts.
+  ///
+  /// @param now The current time.
+  /// @return Returns the time of the vsync at which the frame should start.
+  /// If that is later than `now`, the caller should wait until then.
+  double BeginFrame(double now);
+
+  /// @brief Forget the last frame, e.g. after being minimized, so the next
+  /// one starts at the next vsync.
+  void Reset();
+
+  /// @brief The number of refresh periods each frame is held to.
+  int swap_interval() const;
+
+  /// @brief The estimated time between vsyncs.
+  double vsync_period() const { return vsync_period_; }
+
+  /// @brief When the latest vsync passed to OnVsync() happened, or 0.
+  double last_vsync_time() const { return last_vsync_time_; }
+
+  /// @brief The start time chosen by the last BeginFrame().
+  double frame_start_time() const { return frame_start_time_; }
+
+  /// @brief When the frame begun by the last BeginFrame() should be
+  /// presented.
+  double predicted_present_time() const { return predicted_present_time_; }
+
+  /// @brief The refresh period assumed until vsyncs have been seen.
+  static const double kDefaultVsyncPeriod;
+
+ private:
+  FramePacing pacing_;
+  int present_latency_;
+  double vsync_period_;
+  double last_vsync_time_;
+  double frame_start_time_;
+  double predicted_present_time_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_FRAME_PACER_H
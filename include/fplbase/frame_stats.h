@@ -0,0 +1,131 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_FRAME_STATS_H
+#define FPLBASE_FRAME_STATS_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_renderer
+/// @{
+
+/// @class FrameStats
+/// @brief Frame time statistics over a window of recent frames.
+///
+/// RendererBase keeps one, fed from each RendererBase::AdvanceFrame(): the
+/// frame time is the time between the ends of consecutive buffer swaps, and
+/// the swap time is how long the swap itself took, which is mostly waiting on
+/// the GPU or vsync.
+///
+/// Times are in seconds.
+class FrameStats {
+ public:
+  /// @brief Statistics of the frames in the window.
+  struct Summary {
+    Summary()
+        : num_frames(0),
+          average(0),
+          minimum(0),
+          maximum(0),
+          p50(0),
+          p95(0),
+          p99(0),
+          average_swap(0),
+          p95_swap(0),
+          jank_frames(0) {}
+    /// @brief The number of frames in the window.
+    size_t num_frames;
+    /// @brief Frame time.
+    double average;
+    double minimum;
+    double maximum;
+    double p50;
+    double p95;
+    double p99;
+    /// @brief Time spent in the swap.
+    double average_swap;
+    double p95_swap;
+    /// @brief The number of frames longer than jank_threshold().
+    size_t jank_frames;
+  };
+
+  /// @param window The number of most recent frames to keep.
+  explicit FrameStats(size_t window = kDefaultWindow);
+
+  /// @brief Record a frame.
+  ///
+  /// @param frame_time The time since the previous frame.
+  /// @param swap_time The part of it spent swapping buffers.
+  void AddFrame(double frame_time, double swap_time);
+
+  /// @brief Forget all frames, including the totals.
+  void Reset();
+
+  /// @brief The frame time at `percentile` (0 to 100) of the window, by
+  /// nearest rank, or 0 if there are no frames.
+  double FramePercentile(double percentile) const;
+
+  /// @brief The swap time at `percentile` (0 to 100) of the window.
+  double SwapPercentile(double percentile) const;
+
+  /// @brief Statistics of all frames in the window.
+  Summary Summarize() const;
+
+  /// @brief The number of frames in the window.
+  size_t num_frames() const { return frame_times_.size(); }
+
+  /// @brief The most recent frame time, or 0 if there are no frames.
+  double last_frame_time() const;
+
+  /// @brief The number of frames recorded since construction or Reset().
+  size_t total_frames() const { return total_frames_; }
+
+  /// @brief The number of frames longer than jank_threshold() since
+  /// construction or Reset().
+  size_t total_jank_frames() const { return total_jank_frames_; }
+
+  /// @brief Frames longer than this count as jank. Defaults to 1.5 frames at
+  /// 60Hz, i.e. frames that missed a vsync.
+  double jank_threshold() const { return jank_threshold_; }
+  void set_jank_threshold(double seconds) { jank_threshold_ = seconds; }
+
+  /// @brief The default window, about two seconds at 60Hz.
+  static const size_t kDefaultWindow = 128;
+
+ private:
+  static double Percentile(const std::vector<double> &samples,
+                           std::vector<double> *sorted, double percentile);
+
+  size_t window_;
+  // Ring buffers of the most recent frames, oldest at `next_` once full.
+  std::vector<double> frame_times_;
+  std::vector<double> swap_times_;
+  size_t next_;
+  size_t total_frames_;
+  size_t total_jank_frames_;
+  double jank_threshold_;
+  // Sorted copies, so that queries don't allocate.
+  mutable std::vector<double> sorted_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_FRAME_STATS_H
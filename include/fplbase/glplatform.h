@@ -75,6 +75,8 @@
 #        define GLBASEEXTS                                                     \
          GLEXT(PFNGLACTIVETEXTUREARBPROC, glActiveTexture, true)               \
          GLEXT(PFNGLCOMPRESSEDTEXIMAGE2DPROC, glCompressedTexImage2D, true)    \
+         GLEXT(PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC, glCompressedTexSubImage2D,    \
+               true)                                                           \
          GLEXT(PFNGLBINDSAMPLERPROC, glBindSampler, true)
 #      else   // !defined(_WIN32)
 #        define GLBASEEXTS
@@ -148,6 +150,8 @@
        GLEXT(PFNGLGENERATEMIPMAPEXTPROC, glGenerateMipmap, true)               \
        GLEXT(PFNGLGETATTRIBLOCATIONPROC, glGetAttribLocation, true)            \
        GLEXT(PFNGLDRAWELEMENTSINSTANCEDPROC, glDrawElementsInstanced, true)    \
+       GLEXT(PFNGLDRAWARRAYSINSTANCEDPROC, glDrawArraysInstanced, true)        \
+       GLEXT(PFNGLVERTEXATTRIBDIVISORPROC, glVertexAttribDivisor, true)        \
        GLEXT(PFNGLGENVERTEXARRAYSPROC, glGenVertexArrays, true)                \
        GLEXT(PFNGLDELETEVERTEXARRAYSPROC, glDeleteVertexArrays, true)          \
        GLEXT(PFNGLBINDVERTEXARRAYPROC, glBindVertexArray, true)                \
@@ -158,7 +162,30 @@
        GLEXT(PFNGLGETACTIVEUNIFORMBLOCKIVPROC, glGetActiveUniformBlockiv, true)\
        GLEXT(PFNGLGETACTIVEUNIFORMBLOCKNAMEPROC, glGetActiveUniformBlockName,  \
              true)                                                             \
-       GLEXT(PFNGLBINDBUFFERBASEPROC, glBindBufferBase, true)
+       GLEXT(PFNGLBINDBUFFERBASEPROC, glBindBufferBase, true)                  \
+       GLEXT(PFNGLBINDBUFFERRANGEPROC, glBindBufferRange, true)                \
+       GLEXT(PFNGLMAPBUFFERRANGEPROC, glMapBufferRange, true)                  \
+       GLEXT(PFNGLTEXSTORAGE2DPROC, glTexStorage2D, false)                     \
+       GLEXT(PFNGLTEXSTORAGE3DPROC, glTexStorage3D, false)                     \
+       GLEXT(PFNGLINVALIDATEFRAMEBUFFERPROC, glInvalidateFramebuffer, false)   \
+       GLEXT(PFNGLBLITFRAMEBUFFERPROC, glBlitFramebuffer, false)               \
+       GLEXT(PFNGLRENDERBUFFERSTORAGEMULTISAMPLEPROC,                          \
+             glRenderbufferStorageMultisample, false)                          \
+       GLEXT(PFNGLGETPROGRAMBINARYPROC, glGetProgramBinary, false)             \
+       GLEXT(PFNGLPROGRAMBINARYPROC, glProgramBinary, false)                   \
+       GLEXT(PFNGLPROGRAMPARAMETERIPROC, glProgramParameteri, false)           \
+       GLEXT(PFNGLMULTIDRAWELEMENTSINDIRECTPROC, glMultiDrawElementsIndirect,  \
+             false)                                                            \
+       GLEXT(PFNGLGENQUERIESPROC, glGenQueries, false)                         \
+       GLEXT(PFNGLDELETEQUERIESPROC, glDeleteQueries, false)                   \
+       GLEXT(PFNGLGETQUERYOBJECTUIVPROC, glGetQueryObjectuiv, false)           \
+       GLEXT(PFNGLBEGINQUERYPROC, glBeginQuery, false)                         \
+       GLEXT(PFNGLENDQUERYPROC, glEndQuery, false)                             \
+       GLEXT(PFNGLQUERYCOUNTERPROC, glQueryCounter, false)                     \
+       GLEXT(PFNGLGETQUERYOBJECTUI64VPROC, glGetQueryObjectui64v, false)       \
+       GLEXT(PFNGLFENCESYNCPROC, glFenceSync, false)                           \
+       GLEXT(PFNGLCLIENTWAITSYNCPROC, glClientWaitSync, false)                 \
+       GLEXT(PFNGLDELETESYNCPROC, glDeleteSync, false)
 
 // TODO(jsanmiya): Get this compiling for all versions of OpenGL. Currently only
 //                 valid when GL_VERSION_4_3 is defined.
@@ -200,6 +227,14 @@
 #  define glPopGroupMarker glPopGroupMarkerEXT
 #endif  // PLATFORM_OSX
 
+// glMultiDrawElementsIndirect (OpenGL 4.3) is only declared by the desktop
+// OpenGL headers.
+#if !defined(FPLBASE_GLES) && !defined(__APPLE__)
+#  define FPLBASE_GL_MULTI_DRAW_INDIRECT 1
+#else
+#  define FPLBASE_GL_MULTI_DRAW_INDIRECT 0
+#endif
+
 // Define a GL_CALL macro to wrap each (void-returning) OpenGL call.
 // This logs GL error when LOG_GL_ERRORS below is defined.
 #if defined(_DEBUG) || DEBUG == 1 || !defined(NDEBUG)
@@ -326,6 +361,12 @@ extern void LogGLError(const char *file, int line, const char *call);
 #ifndef GL_UNIFORM_BUFFER
 #  define GL_UNIFORM_BUFFER 0x8A11
 #endif
+#ifndef GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+#  define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#endif
+#ifndef GL_UNIFORM_BLOCK_DATA_SIZE
+#  define GL_UNIFORM_BLOCK_DATA_SIZE 0x8A40
+#endif
 #ifndef GL_DEPTH_BITS
 #  define GL_DEPTH_BITS 0x0D56
 #endif
@@ -335,5 +376,14 @@ extern void LogGLError(const char *file, int line, const char *call);
 #ifndef GL_LUMINANCE_ALPHA
 #  define GL_LUMINANCE_ALPHA 0x190A
 #endif
+#ifndef GL_HALF_FLOAT
+#  define GL_HALF_FLOAT 0x140B
+#endif
+#ifndef GL_INT_2_10_10_10_REV
+#  define GL_INT_2_10_10_10_REV 0x8D9F
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#  define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 #endif  // FPLBASE_GLPLATFORM_H
@@ -21,10 +21,37 @@ namespace fplbase {
 
 /// @brief: Validates that the current GPU state matches a given render state.
 ///
-/// In debug this function will throw assets if the present state does not match
-/// the expected render state. In release no checks will occur.
+/// Each mismatch is logged, naming the state and its expected and actual
+/// values. In debug this function will also assert on the first mismatch.
 bool ValidateRenderState(const RenderState& render_state);
 
+/// @brief: Validates that the current GPU state matches a given render state,
+/// like above, but only asserts if `assert_on_mismatch` is set.
+///
+/// @return true if every state matched.
+bool ValidateRenderState(const RenderState& render_state,
+                         bool assert_on_mismatch);
+
+/// @brief How often Renderer checks the GPU state against its cached
+/// RenderState, see Renderer::set_render_state_validation().
+///
+/// Each check reads the state back from the driver, which stalls it, so
+/// checking everything all the time is too slow to leave on. Sampling keeps
+/// the cost low enough for debug builds on device, while still catching
+/// state that something changed behind the renderer's back.
+struct RenderStateValidation {
+  RenderStateValidation()
+      : frame_interval(0), draw_sample_rate(0.0f), assert_on_mismatch(false) {}
+
+  /// Check at the start of every `frame_interval`th frame. 0 for never.
+  int frame_interval;
+  /// The fraction of draw calls, from 0 to 1, to check right before drawing.
+  /// The draws are picked at random.
+  float draw_sample_rate;
+  /// Whether to assert on a mismatch, or only log it.
+  bool assert_on_mismatch;
+};
+
 }  // namespace fplbase
 
 #endif  // FPLBASE_GPU_DEBUG_H
@@ -0,0 +1,160 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_GPU_PROFILER_H
+#define FPLBASE_GPU_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_renderer
+/// @{
+
+/// @class GpuProfiler
+/// @brief Measures the GPU time of named regions of a frame, with timestamp
+/// queries from GL_ARB_timer_query or GL_EXT_disjoint_timer_query.
+///
+/// Wrap each frame in BeginFrame() and EndFrame(), and each pass or draw
+/// group in PushRegion() and PopRegion() (or a GpuProfileScope). Regions nest,
+/// and also push a debug marker (see debug_markers.h), so they show up in GPU
+/// debuggers too.
+///
+/// The GPU runs a few frames behind, so results are read back kFrameLatency
+/// frames later without waiting: results() is always the most recent frame
+/// whose queries were done. Frames whose results weren't ready by the time
+/// their queries were needed again, or during which the GPU reported a
+/// disjoint event (e.g. a frequency change), are dropped.
+///
+/// Where timer queries aren't supported, everything but the debug markers
+/// does nothing and supported() is false.
+class GpuProfiler {
+ public:
+  /// @brief The GPU time of one region of a completed frame.
+  struct Region {
+    /// @brief The name given to PushRegion().
+    std::string name;
+    /// @brief The number of regions this one is nested in.
+    int depth;
+    /// @brief The GPU time between PushRegion() and PopRegion().
+    double milliseconds;
+  };
+
+  /// @brief Create a profiler. Needs a current GL context.
+  GpuProfiler();
+  ~GpuProfiler();
+
+  /// @brief Whether the GPU supports timer queries.
+  bool supported() const { return supported_; }
+
+  /// @brief Start measuring a frame, and read back the results of the oldest
+  /// frame in flight if they're ready.
+  void BeginFrame();
+
+  /// @brief Finish the frame started with BeginFrame(). All regions must have
+  /// been popped.
+  void EndFrame();
+
+  /// @brief Start a region of the current frame.
+  ///
+  /// @param name The name to report it under. Copied.
+  void PushRegion(const char *name);
+
+  /// @brief End the most recently pushed region.
+  void PopRegion();
+
+  /// @brief The regions of the most recent completed frame, in the order they
+  /// were pushed.
+  const std::vector<Region> &results() const { return results_; }
+
+  /// @brief The GPU time of the most recent completed frame, from BeginFrame()
+  /// to EndFrame().
+  double frame_milliseconds() const { return frame_milliseconds_; }
+
+  /// @brief The number of frames whose results were dropped.
+  size_t dropped_frames() const { return dropped_frames_; }
+
+  /// @brief A line per region of results(), like "  shadows: 1.25 ms",
+  /// indented by depth.
+  std::string Report() const;
+
+  /// @brief The number of frames measured before their results are read.
+  static const int kFrameLatency = 3;
+
+ private:
+  GpuProfiler(const GpuProfiler &);
+  GpuProfiler &operator=(const GpuProfiler &);
+
+  struct PendingRegion {
+    std::string name;
+    int depth;
+    // Indices of the push and pop timestamps in Frame::queries.
+    size_t begin;
+    size_t end;
+  };
+
+  // A frame in flight. Timestamp 0 is at BeginFrame(), the last at
+  // EndFrame().
+  struct Frame {
+    Frame() : used(0), pending(false) {}
+    std::vector<unsigned int> queries;
+    size_t used;
+    std::vector<PendingRegion> regions;
+    bool pending;
+  };
+
+  // Issue a timestamp query in the current frame, returning its index.
+  size_t Timestamp();
+  // Read `frame`'s results into results_ if they're all available.
+  bool ReadBack(Frame *frame);
+
+  bool supported_;
+  Frame frames_[kFrameLatency + 1];
+  size_t current_;
+  bool in_frame_;
+  // Indices into the current frame's regions of those not popped yet.
+  std::vector<size_t> open_regions_;
+  std::vector<Region> results_;
+  std::vector<uint64_t> timestamps_;
+  double frame_milliseconds_;
+  size_t dropped_frames_;
+};
+
+/// @class GpuProfileScope
+/// @brief Pushes a GpuProfiler region for the lifetime of the object.
+class GpuProfileScope {
+ public:
+  GpuProfileScope(GpuProfiler *profiler, const char *name)
+      : profiler_(profiler) {
+    profiler_->PushRegion(name);
+  }
+  ~GpuProfileScope() { profiler_->PopRegion(); }
+
+ private:
+  GpuProfileScope(const GpuProfileScope &);
+  GpuProfileScope &operator=(const GpuProfileScope &);
+
+  GpuProfiler *profiler_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_GPU_PROFILER_H
@@ -17,7 +17,6 @@
 
 #include <functional>
 #include <map>
-#include <queue>
 #include <string>
 #include <vector>
 
@@ -31,13 +30,14 @@
 #include <jni.h>
 #endif
 
+#include "fplbase/internal/spsc_queue.h"
+
 #if !defined(ANDROID_GAMEPAD) && defined(__ANDROID__) && \
     !defined(FPLBASE_BACKEND_STDLIB)
 // Enable the android gamepad code.  It receives input events from java, via
 // JNI, and creates a local representation of the state of any connected
 // gamepads.  Also enables the gamepad_controller controller class.
 #define ANDROID_GAMEPAD 1
-#include "pthread.h"
 #endif  // !defined(ANDROID_GAMEPAD) && defined(__ANDROID__)
 
 namespace fplbase {
@@ -261,7 +261,9 @@ class Gamepad {
   };
 
   /// @brief Default constructor for a Gamepad.
-  Gamepad() { button_list_.resize(Gamepad::kControlCount); }
+  Gamepad() : last_event_time_(0.0) {
+    button_list_.resize(Gamepad::kControlCount);
+  }
 
   /// @brief Advances the internal state by one frame.
   ///
@@ -295,12 +297,23 @@ class Gamepad {
     controller_id_ = controller_id;
   }
 
+  /// @brief When the latest event from this gamepad was received from java,
+  /// on the clock of InputSystem::RealTime(), or 0 if there hasn't been one.
+  ///
+  /// Events are applied once per frame, so this can be earlier than the
+  /// start of the frame they're seen in.
+  double last_event_time() const { return last_event_time_; }
+
+  /// @brief Set when the latest event from this gamepad was received.
+  void set_last_event_time(double time) { last_event_time_ = time; }
+
   /// @brief Internal function for translating android input.
   static int GetGamepadCodeFromJavaKeyCode(int java_keycode);
 
  private:
   AndroidInputDeviceId controller_id_;
   std::vector<Button> button_list_;
+  double last_event_time_;
 };
 
 // Threshold for when we register a hat direction.  (The range is [0, 1]
@@ -317,13 +330,17 @@ struct AndroidInputEvent {
   /// @param[in] control_code_ The control code for the gamepad event.
   /// @param[in] x_ The x position of the event.
   /// @param[in] y_ The y position for the event.
+  /// @param[in] timestamp_ When the event was received, in
+  /// SDL_GetPerformanceCounter() ticks.
   AndroidInputEvent(AndroidInputDeviceId device_id_, int event_code_,
-                    int control_code_, float x_, float y_)
+                    int control_code_, float x_, float y_,
+                    uint64_t timestamp_)
       : device_id(device_id_),
         event_code(event_code_),
         control_code(control_code_),
         x(x_),
-        y(y_) {}
+        y(y_),
+        timestamp(timestamp_) {}
   /// @brief The device ID of the Android device.
   AndroidInputDeviceId device_id;
   /// @brief The event code.
@@ -334,6 +351,9 @@ struct AndroidInputEvent {
   float x;
   /// @brief The `y` coordinate for the event.
   float y;
+  /// @brief When the event was received from java, in
+  /// SDL_GetPerformanceCounter() ticks.
+  uint64_t timestamp;
 };
 #endif  // ANDROID_GAMEPAD
 
@@ -541,6 +561,68 @@ struct TextInputEvent {
                  int32_t length);
 };
 
+/// @brief The kinds of InputEvent.
+enum InputEventType {
+  /// A key or pointer button went down. `code` is its keycode or K_POINTER*.
+  kInputEventButtonDown,
+  /// A key or pointer button went up. `code` is its keycode or K_POINTER*.
+  kInputEventButtonUp,
+  /// A pointer moved. `code` is its K_POINTER*, `device` its index, and
+  /// `x`, `y` its position in pixels.
+  kInputEventPointerMotion,
+  /// The mouse wheel turned by `x`, `y`.
+  kInputEventMouseWheel,
+  /// Button `code` of joystick `device` went down.
+  kInputEventJoystickButtonDown,
+  /// Button `code` of joystick `device` went up.
+  kInputEventJoystickButtonUp,
+  /// Axis `code` of joystick `device` moved to `x`, in [-1, 1].
+  kInputEventJoystickAxis,
+  /// Hat `code` of joystick `device` moved to direction `x`, `y`.
+  kInputEventJoystickHat,
+  /// Gamepad::GamepadInputButton `code` of gamepad `device` went down.
+  kInputEventGamepadButtonDown,
+  /// Gamepad::GamepadInputButton `code` of gamepad `device` went up.
+  kInputEventGamepadButtonUp,
+};
+
+/// @brief One input event, with the time the OS gave it.
+///
+/// Unlike the Button states, which only say what happened since the last
+/// frame, these keep every change, in order, e.g. each of several presses of
+/// the same key within one frame. See InputSystem::input_events().
+struct InputEvent {
+  InputEvent()
+      : type(kInputEventButtonDown),
+        time(0.0),
+        code(0),
+        device(0),
+        x(0.0f),
+        y(0.0f) {}
+  InputEvent(InputEventType type_, double time_, int code_, uint64_t device_,
+             float x_, float y_)
+      : type(type_),
+        time(time_),
+        code(code_),
+        device(device_),
+        x(x_),
+        y(y_) {}
+
+  /// @brief What happened. Says what the other fields mean.
+  InputEventType type;
+  /// @brief When it happened, on the clock of InputSystem::RealTime(), as
+  /// precisely as the OS timestamps it. Usually before the frame that sees
+  /// it.
+  double time;
+  /// @brief The button, axis or hat that changed.
+  int code;
+  /// @brief The pointer, joystick or gamepad it changed on.
+  uint64_t device;
+  /// @brief The new position or value.
+  float x;
+  float y;
+};
+
 /// @class InputSystem
 /// @brief Use to handle time, touch/mouse/keyboard/etc input, and lifecyle
 ///        events.
@@ -641,8 +723,12 @@ class InputSystem {
     return gamepad_map_;
   }
 
-  /// @brief Receives events from java, and stuffs them into a vector until
-  /// we're ready.
+  /// @brief Receives events from java, and queues them until the next
+  /// HandleGamepadEvents().
+  ///
+  /// Never blocks: the events go in a lock-free queue, which only one thread
+  /// (the java UI thread) may push to. Events that arrive while the queue is
+  /// full are dropped.
   static void ReceiveGamepadEvent(int controller_id, int event_code,
                                   int control_code, float x, float y);
 
@@ -718,6 +804,60 @@ class InputSystem {
   /// @brief Accumulated mousewheel delta since the previous frame.
   mathfu::vec2i mousewheel_delta() { return mousewheel_delta_; }
 
+  /// @brief The input events processed by the last AdvanceFrame(), oldest
+  /// first.
+  ///
+  /// The same events drive the Button, pointer and joystick states, which
+  /// hold only their effect on the frame. Use these to react to every change
+  /// in order, at the time it happened, e.g. to judge rhythm game timing or
+  /// to catch presses shorter than a frame.
+  const std::vector<InputEvent> &input_events() const { return input_events_; }
+
+  /// @brief Start recording the input of each frame, to save to `filename`.
+  ///
+  /// Every AdvanceFrame() from now on records its input_events(), pointer
+  /// states, mousewheel delta and DeltaTime(), for StartInputReplay() to
+  /// play back later, e.g. to run the exact same session on two builds and
+  /// compare their frame times. The recording is kept in memory until
+  /// StopInputRecording(), or the InputSystem is destroyed, so recording
+  /// doesn't disturb the frame times it records.
+  ///
+  /// @param[in] filename The file StopInputRecording() will write.
+  void StartInputRecording(const char *filename);
+
+  /// @brief Stop recording, and write the recording to its file.
+  /// @return Returns false if the file could not be written.
+  bool StopInputRecording();
+
+  /// @brief Checks if StartInputRecording() is recording input.
+  bool IsRecordingInput() const { return !record_filename_.empty(); }
+
+  /// @brief Play back a recording made with StartInputRecording().
+  ///
+  /// From the next AdvanceFrame() on, each frame takes its input from the
+  /// recording instead of the input devices, which are ignored, until the
+  /// recording runs out. System events, such as quitting or resizing
+  /// the window, still come from the OS. Pointer positions are replayed as
+  /// they were recorded, so use the same window size.
+  ///
+  /// Time() and DeltaTime() advance by the recorded DeltaTime() of each
+  /// frame, or by `fixed_delta_time` if that's not 0, however long the frame
+  /// actually takes. So a replay drives the same game logic every time it's
+  /// run, while RealTime() measures how fast it runs. Once the replay ends,
+  /// Time() resumes following RealTime().
+  ///
+  /// @param[in] filename A file written by StopInputRecording().
+  /// @param[in] fixed_delta_time The DeltaTime() of every replayed frame, in
+  /// seconds, or 0 to replay the recorded ones.
+  /// @return Returns false if the file can't be loaded or isn't a recording.
+  bool StartInputReplay(const char *filename, double fixed_delta_time = 0.0);
+
+  /// @brief Stop a replay before it runs out, and go back to device input.
+  void StopInputReplay();
+
+  /// @brief Checks if StartInputReplay() is playing back input.
+  bool IsReplayingInput() const { return !replay_data_.empty(); }
+
   /// @brief Start/Stop recording text input events.
   ///
   /// Recorded event can be retrieved by GetTextInputEvents().
@@ -795,13 +935,60 @@ class InputSystem {
   void RemovePointer(size_t i);
   mathfu::vec2 ConvertHatToVector(uint32_t hat_enum) const;
   std::vector<AppEventCallback> app_event_callbacks_;
-  std::map<int, Button> button_map_;
+  // Record an event for input_events().
+  void AddInputEvent(InputEventType type, double time, int code,
+                     uint64_t device, float x, float y) {
+    input_events_.push_back(InputEvent(type, time, code, device, x, y));
+  }
+
+  // Record an event for pointer `pointer`, at its current position.
+  void AddPointerEvent(InputEventType type, double time, size_t pointer);
+  // Record the joystick `event`, if it changes a button, axis or hat.
+  void AddJoystickEvent(Event event, double time);
+
+  // Apply a recorded event to the button, joystick or gamepad it changed.
+  void ApplyInputEvent(const InputEvent &event);
+  // Append this frame's input to record_data_.
+  void RecordInputFrame();
+  // Replace this frame's input with the next frame of replay_data_, or end the
+  // replay if there are no more.
+  void ReplayInputFrame();
+
+  // Where GetButton() keeps `button` in buttons_, or -1 if it's not one of
+  // the K_* values or keycodes that have a place there.
+  static int ButtonIndex(int button);
+
+  // K_* values, keycodes below 256 and scancode keycodes, see ButtonIndex().
+  static const int kNumNegativeButtons = 32;
+  static const int kNumCharacterButtons = 256;
+  static const int kNumScancodeButtons = 512;
+  static const int kNumIndexedButtons =
+      kNumNegativeButtons + kNumCharacterButtons + kNumScancodeButtons;
+
+  // Looked up directly, rather than in a map, for the buttons that have an
+  // index. Any others are in other_buttons_.
+  Button buttons_[kNumIndexedButtons];
+  std::map<int, Button> other_buttons_;
+  std::vector<InputEvent> input_events_;
   std::map<JoystickId, Joystick> joystick_map_;
 
+  // The file and frames of StartInputRecording(), if recording.
+  std::string record_filename_;
+  std::string record_data_;
+  // The frames of StartInputReplay(), if replaying, and how far into them
+  // it's got.
+  std::string replay_data_;
+  size_t replay_offset_;
+  // StartInputReplay()'s fixed_delta_time, and the time it's got to.
+  double replay_delta_time_;
+  double replay_time_;
+
 #if ANDROID_GAMEPAD
   std::map<AndroidInputDeviceId, Gamepad> gamepad_map_;
-  static pthread_mutex_t android_event_mutex;
-  static std::queue<AndroidInputEvent> unhandled_java_input_events_;
+  // Pushed to by the java UI thread, popped by HandleGamepadEvents().
+  static const size_t kMaxAndroidEvents = 128;
+  static SpscQueue<AndroidInputEvent, kMaxAndroidEvents>
+      unhandled_java_input_events_;
 #endif  // ANDROID_GAMEPAD
 
 #if FPLBASE_ANDROID_VR
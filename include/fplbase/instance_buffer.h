@@ -0,0 +1,121 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_INSTANCE_BUFFER_H
+#define FPLBASE_INSTANCE_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/handles.h"
+#include "fplbase/mesh.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_mesh
+/// @{
+
+/// @class InstanceBuffer
+/// @brief A vertex buffer of per-instance attributes, for drawing many
+/// instances of a mesh in one call with Renderer::Render(). Needs OpenGL ES
+/// 3.0 / OpenGL 3.3.
+///
+/// The format is a kEND terminated list of per-instance attributes, laid out
+/// in order like a vertex format. For example, with the format
+/// `{kInstanceTransform3x4f, kInstanceColor4ub, kEND}` each instance is
+///
+///     struct Instance {
+///       float transform[12];  // Rows of the object-to-world transform.
+///       uint8_t color[4];
+///     };
+///
+/// and a vertex shader declares the attributes it uses:
+///
+///     attribute vec4 aInstanceTransform0;
+///     attribute vec4 aInstanceTransform1;
+///     attribute vec4 aInstanceTransform2;
+///     attribute vec4 aInstanceColor;
+///
+/// See shaders/fplbase/instancing.glslv_h.
+///
+/// Each frame, Clear() the buffer, Add() the visible instances, Upload() it
+/// once, and then render each mesh that uses it.
+class InstanceBuffer {
+ public:
+  /// @brief Create an empty buffer.
+  ///
+  /// @param format The per-instance attributes, terminated with kEND. Must
+  ///        pass Mesh::IsValidInstanceFormat().
+  explicit InstanceBuffer(const Attribute *format);
+  ~InstanceBuffer();
+
+  /// @brief Remove all instances, to start a new frame. Keeps the GPU buffer.
+  void Clear();
+
+  /// @brief Append instances to the buffer.
+  ///
+  /// @param data `count` instances of instance_size() bytes each, laid out
+  ///        as described by format().
+  /// @param count The number of instances.
+  /// @return Returns the index of the first instance added.
+  size_t Add(const void *data, size_t count);
+
+  /// @brief Append uninitialized instances, to be filled in before Upload().
+  ///
+  /// @param count The number of instances.
+  /// @return Returns the first instance added. Valid until the next call that
+  ///         adds instances.
+  void *Add(size_t count);
+
+  /// @brief Copy all instances added since Clear() to the GPU, growing the
+  /// buffer if needed. Call once all instances are added, before rendering.
+  void Upload();
+
+  /// @brief The vertex buffer. Invalid until the first Upload().
+  BufferHandle buffer() const { return buffer_; }
+
+  /// @brief The per-instance attributes, terminated with kEND.
+  const Attribute *format() const { return format_; }
+
+  /// @brief The byte size of one instance.
+  size_t instance_size() const { return instance_size_; }
+
+  /// @brief The number of instances added since Clear().
+  size_t count() const { return staging_.size() / instance_size_; }
+
+  /// @brief The GPU memory allocated, in bytes.
+  size_t gpu_memory_size() const { return capacity_; }
+
+  /// @brief The most attributes a format can have, including kEND.
+  static const int kMaxAttributes = 4;
+
+ private:
+  InstanceBuffer(const InstanceBuffer &);
+  InstanceBuffer &operator=(const InstanceBuffer &);
+
+  Attribute format_[kMaxAttributes];
+  size_t instance_size_;
+  std::vector<uint8_t> staging_;
+  BufferHandle buffer_;
+  size_t capacity_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_INSTANCE_BUFFER_H
@@ -0,0 +1,143 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_ASSET_MAP_H
+#define FPLBASE_ASSET_MAP_H
+
+#include <assert.h>
+#include <string>
+#include <vector>
+
+#include "fplbase/asset_id.h"
+
+namespace fplbase {
+
+// Flat, open addressing hash map from AssetId to asset pointer, used by the
+// AssetManager. Lookups hash the name once (or not at all, given an AssetId)
+// and probe a contiguous array, instead of walking a tree of strings.
+// The name of each asset is kept only to detect hash collisions and for
+// debugging.
+template <typename T>
+class AssetMap {
+ public:
+  AssetMap() : size_(0) {}
+
+  // Returns the asset with the given id, or nullptr if there's none.
+  T *Find(const AssetId &id) const {
+    if (!id.valid() || slots_.empty()) return nullptr;
+    for (size_t i = Home(id.hash());; i = Next(i)) {
+      const Slot &slot = slots_[i];
+      if (slot.hash == id.hash()) return slot.asset;
+      if (slot.hash == 0) return nullptr;
+    }
+  }
+
+  // Adds `asset` under `name`, replacing any asset already stored there.
+  void Insert(const AssetId &id, const std::string &name, T *asset) {
+    assert(id.valid());
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+      Rehash(slots_.empty() ? kMinSlots : slots_.size() * 2);
+    }
+    size_t i = Home(id.hash());
+    while (slots_[i].hash != 0 && slots_[i].hash != id.hash()) i = Next(i);
+    Slot &slot = slots_[i];
+    if (slot.hash == 0) {
+      ++size_;
+    } else {
+      // Two different names with the same 64-bit hash would map to the same
+      // asset. Vanishingly unlikely, but catch it in debug builds.
+      assert(slot.name == name);
+    }
+    slot.hash = id.hash();
+    slot.asset = asset;
+    slot.name = name;
+  }
+
+  // Removes the asset with the given id. Returns false if there was none.
+  bool Erase(const AssetId &id) {
+    if (!id.valid() || slots_.empty()) return false;
+    size_t i = Home(id.hash());
+    while (slots_[i].hash != id.hash()) {
+      if (slots_[i].hash == 0) return false;
+      i = Next(i);
+    }
+    // Backward shift deletion: move later entries of the probe sequence into
+    // the hole, so lookups never need tombstones.
+    for (size_t j = Next(i);; j = Next(j)) {
+      if (slots_[j].hash == 0) break;
+      const size_t home = Home(slots_[j].hash);
+      // Move slot j into i if i lies cyclically in [home, j).
+      const bool movable = i <= j ? (home <= i || home > j)
+                                  : (home <= i && home > j);
+      if (movable) {
+        slots_[i] = slots_[j];
+        i = j;
+      }
+    }
+    slots_[i] = Slot();
+    --size_;
+    return true;
+  }
+
+  void Clear() {
+    slots_.clear();
+    size_ = 0;
+  }
+
+  size_t size() const { return size_; }
+
+  // Calls `func(const std::string &name, T *asset)` for every asset.
+  template <typename F>
+  void ForEach(const F &func) const {
+    for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+      if (it->hash != 0) func(it->name, it->asset);
+    }
+  }
+
+ private:
+  struct Slot {
+    Slot() : hash(0), asset(nullptr) {}
+    uint64_t hash;
+    T *asset;
+    std::string name;
+  };
+
+  static const size_t kMinSlots = 16;
+
+  // slots_.size() is always a power of two.
+  size_t Home(uint64_t hash) const {
+    return static_cast<size_t>(hash) & (slots_.size() - 1);
+  }
+  size_t Next(size_t i) const { return (i + 1) & (slots_.size() - 1); }
+
+  void Rehash(size_t num_slots) {
+    std::vector<Slot> old_slots(num_slots);
+    old_slots.swap(slots_);
+    for (auto it = old_slots.begin(); it != old_slots.end(); ++it) {
+      if (it->hash == 0) continue;
+      size_t i = Home(it->hash);
+      while (slots_[i].hash != 0) i = Next(i);
+      slots_[i].hash = it->hash;
+      slots_[i].asset = it->asset;
+      slots_[i].name.swap(it->name);
+    }
+  }
+
+  std::vector<Slot> slots_;
+  size_t size_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_ASSET_MAP_H
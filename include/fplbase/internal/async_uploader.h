@@ -0,0 +1,79 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_INTERNAL_ASYNC_UPLOADER_H
+#define FPLBASE_INTERNAL_ASYNC_UPLOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "fplbase/config.h"  // Must come first.
+
+namespace fplbase {
+
+class AsyncLoader;
+class Environment;
+struct AsyncLoadJob;
+
+// Calls AsyncAsset::Upload() on a thread of its own, with a GL context shared
+// with the renderer's, so GPU uploads of loaded assets don't take time from
+// the main thread's frames. Internal to AsyncLoader.
+//
+// Jobs stay in AsyncLoadJob::kLoading until they've been uploaded, and are
+// then handed back with AsyncLoader::FinishJob(). Where fences are available,
+// the upload is only known to have completed once UploadComplete() returns
+// true.
+class AsyncUploader {
+ public:
+  AsyncUploader(Environment *environment, AsyncLoader *loader);
+  ~AsyncUploader();
+
+  // Creates the shared context and starts the thread. Returns false if the
+  // environment can't make a shared context, in which case assets are
+  // uploaded by Finalize() on the main thread, as before.
+  bool Start(bool use_fences);
+
+  // Uploads the remaining jobs, then ends the thread and destroys the context.
+  void Stop();
+
+  // Hands a job whose Load() has returned to the upload thread.
+  void Push(AsyncLoadJob *job);
+
+  // Whether the GPU is done with the upload of `job`, if it fenced one.
+  // Releases the fence once it has. Main thread only.
+  static bool UploadComplete(AsyncLoadJob *job);
+
+  // Releases the fence of a job that won't be finalized. Main thread only.
+  static void ReleaseFence(AsyncLoadJob *job);
+
+ private:
+  void UploadWorker();
+  void UploadJob(AsyncLoadJob *job);
+
+  Environment *environment_;
+  AsyncLoader *loader_;
+  void *shared_context_;
+  bool use_fences_;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable job_cv_;
+  // Jobs waiting to be uploaded. A nullptr tells the thread to exit.
+  std::deque<AsyncLoadJob *> queue_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_INTERNAL_ASYNC_UPLOADER_H
@@ -0,0 +1,252 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_BUILD_CACHE_H
+#define FPLBASE_BUILD_CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace fplbase {
+
+// Content-addressed cache for the asset pipelines. Inline, so that
+// mesh_pipeline and shader_pipeline can use it without linking fplbase.
+//
+// A conversion is keyed on a BuildHash of everything that decides its output:
+// the tool, its arguments and the contents of its primary input. Inputs only
+// discovered while converting, like a shader's #includes, are recorded as
+// dependencies of the cache entry, and an entry only hits while each of them
+// still hashes to the recorded value. An entry is a manifest,
+// <dir>/<key>.manifest, plus a copy of each output file, <dir>/<key>.<i>.
+
+// Incremental 64 bit FNV-1a hash.
+class BuildHash {
+ public:
+  BuildHash() : value_(kOffsetBasis) {}
+
+  void Add(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      value_ = (value_ ^ bytes[i]) * kPrime;
+    }
+  }
+
+  // Strings are length prefixed, so that ("ab", "c") and ("a", "bc") differ.
+  void Add(const std::string& s) {
+    AddValue(static_cast<uint64_t>(s.size()));
+    Add(s.data(), s.size());
+  }
+
+  void Add(const char* s) { Add(std::string(s ? s : "")); }
+
+  // For integers, enums, floats and other plain values.
+  template <typename T>
+  void AddValue(const T& value) {
+    Add(&value, sizeof(value));
+  }
+
+  uint64_t value() const { return value_; }
+
+ private:
+  static const uint64_t kOffsetBasis = 0xcbf29ce484222325ULL;
+  static const uint64_t kPrime = 0x100000001b3ULL;
+  uint64_t value_;
+};
+
+inline uint64_t HashBuildContents(const std::string& contents) {
+  BuildHash hash;
+  hash.Add(contents);
+  return hash.value();
+}
+
+inline std::string BuildHashToString(uint64_t value) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(value));
+  return buf;
+}
+
+inline bool ReadBuildFile(const std::string& file_name, std::string* dest) {
+  FILE* file = fopen(file_name.c_str(), "rb");
+  if (file == nullptr) return false;
+  dest->clear();
+  char buf[64 * 1024];
+  size_t read;
+  while ((read = fread(buf, 1, sizeof(buf), file)) > 0) {
+    dest->append(buf, read);
+  }
+  const bool ok = ferror(file) == 0;
+  fclose(file);
+  return ok;
+}
+
+inline bool WriteBuildFile(const std::string& file_name,
+                           const std::string& contents) {
+  FILE* file = fopen(file_name.c_str(), "wb");
+  if (file == nullptr) return false;
+  const bool ok =
+      fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+  return fclose(file) == 0 && ok;
+}
+
+class BuildCache {
+ public:
+  // An empty `dir` disables the cache: Fetch() always misses and Store() does
+  // nothing.
+  explicit BuildCache(const std::string& dir) : dir_(dir) {
+    if (!dir_.empty() && dir_.back() != '/' && dir_.back() != '\\') {
+      dir_ += '/';
+    }
+  }
+
+  bool enabled() const { return !dir_.empty(); }
+
+  // Record an input read during the conversion keyed on `key`, other than
+  // those already hashed into `key`.
+  void AddDependency(const std::string& file_name,
+                     const std::string& contents) {
+    dependencies_.push_back(
+        Dependency(file_name, HashBuildContents(contents)));
+  }
+
+  // Record a file written by the conversion keyed on `key`.
+  void AddOutput(const std::string& file_name) {
+    outputs_.push_back(file_name);
+  }
+
+  // If there's an entry for `key` whose dependencies are unchanged, write its
+  // outputs into place and return true. Outputs that already hold the cached
+  // contents are left alone, so their timestamps don't trigger later build
+  // steps. The restored outputs are appended to `outputs`, if given.
+  bool Fetch(uint64_t key, std::vector<std::string>* outputs = nullptr) const {
+    if (!enabled()) return false;
+    const std::string entry = dir_ + BuildHashToString(key);
+    std::string manifest;
+    if (!ReadBuildFile(entry + ".manifest", &manifest)) return false;
+
+    // Parse "dep <hash> <file>" and "out <file>" lines, after the header.
+    std::vector<std::string> cached_outputs;
+    size_t pos = 0;
+    std::string line;
+    bool header = true;
+    while (NextLine(manifest, &pos, &line)) {
+      if (header) {
+        if (line != kManifestHeader) return false;
+        header = false;
+      } else if (line.compare(0, 4, "dep ") == 0 && line.size() > 21) {
+        std::string contents;
+        if (!ReadBuildFile(line.substr(21), &contents) ||
+            BuildHashToString(HashBuildContents(contents)) !=
+                line.substr(4, 16)) {
+          return false;
+        }
+      } else if (line.compare(0, 4, "out ") == 0) {
+        cached_outputs.push_back(line.substr(4));
+      } else {
+        return false;
+      }
+    }
+    if (header) return false;
+
+    // Read every cached output before writing any, so that a damaged entry
+    // can't leave a mix of old and new outputs behind.
+    std::vector<std::string> contents(cached_outputs.size());
+    for (size_t i = 0; i < cached_outputs.size(); ++i) {
+      if (!ReadBuildFile(entry + '.' + std::to_string(i), &contents[i])) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < cached_outputs.size(); ++i) {
+      std::string existing;
+      if (ReadBuildFile(cached_outputs[i], &existing) &&
+          existing == contents[i]) {
+        continue;
+      }
+      if (!WriteBuildFile(cached_outputs[i], contents[i])) return false;
+    }
+    if (outputs) {
+      outputs->insert(outputs->end(), cached_outputs.begin(),
+                      cached_outputs.end());
+    }
+    return true;
+  }
+
+  // Copy the recorded outputs into the cache as the entry for `key`, along
+  // with the recorded dependencies. The manifest is written last, so an
+  // interrupted Store() leaves no entry rather than a partial one.
+  bool Store(uint64_t key) const {
+    if (!enabled()) return false;
+    MakeDirectory();
+    const std::string entry = dir_ + BuildHashToString(key);
+    std::string manifest = std::string(kManifestHeader) + '\n';
+    for (size_t i = 0; i < dependencies_.size(); ++i) {
+      manifest += "dep " + BuildHashToString(dependencies_[i].hash) + ' ' +
+                  dependencies_[i].file_name + '\n';
+    }
+    for (size_t i = 0; i < outputs_.size(); ++i) {
+      std::string contents;
+      if (!ReadBuildFile(outputs_[i], &contents) ||
+          !WriteBuildFile(entry + '.' + std::to_string(i), contents)) {
+        return false;
+      }
+      manifest += "out " + outputs_[i] + '\n';
+    }
+    return WriteBuildFile(entry + ".manifest", manifest);
+  }
+
+ private:
+  struct Dependency {
+    Dependency(const std::string& file_name, uint64_t hash)
+        : file_name(file_name), hash(hash) {}
+    std::string file_name;
+    uint64_t hash;
+  };
+
+  static bool NextLine(const std::string& s, size_t* pos, std::string* line) {
+    if (*pos >= s.size()) return false;
+    size_t end = s.find('\n', *pos);
+    if (end == std::string::npos) end = s.size();
+    line->assign(s, *pos, end - *pos);
+    *pos = end + 1;
+    return true;
+  }
+
+  // Only creates the last directory of the path; its parent must exist.
+  void MakeDirectory() const {
+    const std::string dir = dir_.substr(0, dir_.size() - 1);
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+  }
+
+  static constexpr const char* kManifestHeader = "fplbase-build-cache 1";
+
+  std::string dir_;
+  std::vector<Dependency> dependencies_;
+  std::vector<std::string> outputs_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_BUILD_CACHE_H
@@ -227,13 +227,58 @@ inline bool operator!=(const DepthState &lhs, const DepthState &rhs) {
 }
 
 inline bool operator==(const CullState &lhs, const CullState &rhs) {
-  return lhs.enabled == rhs.enabled && lhs.face == rhs.face;
+  return lhs.enabled == rhs.enabled && lhs.face == rhs.face &&
+         lhs.front == rhs.front;
 }
 
 inline bool operator!=(const CullState &lhs, const CullState &rhs) {
   return !(lhs == rhs);
 }
 
+inline bool operator==(const AlphaTestState &lhs, const AlphaTestState &rhs) {
+  return lhs.enabled == rhs.enabled && lhs.function == rhs.function &&
+         lhs.ref == rhs.ref;
+}
+
+inline bool operator!=(const AlphaTestState &lhs, const AlphaTestState &rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator==(const BlendState &lhs, const BlendState &rhs) {
+  return lhs.enabled == rhs.enabled && lhs.src_alpha == rhs.src_alpha &&
+         lhs.src_color == rhs.src_color && lhs.dst_alpha == rhs.dst_alpha &&
+         lhs.dst_color == rhs.dst_color;
+}
+
+inline bool operator!=(const BlendState &lhs, const BlendState &rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator==(const PointState &lhs, const PointState &rhs) {
+  return lhs.point_sprite_enabled == rhs.point_sprite_enabled &&
+         lhs.program_point_size_enabled == rhs.program_point_size_enabled &&
+         lhs.point_size == rhs.point_size;
+}
+
+inline bool operator!=(const PointState &lhs, const PointState &rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator==(const RenderState &lhs, const RenderState &rhs) {
+  return lhs.alpha_test_state == rhs.alpha_test_state &&
+         lhs.blend_state == rhs.blend_state &&
+         lhs.cull_state == rhs.cull_state &&
+         lhs.depth_state == rhs.depth_state &&
+         lhs.point_state == rhs.point_state &&
+         lhs.scissor_state == rhs.scissor_state &&
+         lhs.stencil_state == rhs.stencil_state &&
+         lhs.viewport == rhs.viewport;
+}
+
+inline bool operator!=(const RenderState &lhs, const RenderState &rhs) {
+  return !(lhs == rhs);
+}
+
 }  // namespace fplbase
 
 #endif  // FPLBASE_INTERNAL_RENDER_STATE_H
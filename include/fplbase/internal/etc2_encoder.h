@@ -0,0 +1,54 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_ETC2_ENCODER_H
+#define FPLBASE_ETC2_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace fplbase {
+
+// A fast ETC2 encoder for textures made at runtime, e.g. on the loader
+// thread. Each 4x4 block tries both subblock splits, with each half's
+// average color and the modifier table that fits it best, rather than
+// searching for the best colors, and writes only the modes ETC1 has, which
+// ETC2 decoders read the same way. Alpha is encoded as EAC, searching every
+// modifier table around the block's range. The output is what
+// GL_COMPRESSED_RGB8_ETC2, or with alpha GL_COMPRESSED_RGBA8_ETC2_EAC,
+// expects.
+
+// The size of a `width` x `height` image encoded by EncodeEtc2Image(), in
+// 8-byte blocks of color, each following an 8-byte block of alpha if
+// `alpha`.
+size_t Etc2ImageSize(int width, int height, bool alpha);
+
+// Encodes a `width` x `height` image of `channels` (3 or 4) bytes per pixel,
+// with tightly packed rows, into `dest`, which must have room for
+// Etc2ImageSize() bytes. The alpha of 3 channel images is 255. The edges of
+// images that aren't a multiple of 4 across are repeated to fill the blocks.
+void EncodeEtc2Image(const uint8_t *src, int width, int height, int channels,
+                     bool alpha, uint8_t *dest);
+
+// Encodes the color of a 4x4 block of RGBA pixels, row by row, into an
+// 8-byte ETC2 block.
+void EncodeEtc2Block(const uint8_t *rgba, uint8_t *dest);
+
+// Encodes the alpha of a 4x4 block of RGBA pixels, row by row, into an
+// 8-byte EAC block.
+void EncodeEacAlphaBlock(const uint8_t *rgba, uint8_t *dest);
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_ETC2_ENCODER_H
@@ -0,0 +1,44 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_LZ4_BLOCK_H
+#define FPLBASE_LZ4_BLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace fplbase {
+
+// A small codec for the LZ4 block format
+// (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), used for
+// supercompressed textures. Decompression is a single pass of copies with no
+// entropy decoding, so it runs at memory speed on the loader thread. Other
+// LZ4 block encoders produce data DecompressLz4Block() can read.
+
+// The most bytes CompressLz4Block() can write for `size` input bytes.
+size_t Lz4BlockBound(size_t size);
+
+// Compresses `size` bytes of `src` into `dest`, which must have room for
+// Lz4BlockBound(size) bytes. Returns the compressed size.
+size_t CompressLz4Block(const uint8_t *src, size_t size, uint8_t *dest);
+
+// Decompresses the block of `src_size` bytes into exactly `dest_size` bytes.
+// Returns false if the block is corrupt or doesn't decompress to that size,
+// without writing outside of `dest`.
+bool DecompressLz4Block(const uint8_t *src, size_t src_size, uint8_t *dest,
+                        size_t dest_size);
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_LZ4_BLOCK_H
@@ -0,0 +1,83 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_MPSC_QUEUE_H
+#define FPLBASE_MPSC_QUEUE_H
+
+#include <atomic>
+
+namespace fplbase {
+
+// Base class for elements of an MpscQueue. The link is embedded in the
+// element, so pushing and popping never allocates.
+struct MpscNode {
+  MpscNode() : mpsc_next(nullptr) {}
+  std::atomic<MpscNode *> mpsc_next;
+};
+
+// Lock-free, unbounded, intrusive multiple-producer single-consumer FIFO
+// queue (Dmitry Vyukov's algorithm). Push() may be called from any number of
+// threads at once. Pop() must only ever be called from one thread at a time.
+// A node can only be in one queue at a time.
+class MpscQueue {
+ public:
+  MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+  // Wait-free. Safe to call from any thread.
+  void Push(MpscNode *node) {
+    node->mpsc_next.store(nullptr, std::memory_order_relaxed);
+    MpscNode *prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->mpsc_next.store(node, std::memory_order_release);
+  }
+
+  // Returns the oldest node, or nullptr if the queue is empty. May also
+  // return nullptr for a moment while a producer is half way through Push();
+  // that node is then returned by a later call. Never blocks.
+  MpscNode *Pop() {
+    MpscNode *tail = tail_;
+    MpscNode *next = tail->mpsc_next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (!next) return nullptr;
+      tail_ = next;
+      tail = next;
+      next = next->mpsc_next.load(std::memory_order_acquire);
+    }
+    if (next) {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire)) return nullptr;
+    // `tail` is the last node. Put the stub behind it so it can be unlinked.
+    Push(&stub_);
+    next = tail->mpsc_next.load(std::memory_order_acquire);
+    if (next) {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+ private:
+  // Producers append at head_, the consumer removes at tail_.
+  std::atomic<MpscNode *> head_;
+  MpscNode *tail_;
+  MpscNode stub_;
+
+  MpscQueue(const MpscQueue &);
+  MpscQueue &operator=(const MpscQueue &);
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MPSC_QUEUE_H
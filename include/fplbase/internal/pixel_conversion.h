@@ -0,0 +1,65 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef FPLBASE_PIXEL_CONVERSION_H
+#define FPLBASE_PIXEL_CONVERSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace fplbase {
+
+// Pixel format conversion kernels used by Texture. Each has a plain C++
+// reference version (the *Scalar functions), and a version that uses
+// SSE2 or NEON when the compiler targets them, falling back to the
+// reference otherwise. Both produce bit-identical results.
+
+// Which vectorized implementation the kernels below were compiled with.
+enum PixelConversionSimd {
+  kPixelConversionScalar,
+  kPixelConversionSse2,
+  kPixelConversionNeon,
+};
+PixelConversionSimd GetPixelConversionSimd();
+
+// Converts `num_pixels` RGBA 8888 pixels to RGBA 5551.
+void Convert8888To5551(const uint8_t *src, uint16_t *dest, size_t num_pixels);
+void Convert8888To5551Scalar(const uint8_t *src, uint16_t *dest,
+                             size_t num_pixels);
+
+// Converts `num_pixels` RGB 888 pixels to RGB 565.
+void Convert888To565(const uint8_t *src, uint16_t *dest, size_t num_pixels);
+void Convert888To565Scalar(const uint8_t *src, uint16_t *dest,
+                           size_t num_pixels);
+
+// Multiplies the RGB of `num_pixels` RGBA 8888 pixels by their alpha, in
+// place, rounding down.
+void MultiplyRgbByAlpha(uint8_t *rgba, size_t num_pixels);
+void MultiplyRgbByAlphaScalar(uint8_t *rgba, size_t num_pixels);
+
+// Halves a `width` x `height` image of `channels` bytes per pixel with a 2x2
+// box filter, into a max(width / 2, 1) x max(height / 2, 1) image. A last odd
+// row or column is dropped. Rows are tightly packed. Each output channel is
+// the rounded-up average of the rounded-up averages of the horizontal pairs,
+// which is what the SSE2 and NEON averaging instructions compute. Only 4
+// channel images are vectorized. `dest` may be `src`, to halve in place.
+void DownsampleBox2x2(const uint8_t *src, int width, int height, int channels,
+                      uint8_t *dest);
+void DownsampleBox2x2Scalar(const uint8_t *src, int width, int height,
+                            int channels, uint8_t *dest);
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_PIXEL_CONVERSION_H
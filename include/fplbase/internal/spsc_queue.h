@@ -0,0 +1,76 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_SPSC_QUEUE_H
+#define FPLBASE_SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+
+namespace fplbase {
+
+// Lock-free, bounded, single-producer single-consumer FIFO queue. Push() must
+// only ever be called from one thread at a time, and Pop() from one other
+// (or the same) thread at a time. Neither ever blocks or allocates. Holds up
+// to `kCapacity` elements, which must be a power of two.
+template <typename T, size_t kCapacity>
+class SpscQueue {
+  static_assert(kCapacity > 0 && (kCapacity & (kCapacity - 1)) == 0,
+                "SpscQueue capacity must be a power of two.");
+
+ public:
+  SpscQueue() : head_(0), tail_(0) {}
+
+  // Returns false, dropping `element`, if the queue is full.
+  bool Push(const T &element) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == kCapacity) {
+      return false;
+    }
+    elements_[head & (kCapacity - 1)] = element;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the queue is empty.
+  bool Pop(T *element) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) return false;
+    *element = elements_[tail & (kCapacity - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Only exact when called from the producer or consumer while the other is
+  // idle; otherwise a snapshot.
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  // The producer only writes head_, and the consumer only writes tail_. They
+  // are kept on separate cache lines so each thread's writes don't
+  // invalidate the other's.
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+  T elements_[kCapacity];
+
+  SpscQueue(const SpscQueue &);
+  SpscQueue &operator=(const SpscQueue &);
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_SPSC_QUEUE_H
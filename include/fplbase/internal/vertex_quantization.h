@@ -0,0 +1,163 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_VERTEX_QUANTIZATION_H
+#define FPLBASE_VERTEX_QUANTIZATION_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace fplbase {
+
+// Encoders and decoders for the compact vertex attributes: kPosition3h,
+// kTexCoord2h, kNormalOct2s and kOrientationPacked. Inline, so that
+// mesh_pipeline can use them without linking fplbase.
+
+// Converts a float to an IEEE 754 half precision float, rounding to nearest
+// even. Out of range values become infinity, NaNs stay NaNs.
+inline uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  const uint32_t abs_bits = bits & 0x7fffffff;
+  if (abs_bits >= 0x7f800000) {
+    // Infinity or NaN, keeping NaNs quiet.
+    return sign | 0x7c00 | (abs_bits > 0x7f800000 ? 0x200 : 0);
+  }
+  if (abs_bits >= 0x477ff000) return sign | 0x7c00;  // Rounds above 65504.
+  if (abs_bits < 0x38800000) {
+    // Denormal half, or zero: shift the mantissa, with its implicit bit, into
+    // place below the smallest normal exponent.
+    if (abs_bits < 0x33000000) return sign;  // Rounds to zero.
+    const uint32_t exponent = abs_bits >> 23;
+    const uint32_t mantissa = (abs_bits & 0x7fffff) | 0x800000;
+    const uint32_t shift = 126 - exponent;
+    uint32_t half = mantissa >> shift;
+    const uint32_t rest = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+    return sign | static_cast<uint16_t>(half);
+  }
+  // Normal half: rebias the exponent and round off 13 mantissa bits. A carry
+  // out of the mantissa correctly bumps the exponent.
+  uint32_t half = (abs_bits - 0x38000000) >> 13;
+  const uint32_t rest = abs_bits & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half;
+  return sign | static_cast<uint16_t>(half);
+}
+
+// Converts an IEEE 754 half precision float to a float, exactly.
+inline float HalfToFloat(uint16_t half) {
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1f;
+  uint32_t mantissa = half & 0x3ff;
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // Denormal: normalize it, as every half denormal is a normal float.
+    exponent = 113;
+    while (!(mantissa & 0x400)) {
+      mantissa <<= 1;
+      --exponent;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Converts a value in [-1, 1] to a signed normalized integer of `bits` bits,
+// the way GL converts it back: value * (2^(bits - 1) - 1).
+inline int32_t FloatToSnorm(float value, int bits) {
+  const float scale = static_cast<float>((1 << (bits - 1)) - 1);
+  const float clamped = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+  return static_cast<int32_t>(floorf(clamped * scale + 0.5f));
+}
+
+// Maps a unit vector onto the octahedron |x| + |y| + |z| = 1, unfolding the
+// lower half over the upper half's diagonals, for kNormalOct2s. The inverse
+// is DecodeOctahedralNormal() below, which is also in
+// shaders/fplbase/vertex_decoding.glslv_h.
+inline void EncodeOctahedralNormal(const float normal[3], int16_t encoded[2]) {
+  const float l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+  float x = l1 > 0.0f ? normal[0] / l1 : 0.0f;
+  float y = l1 > 0.0f ? normal[1] / l1 : 0.0f;
+  if (normal[2] < 0.0f) {
+    const float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    const float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+  encoded[0] = static_cast<int16_t>(FloatToSnorm(x, 16));
+  encoded[1] = static_cast<int16_t>(FloatToSnorm(y, 16));
+}
+
+// Decodes a kNormalOct2s normal to a unit vector.
+inline void DecodeOctahedralNormal(const int16_t encoded[2], float normal[3]) {
+  float x = encoded[0] / 32767.0f;
+  float y = encoded[1] / 32767.0f;
+  x = x < -1.0f ? -1.0f : x;
+  y = y < -1.0f ? -1.0f : y;
+  const float z = 1.0f - fabsf(x) - fabsf(y);
+  if (z < 0.0f) {
+    const float unfolded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    const float unfolded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = unfolded_x;
+    y = unfolded_y;
+  }
+  const float length = sqrtf(x * x + y * y + z * z);
+  normal[0] = x / length;
+  normal[1] = y / length;
+  normal[2] = z / length;
+}
+
+// Packs a unit quaternion (vector.xyz, scalar), whose scalar's sign is the
+// handedness like for kOrientation4f, into kOrientationPacked's
+// GL_INT_2_10_10_10_REV layout: the vector in signed normalized 10 bit x, y
+// and z, and the sign of the scalar in the 2 bit w. The magnitude of the
+// scalar follows from the vector being part of a unit quaternion.
+inline uint32_t PackOrientation(const float quaternion[4]) {
+  const uint32_t x = static_cast<uint32_t>(FloatToSnorm(quaternion[0], 10));
+  const uint32_t y = static_cast<uint32_t>(FloatToSnorm(quaternion[1], 10));
+  const uint32_t z = static_cast<uint32_t>(FloatToSnorm(quaternion[2], 10));
+  const uint32_t w = quaternion[3] < 0.0f ? 3u : 1u;  // -1 or 1.
+  return (x & 0x3ff) | ((y & 0x3ff) << 10) | ((z & 0x3ff) << 20) | (w << 30);
+}
+
+// Unpacks a kOrientationPacked quaternion.
+inline void UnpackOrientation(uint32_t packed, float quaternion[4]) {
+  float length_squared = 0.0f;
+  for (int i = 0; i < 3; ++i) {
+    // Sign extend the 10 bit field.
+    const int32_t value =
+        static_cast<int32_t>((packed >> (10 * i)) << 22) >> 22;
+    const float component = value / 511.0f;
+    quaternion[i] = component < -1.0f ? -1.0f : component;
+    length_squared += quaternion[i] * quaternion[i];
+  }
+  const float scalar = length_squared < 1.0f ? sqrtf(1.0f - length_squared)
+                                             : 0.0f;
+  quaternion[3] = (packed >> 31) ? -scalar : scalar;
+}
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_VERTEX_QUANTIZATION_H
@@ -18,6 +18,7 @@
 #include "fplbase/config.h"  // Must come first.
 
 #include <stdarg.h>
+#include <stddef.h>
 
 namespace fplbase {
 
@@ -72,6 +73,43 @@ void LogInfo(LogCategory category, const char *fmt, va_list args);
 /// string `fmt`.
 void LogError(LogCategory category, const char *fmt, va_list args);
 
+/// @brief Like `LogInfo()`, but always writes the message now, on the calling
+/// thread, even with `SetAsyncLogging()` on.
+void LogInfoRaw(LogCategory category, const char *fmt, va_list args);
+
+/// @brief Like `LogError()`, but always writes the message now, on the
+/// calling thread, even with `SetAsyncLogging()` on.
+void LogErrorRaw(LogCategory category, const char *fmt, va_list args);
+
+/// @brief Turn asynchronous logging on or off.
+/// @details With it on, `LogInfo()` and `LogError()` only format the message
+/// into a fixed size lock-free queue, and a background thread writes it to
+/// stdout, SDL or logcat, so logging doesn't stall the loader or render
+/// threads. When the queue is full, messages are dropped rather than waited
+/// for, and counted by `NumDroppedLogMessages()`. Messages longer than
+/// `kAsyncLogMessageSize` are truncated.
+/// Turning it off writes the messages still queued. Do this before shutting
+/// down, and don't call this from more than one thread at once.
+void SetAsyncLogging(bool enabled);
+
+/// @brief Whether `SetAsyncLogging()` is on.
+bool IsAsyncLogging();
+
+/// @brief Write the messages queued so far by `SetAsyncLogging()`, e.g.
+/// before aborting.
+void FlushLog();
+
+/// @brief The number of messages dropped by `SetAsyncLogging()` because the
+/// queue was full.
+size_t NumDroppedLogMessages();
+
+/// @brief The most messages `SetAsyncLogging()` queues at once.
+static const size_t kAsyncLogQueueSize = 256;
+
+/// @brief The size of a message queued by `SetAsyncLogging()`, including the
+/// terminating zero.
+static const size_t kAsyncLogMessageSize = 512;
+
 /// @brief Log a format string with `Info` priority to the console.
 /// @param[in] fmt A C-string format string.
 void LogInfo(const char *fmt, ...);
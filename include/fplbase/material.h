@@ -31,6 +31,7 @@ namespace fplbase {
 /// @addtogroup fplbase_material
 /// @{
 
+class FileView;
 class Renderer;
 class Texture;
 
@@ -75,12 +76,30 @@ class Material : public Asset {
   static Material *LoadFromMaterialDef(const matdef::Material *matdef,
                                        const TextureLoaderFn &tlf);
 
+  /// @brief Call `tlf` for each texture of `matdef`, with the same arguments
+  /// as LoadFromMaterialDef(), but without creating a Material.
+  /// Used to start loading the textures ahead of the Material.
+  static void LoadTexturesFromMaterialDef(const matdef::Material *matdef,
+                                          const TextureLoaderFn &tlf);
+
   /// @brief Load a .fplmat file, and all the textures referenced from it.
   /// Used by the more convenient AssetManager interface, but can be used
   /// without it.
   static Material *LoadFromMaterialDef(const char *filename,
                                        const TextureLoaderFn &tlf);
 
+  /// @brief Load a .fplmat file into `file`, without loading its textures.
+  /// @return Returns the matdef in `file`, or nullptr if the file couldn't be
+  /// loaded.
+  static const matdef::Material *LoadMaterialDef(const char *filename,
+                                                 FileView *file);
+
+  /// @brief A key that's the same for two matdefs exactly when
+  /// LoadFromMaterialDef() makes identical Materials of them: the same
+  /// textures, formats, flags and blend mode. Used by the AssetManager to
+  /// share one Material between them.
+  static std::string ContentKey(const matdef::Material *matdef);
+
   /// @brief The filename that was the source of the material, if this
   /// material was loaded from a file.
   const std::string& filename() const { return filename_; }
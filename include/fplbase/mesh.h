@@ -15,10 +15,14 @@
 #ifndef FPL_MESH_H
 #define FPL_MESH_H
 
+#include <algorithm>
+#include <functional>
+#include <memory>
 #include <vector>
 
 #include "fplbase/config.h"  // Must come first.
 
+#include "fplbase/allocator.h"
 #include "fplbase/asset.h"
 #include "fplbase/async_loader.h"
 #include "fplbase/handles.h"
@@ -33,6 +37,7 @@ namespace fplbase {
 /// @addtogroup fplbase_mesh
 /// @{
 
+class MeshArena;
 class Renderer;
 struct MeshImpl;
 
@@ -54,6 +59,33 @@ enum Attribute {
   /// @brief A quaternion representation of normal/binormal/tangent.
   /// Order: (vector.xyz, scalar). The handededness is the sign of the scalar.
   kOrientation4f,
+  // Compact formats. These need kFeatureLevel30 (OpenGL ES 3.0 or OpenGL 3.3),
+  // and are encoded with fplbase/internal/vertex_quantization.h.
+  /// @brief 3 half floats, padded to 8 bytes. Can't coexist with kPosition3f.
+  kPosition3h,
+  /// @brief A unit normal, octahedral encoded in 2 signed normalized shorts.
+  /// Decode it in the shader with DecodeOctahedralNormal() from
+  /// shaders/fplbase/vertex_decoding.glslv_h. Can't coexist with kNormal3f.
+  kNormalOct2s,
+  /// @brief The quaternion of kOrientation4f, packed in 10:10:10:2 bits as
+  /// the vector in xyz and the sign of the scalar in w. Decode it in the
+  /// shader with DecodePackedOrientation() from
+  /// shaders/fplbase/vertex_decoding.glslv_h. Can't coexist with
+  /// kOrientation4f.
+  kOrientationPacked,
+  /// @brief 2 half floats. Can't coexist with kTexCoord2f or kTexCoord2us.
+  kTexCoord2h,
+  // Per-instance attributes. These go in an InstanceBuffer, not a Mesh, and
+  // advance once per instance rather than once per vertex.
+  /// @brief The 3 rows of an affine transform, as 3 vec4s, like a
+  /// mathfu::AffineTransform's columns. Read in the shader as
+  /// `aInstanceTransform0..2`.
+  kInstanceTransform3x4f,
+  /// @brief A color, normalized to [0,1]. Read as `aInstanceColor`.
+  kInstanceColor4ub,
+  /// @brief The index of the instance's first bone in a BonePaletteBuffer,
+  /// as a float. Read as `aInstancePaletteOffset`.
+  kInstancePaletteOffset1f,
 };
 
 /// @class Mesh
@@ -61,6 +93,8 @@ enum Attribute {
 ///
 /// A mesh instance contains a VBO and one or more IBO's.
 class Mesh : public AsyncAsset {
+  friend class MeshArena;
+  friend class MultiDrawBatch;
   friend class Renderer;
 
  public:
@@ -104,6 +138,43 @@ class Mesh : public AsyncAsset {
   /// @brief Loads and unpacks the Mesh from 'filename_' and 'data_'.
   virtual void Load();
 
+  /// @brief Whether Load() maps the file instead of copying it.
+  ///
+  /// When set, Load() maps the file with MapFile() rather than reading it into
+  /// memory with LoadFile(), and Finalize() uploads interleaved vertex data
+  /// straight from the mapping. Falls back to LoadFile() for files MapFile()
+  /// can't open, such as compressed APK entries, and while a function set
+  /// with SetLoadFileFunction() is in use.
+  ///
+  /// @param map_file Whether to map the file. Must be set before loading.
+  void set_map_file(bool map_file) { map_file_ = map_file; }
+
+  /// @brief Put the vertices and indices in the shared buffers of `arena`.
+  ///
+  /// Must be set before the mesh is loaded, and the arena must outlive the
+  /// mesh. Meshes the arena can't hold get their own buffers, as usual.
+  ///
+  /// @param arena The arena to allocate from, or nullptr for own buffers.
+  void set_arena(MeshArena *arena) { arena_ = arena; }
+
+  /// @brief The arena set with set_arena().
+  MeshArena *arena() const { return arena_; }
+
+  /// @brief Start loading the mesh's textures from Load().
+  ///
+  /// When set, Load() reads the materials of the mesh (embedded or from their
+  /// .fplmat files) on the loader thread and calls `prefetch_texture_fn` for
+  /// each of their textures, so the textures load in parallel with the mesh
+  /// instead of only once Finalize() creates the materials. The textures it
+  /// returns become load dependencies: Finalize() runs once they are ready.
+  ///
+  /// @param prefetch_texture_fn Called on the loader thread, so must be
+  /// thread-safe. Must return textures that the material_create_fn will
+  /// later return too. Must be set before loading.
+  void set_prefetch_texture_fn(TextureLoaderFn prefetch_texture_fn) {
+    prefetch_texture_fn_ = std::move(prefetch_texture_fn);
+  }
+
   /// @brief Creates a mesh from 'data_'.
   virtual bool Finalize();
 
@@ -111,6 +182,12 @@ class Mesh : public AsyncAsset {
   /// Finalize has been called (by AssetManager::TryFinalize).
   bool IsValid();
 
+  /// @brief Free the vertex and index buffers and the bones.
+  ///
+  /// Keeps the materials, so a later Load() and Finalize() recreate the mesh
+  /// with the same materials rather than creating them again.
+  void Unload();
+
   /// @brief Add an index buffer object to be part of this mesh
   ///
   /// Create one IBO to be part of this mesh. May be called more than once.
@@ -123,6 +200,61 @@ class Mesh : public AsyncAsset {
   void AddIndices(const void *indices, int count, Material *mat,
                   bool is_32_bit = false);
 
+  /// @brief Add a coarser detail level to the most recently added IBO.
+  ///
+  /// Levels are added from most to least detailed, and use the index size
+  /// given to AddIndices(). The renderer draws level `lod` of each IBO, or
+  /// the coarsest it has, when asked to draw that level.
+  ///
+  /// @param indices The indices of the detail level. Usually a subset of the
+  ///        IBO's triangles, on the same vertices.
+  /// @param count The number of indices.
+  /// @param is_32_bit Specifies that the indices are 32bit. Must match the
+  ///        IBO's.
+  void AddIndexLod(const void *indices, int count, bool is_32_bit = false);
+
+  /// @brief Allocate one index buffer for the IBOs and detail levels added
+  /// after this, so they're packed into it at different offsets rather than
+  /// each getting a buffer of their own.
+  ///
+  /// All surfaces of the mesh can then be drawn with a single index buffer
+  /// bound. Indices that don't fit get a buffer of their own. Has no effect
+  /// on meshes in a MeshArena, whose indices are already packed, or once
+  /// indices have been packed into an earlier reservation.
+  ///
+  /// @param size The size in bytes of all indices to be added. Each IBO and
+  ///        level is padded to a multiple of 4 bytes.
+  void ReserveIndexBuffer(size_t size);
+
+  /// @brief The number of detail levels, including the full detail one.
+  ///
+  /// @return Returns 1 for meshes without coarser detail levels.
+  size_t num_lods() const { return lod_screen_sizes_.size() + 1; }
+
+  /// @brief Set when to draw the coarser detail levels.
+  ///
+  /// @param screen_sizes For each level after the first, the fraction of the
+  ///        viewport's width or height that the mesh bounds must cover less
+  ///        of for that level to be used. Decreasing.
+  /// @param count The number of coarser levels.
+  void set_lod_screen_sizes(const float *screen_sizes, size_t count) {
+    lod_screen_sizes_.assign(screen_sizes, screen_sizes + count);
+  }
+
+  /// @brief Pick the detail level to draw the mesh with.
+  ///
+  /// Projects min_position() and max_position() with `model_view_projection`
+  /// and picks the coarsest level whose screen size threshold the projected
+  /// bounds are under. Meshes that cross the near plane get full detail.
+  ///
+  /// @param model_view_projection The transform the mesh is drawn with.
+  /// @param lod_bias Scales the projected size. Less than 1 picks coarser
+  ///        levels sooner, e.g. when the frame rate drops.
+  /// @return Returns a detail level to pass to Renderer::Render(), less than
+  ///         num_lods().
+  size_t SelectLod(const mathfu::mat4 &model_view_projection,
+                   float lod_bias = 1.0f) const;
+
   /// @brief Set the bones used by an animated mesh.
   ///
   /// If mesh is animated set the transform from a bone's parent space into
@@ -162,6 +294,20 @@ class Mesh : public AsyncAsset {
   void GatherShaderTransforms(const mathfu::AffineTransform *bone_transforms,
                               mathfu::AffineTransform *shader_transforms) const;
 
+  /// @brief Convert bone transforms for a dual quaternion skinning shader.
+  ///
+  /// Like GatherShaderTransforms(), but each shader transform is output as a
+  /// dual quaternion, for shaders with kSkinningModeDualQuaternion. The bones
+  /// must be rigid: scale is dropped.
+  ///
+  /// @param bone_transforms Array of bone transforms, in object space.
+  ///                        Length num_bones().
+  /// @param shader_dual_quaternions Output array of two vec4s per shader
+  ///                                bone. Length 2 * num_shader_bones().
+  void GatherShaderDualQuaternions(
+      const mathfu::AffineTransform *bone_transforms,
+      mathfu::vec4_packed *shader_dual_quaternions) const;
+
   /// @brief Returns the number of index buffer objects in the mesh.
   ///
   /// @return Returns the number of index buffer objects in the mesh.
@@ -175,6 +321,35 @@ class Mesh : public AsyncAsset {
 
   const Material *GetMaterial(int i) const { return indices_[i].mat; }
 
+  /// @brief The minimum corner of the bounds of the IBO at the given index.
+  ///
+  /// Meshes loaded from files get the bounds of the vertices each IBO uses.
+  /// Otherwise the bounds are the whole mesh's, unless set with
+  /// set_submesh_bounds().
+  ///
+  /// @param i The index of the IBO.
+  mathfu::vec3 submesh_min_position(size_t i) const {
+    return mathfu::vec3(indices_[i].min_position);
+  }
+
+  /// @brief The maximum corner of the bounds of the IBO at the given index.
+  ///
+  /// @param i The index of the IBO.
+  mathfu::vec3 submesh_max_position(size_t i) const {
+    return mathfu::vec3(indices_[i].max_position);
+  }
+
+  /// @brief Set the bounds of the IBO at the given index, for culling.
+  ///
+  /// @param i The index of the IBO.
+  /// @param min_position The minimum corner of the IBO's vertices.
+  /// @param max_position The maximum corner of the IBO's vertices.
+  void set_submesh_bounds(size_t i, const mathfu::vec3 &min_position,
+                          const mathfu::vec3 &max_position) {
+    indices_[i].min_position = mathfu::vec3_packed(min_position);
+    indices_[i].max_position = mathfu::vec3_packed(max_position);
+  }
+
   /// @brief Define the vertex buffer format.
   ///
   /// `format` must have length <= kMaxAttributes, including `kEND`.
@@ -191,70 +366,91 @@ class Mesh : public AsyncAsset {
   /// mathfu::vec3_packed norm;
   /// mathfu::vec4_packed tangent;
   ///
+  /// Large meshes are processed on several threads. Each vertex gathers the
+  /// contributions of its triangles in index order, so the result doesn't
+  /// depend on the number of threads.
+  ///
   /// @param vertices The vertices to computes the information for.
-  /// @param indices The indices that make up the mesh.
+  /// @param indices The indices that make up the mesh. `uint16_t` or
+  ///        `uint32_t`.
   /// @param numverts The number of vertices in the vertex array.
   /// @param numindices The number of indices in the index array.
-  template <typename T>
-  static void ComputeNormalsTangents(T *vertices, const unsigned short *indices,
+  template <typename T, typename I>
+  static void ComputeNormalsTangents(T *vertices, const I *indices,
                                      int numverts, int numindices) {
-    std::unique_ptr<mathfu::vec3[]> binormals(new mathfu::vec3[numverts]);
+    const int numtris = numindices / 3;
+    std::unique_ptr<mathfu::vec3[]> face_normals(new mathfu::vec3[numtris]);
+    std::unique_ptr<mathfu::vec4[]> face_tangents(new mathfu::vec4[numtris]);
+    std::unique_ptr<mathfu::vec3[]> face_binormals(new mathfu::vec3[numtris]);
 
-    // set all normals to 0, as we'll accumulate
-    for (int i = 0; i < numverts; i++) {
-      vertices[i].norm = mathfu::kZeros3f;
-      vertices[i].tangent = mathfu::kZeros4f;
-      binormals[i] = mathfu::kZeros3f;
-    }
     // Go through each triangle and calculate tangent space for it, then
     // contribute results to adjacent triangles.
     // For a description of the math see e.g.:
     // http://www.terathon.com/code/tangent.html
-    for (int i = 0; i < numindices; i += 3) {
-      auto &v0 = vertices[indices[i + 0]];
-      auto &v1 = vertices[indices[i + 1]];
-      auto &v2 = vertices[indices[i + 2]];
-      // The cross product of two vectors along the triangle surface from the
-      // first vertex gives us this triangle's normal.
-      auto q1 = mathfu::vec3(v1.pos) - mathfu::vec3(v0.pos);
-      auto q2 = mathfu::vec3(v2.pos) - mathfu::vec3(v0.pos);
-      auto norm = normalize(cross(q1, q2));
-      // Contribute the triangle normal into all 3 verts:
-      v0.norm = mathfu::vec3(v0.norm) + norm;
-      v1.norm = mathfu::vec3(v1.norm) + norm;
-      v2.norm = mathfu::vec3(v2.norm) + norm;
-      // Similarly create uv space vectors:
-      auto uv1 = mathfu::vec2(v1.tc) - mathfu::vec2(v0.tc);
-      auto uv2 = mathfu::vec2(v2.tc) - mathfu::vec2(v0.tc);
-      float m = 1 / (uv1.x * uv2.y - uv2.x * uv1.y);
-      auto tangent = mathfu::vec4((uv2.y * q1 - uv1.y * q2) * m, 0);
-      auto binorm = (uv1.x * q2 - uv2.x * q1) * m;
-      v0.tangent = mathfu::vec4(v0.tangent) + tangent;
-      v1.tangent = mathfu::vec4(v1.tangent) + tangent;
-      v2.tangent = mathfu::vec4(v2.tangent) + tangent;
-      binormals[indices[i + 0]] = binorm;
-      binormals[indices[i + 1]] = binorm;
-      binormals[indices[i + 2]] = binorm;
-    }
-    // Normalize per vertex tangent space constributions, and pack tangent /
-    // binormal into a 4 component tangent.
+    ParallelFor(numtris, [&](size_t begin, size_t end) {
+      for (size_t t = begin; t < end; ++t) {
+        const T &v0 = vertices[indices[3 * t + 0]];
+        const T &v1 = vertices[indices[3 * t + 1]];
+        const T &v2 = vertices[indices[3 * t + 2]];
+        // The cross product of two vectors along the triangle surface from
+        // the first vertex gives us this triangle's normal.
+        auto q1 = mathfu::vec3(v1.pos) - mathfu::vec3(v0.pos);
+        auto q2 = mathfu::vec3(v2.pos) - mathfu::vec3(v0.pos);
+        face_normals[t] = normalize(cross(q1, q2));
+        // Similarly create uv space vectors:
+        auto uv1 = mathfu::vec2(v1.tc) - mathfu::vec2(v0.tc);
+        auto uv2 = mathfu::vec2(v2.tc) - mathfu::vec2(v0.tc);
+        float m = 1 / (uv1.x * uv2.y - uv2.x * uv1.y);
+        face_tangents[t] = mathfu::vec4((uv2.y * q1 - uv1.y * q2) * m, 0);
+        face_binormals[t] = (uv1.x * q2 - uv2.x * q1) * m;
+      }
+    });
+
+    // The triangles around vertex i, in index order, are vertex_triangles
+    // from vertex_starts[i] up to vertex_starts[i + 1].
+    std::vector<int> vertex_starts(numverts + 1, 0);
+    for (int i = 0; i < numtris * 3; i++) vertex_starts[indices[i] + 1]++;
     for (int i = 0; i < numverts; i++) {
-      auto norm = mathfu::vec3(vertices[i].norm);
-      auto tangent = mathfu::vec4(vertices[i].tangent);
-      // Renormalize all 3 axes:
-      norm = normalize(norm);
-      tangent = mathfu::vec4(normalize(tangent.xyz()), 0);
-      binormals[i] = normalize(binormals[i]);
-      tangent = mathfu::vec4(
-          // Gram-Schmidt orthogonalize xyz components:
-          normalize(tangent.xyz() - norm * dot(norm, tangent.xyz())),
-          // The w component is the handedness, set as difference between the
-          // binormal we computed from the texture coordinates and that from the
-          // cross-product:
-          dot(cross(norm, tangent.xyz()), binormals[i]));
-      vertices[i].norm = norm;
-      vertices[i].tangent = tangent;
+      vertex_starts[i + 1] += vertex_starts[i];
     }
+    std::vector<int> vertex_triangles(numtris * 3);
+    {
+      std::vector<int> next(vertex_starts.begin(), vertex_starts.end() - 1);
+      for (int i = 0; i < numtris * 3; i++) {
+        vertex_triangles[next[indices[i]]++] = i / 3;
+      }
+    }
+
+    // Sum the contributions of each vertex's triangles, normalize, and pack
+    // tangent / binormal into a 4 component tangent.
+    ParallelFor(numverts, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        auto norm = mathfu::kZeros3f;
+        auto tangent = mathfu::kZeros4f;
+        auto binormal = mathfu::kZeros3f;
+        for (int j = vertex_starts[i]; j < vertex_starts[i + 1]; ++j) {
+          const int t = vertex_triangles[j];
+          norm += face_normals[t];
+          tangent += face_tangents[t];
+          // The binormal is only used for its handedness, so the last
+          // triangle's will do.
+          binormal = face_binormals[t];
+        }
+        // Renormalize all 3 axes:
+        norm = normalize(norm);
+        tangent = mathfu::vec4(normalize(tangent.xyz()), 0);
+        binormal = normalize(binormal);
+        tangent = mathfu::vec4(
+            // Gram-Schmidt orthogonalize xyz components:
+            normalize(tangent.xyz() - norm * dot(norm, tangent.xyz())),
+            // The w component is the handedness, set as difference between
+            // the binormal we computed from the texture coordinates and that
+            // from the cross-product:
+            dot(cross(norm, tangent.xyz()), binormal));
+        vertices[i].norm = norm;
+        vertices[i].tangent = tangent;
+      }
+    });
   }
 
   enum {
@@ -267,6 +463,10 @@ class Mesh : public AsyncAsset {
     kAttributeColor,
     kAttributeBoneIndices,
     kAttributeBoneWeights,
+    // kInstanceTransform3x4f takes three consecutive locations from here.
+    kAttributeInstanceTransform,
+    kAttributeInstanceColor = kAttributeInstanceTransform + 3,
+    kAttributeInstancePaletteOffset,
   };
 
   /// @brief Compute the byte size for a vertex from given attributes.
@@ -292,6 +492,14 @@ class Mesh : public AsyncAsset {
   /// @return Returns whether the format is valid.
   static bool IsValidFormat(const Attribute *attributes);
 
+  /// @brief Checks the format of an InstanceBuffer for correctness.
+  ///
+  /// @param attributes The array of per-instance attributes, terminated with
+  /// kEND.
+  /// @return Returns whether the format has at least one attribute, each
+  /// of them per-instance and used at most once.
+  static bool IsValidInstanceFormat(const Attribute *attributes);
+
   /// @brief Get the minimum position of an AABB about the mesh.
   ///
   /// @return Returns the minimum position of the mesh.
@@ -339,10 +547,22 @@ class Mesh : public AsyncAsset {
   /// @return Returns the total number of indices across all IBOs.
   size_t CalculateTotalNumberOfIndices() const;
 
+  /// @brief Estimate the GPU memory used by this mesh.
+  ///
+  /// @return Returns the size in bytes of the VBO and all IBOs, or 0 if the
+  /// mesh isn't loaded.
+  size_t CalculateMemorySize() const;
+
+  /// @brief The GPU memory this mesh counts towards
+  /// RendererBase::gpu_memory(), in bytes.
+  size_t gpu_memory_size() const { return gpu_memory_size_; }
+
   /// @brief Holder for data that can be turned into a mesh.
   struct InterleavedVertexData {
     const void *vertex_data;
-    std::vector<uint8_t> owned_vertex_data;
+    std::vector<uint8_t,
+                CategoryAllocator<uint8_t, kAllocationMeshStaging>>
+        owned_vertex_data;
     size_t count;
     size_t vertex_size;
     std::vector<Attribute> format;
@@ -362,6 +582,11 @@ class Mesh : public AsyncAsset {
   MATHFU_DEFINE_CLASS_SIMD_AWARE_NEW_DELETE
 
  private:
+  // Call `body` on ranges that together cover [0, count), in parallel when
+  // `count` is large enough to be worth the threads.
+  static void ParallelFor(size_t count,
+                          const std::function<void(size_t, size_t)> &body);
+
   // Disallow copies because of pointers bone_transforms_ and
   // bone_global_transforms_. Feel free to implement copy or move operators
   // if required.
@@ -372,10 +597,23 @@ class Mesh : public AsyncAsset {
   // outside of the impl_ class). Implemented in mesh_common.cc.
   void Clear();
 
+  // Free the file contents in data_, whether mapped or copied.
+  void FreeData();
+
+  // The meshdef in data_, whether mapped or copied.
+  const void *MeshDefBuffer() const;
+
+  // Calls prefetch_texture_fn_ for the textures of all surfaces, on the
+  // loader thread. See set_prefetch_texture_fn().
+  void PrefetchTextures();
+
   // Free all resources in the platform-dependent data (i.e. everything in the
   // impl_ class). Implemented in platform-dependent code.
   void ClearPlatformDependent();
 
+  // Updates gpu_memory_size_ after the buffers changed.
+  void UpdateGpuMemorySize();
+
   // Backend-specific create and destroy calls. These just call new and delete
   // on the platform-specific MeshImpl structs.
   static MeshImpl *CreateMeshImpl();
@@ -383,20 +621,59 @@ class Mesh : public AsyncAsset {
 
   static const int kMaxAttributes = 10;
 
+  // Indices in `ibo`, starting `offset` bytes in. Shared buffers belong to
+  // the mesh's arena, or are the mesh's own index buffer from
+  // ReserveIndexBuffer(), rather than to the range.
+  struct IndexRange {
+    IndexRange()
+        : count(0), ibo(InvalidBufferHandle()), offset(0), shared(false) {}
+    int count;
+    BufferHandle ibo;
+    size_t offset;
+    bool shared;
+  };
+
   struct Indices {
     Indices()
         : count(0),
           ibo(InvalidBufferHandle()),
           mat(nullptr),
           index_type(0),
-          indexBufferMem(InvalidDeviceMemoryHandle()) {}
+          indexBufferMem(InvalidDeviceMemoryHandle()),
+          offset(0),
+          shared(false) {}
     int count;
     BufferHandle ibo;
     Material *mat;
     uint32_t index_type;
     DeviceMemoryHandle indexBufferMem;
+    size_t offset;
+    bool shared;
+    std::vector<IndexRange> lods;
+    // Packed, since vectors of aligned types aren't portable.
+    mathfu::vec3_packed min_position;
+    mathfu::vec3_packed max_position;
+
+    // Detail level `lod`, or the coarsest level if there are fewer.
+    IndexRange Lod(size_t lod) const {
+      if (lod == 0 || lods.empty()) {
+        IndexRange level;
+        level.count = count;
+        level.ibo = ibo;
+        level.offset = offset;
+        level.shared = shared;
+        return level;
+      }
+      return lods[std::min(lod, lods.size()) - 1];
+    }
   };
 
+  // Uploads indices into a buffer of their own or, in an arena, into the
+  // arena page's index buffer, rebased onto arena_first_vertex_.
+  // Implemented in platform-dependent code.
+  IndexRange CreateIndexRange(const void *indices, int count, bool is_32_bit,
+                              uint32_t *index_type);
+
   MeshImpl *impl_;
   std::vector<Indices> indices_;
   uint32_t primitive_;
@@ -405,6 +682,7 @@ class Mesh : public AsyncAsset {
   Attribute format_[kMaxAttributes];
   mathfu::vec3 min_position_;
   mathfu::vec3 max_position_;
+  std::vector<float> lod_screen_sizes_;
 
   // The default bone positions, in object space, inverted. Length NumBones().
   // Used when skinning.
@@ -433,6 +711,27 @@ class Mesh : public AsyncAsset {
 
   // Function to create material.
   MaterialCreateFn material_create_fn_;
+
+  // Materials kept by Unload(), used instead of calling material_create_fn_
+  // the next time the mesh is initialized.
+  std::vector<Material *> reload_materials_;
+
+  // Called from Load() for each texture. See set_prefetch_texture_fn().
+  TextureLoaderFn prefetch_texture_fn_;
+
+  // Whether Load() uses MapFile(). See set_map_file().
+  bool map_file_;
+
+  // The arena from set_arena(), and where in it the vertices went.
+  // arena_page_ is kNoArenaPage if the mesh has its own VBO.
+  MeshArena *arena_;
+  size_t arena_page_;
+  uint32_t arena_first_vertex_;
+  static const size_t kNoArenaPage = static_cast<size_t>(-1);
+  // Non-zero while data_ is a mapping made by MapFile().
+  int32_t mapped_size_;
+  // What this mesh reported to RendererBase::TrackGpuMemory().
+  size_t gpu_memory_size_;
 };
 
 /// @}
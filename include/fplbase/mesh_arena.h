@@ -0,0 +1,131 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_MESH_ARENA_H
+#define FPLBASE_MESH_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/handles.h"
+#include "fplbase/mesh.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_mesh
+/// @{
+
+/// @class MeshArena
+/// @brief Vertex and index buffers shared by many small meshes with the same
+/// vertex format.
+///
+/// A mesh given an arena with Mesh::set_arena() puts its vertices and indices
+/// in the arena's buffers, rather than creating buffers of its own. The
+/// buffers are split into pages of up to 65536 vertices, and indices are
+/// rebased onto the mesh's first vertex in its page as they're uploaded, so
+/// draws only need an offset into the index buffer, even on OpenGL ES 3.0,
+/// which has no base vertex draws. All meshes in a page share one VBO, IBO
+/// and VAO, so drawing them one after the other binds nothing new.
+///
+/// Meshes with a different format or with more vertices than a page fall
+/// back to their own buffers, as do index buffers that don't fit in what's
+/// left of their page's index buffer.
+///
+/// The arena must outlive its meshes. A page's space is reused once all of
+/// its meshes have been freed.
+class MeshArena {
+ public:
+  /// @brief Create an empty arena. Pages are allocated as meshes need them.
+  ///
+  /// @param format The vertex format of the meshes, delimited by `kEND`.
+  /// @param page_vertices The number of vertices in each page. At most
+  ///        kMaxPageVertices.
+  /// @param page_indices The number of indices in each page.
+  explicit MeshArena(const Attribute *format,
+                     size_t page_vertices = kMaxPageVertices,
+                     size_t page_indices = 3 * kMaxPageVertices);
+  ~MeshArena();
+
+  /// @brief The vertex format of the arena's meshes.
+  const Attribute *format() const { return format_; }
+
+  /// @brief The size of a vertex in bytes.
+  size_t vertex_size() const { return vertex_size_; }
+
+  /// @brief The number of pages allocated.
+  size_t num_pages() const { return pages_.size(); }
+
+  /// @brief The GPU memory allocated for all pages, in bytes.
+  size_t gpu_memory_size() const { return gpu_memory_size_; }
+
+  /// @brief The most vertices a page can hold, since their indices are
+  /// 16 bit.
+  static const size_t kMaxPageVertices = 0x10000;
+
+ private:
+  friend class Mesh;
+
+  struct Page {
+    Page()
+        : vbo(InvalidBufferHandle()),
+          ibo(InvalidBufferHandle()),
+          vao(InvalidBufferHandle()),
+          num_vertices(0),
+          num_indices(0),
+          num_meshes(0) {}
+    BufferHandle vbo;
+    BufferHandle ibo;
+    BufferHandle vao;
+    size_t num_vertices;
+    size_t num_indices;
+    int num_meshes;
+  };
+
+  MeshArena(const MeshArena &);
+  MeshArena &operator=(const MeshArena &);
+
+  // Copies `count` vertices into the first page with room for them. Returns
+  // false if the mesh can't go in the arena.
+  bool AllocateVertices(const void *vertex_data, size_t count,
+                        size_t vertex_size, const Attribute *format,
+                        size_t *page, uint32_t *first_vertex);
+
+  // Copies rebased 16 bit indices into `page`. Returns false if they don't
+  // fit.
+  bool AllocateIndices(size_t page, const uint16_t *indices, size_t count,
+                       size_t *offset);
+
+  // Called when a mesh using `page` frees its buffers.
+  void Release(size_t page);
+
+  const Page &page(size_t i) const { return pages_[i]; }
+
+  void CreatePage();
+
+  Attribute format_[Mesh::kMaxAttributes];
+  size_t vertex_size_;
+  size_t page_vertices_;
+  size_t page_indices_;
+  std::vector<Page> pages_;
+  size_t gpu_memory_size_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_ARENA_H
@@ -0,0 +1,131 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_MULTI_DRAW_BATCH_H
+#define FPLBASE_MULTI_DRAW_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/handles.h"
+#include "fplbase/instance_buffer.h"
+
+namespace fplbase {
+
+class Material;
+class Mesh;
+class Renderer;
+
+/// @file
+/// @addtogroup fplbase_mesh
+/// @{
+
+/// @class MultiDrawBatch
+/// @brief Collects the draws of many meshes, and submits those that share
+/// buffers and a material in one glMultiDrawElementsIndirect call.
+///
+/// Meshes in the same MeshArena page share their vertex and index buffers, so
+/// drawing each of them differs only in index offsets and per-object data.
+/// Each draw added here has per-instance attributes in the batch's
+/// InstanceBuffer (e.g. its transform and color), which the shader reads
+/// through the attributes of shaders/fplbase/instancing.glslv_h: each indirect
+/// command's base instance points at its draw's instances.
+///
+/// Where indirect draws aren't supported (see
+/// Renderer::SupportsMultiDrawIndirect()), the same draws are issued one
+/// glDrawElementsInstanced after another, still without any uniform changes
+/// between them. Needs OpenGL ES 3.0 / OpenGL 3.3 either way.
+///
+/// Each frame, Clear() the batch, Add() the visible meshes, then Render() it.
+class MultiDrawBatch {
+ public:
+  /// @param instance_format The per-instance attributes of each draw,
+  ///        terminated with kEND. See InstanceBuffer.
+  explicit MultiDrawBatch(const Attribute *instance_format);
+  ~MultiDrawBatch();
+
+  /// @brief Remove all draws, to start a new frame. Keeps the GPU buffers.
+  void Clear();
+
+  /// @brief Add a draw of every surface of `mesh`.
+  ///
+  /// @param mesh The mesh to draw. Must have indices.
+  /// @param instance_data `instance_count` instances, laid out as described by
+  ///        the instance format.
+  /// @param instance_count The number of instances to draw.
+  /// @param lod The detail level to draw, e.g. from Mesh::SelectLod().
+  void Add(Mesh *mesh, const void *instance_data, size_t instance_count = 1,
+           size_t lod = 0);
+
+  /// @brief Draw everything added since Clear().
+  ///
+  /// The shader and other uniforms must have been set before calling this.
+  /// Draws are reordered so that those sharing buffers and a material go
+  /// together.
+  ///
+  /// @param renderer The renderer to draw with.
+  /// @param ignore_material Whether to ignore the meshes' materials.
+  void Render(Renderer &renderer, bool ignore_material = false);
+
+  /// @brief The number of draws added since Clear(), one per surface.
+  size_t num_draws() const { return draws_.size(); }
+
+  /// @brief The number of GL draw calls made by the last Render().
+  size_t num_draw_calls() const { return num_draw_calls_; }
+
+  /// @brief The per-instance attributes of all draws.
+  const InstanceBuffer &instances() const { return instances_; }
+
+ private:
+  MultiDrawBatch(const MultiDrawBatch &);
+  MultiDrawBatch &operator=(const MultiDrawBatch &);
+
+  // One surface of a mesh. Draws with equal buffers, primitive and material
+  // can go in the same indirect call.
+  struct Draw {
+    const Mesh *mesh;
+    Material *mat;
+    BufferHandle ibo;
+    uint32_t index_type;
+    // The glDrawElementsIndirect command fields, without the base vertex,
+    // which is always 0.
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    uint32_t base_instance;
+  };
+
+  // Whether `a` and `b` can go in the same call.
+  static bool Compatible(const Draw &a, const Draw &b);
+
+  void UploadCommands();
+
+  std::vector<Draw> draws_;
+  // Indices into draws_, grouped into compatible runs by Render().
+  std::vector<size_t> order_;
+  InstanceBuffer instances_;
+  // The indirect commands, five uint32s each, in the order of order_.
+  std::vector<uint32_t> commands_;
+  BufferHandle indirect_buffer_;
+  size_t indirect_capacity_;
+  size_t num_draw_calls_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_MULTI_DRAW_BATCH_H
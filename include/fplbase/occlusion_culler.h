@@ -0,0 +1,129 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef FPLBASE_OCCLUSION_CULLER_H
+#define FPLBASE_OCCLUSION_CULLER_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/render_state.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+class Mesh;
+class Renderer;
+class Shader;
+
+/// @file
+/// @addtogroup fplbase_renderer
+/// @{
+
+/// @class OcclusionCuller
+/// @brief Skips drawing objects hidden behind others, with hardware occlusion
+/// queries on their bounding boxes.
+///
+/// Objects are identified by small ids of the caller's choosing, e.g. their
+/// index in a scene. Each frame, draw the occluders (typically everything
+/// that was visible last frame) first, then wrap the bounding box queries in
+/// BeginQueries() and EndQueries(). The boxes are rasterized against the depth
+/// buffer without touching the color or depth buffers.
+///
+/// Results are never waited for: BeginFrame() picks up the queries the GPU
+/// has finished, and IsVisible() answers with the latest result, so an
+/// object that comes into view shows up a frame or two late. Objects that
+/// haven't been queried yet, or whose box reaches the camera, are visible.
+///
+/// Uses GL_ANY_SAMPLES_PASSED_CONSERVATIVE on OpenGL ES 3 and
+/// GL_ANY_SAMPLES_PASSED (GL_ARB_occlusion_query2) on desktop. Where neither
+/// is supported, supported() is false and every object is visible.
+class OcclusionCuller {
+ public:
+  /// @brief Create a culler. Needs a current GL context.
+  OcclusionCuller();
+  ~OcclusionCuller();
+
+  /// @brief Whether the GPU supports occlusion queries.
+  bool supported() const { return supported_; }
+
+  /// @brief Read back the results of the queries the GPU has finished. Call
+  /// once per frame, before IsVisible().
+  void BeginFrame();
+
+  /// @brief Set up the render state for Query(). Call after drawing the
+  /// occluders.
+  void BeginQueries(Renderer &renderer);
+
+  /// @brief Query whether a box is visible.
+  ///
+  /// Nothing is issued if the object's previous query is still in flight.
+  ///
+  /// @param renderer The renderer, between BeginQueries() and EndQueries().
+  /// @param id The object to query, small and dense: results are stored in
+  ///        a vector indexed by id.
+  /// @param model_view_projection The transform the object is drawn with.
+  /// @param min_position The minimum corner of the object space box.
+  /// @param max_position The maximum corner of the object space box.
+  void Query(Renderer &renderer, size_t id,
+             const mathfu::mat4 &model_view_projection,
+             const mathfu::vec3 &min_position,
+             const mathfu::vec3 &max_position);
+
+  /// @brief Query whether a mesh is visible, by its min_position() and
+  /// max_position().
+  void Query(Renderer &renderer, size_t id,
+             const mathfu::mat4 &model_view_projection, const Mesh &mesh);
+
+  /// @brief Restore the render state changed by BeginQueries().
+  void EndQueries(Renderer &renderer);
+
+  /// @brief Whether the object's latest query found any samples passing the
+  /// depth test. True if it hasn't been queried yet.
+  bool IsVisible(size_t id) const {
+    return id >= objects_.size() || objects_[id].visible;
+  }
+
+  /// @brief Forget an object's results, e.g. when its id is reused.
+  void Reset(size_t id);
+
+  /// @brief The number of queries issued since the last BeginFrame().
+  size_t num_queries() const { return num_queries_; }
+
+ private:
+  OcclusionCuller(const OcclusionCuller &);
+  OcclusionCuller &operator=(const OcclusionCuller &);
+
+  struct Object {
+    Object() : query(0), pending(false), visible(true) {}
+    unsigned int query;
+    bool pending;
+    bool visible;
+  };
+
+  bool supported_;
+  std::vector<Object> objects_;
+  // Draws the boxes. Compiled by the first BeginQueries().
+  Shader *shader_;
+  // The render state before BeginQueries().
+  RenderState saved_state_;
+  bool in_queries_;
+  size_t num_queries_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_OCCLUSION_CULLER_H
@@ -57,6 +57,27 @@ bool LoadFileWithDirectives(const char *filename, std::string *dest,
                             const std::set<std::string> &defines,
                             std::string *error_message);
 
+/// @brief Overloaded LoadFileWithDirectives to also report which files were
+/// \#included, e.g. to track them as build dependencies. They are reported
+/// even when they came from the cache that `ClearShaderIncludeCache()`
+/// clears, and so weren't loaded again.
+///
+/// @param[in] filename A UTF-8 C-string representing the file to load.
+/// @param[out] dest A pointer to a `std::string` to capture the preprocessed
+/// version of the file.
+/// @param[in] defines A set of identifiers which will be
+/// prefixed with \#define at the start of the file.
+/// @param[out] includes A pointer to a set that the names of the \#included
+/// files are added to, as written in their \#include statements.
+/// @param[out] error_message A pointer to a `std::string` that captures an
+/// error message (if the function returned `false`, indicating failure).
+/// @return If this function returns false, `error_message` indicates which
+/// directive caused the problem and why.
+bool LoadFileWithDirectives(const char *filename, std::string *dest,
+                            const std::set<std::string> &defines,
+                            std::set<std::string> *includes,
+                            std::string *error_message);
+
 /// @brief Overloaded LoadFileWithDirectives to allow pre-definining \#define
 /// identifiers in an array.
 ///
@@ -74,6 +95,17 @@ bool LoadFileWithDirectives(const char *filename, std::string *dest,
                             const char * const *defines,
                             std::string *error_message);
 
+/// @brief Forget the files that `LoadFileWithDirectives()` has \#included.
+///
+/// Each \#included file is loaded and parsed once, and then reused by every
+/// file that includes it, e.g. by every shader that AssetManager loads.
+/// `Shader::MarkDirty()` and `AssetManager::ResetGlobalShaderDefines()` call
+/// this, so shaders they reload see edited \#included files, and
+/// `SetLoadFileFunction()` has the same effect. Otherwise call it after changing
+/// \#included files on disk, so the next shader loads see the change. The
+/// top-level files are always loaded again.
+void ClearShaderIncludeCache();
+
 /// @brief Prepares OpenGL shaders for compilation across desktop or mobile.
 ///
 /// This function adds platform-specific definitions that allow the same
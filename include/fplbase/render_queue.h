@@ -0,0 +1,154 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_RENDER_QUEUE_H
+#define FPLBASE_RENDER_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/render_state.h"
+#include "mathfu/constants.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_renderer
+/// @{
+
+class Material;
+class Mesh;
+class RenderTarget;
+class Renderer;
+class Shader;
+
+/// @brief One draw for a RenderQueue: a submesh, and everything it's drawn
+/// with.
+struct RenderQueueItem {
+  RenderQueueItem()
+      : mesh(nullptr),
+        submesh(0),
+        lod(0),
+        shader(nullptr),
+        material(nullptr),
+        target(nullptr),
+        model_view_projection(mathfu::mat4::Identity()),
+        model(mathfu::mat4::Identity()),
+        color(mathfu::kOnes4f),
+        depth(0.0f) {}
+
+  /// The mesh to draw, and which of its submeshes.
+  Mesh *mesh;
+  size_t submesh;
+  /// The detail level to draw. See Mesh::SelectLod().
+  size_t lod;
+  const Shader *shader;
+  /// Overrides the submesh's own material, unless nullptr.
+  Material *material;
+  /// Where to draw, or nullptr for wherever the renderer is drawing. Targets
+  /// are drawn in the order they're first submitted.
+  const RenderTarget *target;
+  /// All of the state to draw with, viewport included. Start from
+  /// Renderer::GetRenderState(). Materials still set their blend mode.
+  RenderState render_state;
+  /// The values of the standard shader uniforms.
+  mathfu::mat4 model_view_projection;
+  mathfu::mat4 model;
+  mathfu::vec4 color;
+  /// Distance from the camera. Opaque draws are drawn nearest first, to
+  /// reject hidden pixels early, and translucent ones farthest first, to
+  /// blend correctly.
+  float depth;
+
+  MATHFU_DEFINE_CLASS_SIMD_AWARE_NEW_DELETE
+};
+
+/// @class RenderQueue
+/// @brief Collects draws and then draws them in an order that changes state
+/// as little as possible.
+///
+/// Each draw is sorted on a 64 bit key of its render target, whether it's
+/// translucent, its render state, shader and material, and its depth. Then
+/// only the render state, shader uniform and material changes between
+/// consecutive draws are made.
+///
+/// Everything an item points to must stay valid until Flush().
+class RenderQueue {
+ public:
+  RenderQueue() {}
+
+  /// @brief Queue one submesh.
+  void Submit(const RenderQueueItem &item);
+
+  /// @brief Queue every submesh of `item.mesh`, ignoring `item.submesh`.
+  void SubmitMesh(const RenderQueueItem &item);
+
+  /// @brief Draw everything queued, sorted, then empty the queue.
+  ///
+  /// Untargeted draws go to the framebuffer and viewport that were bound when
+  /// Flush() began, which are bound again afterwards. Leaves the renderer's
+  /// other render state, shader and transforms as set for the last draw.
+  void Flush(Renderer &renderer);
+
+  /// @brief Sort the queue, and return the targets Flush() will bind, in
+  /// order. nullptr is the framebuffer that was bound when Flush() began.
+  std::vector<const RenderTarget *> TargetOrder();
+
+  /// @brief Empty the queue without drawing.
+  void Clear();
+
+  /// @brief The number of submeshes queued.
+  size_t size() const { return draws_.size(); }
+
+ private:
+  struct Draw {
+    Mesh *mesh;
+    size_t submesh;
+    size_t lod;
+    const Shader *shader;
+    Material *material;
+    const RenderTarget *target;
+    size_t render_state;  // Index into `render_states_`.
+    // Packed, so draws can live in a std::vector without aligned allocation.
+    mathfu::vec4_packed model_view_projection[4];
+    mathfu::vec4_packed model[4];
+    mathfu::vec4_packed color;
+  };
+
+  // Dense ids, in order of first submission, of the objects in the key.
+  typedef std::unordered_map<const void *, uint32_t> IdMap;
+  static uint32_t Id(const void *object, IdMap *ids);
+  void Sort();
+  size_t RenderStateIndex(const RenderState &render_state);
+
+  std::vector<Draw> draws_;
+  // Each distinct render state, in order of first submission.
+  std::vector<PackedRenderState> render_states_;
+  IdMap target_ids_;
+  IdMap shader_ids_;
+  IdMap material_ids_;
+  // A (sort key, index into `draws_`) pair per draw.
+  std::vector<std::pair<uint64_t, uint32_t>> order_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_RENDER_QUEUE_H
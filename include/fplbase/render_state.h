@@ -86,6 +86,82 @@ enum CullingMode {
                        graphics API directly.  */
 };
 
+/// @class PackedRenderState
+/// @brief A RenderState packed into a few words, with a precomputed hash.
+///
+/// The enable flags and enums of every part of the state share one 64 bit
+/// word, and the remaining values, e.g. the viewport, follow it. Comparing two
+/// packed states compares their hashes first, so telling that nothing
+/// changed is usually one compare, and Diff() tells which parts changed
+/// without looking at every field.
+///
+/// Packing is exact, so Unpack() returns the state that was packed.
+class PackedRenderState {
+ public:
+  /// @brief The parts of a RenderState, as bits in the result of Diff().
+  enum Component {
+    kAlphaTestComponent = 1 << 0,
+    kBlendComponent = 1 << 1,
+    kCullComponent = 1 << 2,
+    kDepthComponent = 1 << 3,
+    kPointComponent = 1 << 4,
+    kScissorComponent = 1 << 5,
+    kStencilComponent = 1 << 6,
+    kViewportComponent = 1 << 7,
+    kAllComponents = (1 << 8) - 1
+  };
+
+  /// @brief Packs a default constructed RenderState.
+  PackedRenderState();
+
+  /// @brief Packs `render_state`.
+  explicit PackedRenderState(const RenderState &render_state);
+
+  /// @brief Writes the packed state to `render_state`.
+  void Unpack(RenderState *render_state) const;
+
+  /// @brief The Component bits of the parts that differ from `other`'s.
+  uint32_t Diff(const PackedRenderState &other) const;
+
+  /// @brief A hash of the whole state.
+  uint64_t hash() const { return hash_; }
+
+  /// @brief The enable flags and enums of the whole state, without the
+  /// values that don't fit, e.g. the stencil reference and the viewport.
+  uint64_t flags() const { return flags_; }
+
+  bool operator==(const PackedRenderState &other) const {
+    return hash_ == other.hash_ && flags_ == other.flags_ &&
+           ValuesEqual(other, 0, kNumValues);
+  }
+
+  bool operator!=(const PackedRenderState &other) const {
+    return !(*this == other);
+  }
+
+ private:
+  // Indices of the values that don't fit in `flags_`. Floats are stored as
+  // their bits.
+  enum {
+    kAlphaTestRefValue,
+    kPointSizeValue,
+    kBackStencilRefValue,
+    kBackStencilMaskValue,
+    kFrontStencilRefValue,
+    kFrontStencilMaskValue,
+    kScissorValues,
+    kViewportValues = kScissorValues + 4,
+    kNumValues = kViewportValues + 4
+  };
+
+  void Pack(const RenderState &render_state);
+  bool ValuesEqual(const PackedRenderState &other, int begin, int end) const;
+
+  uint64_t flags_;
+  uint32_t values_[kNumValues];
+  uint64_t hash_;
+};
+
 }  // namespace fplbase
 
 #endif  // FPLBASE_RENDER_STATE_H
@@ -68,7 +68,13 @@ enum DepthStencilFormat {
 /// drawn onto the RenderTarget instead of to the screen buffer.
 class RenderTarget {
  public:
-  RenderTarget() : initialized_(false) {}
+  RenderTarget()
+      : texture_format_(kRenderTargetTextureFormatNone),
+        depth_stencil_format_(kDepthStencilFormatNone),
+        num_views_(1),
+        samples_(1),
+        initialized_(false),
+        gpu_memory_size_(0) {}
   /// @brief Initialize a render target of the provided dimensions.
   ///
   /// Defaults the format to GL_UNSIGNED_BYTE, using a depth buffer.
@@ -84,6 +90,68 @@ class RenderTarget {
                   RenderTargetTextureFormat texture_format,
                   DepthStencilFormat depth_stencil_format);
 
+  /// @brief Initialize a multiview render target, with a texture array layer
+  /// of the provided dimensions per view.
+  ///
+  /// Draws into it go to all layers at once, with `gl_ViewID_OVR` telling
+  /// the vertex shader which one it's computing. Renderer::RenderStereo()
+  /// uses this to draw both eyes with one draw call. Needs
+  /// Renderer::SupportsMultiview(). The depth buffer is a texture array too,
+  /// since renderbuffers can't have layers.
+  ///
+  /// @param dimensions The dimensions of each layer.
+  /// @param texture_format The format of the generated texture array. Can't
+  ///        be kRenderTargetTextureFormatNone.
+  /// @param depth_stencil_format The depth stencil format of the layers.
+  /// @param num_views The number of layers, e.g. 2 for stereo.
+  void InitializeMultiview(const mathfu::vec2i& dimensions,
+                           RenderTargetTextureFormat texture_format,
+                           DepthStencilFormat depth_stencil_format,
+                           int num_views = 2);
+
+  /// @brief Initialize a multisampled render target, for anti-aliasing.
+  ///
+  /// With Renderer::SupportsMultisampledRenderToTexture(), the samples only
+  /// live in tile memory and are resolved into the texture as tiles are
+  /// written out, at no extra bandwidth. Otherwise they're stored in
+  /// multisampled renderbuffers, and Resolve() blits them into the texture.
+  /// Without multisampling support (OpenGL ES 2 without the extension), this
+  /// is a plain render target.
+  ///
+  /// @param dimensions The dimensions of the render target.
+  /// @param texture_format The format of the resolved texture. Can't be
+  ///        kRenderTargetTextureFormatA8, a depth format or
+  ///        kRenderTargetTextureFormatNone.
+  /// @param depth_stencil_format The depth stencil format of the samples.
+  /// @param samples The number of samples per pixel, lowered to what the GPU
+  ///        supports.
+  void InitializeMultisampled(const mathfu::vec2i& dimensions,
+                              RenderTargetTextureFormat texture_format,
+                              DepthStencilFormat depth_stencil_format,
+                              int samples);
+
+  /// @brief Resolve the samples of a multisampled render target into its
+  /// texture, ready for BindAsTexture(). Call after drawing into it. Does
+  /// nothing if the samples are resolved on-tile, or there are none.
+  ///
+  /// Discards the samples afterwards, so they're never written back to
+  /// memory on tiled GPUs. Leaves the screen bound as the render target.
+  void Resolve() const;
+
+  /// @brief Copy a rectangle of this render target into a rectangle of
+  /// `destination`, e.g. RenderTarget::ScreenRenderTarget(), scaling it with
+  /// linear filtering if their sizes differ.
+  ///
+  /// Needs kFeatureLevel30. A multisampled source can't be scaled, so
+  /// Resolve() it and blit it at the same size. Leaves `destination` bound
+  /// as the render target, without changing the viewport.
+  ///
+  /// @param destination The render target to copy to.
+  /// @param source_rect The area of this render target to copy.
+  /// @param destination_rect The area of `destination` to copy it to.
+  void BlitTo(const RenderTarget& destination, const Viewport& source_rect,
+              const Viewport& destination_rect) const;
+
   /// @brief Deletes the associated opengl resources associated with the
   ///        RenderTarget.
   void Delete();
@@ -100,10 +168,25 @@ class RenderTarget {
   ///
   /// Primarily useful when rendering the RenderTarget's texture as part of a
   /// mesh.  Throws an assert if the RenderTarget does not have a texture.
+  /// Multiview render targets bind as a GL_TEXTURE_2D_ARRAY, for a
+  /// `sampler2DArray`.
   ///
   /// @param texture_number The index of the texture to make active.
   void BindAsTexture(int texture_number) const;
 
+  /// @brief Tells the GPU that the contents of some attachments are no longer
+  /// needed.
+  ///
+  /// Call while this is the current render target: at the start of a pass
+  /// that overwrites everything, so the GPU doesn't load the old contents, or
+  /// at its end for attachments that won't be read again (typically depth and
+  /// stencil), so tile-based GPUs don't write them back to memory. Does
+  /// nothing without Renderer::SupportsInvalidateFramebuffer().
+  ///
+  /// @param color Discard the color (or depth texture) attachment.
+  /// @param depth_stencil Discard the depth and stencil buffer.
+  void Invalidate(bool color, bool depth_stencil) const;
+
   /// @brief Checks if this rendertarget refer to an off-screen texture.
   ///
   /// This is important because rendertargets that aren't texture-based will
@@ -135,18 +218,67 @@ class RenderTarget {
   /// @brief Returns true if it has been initialized, false otherwise.
   bool initialized() const { return initialized_; }
 
+  /// @brief The size of the render target, in pixels.
+  const mathfu::vec2i& dimensions() const { return dimensions_; }
+
+  /// @brief The format of the texture, or kRenderTargetTextureFormatNone.
+  RenderTargetTextureFormat texture_format() const { return texture_format_; }
+
+  /// @brief The format of the depth buffer, or kDepthStencilFormatNone.
+  DepthStencilFormat depth_stencil_format() const {
+    return depth_stencil_format_;
+  }
+
+  /// @brief The number of layers of a multiview render target, or 1.
+  int num_views() const { return num_views_; }
+
+  /// @brief The number of samples per pixel, 1 unless multisampled.
+  int samples() const { return samples_; }
+
+  /// @brief Whether this was initialized with InitializeMultiview(), so its
+  /// texture is a GL_TEXTURE_2D_ARRAY.
+  bool IsMultiview() const { return num_views_ > 1; }
+
   /// @brief Gets the RenderTarget that corresponds to the screen.
   ///
   /// @param renderer The renderer object to use.
   /// @return Returns the RenderTarget that corresponds to the screen.
   static RenderTarget ScreenRenderTarget(Renderer& renderer);
 
+  /// @brief Gets a RenderTarget for whichever framebuffer is bound, e.g. the
+  /// screen's, or one an HMD renders into, to bind again later.
+  ///
+  /// @param renderer The renderer object to use.
+  /// @return Returns a RenderTarget the size of the screen, which doesn't own
+  /// the framebuffer.
+  static RenderTarget BoundRenderTarget(Renderer& renderer);
+
+  /// @brief The GPU memory of the texture and depth buffer, in bytes, as
+  /// counted towards RendererBase::gpu_memory(). 0 for the screen.
+  size_t gpu_memory_size() const { return gpu_memory_size_; }
+
  private:
+  // The bytes allocated for a render target of these formats.
+  static size_t CalculateMemorySize(const mathfu::vec2i& dimensions,
+                                    RenderTargetTextureFormat texture_format,
+                                    DepthStencilFormat depth_stencil_format);
+
   mathfu::vec2i dimensions_;
   BufferHandle framebuffer_id_;
   TextureHandle rendered_texture_id_;
+  // A renderbuffer, or a texture array for multiview render targets.
   BufferHandle depth_buffer_id_;
+  RenderTargetTextureFormat texture_format_;
+  DepthStencilFormat depth_stencil_format_;
+  int num_views_;
+  int samples_;
+  // For multisampled targets resolved with Resolve(): the renderbuffer that
+  // holds the color samples, and the framebuffer of the resolved texture.
+  // Invalid otherwise.
+  BufferHandle color_buffer_id_;
+  BufferHandle resolve_framebuffer_id_;
   bool initialized_;
+  size_t gpu_memory_size_;
 };
 
 /// @}
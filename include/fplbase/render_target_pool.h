@@ -0,0 +1,112 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef FPLBASE_RENDER_TARGET_POOL_H
+#define FPLBASE_RENDER_TARGET_POOL_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/render_target.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_render_target
+/// @{
+
+/// @class RenderTargetPool
+/// @brief Recycles transient render targets, e.g. the intermediate buffers of
+/// a post-processing chain, instead of creating and deleting them every
+/// frame.
+///
+/// Acquire() hands out a free render target of the requested size and
+/// formats, creating one only when there's none, and Release() gives it
+/// back. Targets left free for more than `max_idle_frames` calls to
+/// EndFrame() are deleted, so the pool shrinks back when a resolution or
+/// effect changes.
+///
+/// The contents of an acquired target are undefined. Acquire() binds it and
+/// discards its old contents with RenderTarget::Invalidate(), so tile-based
+/// GPUs don't load them; call `Invalidate(false, true)` at the end of a pass
+/// whose depth buffer isn't needed any more, so they don't store it either.
+class RenderTargetPool {
+ public:
+  /// @brief The default number of frames a target stays free before it's
+  /// deleted.
+  static const int kDefaultMaxIdleFrames = 4;
+
+  explicit RenderTargetPool(int max_idle_frames = kDefaultMaxIdleFrames);
+  ~RenderTargetPool();
+
+  /// @brief Get a render target that no one else is using, and make it the
+  /// current render target.
+  ///
+  /// @param dimensions The size of the render target.
+  /// @param texture_format The format of its texture.
+  /// @param depth_stencil_format The format of its depth buffer.
+  /// @param samples The samples per pixel. More than 1 gets a
+  ///        RenderTarget::InitializeMultisampled() target, to Resolve()
+  ///        before it's read.
+  /// @return Returns a render target owned by the pool, valid until it's
+  ///         passed to Release().
+  RenderTarget *Acquire(const mathfu::vec2i &dimensions,
+                        RenderTargetTextureFormat texture_format,
+                        DepthStencilFormat depth_stencil_format,
+                        int samples = 1);
+
+  /// @brief Give back a target from Acquire(), for reuse once whoever reads
+  /// it is done. Its texture stays valid until the next Acquire().
+  void Release(RenderTarget *target);
+
+  /// @brief Delete the targets that have been free too long. Call once per
+  /// frame.
+  void EndFrame();
+
+  /// @brief Delete all free render targets.
+  void Clear();
+
+  /// @brief The number of render targets the pool holds, in use or free.
+  size_t size() const { return entries_.size(); }
+
+  /// @brief The number of render targets handed out and not released.
+  size_t num_in_use() const;
+
+ private:
+  RenderTargetPool(const RenderTargetPool &);
+  RenderTargetPool &operator=(const RenderTargetPool &);
+
+  struct Entry {
+    RenderTarget *target;
+    // The samples asked for, which the target may have fewer of.
+    int samples;
+    bool in_use;
+    // Calls to EndFrame() since the target was released.
+    int idle_frames;
+  };
+
+  // Delete the free entries for which `expired` returns true.
+  template <typename Predicate>
+  void DeleteFree(Predicate expired);
+
+  std::vector<Entry> entries_;
+  int max_idle_frames_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_RENDER_TARGET_POOL_H
@@ -0,0 +1,119 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_RENDER_THREAD_H
+#define FPLBASE_RENDER_THREAD_H
+
+#include <functional>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/command_list.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_renderer
+/// @{
+
+class Renderer;
+struct RenderThreadImpl;
+
+/// @class RenderThread
+/// @brief Renders on a thread of its own, one frame behind the game thread.
+///
+/// Normally the game simulates and renders each frame on one thread, so the
+/// CPU time of both adds up. With a RenderThread, the game thread records
+/// each frame into frame_commands() and hands it over with SubmitFrame(),
+/// then goes on to simulate the next frame while the render thread replays
+/// the one submitted, makes the graphics API calls, and calls
+/// Renderer::AdvanceFrame() to swap buffers. The two command lists are
+/// swapped each frame, so neither thread waits for the other unless one of
+/// them takes longer than a frame.
+///
+///     renderer.Initialize(...);
+///     RenderThread render_thread;
+///     render_thread.Start(&renderer);
+///     while (!input.exit_requested()) {
+///       input.AdvanceFrame(&renderer.window_size());
+///       Simulate(input.DeltaTime());
+///       CommandList &commands = render_thread.frame_commands();
+///       commands.ClearFrameBuffer(mathfu::kZeros4f);
+///       RecordScene(&commands);
+///       render_thread.SubmitFrame(input.minimized(), input.Time());
+///     }
+///     render_thread.Stop();
+///
+/// The graphics context is moved to the render thread by Start(), and back
+/// by Stop(). In between, the game thread must not call anything that uses
+/// the graphics API, such as the Renderer or AssetManager::TryFinalize();
+/// pass those to RunOnRenderThread() instead. See CommandList for what must
+/// stay valid until a frame is replayed.
+///
+/// Start() needs a backend that can move its context between threads, which
+/// the SDL one can. Where it can't, Start() fails, and the game can render on
+/// its own thread as usual.
+class RenderThread {
+ public:
+  RenderThread();
+  /// @brief Calls Stop().
+  ~RenderThread();
+
+  /// @brief Move the graphics context of `renderer` to a new render thread.
+  ///
+  /// @param renderer An initialized Renderer, which the render thread uses
+  /// until Stop().
+  /// @return Returns false if the context couldn't be moved, in which case
+  /// it's still current on the calling thread.
+  bool Start(Renderer *renderer);
+
+  /// @brief Render what's already been submitted, then end the render
+  /// thread and make the graphics context current on the calling thread
+  /// again. Commands recorded since the last SubmitFrame() are dropped.
+  void Stop();
+
+  /// @brief Returns true between Start() and Stop().
+  bool running() const;
+
+  /// @brief The list to record the next frame into, on the game thread.
+  CommandList &frame_commands();
+
+  /// @brief Hand the frame recorded in frame_commands() to the render thread.
+  ///
+  /// Waits for the render thread to finish the frame before, so that its
+  /// command list can be recorded into next.
+  ///
+  /// @param minimized Passed to Renderer::AdvanceFrame() after the frame.
+  /// @param time Passed to Renderer::AdvanceFrame() after the frame.
+  void SubmitFrame(bool minimized, double time);
+
+  /// @brief Run `task` on the render thread, before the next frame it
+  /// replays, e.g. to finalize loaded assets. Tasks run in the order posted.
+  void RunOnRenderThread(const std::function<void(Renderer &)> &task);
+
+  /// @brief Wait for the render thread to finish everything submitted so
+  /// far.
+  void WaitForIdle();
+
+ private:
+  RenderThread(const RenderThread &);
+  RenderThread &operator=(const RenderThread &);
+
+  RenderThreadImpl *impl_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_RENDER_THREAD_H
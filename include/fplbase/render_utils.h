@@ -17,6 +17,7 @@
 
 #include "fplbase/handles.h"
 #include "fplbase/mesh.h"
+#include "fplbase/vertex_format.h"
 
 namespace fplbase {
 
@@ -24,7 +25,10 @@ namespace fplbase {
 ///
 /// Renders primitives using vertex data directly in local memory. This is a
 /// convenient alternative to creating a Mesh instance for small amounts of
-/// data, or dynamic data.
+/// data, or dynamic data. On GL ES 3.0+ and desktop GL 3+ the data is copied
+/// into a streaming buffer object, rather than read from client memory, and
+/// drawn with a vertex array object kept for each format, so consecutive
+/// draws don't set up their attributes.
 ///
 /// @param primitive The type of primitive to render the data as.
 /// @param vertex_count The total number of vertices.
@@ -59,7 +63,10 @@ void RenderArray(Mesh::Primitive primitive, int index_count,
 ///
 /// Renders primitives using vertex data directly in local memory. This is a
 /// convenient alternative to creating a Mesh instance for small amounts of
-/// data, or dynamic data.
+/// data, or dynamic data. On GL ES 3.0+ and desktop GL 3+ the data is copied
+/// into a streaming buffer object, rather than read from client memory, and
+/// drawn with a vertex array object kept for each format, so consecutive
+/// draws don't set up their attributes.
 ///
 /// @param primitive The type of primitive to render the data as.
 /// @param vertex_count The total number of vertices.
@@ -104,6 +111,8 @@ void RenderAAQuadAlongXNinePatch(const mathfu::vec3 &bottom_left,
 /// @brief Convenience method for setting vertex attributes.
 ///
 /// Sets the vertex attributes to prepare for rendering or initializing a VAO.
+/// Per-instance attributes, such as kInstanceTransform3x4f, advance once per
+/// instance.
 ///
 /// @param vbo The vertex buffer object to set.
 /// @param attributes The array of vertex attributes to set.
@@ -119,6 +128,64 @@ void SetAttributes(unsigned int vbo, const Attribute *attributes, int stride,
 /// @param attributes The array of vertex attributes to unset.
 void UnSetAttributes(const Attribute *attributes);
 
+namespace internal {
+
+// What SetAttributes() does before pointing any attribute: undo what the
+// last mesh draw left bound, and bind `vbo` to GL_ARRAY_BUFFER.
+void BeginSetAttributes(unsigned int vbo);
+
+// Enable and point the `rows` consecutive attribute arrays from `location`,
+// or disable them.
+void SetAttributeArray(unsigned int location, int components,
+                       VertexComponentType type, bool normalized, int rows,
+                       int stride, const char *pointer);
+void UnSetAttributeArray(unsigned int location, int rows);
+
+}  // namespace internal
+
+/// @brief Sets the vertex attributes of a compile-time vertex format.
+///
+/// The same as SetAttributes() with `format`'s runtime array and stride, but
+/// with each attribute's location, type and offset known up front, so
+/// nothing walks the format.
+///
+/// @param vbo The vertex buffer object to set.
+/// @param format The vertex format, e.g.
+///        `VertexFormat<kPosition3f, kTexCoord2f>()`.
+/// @param buffer Pointer to data the buffer if is in memory, or 0 if in GPU.
+template <Attribute... Attributes>
+void SetAttributes(unsigned int vbo, VertexFormat<Attributes...> format,
+                   const char *buffer) {
+  (void)format;
+  internal::BeginSetAttributes(vbo);
+  const int stride = static_cast<int>(VertexFormat<Attributes...>::kStride);
+  const int unused[] = {
+      0, (internal::SetAttributeArray(
+              VertexAttributeTraits<Attributes>::kLocation,
+              VertexAttributeTraits<Attributes>::kComponents,
+              VertexAttributeTraits<Attributes>::kType,
+              VertexAttributeTraits<Attributes>::kNormalized,
+              VertexAttributeTraits<Attributes>::kRows, stride,
+              buffer + VertexFormat<Attributes...>::template Offset<
+                           Attributes>()),
+          0)...};
+  (void)unused;
+}
+
+/// @brief Disables the vertex attributes of a compile-time vertex format.
+///
+/// @param format The vertex format to unset.
+template <Attribute... Attributes>
+void UnSetAttributes(VertexFormat<Attributes...> format) {
+  (void)format;
+  const int unused[] = {
+      0, (internal::UnSetAttributeArray(
+              VertexAttributeTraits<Attributes>::kLocation,
+              VertexAttributeTraits<Attributes>::kRows),
+          0)...};
+  (void)unused;
+}
+
 }  // namespace fplbase
 
 #endif  // FPL_RENDER_UTILS_H
@@ -17,7 +17,13 @@
 
 #include "fplbase/config.h"  // Must come first.
 
+#include <string>
+#include <unordered_set>
+
 #include "fplbase/environment.h"
+#include "fplbase/frame_pacer.h"
+#include "fplbase/frame_stats.h"
+#include "fplbase/gpu_debug.h"
 #include "fplbase/material.h"
 #include "fplbase/mesh.h"
 #include "fplbase/render_state.h"
@@ -31,12 +37,89 @@ namespace fplbase {
 
 struct RendererBaseImpl;
 struct RendererImpl;
+class BonePaletteBuffer;
+class InstanceBuffer;
 class Renderer;
 
 /// @file
 /// @addtogroup fplbase_renderer
 /// @{
 
+/// @brief The kinds of GPU allocations RendererBase keeps track of.
+enum GpuMemoryCategory {
+  kGpuMemoryTextures,
+  kGpuMemoryMeshes,
+  kGpuMemoryRenderTargets,
+  kGpuMemoryCategoryCount
+};
+
+/// @brief GPU memory allocated by the objects of one GpuMemoryCategory, or
+/// all of them.
+struct GpuMemoryStats {
+  GpuMemoryStats() : bytes(0), peak_bytes(0), num_objects(0) {}
+  /// The bytes currently allocated.
+  size_t bytes;
+  /// The most bytes allocated at any time since startup, or since
+  /// ResetGpuMemoryPeaks().
+  size_t peak_bytes;
+  /// The number of objects currently holding an allocation.
+  size_t num_objects;
+};
+
+/// @brief The rendering work done in one frame, as counted by fplbase.
+///
+/// Counted where fplbase issues the GL calls, so on the render thread.
+struct RenderCounters {
+  RenderCounters()
+      : draw_calls(0),
+        state_changes(0),
+        texture_binds(0),
+        shader_switches(0),
+        uniform_uploads(0),
+        buffer_upload_bytes(0),
+        texture_upload_bytes(0) {}
+  /// Draw calls, including instanced and indirect ones.
+  size_t draw_calls;
+  /// Render state sent to GL: enables, and blend, depth, stencil, cull,
+  /// point, scissor and viewport state.
+  size_t state_changes;
+  /// Textures bound to a unit that had a different texture bound.
+  size_t texture_binds;
+  /// Programs made current by Renderer::SetShader().
+  size_t shader_switches;
+  /// Uniform values sent to programs, by Renderer::SetShader(),
+  /// Renderer::RenderStereo() and Shader::SetUniform().
+  size_t uniform_uploads;
+  /// Bytes sent to vertex, index, instance, uniform and indirect draw
+  /// buffers.
+  size_t buffer_upload_bytes;
+  /// Bytes of texels sent to textures.
+  size_t texture_upload_bytes;
+};
+
+/// @brief Where the time went between RendererBase::Initialize() and the
+/// first frame, in seconds. Phases that haven't happened yet are 0.
+struct StartupTimes {
+  StartupTimes()
+      : context_creation(0),
+        capability_probe(0),
+        first_shader_compile(0),
+        first_asset_load(0),
+        first_frame(0) {}
+  /// Environment::Initialize(): creating the window and GL context.
+  double context_creation;
+  /// Querying the extensions and limits of the context.
+  double capability_probe;
+  /// Duration of the first CompileAndLinkShader() or RecompileShader().
+  double first_shader_compile;
+  /// From the start of Initialize() until the first asset, of any kind, is
+  /// finalized.
+  double first_asset_load;
+  /// From the start of Initialize() until the end of the first
+  /// AdvanceFrame().
+  double first_frame;
+};
+
 /// @class RendererBase
 /// @brief Manages the rendering system, handling the window and resources.
 ///
@@ -135,7 +218,9 @@ class RendererBase {
                           Shader *shader);
 
   /// @brief Checks for multithreading API.
-  /// Returns true if the graphics API allows multi-threading
+  /// Returns true if the graphics API allows multi-threading.
+  /// With OpenGL it doesn't, but draws can still be prepared on other threads
+  /// by recording them in CommandLists.
   bool AllowMultiThreading();
 
   /// @brief Set bone transforms in vertex shader uniforms.
@@ -241,6 +326,160 @@ class RendererBase {
   /// @brief Returns if multiview capabilities are supported by the hardware.
   bool SupportsMultiview() const;
 
+  /// @brief Returns if textures can be allocated as immutable storage, with
+  /// glTexStorage2D.
+  bool SupportsTextureStorage() const;
+
+  /// @brief Returns if many draws can be submitted in one
+  /// glMultiDrawElementsIndirect call, as MultiDrawBatch does.
+  bool SupportsMultiDrawIndirect() const;
+
+  /// @brief Returns if GPU timestamps can be queried, as GpuProfiler does.
+  bool SupportsTimerQueries() const;
+
+  /// @brief Returns if boolean occlusion queries are supported, as
+  /// OcclusionCuller uses.
+  bool SupportsOcclusionQueries() const;
+
+  /// @brief Returns if framebuffer contents can be discarded with
+  /// glInvalidateFramebuffer, as RenderTarget::Invalidate() does.
+  bool SupportsInvalidateFramebuffer() const;
+
+  /// @brief Returns if multisampled render targets can be resolved on-tile,
+  /// with GL_EXT_multisampled_render_to_texture.
+  bool SupportsMultisampledRenderToTexture() const;
+
+  /// @brief Returns if the driver compiles and links shaders in the
+  /// background, with GL_KHR_parallel_shader_compile. If so, shaders loaded
+  /// through the AssetManager don't stall the main thread while compiling.
+  bool SupportsParallelShaderCompile() const;
+
+  /// @brief Returns if linked shader programs can be saved and reloaded with
+  /// glGetProgramBinary and glProgramBinary.
+  bool SupportsProgramBinary() const;
+
+  /// @brief Returns if the context has the GL extension `name`, e.g.
+  /// "GL_EXT_texture_filter_anisotropic". Valid after Initialize().
+  bool SupportsExtension(const char *name) const;
+
+  /// @brief Save each shader program linked from now on in `directory`, and
+  /// load it from there instead of compiling it the next time it's needed,
+  /// for example, on the next run of the app.
+  ///
+  /// Programs are keyed by their sources after preprocessing, so each set of
+  /// defines is cached separately. Binaries saved by a different driver
+  /// version are ignored and replaced. `directory` must exist and be
+  /// writable; GetStoragePath() is a good choice.
+  ///
+  /// @return Returns false if the driver doesn't support program binaries,
+  /// in which case shaders are still compiled as usual.
+  bool EnableProgramBinaryCache(const char *directory);
+
+  /// @brief The GPU memory allocated by Texture, Mesh or RenderTarget
+  /// objects. The sizes are the ones the objects report with
+  /// gpu_memory_size(), which for textures and meshes are those of
+  /// CalculateMemorySize(). Drivers may use a bit more.
+  const GpuMemoryStats &gpu_memory(GpuMemoryCategory category) const {
+    return gpu_memory_[category];
+  }
+
+  /// @brief The GPU memory allocated by all categories together. Its
+  /// peak_bytes is the high-water mark of the total.
+  const GpuMemoryStats &total_gpu_memory() const {
+    return gpu_memory_[kGpuMemoryCategoryCount];
+  }
+
+  /// @brief Start tracking the high-water marks from the current allocations,
+  /// e.g. at the start of each level.
+  void ResetGpuMemoryPeaks();
+
+  /// @brief Frame and swap times of recent frames, recorded by
+  /// AdvanceFrame(). Frames while minimized aren't recorded.
+  const FrameStats &frame_stats() const { return frame_stats_; }
+  FrameStats &frame_stats() { return frame_stats_; }
+
+  /// @brief Hold frames to a steady rate, with each one starting on a vsync.
+  ///
+  /// AdvanceFrame() then waits, after the buffer swap, for the vsync that
+  /// frame_pacer() picks for the next frame. On Android the vsyncs come from
+  /// the choreographer; elsewhere the swap interval is set to match, and the
+  /// end of each swap is taken as a vsync.
+  void set_frame_pacing(FramePacing pacing);
+
+  /// @brief Frame pacing, fed from AdvanceFrame(). Its
+  /// predicted_present_time() is when the frame being built will be seen.
+  const FramePacer &frame_pacer() const { return frame_pacer_; }
+  FramePacer &frame_pacer() { return frame_pacer_; }
+
+  /// @brief How long each phase of startup took. Complete once the first
+  /// frame and asset are done.
+  const StartupTimes &startup_times() const { return startup_times_; }
+
+  /// @brief Appends a line per phase of startup_times(), with its name and
+  /// milliseconds, to `report`. Log it, or save it with SaveFile(), to see
+  /// what to shave off the time to the first frame.
+  void DumpStartupTimes(std::string *report) const;
+
+  /// @brief The rendering work done in the last frame, i.e. between the
+  /// last two calls to AdvanceFrame(). Each value is also recorded as a
+  /// trace counter, see fplbase/trace.h.
+  const RenderCounters &render_counters() const {
+    return last_render_counters_;
+  }
+
+  /// @brief The rendering work done so far in the current frame.
+  const RenderCounters &current_render_counters() const {
+    return render_counters_;
+  }
+
+  // For internal use only. Adds `amount` to a counter of the current frame.
+  // Does nothing without a RendererBase, or on a shared context thread.
+  static void CountRenderWork(size_t RenderCounters::*counter,
+                              size_t amount = 1) {
+    if (the_base_raw_ && !shared_context_thread_) {
+      the_base_raw_->render_counters_.*counter += amount;
+    }
+  }
+
+  // For internal use only. Marks the calling thread as one making GL calls on
+  // a context shared with the renderer's, e.g. AsyncLoader's upload thread.
+  // Its work isn't counted in the renderer's counters, and bypasses the
+  // renderer's caches of GL state, which are for its own context.
+  static void set_shared_context_thread(bool shared) {
+    shared_context_thread_ = shared;
+  }
+  static bool shared_context_thread() { return shared_context_thread_; }
+
+  // For internal use only. Called by AsyncLoader as each asset is finalized,
+  // to record the first one in startup_times().
+  static void RecordAssetFinalized() {
+    if (the_base_raw_ && the_base_raw_->startup_times_.first_asset_load == 0 &&
+        the_base_raw_->initialize_start_ > 0) {
+      the_base_raw_->RecordFirstAssetLoad();
+    }
+  }
+
+  // For internal use only. Records that an object's allocation changed from
+  // `old_size` to `new_size` bytes. Does nothing without a RendererBase.
+  static void TrackGpuMemory(GpuMemoryCategory category, size_t old_size,
+                             size_t new_size);
+
+  // For internal use only. Starts compiling and linking a program like
+  // CompileAndLinkShader(), without waiting for the result.
+  PendingShaderLink StartCompileAndLinkShader(const char *vs_source,
+                                              const char *ps_source);
+
+  // For internal use only. Whether the driver is done with `link`, so that
+  // FinishCompileAndLinkShader() won't wait for it. Always true without
+  // SupportsParallelShaderCompile().
+  bool IsShaderLinkDone(const PendingShaderLink &link) const;
+
+  // For internal use only. Checks the result of `link`, and puts it in
+  // `shader` like RecompileShader(), or in a new Shader if that's null.
+  // Deletes the program on failure.
+  Shader *FinishCompileAndLinkShader(const PendingShaderLink &link,
+                                     Shader *shader);
+
   // For internal use only.
   RendererBaseImpl* impl() { return impl_; }
 
@@ -270,6 +509,8 @@ class RendererBase {
   // supported texture formats, etc.
   bool InitializeRenderingState();
 
+  void RecordFirstAssetLoad();
+
   double time_;
 
   std::string last_error_;
@@ -280,7 +521,34 @@ class RendererBase {
 
   bool supports_texture_npot_;
   bool supports_multiview_;
+  bool supports_texture_storage_;
   bool supports_instancing_;
+  bool supports_multi_draw_indirect_;
+  bool supports_timer_queries_;
+  bool supports_occlusion_queries_;
+  bool supports_invalidate_framebuffer_;
+  bool supports_multisampled_render_to_texture_;
+  bool supports_parallel_shader_compile_;
+  bool supports_program_binary_;
+  // The context's extensions, listed once by InitializeRenderingState().
+  std::unordered_set<std::string> extensions_;
+
+  // When Initialize() started, which the times to the first frame and asset
+  // are measured from.
+  double initialize_start_;
+  StartupTimes startup_times_;
+
+  FrameStats frame_stats_;
+  // The current frame's counters, and those of the last complete frame.
+  RenderCounters render_counters_;
+  RenderCounters last_render_counters_;
+  // When the last buffer swap finished, or 0 if there's no previous frame to
+  // measure from.
+  double last_swap_end_;
+
+  FramePacer frame_pacer_;
+  // The swap interval last set on environment_.
+  int swap_interval_;
 
   Shader *force_shader_;
   BlendMode force_blend_mode_;
@@ -288,6 +556,9 @@ class RendererBase {
 
   int max_vertex_uniform_components_;
 
+  // Per category, followed by the total.
+  GpuMemoryStats gpu_memory_[kGpuMemoryCategoryCount + 1];
+
   // Current version of the library.
   const FplBaseVersion *version_;
 
@@ -300,6 +571,7 @@ class RendererBase {
   // There is no way to get the raw pointer from the weak_ptr above, so store it
   // unsafely here. This is necessary to support the Get() call.
   static RendererBase* the_base_raw_;
+  static thread_local bool shared_context_thread_;
 
   // Ensure creation and deletion of singleton is atomic.
   static fplutil::Mutex the_base_mutex_;
@@ -326,9 +598,32 @@ class Renderer {
   /// @param mesh The mesh object to be rendered.
   /// @param ignore_material Whether to ignore the meshes defined material.
   /// @param instances The number of instances to be rendered.
-  void Render(Mesh *mesh, bool ignore_material = false, size_t instances = 1);
+  /// @param lod The detail level to draw, e.g. from Mesh::SelectLod().
+  void Render(Mesh *mesh, bool ignore_material = false, size_t instances = 1,
+              size_t lod = 0);
+
+  /// @brief Render one instance of a mesh for each instance in a buffer.
+  ///
+  /// Draws all of `instances` in one call per submesh, with the buffer's
+  /// per-instance attributes, e.g. a transform and color for each tree in a
+  /// forest. Needs OpenGL ES 3.0 / OpenGL 3.3.
+  ///
+  /// @param mesh The mesh object to be rendered.
+  /// @param instances The per-instance attributes, uploaded with
+  ///        InstanceBuffer::Upload(). Nothing is drawn if it's empty.
+  /// @param ignore_material Whether to ignore the meshes defined material.
+  /// @param lod The detail level to draw, e.g. from Mesh::SelectLod().
+  void Render(Mesh *mesh, const InstanceBuffer &instances,
+              bool ignore_material = false, size_t lod = 0);
 
   /// @brief Render a mesh into stereoscopic viewports.
+  ///
+  /// If multiview is supported and `shader` is a multiview shader (see
+  /// Shader::multiview()), both eyes are drawn with a single draw call per
+  /// submesh into the bound multiview render target (see
+  /// RenderTarget::InitializeMultiview()), whose layers share `viewport[0]`.
+  /// Otherwise each eye is drawn in turn, into its own viewport.
+  ///
   /// @param mesh The mesh object to be rendered.
   /// @param shader The shader object to be used.
   /// @param viewport An array with two elements (left and right parameters) for
@@ -339,10 +634,12 @@ class Renderer {
   /// parameters) for camera position.
   /// @param ignore_material Whether to ignore the meshes defined material.
   /// @param instances The number of instances to be rendered.
+  /// @param lod The detail level to draw, e.g. from Mesh::SelectLod().
   void RenderStereo(Mesh *mesh, const Shader *shader, const Viewport *viewport,
                     const mathfu::mat4 *mvp,
                     const mathfu::vec3 *camera_position,
-                    bool ignore_material = false, size_t instances = 1);
+                    bool ignore_material = false, size_t instances = 1,
+                    size_t lod = 0);
 
   /// @brief Render a submesh.
   ///
@@ -353,8 +650,9 @@ class Renderer {
   /// @param mesh The mesh object containing the submesh to be rendered.
   /// @param ignore_material Whether to ignore the mesh's defined material.
   /// @param instances The number of instances to be rendered.
+  /// @param lod The detail level to draw, e.g. from Mesh::SelectLod().
   void RenderSubMesh(Mesh *mesh, size_t submesh, bool ignore_material = false,
-                     size_t instances = 1);
+                     size_t instances = 1, size_t lod = 0);
 
   /// @brief Shader uniform: model_view_projection
   /// @return Returns the current model view projection being used.
@@ -413,6 +711,37 @@ class Renderer {
     bone_transforms_ = bone_transforms;
     num_bones_ = num_bones;
   }
+  /// @brief Shader uniform: bone_dual_quaternions
+  /// @return Returns the dual quaternions set by SetBoneDualQuaternions().
+  const mathfu::vec4_packed *bone_dual_quaternions() const {
+    return bone_dual_quaternions_;
+  }
+  /// @brief The number of bones in the bone_dual_quaternions() array.
+  int num_dual_quaternion_bones() const { return num_dual_quaternion_bones_; }
+  /// @brief Sets the shader uniform bone dual quaternions, for shaders with
+  /// kSkinningModeDualQuaternion.
+  /// @param bone_dual_quaternions Two vec4s per bone, from
+  ///        Mesh::GatherShaderDualQuaternions().
+  /// @param num_bones The number of bones, half the length of the array.
+  void SetBoneDualQuaternions(const mathfu::vec4_packed *bone_dual_quaternions,
+                              int num_bones) {
+    bone_dual_quaternions_ = bone_dual_quaternions;
+    num_dual_quaternion_bones_ = num_bones;
+  }
+  /// @brief Sets a uniform buffer of bone transforms, for shaders that
+  /// declare a `BonePalette` uniform block. Those shaders ignore
+  /// bone_transforms(). See BonePaletteBuffer.
+  /// @param palette The uploaded buffer, or nullptr for none.
+  /// @param offset The byte offset of the palette in the buffer, as returned
+  ///        by BonePaletteBuffer::Add().
+  void SetBonePalette(const BonePaletteBuffer *palette, size_t offset) {
+    bone_palette_ = palette;
+    bone_palette_offset_ = offset;
+  }
+  /// @brief The uniform buffer of bone transforms set by SetBonePalette().
+  const BonePaletteBuffer *bone_palette() const { return bone_palette_; }
+  /// @brief The byte offset set by SetBonePalette().
+  size_t bone_palette_offset() const { return bone_palette_offset_; }
 
   /// @brief Clears the framebuffer.
   ///
@@ -503,6 +832,24 @@ class Renderer {
   /// @brief Cleans up the resources initialized by the renderer.
   void ShutDown() { base_->ShutDown(); }
 
+  /// @brief Frame and swap times of recent frames.
+  const FrameStats &frame_stats() const { return base_->frame_stats(); }
+
+  /// @brief Frame pacing, see RendererBase::set_frame_pacing().
+  void set_frame_pacing(FramePacing pacing) { base_->set_frame_pacing(pacing); }
+  const FramePacer &frame_pacer() const { return base_->frame_pacer(); }
+
+  /// @brief The rendering work done in the last frame.
+  const RenderCounters &render_counters() const {
+    return base_->render_counters();
+  }
+
+  /// @brief How long each phase of startup took.
+  const StartupTimes &startup_times() const { return base_->startup_times(); }
+  void DumpStartupTimes(std::string *report) const {
+    base_->DumpStartupTimes(report);
+  }
+
   /// @brief Sets the window size, for when window is not owned by the renderer.
   void SetWindowSize(const mathfu::vec2i &window_size) {
     base_->SetWindowSize(window_size);
@@ -600,6 +947,35 @@ class Renderer {
     return base_->SupportsTextureNpot();
   }
 
+  /// @brief Returns if textures can be allocated as immutable storage.
+  bool SupportsTextureStorage() const {
+    return base_->SupportsTextureStorage();
+  }
+
+  /// @brief Returns if many draws can be submitted in one indirect call.
+  bool SupportsMultiDrawIndirect() const {
+    return base_->SupportsMultiDrawIndirect();
+  }
+
+  /// @brief Save linked shader programs in `directory`, and load them from
+  /// there instead of compiling them again.
+  bool EnableProgramBinaryCache(const char *directory) {
+    return base_->EnableProgramBinaryCache(directory);
+  }
+
+  /// @brief The GPU memory allocated by one category of objects.
+  const GpuMemoryStats &gpu_memory(GpuMemoryCategory category) const {
+    return base_->gpu_memory(category);
+  }
+
+  /// @brief The GPU memory allocated by all categories together.
+  const GpuMemoryStats &total_gpu_memory() const {
+    return base_->total_gpu_memory();
+  }
+
+  /// @brief Start tracking the high-water marks from the current allocations.
+  void ResetGpuMemoryPeaks() { base_->ResetGpuMemoryPeaks(); }
+
   /// @brief Returns the current render state.
   const RenderState &GetRenderState() const { return render_state_; }
 
@@ -608,6 +984,16 @@ class Renderer {
   /// @param render_state The render state to be set.
   void SetRenderState(const RenderState &render_state);
 
+  /// @brief Sets the render state to match the desired state, like above.
+  ///
+  /// Only the parts of the state that differ from the current state are set,
+  /// and telling that nothing differs is usually one compare. Pack states
+  /// that are set often once, e.g. per material, to save packing them on
+  /// every call.
+  ///
+  /// @param render_state The render state to be set.
+  void SetRenderState(const PackedRenderState &render_state);
+
   /// @brief Updates the cached render state with the given render state.
   ///
   /// This should be used to avoid mismatch between the expected render state
@@ -617,11 +1003,41 @@ class Renderer {
   /// will be updated.)
   void UpdateCachedRenderState(const RenderState &render_state);
 
+  /// @brief Check the GPU state against the cached render state every few
+  /// frames, or before a random sample of draws, and log any mismatch.
+  ///
+  /// Off by default. See RenderStateValidation.
+  void set_render_state_validation(const RenderStateValidation &validation);
+
+  /// @brief How often the GPU state is checked against the cached state.
+  const RenderStateValidation &render_state_validation() const {
+    return render_state_validation_;
+  }
+
+  /// @brief Forget which textures are bound to which texture units.
+  ///
+  /// Texture::Set() skips binding a texture to a unit it's already bound to.
+  /// Call this after binding textures with the graphics API directly, so
+  /// that the next Texture::Set() of each unit binds.
+  void InvalidateTextureBindings();
+
+  /// @brief Unbind the vertex state mesh draws leave bound, and forget it.
+  ///
+  /// Render() leaves a mesh's VAO, or its vertex attribute arrays, set after
+  /// drawing it, so that drawing the same mesh or one in the same buffer
+  /// again sets nothing up. Call this before setting vertex attributes,
+  /// binding VAOs or binding index buffers with the graphics API directly,
+  /// so they don't change what the last Render() left bound.
+  void InvalidateVertexBindings();
+
   /// @brief Activate a shader for subsequent draw calls.
   ///
   /// Will make a shader active for any subsequent draw calls, and sets
   /// all standard uniforms (e.g. mvp matrix) based on current values in
-  /// Renderer, if the shader refers to them.
+  /// Renderer, if the shader refers to them. Each shader remembers the values
+  /// it was last sent, and only those that changed are sent again. Set the
+  /// standard uniforms by hand with Shader::SetUniform(), not with the
+  /// graphics API directly, so that the shader knows to send them again.
   ///
   /// @param shader The shader to be activated.
   void SetShader(const Shader *shader);
@@ -645,7 +1061,15 @@ class Renderer {
   void SetScissorState(const ScissorState &scissor_state);
   void SetStencilState(const StencilState &stencil_state);
   void RenderSubMeshHelper(Mesh *mesh, size_t index, bool ignore_material,
-                           size_t instances);
+                           size_t instances, size_t lod,
+                           BufferHandle *bound_ibo);
+  void RenderMeshHelper(Mesh *mesh, bool ignore_material, size_t instances,
+                        size_t lod);
+  // Validates the render state before a draw, if this draw is sampled.
+  void SampleRenderState() {
+    if (draw_sample_threshold_ != 0) SampleRenderStateHelper();
+  }
+  void SampleRenderStateHelper();
 
   // Platform-dependent data.
   RendererImpl* impl_;
@@ -663,8 +1087,17 @@ class Renderer {
   mathfu::vec3 camera_pos_;
   const mathfu::AffineTransform *bone_transforms_;
   int num_bones_;
+  const mathfu::vec4_packed *bone_dual_quaternions_;
+  int num_dual_quaternion_bones_;
+  const BonePaletteBuffer *bone_palette_;
+  size_t bone_palette_offset_;
 
   RenderState render_state_;
+  // render_state_ packed, for SetRenderState() to diff against. Only up to
+  // date while packed_render_state_valid_ is set; anything that changes
+  // render_state_ clears it.
+  PackedRenderState packed_render_state_;
+  bool packed_render_state_valid_;
 
   BlendMode blend_mode_;
   float blend_amount_;
@@ -673,6 +1106,15 @@ class Renderer {
   StencilMode stencil_mode_;
   int stencil_ref_;
   uint32_t stencil_mask_;
+
+  RenderStateValidation render_state_validation_;
+  // Frames since the render state was last validated at the start of one.
+  int frames_since_validation_;
+  // A draw is validated when the random number drawn for it is below this, so
+  // 0 validates none. Set from render_state_validation_.draw_sample_rate.
+  uint32_t draw_sample_threshold_;
+  // State of the xorshift generator that picks the draws to validate.
+  uint32_t draw_sample_random_;
 };
 
 /// @}
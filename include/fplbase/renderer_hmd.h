@@ -35,6 +35,28 @@ namespace fplbase {
 /// @param width The width of the framebuffer.
 /// @param height The height of the framebuffer.
 void InitializeUndistortFramebuffer(int width, int height);
+/// @brief Scale the undistortion framebuffer relative to the size passed to
+///        InitializeUndistortFramebuffer(), to trade sharpness for fill rate.
+///        The undistortion pass upscales it to the screen.
+/// @param scale The fraction of the width and height to render at, e.g. 0.75
+///        renders about 56% of the pixels.
+/// @note Call before InitializeUndistortFramebuffer().
+void SetUndistortFramebufferScale(float scale);
+/// @brief Render the periphery of each eye at a lower resolution than its
+///        center, since the lenses blur it anyway.
+///
+/// Uses GL_QCOM_texture_foveated where available, which lowers the
+/// resolution gradually away from the center of each eye. Otherwise, on
+/// OpenGL ES 3, HeadMountedDisplayRender() calls its callback twice: once
+/// for the whole view at `periphery_scale`, which is upscaled into the
+/// framebuffer, and once at full resolution, with the depth buffer masking
+/// out all but the fovea. Elsewhere, it does nothing.
+/// @param fovea_size The fraction of the width and height of each eye kept at
+///        full resolution.
+/// @param periphery_scale The resolution of the rest, relative to the full
+///        one. 1 turns foveation off, which is the default.
+/// @note Call before InitializeUndistortFramebuffer().
+void SetFixedFoveation(float fovea_size, float periphery_scale);
 /// @brief Called before rendering for HMD to set up the framebuffer.
 void BeginUndistortFramebuffer();
 /// @brief Called when finished with rendering for HMD, to undistort and render
@@ -73,6 +95,32 @@ void HeadMountedDisplayRenderStart(
 /// @param use_undistortion If the undistortion effect should be used.
 void HeadMountedDisplayRenderEnd(Renderer* renderer, bool use_undistortion);
 
+/// @brief Whether SetFixedFoveation() needs a separate pass for the
+///        periphery, rendered between HeadMountedDisplayBeginPeripheryPass()
+///        and HeadMountedDisplayEndPeripheryPass().
+/// @param use_undistortion If undistortion is applied after rendering.
+bool HeadMountedDisplayHasPeripheryPass(bool use_undistortion);
+
+/// @brief Start rendering the periphery pass, after
+///        HeadMountedDisplayRenderStart().
+/// @param renderer The renderer that is being used to render the scene.
+/// @param clear_color The color to clear the framebuffer to before rendering.
+/// @param view_settings The view settings from
+///        HeadMountedDisplayRenderStart(), scaled here to the periphery
+///        framebuffer.
+void HeadMountedDisplayBeginPeripheryPass(
+    Renderer* renderer, const mathfu::vec4& clear_color,
+    HeadMountedDisplayViewSettings* view_settings);
+
+/// @brief Finish the periphery pass, upscaling it into the undistortion
+///        framebuffer, and mask the periphery out of the depth buffer so that
+///        the full resolution pass only shades the fovea.
+/// @param renderer The renderer that is being used to render the scene.
+/// @param view_settings The view settings from
+///        HeadMountedDisplayRenderStart().
+void HeadMountedDisplayEndPeripheryPass(
+    Renderer* renderer, const HeadMountedDisplayViewSettings& view_settings);
+
 /// @brief Helper function that wraps the HMD calls, rendering using the given
 ///        callback.
 ///
@@ -97,6 +145,14 @@ void HeadMountedDisplayRender(const InputSystem* input_system,
   HeadMountedDisplayRenderStart(input_system->head_mounted_display_input(),
                                 renderer, clear_color, use_undistortion,
                                 &view_settings);
+  if (HeadMountedDisplayHasPeripheryPass(use_undistortion)) {
+    HeadMountedDisplayViewSettings periphery_settings = view_settings;
+    HeadMountedDisplayBeginPeripheryPass(renderer, clear_color,
+                                         &periphery_settings);
+    render_callback(periphery_settings.viewport_extents,
+                    periphery_settings.viewport_transforms);
+    HeadMountedDisplayEndPeripheryPass(renderer, view_settings);
+  }
   render_callback(view_settings.viewport_extents,
                   view_settings.viewport_transforms);
   HeadMountedDisplayRenderEnd(renderer, use_undistortion);
@@ -16,11 +16,14 @@
 #define FPLBASE_SHADER_H
 
 #include <set>
+#include <vector>
 
 #include "fplbase/config.h"  // Must come first.
 
+#include "fplbase/asset_id.h"
 #include "fplbase/async_loader.h"
 #include "fplbase/handles.h"
+#include "fplbase/skinning.h"
 #include "mathfu/glsl_mappings.h"
 
 namespace fplbase {
@@ -34,6 +37,26 @@ struct ShaderImpl;
 static const int kMaxTexturesPerShader = 8;
 static const int kNumVec4sInAffineTransform = 3;
 
+/// @cond FPLBASE_INTERNAL
+// A program whose compile and link have been started but not checked, so the
+// driver can work on it in the background. See
+// RendererBase::StartCompileAndLinkShader().
+struct PendingShaderLink {
+  PendingShaderLink()
+      : program(InvalidShaderHandle()),
+        vs(InvalidShaderHandle()),
+        ps(InvalidShaderHandle()),
+        binary_key(0) {}
+  ShaderHandle program;
+  // Invalid for programs loaded from the program binary cache.
+  ShaderHandle vs;
+  ShaderHandle ps;
+  // Where in the program binary cache to store the program once linked, or 0
+  // to not store it.
+  uint64_t binary_key;
+};
+/// @endcond
+
 /// @class Shader
 /// @brief Represents a shader consisting of a vertex and pixel shader.
 ///
@@ -66,7 +89,9 @@ class Shader : public AsyncAsset {
   /// This function allows you to specify which features are enabled.
   ///
   /// @note This function does not reload the shader. It will simply mark
-  /// the shader as dirty, if its defines have changed.
+  /// the shader as dirty, if its defines have changed. Defines that neither
+  /// the shader's source nor its includes mention don't change the compiled
+  /// program, so changing only those leaves the shader as it is.
   ///
   /// @param global_defines_to_add the defines to be added into 'local_defines'
   /// above. These are generally global rendering settings, for example,
@@ -74,7 +99,8 @@ class Shader : public AsyncAsset {
   /// @param global_defines_to_omit the defines to forcefully omit from
   /// 'local_defines'. Generally used to globally disable expensive features
   /// such as shadows, on low-powered hardware.
-  void UpdateGlobalDefines(
+  /// @return Returns true if the shader has to be recompiled.
+  bool UpdateGlobalDefines(
       const std::vector<std::string> &global_defines_to_add,
       const std::vector<std::string> &global_defines_to_omit);
 
@@ -92,6 +118,11 @@ class Shader : public AsyncAsset {
   /// @brief Creates a Shader from `data_`.
   virtual bool Finalize();
 
+  /// @brief Starts compiling `data_` without waiting for the driver, where it
+  /// supports GL_KHR_parallel_shader_compile, and returns whether the
+  /// compile is done.
+  virtual bool PrepareFinalize();
+
   /// @brief Whether this object loaded and finalized correctly. Call after
   /// Finalize has been called (by AssetManager::TryFinalize).
   bool IsValid() { return ValidShaderHandle(program_); }
@@ -100,7 +131,22 @@ class Shader : public AsyncAsset {
   ///
   /// @param uniform_name The name of the uniform to find.
   /// @return Returns a handle to the requested uniform, -1 if not found.
-  UniformHandle FindUniform(const char *uniform_name);
+  UniformHandle FindUniform(const char *uniform_name) {
+    return FindUniform(AssetId(uniform_name));
+  }
+
+  /// @brief Find a non-standard uniform by its hashed name.
+  ///
+  /// Locations are cached per shader the first time a name is looked up, so
+  /// only the first lookup of a name queries the driver. Hashing a string
+  /// literal at compile time skips the remaining hashing cost too:
+  ///
+  ///     static constexpr AssetId kTint("tint");
+  ///     shader->SetUniform(kTint, tint);
+  ///
+  /// @param uniform_id The hashed name of the uniform to find.
+  /// @return Returns a handle to the requested uniform, -1 if not found.
+  UniformHandle FindUniform(const AssetId &uniform_id);
 
   /// @brief Raw call to set any uniform (with 1/2/3/4/16 components).
   ///
@@ -134,7 +180,20 @@ class Shader : public AsyncAsset {
   template <int N>
   bool SetUniform(const char *uniform_name,
                   const mathfu::Vector<float, N> &value) {
-    auto loc = FindUniform(uniform_name);
+    return SetUniform(AssetId(uniform_name), value);
+  }
+
+  /// @brief Convenience call that does a cached Lookup and a Set if found.
+  ///
+  /// Call this after Set().
+  ///
+  /// @param uniform_id The hashed name of the uniform that will be set.
+  /// @param value The vector to set the uniform to.
+  /// @return Returns true if the uniform was found and set, false otherwise.
+  template <int N>
+  bool SetUniform(const AssetId &uniform_id,
+                  const mathfu::Vector<float, N> &value) {
+    auto loc = LookUpUniform(uniform_id);
     if (!ValidUniformHandle(loc)) return false;
     SetUniform(loc, &value[0], N);
     return true;
@@ -148,7 +207,18 @@ class Shader : public AsyncAsset {
   /// @param value The float to set the uniform to.
   /// @return Returns true if the uniform was found and set, false otherwise.
   bool SetUniform(const char *uniform_name, float value) {
-    auto loc = FindUniform(uniform_name);
+    return SetUniform(AssetId(uniform_name), value);
+  }
+
+  /// @brief Set a non-standard uniform, by hashed name, to a float value.
+  ///
+  /// Call this after Set().
+  ///
+  /// @param uniform_id The hashed name of the uniform that will be set.
+  /// @param value The float to set the uniform to.
+  /// @return Returns true if the uniform was found and set, false otherwise.
+  bool SetUniform(const AssetId &uniform_id, float value) {
+    auto loc = LookUpUniform(uniform_id);
     if (!ValidUniformHandle(loc)) return false;
     SetUniform(loc, &value, 1);
     return true;
@@ -162,7 +232,18 @@ class Shader : public AsyncAsset {
   /// @param value The mat4 to set the uniform to.
   /// @return Returns true if the uniform was found and set, false otherwise.
   bool SetUniform(const char *uniform_name, const mathfu::mat4 &value) {
-    auto loc = FindUniform(uniform_name);
+    return SetUniform(AssetId(uniform_name), value);
+  }
+
+  /// @brief Set a non-standard uniform, by hashed name, to a mat4 value.
+  ///
+  /// Call this after Set().
+  ///
+  /// @param uniform_id The hashed name of the uniform that will be set.
+  /// @param value The mat4 to set the uniform to.
+  /// @return Returns true if the uniform was found and set, false otherwise.
+  bool SetUniform(const AssetId &uniform_id, const mathfu::mat4 &value) {
+    auto loc = LookUpUniform(uniform_id);
     if (!ValidUniformHandle(loc)) return false;
     SetUniform(loc, &value[0], sizeof(value) / sizeof(float));
     return true;
@@ -178,14 +259,46 @@ class Shader : public AsyncAsset {
 
   bool IsDirty() const { return dirty_; }
 
+  /// @brief How this shader expects bone transforms: as dual quaternions if
+  /// it has a `bone_dual_quaternions` uniform, otherwise as affine
+  /// transforms.
+  SkinningMode skinning_mode() const {
+    return ValidUniformHandle(uniform_bone_dual_quaternions_)
+               ? kSkinningModeDualQuaternion
+               : kSkinningModeLinear;
+  }
+
+  /// @brief Whether this shader draws all views of a multiview render target
+  /// at once, reading each view's transform from a
+  /// `model_view_projection_multiview` array (and optionally its camera
+  /// position from `camera_pos_multiview`) indexed by `gl_ViewID_OVR`. See
+  /// shaders/fplbase/multiview.glslv_h and Renderer::RenderStereo().
+  bool multiview() const {
+    return ValidUniformHandle(uniform_model_view_projection_multiview_);
+  }
+
+  /// @brief Uniform block binding point for the `FrameUniforms` block.
+  ///
+  /// On ES3 / GL3, a shader can read `camera_pos`, `light_pos` and `time`
+  /// from a `FrameUniforms` block, and `model_view_projection`, `model` and
+  /// `color` from an `ObjectUniforms` block, by including
+  /// shaders/fplbase/builtin_uniform_blocks.glsl_h instead of declaring the
+  /// uniforms. The renderer uploads the blocks only when their values change,
+  /// so switching between such shaders sends no uniforms. BonePaletteBuffer
+  /// uses binding point 0.
+  static const unsigned int kFrameUniformsBinding = 1;
+  /// @brief Uniform block binding point for the `ObjectUniforms` block.
+  static const unsigned int kObjectUniformsBinding = 2;
+
   /// @brief Call to mark the shader as needing to be reloaded.
   ///
   /// Useful when you've changed the shader source and want to dynamically
-  /// re-compile the shader.
+  /// re-compile the shader. Also clears the cache of \#included files (see
+  /// ClearShaderIncludeCache()), so edits to those show as well.
   ///
   /// @note Be sure to call ReloadIfDirty() on your render thread before
   /// the shader is used. Otherwise an assert will be hit in Shader::Set().
-  void MarkDirty() { dirty_ = true; }
+  void MarkDirty();
 
   // For internal use.
   ShaderImpl *impl() { return impl_; }
@@ -196,6 +309,7 @@ class Shader : public AsyncAsset {
   static Shader *LoadFromShaderDef(const char *filename);
 
  private:
+  friend class AssetManager;
   friend class Renderer;
   friend class RendererBase;
 
@@ -203,6 +317,8 @@ class Shader : public AsyncAsset {
   struct ShaderSourcePair {
     std::string vertex_shader;
     std::string fragment_shader;
+    // See `referenced_names_`.
+    std::vector<uint64_t> referenced_names;
   };
 
   // Used by constructor to init inner variables.
@@ -212,12 +328,26 @@ class Shader : public AsyncAsset {
   /// @brief Clear the Shader and reset everything to null.
   void Clear();
 
+  // Drops the results of a Load() and PrepareFinalize() that won't be
+  // finalized, e.g. because the load was aborted.
+  void ClearPendingLoad();
+
+  // Whether switching from `enabled_defines_` to `defines` would change the
+  // preprocessed source.
+  bool DefinesAffectSource(const std::set<std::string> &defines) const;
+
   void Reset(ShaderHandle program, ShaderHandle vs, ShaderHandle ps);
 
   bool ReloadInternal();
 
   ShaderSourcePair *LoadSourceFile();
 
+  // Returns the location of a uniform of the bound program, from
+  // `uniform_cache_` if it has been looked up since the last link.
+  UniformHandle LookUpUniform(const AssetId &uniform_id);
+  // Picks the variant of a .fplshader file that has `enabled_defines_`.
+  ShaderSourcePair *LoadVariant();
+
   // Backend-specific create and destroy calls. These just call new and delete
   // on the platform-specific impl structs.
   static ShaderImpl *CreateShaderImpl();
@@ -228,6 +358,8 @@ class Shader : public AsyncAsset {
   ShaderHandle program_;
   ShaderHandle vs_;
   ShaderHandle ps_;
+  // Started by PrepareFinalize(), and finished by Finalize().
+  PendingShaderLink pending_link_;
 
   UniformHandle uniform_model_view_projection_;
   UniformHandle uniform_model_;
@@ -236,6 +368,48 @@ class Shader : public AsyncAsset {
   UniformHandle uniform_camera_pos_;
   UniformHandle uniform_time_;
   UniformHandle uniform_bone_transforms_;
+  UniformHandle uniform_bone_dual_quaternions_;
+  UniformHandle uniform_model_view_projection_multiview_;
+  UniformHandle uniform_camera_pos_multiview_;
+  // Locations of the non-standard uniforms looked up by name since the last
+  // link, including those that weren't found. Shaders rarely have more than a
+  // handful, so a linear scan over the hashes beats a map.
+  struct CachedUniform {
+    uint64_t hash;
+    UniformHandle handle;
+  };
+  std::vector<CachedUniform> uniform_cache_;
+  // Size in bytes of the `BonePalette` uniform block, or 0 if there's none.
+  int bone_palette_block_size_;
+  // Whether the shader has a `FrameUniforms` or `ObjectUniforms` block.
+  bool uses_builtin_blocks_;
+
+  // The built-in uniform values last sent to this program, so that
+  // Renderer::SetShader() only sends those that changed. A value is only
+  // trusted while its bit is set in `known`.
+  struct BuiltinUniformValues {
+    enum {
+      kModelViewProjection = 1 << 0,
+      kModel = 1 << 1,
+      kColor = 1 << 2,
+      kLightPos = 1 << 3,
+      kCameraPos = 1 << 4,
+      kTime = 1 << 5,
+      kBoneTransforms = 1 << 6,
+      kBoneDualQuaternions = 1 << 7,
+    };
+    BuiltinUniformValues() : known(0) {}
+    float model_view_projection[16];
+    float model[16];
+    float color[4];
+    float light_pos[3];
+    float camera_pos[3];
+    float time;
+    std::vector<float> bone_transforms;
+    std::vector<float> bone_dual_quaternions;
+    unsigned int known;
+  };
+  mutable BuiltinUniformValues builtin_values_;
 
   Renderer *renderer_;
 
@@ -247,6 +421,12 @@ class Shader : public AsyncAsset {
   // The shader files are preprocessed with this list of defines.
   std::set<std::string> enabled_defines_;
 
+  // Sorted hashes of the identifiers in the source (with includes) the
+  // program was compiled from, other than the names of #defines. A define
+  // can only change the program if its name is among them. Empty if unknown,
+  // e.g. for precompiled variants.
+  std::vector<uint64_t> referenced_names_;
+
   // If true, means this shader needs to be reloaded.
   bool dirty_;
 };
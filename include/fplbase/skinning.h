@@ -0,0 +1,230 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_SKINNING_H
+#define FPLBASE_SKINNING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_mesh
+/// @{
+
+class Mesh;
+
+/// @brief How a skinning shader expects its bone transforms.
+enum SkinningMode {
+  /// Three vec4s per bone in `bone_transforms`: the rows of its affine
+  /// transform. See skinning.glslv_h.
+  kSkinningModeLinear,
+  /// Two vec4s per bone in `bone_dual_quaternions`: the real and dual parts
+  /// of a unit dual quaternion. See skinning_dual_quaternion.glslv_h.
+  kSkinningModeDualQuaternion,
+};
+
+/// @brief The number of vec4s in one bone's dual quaternion.
+static const int kNumVec4sInDualQuaternion = 2;
+
+/// @brief Multiply two affine transforms, without expanding them to 4x4.
+///
+/// An AffineTransform holds the top three rows of a 4x4 transform, one per
+/// vec4, so each row of the product is a sum of the rows of `b` scaled by
+/// the components of a row of `a`, with mathfu's SIMD vec4 math.
+///
+/// @return Returns `a * b`, the transform that applies `b` and then `a`.
+inline mathfu::AffineTransform MultiplyAffineTransforms(
+    const mathfu::AffineTransform &a, const mathfu::AffineTransform &b) {
+  const mathfu::vec4 &b0 = b.GetColumn(0);
+  const mathfu::vec4 &b1 = b.GetColumn(1);
+  const mathfu::vec4 &b2 = b.GetColumn(2);
+  mathfu::AffineTransform product;
+  for (int i = 0; i < 3; ++i) {
+    const mathfu::vec4 &row = a.GetColumn(i);
+    product.GetColumn(i) = b0 * row.x + b1 * row.y + b2 * row.z +
+                           mathfu::vec4(0.0f, 0.0f, 0.0f, row.w);
+  }
+  return product;
+}
+
+/// @brief Multiply arrays of affine transforms: `out[i] = a[i] * b[i]`.
+///
+/// @param a The left hand transforms. Length `count`.
+/// @param b The right hand transforms. Length `count`.
+/// @param count The number of transforms.
+/// @param out The products. Length `count`. May be `a` or `b`.
+void MultiplyAffineTransforms(const mathfu::AffineTransform *a,
+                              const mathfu::AffineTransform *b, size_t count,
+                              mathfu::AffineTransform *out);
+
+/// @brief Convert a rigid transform to a unit dual quaternion.
+///
+/// Dual quaternions only hold rotation and translation, so any scale or shear
+/// in `transform` is lost.
+///
+/// @param transform The rotation and translation.
+/// @param dual_quaternion Output: two vec4s, the real part (the rotation)
+///        then the dual part, each with the scalar in `w`.
+void AffineToDualQuaternion(const mathfu::AffineTransform &transform,
+                            mathfu::vec4_packed *dual_quaternion);
+
+/// @brief The parent of root bones in Mesh::bone_parents().
+static const uint8_t kInvalidBoneIdx = 0xFF;
+
+/// @brief A pose of a skeleton, relative to each bone's parent, to blend with
+/// EvaluatePose(). Rotations, translations and scales are separate arrays, so
+/// the blend reads each straight through.
+struct LocalPose {
+  LocalPose()
+      : rotations(nullptr),
+        translations(nullptr),
+        scales(nullptr),
+        weight(1.0f) {}
+  LocalPose(const mathfu::vec4_packed *rotations,
+            const mathfu::vec3_packed *translations,
+            const mathfu::vec3_packed *scales, float weight)
+      : rotations(rotations),
+        translations(translations),
+        scales(scales),
+        weight(weight) {}
+
+  /// Unit quaternions, with the scalar in `w`. Length num_bones.
+  const mathfu::vec4_packed *rotations;
+  /// Length num_bones.
+  const mathfu::vec3_packed *translations;
+  /// Length num_bones, or nullptr for a scale of 1.
+  const mathfu::vec3_packed *scales;
+  /// This pose's share of the blend. The weights are normalized by their sum.
+  float weight;
+};
+
+/// @brief Blend local poses, and evaluate the blend into the bone transforms
+/// in object space, in one pass over the bones.
+///
+/// Rotations are blended with a normalized lerp, each turned to the same
+/// hemisphere as the first pose's so the blend takes the shorter way round.
+/// Translations and scales are averaged. Each bone's transform is then its
+/// parent's times its blended local one, so parents must come before their
+/// children, as in Mesh::bone_parents(). Bones whose parent doesn't come
+/// before them, e.g. kInvalidBoneIdx, are roots.
+///
+/// @param bone_parents The parent of each bone. Length `num_bones`.
+/// @param num_bones The number of bones.
+/// @param poses The poses to blend. Length `num_poses`, at least 1.
+/// @param num_poses The number of poses.
+/// @param bone_transforms Output: length `num_bones`, as
+///        Mesh::GatherShaderTransforms() takes them.
+void EvaluatePose(const uint8_t *bone_parents, size_t num_bones,
+                  const LocalPose *poses, size_t num_poses,
+                  mathfu::AffineTransform *bone_transforms);
+
+/// @brief One skinned mesh instance's bone palette, for SkinningJobs.
+struct SkinningInstance {
+  SkinningInstance()
+      : mesh(nullptr), bone_transforms(nullptr), shader_transforms(nullptr) {}
+  SkinningInstance(const Mesh *mesh,
+                   const mathfu::AffineTransform *bone_transforms,
+                   mathfu::AffineTransform *shader_transforms)
+      : mesh(mesh),
+        bone_transforms(bone_transforms),
+        shader_transforms(shader_transforms) {}
+
+  const Mesh *mesh;
+  /// The animated bone transforms. Length Mesh::num_bones().
+  const mathfu::AffineTransform *bone_transforms;
+  /// Set to the shader transforms. Length Mesh::num_shader_bones().
+  mathfu::AffineTransform *shader_transforms;
+};
+
+/// @brief One skinned mesh instance's blend of poses, for
+/// SkinningJobs::EvaluatePoses().
+struct PoseInstance {
+  PoseInstance()
+      : mesh(nullptr),
+        poses(nullptr),
+        num_poses(0),
+        bone_transforms(nullptr),
+        shader_transforms(nullptr) {}
+  PoseInstance(const Mesh *mesh, const LocalPose *poses, size_t num_poses,
+               mathfu::AffineTransform *bone_transforms,
+               mathfu::AffineTransform *shader_transforms)
+      : mesh(mesh),
+        poses(poses),
+        num_poses(num_poses),
+        bone_transforms(bone_transforms),
+        shader_transforms(shader_transforms) {}
+
+  const Mesh *mesh;
+  /// The poses to blend, each of Mesh::num_bones() bones. Length `num_poses`.
+  const LocalPose *poses;
+  size_t num_poses;
+  /// Set to the evaluated pose. Length Mesh::num_bones().
+  mathfu::AffineTransform *bone_transforms;
+  /// If not nullptr, set to the shader transforms of the evaluated pose.
+  /// Length Mesh::num_shader_bones().
+  mathfu::AffineTransform *shader_transforms;
+};
+
+struct SkinningJobsImpl;
+
+/// @class SkinningJobs
+/// @brief Worker threads that compute the bone palettes of many mesh
+/// instances in parallel, with Mesh::GatherShaderTransforms(), optionally
+/// evaluating their poses first.
+///
+/// The threads wait between calls, so one SkinningJobs can be kept for the
+/// life of the app and called every frame before rendering.
+class SkinningJobs {
+ public:
+  /// @brief Start the worker threads.
+  ///
+  /// @param num_threads The number of worker threads. The calling thread
+  ///        works too. If negative, one fewer than the number of cores.
+  explicit SkinningJobs(int num_threads = -1);
+  ~SkinningJobs();
+
+  /// @brief Compute the shader transforms of all instances, and return once
+  /// they're done.
+  ///
+  /// @param instances The instances. Their arrays mustn't overlap.
+  /// @param count The number of instances.
+  void GatherShaderTransforms(const SkinningInstance *instances, size_t count);
+
+  /// @brief Evaluate the poses of all instances with EvaluatePose(), then
+  /// compute their shader transforms, and return once they're done.
+  ///
+  /// @param instances The instances. Their output arrays mustn't overlap.
+  /// @param count The number of instances.
+  void EvaluatePoses(const PoseInstance *instances, size_t count);
+
+  /// @brief The number of worker threads, not counting the calling thread.
+  int num_threads() const;
+
+ private:
+  SkinningJobs(const SkinningJobs &);
+  SkinningJobs &operator=(const SkinningJobs &);
+
+  SkinningJobsImpl *impl_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_SKINNING_H
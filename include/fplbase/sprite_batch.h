@@ -0,0 +1,175 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_SPRITE_BATCH_H
+#define FPLBASE_SPRITE_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/asset_id.h"
+#include "mathfu/constants.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+class Renderer;
+class Shader;
+class Texture;
+class TextureAtlas;
+
+/// @file
+/// @addtogroup fplbase_renderer
+/// @{
+
+/// @class SpriteBatch
+/// @brief Collects quads and nine-patches, and draws those sharing a texture
+/// and shader together.
+///
+/// Each quad is the same as one drawn by RenderAAQuadAlongX(), and each
+/// nine-patch the same as one drawn by RenderAAQuadAlongXNinePatch(), but
+/// rather than a draw call each, consecutive ones with the same texture and
+/// shader are streamed into one vertex buffer and drawn with a single call.
+/// Adding one with a different texture or shader draws the ones before it.
+///
+/// Sprites from the same TextureAtlas share its texture, so a UI layer drawn
+/// from one atlas goes out in one draw call.
+///
+/// Everything else the draws use, e.g. the renderer's model view projection,
+/// color and render state, is read when they're drawn, by Flush() or by an
+/// Add call with a different texture or shader. Flush() before changing it.
+class SpriteBatch {
+ public:
+  /// @param renderer The renderer to draw with.
+  explicit SpriteBatch(Renderer *renderer);
+
+  /// @brief Add a quad, like RenderAAQuadAlongX().
+  ///
+  /// @param texture The texture to draw with, set to unit 0, or nullptr to
+  ///        leave the texture units alone.
+  /// @param shader The shader to draw with.
+  /// @param bottom_left The bottom left coordinate of the quad.
+  /// @param top_right The top right coordinate of the quad.
+  /// @param tex_bottom_left The texture coordinates at the bottom left.
+  /// @param tex_top_right The texture coordinates at the top right.
+  void AddQuad(const Texture *texture, const Shader *shader,
+               const mathfu::vec3 &bottom_left, const mathfu::vec3 &top_right,
+               const mathfu::vec2 &tex_bottom_left = mathfu::kZeros2f,
+               const mathfu::vec2 &tex_top_right = mathfu::kOnes2f);
+
+  /// @brief Add a quad showing the whole of an atlas' subtexture.
+  ///
+  /// @param atlas The atlas the subtexture is in.
+  /// @param subtexture The name of the subtexture.
+  /// @param shader The shader to draw with.
+  /// @param bottom_left The bottom left coordinate of the quad.
+  /// @param top_right The top right coordinate of the quad.
+  /// @return false, adding nothing, if there's no such subtexture.
+  bool AddQuad(TextureAtlas &atlas, const AssetId &subtexture,
+               const Shader *shader, const mathfu::vec3 &bottom_left,
+               const mathfu::vec3 &top_right);
+
+  /// @brief Add a nine-patch, like RenderAAQuadAlongXNinePatch().
+  ///
+  /// @param texture The texture to draw with, set to unit 0, or nullptr to
+  ///        leave the texture units alone.
+  /// @param shader The shader to draw with.
+  /// @param bottom_left The bottom left coordinate of the quad.
+  /// @param top_right The top right coordinate of the quad.
+  /// @param texture_size The size of the texture used by the patches.
+  /// @param patch_info The stretchable area, as vec4(x0, y0, x1, y1) in UV
+  ///        coordinates. See RenderAAQuadAlongXNinePatch().
+  void AddNinePatch(const Texture *texture, const Shader *shader,
+                    const mathfu::vec3 &bottom_left,
+                    const mathfu::vec3 &top_right,
+                    const mathfu::vec2i &texture_size,
+                    const mathfu::vec4 &patch_info);
+
+  /// @brief Add a nine-patch of an atlas' subtexture.
+  ///
+  /// @param atlas The atlas the subtexture is in.
+  /// @param subtexture The name of the subtexture.
+  /// @param shader The shader to draw with.
+  /// @param bottom_left The bottom left coordinate of the quad.
+  /// @param top_right The top right coordinate of the quad.
+  /// @param patch_info The stretchable area, in UV coordinates of the
+  ///        subtexture rather than of the whole atlas.
+  /// @return false, adding nothing, if there's no such subtexture.
+  bool AddNinePatch(TextureAtlas &atlas, const AssetId &subtexture,
+                    const Shader *shader, const mathfu::vec3 &bottom_left,
+                    const mathfu::vec3 &top_right,
+                    const mathfu::vec4 &patch_info);
+
+  /// @brief Draw everything added since the last draw.
+  void Flush();
+
+  /// @brief The number of quads waiting to be drawn. A nine-patch counts as
+  /// nine.
+  size_t num_pending_quads() const { return indices_.size() / 6; }
+
+  /// @brief The number of draw calls made since the batch was created.
+  size_t num_draw_calls() const { return num_draw_calls_; }
+
+ private:
+  SpriteBatch(const SpriteBatch &);
+  SpriteBatch &operator=(const SpriteBatch &);
+
+  // Flushes if a sprite of `num_vertices` vertices can't be added to the
+  // pending ones, and returns where to put its vertices.
+  float *Reserve(const Texture *texture, const Shader *shader,
+                 size_t num_vertices, const uint16_t *indices,
+                 size_t num_indices);
+
+  Renderer *renderer_;
+  // The texture and shader of the pending sprites.
+  const Texture *texture_;
+  const Shader *shader_;
+  // Pending vertices, as [x, y, z] [u, v].
+  std::vector<float> vertices_;
+  std::vector<uint16_t> indices_;
+  size_t num_draw_calls_;
+};
+
+/// @}
+
+namespace internal {
+
+// For internal use only. The vertices, as [x, y, z] [u, v], and triangle
+// indices of the quads drawn by RenderAAQuadAlongX() and SpriteBatch.
+static const int kQuadAlongXVertices = 4;
+static const int kQuadAlongXIndices = 6;
+extern const uint16_t kQuadAlongXIndexData[kQuadAlongXIndices];
+void QuadAlongXVertices(const mathfu::vec3 &bottom_left,
+                        const mathfu::vec3 &top_right,
+                        const mathfu::vec2 &tex_bottom_left,
+                        const mathfu::vec2 &tex_top_right, float *vertices);
+
+// For internal use only. The same, for RenderAAQuadAlongXNinePatch(). The
+// texture coordinates span `tex_bounds`, as (offset, size).
+static const int kNinePatchAlongXVertices = 16;
+static const int kNinePatchAlongXIndices = 6 * 9;
+extern const uint16_t kNinePatchAlongXIndexData[kNinePatchAlongXIndices];
+void NinePatchAlongXVertices(const mathfu::vec3 &bottom_left,
+                             const mathfu::vec3 &top_right,
+                             const mathfu::vec2 &texture_size,
+                             const mathfu::vec4 &patch_info,
+                             const mathfu::vec4 &tex_bounds, float *vertices);
+
+}  // namespace internal
+}  // namespace fplbase
+
+#endif  // FPLBASE_SPRITE_BATCH_H
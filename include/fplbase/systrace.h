@@ -16,33 +16,26 @@
 #define FPLBASE_SYSTRACE_H
 
 /// @file fplbase/systrace.h
-/// @brief Functions for creating systrace log events, for Android.
+/// @brief Functions for creating systrace log events.
 ///
-/// To enable, \#define FPLBASE_ENABLE_SYSTRACE 1.
+/// To enable, \#define FPLBASE_ENABLE_SYSTRACE 1. These forward to the
+/// backend of fplbase/trace.h, so events appear in whichever trace is being
+/// recorded. On Android, SystraceInit() installs a SystraceBackend.
 /// @addtogroup fplbase_systrace
 /// @{
 
-#if FPLBASE_ENABLE_SYSTRACE
-#ifndef __ANDROID__
-#error Systrace is only suppported for Android Builds
-#endif
+#include <assert.h>
 
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#endif  // FPLBASE_ENABLE_SYSTRACE
-
-#define MAX_SYSTRACE_LEN 256
-int trace_marker = -1;
+#include "fplbase/trace.h"
 
 /// @brief Initializes the settings for systrace.
 ///
 /// This needs to be called before any other systrace call.
-void SystraceInit() {
-#if FPLBASE_ENABLE_SYSTRACE
-  trace_marker = open("/sys/kernel/debug/tracing/trace_marker", O_WRONLY);
-  // Check that it didn't fail:
-  assert(trace_marker == -1);
+inline void SystraceInit() {
+#if FPLBASE_ENABLE_SYSTRACE && defined(__ANDROID__)
+  static fplbase::SystraceBackend backend;
+  assert(backend.IsValid());
+  fplbase::SetTraceBackend(&backend);
 #endif
 }
 
@@ -54,17 +47,14 @@ void SystraceInit() {
 inline void SystraceBegin(const char *name) {
   (void)name;
 #if FPLBASE_ENABLE_SYSTRACE
-  char buf[MAX_SYSTRACE_LEN];
-  int len = snprintf(buf, MAX_SYSTRACE_LEN, "B|%d|%s", getpid(), name);
-  write(trace_marker, buf, len);
+  fplbase::TraceBegin(name);
 #endif
 }
 
 /// @brief Ends the most recently begun block.
 inline void SystraceEnd() {
 #if FPLBASE_ENABLE_SYSTRACE
-  char c = 'E';
-  write(trace_marker, &c, 1);
+  fplbase::TraceEnd();
 #endif
 }
 
@@ -78,10 +68,7 @@ inline void SystraceCounter(const char *name, const int value) {
   (void)name;
   (void)value;
 #if FPLBASE_ENABLE_SYSTRACE
-  char buf[MAX_SYSTRACE_LEN];
-  int len =
-      snprintf(buf, MAX_SYSTRACE_LEN, "C|%d|%s|%i", getpid(), name, value);
-  write(trace_marker, buf, len);
+  fplbase::TraceCounter(name, value);
 #endif
 }
 
@@ -95,10 +82,7 @@ inline void SystraceAsyncBegin(const char *name, const int32_t cookie) {
   (void)name;
   (void)cookie;
 #if FPLBASE_ENABLE_SYSTRACE
-  char buf[MAX_SYSTRACE_LEN];
-  int len =
-      snprintf(buf, MAX_SYSTRACE_LEN, "S|%d|%s|%i", getpid(), name, cookie);
-  write(trace_marker, buf, len);
+  fplbase::TraceAsyncBegin(name, cookie);
 #endif
 }
 
@@ -112,10 +96,7 @@ inline void SystraceAsyncEnd(const char *name, const int32_t cookie) {
   (void)name;
   (void)cookie;
 #if FPLBASE_ENABLE_SYSTRACE
-  char buf[MAX_SYSTRACE_LEN];
-  int len =
-      snprintf(buf, MAX_SYSTRACE_LEN, "F|%d|%s|%i", getpid(), name, cookie);
-  write(trace_marker, buf, len);
+  fplbase::TraceAsyncEnd(name, cookie);
 #endif
 }
 
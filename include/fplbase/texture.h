@@ -19,6 +19,7 @@
 
 #include "fplbase/config.h"  // Must come first.
 
+#include "fplbase/allocator.h"
 #include "fplbase/async_loader.h"
 #include "fplbase/handles.h"
 #include "mathfu/constants.h"
@@ -56,13 +57,31 @@ enum TextureFlags {
   kTextureFlagsClampToEdge = 1 << 0,
   /// Uses (or generates) mipmaps.
   kTextureFlagsUseMipMaps = 1 << 1,
-  /// Data represents a 1x6 cubemap.
+  /// Data represents a 1x6 cubemap, or a KTX file with 6 faces. See also
+  /// AssetManager::LoadCubeMap() for cube maps in 6 separate files.
   kTextureFlagsIsCubeMap = 1 << 2,
   /// Load texture asynchronously.
   kTextureFlagsLoadAsync = 1 << 3,
   /// Premultiply by alpha on load.
   /// Not supported for ASTC, PKM, or KTX images.
   kTextureFlagsPremultiplyAlpha = 1 << 4,
+  /// Stream in the mips of a compressed KTX file with a mip chain: loading
+  /// only uploads the small mips, and AssetManager::TryFinalize() streams in
+  /// finer ones over later frames, up to Texture::requested_mip(). Needs
+  /// kTextureFlagsUseMipMaps and kFeatureLevel30, and is ignored otherwise.
+  kTextureFlagsStreamMips = 1 << 5,
+  /// Build the mip chain of an uncompressed image in Load(), on the loader
+  /// thread, instead of with glGenerateMipmap() when finalizing. Needs
+  /// kTextureFlagsUseMipMaps. 16bpp textures do this anyway on devices where
+  /// MipmapGeneration16bppSupported() is false, rather than falling back to
+  /// 32bpp.
+  kTextureFlagsBuildMipsOnLoad = 1 << 6,
+  /// Encode an uncompressed 888 or 8888 image as ETC2 before uploading it,
+  /// in Load() on the loader thread, or in LoadFromMemory(), with its mips if
+  /// it has kTextureFlagsUseMipMaps. Needs kFormatAuto or kFormatKTX, a
+  /// device that supports kFormatKTX, and texture storage for mips. Cube maps,
+  /// kTextureFlagsStreamMips, and images under 4x4 are left uncompressed.
+  kTextureFlagsCompressOnLoad = 1 << 7,
 };
 
 inline TextureFlags operator|(TextureFlags a, TextureFlags b) {
@@ -124,7 +143,12 @@ class Texture : public AsyncAsset {
   virtual void LoadFromMemory(const uint8_t *data, const mathfu::vec2i &size,
                               TextureFormat texture_format);
 
-  /// @brief Creates a Texture from `data_` and stores the handle in `id_`.
+  /// @brief Creates a Texture from `data_` on the upload thread, so
+  /// Finalize() has nothing left to do. See AsyncLoader::StartUploadThread().
+  virtual bool Upload();
+
+  /// @brief Creates a Texture from `data_` and stores the handle in `id_`,
+  /// unless Upload() already did.
   virtual bool Finalize();
 
   /// @brief Whether this object loaded and finalized correctly. Call after
@@ -150,8 +174,47 @@ class Texture : public AsyncAsset {
   /// @brief Delete the Texture stored in `id_`, and reset `id_` to `0`.
   void Delete();
 
+  /// @brief Estimate the GPU memory used by this Texture.
+  /// @return Returns the size in bytes of the texture data (including mipmaps)
+  /// in the format it was uploaded in, or 0 if not loaded or external.
+  size_t CalculateMemorySize() const;
+
+  /// @brief The GPU memory this Texture counts towards
+  /// RendererBase::gpu_memory(), in bytes.
+  size_t gpu_memory_size() const { return gpu_memory_size_; }
+
+  /// @brief The number of mip levels in the texture file, or 1 if the file
+  /// has no mip chain (mips generated on upload aren't counted).
+  int num_mips() const { return num_mips_; }
+
+  /// @brief The finest mip level on the GPU, 0 being the full size.
+  ///
+  /// Only above 0 for kTextureFlagsStreamMips textures still streaming in.
+  int resident_mip() const { return resident_mip_; }
+
+  /// @brief The finest mip level to stream in for kTextureFlagsStreamMips
+  /// textures. Defaults to 0, the full size.
+  int requested_mip() const { return requested_mip_; }
+
+  /// @brief Set the finest mip level to stream in. Levels already on the GPU
+  /// stay there.
+  /// @param[in] mip The mip level, 0 being the full size.
+  void set_requested_mip(int mip) { requested_mip_ = mip; }
+
+  /// @brief Request the coarsest mip level that still has at least as many
+  /// pixels as the texture covers on screen.
+  /// @param[in] screen_size The size the texture is drawn at, in pixels.
+  void RequestMipForScreenSize(const mathfu::vec2i &screen_size);
+
+  /// @brief Whether a finer mip than resident_mip() should be streamed in.
+  bool NeedsFinerMip() const {
+    return ValidTextureHandle(id_) && resident_mip_ > requested_mip_;
+  }
+
   /// @brief Update (part of) the current texture with new pixel data.
   /// For now, must always update at least entire row.
+  /// On ES3 / GL3 the pixels are staged through a ring of pixel unpack
+  /// buffers, which suits textures that are updated every frame.
   /// @param[in] unit Specifies which texture unit to do the update with.
   /// @param[in] texture_format The format of `data`.
   /// @param[in] xoffset Lowest x-pixel coordinate to update.
@@ -172,7 +235,8 @@ class Texture : public AsyncAsset {
   /// either 888 or 8888.
   /// @return Returns RGBA array of returned dimensions or `nullptr` if the
   /// format is not understood.
-  /// @note You must `free()` the returned pointer when done.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
   static uint8_t *UnpackTGA(const void *tga_buf, TextureFlags flags,
                             mathfu::vec2i *dimensions,
                             TextureFormat *texture_format);
@@ -189,7 +253,8 @@ class Texture : public AsyncAsset {
   /// either 888 or 8888.
   /// @return Returns a RGBA array of the returned dimensions or `nullptr`, if
   /// the format is not understood.
-  /// @note You must `free()` on the returned pointer when done.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
   static uint8_t *UnpackWebP(const void *webp_buf, size_t size,
                              const mathfu::vec2 &scale, TextureFlags flags,
                              mathfu::vec2i *dimensions,
@@ -205,7 +270,8 @@ class Texture : public AsyncAsset {
   /// kFormatASTC.
   /// @return Returns a buffer ready to be uploaded to GPU memory or `nullptr`,
   /// if the format is not understood.
-  /// @note You must `free()` on the returned pointer when done.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
   static uint8_t *UnpackASTC(const void *astc_buf, size_t size,
                              TextureFlags flags, mathfu::vec2i *dimensions,
                              TextureFormat *texture_format);
@@ -220,7 +286,8 @@ class Texture : public AsyncAsset {
   /// kFormatETC2.
   /// @return Returns a buffer ready to be uploaded to GPU memory or `nullptr`,
   /// if the format is not understood.
-  /// @note You must `free()` on the returned pointer when done.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
   static uint8_t *UnpackPKM(const void *file_buf, size_t size,
                             TextureFlags flags, mathfu::vec2i *dimensions,
                             TextureFormat *texture_format);
@@ -235,11 +302,47 @@ class Texture : public AsyncAsset {
   /// kFormatETC2.
   /// @return Returns a buffer ready to be uploaded to GPU memory or `nullptr`,
   /// if the format is not understood.
-  /// @note You must `free()` on the returned pointer when done.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
   static uint8_t *UnpackKTX(const void *file_buf, size_t size,
                             TextureFlags flags, mathfu::vec2i *dimensions,
                             TextureFormat *texture_format);
 
+  /// @brief Unpacks a memory buffer containing a KTXZ format file, a KTX file
+  /// supercompressed with LZ4.
+  /// @param[in] file_buf The loaded KTXZ file.
+  /// @param[in] size The size of the memory block pointed to by `file_buf`.
+  /// @param[in] flags Texture flags, as for UnpackKTX(). Mips of KTXZ files
+  /// are never streamed, so kTextureFlagsStreamMips is ignored.
+  /// @param[out] dimensions A `mathfu::vec2i` pointer the captures the image
+  /// width and height.
+  /// @param[out] texture_format The format of the returned buffer, always
+  /// kFormatKTX.
+  /// @return Returns the decompressed KTX file, as returned by UnpackKTX(), or
+  /// `nullptr` if the file is corrupt.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
+  static uint8_t *UnpackKTXZ(const void *file_buf, size_t size,
+                             TextureFlags flags, mathfu::vec2i *dimensions,
+                             TextureFormat *texture_format);
+
+  /// @brief Encodes an uncompressed image as ETC2, in the layout of a KTX
+  /// file, so that it uploads like one. Fast enough for images generated at
+  /// runtime, but not as good as an offline encoder.
+  /// @param[in] data The image, of `size` pixels in `texture_format`.
+  /// @param[in] size The width and height of the image.
+  /// @param[in] texture_format kFormat888 for GL_COMPRESSED_RGB8_ETC2, or
+  /// kFormat8888 for GL_COMPRESSED_RGBA8_ETC2_EAC, unless all its alpha is
+  /// opaque.
+  /// @param[in] flags With kTextureFlagsUseMipMaps, box filters the image
+  /// into mips down to 4x4, and encodes those too.
+  /// @return Returns the KTX data, of kFormatKTX, or `nullptr` for other
+  /// formats or images under 4x4.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
+  static uint8_t *EncodeETC2(const uint8_t *data, const mathfu::vec2i &size,
+                             TextureFormat texture_format, TextureFlags flags);
+
   /// @brief Unpacks a memory buffer containing a Png format file.
   /// @param[in] png_buf The Png image data.
   /// @param[in] size The size of the memory block pointed to by `data`.
@@ -251,7 +354,8 @@ class Texture : public AsyncAsset {
   /// @param[out] texture_format Pixel format of unpacked image.
   /// @return Returns a RGBA array of the returned dimensions or `nullptr`, if
   /// the format is not understood.
-  /// @note You must `free()` on the returned pointer when done.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
   static uint8_t *UnpackPng(const void *png_buf, size_t size,
                             const mathfu::vec2 &scale, TextureFlags flags,
                             mathfu::vec2i *dimensions,
@@ -270,7 +374,8 @@ class Texture : public AsyncAsset {
   /// @param[out] texture_format Pixel format of unpacked image.
   /// @return Returns a RGBA array of the returned dimensions or `nullptr`, if
   /// the format is not understood.
-  /// @note You must `free()` on the returned pointer when done.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
   static uint8_t *UnpackJpg(const void *jpg_buf, size_t size,
                             const mathfu::vec2 &scale, TextureFlags flags,
                             mathfu::vec2i *dimensions,
@@ -283,7 +388,8 @@ class Texture : public AsyncAsset {
   /// @note KTX/PKM/ASTC will automatically fall-back on WebP if the file is not
   /// present or not supported by the GPU.
   /// @note `last_error()` contains more information if `nullptr` is returned.
-  ///  You must `free()` the returned pointer when done.
+  ///  You must `FreeMemory()` the returned pointer when done, with
+  ///  `kAllocationTextureStaging`.
   /// @param[in] filename A C-string corresponding to the name of the file
   /// containing the Texture.
   /// @param[in] scale A scale value must be a power of two to have correct
@@ -293,26 +399,36 @@ class Texture : public AsyncAsset {
   /// width and height.
   /// @param[out] texture_format The format of the returned buffer, always
   /// either 888 or 8888.
+  /// @param[out] stats If not null, the time spent reading the file is added
+  /// to `io_time`, and its size to `file_bytes`.
   /// @return Returns a RGBA array of the returned dimensions or `nullptr`, if
   /// the format is not understood.
-  /// @note You must `free()` on the returned pointer when done.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
   static uint8_t *LoadAndUnpackTexture(const char *filename,
                                        const mathfu::vec2 &scale,
                                        TextureFlags flags,
                                        mathfu::vec2i *dimensions,
-                                       TextureFormat *texture_format);
+                                       TextureFormat *texture_format,
+                                       AssetLoadStats *stats = nullptr);
 
   /// @brief Utility function to convert 32bit RGBA (8-bits each) to 16bit RGB
   /// in hex 5551 format.
-  /// @note You must `delete[]` the return value afterwards.
+  /// @note You must `FreeMemory()` the return value afterwards, with
+  /// `kAllocationTransient`.
   static uint16_t *Convert8888To5551(const uint8_t *buffer,
                                      const mathfu::vec2i &size);
   /// @brief Utility function to convert 24bit RGB (8-bits each) to 16bit RGB in
   /// hex 565 format.
-  /// @note You must `delete[]` the return value afterwards.
+  /// @note You must `FreeMemory()` the return value afterwards, with
+  /// `kAllocationTransient`.
   static uint16_t *Convert888To565(const uint8_t *buffer,
                                    const mathfu::vec2i &size);
 
+  /// @brief The size of a pixel of an uncompressed format.
+  /// @return Returns the size in bytes, or 0 for compressed formats.
+  static size_t BytesPerPixel(TextureFormat format);
+
   /// @brief Create a texture from a memory buffer.
   /// @param[in] buffer The data to create the Texture from.
   /// @param[in] size The dimensions of the image in the data buffer.
@@ -383,6 +499,9 @@ class Texture : public AsyncAsset {
   MATHFU_DEFINE_CLASS_SIMD_AWARE_NEW_DELETE
 
  private:
+  friend class TextureMipStream;
+  friend class TextureCubeMapFace;
+
   // Backend-specific create and destroy calls. These just call new and delete
   // on the platform-specific MeshImpl structs.
   static TextureImpl *CreateTextureImpl();
@@ -396,12 +515,25 @@ class Texture : public AsyncAsset {
   /// @param[in] texture_format The format of `buffer`.
   /// @param[in] desired The desired TextureFormat.
   /// @param[in] flags Options for the texture.
+  /// @param[in] base_mip For KTX data holding only the mip tail: the mip
+  /// level of the first image in `buffer`.
+  /// @param[in] num_mips For uncompressed data, the number of mip levels
+  /// packed back to back in `buffer`, as built by BuildMipChain().
   /// @return Returns the Texture handle. Otherwise, it returns `0`, if not a
   /// power of two in size.
   static TextureHandle CreateTexture(
       const uint8_t *buffer, const mathfu::vec2i &size,
       TextureFormat texture_format, TextureFormat desired,
-      TextureFlags flags, TextureImpl *impl);
+      TextureFlags flags, TextureImpl *impl, int base_mip = 0,
+      int num_mips = 1);
+
+
+  /// @brief Upload mip level `mip`, one finer than resident_mip(), and make
+  /// it the finest level sampled from.
+  /// @param[in] data The compressed image data of the level.
+  /// @param[in] size The size of `data` in bytes.
+  /// @return Returns false if `mip` doesn't follow resident_mip().
+  bool UploadMip(int mip, const uint8_t *data, size_t size);
 
   /// @brief Unpacks a memory buffer containing a PNG/JPEG/TGA format file.
   /// @param[in] img_buf The PNG/JPEG/TGA image data including an image header.
@@ -415,7 +547,8 @@ class Texture : public AsyncAsset {
   /// image has an alpha.
   /// @return Returns a RGBA array of the returned dimensions or `nullptr`, if
   /// the format is not understood.
-  /// @note You must `free()` on the returned pointer when done.
+  /// @note You must `FreeMemory()` the returned pointer when done, with
+  /// `kAllocationTextureStaging`.
   static uint8_t *UnpackImage(const void *img_buf, size_t size,
                               const mathfu::vec2 &scale, TextureFlags flags,
                               mathfu::vec2i *dimensions,
@@ -424,6 +557,44 @@ class Texture : public AsyncAsset {
   /// @brief Backend specific conversion of flags to TextureTarget.
   static TextureTarget TextureTargetFromFlags(TextureFlags flags);
 
+  /// @brief Resolve kFormatAuto and kFormatNative to the format the data will
+  /// be uploaded in, given data in `texture_format`.
+  static TextureFormat UploadFormat(TextureFormat desired,
+                                    TextureFormat texture_format);
+
+  /// @brief Convert `data_` to the 16bpp format it will be uploaded in, so
+  /// that Finalize() only has to hand it to the GPU. Called from Load(),
+  /// which typically runs on the loader thread.
+  void ConvertDataToUploadFormat();
+
+  /// @brief Creates the GL texture from `data_`, and frees `data_`.
+  void CreateFromData();
+
+  /// @brief Updates `gpu_memory_size_` after the GL texture changed.
+  void UpdateGpuMemorySize();
+
+  /// @brief Upload face `face` of a cube map loaded as separate faces, from
+  /// `image`, a 2D Texture that loaded it. The first face creates the GL
+  /// texture, and decides the size and format of the others.
+  /// @return Returns false if `image` didn't load, or doesn't match the faces
+  /// uploaded before it.
+  bool UploadCubeMapFace(int face, const Texture &image);
+
+  /// @brief Complete a cube map once all UploadCubeMapFace() calls are done,
+  /// generating its mips if the faces had none, and finalize it.
+  void FinishCubeMap();
+
+  /// @brief Whether kTextureFlagsCompressOnLoad applies to an image of
+  /// `size_` pixels in `texture_format`.
+  bool ShouldEncodeETC2(TextureFormat texture_format) const;
+
+  /// @brief Whether Load() should build the mip chain of `data_` itself.
+  bool ShouldBuildMipChain() const;
+
+  /// @brief Replace `data_` with all its mip levels down to 1x1, box
+  /// filtered and packed back to back, and set `num_mips_`.
+  void BuildMipChain();
+
   TextureImpl *impl_;
   TextureHandle id_;
   mathfu::vec2i size_;
@@ -434,6 +605,82 @@ class Texture : public AsyncAsset {
   TextureFormat desired_;
   TextureFlags flags_;
   bool is_external_;
+  int num_mips_;
+  int resident_mip_;
+  int requested_mip_;
+  // The GL internal format of the KTX mips, for UploadMip().
+  uint32_t mip_format_;
+  // The TextureCubeMapFace objects still to upload a face of this texture.
+  int cube_map_faces_pending_;
+  // What this texture reported to RendererBase::TrackGpuMemory().
+  size_t gpu_memory_size_;
+};
+
+/// @class TextureMipStream
+/// @brief Reads the next finer mip of a kTextureFlagsStreamMips Texture on a
+/// loader thread, and uploads it to the Texture when finalized.
+///
+/// Created and queued by AssetManager::TryFinalize(), which also owns them.
+class TextureMipStream : public AsyncAsset {
+ public:
+  /// @brief Stream mip level `mip` of `texture`'s file into `texture`.
+  TextureMipStream(Texture *texture, int mip);
+  virtual ~TextureMipStream();
+
+  /// @brief Reads the mip level from the file, without touching the Texture.
+  virtual void Load();
+
+  /// @brief Uploads the mip level to the Texture.
+  virtual bool Finalize();
+
+  /// @brief Whether the mip level was read and uploaded.
+  virtual bool IsValid() { return uploaded_; }
+
+  /// @brief The Texture being streamed into.
+  Texture *texture() const { return texture_; }
+
+ private:
+  Texture *texture_;
+  int mip_;
+  size_t size_;
+  bool uploaded_;
+};
+
+/// @class TextureCubeMapFace
+/// @brief Loads one face of a cube map made of 6 separate files on a loader
+/// thread, and uploads it to the cube map Texture when finalized.
+///
+/// The faces of a cube map load in parallel, and each is freed as soon as it
+/// is uploaded, so only the faces in flight are ever held in memory, rather
+/// than a whole 1x6 strip. Each face is loaded like a 2D Texture, so gets the
+/// same mip building, conversion, and compression, but never streams mips.
+/// Created and owned by AssetManager::LoadCubeMap().
+class TextureCubeMapFace : public AsyncAsset {
+ public:
+  /// @brief Load `filename` as face `face` of `texture`, in the GL order of
+  /// +X, -X, +Y, -Y, +Z, -Z.
+  TextureCubeMapFace(Texture *texture, int face, const char *filename);
+  virtual ~TextureCubeMapFace();
+
+  /// @brief Reads and decodes the face, without touching the cube map.
+  virtual void Load();
+
+  /// @brief Uploads the face to the cube map, and finalizes the cube map if
+  /// it was the last one.
+  virtual bool Finalize();
+
+  /// @brief Whether the face was loaded and uploaded.
+  virtual bool IsValid() { return uploaded_; }
+
+  /// @brief The cube map being loaded into.
+  Texture *texture() const { return texture_; }
+
+ private:
+  Texture *texture_;
+  int face_;
+  // The face, loaded as a 2D texture, but never created on the GPU.
+  Texture *image_;
+  bool uploaded_;
 };
 
 /// @brief used by some functions to allow the texture loading mechanism to
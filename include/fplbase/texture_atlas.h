@@ -15,12 +15,15 @@
 #ifndef FPLBASE_TEXTURE_ATLAS_H
 #define FPLBASE_TEXTURE_ATLAS_H
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
 
 #include "fplbase/config.h"  // Must come first.
 #include "fplbase/asset.h"
+#include "fplbase/asset_id.h"
+#include "fplbase/texture.h"
 
 namespace fplbase {
 
@@ -39,15 +42,23 @@ class Texture;
 /// index_map. Subtexture bounding boxes are returned in normalized texture
 /// coordinates, and take the form (u, v, width, height).
 ///
+/// Lookups by name hash the name, the way AssetId does, and binary search a
+/// sorted array of hashes. In code that looks up the same names every frame,
+/// hash them once (at compile time for literals) with AssetId, or resolve
+/// them once to an index into subtexture_bounds() with FindIndex().
+///
 /// @warning This is will very likely be refactored.
 class TextureAtlas : public Asset {
  public:
+  /// @brief Returned by FindIndex() for names not in the atlas.
+  static const size_t kInvalidSubtextureIndex = static_cast<size_t>(-1);
+
   TextureAtlas() : atlas_texture_(nullptr) {}
   ~TextureAtlas() { Delete(); }
 
   /// @brief Delete the texture associated with this atlas.
   void Delete() {
-    atlas_texture_->Delete();
+    if (atlas_texture_) atlas_texture_->Delete();
     atlas_texture_ = nullptr;
   }
 
@@ -57,11 +68,62 @@ class TextureAtlas : public Asset {
   /// @returns Bounds of the subtexture or nullptr if the specified name isn't
   /// found.
   const vec4 *GetBounds(const std::string &name) {
-    auto index_iter = index_map_.find(name);
-    if (index_iter != index_map_.end()) {
-      return &subtexture_bounds_[index_iter->second];
+    return GetBounds(AssetId(name));
+  }
+
+  /// @brief Get the bounds of a subtexture associated with name, without
+  /// building a std::string.
+  const vec4 *GetBounds(const char *name) { return GetBounds(AssetId(name)); }
+
+  /// @brief Get the bounds of the subtexture with the given hashed name.
+  const vec4 *GetBounds(const AssetId &id) {
+    const size_t index = FindIndex(id);
+    return index < subtexture_bounds_.size() ? &subtexture_bounds_[index]
+                                             : nullptr;
+  }
+
+  /// @brief Find the index in subtexture_bounds() of a subtexture.
+  ///
+  /// @param id The hashed name of the subtexture.
+  /// @returns The index, or kInvalidSubtextureIndex if there is none by that
+  /// name.
+  size_t FindIndex(const AssetId &id) const {
+    SyncHashedIndex();
+    auto it = std::lower_bound(hashed_index_.begin(), hashed_index_.end(),
+                               HashedIndex(id.hash(), 0));
+    if (it == hashed_index_.end() || it->hash != id.hash()) {
+      return kInvalidSubtextureIndex;
     }
-    return nullptr;
+    return it->index;
+  }
+
+  /// @brief Add a subtexture to look up by name.
+  ///
+  /// @param name Name of the subtexture. If already in use, the name keeps
+  /// referring to the earlier subtexture.
+  /// @param bounds Normalized bounds of the subtexture.
+  /// @returns The index of the subtexture in subtexture_bounds().
+  size_t AddSubtexture(const std::string &name, const vec4 &bounds) {
+    SyncHashedIndex();
+    const size_t index = subtexture_bounds_.size();
+    subtexture_bounds_.push_back(bounds);
+    if (index_map_.insert(std::make_pair(name, index)).second) {
+      const HashedIndex entry(AssetId(name).hash(), index);
+      auto it = std::lower_bound(hashed_index_.begin(), hashed_index_.end(),
+                                 entry);
+      // Two names with the same 64-bit hash. Vanishingly unlikely, but catch
+      // it in debug builds.
+      assert(it == hashed_index_.end() || it->hash != entry.hash);
+      hashed_index_.insert(it, entry);
+    }
+    return index;
+  }
+
+  /// @brief Remove all subtextures.
+  void ClearSubtextures() {
+    subtexture_bounds_.clear();
+    index_map_.clear();
+    hashed_index_.clear();
   }
 
   /// @brief Get the texture associated with this atlas.
@@ -111,6 +173,8 @@ class TextureAtlas : public Asset {
   ///
   /// @return A map of subtexture names to indices in vector returned by
   /// @ref subtexture_bounds().
+  /// @note Prefer AddSubtexture() and ClearSubtextures(). Lookups only pick
+  /// up direct changes to the map that change its size.
   std::map<std::string, size_t> &index_map() { return index_map_; }
 
   /// @brief Load a texture atlas file. Used by the more convenient AssetManager
@@ -120,12 +184,94 @@ class TextureAtlas : public Asset {
                                         TextureFlags flags,
                                         const TextureLoaderFn &tlf);
  private:
+  struct HashedIndex {
+    HashedIndex(uint64_t name_hash, size_t bounds_index)
+        : hash(name_hash), index(bounds_index) {}
+    bool operator<(const HashedIndex &rhs) const { return hash < rhs.hash; }
+    uint64_t hash;
+    size_t index;
+  };
+
+  // Rebuilds hashed_index_ if index_map_ was changed directly.
+  void SyncHashedIndex() const {
+    if (hashed_index_.size() == index_map_.size()) return;
+    hashed_index_.clear();
+    for (auto it = index_map_.begin(); it != index_map_.end(); ++it) {
+      hashed_index_.push_back(HashedIndex(AssetId(it->first).hash(),
+                                          it->second));
+    }
+    std::sort(hashed_index_.begin(), hashed_index_.end());
+  }
+
   // Texture being used by this atlas.
   Texture *atlas_texture_;
   // List of bounds (offsetx, offsety, sizex, sizey) of each subtexture.
   std::vector<vec4> subtexture_bounds_;
   // Map of subtexture names to indices into subtexture_bounds_.
   std::map<std::string, size_t> index_map_;
+  // The hashes of the names in index_map_ with their indices, sorted by hash.
+  mutable std::vector<HashedIndex> hashed_index_;
+};
+
+/// @class DynamicTextureAtlas
+/// @brief A TextureAtlas that packs subtextures into its texture at runtime.
+///
+/// Useful for the many small images (e.g. UI elements, glyphs) generated
+/// while running, which would otherwise each need a Texture of their own and
+/// a bind per draw. Subtextures are placed with a skyline packer, and
+/// uploaded with Texture::UpdateTexture(). Their bounds are available from
+/// GetBounds() like those of a baked atlas.
+class DynamicTextureAtlas : public TextureAtlas {
+ public:
+  /// @brief Creates the atlas texture, cleared to 0.
+  /// @param size The size of the atlas texture in pixels.
+  /// @param format The format of the texture and the subtexture data. One of
+  /// the formats Texture::UpdateTexture() supports.
+  /// @param flags Options for the texture. Mipmaps aren't supported, since
+  /// only the first level is updated.
+  /// @param padding Pixels to leave between subtextures, so filtering near
+  /// their edges doesn't pick up their neighbors.
+  DynamicTextureAtlas(const mathfu::vec2i &size, TextureFormat format,
+                      TextureFlags flags = kTextureFlagsClampToEdge,
+                      int padding = 1);
+  ~DynamicTextureAtlas();
+
+  /// @brief Packs a subtexture into the atlas and uploads it.
+  ///
+  /// @param name Name to look the subtexture up by with GetBounds().
+  /// @param size Size of the subtexture in pixels.
+  /// @param data The pixels, in the format of the atlas, with rows padded to
+  /// 4 bytes as for Texture::UpdateTexture().
+  /// @returns Normalized bounds of the subtexture, the existing bounds if
+  /// `name` was already added, or nullptr if it doesn't fit. Like the
+  /// pointers from GetBounds(), it's valid until the next Add() or Clear().
+  const vec4 *Add(const std::string &name, const mathfu::vec2i &size,
+                  const void *data);
+
+  /// @brief Forgets all subtextures, making all of the atlas available again.
+  /// The texture keeps its contents until they're overwritten.
+  void Clear();
+
+  /// @brief The size of the atlas texture in pixels.
+  const mathfu::vec2i &size() const { return size_; }
+
+ private:
+  // A horizontal segment of the top edge of the packed area.
+  struct SkylineSegment {
+    int x;
+    int y;
+    int width;
+  };
+
+  // Finds the lowest place for a `size` rectangle, returning false if full.
+  bool Pack(const mathfu::vec2i &size, mathfu::vec2i *position);
+  // The lowest y at which a `width` rectangle at segment `index` fits, or -1.
+  int FitAt(size_t index, int width) const;
+
+  mathfu::vec2i size_;
+  TextureFormat format_;
+  int padding_;
+  std::vector<SkylineSegment> skyline_;
 };
 
 /// @}
@@ -0,0 +1,241 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef FPLBASE_TRACE_H
+#define FPLBASE_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fplbase/config.h"  // Must come first.
+
+/// @file fplbase/trace.h
+/// @brief Scoped trace events and counters, sent to a pluggable backend.
+///
+/// fplbase marks its own hot paths (frame advance, asset loading and
+/// finalizing, and mesh rendering) with these, and apps can add their own:
+///
+///     void Update() {
+///       FPLBASE_TRACE_SCOPE("Update");
+///       ...
+///       FPLBASE_TRACE_COUNTER("Enemies", enemies.size());
+///     }
+///
+/// Events go nowhere until a TraceBackend is installed with
+/// SetTraceBackend(). TraceEventFileBackend writes the Chrome trace event
+/// format, which chrome://tracing and the Perfetto UI open on any platform.
+/// On Android, SystraceBackend writes to the kernel's trace_marker instead,
+/// for systrace and Perfetto captures.
+///
+/// Event names must be string literals, or otherwise outlive the backend.
+///
+/// Without a backend, a trace point is a load and a branch. To compile them
+/// out entirely, \#define FPLBASE_ENABLE_TRACING 0.
+/// @addtogroup fplbase_trace
+/// @{
+
+#ifndef FPLBASE_ENABLE_TRACING
+#define FPLBASE_ENABLE_TRACING 1
+#endif
+
+namespace fplbase {
+
+/// @class TraceBackend
+/// @brief Receives the events of the Trace functions below.
+///
+/// Events come from any thread, so implementations must be thread safe.
+/// Begin() and End() pair up per thread.
+class TraceBackend {
+ public:
+  virtual ~TraceBackend() {}
+
+  /// @brief Begins a block named `name` on the calling thread.
+  virtual void Begin(const char *name) = 0;
+
+  /// @brief Ends the block most recently begun on the calling thread.
+  virtual void End() = 0;
+
+  /// @brief Records the current value of the counter named `name`.
+  virtual void Counter(const char *name, int64_t value) = 0;
+
+  /// @brief Begins a block that may end on another thread. `name` and
+  /// `cookie` identify the block.
+  virtual void AsyncBegin(const char *name, int32_t cookie) = 0;
+
+  /// @brief Ends the block begun by AsyncBegin() with the same `name` and
+  /// `cookie`.
+  virtual void AsyncEnd(const char *name, int32_t cookie) = 0;
+};
+
+/// @brief Sends trace events to `backend`, or discards them if null.
+///
+/// The backend is not owned, and must outlive its use: uninstall it, and
+/// make sure no thread is still tracing, before destroying it.
+void SetTraceBackend(TraceBackend *backend);
+
+/// @brief The backend set by SetTraceBackend(), or null.
+TraceBackend *GetTraceBackend();
+
+/// @brief Begins a block. Prefer FPLBASE_TRACE_SCOPE().
+inline void TraceBegin(const char *name) {
+  TraceBackend *backend = GetTraceBackend();
+  if (backend) backend->Begin(name);
+}
+
+/// @brief Ends the block most recently begun on this thread.
+inline void TraceEnd() {
+  TraceBackend *backend = GetTraceBackend();
+  if (backend) backend->End();
+}
+
+/// @brief Records a counter value, graphed over time by trace viewers.
+inline void TraceCounter(const char *name, int64_t value) {
+  TraceBackend *backend = GetTraceBackend();
+  if (backend) backend->Counter(name, value);
+}
+
+/// @brief Begins a block that may end on another thread.
+inline void TraceAsyncBegin(const char *name, int32_t cookie) {
+  TraceBackend *backend = GetTraceBackend();
+  if (backend) backend->AsyncBegin(name, cookie);
+}
+
+/// @brief Ends a block begun by TraceAsyncBegin().
+inline void TraceAsyncEnd(const char *name, int32_t cookie) {
+  TraceBackend *backend = GetTraceBackend();
+  if (backend) backend->AsyncEnd(name, cookie);
+}
+
+/// @class TraceScope
+/// @brief Traces a block for the lifetime of the object. See
+/// FPLBASE_TRACE_SCOPE().
+class TraceScope {
+ public:
+  explicit TraceScope(const char *name) : backend_(GetTraceBackend()) {
+    if (backend_) backend_->Begin(name);
+  }
+  // Ends the block on the backend that began it, even if another one has
+  // been installed since.
+  ~TraceScope() {
+    if (backend_) backend_->End();
+  }
+
+ private:
+  TraceScope(const TraceScope &);
+  TraceScope &operator=(const TraceScope &);
+
+  TraceBackend *backend_;
+};
+
+struct TraceEventFileBackendImpl;
+
+/// @class TraceEventFileBackend
+/// @brief Writes events to a file in the Chrome trace event (JSON) format.
+///
+/// Open the file in chrome://tracing or https://ui.perfetto.dev. Times are
+/// from GetTimeInSeconds().
+///
+/// Cheap enough to leave on in release builds: each thread appends compact
+/// binary records to a ring buffer of its own, without locks or system
+/// calls, and refers to names by pointer instead of copying them. A
+/// background thread formats and writes the records. If a thread fills its
+/// ring faster than they are written, its newest events are dropped and
+/// counted in num_dropped_events().
+class TraceEventFileBackend : public TraceBackend {
+ public:
+  /// @brief The number of events each thread can buffer.
+  static const size_t kDefaultEventsPerThread = 8192;
+
+  /// @param events_per_thread Rounded up to a power of two.
+  explicit TraceEventFileBackend(
+      size_t events_per_thread = kDefaultEventsPerThread);
+  virtual ~TraceEventFileBackend();
+
+  /// @brief Starts writing to `filename`, replacing it if it exists.
+  /// @return Returns false if the file can't be created.
+  bool Open(const char *filename);
+
+  /// @brief Writes the remaining buffered events and finishes the file.
+  /// Events after this are dropped.
+  void Close();
+
+  /// @brief Writes out the events buffered so far, and waits until they are.
+  void Flush();
+
+  /// @brief Events dropped because their thread's ring buffer was full.
+  size_t num_dropped_events() const;
+
+  virtual void Begin(const char *name);
+  virtual void End();
+  virtual void Counter(const char *name, int64_t value);
+  virtual void AsyncBegin(const char *name, int32_t cookie);
+  virtual void AsyncEnd(const char *name, int32_t cookie);
+
+ private:
+  TraceEventFileBackend(const TraceEventFileBackend &);
+  TraceEventFileBackend &operator=(const TraceEventFileBackend &);
+
+  // Appends an event to the calling thread's ring buffer.
+  void Add(char phase, const char *name, int64_t value);
+
+  TraceEventFileBackendImpl *impl_;
+};
+
+#if defined(__ANDROID__)
+/// @class SystraceBackend
+/// @brief Writes events to the kernel's trace_marker, for systrace.
+class SystraceBackend : public TraceBackend {
+ public:
+  SystraceBackend();
+  virtual ~SystraceBackend();
+
+  /// @brief Whether trace_marker could be opened.
+  bool IsValid() const { return trace_marker_ >= 0; }
+
+  virtual void Begin(const char *name);
+  virtual void End();
+  virtual void Counter(const char *name, int64_t value);
+  virtual void AsyncBegin(const char *name, int32_t cookie);
+  virtual void AsyncEnd(const char *name, int32_t cookie);
+
+ private:
+  void Write(const char *format, const char *name, int64_t value);
+
+  int trace_marker_;
+};
+#endif  // defined(__ANDROID__)
+
+}  // namespace fplbase
+
+#define FPLBASE_TRACE_CONCAT_INNER(a, b) a##b
+#define FPLBASE_TRACE_CONCAT(a, b) FPLBASE_TRACE_CONCAT_INNER(a, b)
+
+#if FPLBASE_ENABLE_TRACING
+/// @brief Traces a block from here to the end of the enclosing scope.
+#define FPLBASE_TRACE_SCOPE(name) \
+  ::fplbase::TraceScope FPLBASE_TRACE_CONCAT(fplbase_trace_scope_, \
+                                             __LINE__)(name)
+/// @brief Records a counter value.
+#define FPLBASE_TRACE_COUNTER(name, value) \
+  ::fplbase::TraceCounter(name, static_cast<int64_t>(value))
+#else
+#define FPLBASE_TRACE_SCOPE(name) \
+  do {                            \
+  } while (0)
+#define FPLBASE_TRACE_COUNTER(name, value) \
+  do {                                     \
+  } while (0)
+#endif  // FPLBASE_ENABLE_TRACING
+
+/// @}
+#endif  // FPLBASE_TRACE_H
@@ -44,6 +44,25 @@ enum PerformanceMode {
   kHighPerformance
 };
 
+/// @brief How hot the device is, from `GetThermalStatus()`. The values match
+/// Android's `PowerManager.THERMAL_STATUS_*`.
+enum ThermalStatus {
+  // Not throttling, or the status isn't known.
+  kThermalStatusNone = 0,
+  // Throttling that doesn't affect the user experience much.
+  kThermalStatusLight,
+  // Throttling that affects performance noticeably.
+  kThermalStatusModerate,
+  // Heavy throttling.
+  kThermalStatusSevere,
+  // The platform is reducing power as much as it can.
+  kThermalStatusCritical,
+  // Key components are being shut down.
+  kThermalStatusEmergency,
+  // The device is about to shut down.
+  kThermalStatusShutdown
+};
+
 #ifdef __ANDROID__
 /// @brief Used for Android to represent a Vsync callback function.
 typedef void (*VsyncCallback)(void);
@@ -102,6 +121,8 @@ bool LoadPreferences(const char *filename, std::string *dest);
 /// by `filename`.
 /// @return Returns `false` if the file couldn't be loaded (usually means it's
 /// not present, but can also mean there was a read error).
+/// @note With `SetWriteBehind()` on, the write is queued instead, and this
+/// returns `true`.
 bool SavePreferences(const char *filename, const void *data, size_t size);
 
 /// @brief Load a single integer value to a preference.
@@ -114,11 +135,17 @@ int32_t LoadPreference(const char *key, int32_t initial_value);
 /// @brief Save a single integer value to a preference.
 /// @param[in] key The UTF-8 key for the preference.
 /// @param[in] value The value to save for the preference.
+/// @note With `SetWriteBehind()` on, the write is queued instead, and this
+/// returns `true` on Android.
 bool SavePreference(const char *key, int32_t value);
 
 /// @brief Map a file into memory and returns its contents via pointer.
 /// @details In contrast to `LoadFile()`, this method calls mmap API to map the
 /// whole or a part of the file.
+/// On Android, relative paths are looked up in the APK through the
+/// `AAssetManager` set with `SetAAssetManager()`. Only entries stored
+/// uncompressed can be mapped; for others this returns nullptr, and the file
+/// has to be copied with `LoadFile()` instead.
 /// @param[in] filename A UTF-8 C-string representing the file to load.
 /// @param[in] offset An offset of the file contents to map.
 /// @param[in/out] size A size to map. A size of 0 indicates to map whole file.
@@ -131,11 +158,57 @@ const void *MapFile(const char *filename, int32_t offset, int32_t *size);
 /// @param[in] size A size to unmap.
 void UnmapFile(const void *file, int32_t size);
 
+/// @class FileView
+/// @brief Read-only contents of a file, mapped into memory where possible
+/// rather than copied.
+///
+/// For data that is only read, such as FlatBuffers or compressed textures.
+/// Load() maps the file with `MapFile()`, and falls back to `LoadFile()` into
+/// a pooled buffer (see `AcquireFileBuffer()`) when it can't be mapped, e.g.
+/// for compressed APK entries, or when `SetLoadFileFunction()` is in use.
+/// A write still queued by `SetWriteBehind()` is read instead of the file.
+class FileView {
+ public:
+  FileView() : data_(nullptr), size_(0), mapped_size_(0), buffer_(nullptr) {}
+  ~FileView() { Reset(); }
+
+  /// @brief Load `filename`, replacing any previous contents.
+  /// @return Returns `false` if the file couldn't be loaded.
+  bool Load(const char *filename);
+
+  /// @brief Unmap or release the contents.
+  void Reset();
+
+  /// @brief The contents, or nullptr if not loaded.
+  const uint8_t *data() const { return data_; }
+
+  /// @brief The size of the contents in bytes.
+  size_t size() const { return size_; }
+
+  /// @brief Whether the contents are mapped rather than copied.
+  bool mapped() const { return mapped_size_ != 0; }
+
+ private:
+  FileView(const FileView &);
+  FileView &operator=(const FileView &);
+
+  const uint8_t *data_;
+  size_t size_;
+  int32_t mapped_size_;
+  std::string *buffer_;
+};
+
 /// @brief check if 16bpp MipMap is supported.
 /// @return Return `true` if 16bpp MipMap generation is supported.
 /// @note Basically always true, except on certain android devices.
 bool MipmapGeneration16bppSupported();
 
+/// @brief Get the time from a monotonic, high resolution clock.
+/// @details Use for measuring durations, e.g. for time budgets and profiling.
+/// Safe to call from any thread.
+/// @return Returns the time in seconds since an arbitrary, fixed point.
+double GetTimeInSeconds();
+
 /// @brief Get the system's RAM size.
 /// @return Returns the system RAM size in MB.
 int32_t GetSystemRamSize();
@@ -179,6 +252,11 @@ void WaitForVsync();
 /// @warning May eventually wrap.
 int GetVsyncFrameId();
 
+/// @brief Get the time of the latest vsync reported by the choreographer.
+/// @return Returns the time, on the clock of GetTimeInSeconds(), or 0 if
+/// there hasn't been one.
+double GetVsyncTime();
+
 /// @brief Triggers a keypress event on an Android device.
 /// @param[in] android_keycode The key code corresponding to the
 /// keypress that should be triggered.
@@ -233,6 +311,12 @@ void SetPerformanceMode(PerformanceMode new_mode);
 /// @return Returns the current `PerformanceMode`.
 PerformanceMode GetPerformanceMode();
 
+/// @brief Get how much the device is throttling to stay cool.
+/// @return Returns the thermal status on Android Q and later, and
+/// `kThermalStatusNone` elsewhere. Makes a JNI call on Android, so don't poll
+/// it more than a few times a second.
+ThermalStatus GetThermalStatus();
+
 /// @brief Relaunch the application.
 void RelaunchApplication();
 
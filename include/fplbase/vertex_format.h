@@ -0,0 +1,198 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_VERTEX_FORMAT_H
+#define FPLBASE_VERTEX_FORMAT_H
+
+#include <stddef.h>
+#include <type_traits>
+
+#include "fplbase/mesh.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_mesh
+/// @{
+
+/// @brief The type of each component of a vertex attribute, independent of
+/// the graphics API.
+enum VertexComponentType {
+  kVertexComponentFloat,
+  kVertexComponentHalfFloat,
+  kVertexComponentUnsignedByte,
+  kVertexComponentUnsignedShort,
+  kVertexComponentShort,
+  kVertexComponentInt2_10_10_10Rev,
+};
+
+/// @brief How an Attribute is laid out in a vertex and read by shaders:
+/// its byte size, its attribute location (one of Mesh::kAttribute*), and
+/// the arguments for pointing the attribute array at it.
+///
+/// Attributes with several rows, like kInstanceTransform3x4f, take `kRows`
+/// consecutive locations of `kSize / kRows` bytes each.
+template <Attribute A>
+struct VertexAttributeTraits;
+
+// clang-format off
+#define FPLBASE_VERTEX_ATTRIBUTE(attribute, size, location, components, type, \
+                                 normalized, rows)                            \
+  template <>                                                                 \
+  struct VertexAttributeTraits<attribute> {                                   \
+    static const size_t kSize = size;                                         \
+    static const unsigned int kLocation = Mesh::location;                     \
+    static const int kComponents = components;                                \
+    static const VertexComponentType kType = kVertexComponent##type;          \
+    static const bool kNormalized = normalized;                               \
+    static const int kRows = rows;                                            \
+    static const bool kPerInstance =                                          \
+        Mesh::location >= Mesh::kAttributeInstanceTransform;                  \
+  };
+FPLBASE_VERTEX_ATTRIBUTE(kPosition3f, 3 * sizeof(float), kAttributePosition, 3, Float, false, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kPosition2f, 2 * sizeof(float), kAttributePosition, 2, Float, false, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kPosition3h, 4 * sizeof(uint16_t), kAttributePosition, 3, HalfFloat, false, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kNormal3f, 3 * sizeof(float), kAttributeNormal, 3, Float, false, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kNormalOct2s, 2 * sizeof(int16_t), kAttributeNormal, 2, Short, true, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kTangent4f, 4 * sizeof(float), kAttributeTangent, 4, Float, false, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kOrientation4f, 4 * sizeof(float), kAttributeOrientation, 4, Float, false, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kOrientationPacked, sizeof(uint32_t), kAttributeOrientation, 4, Int2_10_10_10Rev, true, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kTexCoord2f, 2 * sizeof(float), kAttributeTexCoord, 2, Float, false, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kTexCoord2us, 2 * sizeof(uint16_t), kAttributeTexCoord, 2, UnsignedShort, true, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kTexCoord2h, 2 * sizeof(uint16_t), kAttributeTexCoord, 2, HalfFloat, false, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kTexCoordAlt2f, 2 * sizeof(float), kAttributeTexCoordAlt, 2, Float, false, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kColor4ub, 4, kAttributeColor, 4, UnsignedByte, true, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kBoneIndices4ub, 4, kAttributeBoneIndices, 4, UnsignedByte, false, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kBoneWeights4ub, 4, kAttributeBoneWeights, 4, UnsignedByte, true, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kInstanceTransform3x4f, 12 * sizeof(float), kAttributeInstanceTransform, 4, Float, false, 3)
+FPLBASE_VERTEX_ATTRIBUTE(kInstanceColor4ub, 4, kAttributeInstanceColor, 4, UnsignedByte, true, 1)
+FPLBASE_VERTEX_ATTRIBUTE(kInstancePaletteOffset1f, sizeof(float), kAttributeInstancePaletteOffset, 1, Float, false, 1)
+#undef FPLBASE_VERTEX_ATTRIBUTE
+// clang-format on
+
+namespace internal {
+
+// The sum of `Values`.
+template <size_t... Values>
+struct VertexFormatSum : std::integral_constant<size_t, 0> {};
+template <size_t First, size_t... Rest>
+struct VertexFormatSum<First, Rest...>
+    : std::integral_constant<size_t,
+                             First + VertexFormatSum<Rest...>::value> {};
+
+// The byte offset of `Target` in a vertex of `Attributes`.
+template <Attribute Target, Attribute... Attributes>
+struct VertexFormatOffset {
+  static_assert(sizeof(VertexAttributeTraits<Target>) == 0,
+                "Attribute is not part of the vertex format");
+};
+template <Attribute Target, Attribute... Rest>
+struct VertexFormatOffset<Target, Target, Rest...>
+    : std::integral_constant<size_t, 0> {};
+template <Attribute Target, Attribute First, Attribute... Rest>
+struct VertexFormatOffset<Target, First, Rest...>
+    : std::integral_constant<
+          size_t, VertexAttributeTraits<First>::kSize +
+                      VertexFormatOffset<Target, Rest...>::value> {};
+
+// Whether none of `Attributes` is read at `Location`.
+template <unsigned int Location, Attribute... Attributes>
+struct VertexFormatLocationFree : std::true_type {};
+template <unsigned int Location, Attribute First, Attribute... Rest>
+struct VertexFormatLocationFree<Location, First, Rest...>
+    : std::integral_constant<
+          bool, Location != VertexAttributeTraits<First>::kLocation &&
+                    VertexFormatLocationFree<Location, Rest...>::value> {};
+
+// Whether no two of `Attributes` are read at the same location.
+template <Attribute... Attributes>
+struct VertexFormatDistinct : std::true_type {};
+template <Attribute First, Attribute... Rest>
+struct VertexFormatDistinct<First, Rest...>
+    : std::integral_constant<
+          bool, VertexFormatLocationFree<
+                    VertexAttributeTraits<First>::kLocation, Rest...>::value &&
+                    VertexFormatDistinct<Rest...>::value> {};
+
+}  // namespace internal
+
+/// @brief A vertex format fixed at compile time, such as
+/// `VertexFormat<kPosition3f, kTexCoord2f>`.
+///
+/// The stride and the offset of each attribute are constants, rather than
+/// walks of a kEND-terminated array, and SetAttributes() with a
+/// VertexFormat points each attribute array without looping over the
+/// format. A VertexFormat converts to the equivalent runtime array for
+/// anything that takes a `const Attribute *`, such as Mesh::set_format()
+/// or RenderArray().
+///
+/// The format follows the same rules as Mesh::IsValidFormat() for vertices,
+/// or Mesh::IsValidInstanceFormat() for instances; attributes reading the
+/// same location, or mixing per-vertex and per-instance attributes, fail to
+/// compile.
+template <Attribute... Attributes>
+struct VertexFormat {
+  static_assert(sizeof...(Attributes) > 0, "Vertex format is empty");
+  static_assert(internal::VertexFormatDistinct<Attributes...>::value,
+                "Attributes of a vertex format must use distinct locations");
+  static_assert(
+      internal::VertexFormatSum<
+          VertexAttributeTraits<Attributes>::kPerInstance...>::value %
+              sizeof...(Attributes) ==
+          0,
+      "Vertex format mixes per-vertex and per-instance attributes");
+
+  /// @brief The byte size of a vertex.
+  static const size_t kStride =
+      internal::VertexFormatSum<VertexAttributeTraits<Attributes>::kSize...>::
+          value;
+
+  /// @brief The number of attributes, not counting kEND.
+  static const size_t kNumAttributes = sizeof...(Attributes);
+
+  /// @brief The attributes as an array terminated with kEND.
+  static const Attribute kAttributes[sizeof...(Attributes) + 1];
+
+  /// @brief The byte offset of attribute `A` within a vertex. Fails to
+  /// compile if the format doesn't have `A`.
+  template <Attribute A>
+  static constexpr size_t Offset() {
+    return internal::VertexFormatOffset<A, Attributes...>::value;
+  }
+
+  /// @brief Whether the format has attribute `A`.
+  template <Attribute A>
+  static constexpr bool Has() {
+    return internal::VertexFormatSum<(A == Attributes)...>::value != 0;
+  }
+
+  /// @brief The equivalent runtime format, terminated with kEND.
+  static const Attribute *attributes() { return kAttributes; }
+  operator const Attribute *() const { return kAttributes; }
+};
+
+template <Attribute... Attributes>
+const size_t VertexFormat<Attributes...>::kStride;
+
+template <Attribute... Attributes>
+const size_t VertexFormat<Attributes...>::kNumAttributes;
+
+template <Attribute... Attributes>
+const Attribute VertexFormat<Attributes...>::kAttributes[] = {Attributes...,
+                                                              kEND};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_VERTEX_FORMAT_H
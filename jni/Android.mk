@@ -24,27 +24,61 @@ LOCAL_PATH := $(call realpath-portable,$(LOCAL_PATH))
 FPLBASE_DIR := $(LOCAL_PATH)
 
 FPLBASE_COMMON_SRC_FILES := \
+  src/allocator.cpp \
   src/asset_manager.cpp \
+  src/async_loader_common.cpp \
+  src/async_uploader_gl.cpp \
+  src/bone_palette_buffer_gl.cpp \
+  src/builtin_uniform_buffer_gl.cpp \
+  src/command_list.cpp \
+  src/culling.cpp \
+  src/dynamic_resolution.cpp \
+  src/dynamic_texture_atlas.cpp \
+  src/etc2_encoder.cpp \
+  src/file_archive.cpp \
+  src/frame_pacer.cpp \
+  src/frame_stats.cpp \
   src/gpu_debug_gl.cpp \
+  src/gpu_profiler_gl.cpp \
   src/input.cpp \
+  src/input_recording.cpp \
+  src/instance_buffer_gl.cpp \
+  src/lz4_block.cpp \
   src/material.cpp \
+  src/mesh_arena_gl.cpp \
   src/mesh_common.cpp \
   src/mesh_gl.cpp \
+  src/multi_draw_batch_gl.cpp \
+  src/occlusion_culler_gl.cpp \
+  src/pixel_conversion.cpp \
+  src/pixel_unpack_ring_gl.cpp \
   src/precompiled.cpp \
   src/preprocessor.cpp \
+  src/program_binary_cache_gl.cpp \
+  src/render_queue.cpp \
+  src/render_state.cpp \
   src/render_target_common.cpp \
   src/render_target_gl.cpp \
+  src/render_target_pool.cpp \
+  src/render_thread.cpp \
   src/render_utils_gl.cpp \
   src/renderer_common.cpp \
   src/renderer_gl.cpp \
   src/renderer_hmd_gl.cpp \
   src/shader_common.cpp \
   src/shader_gl.cpp \
+  src/skinning.cpp \
+  src/sprite_batch.cpp \
+  src/streaming_buffer_gl.cpp \
+  src/texture_bindings_gl.cpp \
   src/texture_common.cpp \
   src/texture_gl.cpp \
+  src/trace.cpp \
   src/type_conversions_gl.cpp \
   src/utilities.cpp \
   src/version.cpp \
+  src/vertex_bindings_gl.cpp \
+  src/write_behind.cpp \
   src/gl3stub_android.c
 
 FPLBASE_EXPORT_COMMON_CPPFLAGS := -std=c++11 \
@@ -74,6 +108,8 @@ FPLBASE_SCHEMA_DIR := $(FPLBASE_DIR)/schemas
 FPLBASE_SCHEMA_INCLUDE_DIRS :=
 
 FPLBASE_SCHEMA_FILES := \
+  $(FPLBASE_SCHEMA_DIR)/archive.fbs \
+  $(FPLBASE_SCHEMA_DIR)/asset_manifest.fbs \
   $(FPLBASE_SCHEMA_DIR)/common.fbs \
   $(FPLBASE_SCHEMA_DIR)/materials.fbs \
   $(FPLBASE_SCHEMA_DIR)/mesh.fbs \
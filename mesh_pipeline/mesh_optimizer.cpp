@@ -0,0 +1,482 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mesh_optimizer.h"
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+namespace fplbase {
+
+static const uint32_t kNoVertex = static_cast<uint32_t>(-1);
+
+// The triangles that use each vertex, as offsets into one array.
+struct VertexTriangles {
+  std::vector<uint32_t> offsets;    // Per vertex, plus one at the end.
+  std::vector<uint32_t> triangles;  // Grouped by vertex.
+
+  VertexTriangles(const std::vector<uint32_t> &indices, size_t num_vertices)
+      : offsets(num_vertices + 1, 0), triangles(indices.size()) {
+    for (size_t i = 0; i < indices.size(); ++i) ++offsets[indices[i] + 1];
+    for (size_t v = 0; v < num_vertices; ++v) offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) {
+      triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+};
+
+// Tipsify's choice of the next vertex to fan around: the candidate that
+// stays in the cache the longest while its remaining triangles are emitted.
+// Falls back to the last vertices emitted (dead-end stack), and then to the
+// next vertex with triangles left, which starts a new cluster.
+static uint32_t NextFanVertex(const std::vector<uint32_t> &candidates,
+                              const std::vector<uint32_t> &live_triangles,
+                              const std::vector<size_t> &cache_time,
+                              size_t time, size_t cache_size,
+                              std::vector<uint32_t> *dead_ends,
+                              uint32_t *cursor, bool *new_cluster) {
+  uint32_t best = kNoVertex;
+  size_t best_priority = 0;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    const uint32_t v = candidates[i];
+    if (live_triangles[v] == 0) continue;
+    // Vertices that would drop out of the cache while emitting their
+    // triangles get the lowest non-zero priority.
+    size_t priority = 1;
+    if (time - cache_time[v] + 2 * live_triangles[v] <= cache_size) {
+      priority = time - cache_time[v] + 1;
+    }
+    if (priority > best_priority) {
+      best_priority = priority;
+      best = v;
+    }
+  }
+  *new_cluster = false;
+  if (best != kNoVertex) return best;
+
+  while (!dead_ends->empty()) {
+    const uint32_t v = dead_ends->back();
+    dead_ends->pop_back();
+    if (live_triangles[v] > 0) return v;
+  }
+  *new_cluster = true;
+  for (; *cursor < live_triangles.size(); ++*cursor) {
+    if (live_triangles[*cursor] > 0) return *cursor;
+  }
+  return kNoVertex;
+}
+
+// Sorts `clusters`, each a range of the triangles in `indices`, by how far
+// out they face: the dot product of the cluster's area weighted normal and
+// its offset from the mesh's center.
+static void SortClustersForOverdraw(const float *positions,
+                                    const std::vector<uint32_t> &clusters,
+                                    std::vector<uint32_t> *indices) {
+  const size_t num_triangles = indices->size() / 3;
+  const size_t num_clusters = clusters.size();
+  if (num_clusters < 2) return;
+
+  // The area weighted center of the mesh, and of each cluster.
+  std::vector<float> cluster_center(num_clusters * 3, 0.0f);
+  std::vector<float> cluster_normal(num_clusters * 3, 0.0f);
+  std::vector<float> cluster_area(num_clusters, 0.0f);
+  float mesh_center[3] = {0.0f, 0.0f, 0.0f};
+  float mesh_area = 0.0f;
+  for (size_t c = 0; c < num_clusters; ++c) {
+    const size_t end = c + 1 < num_clusters ? clusters[c + 1] : num_triangles;
+    for (size_t t = clusters[c]; t < end; ++t) {
+      const float *p0 = positions + 3 * (*indices)[3 * t];
+      const float *p1 = positions + 3 * (*indices)[3 * t + 1];
+      const float *p2 = positions + 3 * (*indices)[3 * t + 2];
+      const float e1[] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+      const float e2[] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+      const float normal[] = {e1[1] * e2[2] - e1[2] * e2[1],
+                              e1[2] * e2[0] - e1[0] * e2[2],
+                              e1[0] * e2[1] - e1[1] * e2[0]};
+      const float area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] +
+                               normal[2] * normal[2]);
+      for (int i = 0; i < 3; ++i) {
+        const float center = (p0[i] + p1[i] + p2[i]) / 3.0f;
+        cluster_center[3 * c + i] += center * area;
+        cluster_normal[3 * c + i] += normal[i];
+        mesh_center[i] += center * area;
+      }
+      cluster_area[c] += area;
+      mesh_area += area;
+    }
+  }
+  if (mesh_area <= 0.0f) return;
+  for (int i = 0; i < 3; ++i) mesh_center[i] /= mesh_area;
+
+  std::vector<float> facing(num_clusters, 0.0f);
+  for (size_t c = 0; c < num_clusters; ++c) {
+    if (cluster_area[c] <= 0.0f) continue;
+    for (int i = 0; i < 3; ++i) {
+      const float offset =
+          cluster_center[3 * c + i] / cluster_area[c] - mesh_center[i];
+      facing[c] += offset * cluster_normal[3 * c + i];
+    }
+  }
+  std::vector<uint32_t> order(num_clusters);
+  for (size_t c = 0; c < num_clusters; ++c) order[c] = static_cast<uint32_t>(c);
+  std::stable_sort(order.begin(), order.end(),
+                   [&facing](uint32_t a, uint32_t b) {
+                     return facing[a] > facing[b];
+                   });
+
+  std::vector<uint32_t> sorted;
+  sorted.reserve(indices->size());
+  for (size_t i = 0; i < num_clusters; ++i) {
+    const uint32_t c = order[i];
+    const size_t end = c + 1 < num_clusters ? clusters[c + 1] : num_triangles;
+    sorted.insert(sorted.end(), indices->begin() + 3 * clusters[c],
+                  indices->begin() + 3 * end);
+  }
+  indices->swap(sorted);
+}
+
+void OptimizeTriangleOrder(const float *positions, size_t num_vertices,
+                           size_t cache_size, std::vector<uint32_t> *indices) {
+  assert(indices->size() % 3 == 0);
+  const size_t num_triangles = indices->size() / 3;
+  if (num_triangles < 2) return;
+
+  const VertexTriangles adjacency(*indices, num_vertices);
+  std::vector<uint32_t> live_triangles(num_vertices);
+  for (size_t v = 0; v < num_vertices; ++v) {
+    live_triangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+  }
+  // When each vertex last entered the cache. Start out far in the past.
+  std::vector<size_t> cache_time(num_vertices, 0);
+  size_t time = cache_size + 1;
+  std::vector<bool> emitted(num_triangles, false);
+  std::vector<uint32_t> dead_ends;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  output.reserve(indices->size());
+  // The first triangle of each cluster.
+  std::vector<uint32_t> clusters(1, 0);
+
+  uint32_t cursor = 0;
+  uint32_t fan = (*indices)[0];
+  while (fan != kNoVertex) {
+    candidates.clear();
+    for (uint32_t i = adjacency.offsets[fan]; i < adjacency.offsets[fan + 1];
+         ++i) {
+      const uint32_t t = adjacency.triangles[i];
+      if (emitted[t]) continue;
+      emitted[t] = true;
+      for (int corner = 0; corner < 3; ++corner) {
+        const uint32_t v = (*indices)[3 * t + corner];
+        output.push_back(v);
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        --live_triangles[v];
+        if (time - cache_time[v] > cache_size) cache_time[v] = time++;
+      }
+    }
+    bool new_cluster = false;
+    fan = NextFanVertex(candidates, live_triangles, cache_time, time,
+                        cache_size, &dead_ends, &cursor, &new_cluster);
+    if (new_cluster && fan != kNoVertex) {
+      clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+    }
+  }
+  assert(output.size() == indices->size());
+  indices->swap(output);
+
+  SortClustersForOverdraw(positions, clusters, indices);
+}
+
+std::vector<uint32_t> OptimizeVertexFetchOrder(
+    size_t num_vertices, const std::vector<std::vector<uint32_t> *> &buffers) {
+  std::vector<uint32_t> new_index(num_vertices, kNoVertex);
+  std::vector<uint32_t> old_index;
+  old_index.reserve(num_vertices);
+  for (size_t b = 0; b < buffers.size(); ++b) {
+    std::vector<uint32_t> &indices = *buffers[b];
+    for (size_t i = 0; i < indices.size(); ++i) {
+      uint32_t &renumbered = new_index[indices[i]];
+      if (renumbered == kNoVertex) {
+        renumbered = static_cast<uint32_t>(old_index.size());
+        old_index.push_back(indices[i]);
+      }
+      indices[i] = renumbered;
+    }
+  }
+  return old_index;
+}
+
+// The squared cosine of the furthest a collapse may turn a triangle.
+static const double kMinCollapseCosSquared = 0.25;
+
+// Sum of squared distances to a set of planes, weighted by area, as the
+// upper triangle of a symmetric 4x4 matrix.
+struct Quadric {
+  double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+
+  Quadric() : xx(0), xy(0), xz(0), xw(0), yy(0), yz(0), yw(0), zz(0), zw(0),
+              ww(0) {}
+
+  void AddPlane(const double n[3], double d, double weight) {
+    xx += weight * n[0] * n[0];
+    xy += weight * n[0] * n[1];
+    xz += weight * n[0] * n[2];
+    xw += weight * n[0] * d;
+    yy += weight * n[1] * n[1];
+    yz += weight * n[1] * n[2];
+    yw += weight * n[1] * d;
+    zz += weight * n[2] * n[2];
+    zw += weight * n[2] * d;
+    ww += weight * d * d;
+  }
+
+  void Add(const Quadric &q) {
+    xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw; yy += q.yy;
+    yz += q.yz; yw += q.yw; zz += q.zz; zw += q.zw; ww += q.ww;
+  }
+
+  double Error(const float p[3]) const {
+    const double x = p[0], y = p[1], z = p[2];
+    return x * (xx * x + 2 * (xy * y + xz * z + xw)) +
+           y * (yy * y + 2 * (yz * z + yw)) + z * (zz * z + 2 * zw) + ww;
+  }
+};
+
+// Moving vertex `from` onto vertex `to`.
+struct Collapse {
+  double error;
+  uint32_t from;
+  uint32_t to;
+  // The vertices' versions when `error` was calculated.
+  uint32_t from_version;
+  uint32_t to_version;
+
+  bool operator>(const Collapse &other) const { return error > other.error; }
+};
+
+static void TriangleNormal(const float *p0, const float *p1, const float *p2,
+                           double normal[3]) {
+  const double e1[] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  const double e2[] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+  normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+// Locks vertices that can't move without tearing or shrinking the mesh:
+// those on open or non-manifold edges, and those that share a position with
+// another vertex.
+static void LockBoundaries(const float *positions, size_t num_vertices,
+                           const std::vector<uint32_t> &indices,
+                           std::vector<bool> *locked) {
+  std::unordered_map<uint64_t, int> edge_counts;
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    for (int corner = 0; corner < 3; ++corner) {
+      const uint64_t a = indices[i + corner];
+      const uint64_t b = indices[i + (corner + 1) % 3];
+      ++edge_counts[a < b ? (a << 32) | b : (b << 32) | a];
+    }
+  }
+  for (auto it = edge_counts.begin(); it != edge_counts.end(); ++it) {
+    if (it->second == 2) continue;
+    (*locked)[it->first >> 32] = true;
+    (*locked)[it->first & 0xFFFFFFFF] = true;
+  }
+
+  std::vector<uint32_t> by_position(num_vertices);
+  for (size_t v = 0; v < num_vertices; ++v) {
+    by_position[v] = static_cast<uint32_t>(v);
+  }
+  auto position_less = [positions](uint32_t a, uint32_t b) {
+    return std::lexicographical_compare(positions + 3 * a,
+                                        positions + 3 * a + 3,
+                                        positions + 3 * b,
+                                        positions + 3 * b + 3);
+  };
+  std::sort(by_position.begin(), by_position.end(), position_less);
+  for (size_t i = 1; i < num_vertices; ++i) {
+    const uint32_t a = by_position[i - 1];
+    const uint32_t b = by_position[i];
+    if (!position_less(a, b)) {
+      (*locked)[a] = true;
+      (*locked)[b] = true;
+    }
+  }
+}
+
+void SimplifyTriangles(const float *positions, size_t num_vertices,
+                       const std::vector<bool> &locked,
+                       size_t target_index_count,
+                       std::vector<uint32_t> *indices) {
+  assert(indices->size() % 3 == 0);
+  assert(locked.empty() || locked.size() == num_vertices);
+  std::vector<uint32_t> &tris = *indices;
+  const size_t num_triangles = tris.size() / 3;
+  size_t live_triangles = num_triangles;
+  if (3 * live_triangles <= target_index_count) return;
+
+  std::vector<bool> fixed(locked);
+  fixed.resize(num_vertices, false);
+  LockBoundaries(positions, num_vertices, tris, &fixed);
+
+  std::vector<Quadric> quadrics(num_vertices);
+  std::vector<std::vector<uint32_t>> vertex_tris(num_vertices);
+  for (size_t t = 0; t < num_triangles; ++t) {
+    const uint32_t *tri = &tris[3 * t];
+    double normal[3];
+    TriangleNormal(positions + 3 * tri[0], positions + 3 * tri[1],
+                   positions + 3 * tri[2], normal);
+    const double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                               normal[2] * normal[2]);
+    for (int corner = 0; corner < 3; ++corner) {
+      vertex_tris[tri[corner]].push_back(static_cast<uint32_t>(t));
+    }
+    if (length <= 0.0) continue;
+    for (int i = 0; i < 3; ++i) normal[i] /= length;
+    const float *p0 = positions + 3 * tri[0];
+    const double d = -(normal[0] * p0[0] + normal[1] * p0[1] +
+                       normal[2] * p0[2]);
+    for (int corner = 0; corner < 3; ++corner) {
+      quadrics[tri[corner]].AddPlane(normal, d, 0.5 * length);
+    }
+  }
+
+  std::vector<uint32_t> versions(num_vertices, 0);
+  std::vector<bool> removed(num_vertices, false);
+  std::vector<bool> dead(num_triangles, false);
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>
+      collapses;
+  auto push_collapse = [&](uint32_t from, uint32_t to) {
+    if (fixed[from] || from == to) return;
+    Quadric q = quadrics[from];
+    q.Add(quadrics[to]);
+    const Collapse c = {q.Error(positions + 3 * to), from, to, versions[from],
+                        versions[to]};
+    collapses.push(c);
+  };
+  for (size_t i = 0; i < tris.size(); i += 3) {
+    for (int corner = 0; corner < 3; ++corner) {
+      const uint32_t a = tris[i + corner];
+      const uint32_t b = tris[i + (corner + 1) % 3];
+      push_collapse(a, b);
+      push_collapse(b, a);
+    }
+  }
+
+  while (3 * live_triangles > target_index_count && !collapses.empty()) {
+    const Collapse c = collapses.top();
+    collapses.pop();
+    if (removed[c.from] || removed[c.to] ||
+        versions[c.from] != c.from_version || versions[c.to] != c.to_version) {
+      continue;
+    }
+
+    // Reject collapses that would flip or flatten a remaining triangle.
+    const std::vector<uint32_t> &from_tris = vertex_tris[c.from];
+    bool flips = false;
+    for (size_t i = 0; i < from_tris.size() && !flips; ++i) {
+      const uint32_t *tri = &tris[3 * from_tris[i]];
+      if (dead[from_tris[i]] ||
+          tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+        continue;
+      }
+      const float *p[3];
+      const float *moved[3];
+      for (int corner = 0; corner < 3; ++corner) {
+        p[corner] = positions + 3 * tri[corner];
+        moved[corner] =
+            positions + 3 * (tri[corner] == c.from ? c.to : tri[corner]);
+      }
+      double before[3], after[3];
+      TriangleNormal(p[0], p[1], p[2], before);
+      TriangleNormal(moved[0], moved[1], moved[2], after);
+      const double dot = before[0] * after[0] + before[1] * after[1] +
+                         before[2] * after[2];
+      const double lengths_squared =
+          (before[0] * before[0] + before[1] * before[1] +
+           before[2] * before[2]) *
+          (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+      // Turning more than about 60 degrees folds the surface into slivers.
+      flips = dot <= 0.0 ||
+              dot * dot < kMinCollapseCosSquared * lengths_squared;
+    }
+    if (flips) continue;
+
+    removed[c.from] = true;
+    quadrics[c.to].Add(quadrics[c.from]);
+    ++versions[c.to];
+    std::vector<uint32_t> &to_tris = vertex_tris[c.to];
+    for (size_t i = 0; i < from_tris.size(); ++i) {
+      const uint32_t t = from_tris[i];
+      if (dead[t]) continue;
+      uint32_t *tri = &tris[3 * t];
+      if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+        dead[t] = true;
+        --live_triangles;
+        continue;
+      }
+      for (int corner = 0; corner < 3; ++corner) {
+        if (tri[corner] == c.from) tri[corner] = c.to;
+      }
+      to_tris.push_back(t);
+    }
+    vertex_tris[c.from].clear();
+    to_tris.erase(std::remove_if(to_tris.begin(), to_tris.end(),
+                                 [&dead](uint32_t t) { return dead[t]; }),
+                  to_tris.end());
+
+    // The costs of collapses into or out of `to` changed.
+    for (size_t i = 0; i < to_tris.size(); ++i) {
+      const uint32_t *tri = &tris[3 * to_tris[i]];
+      for (int corner = 0; corner < 3; ++corner) {
+        push_collapse(c.to, tri[corner]);
+        push_collapse(tri[corner], c.to);
+      }
+    }
+  }
+
+  size_t out = 0;
+  for (size_t t = 0; t < num_triangles; ++t) {
+    if (dead[t]) continue;
+    for (int corner = 0; corner < 3; ++corner) {
+      tris[out++] = tris[3 * t + corner];
+    }
+  }
+  tris.resize(out);
+}
+
+float AverageCacheMissRatio(const std::vector<uint32_t> &indices,
+                            size_t num_vertices, size_t cache_size) {
+  if (indices.size() < 3) return 0.0f;
+  // A FIFO cache: a vertex is in it if it entered within the last
+  // `cache_size` misses.
+  std::vector<size_t> entered(num_vertices, 0);
+  size_t misses = 0;
+  for (size_t i = 0; i < indices.size(); ++i) {
+    size_t &time = entered[indices[i]];
+    if (time == 0 || misses + 1 - time >= cache_size + 1) {
+      ++misses;
+      time = misses;
+    }
+  }
+  return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+}  // namespace fplbase
@@ -0,0 +1,65 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_MESH_OPTIMIZER_H_
+#define FPLBASE_MESH_OPTIMIZER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace fplbase {
+
+// Post-transform vertex cache size to optimize for. Smaller than most GPUs'
+// caches, since an order tuned for a small cache still does well on a bigger
+// one, but not the other way around.
+static const size_t kVertexCacheSize = 16;
+
+// Reorders the triangles of `indices` for the post-transform vertex cache
+// with Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw", 2007). Then sorts the clusters of
+// triangles that Tipsify emits between cache flushes so that the outer,
+// outward facing ones come first, which reduces overdraw from any view.
+// `positions` holds xyz for each of the `num_vertices` vertices.
+void OptimizeTriangleOrder(const float *positions, size_t num_vertices,
+                           size_t cache_size, std::vector<uint32_t> *indices);
+
+// Renumbers the vertices in the order the index buffers first reference
+// them, in place, so vertex fetches walk forward through memory. Returns, for
+// each new vertex index, the old one. Vertices that aren't referenced are
+// dropped.
+std::vector<uint32_t> OptimizeVertexFetchOrder(
+    size_t num_vertices, const std::vector<std::vector<uint32_t> *> &buffers);
+
+// Removes triangles from `indices` by collapsing edges into one of their
+// vertices, picking the collapse that least changes the surface, as measured
+// by quadric error (Garland and Heckbert, "Surface Simplification Using
+// Quadric Error Metrics", 1997). Stops at `target_index_count` indices, or
+// when no more edges can be collapsed. Only moves indices onto existing
+// vertices, so the result uses a subset of the original vertices.
+// Vertices with `locked` set, on a border, or sharing their position with
+// another vertex (e.g. a UV seam) are never removed. `locked` may be empty.
+void SimplifyTriangles(const float *positions, size_t num_vertices,
+                       const std::vector<bool> &locked,
+                       size_t target_index_count,
+                       std::vector<uint32_t> *indices);
+
+// The average number of vertices transformed per triangle, with a FIFO cache
+// of `cache_size` vertices. Between 0.5 (ideal) and 3.
+float AverageCacheMissRatio(const std::vector<uint32_t> &indices,
+                            size_t num_vertices, size_t cache_size);
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_OPTIMIZER_H_
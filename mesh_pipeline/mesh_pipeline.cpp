@@ -17,24 +17,30 @@
 #include <assert.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
 #include <cfloat>
+#include <chrono>
 #include <fstream>
 #include <functional>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "common_generated.h"
 #include "fbx_common/fbx_common.h"
-#include "flatbuffers/hash.h"
 #include "fplbase/fpl_common.h"
+#include "fplbase/internal/build_cache.h"
+#include "fplbase/internal/vertex_quantization.h"
 #include "fplutil/file_utils.h"
 #include "fplutil/string_utils.h"
 #include "materials_generated.h"
 #include "mathfu/constants.h"
 #include "mathfu/glsl_mappings.h"
 #include "mesh_generated.h"
+#include "mesh_optimizer.h"
 
 namespace fplbase {
 
@@ -65,6 +71,11 @@ static const char* const kImageExtensions[] = {"jpg", "jpeg", "png", "webp",
                                                "tga"};
 static const FbxColor kDefaultColor(1.0, 1.0, 1.0, 1.0);
 
+// The fraction of the screen a mesh can cover with fewer triangles than full
+// detail. With a LOD ratio of 0.5, the first coarser level is drawn once the
+// mesh is about a third of the screen across.
+static const float kLodFullDetailScreenSize = 0.5f;
+
 // Defines the order in which textures are assigned shader indices.
 // Shader indices are assigned, starting from 0, as textures are found.
 static const char* kTextureProperties[] = {
@@ -462,12 +473,14 @@ class FlatMesh {
  public:
   explicit FlatMesh(int max_verts, VertexAttributeBitmask vertex_attributes,
                     Logger& log)
-      : points_(max_verts),
-        cur_index_buf_(nullptr),
+      : cur_index_buf_(nullptr),
         mesh_vertex_attributes_(0),
         vertex_attributes_(vertex_attributes),
         log_(log) {
-    points_.clear();
+    // Reserve rather than construct `max_verts` points, so that the pages of
+    // this upper bound that are never reached are never touched either.
+    points_.reserve(max_verts);
+    unique_.Reserve(max_verts);
   }
 
   unsigned int AppendBone(const char* bone_name,
@@ -524,21 +537,13 @@ class FlatMesh {
                       const vec4& tangent, const vec4& orientation,
                       const vec4& color, const vec2& uv, const vec2& uv_alt,
                       const SkinBinding& skin_binding) {
-    // The `unique_` map holds pointers into `points_`, so we cannot realloc
-    // `points_`. Instead, we reserve enough memory for an upper bound on
-    // its size. If this assert hits, NumVertsUpperBound() is incorrect.
-    assert(points_.capacity() > points_.size());
-
     // TODO: Round values before creating.
     points_.push_back(Vertex(vertex_attributes_, vertex, normal, tangent,
                              orientation, color, uv, uv_alt, skin_binding));
 
-    const VertexRef ref_to_insert(&points_.back(), points_.size() - 1);
-    auto insertion = unique_.insert(ref_to_insert);
-
-    // The `insert` call returns two values: iterator and success.
-    const VertexRef& ref = *insertion.first;
-    const bool new_control_point_created = insertion.second;
+    const VertIndex new_index = static_cast<VertIndex>(points_.size() - 1);
+    const VertIndex index = unique_.Insert(points_, new_index);
+    const bool new_control_point_created = index == new_index;
 
     // We recycled an existing point, so we can remove the one we added with
     // push_back().
@@ -547,11 +552,11 @@ class FlatMesh {
     }
 
     // Append index of polygon point.
-    cur_index_buf_->push_back(ref.index);
+    cur_index_buf_->push_back(index);
 
     // Log the data we just added.
     if (log_.level() <= kLogVerbose) {
-      log_.Log(kLogVerbose, "Point: index %d", ref.index);
+      log_.Log(kLogVerbose, "Point: index %d", index);
       if (new_control_point_created) {
         const VertexAttributeBitmask attributes =
             vertex_attributes_ & mesh_vertex_attributes_;
@@ -596,6 +601,112 @@ class FlatMesh {
     }
   }
 
+  // Simplify each surface into `num_lods` coarser detail levels, each with
+  // about `ratio` times the triangles of the previous one.
+  void GenerateLods(int num_lods, float ratio) {
+    const std::vector<float> positions = Positions();
+
+    // Keep the vertices that surfaces share, so they don't come apart.
+    std::vector<int> surface_counts(points_.size(), 0);
+    std::vector<bool> locked(points_.size(), false);
+    for (auto it = surfaces_.begin(); it != surfaces_.end(); ++it) {
+      std::unordered_set<VertIndex> used(it->second.begin(), it->second.end());
+      for (auto v = used.begin(); v != used.end(); ++v) {
+        if (++surface_counts[*v] > 1) locked[*v] = true;
+      }
+    }
+
+    const int num_triangles = NumTriangles();
+    std::vector<int> lod_triangles(num_lods, 0);
+    for (auto it = surfaces_.begin(); it != surfaces_.end(); ++it) {
+      std::vector<IndexBuffer>& lods = lods_[it->first];
+      lods.reserve(num_lods);
+      const IndexBuffer* prev = &it->second;
+      float target = static_cast<float>(it->second.size() / 3);
+      for (int i = 0; i < num_lods; ++i) {
+        target *= ratio;
+        lods.push_back(*prev);
+        SimplifyTriangles(positions.data(), points_.size(), locked,
+                          3 * static_cast<size_t>(target), &lods.back());
+        prev = &lods.back();
+        lod_triangles[i] += static_cast<int>(prev->size() / 3);
+      }
+    }
+
+    // The triangles on screen stay about the same size when the number of
+    // triangles scales with the screen area the mesh covers.
+    lod_screen_sizes_.clear();
+    for (int i = 0; i < num_lods && num_triangles > 0; ++i) {
+      const float achieved =
+          static_cast<float>(lod_triangles[i]) / num_triangles;
+      lod_screen_sizes_.push_back(kLodFullDetailScreenSize * sqrt(achieved));
+      log_.Log(kLogInfo, "LOD %d has %d triangles, drawn below %.3f\n", i + 1,
+               lod_triangles[i], lod_screen_sizes_.back());
+    }
+  }
+
+  // Reorder each surface's triangles for the post-transform vertex cache and
+  // for less overdraw, then renumber the vertices in the order they're first
+  // used so that vertex fetches are sequential.
+  void Optimize() {
+    const std::vector<float> positions = Positions();
+
+    float acmr_before = 0.0f;
+    float acmr_after = 0.0f;
+    std::vector<IndexBuffer*> index_bufs;
+    for (auto it = surfaces_.begin(); it != surfaces_.end(); ++it) {
+      IndexBuffer& index_buf = it->second;
+      const float weight = static_cast<float>(index_buf.size());
+      acmr_before += weight * AverageCacheMissRatio(index_buf, points_.size(),
+                                                    kVertexCacheSize);
+      OptimizeTriangleOrder(positions.data(), points_.size(),
+                            kVertexCacheSize, &index_buf);
+      acmr_after += weight * AverageCacheMissRatio(index_buf, points_.size(),
+                                                   kVertexCacheSize);
+      index_bufs.push_back(&index_buf);
+    }
+    // Coarser levels use a subset of the vertices, so they go after the full
+    // detail ones in fetch order.
+    for (auto it = lods_.begin(); it != lods_.end(); ++it) {
+      for (auto lod = it->second.begin(); lod != it->second.end(); ++lod) {
+        OptimizeTriangleOrder(positions.data(), points_.size(),
+                              kVertexCacheSize, &*lod);
+        index_bufs.push_back(&*lod);
+      }
+    }
+    const int num_indices = 3 * NumTriangles();
+    if (num_indices > 0) {
+      log_.Log(kLogInfo,
+               "Vertex cache misses per triangle: %.3f before, %.3f after\n",
+               acmr_before / num_indices, acmr_after / num_indices);
+    }
+
+    const std::vector<uint32_t> order =
+        OptimizeVertexFetchOrder(points_.size(), index_bufs);
+    std::vector<Vertex> points;
+    points.reserve(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      points.push_back(points_[order[i]]);
+    }
+    points_.swap(points);
+
+    // `unique_` indexes the old vertex order, and we're done appending.
+    unique_.Clear();
+    cur_index_buf_ = nullptr;
+  }
+
+  // The position of each vertex, as xyz floats.
+  std::vector<float> Positions() const {
+    std::vector<float> positions(points_.size() * 3);
+    for (size_t i = 0; i < points_.size(); ++i) {
+      const vec3 position = vec3(points_[i].vertex);
+      positions[3 * i] = position.x;
+      positions[3 * i + 1] = position.y;
+      positions[3 * i + 2] = position.z;
+    }
+    return positions;
+  }
+
   // Output material and mesh flatbuffers for the gathered surfaces.
   bool OutputFlatBuffer(
       const std::string& mesh_name_unformated,
@@ -604,7 +715,7 @@ class FlatMesh {
       const std::string& texture_extension,
       const std::vector<matdef::TextureFormat>& texture_formats,
       matdef::BlendMode blend_mode, bool interleaved, bool force32,
-      bool embed_materials) const {
+      bool quantize, bool embed_materials) const {
     // Ensure directory names end with a slash.
     const std::string mesh_name = fplutil::BaseFileName(mesh_name_unformated);
     const std::string assets_base_dir =
@@ -633,7 +744,7 @@ class FlatMesh {
     // `assets_base_dir`.
     OutputMeshFlatBuffer(mesh_name, assets_base_dir, assets_sub_dir,
                          texture_extension, texture_formats, blend_mode,
-                         interleaved, force32, embed_materials);
+                         interleaved, force32, quantize, embed_materials);
 
     // Log summary
     log_.Log(kLogImportant, "  %s (%d vertices, %d triangles)\n",
@@ -642,6 +753,9 @@ class FlatMesh {
     return true;
   }
 
+  // The files written by OutputFlatBuffer().
+  const std::vector<std::string>& output_files() const { return output_files_; }
+
   int NumTriangles() const {
     size_t num_indices = 0;
     for (auto it = surfaces_.begin(); it != surfaces_.end(); ++it) {
@@ -756,26 +870,68 @@ class FlatMesh {
     }
   };
 
-  struct VertexRef {
-    const Vertex* ref;
-    VertIndex index;
-    VertexRef(const Vertex* v, size_t index)
-        : ref(v), index(static_cast<VertIndex>(index)) {
-      assert(index <= std::numeric_limits<VertIndex>::max());
+  // Vertex is all floats and bytes, in 4 byte multiples, so has no padding
+  // and its identity is its memory image.
+  static_assert(sizeof(Vertex) % sizeof(uint32_t) == 0,
+                "Vertex is hashed a word at a time.");
+
+  // Open addressing hash set of indices into `points_`, for finding duplicate
+  // vertices. Sized once, from the upper bound on the vertex count, so it
+  // never rehashes, and at 4 bytes a slot it's a fraction of the size of a
+  // node based set.
+  class UniqueVertices {
+   public:
+    UniqueVertices() : mask_(0) {}
+
+    void Reserve(size_t max_verts) {
+      // Keep the table at most two thirds full.
+      size_t capacity = 16;
+      while (capacity < max_verts + max_verts / 2) capacity *= 2;
+      slots_.assign(capacity, VertIndex(kEmptySlot));
+      mask_ = capacity - 1;
+    }
+
+    // Returns the index of the first vertex equal to `points[index]`. That's
+    // `index` itself, now added to the set, if there was none.
+    VertIndex Insert(const std::vector<Vertex>& points, VertIndex index) {
+      assert(!slots_.empty() && index != kEmptySlot);
+      const Vertex& vertex = points[index];
+      for (size_t slot = Hash(vertex) & mask_;; slot = (slot + 1) & mask_) {
+        const VertIndex existing = slots_[slot];
+        if (existing == kEmptySlot) {
+          slots_[slot] = index;
+          return index;
+        }
+        if (memcmp(&points[existing], &vertex, sizeof(vertex)) == 0) {
+          return existing;
+        }
+      }
     }
-  };
 
-  struct VertexHash {
-    uint64_t operator()(const VertexRef& c) const {
-      return flatbuffers::HashFnv1a<uint64_t>(
-          reinterpret_cast<const char*>(c.ref));
+    void Clear() {
+      std::vector<VertIndex>().swap(slots_);
+      mask_ = 0;
     }
-  };
 
-  struct VerticesEqual {
-    bool operator()(const VertexRef& a, const VertexRef& b) const {
-      return memcmp(a.ref, b.ref, sizeof(*a.ref)) == 0;
+   private:
+    static const VertIndex kEmptySlot = 0xFFFFFFFF;
+
+    // Multiplicative hash over the words of the whole vertex. Unlike hashing
+    // it as a C string, this never stops at a zero byte, which every 0.0f
+    // and 1.0f component starts with.
+    static size_t Hash(const Vertex& vertex) {
+      uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+      memcpy(words, &vertex, sizeof(words));
+      uint64_t hash = 0;
+      for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i) {
+        hash = (hash ^ words[i]) * 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 29;
+      }
+      return static_cast<size_t>(hash ^ (hash >> 32));
     }
+
+    std::vector<VertIndex> slots_;
+    size_t mask_;
   };
 
   struct Bone {
@@ -793,7 +949,9 @@ class FlatMesh {
 
   typedef std::unordered_map<FlatTextures, IndexBuffer, FlatTextureHash>
       SurfaceMap;
-  typedef std::unordered_set<VertexRef, VertexHash, VerticesEqual> VertexSet;
+  typedef std::unordered_map<FlatTextures, std::vector<IndexBuffer>,
+                             FlatTextureHash>
+      LodMap;
 
   static bool HasTexture(const FlatTextures& textures) {
     return textures.Count() > 0;
@@ -842,6 +1000,7 @@ class FlatMesh {
     log_.Log(kLogVerbose, "Writing %s\n", file_name.c_str());
     fwrite(fbb.GetBufferPointer(), 1, fbb.GetSize(), file);
     fclose(file);
+    output_files_.push_back(file_name);
   }
 
 
@@ -885,6 +1044,37 @@ class FlatMesh {
     return material_fb;
   }
 
+  // The layouts of the compact attributes written with --quantize-attributes.
+  struct QuantizedPosition {
+    uint16_t xyz[3];
+    uint16_t padding;  // Keeps the following attributes 4 byte aligned.
+    explicit QuantizedPosition(const vec3& p) : padding(0) {
+      for (int i = 0; i < 3; ++i) xyz[i] = FloatToHalf(p[i]);
+    }
+  };
+  struct QuantizedNormal {
+    int16_t xy[2];
+    explicit QuantizedNormal(const vec3& n) {
+      const float normal[] = {n.x, n.y, n.z};
+      EncodeOctahedralNormal(normal, xy);
+    }
+  };
+  struct QuantizedUv {
+    uint16_t uv[2];
+    explicit QuantizedUv(const vec2& u) {
+      uv[0] = FloatToHalf(u.x);
+      uv[1] = FloatToHalf(u.y);
+    }
+  };
+
+  // Copies `value` as is, so see the little-endian TODO in
+  // BuildMeshFlatBuffer().
+  template <typename T>
+  static void AppendBytes(const T& value, std::vector<uint8_t>* bytes) {
+    auto attr = reinterpret_cast<const uint8_t*>(&value);
+    bytes->insert(bytes->end(), attr, attr + sizeof(T));
+  }
+
   VertIndex GetMaxIndex(const IndexBuffer& indices) const {
     return indices.empty() ? 0
                            : *std::max_element(indices.begin(), indices.end());
@@ -895,7 +1085,7 @@ class FlatMesh {
       const std::string& assets_sub_dir, const std::string& texture_extension,
       const std::vector<matdef::TextureFormat>& texture_formats,
       matdef::BlendMode blend_mode, bool interleaved, bool force32,
-      bool embed_materials) const {
+      bool quantize, bool embed_materials) const {
     const VertexAttributeBitmask attributes =
         vertex_attributes_ == kVertexAttributeBit_AllAttributesInSourceFile
             ? mesh_vertex_attributes_
@@ -937,13 +1127,34 @@ class FlatMesh {
                index_buf.size() / 3);
       flatbuffers::Offset<flatbuffers::Vector<VertIndexCompact>> indices_fb = 0;
       flatbuffers::Offset<flatbuffers::Vector<VertIndex>> indices32_fb = 0;
-      if (!force32 && GetMaxIndex(index_buf) <= kMaxVertexIndex) {
+      const bool compact =
+          !force32 && GetMaxIndex(index_buf) <= kMaxVertexIndex;
+      if (compact) {
         CopyIndexBuf(index_buf, &index_buf_compact);
         indices_fb = fbb.CreateVector(index_buf_compact);
       } else {
         indices32_fb = fbb.CreateVector(index_buf);
       }
 
+      // Coarser levels index a subset of the same vertices, so they always
+      // fit in the same index size.
+      std::vector<flatbuffers::Offset<meshdef::SurfaceLod>> lods_fb;
+      auto lods = lods_.find(textures);
+      if (lods != lods_.end()) {
+        for (auto lod = lods->second.begin(); lod != lods->second.end();
+             ++lod) {
+          if (compact) {
+            CopyIndexBuf(*lod, &index_buf_compact);
+            lods_fb.push_back(meshdef::CreateSurfaceLod(
+                fbb, fbb.CreateVector(index_buf_compact)));
+          } else {
+            lods_fb.push_back(
+                meshdef::CreateSurfaceLod(fbb, 0, fbb.CreateVector(*lod)));
+          }
+        }
+      }
+      auto lods_vector_fb = lods_fb.empty() ? 0 : fbb.CreateVector(lods_fb);
+
       flatbuffers::Offset<matdef::Material> material_data_fb = 0;
       if (embed_materials && HasTexture(textures)) {
         log_.Log(kLogInfo, "  %s:", material_file_name.c_str());
@@ -952,12 +1163,15 @@ class FlatMesh {
                                     texture_formats, blend_mode, textures);
       }
 
-      auto surface_fb = meshdef::CreateSurface(fbb, indices_fb, material_fb,
-                                               indices32_fb, material_data_fb);
+      auto surface_fb =
+          meshdef::CreateSurface(fbb, indices_fb, material_fb, indices32_fb,
+                                 material_data_fb, lods_vector_fb);
       surfaces_fb.push_back(surface_fb);
       surface_idx++;
     }
     auto surface_vector_fb = fbb.CreateVector(surfaces_fb);
+    auto lod_screen_sizes_fb =
+        lod_screen_sizes_.empty() ? 0 : fbb.CreateVector(lod_screen_sizes_);
 
     // Output the mesh.
 
@@ -1004,24 +1218,28 @@ class FlatMesh {
       std::vector<uint8_t> format;
       size_t vert_size = 0;
       if (attributes & kVertexAttributeBit_Position) {
-        format.push_back(meshdef::Attribute_Position3f);
-        vert_size += sizeof(vec3_packed);
+        format.push_back(quantize ? meshdef::Attribute_Position3h
+                                  : meshdef::Attribute_Position3f);
+        vert_size += quantize ? sizeof(QuantizedPosition) : sizeof(vec3_packed);
       }
       if (attributes & kVertexAttributeBit_Normal) {
-        format.push_back(meshdef::Attribute_Normal3f);
-        vert_size += sizeof(vec3_packed);
+        format.push_back(quantize ? meshdef::Attribute_NormalOct2s
+                                  : meshdef::Attribute_Normal3f);
+        vert_size += quantize ? sizeof(QuantizedNormal) : sizeof(vec3_packed);
       }
       if (attributes & kVertexAttributeBit_Tangent) {
         format.push_back(meshdef::Attribute_Tangent4f);
         vert_size += sizeof(vec4_packed);
       }
       if (attributes & kVertexAttributeBit_Orientation) {
-        format.push_back(meshdef::Attribute_Orientation4f);
-        vert_size += sizeof(vec4_packed);
+        format.push_back(quantize ? meshdef::Attribute_OrientationPacked
+                                  : meshdef::Attribute_Orientation4f);
+        vert_size += quantize ? sizeof(uint32_t) : sizeof(vec4_packed);
       }
       if (attributes & kVertexAttributeBit_Uv) {
-        format.push_back(meshdef::Attribute_TexCoord2f);
-        vert_size += sizeof(vec2_packed);
+        format.push_back(quantize ? meshdef::Attribute_TexCoord2h
+                                  : meshdef::Attribute_TexCoord2f);
+        vert_size += quantize ? sizeof(QuantizedUv) : sizeof(vec2_packed);
       }
       if (attributes & kVertexAttributeBit_UvAlt) {
         format.push_back(meshdef::Attribute_TexCoordAlt2f);
@@ -1043,24 +1261,42 @@ class FlatMesh {
       for (size_t i = 0; i < num_points; ++i) {
         const Vertex& p = points_[i];
         if (attributes & kVertexAttributeBit_Position) {
-          auto attr = reinterpret_cast<const uint8_t *>(&p.vertex);
-          iattrs.insert(iattrs.end(), attr, attr + sizeof(vec3_packed));
+          if (quantize) {
+            const QuantizedPosition position(vec3(p.vertex));
+            AppendBytes(position, &iattrs);
+          } else {
+            AppendBytes(p.vertex, &iattrs);
+          }
         }
         if (attributes & kVertexAttributeBit_Normal) {
-          auto attr = reinterpret_cast<const uint8_t *>(&p.normal);
-          iattrs.insert(iattrs.end(), attr, attr + sizeof(vec3_packed));
+          if (quantize) {
+            const QuantizedNormal normal(vec3(p.normal));
+            AppendBytes(normal, &iattrs);
+          } else {
+            AppendBytes(p.normal, &iattrs);
+          }
         }
         if (attributes & kVertexAttributeBit_Tangent) {
           auto attr = reinterpret_cast<const uint8_t *>(&p.tangent);
           iattrs.insert(iattrs.end(), attr, attr + sizeof(vec4_packed));
         }
         if (attributes & kVertexAttributeBit_Orientation) {
-          auto attr = reinterpret_cast<const uint8_t *>(&p.orientation);
-          iattrs.insert(iattrs.end(), attr, attr + sizeof(vec4_packed));
+          if (quantize) {
+            const vec4 orientation(p.orientation);
+            const float q[] = {orientation.x, orientation.y, orientation.z,
+                               orientation.w};
+            AppendBytes(PackOrientation(q), &iattrs);
+          } else {
+            AppendBytes(p.orientation, &iattrs);
+          }
         }
         if (attributes & kVertexAttributeBit_Uv) {
-          auto attr = reinterpret_cast<const uint8_t *>(&p.uv);
-          iattrs.insert(iattrs.end(), attr, attr + sizeof(vec2_packed));
+          if (quantize) {
+            const QuantizedUv uv(vec2(p.uv));
+            AppendBytes(uv, &iattrs);
+          } else {
+            AppendBytes(p.uv, &iattrs);
+          }
         }
         if (attributes & kVertexAttributeBit_UvAlt) {
           auto attr = reinterpret_cast<const uint8_t *>(&p.uv_alt);
@@ -1090,7 +1326,7 @@ class FlatMesh {
           0, 0, 0, &max_fb, &min_fb,
           bone_names_fb, bone_transforms_fb, bone_parents_fb,
           shader_to_mesh_bones_fb, 0, meshdef::MeshVersion_MostRecent,
-          formatvec, attrvec);
+          formatvec, attrvec, /* orientations = */ 0, lod_screen_sizes_fb);
     } else {
       // First convert to structure-of-array format.
       std::vector<Vec3> vertices;
@@ -1162,7 +1398,8 @@ class FlatMesh {
           colors_fb, uvs_fb, skin_indices_fb, skin_weights_fb, &max_fb, &min_fb,
           bone_names_fb, bone_transforms_fb, bone_parents_fb,
           shader_to_mesh_bones_fb, uvs_alt_fb, meshdef::MeshVersion_MostRecent,
-          /* attributes = */ 0, /* vertices = */ 0, orientations_fb);
+          /* attributes = */ 0, /* vertices = */ 0, orientations_fb,
+          lod_screen_sizes_fb);
     }
   }
 
@@ -1171,7 +1408,7 @@ class FlatMesh {
       const std::string& assets_sub_dir, const std::string& texture_extension,
       const std::vector<matdef::TextureFormat>& texture_formats,
       matdef::BlendMode blend_mode, bool interleaved, bool force32,
-      bool embed_materials) const {
+      bool quantize, bool embed_materials) const {
     const std::string rel_mesh_file_name =
         assets_sub_dir + mesh_name + "." + meshdef::MeshExtension();
     const std::string full_mesh_file_name =
@@ -1182,7 +1419,7 @@ class FlatMesh {
     flatbuffers::FlatBufferBuilder fbb;
     auto mesh_fb = BuildMeshFlatBuffer(
         fbb, mesh_name, assets_sub_dir, texture_extension, texture_formats,
-        blend_mode, interleaved, force32, embed_materials);
+        blend_mode, interleaved, force32, quantize, embed_materials);
 
     meshdef::FinishMeshBuffer(fbb, mesh_fb);
 
@@ -1325,12 +1562,16 @@ class FlatMesh {
   }
 
   SurfaceMap surfaces_;
-  VertexSet unique_;
+  // Coarser detail levels of each surface, and when to draw them.
+  LodMap lods_;
+  std::vector<float> lod_screen_sizes_;
+  UniqueVertices unique_;
   std::vector<Vertex> points_;
   IndexBuffer* cur_index_buf_;
   VertexAttributeBitmask mesh_vertex_attributes_;
   std::vector<Bone> bones_;
   VertexAttributeBitmask vertex_attributes_;
+  mutable std::vector<std::string> output_files_;
 
   // Information and warnings.
   Logger& log_;
@@ -2171,17 +2412,84 @@ MeshPipelineArgs::MeshPipelineArgs()
       recenter(false),
       interleaved(true),
       force32(false),
+      quantize(false),
+      optimize(true),
+      num_lods(0),
+      lod_ratio(0.5f),
       embed_materials(false),
       vertex_attributes(kVertexAttributeBit_AllAttributesInSourceFile),
       log_level(kLogWarning),
-      gather_textures(true) {
+      gather_textures(true),
+      batch(false),
+      num_jobs(0) {
   bake_transform.SetIdentity();
 }
 
+// Bump when a change to this tool changes the output for the same input, to
+// invalidate existing build cache entries.
+static const int kMeshPipelineCacheVersion = 1;
+
+// Hash every argument that affects the output files, and the FBX file itself.
+// Logging, batching and the cache directory don't change the output, so are
+// left out. Texture files are only looked up, never read, so a cache hit
+// assumes they haven't moved since the entry was stored.
+static uint64_t MeshCacheKey(const MeshPipelineArgs& args,
+                             const std::string& fbx_contents) {
+  BuildHash hash;
+  hash.Add("mesh_pipeline");
+  hash.AddValue(kMeshPipelineCacheVersion);
+  hash.Add(args.fbx_file);
+  hash.Add(args.asset_base_dir);
+  hash.Add(args.asset_rel_dir);
+  hash.Add(args.texture_extension);
+  hash.AddValue(static_cast<uint64_t>(args.texture_formats.size()));
+  for (size_t i = 0; i < args.texture_formats.size(); ++i) {
+    hash.AddValue(args.texture_formats[i]);
+  }
+  hash.AddValue(args.blend_mode);
+  hash.AddValue(args.axis_system);
+  hash.AddValue(args.distance_unit_scale);
+  hash.AddValue(args.recenter);
+  hash.AddValue(args.interleaved);
+  hash.AddValue(args.force32);
+  hash.AddValue(args.quantize);
+  hash.AddValue(args.optimize);
+  hash.AddValue(args.num_lods);
+  hash.AddValue(args.lod_ratio);
+  hash.AddValue(args.embed_materials);
+  hash.AddValue(args.vertex_attributes);
+  hash.AddValue(args.gather_textures);
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      hash.AddValue(args.bake_transform.Get(i, j));
+    }
+  }
+  hash.Add(fbx_contents);
+  return hash.value();
+}
+
 int RunMeshPipeline(const MeshPipelineArgs& args, fplutil::Logger& log) {
   // Update the amount of information we're dumping.
   log.set_level(args.log_level);
 
+  // Skip the conversion when the cache holds outputs built from the same
+  // arguments and FBX file.
+  BuildCache cache(args.cache_dir);
+  uint64_t cache_key = 0;
+  if (cache.enabled()) {
+    std::string fbx_contents;
+    if (ReadBuildFile(args.fbx_file, &fbx_contents)) {
+      cache_key = MeshCacheKey(args, fbx_contents);
+      std::vector<std::string> outputs;
+      if (cache.Fetch(cache_key, &outputs)) {
+        for (size_t i = 0; i < outputs.size(); ++i) {
+          log.Log(kLogImportant, "  %s (up to date)\n", outputs[i].c_str());
+        }
+        return 0;
+      }
+    }
+  }
+
   // Currently orientations can only be generated from normal-tangents, so it
   // doesn't make sense to export both. If this changes at some point, then be
   // sure to also update kVertexAttributeBit_AllAttributesInSourceFile.
@@ -2192,6 +2500,12 @@ int RunMeshPipeline(const MeshPipelineArgs& args, fplutil::Logger& log) {
     return 1;
   }
 
+  // The per-attribute arrays of the non-interleaved format are all floats.
+  if (args.quantize && !args.interleaved) {
+    log.Log(kLogError, "Can only quantize interleaved vertex attributes.\n");
+    return 1;
+  }
+
   // Load the FBX file.
   fplbase::FbxMeshParser pipe(log, args.bake_transform);
   const bool load_status = pipe.Load(args.fbx_file.c_str(), args.axis_system,
@@ -2203,16 +2517,92 @@ int RunMeshPipeline(const MeshPipelineArgs& args, fplutil::Logger& log) {
   const int max_verts = pipe.NumVertsUpperBound();
   fplbase::FlatMesh mesh(max_verts, args.vertex_attributes, log);
   pipe.GatherFlatMesh(args.gather_textures, &mesh);
+  if (args.num_lods > 0) mesh.GenerateLods(args.num_lods, args.lod_ratio);
+  if (args.optimize) mesh.Optimize();
 
   // Output gathered data to a binary FlatBuffer.
   const bool output_status = mesh.OutputFlatBuffer(
       args.fbx_file, args.asset_base_dir, args.asset_rel_dir,
       args.texture_extension, args.texture_formats, args.blend_mode,
-      args.interleaved, args.force32, args.embed_materials);
+      args.interleaved, args.force32, args.quantize, args.embed_materials);
   if (!output_status) return 1;
 
+  if (cache_key != 0) {
+    for (size_t i = 0; i < mesh.output_files().size(); ++i) {
+      cache.AddOutput(mesh.output_files()[i]);
+    }
+    if (!cache.Store(cache_key)) {
+      log.Log(kLogWarning, "Could not add %s to the build cache in %s\n",
+              args.fbx_file.c_str(), args.cache_dir.c_str());
+    }
+  }
+
   // Success.
   return 0;
 }
 
+int RunMeshPipelineBatch(const MeshPipelineArgs& args,
+                         const std::vector<std::string>& fbx_files,
+                         fplutil::Logger& log) {
+  struct FileResult {
+    FileResult() : index(0), status(1), seconds(0.0) {}
+    size_t index;
+    int status;
+    double seconds;
+  };
+  std::vector<FileResult> results(fbx_files.size());
+  std::atomic<size_t> next_file(0);
+
+  auto worker = [&]() {
+    // Each conversion creates its own FbxManager in FbxMeshParser, and each
+    // worker logs through its own Logger, so nothing FBX is shared.
+    Logger worker_log;
+    for (;;) {
+      const size_t i = next_file++;
+      if (i >= fbx_files.size()) return;
+      MeshPipelineArgs file_args = args;
+      file_args.fbx_file = fbx_files[i];
+      const auto start = std::chrono::steady_clock::now();
+      results[i].index = i;
+      results[i].status = RunMeshPipeline(file_args, worker_log);
+      results[i].seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    }
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  size_t num_jobs = args.num_jobs > 0
+                        ? static_cast<size_t>(args.num_jobs)
+                        : std::max(std::thread::hardware_concurrency(), 1u);
+  num_jobs = std::min(num_jobs, fbx_files.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_jobs; ++i) threads.push_back(std::thread(worker));
+  worker();
+  for (auto it = threads.begin(); it != threads.end(); ++it) it->join();
+  const double total_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  // Report the slowest files first, so they're easy to find.
+  log.set_level(std::min(args.log_level, kLogImportant));
+  std::sort(results.begin(), results.end(),
+            [](const FileResult& a, const FileResult& b) {
+              return a.seconds > b.seconds;
+            });
+  int num_failed = 0;
+  for (auto it = results.begin(); it != results.end(); ++it) {
+    if (it->status != 0) num_failed++;
+    log.Log(it->status == 0 ? kLogImportant : kLogError, "%8.2fs %s%s\n",
+            it->seconds, fbx_files[it->index].c_str(),
+            it->status == 0 ? "" : " (failed)");
+  }
+  log.Log(kLogImportant,
+          "Converted %d of %d files in %.2fs with %d jobs.\n",
+          static_cast<int>(results.size()) - num_failed,
+          static_cast<int>(results.size()), total_seconds,
+          static_cast<int>(num_jobs));
+  return num_failed == 0 ? 0 : 1;
+}
+
 }  // namespace fplbase
@@ -16,6 +16,7 @@
 #define FPLBASE_MESH_PIPELINE_H_
 
 #include <string>
+#include <vector>
 #include "fbx_common/fbx_common.h"
 #include "flatbuffers/flatbuffers.h"
 #include "fplbase/fpl_common.h"
@@ -84,15 +85,28 @@ struct MeshPipelineArgs {
   bool recenter;         /// Translate geometry to origin.
   bool interleaved;      /// Write vertex attributes interleaved.
   bool force32;          /// Force 32bit indices.
+  bool quantize;         /// Write compact vertex attributes.
+  bool optimize;         /// Reorder triangles and vertices for the GPU caches.
+  int num_lods;          /// Number of coarser detail levels to generate.
+  float lod_ratio;       /// Fraction of triangles kept by each detail level.
   bool embed_materials;  /// Embed material definitions in fplmesh file.
   VertexAttributeBitmask vertex_attributes;  /// Vertex attributes to output.
   fplutil::LogLevel log_level;  /// Amount of logging to dump during conversion.
   bool gather_textures;         /// Gather textures and generate .fplmat files.
   FbxAMatrix bake_transform;    /// Transform baked into vertices.
+  bool batch;    /// fbx_file is a manifest or directory of FBX files.
+  int num_jobs;  /// Files converted at once in batch mode. 0 for one per core.
+  std::string cache_dir;  /// Build cache directory. Empty to always rebuild.
 };
 
 int RunMeshPipeline(const MeshPipelineArgs& args, fplutil::Logger& log);
 
+/// Convert each of `fbx_files` with `args`, several at once on worker threads,
+/// and log how long each took, slowest first. Returns non-zero if any failed.
+int RunMeshPipelineBatch(const MeshPipelineArgs& args,
+                         const std::vector<std::string>& fbx_files,
+                         fplutil::Logger& log);
+
 }  // namespace fplbase
 
 #endif  // FPLBASE_MESH_PIPELINE_H_
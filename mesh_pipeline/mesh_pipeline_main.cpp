@@ -14,6 +14,18 @@
 
 #include "mesh_pipeline.h"
 
+#include <ctype.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
 using fplutil::kLogError;
 using fplutil::kLogImportant;
 using fplutil::kLogInfo;
@@ -179,6 +191,63 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
     } else if (arg == "--force-32-bit-indices") {
       args->force32 = true;
 
+    } else if (arg == "--quantize-attributes") {
+      args->quantize = true;
+
+    } else if (arg == "--no-optimize") {
+      args->optimize = false;
+
+    } else if (arg == "--lods") {
+      if (i + 1 < argc - 1) {
+        char* end;
+        args->num_lods = static_cast<int>(strtol(argv[i + 1], &end, 10));
+        valid_args = end != argv[i + 1] && args->num_lods >= 0;
+        if (!valid_args) {
+          log.Log(kLogError, "Invalid --lods %s\n\n", argv[i + 1]);
+        }
+        i++;
+      } else {
+        valid_args = false;
+      }
+
+    } else if (arg == "--lod-ratio") {
+      if (i + 1 < argc - 1) {
+        char* end;
+        args->lod_ratio = static_cast<float>(strtod(argv[i + 1], &end));
+        valid_args = end != argv[i + 1] && args->lod_ratio > 0.0f &&
+                     args->lod_ratio < 1.0f;
+        if (!valid_args) {
+          log.Log(kLogError, "Invalid --lod-ratio %s\n\n", argv[i + 1]);
+        }
+        i++;
+      } else {
+        valid_args = false;
+      }
+
+    } else if (arg == "--batch") {
+      args->batch = true;
+
+    } else if (arg == "-j" || arg == "--jobs") {
+      if (i + 1 < argc - 1) {
+        char* end;
+        args->num_jobs = static_cast<int>(strtol(argv[i + 1], &end, 10));
+        valid_args = end != argv[i + 1] && args->num_jobs > 0;
+        if (!valid_args) {
+          log.Log(kLogError, "Invalid --jobs %s\n\n", argv[i + 1]);
+        }
+        i++;
+      } else {
+        valid_args = false;
+      }
+
+    } else if (arg == "--cache-dir") {
+      if (i + 1 < argc - 1) {
+        args->cache_dir = std::string(argv[i + 1]);
+        i++;
+      } else {
+        valid_args = false;
+      }
+
     } else if (arg == "--no-textures") {
       args->gather_textures = false;
 
@@ -297,8 +366,11 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
         "                     [-e TEXTURE_EXTENSION] [-f TEXTURE_FORMATS]\n"
         "                     [-m BLEND_MODE] [-a AXES] [-u (unit)|(scale)]\n"
         "                     [--attrib p|n|t|q|u|v|c|b]\n"
-        "                     [--force-32-bit-indices] [--no-textures]\n"
-        "                     [--embed-materials] [-h] [-c] [-l] [-v|-d|-i]\n"
+        "                     [--force-32-bit-indices] [--quantize-attributes]\n"
+        "                     [--no-optimize] [--lods COUNT]\n"
+        "                     [--lod-ratio RATIO] [--no-textures]\n"
+        "                     [--embed-materials] [--batch] [-j JOBS]\n"
+        "                     [-h] [-c] [-l] [-v|-d|-i]\n"
         "                     FBX_FILE\n"
         "\n"
         "Pipeline to convert FBX mesh data into FlatBuffer mesh data.\n"
@@ -404,11 +476,42 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
         "  --force-32-bit-indices\n"
         "                By default, decides to use 16 or 32 bit indices\n"
         "                on index count. This makes it always use 32 bit.\n"
+        "  --quantize-attributes\n"
+        "                Write half float positions and UVs, octahedral\n"
+        "                normals and 10:10:10:2 orientations, about halving\n"
+        "                the vertex size. Tangents aren't quantized. Needs\n"
+        "                OpenGL ES 3.0, and shaders that decode normals and\n"
+        "                orientations with shaders/fplbase/\n"
+        "                vertex_decoding.glslv_h. Not with -l.\n"
+        "  --no-optimize\n"
+        "                Keep triangles and vertices in source file order.\n"
+        "                By default, triangles are reordered for the GPU's\n"
+        "                vertex cache and to reduce overdraw, and vertices\n"
+        "                are reordered to match.\n"
+        "  --lods COUNT\n"
+        "                Also write COUNT coarser detail levels of each\n"
+        "                surface, simplified with quadric error edge\n"
+        "                collapses. They share the full detail vertices.\n"
+        "                Pick one with Mesh::SelectLod(). Default 0.\n"
+        "  --lod-ratio RATIO\n"
+        "                Fraction of the previous level's triangles that\n"
+        "                each detail level keeps. Default 0.5.\n"
         "  --no-textures\n"
         "                Do not search for textures or create .fplmat files.\n"
         "  --embed-materials\n"
         "                Embeds the material data directly into the .fplmesh\n"
         "                file instead of generating separate .fplmat files.\n"
+        "  --batch       FBX_FILE is a directory, whose .fbx files are all\n"
+        "                converted, or a manifest listing one FBX file per\n"
+        "                line. Files are converted in parallel, and the time\n"
+        "                each took is reported, slowest first.\n"
+        "  -j, --jobs JOBS\n"
+        "                Number of files to convert at once with --batch.\n"
+        "                Default is one per core.\n"
+        "  --cache-dir DIRECTORY\n"
+        "                Reuse the outputs of an earlier conversion from\n"
+        "                DIRECTORY when the FBX file and these options are\n"
+        "                unchanged, and store new outputs there.\n"
         "  -v, --verbose output all informative messages\n"
         "  -d, --details output important informative messages\n"
         "  -i, --info    output more than details, less than verbose\n");
@@ -418,6 +521,65 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
   return valid_args;
 }
 
+static bool HasFbxExtension(const std::string& file) {
+  if (file.size() < 4) return false;
+  std::string extension = file.substr(file.size() - 4);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 ::tolower);
+  return extension == ".fbx";
+}
+
+// Append the .fbx files in `dir` to `files`. Returns false if `dir` isn't a
+// directory.
+static bool ListFbxFilesInDirectory(const std::string& dir,
+                                    std::vector<std::string>* files) {
+#if defined(_WIN32)
+  WIN32_FIND_DATAA find_data;
+  HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &find_data);
+  if (find == INVALID_HANDLE_VALUE) return false;
+  do {
+    if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+        HasFbxExtension(find_data.cFileName)) {
+      files->push_back(dir + "\\" + find_data.cFileName);
+    }
+  } while (FindNextFileA(find, &find_data));
+  FindClose(find);
+#else
+  DIR* d = opendir(dir.c_str());
+  if (d == nullptr) return false;
+  while (const dirent* entry = readdir(d)) {
+    if (HasFbxExtension(entry->d_name)) {
+      files->push_back(dir + "/" + entry->d_name);
+    }
+  }
+  closedir(d);
+#endif
+  return true;
+}
+
+// Fill `files` from `path`, a directory of FBX files or a manifest with one
+// FBX file per line. Blank lines and lines starting with '#' are skipped.
+static bool ListBatchFiles(const std::string& path, fplutil::Logger& log,
+                           std::vector<std::string>* files) {
+  if (ListFbxFilesInDirectory(path, files)) {
+    std::sort(files->begin(), files->end());
+    return true;
+  }
+  std::ifstream manifest(path.c_str());
+  if (!manifest) {
+    log.Log(kLogError, "Can't open batch manifest or directory %s\n",
+            path.c_str());
+    return false;
+  }
+  std::string line;
+  while (std::getline(manifest, line)) {
+    const size_t end = line.find_last_not_of(" \t\r");
+    if (end == std::string::npos || line[0] == '#') continue;
+    files->push_back(line.substr(0, end + 1));
+  }
+  return true;
+}
+
 int main(int argc, char** argv) {
   fplutil::Logger log;
 
@@ -425,5 +587,10 @@ int main(int argc, char** argv) {
   fplbase::MeshPipelineArgs args;
   if (!ParseMeshPipelineArgs(argc, argv, log, &args)) return 1;
 
+  if (args.batch) {
+    std::vector<std::string> fbx_files;
+    if (!ListBatchFiles(args.fbx_file, log, &fbx_files)) return 1;
+    return fplbase::RunMeshPipelineBatch(args, fbx_files, log);
+  }
   return fplbase::RunMeshPipeline(args, log);
 }
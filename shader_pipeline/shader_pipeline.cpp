@@ -16,9 +16,16 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <vector>
 
 #include "common_generated.h"
+#include "fplbase/internal/build_cache.h"
 #include "fplbase/preprocessor.h"
 #include "fplbase/utilities.h"
 #include "shader_generated.h"
@@ -43,83 +50,248 @@ static std::string ApplyVersion(const std::string& source,
   return versioned_source;
 }
 
-int RunShaderPipeline(const ShaderPipelineArgs& args) {
-  // Store the current load file function which we'll restore later.
-  fplbase::LoadFileFunction load_fn = fplbase::SetLoadFileFunction(nullptr);
+// Bump when a change to this tool changes the output for the same input, to
+// invalidate existing build cache entries.
+static const int kShaderPipelineCacheVersion = 2;
+
+// Hash everything that decides the output except the #included files, which
+// aren't known until the shaders have been preprocessed.
+static uint64_t ShaderCacheKey(const ShaderPipelineArgs& args,
+                               const std::string& vertex_source,
+                               const std::string& fragment_source) {
+  BuildHash hash;
+  hash.Add("shader_pipeline");
+  hash.AddValue(kShaderPipelineCacheVersion);
+  hash.Add(args.vertex_shader);
+  hash.Add(args.fragment_shader);
+  hash.Add(args.output_file);
+  hash.Add(args.version);
+  for (auto it = args.defines.begin(); it != args.defines.end(); ++it) {
+    if (*it) hash.Add(*it);
+  }
+  hash.AddValue(static_cast<uint64_t>(args.defines.size()));
+  for (auto it = args.include_dirs.begin(); it != args.include_dirs.end();
+       ++it) {
+    hash.Add(*it);
+  }
+  for (auto it = args.variants.begin(); it != args.variants.end(); ++it) {
+    hash.Add(*it);
+  }
+  hash.AddValue(static_cast<uint64_t>(args.variants.size()));
+  hash.Add(vertex_source);
+  hash.Add(fragment_source);
+  return hash.value();
+}
+
+// Every combination of at most one define from each comma-separated group in
+// `variants`, each sorted, starting with the one with none.
+static std::vector<std::vector<std::string>> VariantDefines(
+    const std::vector<std::string>& variants) {
+  std::vector<std::vector<std::string>> groups;
+  for (auto it = variants.begin(); it != variants.end(); ++it) {
+    std::vector<std::string> group;
+    size_t start = 0;
+    while (start <= it->size()) {
+      size_t end = it->find(',', start);
+      if (end == std::string::npos) end = it->size();
+      if (end > start) group.push_back(it->substr(start, end - start));
+      start = end + 1;
+    }
+    if (!group.empty()) groups.push_back(group);
+  }
 
-  // Provide a custom loader that will search include paths for files.  This
-  // loader will use the previous file loader for the actual loading operation.
-  fplbase::SetLoadFileFunction([&load_fn, &args](const char* filename,
-                                                 std::string* dest) {
-    // First try to load the file at the given path.
-    if (load_fn(filename, dest)) {
-      return true;
+  // Count through the combinations, where choice[i] is 0 for none of group
+  // i, or 1 + the index of the define picked from it.
+  std::vector<std::vector<std::string>> combinations;
+  std::vector<size_t> choice(groups.size(), 0);
+  for (;;) {
+    std::vector<std::string> defines;
+    for (size_t i = 0; i < groups.size(); ++i) {
+      if (choice[i]) defines.push_back(groups[i][choice[i] - 1]);
     }
+    std::sort(defines.begin(), defines.end());
+    combinations.push_back(defines);
 
-    // Otherwise, try to load from each of the include dirs (but only for
-    // #included files).
-    if (args.vertex_shader.compare(filename) != 0 &&
-        args.fragment_shader.compare(filename) != 0) {
-      std::string path;
-      for (const auto& dir : args.include_dirs) {
-        path = dir;
-        if (path.back() != '/' && path.back() != '\\') {
-          path += '/';
-        }
-        path += filename;
-        if (load_fn(path.c_str(), dest)) {
-          return true;
-        }
+    size_t i = 0;
+    while (i < groups.size() && ++choice[i] > groups[i].size()) {
+      choice[i++] = 0;
+    }
+    if (i == groups.size()) break;
+  }
+  return combinations;
+}
+
+// The #included files loaded so far, by the name in their #include
+// statements, so that headers shared by the shaders of a batch are only
+// searched for and read once. Every shader of a run shares the include
+// directories, like the cache in LoadFileWithDirectives() that this sits
+// behind.
+class IncludeFiles {
+ public:
+  IncludeFiles(const std::vector<char*>& include_dirs,
+               const LoadFileFunction& load_fn)
+      : include_dirs_(include_dirs), load_fn_(load_fn) {}
+
+  // Load `filename` from where it is, or else from the first of the include
+  // directories that has it.
+  bool Load(const char* filename, std::string* dest) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = files_.find(filename);
+      if (it != files_.end()) {
+        *dest = it->second.contents;
+        return it->second.found;
       }
     }
 
-    return false;
-  });
+    File file;
+    file.path = filename;
+    file.found = load_fn_(filename, &file.contents);
+    for (auto it = include_dirs_.begin();
+         it != include_dirs_.end() && !file.found; ++it) {
+      file.path = *it;
+      if (file.path.back() != '/' && file.path.back() != '\\') {
+        file.path += '/';
+      }
+      file.path += filename;
+      file.found = load_fn_(file.path.c_str(), &file.contents);
+    }
+    if (!file.found) file.contents.clear();
+    *dest = file.contents;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_.insert(std::make_pair(std::string(filename), file));
+    return file.found;
+  }
+
+  // Find the path and contents of `filename`, if it was loaded.
+  bool Find(const std::string& filename, std::string* path,
+            std::string* contents) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = files_.find(filename);
+    if (it == files_.end() || !it->second.found) return false;
+    *path = it->second.path;
+    *contents = it->second.contents;
+    return true;
+  }
+
+ private:
+  struct File {
+    File() : found(false) {}
+    bool found;
+    std::string path;
+    std::string contents;
+  };
+
+  const std::vector<char*>& include_dirs_;
+  const LoadFileFunction& load_fn_;
+  std::mutex mutex_;
+  std::map<std::string, File> files_;
+};
+
+// The shader this thread is preprocessing, to tell its #included files from
+// the shaders themselves.
+static thread_local const ShaderPipelineArgs* t_shader_args = nullptr;
+
+// Loads both shaders with their #includes, and the defines every variant
+// gets as well as `variant_defines`. Adds the names of the #included files to
+// `includes`.
+static bool PreprocessShaders(const ShaderPipelineArgs& args,
+                              const std::vector<std::string>& variant_defines,
+                              std::string* vsh, std::string* fsh,
+                              std::set<std::string>* includes) {
+  std::set<std::string> defines;
+  for (auto it = args.defines.begin(); it != args.defines.end(); ++it) {
+    if (*it && **it) defines.insert(*it);
+  }
+  defines.insert(variant_defines.begin(), variant_defines.end());
 
-  // Read
-  int status = 0;
-  std::string vsh;
-  std::string fsh;
   std::string error_message;
-  const char* const* defines = args.defines.data();
-  if (!fplbase::LoadFileWithDirectives(args.vertex_shader.c_str(), &vsh,
-                                       defines, &error_message)) {
+  if (!fplbase::LoadFileWithDirectives(args.vertex_shader.c_str(), vsh,
+                                       defines, includes, &error_message)) {
     printf("Unable to load file: %s \n%s\n", args.vertex_shader.c_str(),
            error_message.c_str());
-    status = 1;
+    return false;
   }
-
-  if (!status &&
-      !fplbase::LoadFileWithDirectives(args.fragment_shader.c_str(), &fsh,
-                                       defines, &error_message)) {
-    printf("Unable to load file: %s \n%s\n", args.vertex_shader.c_str(),
+  if (!fplbase::LoadFileWithDirectives(args.fragment_shader.c_str(), fsh,
+                                       defines, includes, &error_message)) {
+    printf("Unable to load file: %s \n%s\n", args.fragment_shader.c_str(),
            error_message.c_str());
-    status = 1;
+    return false;
   }
+  if (!args.version.empty()) {
+    *vsh = ApplyVersion(*vsh, args.version);
+    *fsh = ApplyVersion(*fsh, args.version);
+  }
+  return true;
+}
 
-  // Restore the previous load file function.
-  fplbase::SetLoadFileFunction(load_fn);
-
-  if (status != 0) {
-    return status;
+// Writes the fplshader file for `args`, with its #included files loaded
+// through `include_files`. Safe to call from several threads at once, while
+// the load file function set by RunShaders() is in place.
+static int BuildShader(const ShaderPipelineArgs& args,
+                       IncludeFiles* include_files) {
+  // Skip the conversion when the cache holds an output built from the same
+  // arguments, shader sources and #included files.
+  BuildCache cache(args.cache_dir);
+  uint64_t cache_key = 0;
+  if (cache.enabled()) {
+    std::string vertex_source;
+    std::string fragment_source;
+    if (ReadBuildFile(args.vertex_shader, &vertex_source) &&
+        ReadBuildFile(args.fragment_shader, &fragment_source)) {
+      cache_key = ShaderCacheKey(args, vertex_source, fragment_source);
+      if (cache.Fetch(cache_key)) {
+        printf("Up to date: %s\n", args.output_file.c_str());
+        return 0;
+      }
+    }
   }
 
-  if (!args.version.empty()) {
-    vsh = ApplyVersion(vsh, args.version);
-    fsh = ApplyVersion(fsh, args.version);
+  // Read and preprocess every variant. The first, with none of the variant
+  // defines, doubles as the shader for loaders that predate variants.
+  const std::vector<std::vector<std::string>> variant_defines =
+      VariantDefines(args.variants);
+  std::vector<std::string> vsh(variant_defines.size());
+  std::vector<std::string> fsh(variant_defines.size());
+  std::set<std::string> includes;
+  t_shader_args = &args;
+  for (size_t i = 0; i < variant_defines.size(); ++i) {
+    if (!PreprocessShaders(args, variant_defines[i], &vsh[i], &fsh[i],
+                           &includes)) {
+      t_shader_args = nullptr;
+      return 1;
+    }
   }
+  t_shader_args = nullptr;
 
   // Create the FlatBuffer for the Shader.
   flatbuffers::FlatBufferBuilder fbb;
-  auto vsh_fb = fbb.CreateString(vsh);
-  auto fsh_fb = fbb.CreateString(fsh);
+  auto vsh_fb = fbb.CreateString(vsh[0]);
+  auto fsh_fb = fbb.CreateString(fsh[0]);
 
   std::vector<flatbuffers::Offset<flatbuffers::String>> sources_vector;
   sources_vector.push_back(fbb.CreateString(args.vertex_shader));
   sources_vector.push_back(fbb.CreateString(args.fragment_shader));
   auto sources_fb = fbb.CreateVector(sources_vector);
 
-  auto shader_fb = shaderdef::CreateShader(fbb, vsh_fb, fsh_fb, sources_fb);
+  // Without --variant there's only the one, which needs no table of its own.
+  flatbuffers::Offset<
+      flatbuffers::Vector<flatbuffers::Offset<shaderdef::ShaderVariant>>>
+      variants_fb;
+  if (!args.variants.empty()) {
+    std::vector<flatbuffers::Offset<shaderdef::ShaderVariant>> variants_vector;
+    for (size_t i = 0; i < variant_defines.size(); ++i) {
+      auto defines_fb = fbb.CreateVectorOfStrings(variant_defines[i]);
+      variants_vector.push_back(shaderdef::CreateShaderVariant(
+          fbb, defines_fb, i ? fbb.CreateString(vsh[i]) : vsh_fb,
+          i ? fbb.CreateString(fsh[i]) : fsh_fb));
+    }
+    variants_fb = fbb.CreateVector(variants_vector);
+  }
+
+  auto shader_fb =
+      shaderdef::CreateShader(fbb, vsh_fb, fsh_fb, sources_fb, variants_fb);
   shaderdef::FinishShaderBuffer(fbb, shader_fb);
 
   // Save the Shader FlatBuffer to disk.
@@ -128,8 +300,92 @@ int RunShaderPipeline(const ShaderPipelineArgs& args) {
     return 1;
   }
 
+  if (cache_key != 0) {
+    std::string path;
+    std::string contents;
+    for (auto it = includes.begin(); it != includes.end(); ++it) {
+      if (include_files->Find(*it, &path, &contents)) {
+        cache.AddDependency(path, contents);
+      }
+    }
+    cache.AddOutput(args.output_file);
+    if (!cache.Store(cache_key)) {
+      printf("Could not add %s to the build cache in %s.\n",
+             args.output_file.c_str(), args.cache_dir.c_str());
+    }
+  }
+
   // Success.
   return 0;
 }
 
+// Builds each of `shaders` on `num_jobs` threads, sharing their #included
+// files. Returns the number that failed.
+static int RunShaders(const std::vector<ShaderPipelineArgs>& shaders,
+                      size_t num_jobs) {
+  if (shaders.empty()) return 0;
+  const std::vector<char*>& include_dirs = shaders[0].include_dirs;
+
+  // Store the current load file function which we'll restore later.
+  fplbase::LoadFileFunction load_fn = fplbase::SetLoadFileFunction(nullptr);
+
+  // Provide a custom loader that will search include paths for #included
+  // files. This loader will use the previous file loader for the actual
+  // loading operation. Setting it drops any #included files the include
+  // cache holds from another loader.
+  IncludeFiles include_files(include_dirs, load_fn);
+  fplbase::SetLoadFileFunction([&load_fn, &include_files](
+                                   const char* filename, std::string* dest) {
+    const ShaderPipelineArgs* args = t_shader_args;
+    const bool is_include = args != nullptr &&
+                            args->vertex_shader.compare(filename) != 0 &&
+                            args->fragment_shader.compare(filename) != 0;
+    return is_include ? include_files.Load(filename, dest)
+                      : load_fn(filename, dest);
+  });
+
+  std::atomic<size_t> next_shader(0);
+  std::atomic<int> num_failed(0);
+  auto worker = [&]() {
+    for (;;) {
+      const size_t i = next_shader++;
+      if (i >= shaders.size()) return;
+      if (BuildShader(shaders[i], &include_files) != 0) num_failed++;
+    }
+  };
+  num_jobs = std::min(std::max(num_jobs, static_cast<size_t>(1)),
+                      shaders.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_jobs; ++i) threads.push_back(std::thread(worker));
+  worker();
+  for (auto it = threads.begin(); it != threads.end(); ++it) it->join();
+
+  // Restore the previous load file function, which also drops the #included
+  // files loaded through ours.
+  fplbase::SetLoadFileFunction(load_fn);
+  return num_failed;
+}
+
+int RunShaderPipeline(const ShaderPipelineArgs& args) {
+  return RunShaders(std::vector<ShaderPipelineArgs>(1, args), 1) ? 1 : 0;
+}
+
+int RunShaderPipelineBatch(const std::vector<ShaderPipelineArgs>& shaders,
+                           int num_jobs) {
+  for (auto it = shaders.begin(); it != shaders.end(); ++it) {
+    if (it->include_dirs != shaders[0].include_dirs) {
+      printf("Every shader in a batch needs the same include directories.\n");
+      return 1;
+    }
+  }
+  const size_t jobs = num_jobs > 0
+                          ? static_cast<size_t>(num_jobs)
+                          : std::max(std::thread::hardware_concurrency(), 1u);
+  const int num_failed = RunShaders(shaders, jobs);
+  printf("Built %d of %d shaders.\n",
+         static_cast<int>(shaders.size()) - num_failed,
+         static_cast<int>(shaders.size()));
+  return num_failed ? 1 : 0;
+}
+
 }  // namespace fplbase
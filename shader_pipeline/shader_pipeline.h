@@ -27,10 +27,22 @@ struct ShaderPipelineArgs {
   std::string version;              /// Version override.
   std::vector<char*> defines;       /// Definitions to include into the shaders.
   std::vector<char*> include_dirs;  /// Directories to search for include files.
+  /// Groups of comma-separated defines. A variant is written for every
+  /// combination of at most one define from each group.
+  std::vector<std::string> variants;
+  std::string cache_dir;  /// Build cache directory. Empty to always rebuild.
+  bool batch = false;     /// output_file is a manifest of shaders to build.
+  int num_jobs = 0;       /// Shaders built at once with batch. 0 for 1/core.
 };
 
 int RunShaderPipeline(const ShaderPipelineArgs& args);
 
+/// Build each of `shaders`, several at once on worker threads, loading the
+/// files they #include only once. They all need the same include_dirs.
+/// Returns non-zero if any failed.
+int RunShaderPipelineBatch(const std::vector<ShaderPipelineArgs>& shaders,
+                           int num_jobs);
+
 }  // namespace fplbase
 
 #endif  // FPLBASE_SHADER_PIPELINE_H_
@@ -14,6 +14,11 @@
 
 #include "shader_pipeline.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+
 static bool ParseShaderPipelineArgs(int argc, char** argv,
                                     fplbase::ShaderPipelineArgs* args) {
   bool valid_args = true;
@@ -65,6 +70,15 @@ static bool ParseShaderPipelineArgs(int argc, char** argv,
         valid_args = false;
       }
 
+      // --variant switch
+    } else if (arg == "--variant") {
+      if (i < argc - 2) {
+        ++i;
+        args->variants.push_back(argv[i]);
+      } else {
+        valid_args = false;
+      }
+
       // --version switch
     } else if (arg == "--version") {
       if (i < argc - 2) {
@@ -74,6 +88,28 @@ static bool ParseShaderPipelineArgs(int argc, char** argv,
         valid_args = false;
       }
 
+      // --cache-dir switch
+    } else if (arg == "--cache-dir") {
+      if (i < argc - 2) {
+        ++i;
+        args->cache_dir = argv[i];
+      } else {
+        valid_args = false;
+      }
+
+      // --batch switch
+    } else if (arg == "--batch") {
+      args->batch = true;
+
+      // -j switch
+    } else if (arg == "-j" || arg == "--jobs") {
+      if (i < argc - 2) {
+        ++i;
+        args->num_jobs = atoi(argv[i]);
+      } else {
+        valid_args = false;
+      }
+
       // all other (non-empty) arguments
     } else if (arg != "") {
       printf("Unknown parameter: %s\n", arg.c_str());
@@ -85,7 +121,8 @@ static bool ParseShaderPipelineArgs(int argc, char** argv,
   // Null-terminate the vector so the resulting array is null-termintated.
   args->defines.insert(args->defines.end(), nullptr);
 
-  if (args->vertex_shader.empty() || args->fragment_shader.empty()) {
+  if (!args->batch &&
+      (args->vertex_shader.empty() || args->fragment_shader.empty())) {
     valid_args = false;
   }
 
@@ -94,6 +131,7 @@ static bool ParseShaderPipelineArgs(int argc, char** argv,
     printf(
         "Usage: shader_pipeline -vs VERTEX_SHADER -fs FRAGMENT_SHADER\n"
         "                       OUTPUT_FILE\n"
+        "       shader_pipeline --batch MANIFEST\n"
         "\n"
         "Pipeline to generate fplshader files from individual vertex and \n"
         "fragment shader files.\n"
@@ -103,18 +141,67 @@ static bool ParseShaderPipelineArgs(int argc, char** argv,
         "  -fs, --fragment-shader FRAGMENT_SHADER\n"
         "  -i,  --include_dir DIRECTORY\n"
         "  -d,  --defines DEFINITION\n"
-        "       --version VERSION\n");
+        "       --variant DEFINITION[,DEFINITION...]\n"
+        "                Also write the shaders preprocessed with each of\n"
+        "                these defines, or none of them, combined with every\n"
+        "                choice from the other --variant groups.\n"
+        "       --version VERSION\n"
+        "       --cache-dir DIRECTORY\n"
+        "                Reuse the output of an earlier run from DIRECTORY\n"
+        "                when the arguments, shaders and #included files\n"
+        "                are unchanged, and store new outputs there.\n"
+        "       --batch  Build every shader listed in MANIFEST, one per line\n"
+        "                as VERTEX_SHADER FRAGMENT_SHADER OUTPUT_FILE, in\n"
+        "                parallel. The files they #include are loaded once,\n"
+        "                and the other options apply to all of them.\n"
+        "  -j,  --jobs JOBS\n"
+        "                Number of shaders to build at once with --batch.\n"
+        "                Default is one per core.\n");
   }
 
   return valid_args;
 }
 
+// Fill `shaders` with a copy of `args` for each line of the manifest named
+// by its output_file. Blank lines and lines starting with '#' are skipped.
+static bool ReadBatchManifest(
+    const fplbase::ShaderPipelineArgs& args,
+    std::vector<fplbase::ShaderPipelineArgs>* shaders) {
+  std::ifstream manifest(args.output_file.c_str());
+  if (!manifest) {
+    printf("Can't open batch manifest %s\n", args.output_file.c_str());
+    return false;
+  }
+  std::string line;
+  for (int line_number = 1; std::getline(manifest, line); ++line_number) {
+    std::istringstream fields(line);
+    fplbase::ShaderPipelineArgs shader = args;
+    if (!(fields >> shader.vertex_shader) || shader.vertex_shader[0] == '#') {
+      continue;
+    }
+    std::string extra;
+    if (!(fields >> shader.fragment_shader >> shader.output_file) ||
+        fields >> extra) {
+      printf("%s:%d: expected VERTEX_SHADER FRAGMENT_SHADER OUTPUT_FILE\n",
+             args.output_file.c_str(), line_number);
+      return false;
+    }
+    shaders->push_back(shader);
+  }
+  return true;
+}
+
 int main(int argc, char** argv) {
   // Parse the command line arguments.
   fplbase::ShaderPipelineArgs args;
   if (!ParseShaderPipelineArgs(argc, argv, &args)) {
     return 1;
   }
+  if (args.batch) {
+    std::vector<fplbase::ShaderPipelineArgs> shaders;
+    if (!ReadBatchManifest(args, &shaders)) return 1;
+    return fplbase::RunShaderPipelineBatch(shaders, args.num_jobs);
+  }
   return fplbase::RunShaderPipeline(args);
 }
 
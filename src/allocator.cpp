@@ -0,0 +1,77 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "precompiled.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "fplbase/allocator.h"
+
+namespace fplbase {
+
+// Functions called by AllocateMemory() and FreeMemory(), if set. They're not
+// locked, since they're called for every decoded image, and SetAllocator()
+// must not be called while anything is loading anyway.
+static AllocateFunction g_allocate_function;
+static FreeFunction g_free_function;
+
+void SetAllocator(AllocateFunction allocate_function,
+                  FreeFunction free_function) {
+  if (allocate_function && free_function) {
+    g_allocate_function = allocate_function;
+    g_free_function = free_function;
+  } else {
+    g_allocate_function = nullptr;
+    g_free_function = nullptr;
+  }
+}
+
+bool HasCustomAllocator() { return g_allocate_function != nullptr; }
+
+void *AllocateMemory(size_t size, AllocationCategory category) {
+  assert(category < kAllocationCategoryCount);
+  return g_allocate_function ? g_allocate_function(size, category)
+                             : malloc(size);
+}
+
+void FreeMemory(void *ptr, AllocationCategory category) {
+  if (!ptr) return;
+  if (g_free_function) {
+    g_free_function(ptr, category);
+  } else {
+    free(ptr);
+  }
+}
+
+// The pointer AllocateMemory() returned is kept just before the aligned one.
+// There's always room for it, since AllocateMemory() is at least pointer
+// aligned, so rounding up moves the pointer by at least that much.
+void *AllocateAlignedMemory(size_t size, AllocationCategory category) {
+  static_assert((kAllocationAlignment & (kAllocationAlignment - 1)) == 0,
+                "kAllocationAlignment must be a power of 2.");
+  uint8_t *ptr = static_cast<uint8_t *>(
+      AllocateMemory(size + kAllocationAlignment, category));
+  if (!ptr) return nullptr;
+  uint8_t *aligned = reinterpret_cast<uint8_t *>(
+      (reinterpret_cast<uintptr_t>(ptr) + kAllocationAlignment) &
+      ~static_cast<uintptr_t>(kAllocationAlignment - 1));
+  reinterpret_cast<void **>(aligned)[-1] = ptr;
+  return aligned;
+}
+
+void FreeAlignedMemory(void *ptr, AllocationCategory category) {
+  if (!ptr) return;
+  FreeMemory(reinterpret_cast<void **>(ptr)[-1], category);
+}
+
+}  // namespace fplbase
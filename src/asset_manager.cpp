@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "precompiled.h"
+#include "asset_manifest_generated.h"
 #include "common_generated.h"
 #include "fplbase/asset_manager.h"
 #include "fplbase/texture.h"
@@ -27,10 +28,19 @@ using mathfu::vec3;
 using mathfu::vec4;
 using mathfu::vec4i;
 
+#ifdef _WIN32
+#define snprintf(buffer, count, format, ...) \
+  _snprintf_s(buffer, count, count, format, __VA_ARGS__)
+#endif  // _WIN32
+
 namespace fplbase {
 
 void FileAsset::Load() {
-  if (LoadFile(filename_.c_str(), &contents)) {
+  const double start = GetTimeInSeconds();
+  const bool loaded = LoadFile(filename_.c_str(), &contents);
+  load_stats_.io_time = GetTimeInSeconds() - start;
+  load_stats_.file_bytes = contents.length();
+  if (loaded) {
     // This is just to signal the load succeeded. data_ doesn't own the memory.
     data_ = reinterpret_cast<const uint8_t *>(contents.c_str());
   }
@@ -45,39 +55,258 @@ bool FileAsset::Finalize() {
 
 bool FileAsset::IsValid() { return true; }
 
+FileAsset::~FileAsset() {
+  if (mapped_data_) UnmapFile(mapped_data_, mapped_size_);
+}
+
+bool FileAsset::LoadMapped(const char *filename) {
+  int32_t size = 0;
+  auto mapping = HasCustomLoadFileFunction()
+                     ? nullptr
+                     : static_cast<const uint8_t *>(MapFile(filename, 0, &size));
+  if (!mapping) return LoadFile(filename, &contents);
+  if (mapped_data_) UnmapFile(mapped_data_, mapped_size_);
+  mapped_data_ = mapping;
+  mapped_size_ = size;
+  contents.clear();
+  return true;
+}
+
 template <typename T>
-T FindInMap(const std::map<std::string, T> &map, const char *name) {
-  auto it = map.find(name);
-  return it != map.end() ? it->second : 0;
+T *FindInMap(const AssetMap<T> &map, const char *name) {
+  return map.Find(AssetId(name));
 }
 
 template <typename T>
-void DestructAssetsInMap(std::map<std::string, T> &map) {
-  for (auto it = map.begin(); it != map.end(); ++it) {
-    delete it->second;
-  }
-  map.clear();
+void DestructAssetsInMap(AssetMap<T> &map) {
+  map.ForEach([](const std::string &, T *asset) { delete asset; });
+  map.Clear();
 }
 
 AssetManager::AssetManager(Renderer &renderer)
-    : renderer_(renderer), texture_scale_(mathfu::kOnes2f) {
+    : renderer_(renderer),
+      texture_scale_(mathfu::kOnes2f),
+      map_mesh_files_(false),
+      use_epoch_(0),
+      recording_loads_(false) {
   // Empty material for default case.
-  material_map_[""] = new Material();
+  material_map_.Insert(AssetId(""), "", new Material());
 }
 
 void AssetManager::ClearAllAssets() {
-  DestructAssetsInMap(material_map_);
+  // Materials with the same contents appear under each of their file names,
+  // so collect them first, to delete each once.
+  std::unordered_set<Material *> materials;
+  material_map_.ForEach(
+      [&](const std::string &, Material *mat) { materials.insert(mat); });
+  for (auto it = embedded_materials_.begin(); it != embedded_materials_.end();
+       ++it) {
+    materials.insert(it->second);
+  }
+  for (auto it = materials.begin(); it != materials.end(); ++it) delete *it;
+  material_map_.Clear();
+  material_contents_.clear();
+  embedded_materials_.clear();
   DestructAssetsInMap(texture_atlas_map_);
   DestructAssetsInMap(mesh_map_);
   DestructAssetsInMap(shader_map_);
+  for (auto it = mip_streams_.begin(); it != mip_streams_.end(); ++it) {
+    loader_.AbortJobAndDelete(it->second);
+  }
+  mip_streams_.clear();
+  while (!cube_map_faces_.empty()) {
+    StopCubeMapLoading(cube_map_faces_.begin()->first);
+  }
+  {
+    fplutil::MutexLock lock(prefetch_mutex_);
+    RegisterPrefetchedTextures();
+    texture_index_.clear();
+  }
   DestructAssetsInMap(texture_map_);
   DestructAssetsInMap(file_map_);
+  ClearResidency(&texture_residency_);
+  ClearResidency(&mesh_residency_);
+}
+
+template <typename T>
+void AssetManager::TrackResidency(T *asset, ResidentSet<T> *set) {
+  asset->AddFinalizeCallback([this, asset, set]() {
+    if (!asset->IsValid() || set->entries.count(asset)) return;
+    const typename ResidentSet<T>::Entry entry = {
+        asset, asset->CalculateMemorySize(), use_epoch_};
+    set->lru.push_front(entry);
+    set->entries[asset] = set->lru.begin();
+    set->bytes_used += entry.size;
+  });
+}
+
+template <typename T>
+void AssetManager::Touch(T *asset, ResidentSet<T> *set) {
+  auto it = set->entries.find(asset);
+  if (it != set->entries.end()) {
+    it->second->last_use = use_epoch_;
+    set->lru.splice(set->lru.begin(), set->lru, it->second);
+    return;
+  }
+  if (set->evicted.erase(asset)) {
+    // Load it again, it rejoins `set` once it has finalized.
+    asset->finalized_ = false;
+    TrackResidency(asset, set);
+    loader_.QueueJob(asset, asset->load_priority());
+  }
+}
+
+template <typename T>
+void AssetManager::ForgetResidency(T *asset, ResidentSet<T> *set) {
+  auto it = set->entries.find(asset);
+  if (it != set->entries.end()) {
+    set->bytes_used -= it->second->size;
+    set->lru.erase(it->second);
+    set->entries.erase(it);
+  }
+  set->evicted.erase(asset);
+}
+
+template <typename T>
+void AssetManager::ClearResidency(ResidentSet<T> *set) {
+  set->lru.clear();
+  set->entries.clear();
+  set->evicted.clear();
+  set->bytes_used = 0;
+}
+
+template <typename T>
+void AssetManager::EvictOverBudget(ResidentSet<T> *set) {
+  if (set->budget == 0) return;
+  auto it = set->lru.end();
+  while (set->bytes_used > set->budget && it != set->lru.begin()) {
+    --it;
+    // This, and everything in front of it, is still in use.
+    if (it->last_use == use_epoch_) break;
+    if (it->asset->HasHandles()) continue;
+    T *asset = it->asset;
+    set->bytes_used -= it->size;
+    set->entries.erase(asset);
+    set->evicted.insert(asset);
+    it = set->lru.erase(it);
+    Evict(asset);
+  }
+}
+
+void AssetManager::EnforceMemoryBudget() {
+  auto &textures = texture_residency_;
+  if (textures.budget != 0 && textures.bytes_used > textures.budget) {
+    // The textures of meshes with handles are in use as well.
+    auto &meshes = mesh_residency_.lru;
+    for (auto it = meshes.begin(); it != meshes.end(); ++it) {
+      if (!it->asset->HasHandles()) continue;
+      for (size_t i = 0; i < it->asset->GetNumIndexBufferObjects(); ++i) {
+        TouchMaterial(it->asset->GetMaterial(static_cast<int>(i)));
+      }
+    }
+  }
+  EvictOverBudget(&texture_residency_);
+  EvictOverBudget(&mesh_residency_);
+  ++use_epoch_;
+}
+
+void AssetManager::StreamMips() {
+  auto &textures = texture_residency_;
+  // Uploaded mips make their textures bigger, so update their sizes first.
+  size_t pending_bytes = 0;
+  for (auto it = mip_streams_.begin(); it != mip_streams_.end();) {
+    TextureMipStream *stream = it->second;
+    Texture *tex = it->first;
+    if (!stream->IsFinalized()) {
+      // The next mip has 4x the pixels of everything resident so far.
+      pending_bytes += tex->CalculateMemorySize() * 3;
+      ++it;
+      continue;
+    }
+    if (!stream->IsValid()) {
+      // Don't retry every frame, keep what is resident.
+      tex->set_requested_mip(tex->resident_mip());
+    }
+    auto entry = textures.entries.find(tex);
+    if (entry != textures.entries.end()) {
+      textures.bytes_used -= entry->second->size;
+      entry->second->size = tex->CalculateMemorySize();
+      textures.bytes_used += entry->second->size;
+    }
+    delete stream;
+    it = mip_streams_.erase(it);
+  }
+  // Stream most recently used first, one mip per texture at a time.
+  for (auto it = textures.lru.begin(); it != textures.lru.end(); ++it) {
+    Texture *tex = it->asset;
+    if (!tex->NeedsFinerMip() || mip_streams_.count(tex)) continue;
+    const size_t growth = it->size * 3;
+    if (textures.budget != 0 &&
+        textures.bytes_used + pending_bytes + growth > textures.budget) {
+      continue;
+    }
+    pending_bytes += growth;
+    auto stream = new TextureMipStream(tex, tex->resident_mip() - 1);
+    mip_streams_[tex] = stream;
+    loader_.QueueJob(stream, kLoadPriorityLow);
+  }
+}
+
+void AssetManager::StopMipStreaming(Texture *texture) {
+  auto it = mip_streams_.find(texture);
+  if (it == mip_streams_.end()) return;
+  // Deletes it right away, unless a loader thread is busy with it.
+  loader_.AbortJobAndDelete(it->second);
+  mip_streams_.erase(it);
+}
+
+void AssetManager::CollectCubeMapFaces() {
+  for (auto it = cube_map_faces_.begin(); it != cube_map_faces_.end();) {
+    // The last face to finalize also finalizes the cube map.
+    if (!it->first->IsFinalized()) {
+      ++it;
+      continue;
+    }
+    for (auto face = it->second.begin(); face != it->second.end(); ++face) {
+      delete *face;
+    }
+    it = cube_map_faces_.erase(it);
+  }
+}
+
+void AssetManager::StopCubeMapLoading(Texture *texture) {
+  auto it = cube_map_faces_.find(texture);
+  if (it == cube_map_faces_.end()) return;
+  for (auto face = it->second.begin(); face != it->second.end(); ++face) {
+    // Deletes it right away, unless a loader thread is busy with it.
+    loader_.AbortJobAndDelete(*face);
+  }
+  cube_map_faces_.erase(it);
+}
+
+void AssetManager::TouchMaterial(Material *material) {
+  if (!material) return;
+  auto &textures = material->textures();
+  for (auto it = textures.begin(); it != textures.end(); ++it) {
+    if (*it) TouchTexture(*it);
+  }
+}
+
+void AssetManager::TouchMesh(Mesh *mesh) {
+  Touch(mesh, &mesh_residency_);
+  for (size_t i = 0; i < mesh->GetNumIndexBufferObjects(); ++i) {
+    TouchMaterial(mesh->GetMaterial(static_cast<int>(i)));
+  }
 }
 
 Shader *AssetManager::FindShader(const char *basename) {
   return FindInMap(shader_map_, basename);
 }
 
+Shader *AssetManager::FindShader(const AssetId &id) {
+  return shader_map_.Find(id);
+}
+
 Shader *AssetManager::LoadShaderHelper(
     const char *basename, const std::vector<std::string> &local_defines,
     const char *alias, bool async) {
@@ -102,15 +331,43 @@ Shader *AssetManager::LoadShader(const char *basename, bool async,
   return LoadShader(basename, empty_defines, async, alias);
 }
 
+Shader *AssetManager::LoadShader(const AssetId &id, bool async) {
+  auto shader = FindShader(id);
+  if (shader) {
+    shader->UpdateGlobalDefines(defines_to_add_, defines_to_omit_);
+    return shader;
+  }
+  return LoadShader(id.name(), async);
+}
+
 void AssetManager::ResetGlobalShaderDefines(
     const std::vector<std::string> &defines_to_add,
-    const std::vector<std::string> &defines_to_omit) {
+    const std::vector<std::string> &defines_to_omit, bool async) {
   defines_to_add_ = defines_to_add;
   defines_to_omit_ = defines_to_omit;
-  for (auto iter = shader_map_.begin(); iter != shader_map_.end(); ++iter) {
-    Shader *shader = iter->second;
-    shader->UpdateGlobalDefines(defines_to_add_, defines_to_omit_);
-  }
+  // The shaders reloaded below read their #included files again, so they
+  // pick up edits to those too.
+  ClearShaderIncludeCache();
+  shader_map_.ForEach([this, async](const std::string &, Shader *shader) {
+    // A loader thread may be preprocessing the shader with its old defines.
+    // Start that over with the new ones.
+    const bool loading = shader->load_job_ != nullptr;
+    if (loading) {
+      loader_.AbortJob(shader);
+      shader->ClearPendingLoad();
+    }
+    const bool affected =
+        shader->UpdateGlobalDefines(defines_to_add_, defines_to_omit_);
+    const bool reload = async && affected && shader->IsValid();
+    if (reload) {
+      // Keep rendering with the current program until Finalize() swaps in
+      // the new one.
+      shader->dirty_ = false;
+    }
+    if (loading || reload) {
+      loader_.QueueJob(shader, shader->load_priority());
+    }
+  });
 }
 
 void AssetManager::ForEachShaderWithDefine(const char *define,
@@ -118,12 +375,45 @@ void AssetManager::ForEachShaderWithDefine(const char *define,
   // Use a simple for loop to visit all shaders with 'define' specified, since
   // we only have limited shaders currently. TODO(yifengh): optimize this if
   // there is a growing number of shaders.
-  for (auto iter = shader_map_.begin(); iter != shader_map_.end(); ++iter) {
-    Shader *shader = iter->second;
+  shader_map_.ForEach([define, &func](const std::string &, Shader *shader) {
     if (ValidShaderHandle(shader->program()) && shader->HasDefine(define)) {
       func(shader);
     }
-  }
+  });
+}
+
+template <typename T>
+static void ForEachLoadStatsInMap(const AssetMap<T> &map, const char *type,
+                                  const AssetManager::LoadStatsFn &func) {
+  map.ForEach([type, &func](const std::string &name, T *asset) {
+    if (asset->IsFinalized()) func(type, name, asset->load_stats());
+  });
+}
+
+void AssetManager::ForEachLoadStats(const LoadStatsFn &func) const {
+  ForEachLoadStatsInMap(texture_map_, "texture", func);
+  ForEachLoadStatsInMap(mesh_map_, "mesh", func);
+  ForEachLoadStatsInMap(shader_map_, "shader", func);
+  ForEachLoadStatsInMap(file_map_, "file", func);
+}
+
+void AssetManager::DumpLoadStats(std::string *csv) const {
+  *csv += "type,name,queue_ms,load_ms,io_ms,decode_ms,wait_ms,finalize_ms,"
+          "file_bytes,decoded_bytes\n";
+  ForEachLoadStats([csv](const char *type, const std::string &name,
+                         const AssetLoadStats &stats) {
+    char times[96];
+    snprintf(times, sizeof(times), ",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,",
+             stats.queue_time * 1000.0, stats.load_time * 1000.0,
+             stats.io_time * 1000.0, stats.decode_time * 1000.0,
+             stats.wait_time * 1000.0, stats.finalize_time * 1000.0);
+    *csv += type;
+    *csv += ",";
+    *csv += name;
+    *csv += times;
+    *csv += flatbuffers::NumToString(stats.file_bytes) + "," +
+            flatbuffers::NumToString(stats.decoded_bytes) + "\n";
+  });
 }
 
 Shader *AssetManager::LoadShaderDef(const char *filename) {
@@ -131,89 +421,287 @@ Shader *AssetManager::LoadShaderDef(const char *filename) {
   if (shader) return shader;
   shader = Shader::LoadFromShaderDef(filename);
   if (!shader) return nullptr;
-  shader_map_[filename] = shader;
+  shader_map_.Insert(AssetId(filename), filename, shader);
   return shader;
 }
 
 void AssetManager::UnloadShader(const char *filename) {
   auto shader = FindShader(filename);
   if (!shader || shader->DecreaseRefCount()) return;
-  loader_.AbortJob(shader);
-  shader_map_.erase(filename);
-  delete shader;
+  shader_map_.Erase(AssetId(filename));
+  // Deletes it right away, unless a loader thread is busy with it.
+  loader_.AbortJobAndDelete(shader);
 }
 
 Texture *AssetManager::FindTexture(const char *filename) {
-  return FindInMap(texture_map_, filename);
+  auto tex = FindInMap(texture_map_, filename);
+  if (tex) TouchTexture(tex);
+  return tex;
+}
+
+Texture *AssetManager::FindTexture(const AssetId &id) {
+  auto tex = texture_map_.Find(id);
+  if (tex) TouchTexture(tex);
+  return tex;
 }
 
 Texture *AssetManager::LoadTexture(const char *filename, TextureFormat format,
-                                   TextureFlags flags) {
+                                   TextureFlags flags, int priority) {
   auto tex = FindTexture(filename);
-  if (tex) return tex;
-  tex = new Texture(filename, format, flags);
+  if (tex) {
+    RaisePriority(tex, priority);
+    return tex;
+  }
+  {
+    // A loader thread may have created it meanwhile, see PrefetchTexture().
+    fplutil::MutexLock lock(prefetch_mutex_);
+    RegisterPrefetchedTextures();
+    tex = FindInMap(texture_map_, filename);
+    if (!tex) {
+      tex = new Texture(filename, format, flags);
+      texture_index_[AssetId(filename).hash()] = tex;
+    }
+  }
+  if (tex->IsFinalized() || tex->load_job_) {
+    // Prefetched, so it is already loading.
+    RaisePriority(tex, priority);
+    return tex;
+  }
+  RecordLoad(RecordedLoad::kTexture, filename,
+             (flags & kTextureFlagsLoadAsync) != 0, priority, format, flags);
+  TrackResidency(tex, &texture_residency_);
   return LoadOrQueue(tex, texture_map_, (flags & kTextureFlagsLoadAsync) != 0,
-                     nullptr /* alias */);
+                     nullptr /* alias */, priority);
+}
+
+Texture *AssetManager::PrefetchTexture(const char *filename,
+                                       TextureFormat format, TextureFlags flags,
+                                       int priority, const vec2 &scale) {
+  fplutil::MutexLock lock(prefetch_mutex_);
+  const uint64_t hash = AssetId(filename).hash();
+  auto it = texture_index_.find(hash);
+  if (it != texture_index_.end()) return it->second;
+  auto tex = new Texture(filename, format, flags | kTextureFlagsLoadAsync);
+  tex->set_scale(scale);
+  TrackResidency(tex, &texture_residency_);
+  texture_index_[hash] = tex;
+  prefetched_.push_back(tex);
+  loader_.QueueJob(tex, priority);
+  return tex;
+}
+
+void AssetManager::RegisterPrefetchedTextures() {
+  for (auto it = prefetched_.begin(); it != prefetched_.end(); ++it) {
+    texture_map_.Insert(AssetId((*it)->filename()), (*it)->filename(), *it);
+  }
+  prefetched_.clear();
+}
+
+Texture *AssetManager::LoadTexture(const AssetId &id, TextureFormat format,
+                                   TextureFlags flags, int priority) {
+  auto tex = FindTexture(id);
+  if (tex) {
+    RaisePriority(tex, priority);
+    return tex;
+  }
+  return LoadTexture(id.name(), format, flags, priority);
+}
+
+Texture *AssetManager::LoadCubeMap(const char *name,
+                                   const char *const face_filenames[6],
+                                   TextureFormat format, TextureFlags flags,
+                                   int priority) {
+  auto tex = FindTexture(name);
+  if (tex) {
+    auto faces = cube_map_faces_.find(tex);
+    if (faces != cube_map_faces_.end()) {
+      for (auto it = faces->second.begin(); it != faces->second.end(); ++it) {
+        RaisePriority(*it, priority);
+      }
+    }
+    return tex;
+  }
+  tex = new Texture(name, format, flags | kTextureFlagsIsCubeMap);
+  {
+    fplutil::MutexLock lock(prefetch_mutex_);
+    texture_index_[AssetId(name).hash()] = tex;
+  }
+  texture_map_.Insert(AssetId(name), name, tex);
+  std::vector<TextureCubeMapFace *> &faces = cube_map_faces_[tex];
+  for (int face = 0; face < 6; ++face) {
+    faces.push_back(new TextureCubeMapFace(tex, face, face_filenames[face]));
+  }
+  if (flags & kTextureFlagsLoadAsync) {
+    for (auto it = faces.begin(); it != faces.end(); ++it) {
+      loader_.QueueJob(*it, priority);
+    }
+  } else {
+    for (auto it = faces.begin(); it != faces.end(); ++it) (*it)->LoadNow();
+    CollectCubeMapFaces();
+  }
+  return tex;
 }
 
 void AssetManager::StartLoadingTextures() { loader_.StartLoading(); }
 
 void AssetManager::StopLoadingTextures() { loader_.PauseLoading(); }
 
-bool AssetManager::TryFinalize() { return loader_.TryFinalize(); }
+bool AssetManager::TryFinalize() {
+  {
+    fplutil::MutexLock lock(prefetch_mutex_);
+    RegisterPrefetchedTextures();
+  }
+  const bool done = loader_.TryFinalize();
+  EnforceMemoryBudget();
+  StreamMips();
+  CollectCubeMapFaces();
+  return done;
+}
+
+bool AssetManager::TryFinalize(double budget_ms, int *num_pending) {
+  {
+    fplutil::MutexLock lock(prefetch_mutex_);
+    RegisterPrefetchedTextures();
+  }
+  const bool done = loader_.TryFinalize(budget_ms, num_pending);
+  EnforceMemoryBudget();
+  StreamMips();
+  CollectCubeMapFaces();
+  return done;
+}
 
 void AssetManager::UnloadTexture(const char *filename) {
-  auto tex = FindTexture(filename);
+  auto tex = FindInMap(texture_map_, filename);
   if (!tex || tex->DecreaseRefCount()) return;
-  loader_.AbortJob(tex);
-  texture_map_.erase(filename);
-  delete tex;
+  texture_map_.Erase(AssetId(filename));
+  {
+    fplutil::MutexLock lock(prefetch_mutex_);
+    texture_index_.erase(AssetId(filename).hash());
+  }
+  ForgetResidency(tex, &texture_residency_);
+  StopMipStreaming(tex);
+  StopCubeMapLoading(tex);
+  // Deletes it right away, unless a loader thread is busy with it.
+  loader_.AbortJobAndDelete(tex);
 }
 
 Material *AssetManager::FindMaterial(const char *filename) {
-  return FindInMap(material_map_, filename);
+  auto mat = FindInMap(material_map_, filename);
+  TouchMaterial(mat);
+  return mat;
+}
+
+Material *AssetManager::FindMaterial(const AssetId &id) {
+  auto mat = material_map_.Find(id);
+  TouchMaterial(mat);
+  return mat;
 }
 
 Material *AssetManager::LoadMaterial(const char *filename,
                                      bool async_resources) {
   auto mat = FindMaterial(filename);
   if (mat) return mat;
-  mat = Material::LoadFromMaterialDef(filename,
-    [&](const char *filename, TextureFormat format,
-        TextureFlags flags) -> Texture* {
-      auto tex = LoadTexture(filename, format, flags |
-        (async_resources ? kTextureFlagsLoadAsync : kTextureFlagsNone));
-      tex->set_scale(texture_scale_);
-      return tex;
-    });
-  if (!mat) return nullptr;
-  material_map_[filename] = mat;
+  RecordLoad(RecordedLoad::kMaterial, filename, async_resources,
+             kLoadPriorityNormal);
+  FileView file;
+  const matdef::Material *def = Material::LoadMaterialDef(filename, &file);
+  const std::string key = Material::ContentKey(def);
+  auto shared = def ? material_contents_.find(key) : material_contents_.end();
+  if (shared != material_contents_.end()) {
+    // Another file with the same contents, so share its material.
+    mat = shared->second;
+    mat->IncreaseRefCount();
+  } else {
+    mat = Material::LoadFromMaterialDef(def,
+      [&](const char *filename, TextureFormat format,
+          TextureFlags flags) -> Texture* {
+        auto tex = LoadTexture(filename, format, flags |
+          (async_resources ? kTextureFlagsLoadAsync : kTextureFlagsNone));
+        tex->set_scale(texture_scale_);
+        return tex;
+      });
+    if (!mat) {
+      RendererBase::Get()->set_last_error(std::string("Couldn\'t load: ") +
+                                          filename);
+      return nullptr;
+    }
+    mat->set_filename(filename);
+    material_contents_[key] = mat;
+  }
+  material_map_.Insert(AssetId(filename), filename, mat);
   return mat;
 }
 
+Material *AssetManager::LoadMaterial(const AssetId &id, bool async_resources) {
+  auto mat = FindMaterial(id);
+  if (mat) return mat;
+  return LoadMaterial(id.name(), async_resources);
+}
+
 void AssetManager::UnloadMaterial(const char *filename) {
-  auto mat = FindMaterial(filename);
-  if (!mat || mat->DecreaseRefCount()) return;
+  auto mat = FindInMap(material_map_, filename);
+  if (!mat) return;
+  if (mat->DecreaseRefCount()) {
+    // Forget a name it's only shared under. It stays under the name it was
+    // loaded with until the last reference goes, as without sharing.
+    if (mat->filename() != filename) material_map_.Erase(AssetId(filename));
+    return;
+  }
   mat->DeleteTextures();
-  material_map_.erase(filename);
+  material_map_.Erase(AssetId(filename));
+  material_map_.Erase(AssetId(mat->filename()));
+  for (auto it = material_contents_.begin(); it != material_contents_.end();
+       ++it) {
+    if (it->second == mat) {
+      material_contents_.erase(it);
+      break;
+    }
+  }
+  fplutil::MutexLock lock(prefetch_mutex_);
   for (auto it = mat->textures().begin(); it != mat->textures().end(); ++it) {
-    texture_map_.erase((*it)->filename());
+    texture_map_.Erase(AssetId((*it)->filename()));
+    texture_index_.erase(AssetId((*it)->filename()).hash());
+    ForgetResidency(*it, &texture_residency_);
+    StopMipStreaming(*it);
+    StopCubeMapLoading(*it);
   }
 }
 
+Material *AssetManager::LoadEmbeddedMaterial(
+    const matdef::Material *def, const TextureLoaderFn &load_texture_fn) {
+  const std::string key = Material::ContentKey(def);
+  auto it = embedded_materials_.find(key);
+  if (it != embedded_materials_.end()) return it->second;
+  auto mat = Material::LoadFromMaterialDef(def, load_texture_fn);
+  if (mat) embedded_materials_[key] = mat;
+  return mat;
+}
+
 Mesh *AssetManager::FindMesh(const char *filename) {
-  return FindInMap(mesh_map_, filename);
+  auto mesh = FindInMap(mesh_map_, filename);
+  if (mesh) TouchMesh(mesh);
+  return mesh;
+}
+
+Mesh *AssetManager::FindMesh(const AssetId &id) {
+  auto mesh = mesh_map_.Find(id);
+  if (mesh) TouchMesh(mesh);
+  return mesh;
 }
 
-Mesh *AssetManager::LoadMesh(const char *filename, bool async) {
+Mesh *AssetManager::LoadMesh(const char *filename, bool async, int priority) {
   auto mesh = FindMesh(filename);
-  if (mesh) return mesh;
+  if (mesh) {
+    RaisePriority(mesh, priority);
+    return mesh;
+  }
 
+  RecordLoad(RecordedLoad::kMesh, filename, async, priority);
   auto async_flags = (async ? kTextureFlagsLoadAsync : kTextureFlagsNone);
-  auto load_texture_fn = [this, async_flags](const char *filename,
-                                             TextureFormat format,
-                                             TextureFlags flags) -> Texture * {
-    auto tex = LoadTexture(filename, format, flags | async_flags);
+  auto load_texture_fn = [this, async_flags, priority](
+      const char *filename, TextureFormat format,
+      TextureFlags flags) -> Texture * {
+    auto tex = LoadTexture(filename, format, flags | async_flags, priority);
     tex->set_scale(texture_scale_);
     return tex;
   };
@@ -222,24 +710,52 @@ Mesh *AssetManager::LoadMesh(const char *filename, bool async) {
       new Mesh(filename, [this, async, load_texture_fn](const char *filename,
                                                  const matdef::Material *def) {
         if (def) {
-          return Material::LoadFromMaterialDef(def, load_texture_fn);
+          return LoadEmbeddedMaterial(def, load_texture_fn);
         } else {
           return LoadMaterial(filename, async);
         }
       });
-  return LoadOrQueue(mesh, mesh_map_, async, nullptr /* alias */);
+  mesh->set_map_file(map_mesh_files_);
+  if (async) {
+    // Start on the textures while the mesh itself is loading.
+    const vec2 scale = texture_scale_;
+    mesh->set_prefetch_texture_fn([this, priority, scale](
+        const char *filename, TextureFormat format, TextureFlags flags) {
+      return PrefetchTexture(filename, format, flags, priority, scale);
+    });
+  }
+  TrackResidency(mesh, &mesh_residency_);
+  return LoadOrQueue(mesh, mesh_map_, async, nullptr /* alias */, priority);
+}
+
+Mesh *AssetManager::LoadMesh(const AssetId &id, bool async, int priority) {
+  auto mesh = FindMesh(id);
+  if (mesh) {
+    RaisePriority(mesh, priority);
+    return mesh;
+  }
+  return LoadMesh(id.name(), async, priority);
 }
 
 void AssetManager::UnloadMesh(const char *filename) {
-  auto mesh = FindMesh(filename);
+  auto mesh = FindInMap(mesh_map_, filename);
   if (!mesh || mesh->DecreaseRefCount()) return;
-  loader_.AbortJob(mesh);
-  mesh_map_.erase(filename);
-  delete mesh;
+  mesh_map_.Erase(AssetId(filename));
+  ForgetResidency(mesh, &mesh_residency_);
+  // Deletes it right away, unless a loader thread is busy with it.
+  loader_.AbortJobAndDelete(mesh);
 }
 
 TextureAtlas *AssetManager::FindTextureAtlas(const char *filename) {
-  return FindInMap(texture_atlas_map_, filename);
+  auto atlas = FindInMap(texture_atlas_map_, filename);
+  if (atlas && atlas->atlas_texture()) TouchTexture(atlas->atlas_texture());
+  return atlas;
+}
+
+TextureAtlas *AssetManager::FindTextureAtlas(const AssetId &id) {
+  auto atlas = texture_atlas_map_.Find(id);
+  if (atlas && atlas->atlas_texture()) TouchTexture(atlas->atlas_texture());
+  return atlas;
 }
 
 TextureAtlas *AssetManager::LoadTextureAtlas(const char *filename,
@@ -252,14 +768,14 @@ TextureAtlas *AssetManager::LoadTextureAtlas(const char *filename,
       return LoadTexture(filename, format, flags);
     });
   if (!atlas) return nullptr;
-  texture_atlas_map_[filename] = atlas;
+  texture_atlas_map_.Insert(AssetId(filename), filename, atlas);
   return atlas;
 }
 
 void AssetManager::UnloadTextureAtlas(const char *filename) {
-  auto atlas = FindTextureAtlas(filename);
+  auto atlas = FindInMap(texture_atlas_map_, filename);
   if (!atlas || atlas->DecreaseRefCount()) return;
-  texture_atlas_map_.erase(filename);
+  texture_atlas_map_.Erase(AssetId(filename));
   delete atlas;
 }
 
@@ -267,12 +783,17 @@ FileAsset *AssetManager::FindFileAsset(const char *filename) {
   return FindInMap(file_map_, filename);
 }
 
-FileAsset *AssetManager::LoadFileAsset(const char *filename) {
+FileAsset *AssetManager::FindFileAsset(const AssetId &id) {
+  return file_map_.Find(id);
+}
+
+FileAsset *AssetManager::LoadFileAsset(const char *filename, bool map_file) {
   auto file = FindFileAsset(filename);
   if (file) return file;
   file = new FileAsset();
-  if (LoadFile(filename, &file->contents)) {
-    file_map_[filename] = file;
+  if (map_file ? file->LoadMapped(filename)
+               : LoadFile(filename, &file->contents)) {
+    file_map_.Insert(AssetId(filename), filename, file);
     return file;
   }
   delete file;
@@ -282,8 +803,70 @@ FileAsset *AssetManager::LoadFileAsset(const char *filename) {
 void AssetManager::UnloadFileAsset(const char *filename) {
   auto file = FindFileAsset(filename);
   if (!file || file->DecreaseRefCount()) return;
-  file_map_.erase(filename);
+  file_map_.Erase(AssetId(filename));
   delete file;
 }
 
+void AssetManager::StartRecordingLoads() {
+  recorded_loads_.clear();
+  recording_loads_ = true;
+}
+
+void AssetManager::RecordLoad(RecordedLoad::Type type, const char *name,
+                              bool async, int priority, TextureFormat format,
+                              TextureFlags flags) {
+  if (!recording_loads_) return;
+  const RecordedLoad load = {type, name, format, flags, priority, async};
+  recorded_loads_.push_back(load);
+}
+
+bool AssetManager::SaveLoadManifest(const char *filename) const {
+  flatbuffers::FlatBufferBuilder fbb;
+  std::vector<flatbuffers::Offset<manifestdef::Entry>> entries;
+  entries.reserve(recorded_loads_.size());
+  for (auto it = recorded_loads_.begin(); it != recorded_loads_.end(); ++it) {
+    static const manifestdef::AssetType kTypes[] = {
+        manifestdef::AssetType_Texture, manifestdef::AssetType_Material,
+        manifestdef::AssetType_Mesh};
+    entries.push_back(manifestdef::CreateEntry(
+        fbb, kTypes[it->type], fbb.CreateString(it->name), it->format,
+        static_cast<uint32_t>(it->flags), it->priority, it->async));
+  }
+  manifestdef::FinishManifestBuffer(
+      fbb, manifestdef::CreateManifest(fbb, fbb.CreateVector(entries)));
+  return SaveFile(filename, fbb.GetBufferPointer(), fbb.GetSize());
+}
+
+bool AssetManager::PrefetchManifest(const char *filename) {
+  FileView file;
+  if (!file.Load(filename)) return false;
+  flatbuffers::Verifier verifier(file.data(), file.size());
+  if (!manifestdef::VerifyManifestBuffer(verifier)) {
+    LogError(kError, "Invalid load manifest: %s", filename);
+    return false;
+  }
+  auto manifest = manifestdef::GetManifest(file.data());
+  if (!manifest->entries()) return true;
+  for (flatbuffers::uoffset_t i = 0; i < manifest->entries()->size(); i++) {
+    auto entry = manifest->entries()->Get(i);
+    const char *name = entry->name()->c_str();
+    switch (entry->type()) {
+      case manifestdef::AssetType_Texture: {
+        Texture *tex = LoadTexture(
+            name, static_cast<TextureFormat>(entry->format()),
+            static_cast<TextureFlags>(entry->flags()), entry->priority());
+        tex->set_scale(texture_scale_);
+        break;
+      }
+      case manifestdef::AssetType_Material:
+        LoadMaterial(name, entry->async());
+        break;
+      case manifestdef::AssetType_Mesh:
+        LoadMesh(name, entry->async(), entry->priority());
+        break;
+    }
+  }
+  return true;
+}
+
 }  // namespace fplbase
@@ -0,0 +1,226 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/async_loader.h"
+#include "fplbase/environment.h"
+#include "fplbase/internal/async_uploader.h"
+#include "fplbase/renderer.h"
+#include "fplbase/trace.h"
+#include "fplbase/utilities.h"
+
+namespace fplbase {
+
+bool AsyncAsset::LoadNow() {
+  load_stats_ = AssetLoadStats();
+  const double start = GetTimeInSeconds();
+  {
+    FPLBASE_TRACE_SCOPE("Load");
+    Load();
+  }
+  const double loaded = GetTimeInSeconds();
+  load_stats_.load_time = loaded - start;
+  load_dependencies_.clear();
+  bool ok = data_ != nullptr;
+  // Call this even if data_ is null, to enforce Finalize() checking for it.
+  finalize_start_ = loaded;
+  {
+    FPLBASE_TRACE_SCOPE("Finalize");
+    ok = Finalize() && ok;
+  }
+  RendererBase::RecordAssetFinalized();
+  return ok;
+}
+
+void AsyncAsset::CallFinalizeCallback() {
+  // The callbacks may delete this asset, so record the time first.
+  if (finalize_start_ >= 0.0) {
+    load_stats_.finalize_time = GetTimeInSeconds() - finalize_start_;
+    finalize_start_ = -1.0;
+  }
+  auto callbacks = finalize_callbacks_;
+  finalize_callbacks_.clear();
+  finalized_ = true;
+  for (auto it = callbacks.begin(); it != callbacks.end(); ++it) {
+    (*it)();
+  }
+}
+
+void AsyncLoader::set_num_worker_threads(int num_threads) {
+  num_worker_threads_ = num_threads > 0 ? num_threads
+                                        : DefaultNumWorkerThreads();
+}
+
+void AsyncLoader::InsertJob(AsyncLoadJob *job) {
+  // Walk back from the end, past all jobs of lower priority. Never move ahead
+  // of a nullptr, so jobs queued after StopLoadingWhenComplete() or
+  // PauseLoading() stay behind it.
+  auto it = queue_.end();
+  while (it != queue_.begin()) {
+    const AsyncLoadJob *prev = *(it - 1);
+    if (!prev || prev->priority >= job->priority) break;
+    --it;
+  }
+  queue_.insert(it, job);
+}
+
+void AsyncLoader::DetachJob(AsyncAsset *res) {
+  AsyncLoadJob *job = res->load_job_;
+  assert(job && job->state.load() != AsyncLoadJob::kLoading);
+  // The (now empty) job is deleted once it reaches the front of its queue.
+  job->asset = nullptr;
+  res->load_job_ = nullptr;
+  --num_pending_requests_;
+}
+
+void AsyncLoader::DeleteJobs() {
+  // Don't touch the assets here, they may already have been destroyed.
+  for (auto it = queue_.begin(); it != queue_.end(); ++it) delete *it;
+  queue_.clear();
+  while (AsyncLoadJob *job = PopDone()) {
+    AsyncUploader::ReleaseFence(job);
+    delete job;
+  }
+  for (auto it = waiting_.begin(); it != waiting_.end(); ++it) {
+    AsyncUploader::ReleaseFence(*it);
+    delete *it;
+  }
+  waiting_.clear();
+}
+
+AsyncLoadJob *AsyncLoader::PopDone() {
+  return static_cast<AsyncLoadJob *>(done_.Pop());
+}
+
+void AsyncLoader::LoadJob(AsyncLoadJob *job) {
+  AsyncAsset *res = job->asset;
+  const double start = GetTimeInSeconds();
+  res->load_stats_ = AssetLoadStats();
+  res->load_stats_.queue_time = start - job->queued_at;
+  {
+    FPLBASE_TRACE_SCOPE("Load");
+    res->Load();
+  }
+  job->loaded_at = GetTimeInSeconds();
+  res->load_stats_.load_time = job->loaded_at - start;
+  // The upload thread hands it on once it's uploaded. Until then the job stays
+  // kLoading, so AbortJob() waits for the upload too.
+  if (uploader_) {
+    uploader_->Push(job);
+    return;
+  }
+  FinishJob(job);
+}
+
+// static
+bool AsyncLoader::ReadyToFinalize(AsyncLoadJob *job) {
+  // Even an aborted asset's GPU objects may still be in use by the upload.
+  if (!AsyncUploader::UploadComplete(job)) return false;
+  AsyncAsset *res = job->asset;
+  if (!res || job->delete_when_loaded) return true;
+  return res->LoadDependenciesFinalized() && res->PrepareFinalize();
+}
+
+bool AsyncLoader::FinalizeJob(AsyncLoadJob *job, double end_time) {
+  AsyncAsset *res = job->asset;
+  const bool discard = job->delete_when_loaded;
+  const double loaded_at = job->loaded_at;
+  delete job;
+  // Skip jobs that were aborted after they finished loading.
+  if (!res) return true;
+  res->load_job_ = nullptr;
+  res->load_dependencies_.clear();
+  --num_pending_requests_;
+
+  if (discard) {
+    delete res;
+    return true;
+  }
+
+  const double start = GetTimeInSeconds();
+  res->load_stats_.wait_time = start - loaded_at;
+  // CallFinalizeCallback() records the finalize time.
+  res->finalize_start_ = start;
+  {
+    FPLBASE_TRACE_SCOPE("Finalize");
+    // A finalize callback may delete res, so don't touch it afterwards.
+    // Callers check IsValid() to know if a failed resource can be used.
+    res->Finalize();
+  }
+  RendererBase::RecordAssetFinalized();
+  return GetTimeInSeconds() < end_time;
+}
+
+bool AsyncLoader::StartUploadThread(Environment *environment) {
+  assert(worker_threads_.empty());
+  if (uploader_) return true;
+  uploader_ = new AsyncUploader(environment, this);
+  // Without fences, the upload thread waits for the GPU with glFinish().
+  const bool use_fences = environment->feature_level() >= kFeatureLevel30;
+  if (!uploader_->Start(use_fences)) {
+    delete uploader_;
+    uploader_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void AsyncLoader::StopUploadThread() {
+  if (!uploader_) return;
+  uploader_->Stop();
+  delete uploader_;
+  uploader_ = nullptr;
+}
+
+bool AsyncLoader::TryFinalize() {
+  return TryFinalize(std::numeric_limits<double>::infinity());
+}
+
+bool AsyncLoader::TryFinalize(double budget_ms, int *num_pending) {
+  FPLBASE_TRACE_SCOPE("TryFinalize");
+  const double end_time = GetTimeInSeconds() + budget_ms / 1000.0;
+  bool has_time = true;
+  // First the assets whose dependencies have since been finalized, or that
+  // have since finished preparing. The assets may have been aborted
+  // meanwhile, which clears job->asset.
+  for (size_t i = 0; i < waiting_.size() && has_time;) {
+    AsyncLoadJob *job = waiting_[i];
+    if (!ReadyToFinalize(job)) {
+      ++i;
+      continue;
+    }
+    waiting_.erase(waiting_.begin() + i);
+    has_time = FinalizeJob(job, end_time);
+  }
+  // Draining done_ doesn't need the lock: only this thread pops from it, and
+  // the workers no longer touch a job once they've pushed it.
+  while (has_time) {
+    AsyncLoadJob *job = PopDone();
+    if (!job) break;
+    if (!ReadyToFinalize(job)) {
+      // Park it until a later call, after its dependencies are finalized
+      // and it's done preparing.
+      waiting_.push_back(job);
+      continue;
+    }
+    // Leave the rest for the next call once the budget is spent.
+    has_time = FinalizeJob(job, end_time);
+  }
+  const int pending = num_pending_requests_;
+  FPLBASE_TRACE_COUNTER("AssetsPending", pending);
+  if (num_pending) *num_pending = pending;
+  return pending == 0;
+}
+
+}  // namespace fplbase
@@ -18,41 +18,39 @@
 
 namespace fplbase {
 
-// Push this to signal the worker thread that it's time to quit.
-class BookendAsyncResource : public AsyncAsset {
-  static const char *kBookendFileName;
-
- public:
-  BookendAsyncResource() : AsyncAsset(kBookendFileName) {}
-  virtual ~BookendAsyncResource() {}
-  virtual void Load() {}
-  virtual bool Finalize() { return true; }
-  virtual bool IsValid() { return true; }
-  static bool IsBookend(const AsyncAsset &res) {
-    return res.filename() == kBookendFileName;
-  }
-};
-
-// static
-const char *BookendAsyncResource::kBookendFileName = "bookend";
-
 AsyncLoader::AsyncLoader()
-    : loading_(nullptr), num_pending_requests_(0), worker_thread_(nullptr) {
+    : num_pending_requests_(0),
+      num_worker_threads_(DefaultNumWorkerThreads()),
+      uploader_(nullptr) {
   mutex_ = SDL_CreateMutex();
   job_semaphore_ = SDL_CreateSemaphore(0);
-  assert(mutex_ && job_semaphore_);
+  loaded_cv_ = SDL_CreateCond();
+  assert(mutex_ && job_semaphore_ && loaded_cv_);
 }
 
 AsyncLoader::~AsyncLoader() {
   Stop();
+  DeleteJobs();
+}
+
+// static
+int AsyncLoader::DefaultNumWorkerThreads() {
+  // Leave one core for the main / render thread.
+  return std::max(SDL_GetCPUCount() - 1, 1);
 }
 
 void AsyncLoader::Stop() {
-  if (worker_thread_) {
+  const bool had_workers = !worker_threads_.empty();
+  if (had_workers) {
     StopLoadingWhenComplete();
-    SDL_WaitThread(static_cast<SDL_Thread *>(worker_thread_), nullptr);
-    worker_thread_ = nullptr;
-
+    for (auto it = worker_threads_.begin(); it != worker_threads_.end(); ++it) {
+      SDL_WaitThread(static_cast<SDL_Thread *>(*it), nullptr);
+    }
+    worker_threads_.clear();
+  }
+  // Before the lock goes: the upload thread takes it to finish each job.
+  StopUploadThread();
+  if (had_workers) {
     if (mutex_) {
       SDL_DestroyMutex(static_cast<SDL_mutex *>(mutex_));
       mutex_ = nullptr;
@@ -61,61 +59,104 @@ void AsyncLoader::Stop() {
       SDL_DestroySemaphore(static_cast<SDL_semaphore *>(job_semaphore_));
       job_semaphore_ = nullptr;
     }
+    if (loaded_cv_) {
+      SDL_DestroyCond(static_cast<SDL_cond *>(loaded_cv_));
+      loaded_cv_ = nullptr;
+    }
   }
 }
 
-void AsyncLoader::QueueJob(AsyncAsset *res) {
-  Lock([this, res]() {
-    queue_.push_back(res);
+void AsyncLoader::QueueJob(AsyncAsset *res, int priority) {
+  Lock([this, res, priority]() {
+    assert(!res->load_job_);
+    res->load_priority_ = priority;
+    res->load_job_ = new AsyncLoadJob(res, priority);
+    res->load_job_->queued_at = GetTimeInSeconds();
+    InsertJob(res->load_job_);
     ++num_pending_requests_;
   });
   SDL_SemPost(static_cast<SDL_semaphore *>(job_semaphore_));
 }
 
-void AsyncLoader::AbortJob(AsyncAsset *res) {
-  const bool was_loading =
-      LockReturn<bool>([this, res]() { return loading_ == res; });
+bool AsyncLoader::Reprioritize(AsyncAsset *res, int priority) {
+  return LockReturn<bool>([this, res, priority]() {
+    res->load_priority_ = priority;
+    AsyncLoadJob *job = res->load_job_;
+    if (!job || job->state.load() != AsyncLoadJob::kQueued) return false;
+    queue_.erase(std::find(queue_.begin(), queue_.end(), job));
+    job->priority = priority;
+    InsertJob(job);
+    return true;
+  });
+}
 
-  if (was_loading) {
-    PauseLoading();
+void AsyncLoader::AbortJob(AsyncAsset *res) {
+  auto mutex = static_cast<SDL_mutex *>(mutex_);
+  SDL_LockMutex(mutex);
+  AsyncLoadJob *job = res->load_job_;
+  if (job) {
+    // Only wait for this job; the other workers carry on.
+    while (job->state.load() == AsyncLoadJob::kLoading) {
+      SDL_CondWait(static_cast<SDL_cond *>(loaded_cv_), mutex);
+    }
+    DetachJob(res);
   }
+  SDL_UnlockMutex(mutex);
+}
 
-  Lock([this, res]() {
-    auto iter = std::find(queue_.begin(), queue_.end(), res);
-    if (iter != queue_.end()) {
-      queue_.erase(iter);
-      --num_pending_requests_;
-    }
+void AsyncLoader::FinishJob(AsyncLoadJob *job) {
+  // Set under the lock, so AbortJob() can't check the state and then miss
+  // the signal.
+  Lock([job]() { job->state = AsyncLoadJob::kLoaded; });
+  SDL_CondBroadcast(static_cast<SDL_cond *>(loaded_cv_));
+  // Hand the job to the main thread, which pops it without the lock.
+  done_.Push(job);
+}
 
-    iter = std::find(done_.begin(), done_.end(), res);
-    if (iter != done_.end()) {
-      done_.erase(iter);
-      --num_pending_requests_;
+void AsyncLoader::AbortJobAndDelete(AsyncAsset *res) {
+  const bool deferred = LockReturn<bool>([this, res]() {
+    AsyncLoadJob *job = res->load_job_;
+    if (job && job->state.load() == AsyncLoadJob::kLoading) {
+      // TryFinalize() deletes it once it has loaded.
+      job->delete_when_loaded = true;
+      return true;
     }
+    if (job) DetachJob(res);
+    return false;
   });
-
-  if (was_loading) {
-    StartLoading();
-  }
+  if (!deferred) delete res;
 }
 
 void AsyncLoader::LoaderWorker() {
   for (;;) {
-    Lock([this]() { loading_ = queue_.empty() ? nullptr : queue_.front(); });
-    if (!loading_) {
+    // Take the job off the queue right away, so other workers can start on
+    // the next one while this one loads.
+    AsyncLoadJob *job = nullptr;
+    AsyncAsset *res = nullptr;
+    const bool has_job = LockReturn<bool>([this, &job, &res]() {
+      if (queue_.empty()) return false;
+      job = queue_.front();
+      queue_.pop_front();
+      if (job && job->asset) {
+        job->state = AsyncLoadJob::kLoading;
+        res = job->asset;
+      }
+      return true;
+    });
+    if (!has_job) {
       SDL_SemWait(static_cast<SDL_semaphore *>(job_semaphore_));
       continue;
     }
-    // Stop loading once we reach the bookend enqueued by
+    // Stop loading once we reach a nullptr enqueued by
     // StopLoadingWhenComplete(). To start loading again, call StartLoading().
-    if (BookendAsyncResource::IsBookend(*loading_)) break;
-    LogInfo(kApplication, "async load: %s", loading_->filename_.c_str());
-    loading_->Load();
-    Lock([this]() {
-      queue_.pop_front();
-      done_.push_back(loading_);
-      loading_ = nullptr;
-    });
+    if (!job) break;
+    if (!res) {
+      // Aborted while it was queued.
+      delete job;
+      continue;
+    }
+    LogInfo(kApplication, "async load: %s", res->filename_.c_str());
+    LoadJob(job);
   }
 }
 
@@ -125,39 +166,27 @@ int AsyncLoader::LoaderThread(void *user_data) {
 }
 
 void AsyncLoader::StartLoading() {
-  worker_thread_ =
-      SDL_CreateThread(AsyncLoader::LoaderThread, "FPL Loader Thread", this);
-  assert(worker_thread_);
+  if (!worker_threads_.empty()) return;
+  for (int i = 0; i < num_worker_threads_; ++i) {
+    Thread thread =
+        SDL_CreateThread(AsyncLoader::LoaderThread, "FPL Loader Thread", this);
+    assert(thread);
+    worker_threads_.push_back(thread);
+  }
 }
 
 void AsyncLoader::PauseLoading() { assert(false); }
 
 void AsyncLoader::StopLoadingWhenComplete() {
-  // When the loader thread hits the bookend, it will exit.
-  static BookendAsyncResource bookend;
-  QueueJob(&bookend);
-}
-
-bool AsyncLoader::TryFinalize() {
-  for (;;) {
-    auto res = LockReturn<AsyncAsset *>(
-        [this]() { return done_.empty() ? nullptr : done_.front(); });
-    if (!res) break;
-    bool ok = res->Finalize();
-    if (!ok) {
-      // Can't do much here, since res is already constructed. Caller has to
-      // check IsValid() to know if resource can be used.
-    }
-    Lock([this, res]() {
-      // It's possible that the resource was destroyed during its finalize
-      // callbacks, so ensure that it's still the first item in done_.
-      if (done_.size() > 0 && done_.front() == res) {
-        done_.pop_front();
-      }
-      --num_pending_requests_;
-    });
+  // When a loader thread hits a nullptr, it will exit, so queue one per
+  // thread. These are not jobs, so they don't count as pending requests.
+  const size_t num_threads = worker_threads_.size();
+  Lock([this, num_threads]() {
+    queue_.insert(queue_.end(), num_threads, nullptr);
+  });
+  for (size_t i = 0; i < num_threads; ++i) {
+    SDL_SemPost(static_cast<SDL_semaphore *>(job_semaphore_));
   }
-  return LockReturn<bool>([this]() { return num_pending_requests_ == 0; });
 }
 
 void AsyncLoader::Lock(const std::function<void()> &body) {
@@ -18,131 +18,156 @@
 
 namespace fplbase {
 
-AsyncLoader::AsyncLoader() : loading_(nullptr), num_pending_requests_(0) {
-}
+AsyncLoader::AsyncLoader()
+    : num_pending_requests_(0),
+      num_worker_threads_(DefaultNumWorkerThreads()),
+      uploader_(nullptr) {}
 
 AsyncLoader::~AsyncLoader() {
   {
     std::lock_guard<std::mutex> lock(mutex_);
+    // Let the workers exit without loading anything else.
+    for (auto it = queue_.begin(); it != queue_.end(); ++it) delete *it;
     queue_.clear();
   }
   Stop();
+  DeleteJobs();
+}
+
+// static
+int AsyncLoader::DefaultNumWorkerThreads() {
+  // Leave one core for the main / render thread.
+  const int num_cores = static_cast<int>(std::thread::hardware_concurrency());
+  return std::max(num_cores - 1, 1);
 }
 
 void AsyncLoader::Stop() {
-  if (worker_thread_.joinable()) {
+  if (!worker_threads_.empty()) {
     StopLoadingWhenComplete();
-    worker_thread_.join();
+    for (auto it = worker_threads_.begin(); it != worker_threads_.end(); ++it) {
+      it->join();
+    }
+    worker_threads_.clear();
   }
+  StopUploadThread();
 }
 
-void AsyncLoader::QueueJob(AsyncAsset *res) {
+void AsyncLoader::QueueJob(AsyncAsset *res, int priority) {
   {
     std::lock_guard<std::mutex> lock(mutex_);
-    queue_.push_back(res);
+    assert(!res->load_job_);
+    res->load_priority_ = priority;
+    res->load_job_ = new AsyncLoadJob(res, priority);
+    res->load_job_->queued_at = GetTimeInSeconds();
+    InsertJob(res->load_job_);
     ++num_pending_requests_;
   }
   job_cv_.notify_one();
 }
 
+bool AsyncLoader::Reprioritize(AsyncAsset *res, int priority) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  res->load_priority_ = priority;
+  AsyncLoadJob *job = res->load_job_;
+  if (!job || job->state.load() != AsyncLoadJob::kQueued) return false;
+  queue_.erase(std::find(queue_.begin(), queue_.end(), job));
+  job->priority = priority;
+  InsertJob(job);
+  return true;
+}
+
 void AsyncLoader::AbortJob(AsyncAsset *res) {
-  bool was_loading = false;
+  std::unique_lock<std::mutex> lock(mutex_);
+  AsyncLoadJob *job = res->load_job_;
+  if (!job) return;
+  // Only wait for this job; the other workers carry on.
+  loaded_cv_.wait(lock, [job]() {
+    return job->state.load() != AsyncLoadJob::kLoading;
+  });
+  DetachJob(res);
+}
+
+void AsyncLoader::FinishJob(AsyncLoadJob *job) {
+  // Set under the lock, so AbortJob() can't check the state and then miss
+  // the notification.
   {
     std::lock_guard<std::mutex> lock(mutex_);
-    was_loading = loading_ == res;
-  }
-
-  if (was_loading) {
-    PauseLoading();
+    job->state = AsyncLoadJob::kLoaded;
   }
+  loaded_cv_.notify_all();
+  // Hand the job to the main thread, which pops it without the lock.
+  done_.Push(job);
+}
 
+void AsyncLoader::AbortJobAndDelete(AsyncAsset *res) {
   {
     std::lock_guard<std::mutex> lock(mutex_);
-    auto iter = std::find(queue_.begin(), queue_.end(), res);
-    if (iter != queue_.end()) {
-      queue_.erase(iter);
-      --num_pending_requests_;
-    }
-
-    iter = std::find(done_.begin(), done_.end(), res);
-    if (iter != done_.end()) {
-      done_.erase(iter);
-      --num_pending_requests_;
+    AsyncLoadJob *job = res->load_job_;
+    if (job && job->state.load() == AsyncLoadJob::kLoading) {
+      // TryFinalize() deletes it once it has loaded.
+      job->delete_when_loaded = true;
+      return;
     }
+    if (job) DetachJob(res);
   }
-
-  if (was_loading) {
-    StartLoading();
-  }
+  delete res;
 }
 
 void AsyncLoader::StartLoading() {
-  if (!worker_thread_.joinable()) {
-    worker_thread_ = std::thread(AsyncLoader::LoaderThread, this);
+  if (worker_threads_.empty()) {
+    for (int i = 0; i < num_worker_threads_; ++i) {
+      worker_threads_.push_back(std::thread(AsyncLoader::LoaderThread, this));
+    }
   }
 }
 
 void AsyncLoader::PauseLoading() {
   {
+    // One nullptr per worker, so that every worker exits after its current job.
     std::lock_guard<std::mutex> lock(mutex_);
-    queue_.push_front(nullptr);
+    queue_.insert(queue_.begin(), worker_threads_.size(), nullptr);
   }
-  job_cv_.notify_one();
-  worker_thread_.join();
+  job_cv_.notify_all();
+  for (auto it = worker_threads_.begin(); it != worker_threads_.end(); ++it) {
+    it->join();
+  }
+  worker_threads_.clear();
 }
 
-void AsyncLoader::StopLoadingWhenComplete() { QueueJob(nullptr); }
-
-bool AsyncLoader::TryFinalize() {
-  for (;;) {
-    AsyncAsset *resource = nullptr;
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      if (done_.size() > 0) resource = done_[0];
-    }
-
-    if (!resource) break;
-    bool ok = resource->Finalize();
-    if (!ok) {
-      // Can't do much here, since res is already constructed. Caller has to
-      // check IsValid() to know if resource can be used.
-    }
-
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      // It's possible that the resource was destroyed during its finalize
-      // callbacks, so ensure that it's still the first item in done_.
-      if (done_.size() > 0 && done_.front() == resource) {
-        done_.pop_front();
-      }
-      --num_pending_requests_;
-    }
-  }
-  bool finished;
+void AsyncLoader::StopLoadingWhenComplete() {
+  // The nullptrs are not jobs, so they don't count as pending requests.
   {
-    std::unique_lock<std::mutex> lock(mutex_);
-    finished = num_pending_requests_ == 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.insert(queue_.end(), worker_threads_.size(), nullptr);
   }
-  return finished;
+  job_cv_.notify_all();
 }
 
 void AsyncLoader::LoaderWorker() {
   for (;;) {
+    AsyncLoadJob *job = nullptr;
+    AsyncAsset *res = nullptr;
     {
       std::unique_lock<std::mutex> lock(mutex_);
       job_cv_.wait(lock, [this]() { return queue_.size() > 0; });
-      loading_ = queue_.front();
+      job = queue_.front();
       queue_.pop_front();
+      if (job && job->asset) {
+        job->state = AsyncLoadJob::kLoading;
+        res = job->asset;
+      }
     }
 
-    if (!loading_) {
+    if (!job) {
       break;
     }
+    if (!res) {
+      // Aborted while it was queued.
+      delete job;
+      continue;
+    }
 
-    loading_->Load();
-    std::lock_guard<std::mutex> lock(mutex_);
-    done_.push_back(loading_);
-    loading_ = nullptr;
+    LoadJob(job);
   }
 }
 
@@ -0,0 +1,129 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/internal/async_uploader.h"
+
+#include "fplbase/async_loader.h"
+#include "fplbase/environment.h"
+#include "fplbase/glplatform.h"
+#include "fplbase/logging.h"
+#include "fplbase/renderer.h"
+#include "fplbase/trace.h"
+#include "fplbase/utilities.h"
+
+namespace fplbase {
+
+AsyncUploader::AsyncUploader(Environment *environment, AsyncLoader *loader)
+    : environment_(environment),
+      loader_(loader),
+      shared_context_(nullptr),
+      use_fences_(false) {}
+
+AsyncUploader::~AsyncUploader() { Stop(); }
+
+bool AsyncUploader::Start(bool use_fences) {
+  if (thread_.joinable()) return true;
+  shared_context_ = environment_->CreateSharedContext();
+  if (!shared_context_) {
+    LogInfo(kApplication, "async upload: no shared GL context available");
+    return false;
+  }
+  use_fences_ = use_fences;
+  thread_ = std::thread(&AsyncUploader::UploadWorker, this);
+  return true;
+}
+
+void AsyncUploader::Stop() {
+  if (!thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(nullptr);
+  }
+  job_cv_.notify_one();
+  thread_.join();
+  environment_->DestroySharedContext(shared_context_);
+  shared_context_ = nullptr;
+}
+
+void AsyncUploader::Push(AsyncLoadJob *job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(job);
+  }
+  job_cv_.notify_one();
+}
+
+void AsyncUploader::UploadWorker() {
+  if (!environment_->MakeSharedContextCurrent(shared_context_)) {
+    LogError(kApplication, "async upload: can't make shared context current");
+  }
+  RendererBase::set_shared_context_thread(true);
+  for (;;) {
+    AsyncLoadJob *job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_cv_.wait(lock, [this]() { return !queue_.empty(); });
+      job = queue_.front();
+      queue_.pop_front();
+    }
+    if (!job) break;
+    UploadJob(job);
+  }
+  RendererBase::set_shared_context_thread(false);
+  environment_->MakeSharedContextCurrent(nullptr);
+}
+
+void AsyncUploader::UploadJob(AsyncLoadJob *job) {
+  // The job is still kLoading, so the main thread doesn't touch the asset.
+  AsyncAsset *res = job->asset;
+  const double start = GetTimeInSeconds();
+  bool uploaded;
+  {
+    FPLBASE_TRACE_SCOPE("Upload");
+    uploaded = res->Upload();
+  }
+  if (uploaded) {
+    // The main context may only use the objects once the commands that made
+    // them have completed. Without fences, wait for that here instead.
+    if (use_fences_) {
+      job->upload_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      GL_CALL(glFlush());
+    } else {
+      GL_CALL(glFinish());
+    }
+  }
+  res->load_stats_.upload_time = GetTimeInSeconds() - start;
+  job->loaded_at = GetTimeInSeconds();
+  loader_->FinishJob(job);
+}
+
+// static
+bool AsyncUploader::UploadComplete(AsyncLoadJob *job) {
+  if (!job->upload_fence) return true;
+  const GLenum status = glClientWaitSync(
+      static_cast<GLsync>(job->upload_fence), 0, 0);
+  if (status == GL_TIMEOUT_EXPIRED) return false;
+  ReleaseFence(job);
+  return true;
+}
+
+// static
+void AsyncUploader::ReleaseFence(AsyncLoadJob *job) {
+  if (!job->upload_fence) return;
+  GL_CALL(glDeleteSync(static_cast<GLsync>(job->upload_fence)));
+  job->upload_fence = nullptr;
+}
+
+}  // namespace fplbase
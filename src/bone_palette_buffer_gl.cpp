@@ -0,0 +1,82 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "fplbase/bone_palette_buffer.h"
+#include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/renderer.h"
+
+namespace fplbase {
+
+const unsigned int BonePaletteBuffer::kBinding;
+
+static const size_t kVec4sPerTransform = 3;
+
+BonePaletteBuffer::BonePaletteBuffer()
+    : buffer_(InvalidBufferHandle()), capacity_(0), alignment_(1) {
+  GLint alignment = 0;
+  GL_CALL(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment));
+  const size_t vec4_size = sizeof(mathfu::vec4_packed);
+  alignment_ = std::max<size_t>((alignment + vec4_size - 1) / vec4_size, 1);
+}
+
+BonePaletteBuffer::~BonePaletteBuffer() {
+  if (ValidBufferHandle(buffer_)) {
+    auto buffer = GlBufferHandle(buffer_);
+    GL_CALL(glDeleteBuffers(1, &buffer));
+  }
+  RendererBase::TrackGpuMemory(kGpuMemoryMeshes, capacity_, 0);
+}
+
+void BonePaletteBuffer::Clear() { staging_.clear(); }
+
+size_t BonePaletteBuffer::Add(const mathfu::AffineTransform *transforms,
+                              size_t count) {
+  const size_t aligned =
+      (staging_.size() + alignment_ - 1) / alignment_ * alignment_;
+  staging_.resize(aligned);
+  staging_.reserve(aligned + count * kVec4sPerTransform);
+  for (size_t i = 0; i < count; ++i) {
+    for (int row = 0; row < 3; ++row) {
+      staging_.push_back(mathfu::vec4_packed(transforms[i].GetColumn(row)));
+    }
+  }
+  return aligned * sizeof(mathfu::vec4_packed);
+}
+
+void BonePaletteBuffer::Upload() {
+  if (staging_.empty()) return;
+  const size_t size = this->size();
+  if (!ValidBufferHandle(buffer_)) {
+    GLuint buffer = 0;
+    GL_CALL(glGenBuffers(1, &buffer));
+    buffer_ = BufferHandleFromGl(buffer);
+  }
+  GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, GlBufferHandle(buffer_)));
+  if (size > capacity_) {
+    // Grow geometrically, so a skeleton count that creeps up frame by frame
+    // doesn't reallocate every frame.
+    const size_t capacity = std::max(size, 2 * capacity_);
+    GL_CALL(glBufferData(GL_UNIFORM_BUFFER, capacity, nullptr,
+                         GL_DYNAMIC_DRAW));
+    RendererBase::TrackGpuMemory(kGpuMemoryMeshes, capacity_, capacity);
+    capacity_ = capacity;
+  }
+  GL_CALL(glBufferSubData(GL_UNIFORM_BUFFER, 0, size, &staging_[0]));
+  RendererBase::CountRenderWork(&RenderCounters::buffer_upload_bytes, size);
+  GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+}
+
+}  // namespace fplbase
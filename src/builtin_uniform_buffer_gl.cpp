@@ -0,0 +1,96 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "builtin_uniform_buffer_gl.h"
+
+#include "fplbase/glplatform.h"
+#include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/renderer.h"
+#include "fplbase/shader.h"
+
+namespace fplbase {
+
+BuiltinUniformBuffer::BuiltinUniformBuffer()
+    : stream_(GL_UNIFORM_BUFFER),
+      fallback_(InvalidBufferHandle()),
+      alignment_(0),
+      valid_(false) {
+  memset(&last_, 0, sizeof(last_));
+}
+
+void BuiltinUniformBuffer::Update(const mathfu::mat4 &model_view_projection,
+                                  const mathfu::mat4 &model,
+                                  const mathfu::vec4 &color,
+                                  const mathfu::vec3 &light_pos,
+                                  const mathfu::vec3 &camera_pos, float time) {
+  Blocks blocks;
+  memset(&blocks, 0, sizeof(blocks));
+  for (int i = 0; i < 3; ++i) {
+    blocks.frame.camera_pos[i] = camera_pos[i];
+    blocks.frame.light_pos[i] = light_pos[i];
+  }
+  blocks.frame.time = time;
+  for (int i = 0; i < 16; ++i) {
+    blocks.object.model_view_projection[i] = model_view_projection[i];
+    blocks.object.model[i] = model[i];
+  }
+  for (int i = 0; i < 4; ++i) blocks.object.color[i] = color[i];
+  if (valid_ && memcmp(&blocks, &last_, sizeof(blocks)) == 0) return;
+  last_ = blocks;
+  valid_ = true;
+
+  if (alignment_ == 0) {
+    GLint alignment = 0;
+    GL_CALL(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment));
+    alignment_ = std::max<size_t>(alignment, 16);
+    const size_t object_offset =
+        (sizeof(FrameBlock) + alignment_ - 1) / alignment_ * alignment_;
+    staging_.assign(object_offset + sizeof(ObjectBlock), 0);
+  }
+  // Both blocks are written every time, so that they're always in the same
+  // buffer storage, even when the stream orphans it.
+  const size_t object_offset = staging_.size() - sizeof(ObjectBlock);
+  memcpy(&staging_[0], &blocks.frame, sizeof(FrameBlock));
+  memcpy(&staging_[object_offset], &blocks.object, sizeof(ObjectBlock));
+
+  size_t offset = 0;
+  if (stream_.Write(&staging_[0], staging_.size(), alignment_, &offset)) {
+    Bind(stream_.buffer(), offset);
+  } else {
+    GLuint buffer = GlBufferHandle(fallback_);
+    if (!buffer) {
+      GL_CALL(glGenBuffers(1, &buffer));
+      fallback_ = BufferHandleFromGl(buffer);
+    }
+    GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, buffer));
+    GL_CALL(glBufferData(GL_UNIFORM_BUFFER, staging_.size(), &staging_[0],
+                         GL_STREAM_DRAW));
+    RendererBase::CountRenderWork(&RenderCounters::buffer_upload_bytes,
+                                  staging_.size());
+    Bind(fallback_, 0);
+  }
+  GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+}
+
+void BuiltinUniformBuffer::Bind(BufferHandle buffer, size_t offset) {
+  const GLuint buffer_gl = GlBufferHandle(buffer);
+  GL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, Shader::kFrameUniformsBinding,
+                            buffer_gl, offset, sizeof(FrameBlock)));
+  GL_CALL(glBindBufferRange(
+      GL_UNIFORM_BUFFER, Shader::kObjectUniformsBinding, buffer_gl,
+      offset + staging_.size() - sizeof(ObjectBlock), sizeof(ObjectBlock)));
+}
+
+}  // namespace fplbase
@@ -0,0 +1,82 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_BUILTIN_UNIFORM_BUFFER_GL_H
+#define FPLBASE_BUILTIN_UNIFORM_BUFFER_GL_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "fplbase/handles.h"
+#include "mathfu/glsl_mappings.h"
+#include "streaming_buffer_gl.h"
+
+namespace fplbase {
+
+/// @brief The `FrameUniforms` and `ObjectUniforms` uniform blocks, for
+/// shaders that read the built-in uniforms from a uniform buffer on ES3 /
+/// GL3. See shaders/fplbase/builtin_uniform_blocks.glsl_h for the layout.
+///
+/// Both blocks are written together to a StreamingBuffer, and bound to
+/// Shader::kFrameUniformsBinding and Shader::kObjectUniformsBinding, only
+/// when a value changes. Setting another shader that uses the blocks costs no
+/// uniform calls; it reads the ranges already bound.
+class BuiltinUniformBuffer {
+ public:
+  BuiltinUniformBuffer();
+
+  /// @brief Make the bound blocks hold these values, writing and binding new
+  /// ranges if any changed since the last call.
+  void Update(const mathfu::mat4 &model_view_projection,
+              const mathfu::mat4 &model, const mathfu::vec4 &color,
+              const mathfu::vec3 &light_pos, const mathfu::vec3 &camera_pos,
+              float time);
+
+  /// @brief Forget what's bound, so the next Update() writes and binds.
+  void Invalidate() { valid_ = false; }
+
+ private:
+  // std140 layouts. A float packs after a vec3, so `time` fills its padding.
+  struct FrameBlock {
+    float camera_pos[3];
+    float time;
+    float light_pos[3];
+    float padding;
+  };
+  struct ObjectBlock {
+    float model_view_projection[16];
+    float model[16];
+    float color[4];
+  };
+  struct Blocks {
+    FrameBlock frame;
+    ObjectBlock object;
+  };
+
+  void Bind(BufferHandle buffer, size_t offset);
+
+  StreamingBuffer stream_;
+  // Used instead when the stream can't be mapped.
+  BufferHandle fallback_;
+  // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, or 0 before the first Update().
+  size_t alignment_;
+  // The frame block, padded to alignment_, then the object block.
+  std::vector<unsigned char> staging_;
+  Blocks last_;
+  bool valid_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_BUILTIN_UNIFORM_BUFFER_GL_H
@@ -0,0 +1,304 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/command_list.h"
+
+#include <memory>
+
+#include "fplbase/material.h"
+#include "fplbase/mesh.h"
+#include "fplbase/render_target.h"
+#include "fplbase/renderer.h"
+#include "fplbase/shader.h"
+#include "fplbase/skinning.h"
+
+using mathfu::AffineTransform;
+using mathfu::mat4;
+using mathfu::vec3;
+using mathfu::vec4;
+using mathfu::vec4_packed;
+
+namespace fplbase {
+
+// Reads back what CommandList::Append() wrote. Values are copied out, since
+// they're packed at byte offsets.
+template <typename T>
+static T ReadValue(const uint8_t **data) {
+  T value;
+  memcpy(&value, *data, sizeof(value));
+  *data += sizeof(value);
+  return value;
+}
+
+static mat4 ReadMatrix(const uint8_t **data) {
+  const vec4_packed c0 = ReadValue<vec4_packed>(data);
+  const vec4_packed c1 = ReadValue<vec4_packed>(data);
+  const vec4_packed c2 = ReadValue<vec4_packed>(data);
+  const vec4_packed c3 = ReadValue<vec4_packed>(data);
+  return mat4(vec4(c0), vec4(c1), vec4(c2), vec4(c3));
+}
+
+void CommandList::AppendMatrix(const mat4 &matrix) {
+  vec4_packed columns[4];
+  matrix.Pack(columns);
+  Append(columns, sizeof(columns));
+}
+
+void CommandList::SetRenderState(const RenderState &render_state) {
+  Begin(kSetRenderState);
+  Append(render_state);
+}
+
+void CommandList::SetRenderTarget(const RenderTarget *target) {
+  assert(target);
+  Begin(kSetRenderTarget);
+  Append(target);
+}
+
+void CommandList::SetModelViewProjection(const mat4 &model_view_projection) {
+  Begin(kSetModelViewProjection);
+  AppendMatrix(model_view_projection);
+}
+
+void CommandList::SetModel(const mat4 &model) {
+  Begin(kSetModel);
+  AppendMatrix(model);
+}
+
+void CommandList::ClearFrameBuffer(const vec4 &color) {
+  Begin(kClearFrameBuffer);
+  Append(vec4_packed(color));
+}
+
+void CommandList::ClearDepthBuffer() { Begin(kClearDepthBuffer); }
+
+void CommandList::SetColor(const vec4 &color) {
+  Begin(kSetColor);
+  Append(vec4_packed(color));
+}
+
+void CommandList::SetLightPos(const vec3 &light_pos) {
+  Begin(kSetLightPos);
+  Append(mathfu::vec3_packed(light_pos));
+}
+
+void CommandList::SetCameraPos(const vec3 &camera_pos) {
+  Begin(kSetCameraPos);
+  Append(mathfu::vec3_packed(camera_pos));
+}
+
+void CommandList::SetBoneTransforms(const AffineTransform *bone_transforms,
+                                    int num_bones) {
+  assert(num_bones >= 0 && (bone_transforms || num_bones == 0));
+  Begin(kSetBoneTransforms);
+  Append(num_bones);
+  Append(bone_transforms, num_bones * sizeof(AffineTransform));
+  num_bone_transforms_ += num_bones;
+}
+
+void CommandList::SetBoneDualQuaternions(
+    const vec4_packed *bone_dual_quaternions, int num_bones) {
+  assert(num_bones >= 0 && (bone_dual_quaternions || num_bones == 0));
+  const size_t count = num_bones * kNumVec4sInDualQuaternion;
+  Begin(kSetBoneDualQuaternions);
+  Append(num_bones);
+  Append(bone_dual_quaternions, count * sizeof(vec4_packed));
+  num_bone_dual_quaternions_ += count;
+}
+
+void CommandList::SetShader(const Shader *shader) {
+  assert(shader);
+  Begin(kSetShader);
+  Append(shader);
+}
+
+void CommandList::SetUniform(Shader *shader, UniformHandle uniform,
+                             const float *value, size_t num_components) {
+  assert(shader);
+  Begin(kSetUniform);
+  Append(shader);
+  Append(uniform);
+  Append(num_components);
+  Append(value, num_components * sizeof(float));
+}
+
+void CommandList::SetMaterial(Material *material) {
+  assert(material);
+  Begin(kSetMaterial);
+  Append(material);
+}
+
+void CommandList::Render(Mesh *mesh, bool ignore_material, size_t instances,
+                         size_t lod) {
+  assert(mesh);
+  Begin(kRender);
+  Append(mesh);
+  Append(ignore_material);
+  Append(instances);
+  Append(lod);
+}
+
+void CommandList::RenderSubMesh(Mesh *mesh, size_t submesh,
+                                bool ignore_material, size_t instances,
+                                size_t lod) {
+  assert(mesh);
+  Begin(kRenderSubMesh);
+  Append(mesh);
+  Append(submesh);
+  Append(ignore_material);
+  Append(instances);
+  Append(lod);
+}
+
+void CommandList::Replay(Renderer &renderer) const {
+  // The renderer keeps pointers to bone arrays until they're replaced, so
+  // each one is unpacked to its own place in arrays that last the replay.
+  std::unique_ptr<AffineTransform[]> bone_transforms(
+      num_bone_transforms_ ? new AffineTransform[num_bone_transforms_]
+                           : nullptr);
+  std::vector<vec4_packed> bone_dual_quaternions(num_bone_dual_quaternions_);
+  size_t bone_transforms_used = 0;
+  size_t bone_dual_quaternions_used = 0;
+
+  const uint8_t *data = commands_.data();
+  const uint8_t *const end = data + commands_.size();
+  while (data < end) {
+    const Command command = static_cast<Command>(ReadValue<uint8_t>(&data));
+    switch (command) {
+      case kSetRenderState:
+        renderer.SetRenderState(ReadValue<RenderState>(&data));
+        break;
+
+      case kSetRenderTarget: {
+        const RenderTarget *target = ReadValue<const RenderTarget *>(&data);
+        target->SetAsRenderTarget();
+        // SetAsRenderTarget() sets the viewport behind the renderer's back.
+        RenderState cached = renderer.GetRenderState();
+        cached.viewport = Viewport(mathfu::kZeros2i, target->dimensions());
+        renderer.UpdateCachedRenderState(cached);
+        break;
+      }
+
+      case kClearFrameBuffer:
+        renderer.ClearFrameBuffer(vec4(ReadValue<vec4_packed>(&data)));
+        break;
+
+      case kClearDepthBuffer:
+        renderer.ClearDepthBuffer();
+        break;
+
+      case kSetModelViewProjection:
+        renderer.set_model_view_projection(ReadMatrix(&data));
+        break;
+
+      case kSetModel:
+        renderer.set_model(ReadMatrix(&data));
+        break;
+
+      case kSetColor:
+        renderer.set_color(vec4(ReadValue<vec4_packed>(&data)));
+        break;
+
+      case kSetLightPos:
+        renderer.set_light_pos(vec3(ReadValue<mathfu::vec3_packed>(&data)));
+        break;
+
+      case kSetCameraPos:
+        renderer.set_camera_pos(vec3(ReadValue<mathfu::vec3_packed>(&data)));
+        break;
+
+      case kSetBoneTransforms: {
+        const int num_bones = ReadValue<int>(&data);
+        AffineTransform *transforms =
+            bone_transforms.get() + bone_transforms_used;
+        memcpy(transforms, data, num_bones * sizeof(AffineTransform));
+        data += num_bones * sizeof(AffineTransform);
+        bone_transforms_used += num_bones;
+        renderer.SetBoneTransforms(num_bones ? transforms : nullptr,
+                                   num_bones);
+        break;
+      }
+
+      case kSetBoneDualQuaternions: {
+        const int num_bones = ReadValue<int>(&data);
+        const size_t count = num_bones * kNumVec4sInDualQuaternion;
+        vec4_packed *dual_quaternions =
+            bone_dual_quaternions.data() + bone_dual_quaternions_used;
+        memcpy(dual_quaternions, data, count * sizeof(vec4_packed));
+        data += count * sizeof(vec4_packed);
+        bone_dual_quaternions_used += count;
+        renderer.SetBoneDualQuaternions(num_bones ? dual_quaternions : nullptr,
+                                        num_bones);
+        break;
+      }
+
+      case kSetShader:
+        renderer.SetShader(ReadValue<const Shader *>(&data));
+        break;
+
+      case kSetUniform: {
+        Shader *shader = ReadValue<Shader *>(&data);
+        const UniformHandle uniform = ReadValue<UniformHandle>(&data);
+        const size_t num_components = ReadValue<size_t>(&data);
+        float value[16];
+        assert(num_components <= 16);
+        memcpy(value, data, num_components * sizeof(float));
+        data += num_components * sizeof(float);
+        shader->SetUniform(uniform, value, num_components);
+        break;
+      }
+
+      case kSetMaterial:
+        ReadValue<Material *>(&data)->Set(renderer);
+        break;
+
+      case kRender: {
+        Mesh *mesh = ReadValue<Mesh *>(&data);
+        const bool ignore_material = ReadValue<bool>(&data);
+        const size_t instances = ReadValue<size_t>(&data);
+        const size_t lod = ReadValue<size_t>(&data);
+        renderer.Render(mesh, ignore_material, instances, lod);
+        break;
+      }
+
+      case kRenderSubMesh: {
+        Mesh *mesh = ReadValue<Mesh *>(&data);
+        const size_t submesh = ReadValue<size_t>(&data);
+        const bool ignore_material = ReadValue<bool>(&data);
+        const size_t instances = ReadValue<size_t>(&data);
+        const size_t lod = ReadValue<size_t>(&data);
+        renderer.RenderSubMesh(mesh, submesh, ignore_material, instances, lod);
+        break;
+      }
+
+      default:
+        assert(false);
+        return;
+    }
+  }
+  assert(data == end);
+
+  // Don't leave the renderer pointing at the arrays freed on return.
+  if (num_bone_transforms_) renderer.SetBoneTransforms(nullptr, 0);
+  if (num_bone_dual_quaternions_) renderer.SetBoneDualQuaternions(nullptr, 0);
+}
+
+void CommandList::Clear() {
+  commands_.clear();
+  num_bone_transforms_ = 0;
+  num_bone_dual_quaternions_ = 0;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,76 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "fplbase/culling.h"
+#include "fplbase/mesh.h"
+
+using mathfu::mat4;
+using mathfu::vec4;
+
+namespace fplbase {
+
+Frustum::Frustum(const mat4 &model_view_projection) {
+  // A point is visible when -w <= x, y, z <= w in clip space (Gribb and
+  // Hartmann, "Fast Extraction of Viewing Frustum Planes from the
+  // World-View-Projection Matrix").
+  const mat4 rows = model_view_projection.Transpose();
+  const vec4 x = rows.GetColumn(0);
+  const vec4 y = rows.GetColumn(1);
+  const vec4 z = rows.GetColumn(2);
+  const vec4 w = rows.GetColumn(3);
+  planes_[0] = w + x;
+  planes_[1] = w - x;
+  planes_[2] = w + y;
+  planes_[3] = w - y;
+  planes_[4] = w + z;
+  planes_[5] = w - z;
+  for (int i = 0; i < kNumPlanes; ++i) {
+    abs_planes_[i] = vec4::Max(planes_[i], -planes_[i]);
+  }
+}
+
+size_t CullSubmeshes(const mat4 &view_projection,
+                     const CullInstance *instances, size_t num_instances,
+                     std::vector<VisibleSubmesh> *visible) {
+  visible->clear();
+  for (size_t i = 0; i < num_instances; ++i) {
+    const Mesh *mesh = instances[i].mesh;
+    if (mesh == nullptr || mesh->num_vertices() == 0) continue;
+
+    const Frustum frustum(view_projection * *instances[i].world_transform);
+    if (!frustum.IntersectsBox(mesh->min_position(), mesh->max_position())) {
+      continue;
+    }
+
+    // Meshes without index buffers are drawn as submesh 0.
+    const size_t num_submeshes =
+        std::max<size_t>(mesh->GetNumIndexBufferObjects(), 1);
+    for (size_t j = 0; j < num_submeshes; ++j) {
+      if (num_submeshes > 1 &&
+          !frustum.IntersectsBox(mesh->submesh_min_position(j),
+                                 mesh->submesh_max_position(j))) {
+        continue;
+      }
+      VisibleSubmesh submesh;
+      submesh.instance = i;
+      submesh.submesh = j;
+      visible->push_back(submesh);
+    }
+  }
+  return visible->size();
+}
+
+}  // namespace fplbase
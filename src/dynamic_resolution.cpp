@@ -0,0 +1,166 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/dynamic_resolution.h"
+
+#include <math.h>
+
+#include "fplbase/renderer.h"
+
+namespace fplbase {
+
+const double DynamicResolution::kThermalPollInterval = 1.0;
+
+// Lower the scale once the smoothed load is over budget, and raise it again
+// once there's this much room to spare. The gap between them keeps the scale
+// from flipping back and forth.
+static const double kMaxLoad = 1.0;
+static const double kMinLoad = 0.75;
+// The load to aim for when changing scale.
+static const double kTargetLoad = 0.9;
+// How fast the smoothed load follows the measurements: quickly when frames
+// get slower, so a spike is caught within a few frames, slowly when they get
+// faster, so the scale isn't raised on one quick frame.
+static const double kLoadRiseRate = 0.25;
+static const double kLoadFallRate = 0.05;
+// The most the scale changes by per Update().
+static const float kMaxScaleDown = 0.05f;
+static const float kMaxScaleUp = 0.02f;
+// ScaledSize() rounds to blocks of this many pixels.
+static const int kSizeGranularity = 8;
+
+DynamicResolution::DynamicResolution()
+    : target_frame_time_(1.0 / 60.0),
+      min_scale_(0.5f),
+      max_scale_(1.0f),
+      scale_(1.0f),
+      load_(0.0),
+      poll_thermal_status_(true),
+      thermal_status_(kThermalStatusNone),
+      next_thermal_poll_(0.0),
+      texture_format_(kRenderTargetTextureFormatRGBA8),
+      depth_stencil_format_(kDepthStencilFormatDepth24Stencil8),
+      render_size_(mathfu::kZeros2i) {}
+
+DynamicResolution::~DynamicResolution() { target_.Delete(); }
+
+void DynamicResolution::set_scale_range(float min_scale, float max_scale) {
+  assert(0.0f < min_scale && min_scale <= max_scale);
+  min_scale_ = min_scale;
+  max_scale_ = max_scale;
+  scale_ = mathfu::Clamp(scale_, min_scale_, scale_cap());
+}
+
+float DynamicResolution::scale_cap() const {
+  // How much of the range between min_scale_ and max_scale_ is allowed.
+  float fraction;
+  switch (thermal_status_) {
+    case kThermalStatusNone:
+    case kThermalStatusLight:
+      fraction = 1.0f;
+      break;
+    case kThermalStatusModerate:
+      fraction = 0.66f;
+      break;
+    case kThermalStatusSevere:
+      fraction = 0.33f;
+      break;
+    default:
+      fraction = 0.0f;
+      break;
+  }
+  return min_scale_ + (max_scale_ - min_scale_) * fraction;
+}
+
+void DynamicResolution::Update(double gpu_time, double now) {
+  if (poll_thermal_status_ && now >= next_thermal_poll_) {
+    thermal_status_ = GetThermalStatus();
+    next_thermal_poll_ = now + kThermalPollInterval;
+  }
+
+  if (gpu_time > 0.0 && target_frame_time_ > 0.0) {
+    const double load = gpu_time / target_frame_time_;
+    if (load_ <= 0.0) {
+      load_ = load;
+    } else {
+      load_ += (load - load_) * (load > load_ ? kLoadRiseRate : kLoadFallRate);
+    }
+  }
+
+  float scale = scale_;
+  if (load_ > kMaxLoad || (load_ > 0.0 && load_ < kMinLoad)) {
+    // GPU time goes with the number of pixels, the square of the scale.
+    const float ideal =
+        scale_ * static_cast<float>(sqrt(kTargetLoad / load_));
+    scale = mathfu::Clamp(ideal, scale_ - kMaxScaleDown, scale_ + kMaxScaleUp);
+  }
+  scale = mathfu::Clamp(scale, min_scale_, scale_cap());
+  if (scale != scale_ && load_ > 0.0) {
+    // Assume the change has the expected effect, rather than change the scale
+    // again on the frames measured before it took effect.
+    const double ratio = scale / scale_;
+    load_ *= ratio * ratio;
+  }
+  scale_ = scale;
+}
+
+// static
+mathfu::vec2i DynamicResolution::ScaledSize(const mathfu::vec2i &screen_size,
+                                            float scale) {
+  if (scale >= 1.0f) return screen_size;
+  mathfu::vec2i size;
+  for (int i = 0; i < 2; ++i) {
+    const int blocks = static_cast<int>(
+        floorf(screen_size[i] * scale / kSizeGranularity + 0.5f));
+    size[i] = std::min(screen_size[i],
+                       std::max(blocks, 1) * kSizeGranularity);
+  }
+  return size;
+}
+
+void DynamicResolution::BeginScene(Renderer &renderer) {
+  const mathfu::vec2i screen_size = renderer.GetViewportSize();
+  if (renderer.feature_level() < kFeatureLevel30) {
+    // No glBlitFramebuffer() to upscale with.
+    scale_ = 1.0f;
+    render_size_ = screen_size;
+    return;
+  }
+  if (!target_.initialized() || target_.dimensions() != screen_size) {
+    target_.Delete();
+    target_.Initialize(screen_size, texture_format_, depth_stencil_format_);
+  }
+  target_.SetAsRenderTarget();
+  // The scene overwrites everything it shows, so don't load the old
+  // contents.
+  target_.Invalidate(true, true);
+  // SetAsRenderTarget() sets the viewport behind the renderer's back.
+  RenderState cached = renderer.GetRenderState();
+  cached.viewport = Viewport(mathfu::kZeros2i, screen_size);
+  renderer.UpdateCachedRenderState(cached);
+  render_size_ = ScaledSize(screen_size, scale_);
+  renderer.SetViewport(Viewport(mathfu::kZeros2i, render_size_));
+}
+
+void DynamicResolution::EndScene(Renderer &renderer) {
+  if (!render_target()) return;
+  target_.Invalidate(false, true);
+  const RenderTarget screen = RenderTarget::ScreenRenderTarget(renderer);
+  target_.BlitTo(screen, Viewport(mathfu::kZeros2i, render_size_),
+                 Viewport(mathfu::kZeros2i, screen.dimensions()));
+  renderer.SetViewport(Viewport(mathfu::kZeros2i, screen.dimensions()));
+}
+
+}  // namespace fplbase
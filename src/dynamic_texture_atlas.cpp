@@ -0,0 +1,129 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/texture.h"
+#include "fplbase/texture_atlas.h"
+
+using mathfu::vec2;
+using mathfu::vec2i;
+
+namespace fplbase {
+
+DynamicTextureAtlas::DynamicTextureAtlas(const vec2i &size,
+                                         TextureFormat format,
+                                         TextureFlags flags, int padding)
+    : size_(size), format_(format), padding_(padding) {
+  Texture *texture = new Texture(
+      nullptr, format,
+      static_cast<TextureFlags>(flags & ~kTextureFlagsUseMipMaps));
+  // Start out cleared, so filtering at the edges of subtextures doesn't pick
+  // up garbage.
+  const std::vector<uint8_t> cleared(
+      static_cast<size_t>(size.x) * size.y * Texture::BytesPerPixel(format),
+      0);
+  texture->LoadFromMemory(cleared.data(), size, format);
+  set_atlas_texture(texture);
+  Clear();
+}
+
+DynamicTextureAtlas::~DynamicTextureAtlas() {
+  Texture *texture = atlas_texture();
+  Delete();
+  delete texture;
+}
+
+void DynamicTextureAtlas::Clear() {
+  ClearSubtextures();
+  const SkylineSegment floor = {0, 0, size_.x};
+  skyline_.assign(1, floor);
+}
+
+const vec4 *DynamicTextureAtlas::Add(const std::string &name,
+                                     const vec2i &size, const void *data) {
+  const vec4 *existing = GetBounds(AssetId(name));
+  if (existing) return existing;
+  if (size.x <= 0 || size.y <= 0 || size.x > size_.x || size.y > size_.y) {
+    return nullptr;
+  }
+  // Leave the padding right of and below the subtexture, except at the edges
+  // of the atlas.
+  const vec2i padded = vec2i::Min(size + vec2i(padding_, padding_), size_);
+  vec2i position;
+  if (!Pack(padded, &position)) return nullptr;
+
+  atlas_texture()->UpdateTexture(0, format_, position.x, position.y, size.x,
+                                 size.y, data);
+  const vec2 atlas_size(size_);
+  const vec4 bounds(position.x / atlas_size.x, position.y / atlas_size.y,
+                    size.x / atlas_size.x, size.y / atlas_size.y);
+  return &subtexture_bounds()[AddSubtexture(name, bounds)];
+}
+
+int DynamicTextureAtlas::FitAt(size_t index, int width) const {
+  const int x = skyline_[index].x;
+  if (x + width > size_.x) return -1;
+  int y = 0;
+  for (size_t i = index; i < skyline_.size() && skyline_[i].x < x + width;
+       ++i) {
+    y = std::max(y, skyline_[i].y);
+  }
+  return y;
+}
+
+bool DynamicTextureAtlas::Pack(const vec2i &size, vec2i *position) {
+  // Bottom-left heuristic: the place where the top of the rectangle ends up
+  // lowest, preferring narrower segments to keep wide ones for wide images.
+  size_t best = skyline_.size();
+  int best_y = 0;
+  for (size_t i = 0; i < skyline_.size(); ++i) {
+    const int y = FitAt(i, size.x);
+    if (y < 0 || y + size.y > size_.y) continue;
+    if (best == skyline_.size() || y < best_y ||
+        (y == best_y && skyline_[i].width < skyline_[best].width)) {
+      best = i;
+      best_y = y;
+    }
+  }
+  if (best == skyline_.size()) return false;
+  *position = vec2i(skyline_[best].x, best_y);
+
+  // Raise the skyline over the rectangle, and cut it out of the segments it
+  // now covers.
+  const SkylineSegment top = {position->x, best_y + size.y, size.x};
+  skyline_.insert(skyline_.begin() + best, top);
+  const int end = top.x + top.width;
+  for (size_t i = best + 1; i < skyline_.size() && skyline_[i].x < end;) {
+    SkylineSegment &segment = skyline_[i];
+    const int covered = end - segment.x;
+    if (covered < segment.width) {
+      segment.x += covered;
+      segment.width -= covered;
+      break;
+    }
+    skyline_.erase(skyline_.begin() + i);
+  }
+  // Merge neighbors at the same height.
+  for (size_t i = 0; i + 1 < skyline_.size();) {
+    if (skyline_[i].y == skyline_[i + 1].y) {
+      skyline_[i].width += skyline_[i + 1].width;
+      skyline_.erase(skyline_.begin() + i + 1);
+    } else {
+      ++i;
+    }
+  }
+  return true;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,271 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// An environment without a window, for benchmarks and tests on machines
+// without a display, e.g. CI runners with a GPU. Renders into an EGL pbuffer
+// of the requested window size. Built into fplbase_headless, with the stdlib
+// versions of the other backend files.
+
+#include "precompiled.h"  // NOLINT
+
+#include <EGL/egl.h>
+
+#include "fplbase/environment.h"
+#include "fplbase/utilities.h"
+
+#ifndef EGL_CONTEXT_MAJOR_VERSION
+#define EGL_CONTEXT_MAJOR_VERSION 0x3098
+#define EGL_CONTEXT_MINOR_VERSION 0x30FB
+#define EGL_CONTEXT_OPENGL_PROFILE_MASK 0x30FD
+#define EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT 0x00000002
+#endif
+
+using mathfu::vec2i;
+
+namespace fplbase {
+
+struct HeadlessHandles : EnvironmentHandles {
+  HeadlessHandles()
+      : display_(EGL_NO_DISPLAY),
+        config_(nullptr),
+        surface_(EGL_NO_SURFACE),
+        context_(EGL_NO_CONTEXT) {}
+  ~HeadlessHandles() {
+    if (display_ == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context_ != EGL_NO_CONTEXT) eglDestroyContext(display_, context_);
+    if (surface_ != EGL_NO_SURFACE) eglDestroySurface(display_, surface_);
+    eglTerminate(display_);
+  }
+
+  EGLDisplay display_;
+  EGLConfig config_;
+  EGLSurface surface_;
+  EGLContext context_;
+};
+
+// A context from Environment::CreateSharedContext().
+struct HeadlessSharedContext {
+  EGLSurface surface;
+  EGLContext context;
+};
+
+#ifdef FPLBASE_GLES
+static const EGLenum kApi = EGL_OPENGL_ES_API;
+static const EGLint kRenderableType = EGL_OPENGL_ES2_BIT;
+static const EGLint kContextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3,
+                                        EGL_CONTEXT_MINOR_VERSION, 0,
+                                        EGL_NONE};
+#else
+static const EGLenum kApi = EGL_OPENGL_API;
+static const EGLint kRenderableType = EGL_OPENGL_BIT;
+// Profiles only apply from 3.2, and drivers may hand back a core context for
+// a 3.1 request. RenderArray() draws from client memory, so this needs the
+// compatibility profile the SDL backend asks for.
+static const EGLint kContextAttribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 2,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK,
+    EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+    EGL_NONE};
+#endif
+
+// From EGL_EXT_platform_base and EGL_MESA_platform_surfaceless.
+typedef EGLDisplay (*PlatformDisplayFunction)(EGLenum platform,
+                                              void *native_display,
+                                              const EGLint *attrib_list);
+static const EGLenum kPlatformSurfaceless = 0x31DD;
+
+static std::string EglError(const char *call) {
+  char error[64];
+  snprintf(error, sizeof(error), "%s fail: 0x%x", call, eglGetError());
+  return error;
+}
+
+bool Environment::Initialize(const vec2i &window_size,
+                             const char * /*window_title*/,
+                             WindowMode /*window_mode*/) {
+  std::unique_ptr<HeadlessHandles> handles(new HeadlessHandles);
+  handles->display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (handles->display_ == EGL_NO_DISPLAY ||
+      !eglInitialize(handles->display_, nullptr, nullptr)) {
+    // The default display usually wants an X server. Mesa can also give a
+    // display with no window system at all.
+    auto get_platform_display = reinterpret_cast<PlatformDisplayFunction>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    handles->display_ =
+        get_platform_display
+            ? get_platform_display(kPlatformSurfaceless, EGL_DEFAULT_DISPLAY,
+                                   nullptr)
+            : EGL_NO_DISPLAY;
+    if (handles->display_ == EGL_NO_DISPLAY ||
+        !eglInitialize(handles->display_, nullptr, nullptr)) {
+      last_error_ = EglError("eglInitialize");
+      return false;
+    }
+  }
+  if (!eglBindAPI(kApi)) {
+    last_error_ = EglError("eglBindAPI");
+    return false;
+  }
+
+  const EGLint config_attribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                   EGL_RENDERABLE_TYPE, kRenderableType,
+                                   EGL_RED_SIZE, 8,
+                                   EGL_GREEN_SIZE, 8,
+                                   EGL_BLUE_SIZE, 8,
+                                   EGL_ALPHA_SIZE, 8,
+                                   EGL_DEPTH_SIZE, 24,
+                                   EGL_NONE};
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(handles->display_, config_attribs, &handles->config_,
+                       1, &num_configs) ||
+      num_configs < 1) {
+    last_error_ = EglError("eglChooseConfig");
+    return false;
+  }
+
+  const EGLint surface_attribs[] = {EGL_WIDTH, window_size.x,
+                                    EGL_HEIGHT, window_size.y, EGL_NONE};
+  handles->surface_ = eglCreatePbufferSurface(
+      handles->display_, handles->config_, surface_attribs);
+  if (handles->surface_ == EGL_NO_SURFACE) {
+    last_error_ = EglError("eglCreatePbufferSurface");
+    return false;
+  }
+
+  feature_level_ = kFeatureLevel30;
+  handles->context_ = eglCreateContext(handles->display_, handles->config_,
+                                       EGL_NO_CONTEXT, kContextAttribs);
+  if (handles->context_ == EGL_NO_CONTEXT) {
+    // Fall back on whatever version the driver gives by default.
+    feature_level_ = kFeatureLevel20;
+#ifdef FPLBASE_GLES
+    const EGLint es2_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+    const EGLint *fallback_attribs = es2_attribs;
+#else
+    const EGLint *fallback_attribs = nullptr;
+#endif
+    handles->context_ = eglCreateContext(handles->display_, handles->config_,
+                                         EGL_NO_CONTEXT, fallback_attribs);
+  }
+  if (handles->context_ == EGL_NO_CONTEXT) {
+    last_error_ = EglError("eglCreateContext");
+    return false;
+  }
+  if (!eglMakeCurrent(handles->display_, handles->surface_, handles->surface_,
+                      handles->context_)) {
+    last_error_ = EglError("eglMakeCurrent");
+    return false;
+  }
+  window_size_ = window_size;
+  handles_.reset(handles.release());
+
+#if !defined(FPLBASE_GLES) && !defined(__APPLE__)
+#define GLEXT(type, name, required) \
+  LOOKUP_GL_FUNCTION(type, name, required, eglGetProcAddress)
+  GLBASEEXTS GLEXTS
+#undef GLEXT
+
+#ifdef GL_MAJOR_VERSION
+  if (feature_level_ == kFeatureLevel20) {
+    // The default context may still be a 3.x one.
+    GLint version = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &version);
+    if (glGetError() == 0 && version >= 3) feature_level_ = kFeatureLevel30;
+  }
+#endif  // defined(GL_MAJOR_VERSION)
+#endif  // !defined(FPLBASE_GLES) && !defined(__APPLE__)
+
+#ifdef FPLBASE_GLES
+#define GLEXT(type, name, required) \
+  LOOKUP_GL_FUNCTION(type, name, required, eglGetProcAddress)
+  GLESEXTS
+#undef GLEXT
+#endif  // FPLBASE_GLES
+
+  LogInfo(kApplication, "FPLBase: headless context %dx%d, feature level %s",
+          window_size.x, window_size.y,
+          feature_level_ == kFeatureLevel20 ? "2.0" : "3.0");
+  return true;
+}
+
+void Environment::ShutDown() { handles_.reset(); }
+
+void Environment::AdvanceFrame(bool /*minimized*/) {
+  auto handles = static_cast<HeadlessHandles *>(handles_.get());
+  if (!handles) return;
+  // Nothing is shown, but a swap ends the frame for the driver, as it would
+  // with a window.
+  eglSwapBuffers(handles->display_, handles->surface_);
+}
+
+int Environment::GetRefreshRate() const { return 0; }
+
+bool Environment::SetSwapInterval(int interval) {
+  auto handles = static_cast<HeadlessHandles *>(handles_.get());
+  if (!handles) return false;
+  return eglSwapInterval(handles->display_, interval) == EGL_TRUE;
+}
+
+bool Environment::MakeContextCurrent(bool current) {
+  auto handles = static_cast<HeadlessHandles *>(handles_.get());
+  if (!handles) return false;
+  return eglMakeCurrent(handles->display_,
+                        current ? handles->surface_ : EGL_NO_SURFACE,
+                        current ? handles->surface_ : EGL_NO_SURFACE,
+                        current ? handles->context_ : EGL_NO_CONTEXT) ==
+         EGL_TRUE;
+}
+
+void *Environment::CreateSharedContext() {
+  auto handles = static_cast<HeadlessHandles *>(handles_.get());
+  if (!handles) return nullptr;
+  EGLContext context =
+      eglCreateContext(handles->display_, handles->config_, handles->context_,
+                       feature_level_ == kFeatureLevel30 ? kContextAttribs
+                                                         : nullptr);
+  if (context == EGL_NO_CONTEXT) return nullptr;
+  const EGLint surface_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+  HeadlessSharedContext *shared = new HeadlessSharedContext;
+  shared->surface = eglCreatePbufferSurface(handles->display_,
+                                            handles->config_, surface_attribs);
+  shared->context = context;
+  return shared;
+}
+
+bool Environment::MakeSharedContextCurrent(void *shared_context) {
+  auto handles = static_cast<HeadlessHandles *>(handles_.get());
+  if (!handles) return false;
+  auto shared = static_cast<HeadlessSharedContext *>(shared_context);
+  return eglMakeCurrent(handles->display_,
+                        shared ? shared->surface : EGL_NO_SURFACE,
+                        shared ? shared->surface : EGL_NO_SURFACE,
+                        shared ? shared->context : EGL_NO_CONTEXT) == EGL_TRUE;
+}
+
+void Environment::DestroySharedContext(void *shared_context) {
+  auto handles = static_cast<HeadlessHandles *>(handles_.get());
+  auto shared = static_cast<HeadlessSharedContext *>(shared_context);
+  if (!handles || !shared) return;
+  if (shared->surface != EGL_NO_SURFACE) {
+    eglDestroySurface(handles->display_, shared->surface);
+  }
+  eglDestroyContext(handles->display_, shared->context);
+  delete shared;
+}
+
+vec2i Environment::GetViewportSize() const { return window_size(); }
+
+}  // namespace fplbase
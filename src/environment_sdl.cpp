@@ -18,6 +18,7 @@
 #include "fplbase/utilities.h"
 
 #ifdef __ANDROID__
+#include <EGL/egl.h>
 #include "fplbase/renderer_android.h"
 #endif
 
@@ -39,6 +40,19 @@ struct SDLHandles : EnvironmentHandles {
   SDL_GLContext context_;
 };
 
+// A context from Environment::CreateSharedContext().
+struct SDLSharedContext {
+#ifdef __ANDROID__
+  // The window's surface can only be current on one thread, so the shared
+  // context gets a surface of its own.
+  EGLDisplay display;
+  EGLSurface surface;
+  EGLContext context;
+#else
+  SDL_GLContext context;
+#endif
+};
+
 static WindowMode AdjustWindowModeForPlatform(WindowMode window_mode) {
 #ifdef PLATFORM_MOBILE
   // If on a mobile platform and a windowed desktop mode was selected, switch
@@ -200,6 +214,105 @@ void Environment::AdvanceFrame(bool minimized) {
   SDL_GetWindowSize(handles->window_, &window_size_.x, &window_size_.y);
 }
 
+int Environment::GetRefreshRate() const {
+  auto handles = static_cast<SDLHandles *>(handles_.get());
+  SDL_DisplayMode mode;
+  if (!handles || SDL_GetWindowDisplayMode(handles->window_, &mode) != 0) {
+    return 0;
+  }
+  return mode.refresh_rate;
+}
+
+bool Environment::SetSwapInterval(int interval) {
+  if (!handles_) return false;
+  return SDL_GL_SetSwapInterval(interval) == 0;
+}
+
+bool Environment::MakeContextCurrent(bool current) {
+  auto handles = static_cast<SDLHandles *>(handles_.get());
+  if (!handles) return false;
+  return SDL_GL_MakeCurrent(handles->window_,
+                            current ? handles->context_ : nullptr) == 0;
+}
+
+void *Environment::CreateSharedContext() {
+  auto handles = static_cast<SDLHandles *>(handles_.get());
+  if (!handles) return nullptr;
+#ifdef __ANDROID__
+  EGLDisplay display = eglGetCurrentDisplay();
+  EGLContext current = eglGetCurrentContext();
+  EGLint config_id = 0, client_version = 2;
+  if (current == EGL_NO_CONTEXT ||
+      !eglQueryContext(display, current, EGL_CONFIG_ID, &config_id) ||
+      !eglQueryContext(display, current, EGL_CONTEXT_CLIENT_VERSION,
+                       &client_version)) {
+    return nullptr;
+  }
+  const EGLint config_attribs[] = {EGL_CONFIG_ID, config_id, EGL_NONE};
+  EGLConfig config;
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) ||
+      num_configs < 1) {
+    return nullptr;
+  }
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, client_version,
+                                    EGL_NONE};
+  EGLContext context =
+      eglCreateContext(display, config, current, context_attribs);
+  if (context == EGL_NO_CONTEXT) return nullptr;
+  // Nothing is drawn to it. Without pbuffer support, count on
+  // EGL_KHR_surfaceless_context instead.
+  const EGLint surface_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+  EGLSurface surface =
+      eglCreatePbufferSurface(display, config, surface_attribs);
+  SDLSharedContext *shared = new SDLSharedContext;
+  shared->display = display;
+  shared->surface = surface;
+  shared->context = context;
+  return shared;
+#else
+  // SDL_GL_CreateContext() makes the new context current, with the same
+  // attributes the rendering context was created with.
+  SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+  SDL_GLContext context = SDL_GL_CreateContext(handles->window_);
+  SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+  SDL_GL_MakeCurrent(handles->window_, handles->context_);
+  if (!context) return nullptr;
+  SDLSharedContext *shared = new SDLSharedContext;
+  shared->context = context;
+  return shared;
+#endif  // __ANDROID__
+}
+
+bool Environment::MakeSharedContextCurrent(void *shared_context) {
+  auto handles = static_cast<SDLHandles *>(handles_.get());
+  if (!handles) return false;
+  auto shared = static_cast<SDLSharedContext *>(shared_context);
+#ifdef __ANDROID__
+  EGLDisplay display = shared ? shared->display : eglGetCurrentDisplay();
+  return eglMakeCurrent(display, shared ? shared->surface : EGL_NO_SURFACE,
+                        shared ? shared->surface : EGL_NO_SURFACE,
+                        shared ? shared->context : EGL_NO_CONTEXT) == EGL_TRUE;
+#else
+  return SDL_GL_MakeCurrent(handles->window_,
+                            shared ? shared->context : nullptr) == 0;
+#endif  // __ANDROID__
+}
+
+void Environment::DestroySharedContext(void *shared_context) {
+  auto shared = static_cast<SDLSharedContext *>(shared_context);
+  if (!shared) return;
+#ifdef __ANDROID__
+  if (shared->surface != EGL_NO_SURFACE) {
+    eglDestroySurface(shared->display, shared->surface);
+  }
+  eglDestroyContext(shared->display, shared->context);
+#else
+  SDL_GL_DeleteContext(shared->context);
+#endif  // __ANDROID__
+  delete shared;
+}
+
 vec2i Environment::GetViewportSize() const {
 #if defined(__ANDROID__)
   // Check HW scaler setting and change a viewport size if they are set.
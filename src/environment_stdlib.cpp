@@ -88,6 +88,29 @@ void Environment::AdvanceFrame(bool minimized) {
   (void)minimized;
 }
 
+int Environment::GetRefreshRate() const { return 0; }
+
+bool Environment::SetSwapInterval(int interval) {
+  (void)interval;
+  return false;
+}
+
+bool Environment::MakeContextCurrent(bool current) {
+  (void)current;
+  return false;
+}
+
+void *Environment::CreateSharedContext() { return nullptr; }
+
+bool Environment::MakeSharedContextCurrent(void *shared_context) {
+  (void)shared_context;
+  return false;
+}
+
+void Environment::DestroySharedContext(void *shared_context) {
+  (void)shared_context;
+}
+
 vec2i Environment::GetViewportSize() const {
   return window_size();
 }
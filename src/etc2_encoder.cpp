@@ -0,0 +1,260 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/internal/etc2_encoder.h"
+
+namespace fplbase {
+
+static const int kBlockDim = 4;
+static const int kBlockPixels = kBlockDim * kBlockDim;
+
+// The luminance modifiers of ETC1, as {a, b}, which pixel indices 0 to 3
+// select as +a, +b, -a and -b.
+static const int kEtcModifiers[8][2] = {
+    {2, 8},   {5, 17},  {9, 29},   {13, 42},
+    {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+// The alpha modifiers of EAC, scaled by the block's multiplier.
+static const int kEacModifiers[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12}, {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},  {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},  {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},  {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},   {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+static inline int Clamp255(int v) { return v < 0 ? 0 : (v > 255 ? 255 : v); }
+
+static inline int Square(int v) { return v * v; }
+
+static inline int Expand4(int v) { return v * 17; }
+
+static inline int Expand5(int v) { return (v << 3) | (v >> 2); }
+
+static void StoreBigEndian(uint64_t bits, uint8_t *dest) {
+  for (int i = 7; i >= 0; --i) {
+    dest[i] = static_cast<uint8_t>(bits);
+    bits >>= 8;
+  }
+}
+
+// Both blocks number their pixels down each column in turn.
+static inline int PixelBit(int x, int y) { return x * kBlockDim + y; }
+
+// The pixels of one half of a block, split into columns 0-1 and 2-3, or if
+// `flip` into rows 0-1 and 2-3.
+static inline void SubblockPixel(bool flip, int half, int i, int *x, int *y) {
+  const int across = flip ? kBlockDim : 2;
+  *x = (flip ? 0 : half * 2) + i % across;
+  *y = (flip ? half * 2 : 0) + i / across;
+}
+
+struct SubblockFit {
+  int error;
+  int table;
+  uint32_t indices;  // Already placed in the block's bits 31..0.
+};
+
+// Picks the modifier table, and each pixel's modifier, that bring the
+// half's pixels closest to `base`.
+static SubblockFit FitSubblock(const uint8_t *rgba, bool flip, int half,
+                               const int base[3]) {
+  SubblockFit best = {std::numeric_limits<int>::max(), 0, 0};
+  for (int table = 0; table < 8; ++table) {
+    const int a = kEtcModifiers[table][0];
+    const int b = kEtcModifiers[table][1];
+    const int modifiers[4] = {a, b, -a, -b};
+    SubblockFit fit = {0, table, 0};
+    for (int i = 0; i < kBlockPixels / 2 && fit.error < best.error; ++i) {
+      int x, y;
+      SubblockPixel(flip, half, i, &x, &y);
+      const uint8_t *p = rgba + (y * kBlockDim + x) * 4;
+      int best_error = std::numeric_limits<int>::max();
+      uint32_t best_index = 0;
+      for (uint32_t index = 0; index < 4; ++index) {
+        const int m = modifiers[index];
+        const int error = Square(Clamp255(base[0] + m) - p[0]) +
+                          Square(Clamp255(base[1] + m) - p[1]) +
+                          Square(Clamp255(base[2] + m) - p[2]);
+        if (error < best_error) {
+          best_error = error;
+          best_index = index;
+        }
+      }
+      fit.error += best_error;
+      const int bit = PixelBit(x, y);
+      fit.indices |= ((best_index >> 1) << (16 + bit)) | ((best_index & 1) << bit);
+    }
+    if (fit.error < best.error) best = fit;
+  }
+  return best;
+}
+
+void EncodeEtc2Block(const uint8_t *rgba, uint8_t *dest) {
+  int best_error = std::numeric_limits<int>::max();
+  uint64_t best_bits = 0;
+  for (int flip = 0; flip < 2; ++flip) {
+    int average[2][3] = {{0, 0, 0}, {0, 0, 0}};
+    for (int half = 0; half < 2; ++half) {
+      for (int i = 0; i < kBlockPixels / 2; ++i) {
+        int x, y;
+        SubblockPixel(flip != 0, half, i, &x, &y);
+        const uint8_t *p = rgba + (y * kBlockDim + x) * 4;
+        for (int c = 0; c < 3; ++c) average[half][c] += p[c];
+      }
+      for (int c = 0; c < 3; ++c) {
+        average[half][c] = (average[half][c] + kBlockPixels / 4) /
+                           (kBlockPixels / 2);
+      }
+    }
+
+    // Differential mode keeps 5 bits of each color, when the second is
+    // within reach of the first's 3-bit signed delta. Any further would
+    // select one of ETC2's other modes, so fall back to 4 bits each.
+    int q5[2][3], q4[2][3];
+    bool differential = true;
+    for (int c = 0; c < 3; ++c) {
+      for (int half = 0; half < 2; ++half) {
+        q5[half][c] = (average[half][c] * 31 + 127) / 255;
+        q4[half][c] = (average[half][c] * 15 + 127) / 255;
+      }
+      const int delta = q5[1][c] - q5[0][c];
+      differential = differential && delta >= -4 && delta <= 3;
+    }
+
+    for (int mode = differential ? 0 : 1; mode < 2; ++mode) {
+      const bool individual = mode == 1;
+      SubblockFit fits[2];
+      for (int half = 0; half < 2; ++half) {
+        int base[3];
+        for (int c = 0; c < 3; ++c) {
+          base[c] = individual ? Expand4(q4[half][c]) : Expand5(q5[half][c]);
+        }
+        fits[half] = FitSubblock(rgba, flip != 0, half, base);
+      }
+      const int error = fits[0].error + fits[1].error;
+      if (error >= best_error) continue;
+      best_error = error;
+
+      uint64_t bits = 0;
+      for (int c = 0; c < 3; ++c) {
+        const int shift = 56 - c * 8;
+        if (individual) {
+          bits |= static_cast<uint64_t>(q4[0][c]) << (shift + 4);
+          bits |= static_cast<uint64_t>(q4[1][c]) << shift;
+        } else {
+          bits |= static_cast<uint64_t>(q5[0][c]) << (shift + 3);
+          bits |= static_cast<uint64_t>((q5[1][c] - q5[0][c]) & 7) << shift;
+        }
+      }
+      bits |= static_cast<uint64_t>(fits[0].table) << 37;
+      bits |= static_cast<uint64_t>(fits[1].table) << 34;
+      bits |= static_cast<uint64_t>(individual ? 0 : 1) << 33;
+      bits |= static_cast<uint64_t>(flip) << 32;
+      bits |= fits[0].indices | fits[1].indices;
+      best_bits = bits;
+    }
+  }
+  StoreBigEndian(best_bits, dest);
+}
+
+void EncodeEacAlphaBlock(const uint8_t *rgba, uint8_t *dest) {
+  int low = 255, high = 0;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    const int a = rgba[i * 4 + 3];
+    low = std::min(low, a);
+    high = std::max(high, a);
+  }
+
+  int best_error = std::numeric_limits<int>::max();
+  uint64_t best_bits = 0;
+  for (int table = 0; table < 16 && best_error > 0; ++table) {
+    const int *modifiers = kEacModifiers[table];
+    // Each table's most negative and most positive modifiers are its 4th
+    // and 8th.
+    const int range = modifiers[7] - modifiers[3];
+    const int guess = std::max(1, ((high - low) + range / 2) / range);
+    for (int multiplier = std::max(1, guess - 1);
+         multiplier <= std::min(15, guess + 1); ++multiplier) {
+      // Center the table's range on the block's.
+      const int twice_base =
+          low + high - multiplier * (modifiers[3] + modifiers[7]);
+      const int base = Clamp255((twice_base + 1) / 2);
+      int error = 0;
+      uint64_t indices = 0;
+      for (int x = 0; x < kBlockDim && error < best_error; ++x) {
+        for (int y = 0; y < kBlockDim; ++y) {
+          const int a = rgba[(y * kBlockDim + x) * 4 + 3];
+          int best_pixel_error = std::numeric_limits<int>::max();
+          uint64_t best_index = 0;
+          for (int index = 0; index < 8; ++index) {
+            const int pixel_error =
+                Square(Clamp255(base + modifiers[index] * multiplier) - a);
+            if (pixel_error < best_pixel_error) {
+              best_pixel_error = pixel_error;
+              best_index = static_cast<uint64_t>(index);
+            }
+          }
+          error += best_pixel_error;
+          indices |= best_index << (45 - 3 * PixelBit(x, y));
+        }
+      }
+      if (error < best_error) {
+        best_error = error;
+        best_bits = (static_cast<uint64_t>(base) << 56) |
+                    (static_cast<uint64_t>(multiplier) << 52) |
+                    (static_cast<uint64_t>(table) << 48) | indices;
+      }
+    }
+  }
+  StoreBigEndian(best_bits, dest);
+}
+
+size_t Etc2ImageSize(int width, int height, bool alpha) {
+  const size_t blocks = static_cast<size_t>((width + kBlockDim - 1) / kBlockDim) *
+                        static_cast<size_t>((height + kBlockDim - 1) / kBlockDim);
+  return blocks * (alpha ? 16 : 8);
+}
+
+void EncodeEtc2Image(const uint8_t *src, int width, int height, int channels,
+                     bool alpha, uint8_t *dest) {
+  uint8_t block[kBlockPixels * 4];
+  for (int block_y = 0; block_y < height; block_y += kBlockDim) {
+    for (int block_x = 0; block_x < width; block_x += kBlockDim) {
+      for (int y = 0; y < kBlockDim; ++y) {
+        const int src_y = std::min(block_y + y, height - 1);
+        for (int x = 0; x < kBlockDim; ++x) {
+          const int src_x = std::min(block_x + x, width - 1);
+          const uint8_t *p = src + (src_y * width + src_x) * channels;
+          uint8_t *q = block + (y * kBlockDim + x) * 4;
+          q[0] = p[0];
+          q[1] = p[1];
+          q[2] = p[2];
+          q[3] = channels == 4 ? p[3] : 255;
+        }
+      }
+      if (alpha) {
+        EncodeEacAlphaBlock(block, dest);
+        dest += 8;
+      }
+      EncodeEtc2Block(block, dest);
+      dest += 8;
+    }
+  }
+}
+
+}  // namespace fplbase
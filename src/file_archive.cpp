@@ -0,0 +1,122 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "precompiled.h"
+#include "fplbase/file_archive.h"
+#include "fplbase/utilities.h"
+
+#include "archive_generated.h"
+
+namespace fplbase {
+
+// See schemas/archive.fbs.
+static const size_t kArchiveHeaderSize = 8;
+static const size_t kArchiveContentsAlignment = 16;
+
+FileArchive::FileArchive()
+    : mapping_(nullptr),
+      mapping_size_(0),
+      index_(nullptr),
+      contents_(nullptr),
+      contents_size_(0) {}
+
+FileArchive::~FileArchive() { Close(); }
+
+bool FileArchive::Open(const char *filename) {
+  Close();
+  int32_t size = 0;
+  mapping_ = static_cast<const uint8_t *>(MapFile(filename, 0, &size));
+  if (!mapping_) return false;
+  mapping_size_ = size;
+
+  const size_t file_size = static_cast<size_t>(size);
+  const size_t index_size =
+      file_size >= kArchiveHeaderSize
+          ? flatbuffers::ReadScalar<uint32_t>(mapping_)
+          : 0;
+  const size_t contents_start =
+      (kArchiveHeaderSize + index_size + kArchiveContentsAlignment - 1) &
+      ~(kArchiveContentsAlignment - 1);
+  const uint8_t *index = mapping_ + kArchiveHeaderSize;
+  bool ok = index_size > 0 && contents_start <= file_size;
+  if (ok) {
+    flatbuffers::Verifier verifier(index, index_size);
+    ok = archivedef::VerifyArchiveBuffer(verifier);
+  }
+  if (!ok) {
+    LogError(kError, "Invalid archive: %s", filename);
+    Close();
+    return false;
+  }
+  index_ = archivedef::GetArchive(index);
+  contents_ = mapping_ + contents_start;
+  contents_size_ = file_size - contents_start;
+  return true;
+}
+
+void FileArchive::Close() {
+  if (mapping_) UnmapFile(mapping_, mapping_size_);
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  index_ = nullptr;
+  contents_ = nullptr;
+  contents_size_ = 0;
+}
+
+bool FileArchive::Find(const char *name, const uint8_t **data,
+                       size_t *size) const {
+  if (!index_ || !index_->entries()) return false;
+  // archive_pipeline sorts the entries by name.
+  auto entries = index_->entries();
+  flatbuffers::uoffset_t lo = 0;
+  flatbuffers::uoffset_t hi = entries->size();
+  while (lo < hi) {
+    const flatbuffers::uoffset_t mid = lo + (hi - lo) / 2;
+    auto entry = entries->Get(mid);
+    const int order = entry->name() ? strcmp(entry->name()->c_str(), name) : -1;
+    if (order < 0) {
+      lo = mid + 1;
+    } else if (order > 0) {
+      hi = mid;
+    } else {
+      if (entry->offset() > contents_size_ ||
+          entry->size() > contents_size_ - entry->offset()) {
+        LogError(kError, "Archive entry out of bounds: %s", name);
+        return false;
+      }
+      *data = contents_ + entry->offset();
+      *size = static_cast<size_t>(entry->size());
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FileArchive::LoadFile(const char *name, std::string *dest) const {
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+  if (!Find(name, &data, &size)) return false;
+  dest->assign(reinterpret_cast<const char *>(data), size);
+  return true;
+}
+
+LoadFileFunction FileArchive::CreateLoadFileFunction(
+    const LoadFileFunction &fallback) const {
+  return [this, fallback](const char *filename, std::string *dest) {
+    return LoadFile(filename, dest) || (fallback && fallback(filename, dest));
+  };
+}
+
+}  // namespace fplbase
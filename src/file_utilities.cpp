@@ -29,27 +29,47 @@
 #include <assert.h>
 #include <algorithm>
 #include <mutex>
+#include <vector>
 #include "fplbase/file_utilities.h"
 #include "fplbase/logging.h"
+#include "write_behind.h"
 
 namespace fplbase {
 
 // Function called by LoadFile().
 static std::mutex g_load_file_function_mutex_;
 static LoadFileFunction g_load_file_function = LoadFileRaw;
+static bool g_custom_load_file_function = false;
+static uint32_t g_load_file_function_generation = 0;
 
 LoadFileFunction SetLoadFileFunction(LoadFileFunction load_file_function) {
-  std::unique_lock<std::mutex> lock(g_load_file_function_mutex_);
-  LoadFileFunction previous_function = g_load_file_function;
-  if (load_file_function) {
-    g_load_file_function = load_file_function;
-  } else {
-    g_load_file_function = LoadFileRaw;
+  LoadFileFunction previous_function;
+  {
+    std::unique_lock<std::mutex> lock(g_load_file_function_mutex_);
+    previous_function = g_load_file_function;
+    if (load_file_function) {
+      g_load_file_function = load_file_function;
+    } else {
+      g_load_file_function = LoadFileRaw;
+    }
+    g_custom_load_file_function = load_file_function != nullptr;
+    g_load_file_function_generation++;
   }
   return previous_function;
 }
 
+bool HasCustomLoadFileFunction() {
+  std::unique_lock<std::mutex> lock(g_load_file_function_mutex_);
+  return g_custom_load_file_function;
+}
+
+uint32_t LoadFileFunctionGeneration() {
+  std::unique_lock<std::mutex> lock(g_load_file_function_mutex_);
+  return g_load_file_function_generation;
+}
+
 bool LoadFile(const char *filename, std::string *dest) {
+  if (FindQueuedFileWrite(filename, dest)) return true;
   LoadFileFunction load_file_function;
   {
     std::unique_lock<std::mutex> lock(g_load_file_function_mutex_);
@@ -59,6 +79,102 @@ bool LoadFile(const char *filename, std::string *dest) {
   return load_file_function(filename, dest);
 }
 
+bool ReadFileChunks(const char *filename, size_t chunk_size,
+                    const FileChunkFunction &chunk_function) {
+  PooledFileBuffer file;
+  const bool queued = FindQueuedFileWrite(filename, file.get());
+  if (!queued && !HasCustomLoadFileFunction()) {
+    return ReadFileChunksRaw(filename, chunk_size, chunk_function);
+  }
+  // Queued writes and the custom function only give whole files.
+  if (!queued && !LoadFile(filename, file.get())) return false;
+  return chunk_function(reinterpret_cast<const uint8_t *>(file->data()),
+                        file->size());
+}
+
+// Free buffers for AcquireFileBuffer(), in no particular order. Few enough
+// that a linear search beats keeping them sorted.
+static std::mutex g_file_buffer_pool_mutex_;
+static std::vector<std::string *> g_file_buffer_pool;
+static size_t g_file_buffer_pool_bytes = 0;
+static size_t g_file_buffer_pool_max_buffers = 8;
+static size_t g_file_buffer_pool_max_bytes = 32 * 1024 * 1024;
+
+// Frees pool buffers, smallest first, until within the limits.
+static void TrimFileBufferPool() {
+  while (g_file_buffer_pool.size() > g_file_buffer_pool_max_buffers ||
+         g_file_buffer_pool_bytes > g_file_buffer_pool_max_bytes) {
+    auto smallest = std::min_element(
+        g_file_buffer_pool.begin(), g_file_buffer_pool.end(),
+        [](const std::string *a, const std::string *b) {
+          return a->capacity() < b->capacity();
+        });
+    g_file_buffer_pool_bytes -= (*smallest)->capacity();
+    delete *smallest;
+    *smallest = g_file_buffer_pool.back();
+    g_file_buffer_pool.pop_back();
+  }
+}
+
+std::string *AcquireFileBuffer(size_t min_capacity) {
+  {
+    std::unique_lock<std::mutex> lock(g_file_buffer_pool_mutex_);
+    // The smallest buffer that fits, or else the largest one.
+    auto best = g_file_buffer_pool.end();
+    for (auto it = g_file_buffer_pool.begin(); it != g_file_buffer_pool.end();
+         ++it) {
+      if (best == g_file_buffer_pool.end()) {
+        best = it;
+        continue;
+      }
+      const size_t capacity = (*it)->capacity();
+      const size_t best_capacity = (*best)->capacity();
+      const bool fits = capacity >= min_capacity;
+      const bool best_fits = best_capacity >= min_capacity;
+      if (fits ? !best_fits || capacity < best_capacity
+               : !best_fits && capacity > best_capacity) {
+        best = it;
+      }
+    }
+    if (best != g_file_buffer_pool.end()) {
+      std::string *buffer = *best;
+      *best = g_file_buffer_pool.back();
+      g_file_buffer_pool.pop_back();
+      g_file_buffer_pool_bytes -= buffer->capacity();
+      if (buffer->capacity() < min_capacity) buffer->reserve(min_capacity);
+      return buffer;
+    }
+  }
+  std::string *buffer = new std::string();
+  buffer->reserve(min_capacity);
+  return buffer;
+}
+
+void ReleaseFileBuffer(std::string *buffer) {
+  if (!buffer) return;
+  buffer->clear();  // Keeps the capacity.
+  std::unique_lock<std::mutex> lock(g_file_buffer_pool_mutex_);
+  // Reserve up front, so that releasing doesn't allocate either.
+  if (g_file_buffer_pool.capacity() <= g_file_buffer_pool_max_buffers) {
+    g_file_buffer_pool.reserve(g_file_buffer_pool_max_buffers + 1);
+  }
+  g_file_buffer_pool.push_back(buffer);
+  g_file_buffer_pool_bytes += buffer->capacity();
+  TrimFileBufferPool();
+}
+
+void SetFileBufferPoolLimits(size_t max_buffers, size_t max_bytes) {
+  std::unique_lock<std::mutex> lock(g_file_buffer_pool_mutex_);
+  g_file_buffer_pool_max_buffers = max_buffers;
+  g_file_buffer_pool_max_bytes = max_bytes;
+  TrimFileBufferPool();
+}
+
+bool SaveFile(const char *filename, const void *data, size_t size) {
+  if (QueueFileWrite(filename, data, size)) return true;
+  return SaveFileRaw(filename, data, size);
+}
+
 bool SaveFile(const char *filename, const std::string &src) {
   return SaveFile(filename, static_cast<const void *>(src.c_str()),
                   src.length());  // don't include the '\0'
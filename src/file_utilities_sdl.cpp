@@ -41,7 +41,27 @@ bool LoadFileRaw(const char *filename, std::string *dest) {
   return len == rlen && len > 0;
 }
 
-bool SaveFile(const char *filename, const void *data, size_t size) {
+bool ReadFileChunksRaw(const char *filename, size_t chunk_size,
+                       const FileChunkFunction &chunk_function) {
+  auto handle = SDL_RWFromFile(filename, "rb");
+  if (!handle) {
+    LogError(kError, "LoadFile fail on %s", filename);
+    return false;
+  }
+  PooledFileBuffer chunk(chunk_size);
+  chunk->resize(chunk_size);
+  uint8_t *data = reinterpret_cast<uint8_t *>(&(*chunk)[0]);
+  bool ok = true;
+  size_t rlen;
+  while (ok && (rlen = static_cast<size_t>(
+                    SDL_RWread(handle, data, 1, chunk_size))) > 0) {
+    ok = chunk_function(data, rlen);
+  }
+  SDL_RWclose(handle);
+  return ok;
+}
+
+bool SaveFileRaw(const char *filename, const void *data, size_t size) {
   auto handle = SDL_RWFromFile(filename, "wb");
   if (!handle) {
     SDL_LogError(SDL_LOG_CATEGORY_ERROR, "SaveFile fail on %s", filename);
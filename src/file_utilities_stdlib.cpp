@@ -78,7 +78,48 @@ bool LoadFileRaw(const char *filename, std::string *dest) {
 #endif
 }
 
-bool SaveFile(const char *filename, const void *data, size_t size) {
+bool ReadFileChunksRaw(const char *filename, size_t chunk_size,
+                       const FileChunkFunction &chunk_function) {
+  PooledFileBuffer chunk(chunk_size);
+  chunk->resize(chunk_size);
+  uint8_t *data = reinterpret_cast<uint8_t *>(&(*chunk)[0]);
+#if defined(__ANDROID__)
+  if (!GetAAssetManager()) {
+    LogError(kError,
+             "Need to call SetAssetManager() once before calling LoadFile()");
+    assert(false);
+  }
+  AAsset *asset =
+      AAssetManager_open(GetAAssetManager(), filename, AASSET_MODE_STREAMING);
+  if (!asset) {
+    LogError(kError, "LoadFile fail on %s", filename);
+    return false;
+  }
+  bool ok = true;
+  int rlen;
+  while (ok && (rlen = AAsset_read(asset, data, chunk_size)) > 0) {
+    ok = chunk_function(data, static_cast<size_t>(rlen));
+  }
+  AAsset_close(asset);
+  return ok && rlen == 0;
+#else
+  FILE *fd = fopen(filename, "rb");
+  if (fd == NULL) {
+    LogError(kError, "LoadFile fail on %s", filename);
+    return false;
+  }
+  bool ok = true;
+  size_t rlen;
+  while (ok && (rlen = fread(data, 1, chunk_size, fd)) > 0) {
+    ok = chunk_function(data, rlen);
+  }
+  ok = ok && !ferror(fd);
+  fclose(fd);
+  return ok;
+#endif
+}
+
+bool SaveFileRaw(const char *filename, const void *data, size_t size) {
 #if defined(__ANDROID__)
   (void)filename;
   (void)data;
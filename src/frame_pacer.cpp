@@ -0,0 +1,98 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/frame_pacer.h"
+
+namespace fplbase {
+
+const double FramePacer::kDefaultVsyncPeriod = 1.0 / 60.0;
+
+// How much of each new measurement goes into the refresh period estimate.
+static const double kPeriodSmoothing = 0.05;
+
+// The fraction of a refresh period that times may be off by, e.g. because a
+// vsync callback ran late, and still count as being at that vsync.
+static const double kVsyncTolerance = 0.25;
+
+FramePacer::FramePacer()
+    : pacing_(kFramePacingOff),
+      present_latency_(1),
+      vsync_period_(kDefaultVsyncPeriod),
+      last_vsync_time_(0),
+      frame_start_time_(0),
+      predicted_present_time_(0) {}
+
+void FramePacer::set_vsync_period(double period) {
+  if (period > 0) vsync_period_ = period;
+}
+
+void FramePacer::OnVsync(double time) {
+  if (last_vsync_time_ > 0) {
+    const double elapsed = time - last_vsync_time_;
+    if (elapsed <= 0) return;
+    // Some vsyncs may have been missed in between.
+    const double periods = std::max(1.0, floor(elapsed / vsync_period_ + 0.5));
+    const double period = elapsed / periods;
+    if (fabs(period - vsync_period_) < kVsyncTolerance * vsync_period_) {
+      vsync_period_ += kPeriodSmoothing * (period - vsync_period_);
+    }
+  }
+  last_vsync_time_ = time;
+}
+
+double FramePacer::BeginFrame(double now) {
+  const int interval = swap_interval();
+  double start = now;
+  double present_base = now;
+  if (last_vsync_time_ > 0) {
+    const double periods_since_vsync =
+        (now - last_vsync_time_) / vsync_period_;
+    // The latest vsync at or before now.
+    present_base =
+        last_vsync_time_ + floor(periods_since_vsync) * vsync_period_;
+    if (pacing_ != kFramePacingOff) {
+      // The vsync we're at, or failing that, the next one.
+      start = last_vsync_time_ +
+              ceil(periods_since_vsync - kVsyncTolerance) * vsync_period_;
+      // Don't start before the last frame has had its whole interval.
+      const double earliest = frame_start_time_ + interval * vsync_period_;
+      if (frame_start_time_ > 0 &&
+          start < earliest - kVsyncTolerance * vsync_period_) {
+        start = last_vsync_time_ +
+                floor((earliest - last_vsync_time_) / vsync_period_ + 0.5) *
+                    vsync_period_;
+      }
+      present_base = start;
+    }
+  }
+  frame_start_time_ = start;
+  predicted_present_time_ =
+      present_base + (interval + present_latency_) * vsync_period_;
+  return start;
+}
+
+void FramePacer::Reset() {
+  last_vsync_time_ = 0;
+  frame_start_time_ = 0;
+  predicted_present_time_ = 0;
+}
+
+int FramePacer::swap_interval() const {
+  if (pacing_ == kFramePacingOff) return 1;
+  const double frame_period = 1.0 / static_cast<double>(pacing_);
+  return std::max(1, static_cast<int>(frame_period / vsync_period_ + 0.5));
+}
+
+}  // namespace fplbase
@@ -0,0 +1,112 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/frame_stats.h"
+
+namespace fplbase {
+
+const size_t FrameStats::kDefaultWindow;
+
+FrameStats::FrameStats(size_t window)
+    : window_(std::max<size_t>(window, 1)),
+      next_(0),
+      total_frames_(0),
+      total_jank_frames_(0),
+      jank_threshold_(1.5 / 60.0) {
+  frame_times_.reserve(window_);
+  swap_times_.reserve(window_);
+  sorted_.reserve(window_);
+}
+
+void FrameStats::AddFrame(double frame_time, double swap_time) {
+  if (frame_times_.size() < window_) {
+    frame_times_.push_back(frame_time);
+    swap_times_.push_back(swap_time);
+  } else {
+    frame_times_[next_] = frame_time;
+    swap_times_[next_] = swap_time;
+  }
+  next_ = (next_ + 1) % window_;
+  ++total_frames_;
+  if (frame_time > jank_threshold_) ++total_jank_frames_;
+}
+
+void FrameStats::Reset() {
+  frame_times_.clear();
+  swap_times_.clear();
+  next_ = 0;
+  total_frames_ = 0;
+  total_jank_frames_ = 0;
+}
+
+double FrameStats::last_frame_time() const {
+  if (frame_times_.empty()) return 0;
+  return frame_times_[(next_ + window_ - 1) % window_];
+}
+
+// Nearest rank: the smallest sample with at least `percentile` percent of the
+// samples at or below it. `sorted` must not be empty.
+static double NearestRank(const std::vector<double> &sorted,
+                          double percentile) {
+  const double rank = ceil(percentile / 100.0 * sorted.size());
+  const size_t index = static_cast<size_t>(
+      std::min(std::max(rank, 1.0), static_cast<double>(sorted.size())));
+  return sorted[index - 1];
+}
+
+double FrameStats::Percentile(const std::vector<double> &samples,
+                              std::vector<double> *sorted,
+                              double percentile) {
+  if (samples.empty()) return 0;
+  sorted->assign(samples.begin(), samples.end());
+  std::sort(sorted->begin(), sorted->end());
+  return NearestRank(*sorted, percentile);
+}
+
+double FrameStats::FramePercentile(double percentile) const {
+  return Percentile(frame_times_, &sorted_, percentile);
+}
+
+double FrameStats::SwapPercentile(double percentile) const {
+  return Percentile(swap_times_, &sorted_, percentile);
+}
+
+FrameStats::Summary FrameStats::Summarize() const {
+  Summary summary;
+  const size_t n = frame_times_.size();
+  summary.num_frames = n;
+  if (n == 0) return summary;
+
+  double total = 0;
+  double total_swap = 0;
+  for (size_t i = 0; i < n; ++i) {
+    total += frame_times_[i];
+    total_swap += swap_times_[i];
+    if (frame_times_[i] > jank_threshold_) ++summary.jank_frames;
+  }
+  summary.average = total / n;
+  summary.average_swap = total_swap / n;
+
+  // Sort once for all of the frame time percentiles.
+  summary.p50 = Percentile(frame_times_, &sorted_, 50);
+  summary.p95 = NearestRank(sorted_, 95);
+  summary.p99 = NearestRank(sorted_, 99);
+  summary.minimum = sorted_.front();
+  summary.maximum = sorted_.back();
+  summary.p95_swap = SwapPercentile(95);
+  return summary;
+}
+
+}  // namespace fplbase
@@ -14,296 +14,244 @@
 
 #include "fplbase/gpu_debug.h"
 
+#include <stdio.h>
+
 #include "fplbase/glplatform.h"
 #include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/logging.h"
 
 namespace fplbase {
 
-inline bool GlToBool(GLboolean bool_value) { return bool_value == GL_TRUE; }
-
-bool ValidateGlBlendState(const BlendState& state) {
-  GLboolean bool_value;
-  GLint int_value;
-
-  GL_CALL(glGetBooleanv(GL_BLEND, &bool_value));
-  if (GlToBool(bool_value) != state.enabled) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_BLEND_SRC_RGB, &int_value));
-  if (static_cast<GLint>(BlendStateFactorToGl(state.src_color)) != int_value) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_BLEND_SRC_ALPHA, &int_value));
-  if (static_cast<GLint>(BlendStateFactorToGl(state.src_alpha)) != int_value) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_BLEND_DST_RGB, &int_value));
-  if (static_cast<GLint>(BlendStateFactorToGl(state.dst_color)) != int_value) {
-    assert(false);
-    return false;
-  }
+namespace {
 
-  GL_CALL(glGetIntegerv(GL_BLEND_DST_ALPHA, &int_value));
-  if (static_cast<GLint>(BlendStateFactorToGl(state.dst_alpha)) != int_value) {
-    assert(false);
-    return false;
-  }
+// Reports one state that doesn't match the cached RenderState. Asserts too, if
+// the caller asked for it, after logging so the log says what went wrong.
+void ReportMismatch(const char *name, const char *expected, const char *actual,
+                    bool assert_on_mismatch) {
+  LogError(kRender, "Render state mismatch: %s is %s, expected %s.", name,
+           actual, expected);
+  assert(!assert_on_mismatch);
+  (void)assert_on_mismatch;
+}
 
-  return true;
+void ReportMismatch(const char *name, GLint expected, GLint actual,
+                    bool assert_on_mismatch) {
+  LogError(kRender, "Render state mismatch: %s is 0x%x, expected 0x%x.", name,
+           static_cast<unsigned int>(actual),
+           static_cast<unsigned int>(expected));
+  assert(!assert_on_mismatch);
+  (void)assert_on_mismatch;
 }
 
-bool ValidateGlCullState(const CullState& state) {
+bool CheckGlBool(GLenum pname, const char *name, bool expected,
+                 bool assert_on_mismatch) {
   GLboolean bool_value;
-  GLint int_value;
-
-  GL_CALL(glGetBooleanv(GL_CULL_FACE, &bool_value));
-  if (GlToBool(bool_value) != state.enabled) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_CULL_FACE_MODE, &int_value));
-  if (static_cast<GLint>(CullFaceToGl(state.face)) != int_value) {
-    assert(false);
-    return false;
-  }
-
-  return true;
+  GL_CALL(glGetBooleanv(pname, &bool_value));
+  const bool actual = bool_value == GL_TRUE;
+  if (actual == expected) return true;
+  ReportMismatch(name, expected ? "true" : "false", actual ? "true" : "false",
+                 assert_on_mismatch);
+  return false;
 }
 
-bool ValidateGlDepthState(const DepthState& state) {
-  GLboolean bool_value;
+bool CheckGlInt(GLenum pname, const char *name, GLint expected,
+                bool assert_on_mismatch) {
   GLint int_value;
+  GL_CALL(glGetIntegerv(pname, &int_value));
+  if (int_value == expected) return true;
+  ReportMismatch(name, expected, int_value, assert_on_mismatch);
+  return false;
+}
 
-  GL_CALL(glGetBooleanv(GL_DEPTH_TEST, &bool_value));
-  if (GlToBool(bool_value) != state.test_enabled) {
-    assert(false);
-    return false;
-  }
+bool CheckGlRect(GLenum pname, const char *name, const mathfu::vec2i &pos,
+                 const mathfu::vec2i &size, bool assert_on_mismatch) {
+  GLint int_values[4];
+  GL_CALL(glGetIntegerv(pname, int_values));
+  if (int_values[0] == pos.x && int_values[1] == pos.y &&
+      int_values[2] == size.x && int_values[3] == size.y) {
+    return true;
+  }
+  char expected[64];
+  char actual[64];
+  snprintf(expected, sizeof(expected), "(%d, %d, %d, %d)", pos.x, pos.y,
+           size.x, size.y);
+  snprintf(actual, sizeof(actual), "(%d, %d, %d, %d)", int_values[0],
+           int_values[1], int_values[2], int_values[3]);
+  ReportMismatch(name, expected, actual, assert_on_mismatch);
+  return false;
+}
 
-  GL_CALL(glGetBooleanv(GL_DEPTH_WRITEMASK, &bool_value));
-  if (GlToBool(bool_value) != state.write_enabled) {
-    assert(false);
-    return false;
-  }
+}  // namespace
+
+// Each of these checks every value, rather than stopping at the first
+// mismatch, so a single validation logs everything that's out of sync.
+
+bool ValidateGlBlendState(const BlendState& state, bool assert_on_mismatch) {
+  bool valid = CheckGlBool(GL_BLEND, "GL_BLEND", state.enabled,
+                           assert_on_mismatch);
+  valid &= CheckGlInt(GL_BLEND_SRC_RGB, "GL_BLEND_SRC_RGB",
+                      static_cast<GLint>(BlendStateFactorToGl(state.src_color)),
+                      assert_on_mismatch);
+  valid &= CheckGlInt(GL_BLEND_SRC_ALPHA, "GL_BLEND_SRC_ALPHA",
+                      static_cast<GLint>(BlendStateFactorToGl(state.src_alpha)),
+                      assert_on_mismatch);
+  valid &= CheckGlInt(GL_BLEND_DST_RGB, "GL_BLEND_DST_RGB",
+                      static_cast<GLint>(BlendStateFactorToGl(state.dst_color)),
+                      assert_on_mismatch);
+  valid &= CheckGlInt(GL_BLEND_DST_ALPHA, "GL_BLEND_DST_ALPHA",
+                      static_cast<GLint>(BlendStateFactorToGl(state.dst_alpha)),
+                      assert_on_mismatch);
+  return valid;
+}
 
-  GL_CALL(glGetIntegerv(GL_DEPTH_FUNC, &int_value));
-  if (static_cast<GLint>(RenderFunctionToGlFunction(state.function)) !=
-      int_value) {
-    assert(false);
-    return false;
-  }
+bool ValidateGlCullState(const CullState& state, bool assert_on_mismatch) {
+  bool valid = CheckGlBool(GL_CULL_FACE, "GL_CULL_FACE", state.enabled,
+                           assert_on_mismatch);
+  valid &= CheckGlInt(GL_CULL_FACE_MODE, "GL_CULL_FACE_MODE",
+                      static_cast<GLint>(CullFaceToGl(state.face)),
+                      assert_on_mismatch);
+  return valid;
+}
 
-  return true;
+bool ValidateGlDepthState(const DepthState& state, bool assert_on_mismatch) {
+  bool valid = CheckGlBool(GL_DEPTH_TEST, "GL_DEPTH_TEST", state.test_enabled,
+                           assert_on_mismatch);
+  valid &= CheckGlBool(GL_DEPTH_WRITEMASK, "GL_DEPTH_WRITEMASK",
+                       state.write_enabled, assert_on_mismatch);
+  valid &= CheckGlInt(
+      GL_DEPTH_FUNC, "GL_DEPTH_FUNC",
+      static_cast<GLint>(RenderFunctionToGlFunction(state.function)),
+      assert_on_mismatch);
+  return valid;
 }
 
-bool ValidateGlPointState(const PointState& state) {
-  GLboolean bool_value;
+bool ValidateGlPointState(const PointState& state, bool assert_on_mismatch) {
+  bool valid = true;
 
 #ifndef FPLBASE_GLES
 #ifdef GL_POINT_SPRITE
-  GL_CALL(glGetBooleanv(GL_POINT_SPRITE, &bool_value));
-  if (GlToBool(bool_value) != state.point_sprite_enabled) {
-    assert(false);
-    return false;
-  }
+  valid &= CheckGlBool(GL_POINT_SPRITE, "GL_POINT_SPRITE",
+                       state.point_sprite_enabled, assert_on_mismatch);
 #endif  // GL_POINT_SPRITE
 
 #ifdef GL_PROGRAM_POINT_SIZE
-  GL_CALL(glGetBooleanv(GL_PROGRAM_POINT_SIZE, &bool_value));
-  if (GlToBool(bool_value) != state.point_sprite_enabled) {
-    assert(false);
-    return false;
-  }
+  valid &= CheckGlBool(GL_PROGRAM_POINT_SIZE, "GL_PROGRAM_POINT_SIZE",
+                       state.point_sprite_enabled, assert_on_mismatch);
 #elif defined(GL_VERTEX_PROGRAM_POINT_SIZE)
-  GL_CALL(glGetBooleanv(GL_VERTEX_PROGRAM_POINT_SIZE, &bool_value));
-  if (GlToBool(bool_value) != state.point_sprite_enabled) {
-    assert(false);
-    return false;
-  }
+  valid &= CheckGlBool(GL_VERTEX_PROGRAM_POINT_SIZE,
+                       "GL_VERTEX_PROGRAM_POINT_SIZE",
+                       state.point_sprite_enabled, assert_on_mismatch);
 #endif  // GL_PROGRAM_POINT_SIZE
 
   float float_value;
   GL_CALL(glGetFloatv(GL_POINT_SIZE, &float_value));
   if (float_value != state.point_size) {
-    assert(false);
-    return false;
-  }
+    char expected[32];
+    char actual[32];
+    snprintf(expected, sizeof(expected), "%g", state.point_size);
+    snprintf(actual, sizeof(actual), "%g", float_value);
+    ReportMismatch("GL_POINT_SIZE", expected, actual, assert_on_mismatch);
+    valid = false;
+  }
+#else
+  (void)state;
+  (void)assert_on_mismatch;
 #endif  // FPLBASE_GLES
 
-  // "Use" the bool value in case none of the conditions were hit, to avoid
-  // compilation errors.
-  (void)bool_value;
-
-  return true;
+  return valid;
 }
 
-bool ValidateGlStencilState(const StencilState& state) {
-  GLboolean bool_value;
-  GLint int_value;
-
-  GL_CALL(glGetBooleanv(GL_STENCIL_TEST, &bool_value));
-  if (GlToBool(bool_value) != state.enabled) {
-    assert(false);
-    return false;
-  }
+bool ValidateGlStencilState(const StencilState& state,
+                            bool assert_on_mismatch) {
+  bool valid = CheckGlBool(GL_STENCIL_TEST, "GL_STENCIL_TEST", state.enabled,
+                           assert_on_mismatch);
 
   // Back Stencil Function values.
-  GL_CALL(glGetIntegerv(GL_STENCIL_BACK_FUNC, &int_value));
-  if (static_cast<GLint>(RenderFunctionToGlFunction(
-          state.back_function.function)) != int_value) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_STENCIL_BACK_REF, &int_value));
-  if (static_cast<GLint>(state.back_function.ref) != int_value) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_STENCIL_BACK_VALUE_MASK, &int_value));
-  if (static_cast<GLint>(state.back_function.mask) != int_value) {
-    assert(false);
-    return false;
-  }
+  valid &= CheckGlInt(GL_STENCIL_BACK_FUNC, "GL_STENCIL_BACK_FUNC",
+                      static_cast<GLint>(RenderFunctionToGlFunction(
+                          state.back_function.function)),
+                      assert_on_mismatch);
+  valid &= CheckGlInt(GL_STENCIL_BACK_REF, "GL_STENCIL_BACK_REF",
+                      static_cast<GLint>(state.back_function.ref),
+                      assert_on_mismatch);
+  valid &= CheckGlInt(GL_STENCIL_BACK_VALUE_MASK, "GL_STENCIL_BACK_VALUE_MASK",
+                      static_cast<GLint>(state.back_function.mask),
+                      assert_on_mismatch);
 
   // Front Stencil Function values.
-  GL_CALL(glGetIntegerv(GL_STENCIL_FUNC, &int_value));
-  if (static_cast<GLint>(RenderFunctionToGlFunction(
-          state.front_function.function)) != int_value) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_STENCIL_REF, &int_value));
-  if (static_cast<GLint>(state.front_function.ref) != int_value) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_STENCIL_VALUE_MASK, &int_value));
-  if (static_cast<GLint>(state.front_function.mask) != int_value) {
-    assert(false);
-    return false;
-  }
+  valid &= CheckGlInt(GL_STENCIL_FUNC, "GL_STENCIL_FUNC",
+                      static_cast<GLint>(RenderFunctionToGlFunction(
+                          state.front_function.function)),
+                      assert_on_mismatch);
+  valid &= CheckGlInt(GL_STENCIL_REF, "GL_STENCIL_REF",
+                      static_cast<GLint>(state.front_function.ref),
+                      assert_on_mismatch);
+  valid &= CheckGlInt(GL_STENCIL_VALUE_MASK, "GL_STENCIL_VALUE_MASK",
+                      static_cast<GLint>(state.front_function.mask),
+                      assert_on_mismatch);
 
   // Back Stencil Operations.
-  GL_CALL(glGetIntegerv(GL_STENCIL_BACK_FAIL, &int_value));
-  if (static_cast<GLint>(StencilOpToGlOp(state.back_op.stencil_fail)) !=
-      int_value) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_STENCIL_BACK_PASS_DEPTH_FAIL, &int_value));
-  if (static_cast<GLint>(StencilOpToGlOp(state.back_op.depth_fail)) !=
-      int_value) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_STENCIL_BACK_PASS_DEPTH_PASS, &int_value));
-  if (static_cast<GLint>(StencilOpToGlOp(state.back_op.pass)) != int_value) {
-    assert(false);
-    return false;
-  }
+  valid &= CheckGlInt(
+      GL_STENCIL_BACK_FAIL, "GL_STENCIL_BACK_FAIL",
+      static_cast<GLint>(StencilOpToGlOp(state.back_op.stencil_fail)),
+      assert_on_mismatch);
+  valid &= CheckGlInt(
+      GL_STENCIL_BACK_PASS_DEPTH_FAIL, "GL_STENCIL_BACK_PASS_DEPTH_FAIL",
+      static_cast<GLint>(StencilOpToGlOp(state.back_op.depth_fail)),
+      assert_on_mismatch);
+  valid &= CheckGlInt(
+      GL_STENCIL_BACK_PASS_DEPTH_PASS, "GL_STENCIL_BACK_PASS_DEPTH_PASS",
+      static_cast<GLint>(StencilOpToGlOp(state.back_op.pass)),
+      assert_on_mismatch);
 
   // Front Stencil Operations.
-  GL_CALL(glGetIntegerv(GL_STENCIL_FAIL, &int_value));
-  if (static_cast<GLint>(StencilOpToGlOp(state.front_op.stencil_fail)) !=
-      int_value) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_STENCIL_PASS_DEPTH_FAIL, &int_value));
-  if (static_cast<GLint>(StencilOpToGlOp(state.front_op.depth_fail)) !=
-      int_value) {
-    assert(false);
-    return false;
-  }
-
-  GL_CALL(glGetIntegerv(GL_STENCIL_PASS_DEPTH_PASS, &int_value));
-  if (static_cast<GLint>(StencilOpToGlOp(state.front_op.pass)) != int_value) {
-    assert(false);
-    return false;
-  }
-
-  return true;
+  valid &= CheckGlInt(
+      GL_STENCIL_FAIL, "GL_STENCIL_FAIL",
+      static_cast<GLint>(StencilOpToGlOp(state.front_op.stencil_fail)),
+      assert_on_mismatch);
+  valid &= CheckGlInt(
+      GL_STENCIL_PASS_DEPTH_FAIL, "GL_STENCIL_PASS_DEPTH_FAIL",
+      static_cast<GLint>(StencilOpToGlOp(state.front_op.depth_fail)),
+      assert_on_mismatch);
+  valid &= CheckGlInt(
+      GL_STENCIL_PASS_DEPTH_PASS, "GL_STENCIL_PASS_DEPTH_PASS",
+      static_cast<GLint>(StencilOpToGlOp(state.front_op.pass)),
+      assert_on_mismatch);
+
+  return valid;
 }
 
-bool ValidateGlScissorState(const ScissorState& state) {
-  GLboolean bool_value;
-
-  GL_CALL(glGetBooleanv(GL_SCISSOR_TEST, &bool_value));
-  if (GlToBool(bool_value) != state.enabled) {
-    assert(false);
-    return false;
-  }
-
-  GLint int_values[4];
-
-  GL_CALL(glGetIntegerv(GL_SCISSOR_BOX, int_values));
-  if (int_values[0] != state.rect.pos.x || int_values[1] != state.rect.pos.y ||
-      int_values[2] != state.rect.size.x ||
-      int_values[3] != state.rect.size.y) {
-    assert(false);
-    return false;
-  }
-
-  return true;
+bool ValidateGlScissorState(const ScissorState& state,
+                            bool assert_on_mismatch) {
+  bool valid = CheckGlBool(GL_SCISSOR_TEST, "GL_SCISSOR_TEST", state.enabled,
+                           assert_on_mismatch);
+  valid &= CheckGlRect(GL_SCISSOR_BOX, "GL_SCISSOR_BOX", state.rect.pos,
+                       state.rect.size, assert_on_mismatch);
+  return valid;
 }
 
-bool ValidateGlViewport(const Viewport& viewport) {
-  GLint int_values[4];
-
-  GL_CALL(glGetIntegerv(GL_VIEWPORT, int_values));
-  if (int_values[0] != viewport.pos.x || int_values[1] != viewport.pos.y ||
-      int_values[2] != viewport.size.x || int_values[3] != viewport.size.y) {
-    assert(false);
-    return false;
-  }
+bool ValidateGlViewport(const Viewport& viewport, bool assert_on_mismatch) {
+  return CheckGlRect(GL_VIEWPORT, "GL_VIEWPORT", viewport.pos, viewport.size,
+                     assert_on_mismatch);
+}
 
-  return true;
+bool ValidateRenderState(const RenderState& render_state,
+                         bool assert_on_mismatch) {
+  bool valid =
+      ValidateGlBlendState(render_state.blend_state, assert_on_mismatch);
+  valid &= ValidateGlCullState(render_state.cull_state, assert_on_mismatch);
+  valid &=
+      ValidateGlScissorState(render_state.scissor_state, assert_on_mismatch);
+  valid &= ValidateGlDepthState(render_state.depth_state, assert_on_mismatch);
+  valid &= ValidateGlPointState(render_state.point_state, assert_on_mismatch);
+  valid &=
+      ValidateGlStencilState(render_state.stencil_state, assert_on_mismatch);
+  valid &= ValidateGlViewport(render_state.viewport, assert_on_mismatch);
+  return valid;
 }
 
 bool ValidateRenderState(const RenderState& render_state) {
-  if (!ValidateGlBlendState(render_state.blend_state)) {
-    return false;
-  }
-
-  if (!ValidateGlCullState(render_state.cull_state)) {
-    return false;
-  }
-
-  if (!ValidateGlScissorState(render_state.scissor_state)) {
-    return false;
-  }
-
-  if (!ValidateGlDepthState(render_state.depth_state)) {
-    return false;
-  }
-
-  if (!ValidateGlPointState(render_state.point_state)) {
-    return false;
-  }
-
-  if (!ValidateGlStencilState(render_state.stencil_state)) {
-    return false;
-  }
-
-  if (!ValidateGlViewport(render_state.viewport)) {
-    return false;
-  }
-
-  return true;
+  return ValidateRenderState(render_state, true);
 }
 
 }  // namespace fplbase
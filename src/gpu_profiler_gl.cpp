@@ -0,0 +1,245 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "fplbase/debug_markers.h"
+#include "fplbase/fpl_common.h"
+#include "fplbase/gpu_profiler.h"
+#include "fplbase/renderer.h"
+
+#ifdef _WIN32
+#define snprintf(buffer, count, format, ...) \
+  _snprintf_s(buffer, count, count, format, __VA_ARGS__)
+#endif  // _WIN32
+
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP 0x8E28
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+namespace fplbase {
+
+const int GpuProfiler::kFrameLatency;
+
+// RendererBase::SupportsTimerQueries() is never true on Apple platforms,
+// whose headers don't all declare the entry points.
+#if defined(__APPLE__)
+
+static bool LoadTimerQueries() { return false; }
+static void QueryTimestamp(GLuint /*query*/) {}
+static bool QueryAvailable(GLuint /*query*/) { return false; }
+static uint64_t QueryResult(GLuint /*query*/) { return 0; }
+static bool Disjoint() { return false; }
+
+#elif defined(FPLBASE_GLES)
+
+// GL_EXT_disjoint_timer_query's entry points aren't in the ES 3.0 headers.
+typedef void(GL_APIENTRYP QueryCounterProc)(GLuint id, GLenum target);
+typedef void(GL_APIENTRYP GetQueryObjectui64vProc)(GLuint id, GLenum pname,
+                                                   GLuint64 *params);
+static QueryCounterProc query_counter = nullptr;
+static GetQueryObjectui64vProc get_query_object_ui64v = nullptr;
+
+static bool LoadTimerQueries() {
+  query_counter = reinterpret_cast<QueryCounterProc>(
+      eglGetProcAddress("glQueryCounterEXT"));
+  get_query_object_ui64v = reinterpret_cast<GetQueryObjectui64vProc>(
+      eglGetProcAddress("glGetQueryObjectui64vEXT"));
+  return query_counter != nullptr && get_query_object_ui64v != nullptr;
+}
+
+static void QueryTimestamp(GLuint query) {
+  GL_CALL(query_counter(query, GL_TIMESTAMP));
+}
+
+static bool QueryAvailable(GLuint query) {
+  GLuint available = 0;
+  GL_CALL(glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available));
+  return available != 0;
+}
+
+static uint64_t QueryResult(GLuint query) {
+  GLuint64 result = 0;
+  GL_CALL(get_query_object_ui64v(query, GL_QUERY_RESULT, &result));
+  return result;
+}
+
+// Whether timings since the last check can't be trusted.
+static bool Disjoint() {
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  return disjoint != 0;
+}
+
+#else  // Desktop OpenGL.
+
+static bool LoadTimerQueries() { return true; }
+
+static void QueryTimestamp(GLuint query) {
+  GL_CALL(glQueryCounter(query, GL_TIMESTAMP));
+}
+
+static bool QueryAvailable(GLuint query) {
+  GLuint available = 0;
+  GL_CALL(glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available));
+  return available != 0;
+}
+
+static uint64_t QueryResult(GLuint query) {
+  GLuint64 result = 0;
+  GL_CALL(glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result));
+  return result;
+}
+
+static bool Disjoint() { return false; }
+
+#endif  // Desktop OpenGL.
+
+GpuProfiler::GpuProfiler()
+    : supported_(false),
+      current_(0),
+      in_frame_(false),
+      frame_milliseconds_(0),
+      dropped_frames_(0) {
+  const RendererBase *renderer = RendererBase::Get();
+  supported_ = renderer != nullptr && renderer->SupportsTimerQueries() &&
+               LoadTimerQueries();
+}
+
+GpuProfiler::~GpuProfiler() {
+  for (size_t i = 0; i < FPL_ARRAYSIZE(frames_); ++i) {
+    std::vector<unsigned int> &queries = frames_[i].queries;
+    if (!queries.empty()) {
+      GL_CALL(glDeleteQueries(static_cast<GLsizei>(queries.size()),
+                              &queries[0]));
+    }
+  }
+}
+
+void GpuProfiler::BeginFrame() {
+  assert(!in_frame_);
+  in_frame_ = true;
+  if (!supported_) return;
+
+  const size_t num_frames = FPL_ARRAYSIZE(frames_);
+  if (Disjoint()) {
+    for (size_t i = 0; i < num_frames; ++i) {
+      if (frames_[i].pending) ++dropped_frames_;
+      frames_[i].pending = false;
+    }
+  }
+
+  // The next slot holds the oldest frame in flight. Read back as many frames
+  // as are done, oldest first, so results_ ends up the newest of them.
+  current_ = (current_ + 1) % num_frames;
+  for (size_t i = 0; i < num_frames; ++i) {
+    Frame &frame = frames_[(current_ + i) % num_frames];
+    if (!frame.pending) continue;
+    if (!ReadBack(&frame)) break;
+    frame.pending = false;
+  }
+  Frame &frame = frames_[current_];
+  if (frame.pending) {
+    // Not done after kFrameLatency frames. Its queries are needed now.
+    ++dropped_frames_;
+    frame.pending = false;
+  }
+  frame.used = 0;
+  frame.regions.clear();
+  Timestamp();
+}
+
+void GpuProfiler::EndFrame() {
+  assert(in_frame_);
+  assert(open_regions_.empty());
+  in_frame_ = false;
+  if (!supported_) return;
+  Timestamp();
+  frames_[current_].pending = true;
+}
+
+void GpuProfiler::PushRegion(const char *name) {
+  PushDebugMarker(name);
+  if (!supported_) return;
+  assert(in_frame_);
+  Frame &frame = frames_[current_];
+  PendingRegion region;
+  region.name = name;
+  region.depth = static_cast<int>(open_regions_.size());
+  region.begin = Timestamp();
+  region.end = region.begin;
+  open_regions_.push_back(frame.regions.size());
+  frame.regions.push_back(region);
+}
+
+void GpuProfiler::PopRegion() {
+  PopDebugMarker();
+  if (!supported_) return;
+  assert(!open_regions_.empty());
+  frames_[current_].regions[open_regions_.back()].end = Timestamp();
+  open_regions_.pop_back();
+}
+
+size_t GpuProfiler::Timestamp() {
+  Frame &frame = frames_[current_];
+  if (frame.used == frame.queries.size()) {
+    GLuint query = 0;
+    GL_CALL(glGenQueries(1, &query));
+    frame.queries.push_back(query);
+  }
+  QueryTimestamp(frame.queries[frame.used]);
+  return frame.used++;
+}
+
+bool GpuProfiler::ReadBack(Frame *frame) {
+  assert(frame->used >= 2);
+  // Queries complete in order, so the last one being done means all are.
+  if (!QueryAvailable(frame->queries[frame->used - 1])) return false;
+  timestamps_.resize(frame->used);
+  for (size_t i = 0; i < frame->used; ++i) {
+    timestamps_[i] = QueryResult(frame->queries[i]);
+  }
+  const double kNanosecondsPerMillisecond = 1e6;
+  results_.resize(frame->regions.size());
+  for (size_t i = 0; i < frame->regions.size(); ++i) {
+    const PendingRegion &pending = frame->regions[i];
+    Region &region = results_[i];
+    region.name = pending.name;
+    region.depth = pending.depth;
+    const uint64_t begin = timestamps_[pending.begin];
+    const uint64_t end = std::max(timestamps_[pending.end], begin);
+    region.milliseconds =
+        static_cast<double>(end - begin) / kNanosecondsPerMillisecond;
+  }
+  frame_milliseconds_ =
+      static_cast<double>(timestamps_[frame->used - 1] - timestamps_[0]) /
+      kNanosecondsPerMillisecond;
+  return true;
+}
+
+std::string GpuProfiler::Report() const {
+  std::string report;
+  char line[256];
+  for (auto it = results_.begin(); it != results_.end(); ++it) {
+    snprintf(line, sizeof(line), "%*s%s: %.2f ms\n", 2 * it->depth, "",
+             it->name.c_str(), it->milliseconds);
+    report += line;
+  }
+  return report;
+}
+
+}  // namespace fplbase
@@ -16,10 +16,6 @@
 #include "fplbase/input.h"
 #include "fplbase/utilities.h"
 
-//#if defined(_DEBUG) || DEBUG==1
-//#define LOG_FRAMERATE
-//#endif
-
 using mathfu::mat4;
 using mathfu::vec2;
 using mathfu::vec2i;
@@ -32,6 +28,9 @@ namespace fplbase {
 InputSystem::InputSystem()
     : exit_requested_(false),
       minimized_(false),
+      replay_offset_(0),
+      replay_delta_time_(0),
+      replay_time_(0),
       frame_time_(0),
       elapsed_time_(0),
       start_time_(0),
@@ -48,6 +47,7 @@ InputSystem::InputSystem()
 }
 
 InputSystem::~InputSystem() {
+  if (IsRecordingInput()) StopInputRecording();
 #if FPLBASE_ANDROID_VR
   head_mounted_display_input_.ClearHMDJNIReference();
 #endif  // FPLBASE_ANDROID_VR
@@ -55,7 +55,8 @@ InputSystem::~InputSystem() {
 
 
 void InputSystem::ResetInputState() {
-  button_map_.clear();
+  for (int i = 0; i < kNumIndexedButtons; ++i) buttons_[i] = Button();
+  other_buttons_.clear();
 #if ANDROID_GAMEPAD
   gamepad_map_.clear();
 #endif
@@ -87,44 +88,13 @@ void InputSystem::AdvanceFrame(vec2i *window_size) {
   }
 #endif
 
-#ifdef LOG_FRAMERATE
-  // Framerate statistics over the last N frames.
-  const int kNumDeltaTimes = 64;
-  static int cur_delta_idx = 0;
-  static double delta_times[kNumDeltaTimes];
-  delta_times[cur_delta_idx++] = DeltaTime();
-  if (cur_delta_idx == kNumDeltaTimes) {
-    cur_delta_idx = 0;
-    double sum_delta = 0, min_delta = 99999, max_delta = 0;
-    const int kMaxBins = 8;
-    int bins[kMaxBins] = {0};
-    for (int i = 0; i < kNumDeltaTimes; i++) {
-      sum_delta += delta_times[i];
-      min_delta = std::min(min_delta, delta_times[i]);
-      max_delta = std::max(max_delta, delta_times[i]);
-      // Frame-count "bin".
-      // Bin 0: 0 ~ 16.6ms (=1/60s)
-      // Bin 1: 16.6 ~ 32.3ms (=2/60s)
-      // Bin 2: 32.3 ~ 50ms (=3/60s)
-      auto bin = static_cast<int>(delta_times[i] * 60.0);
-      bins[std::max(1, std::min(bin, kMaxBins - 1))]++;
-    }
-    std::ostringstream os;
-    for (int i = 1; i < kMaxBins; i++) {
-      os << bins[i] << ";";
-    }
-    LogInfo(kApplication,
-            "DeltaTime (ms) avg: %.1f, max: %.1f, min: %.1f, bins: %s",
-            (sum_delta / kNumDeltaTimes * 1000), max_delta * 1000,
-            min_delta * 1000, os.str().c_str());
-  }
-#endif
-
   // Reset our per-frame input state.
   mousewheel_delta_ = mathfu::kZeros2i;
-  for (auto it = button_map_.begin(); it != button_map_.end(); ++it) {
+  for (int i = 0; i < kNumIndexedButtons; ++i) buttons_[i].AdvanceFrame();
+  for (auto it = other_buttons_.begin(); it != other_buttons_.end(); ++it) {
     it->second.AdvanceFrame();
   }
+  input_events_.clear();
   for (auto it = pointers_.begin(); it != pointers_.end(); ++it) {
     it->mousedelta = mathfu::kZeros2i;
     if (touch_device_ && !it->used) {
@@ -146,6 +116,16 @@ void InputSystem::AdvanceFrame(vec2i *window_size) {
   }
 
   UpdateEvents(window_size);
+  if (IsReplayingInput()) ReplayInputFrame();
+#if ANDROID_GAMEPAD
+  // Gamepad events were added first, but may have come in after some of the
+  // others.
+  std::stable_sort(input_events_.begin(), input_events_.end(),
+                   [](const InputEvent &a, const InputEvent &b) {
+                     return a.time < b.time;
+                   });
+#endif  // ANDROID_GAMEPAD
+  if (IsRecordingInput()) RecordInputFrame();
 
   // Update the head mounted display input. Note this is after the mouse
   // input, as that can be treated as a trigger.
@@ -158,10 +138,30 @@ double InputSystem::Time() const { return elapsed_time_; }
 
 double InputSystem::DeltaTime() const { return frame_time_; }
 
+int InputSystem::ButtonIndex(int button) {
+  if (button < 0) {
+    return button >= -kNumNegativeButtons ? button + kNumNegativeButtons : -1;
+  }
+  if (button < kNumCharacterButtons) return kNumNegativeButtons + button;
+  if (button & FPLK_SCANCODE_MASK) {
+    const int scancode = button & ~FPLK_SCANCODE_MASK;
+    if (scancode < kNumScancodeButtons) {
+      return kNumNegativeButtons + kNumCharacterButtons + scancode;
+    }
+  }
+  return -1;
+}
+
 Button &InputSystem::GetButton(int button) {
-  auto it = button_map_.find(button);
-  return it != button_map_.end() ? it->second
-                                 : (button_map_[button] = Button());
+  const int index = ButtonIndex(button);
+  return index >= 0 ? buttons_[index] : other_buttons_[button];
+}
+
+void InputSystem::AddPointerEvent(InputEventType type, double time,
+                                  size_t pointer) {
+  const vec2i &position = pointers_[pointer].mousepos;
+  AddInputEvent(type, time, K_POINTER1 + static_cast<int>(pointer), pointer,
+                static_cast<float>(position.x), static_cast<float>(position.y));
 }
 
 Joystick &InputSystem::GetJoystick(JoystickId joystick_id) {
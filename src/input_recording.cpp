@@ -0,0 +1,219 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/file_utilities.h"
+#include "fplbase/input.h"
+#include "fplbase/logging.h"
+
+using mathfu::vec2;
+using mathfu::vec2i;
+
+namespace fplbase {
+
+// A recording is this header, followed by one block per frame of:
+//   double frame_time, double elapsed_time,
+//   int32 mousewheel_delta x, y,
+//   uint32 pointer count, then per pointer:
+//     uint64 id, int32 mousepos x, y, int32 mousedelta x, y, uint8 used,
+//   uint32 event count, then per event:
+//     int32 type, double time, int32 code, uint64 device, float x, y.
+// All in the byte order of the device that made it, since a recording is
+// meant to be replayed on the device it was made on.
+static const uint32_t kRecordingMagic = 0x494c5046;  // "FPLI"
+static const uint32_t kRecordingVersion = 1;
+
+template <typename T>
+static void Write(const T &value, std::string *data) {
+  data->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool Read(const std::string &data, size_t *offset, T *value) {
+  if (data.size() - *offset < sizeof(*value)) return false;
+  memcpy(value, data.data() + *offset, sizeof(*value));
+  *offset += sizeof(*value);
+  return true;
+}
+
+static void WriteVec2i(const vec2i &v, std::string *data) {
+  Write(static_cast<int32_t>(v.x), data);
+  Write(static_cast<int32_t>(v.y), data);
+}
+
+static bool ReadVec2i(const std::string &data, size_t *offset, vec2i *v) {
+  int32_t x, y;
+  if (!Read(data, offset, &x) || !Read(data, offset, &y)) return false;
+  *v = vec2i(x, y);
+  return true;
+}
+
+void InputSystem::StartInputRecording(const char *filename) {
+  record_filename_ = filename;
+  record_data_.clear();
+  Write(kRecordingMagic, &record_data_);
+  Write(kRecordingVersion, &record_data_);
+}
+
+bool InputSystem::StopInputRecording() {
+  if (!IsRecordingInput()) return false;
+  const bool saved = SaveFile(record_filename_.c_str(), record_data_);
+  if (!saved) {
+    LogError(kApplication, "Can't write input recording %s",
+             record_filename_.c_str());
+  }
+  record_filename_.clear();
+  record_data_.clear();
+  return saved;
+}
+
+bool InputSystem::StartInputReplay(const char *filename,
+                                   double fixed_delta_time) {
+  StopInputReplay();
+  std::string data;
+  if (!LoadFile(filename, &data)) {
+    LogError(kApplication, "Can't load input recording %s", filename);
+    return false;
+  }
+  size_t offset = 0;
+  uint32_t magic = 0, version = 0;
+  if (!Read(data, &offset, &magic) || !Read(data, &offset, &version) ||
+      magic != kRecordingMagic || version != kRecordingVersion) {
+    LogError(kApplication, "%s is not an input recording", filename);
+    return false;
+  }
+  if (offset == data.size()) return false;  // No frames to replay.
+  replay_data_.swap(data);
+  replay_offset_ = offset;
+  replay_delta_time_ = fixed_delta_time;
+  replay_time_ = elapsed_time_;
+  // Release anything held down when the replay took over.
+  ResetInputState();
+  return true;
+}
+
+void InputSystem::StopInputReplay() {
+  replay_data_.clear();
+  replay_offset_ = 0;
+}
+
+void InputSystem::RecordInputFrame() {
+  Write(frame_time_, &record_data_);
+  Write(elapsed_time_, &record_data_);
+  WriteVec2i(mousewheel_delta_, &record_data_);
+  Write(static_cast<uint32_t>(pointers_.size()), &record_data_);
+  for (auto it = pointers_.begin(); it != pointers_.end(); ++it) {
+    Write(static_cast<uint64_t>(it->id), &record_data_);
+    WriteVec2i(it->mousepos, &record_data_);
+    WriteVec2i(it->mousedelta, &record_data_);
+    Write(static_cast<uint8_t>(it->used), &record_data_);
+  }
+  Write(static_cast<uint32_t>(input_events_.size()), &record_data_);
+  for (auto it = input_events_.begin(); it != input_events_.end(); ++it) {
+    Write(static_cast<int32_t>(it->type), &record_data_);
+    Write(it->time, &record_data_);
+    Write(static_cast<int32_t>(it->code), &record_data_);
+    Write(it->device, &record_data_);
+    Write(it->x, &record_data_);
+    Write(it->y, &record_data_);
+  }
+}
+
+void InputSystem::ReplayInputFrame() {
+  const std::string &data = replay_data_;
+  size_t *offset = &replay_offset_;
+  double frame_time = 0.0, recorded_time = 0.0;
+  vec2i mousewheel_delta;
+  uint32_t num_pointers = 0;
+  bool ok = Read(data, offset, &frame_time) &&
+            Read(data, offset, &recorded_time) &&
+            ReadVec2i(data, offset, &mousewheel_delta) &&
+            Read(data, offset, &num_pointers);
+
+  // Step the replay's own clock, rather than the real one.
+  frame_time_ = replay_delta_time_ > 0.0 ? replay_delta_time_ : frame_time;
+  replay_time_ += frame_time_;
+  elapsed_time_ = replay_time_;
+  mousewheel_delta_ = mousewheel_delta;
+
+  for (uint32_t i = 0; ok && i < num_pointers; ++i) {
+    uint64_t id = 0;
+    InputPointer pointer;
+    uint8_t used = 0;
+    ok = Read(data, offset, &id) &&
+         ReadVec2i(data, offset, &pointer.mousepos) &&
+         ReadVec2i(data, offset, &pointer.mousedelta) &&
+         Read(data, offset, &used);
+    pointer.id = id;
+    pointer.used = used != 0;
+    if (ok && i < pointers_.size()) pointers_[i] = pointer;
+  }
+
+  uint32_t num_events = 0;
+  ok = ok && Read(data, offset, &num_events);
+  for (uint32_t i = 0; ok && i < num_events; ++i) {
+    int32_t type = 0, code = 0;
+    InputEvent event;
+    ok = Read(data, offset, &type) && Read(data, offset, &event.time) &&
+         Read(data, offset, &code) && Read(data, offset, &event.device) &&
+         Read(data, offset, &event.x) && Read(data, offset, &event.y);
+    if (!ok) break;
+    event.type = static_cast<InputEventType>(type);
+    event.code = code;
+    // Keep the event where it was relative to its frame.
+    event.time += elapsed_time_ - recorded_time;
+    ApplyInputEvent(event);
+    input_events_.push_back(event);
+  }
+
+  if (!ok) LogError(kApplication, "Input recording is truncated");
+  if (!ok || *offset == data.size()) StopInputReplay();
+}
+
+void InputSystem::ApplyInputEvent(const InputEvent &event) {
+  // Pointer motion and the mousewheel are replayed from their recorded
+  // state instead.
+  switch (event.type) {
+    case kInputEventButtonDown:
+    case kInputEventButtonUp:
+      GetButton(event.code).Update(event.type == kInputEventButtonDown);
+      break;
+    case kInputEventJoystickButtonDown:
+    case kInputEventJoystickButtonUp:
+      joystick_map_[event.device]
+          .GetButton(static_cast<size_t>(event.code))
+          .Update(event.type == kInputEventJoystickButtonDown);
+      break;
+    case kInputEventJoystickAxis:
+      joystick_map_[event.device].SetAxis(static_cast<size_t>(event.code),
+                                          event.x);
+      break;
+    case kInputEventJoystickHat:
+      joystick_map_[event.device].SetHat(static_cast<size_t>(event.code),
+                                         vec2(event.x, event.y));
+      break;
+#if ANDROID_GAMEPAD
+    case kInputEventGamepadButtonDown:
+    case kInputEventGamepadButtonUp:
+      GetGamepad(static_cast<AndroidInputDeviceId>(event.device))
+          .GetButton(static_cast<Gamepad::GamepadInputButton>(event.code))
+          .Update(event.type == kInputEventGamepadButtonDown);
+      break;
+#endif  // ANDROID_GAMEPAD
+    default:
+      break;
+  }
+}
+
+}  // namespace fplbase
@@ -89,10 +89,43 @@ int InputSystem::HandleAppEvents(void *userdata, void *ev) {
   return passthrough;
 }
 
+// Whether `type` is input from a keyboard, mouse, touch screen or joystick,
+// rather than an event from the system.
+static bool IsDeviceInputEvent(uint32_t type) {
+  switch (type) {
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+    case SDL_FINGERDOWN:
+    case SDL_FINGERUP:
+    case SDL_FINGERMOTION:
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+    case SDL_MOUSEMOTION:
+    case SDL_MOUSEWHEEL:
+    case SDL_JOYAXISMOTION:
+    case SDL_JOYBUTTONDOWN:
+    case SDL_JOYBUTTONUP:
+    case SDL_JOYHATMOTION:
+    case SDL_TEXTEDITING:
+    case SDL_TEXTINPUT:
+    case SDL_MULTIGESTURE:
+      return true;
+    default:
+      return false;
+  }
+}
+
 void InputSystem::UpdateEvents(mathfu::vec2i *window_size) {
+  // SDL timestamps events in milliseconds since it was initialized. Map them
+  // onto the clock of RealTime().
+  const double event_time_offset = RealTime() - SDL_GetTicks() / 1000.0;
+
   // Poll events until Q is empty.
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
+    const double time = event.common.timestamp / 1000.0 + event_time_offset;
+    // A replay supplies the input, so the input devices are ignored.
+    if (IsReplayingInput() && IsDeviceInputEvent(event.type)) continue;
     switch (event.type) {
       case SDL_QUIT:
         exit_requested_ = true;
@@ -100,6 +133,11 @@ void InputSystem::UpdateEvents(mathfu::vec2i *window_size) {
       case SDL_KEYDOWN:
       case SDL_KEYUP: {
         GetButton(event.key.keysym.sym).Update(event.key.state == SDL_PRESSED);
+        if (!event.key.repeat) {
+          AddInputEvent(event.key.state == SDL_PRESSED ? kInputEventButtonDown
+                                                       : kInputEventButtonUp,
+                        time, event.key.keysym.sym, 0, 0.0f, 0.0f);
+        }
         if (record_text_input_) {
           text_input_events_.push_back(TextInputEvent(
               kTextInputEventTypeKey, event.key.state, (event.key.repeat != 0),
@@ -112,18 +150,21 @@ void InputSystem::UpdateEvents(mathfu::vec2i *window_size) {
         touch_device_ = true;
         size_t i = UpdateDragPosition(&event.tfinger, event.type, *window_size);
         GetPointerButton(i).Update(true);
+        AddPointerEvent(kInputEventButtonDown, time, i);
         break;
       }
       case SDL_FINGERUP: {
         touch_device_ = true;
         size_t i = FindPointer(event.tfinger.fingerId);
+        AddPointerEvent(kInputEventButtonUp, time, i);
         RemovePointer(i);
         GetPointerButton(i).Update(false);
         break;
       }
       case SDL_FINGERMOTION: {
         touch_device_ = true;
-        UpdateDragPosition(&event.tfinger, event.type, *window_size);
+        size_t i = UpdateDragPosition(&event.tfinger, event.type, *window_size);
+        AddPointerEvent(kInputEventPointerMotion, time, i);
         break;
       }
 #else   // PLATFORM_MOBILE
@@ -149,6 +190,11 @@ void InputSystem::UpdateEvents(mathfu::vec2i *window_size) {
           pointers_[0].mousepos = vec2i(event.button.x, event.button.y);
         }
         pointers_[0].used = true;
+        AddInputEvent(event.button.state == SDL_PRESSED ? kInputEventButtonDown
+                                                        : kInputEventButtonUp,
+                      time, K_POINTER1 + event.button.button - 1, 0,
+                      static_cast<float>(pointers_[0].mousepos.x),
+                      static_cast<float>(pointers_[0].mousepos.y));
 #if FPLBASE_ANDROID_VR
         if (event.button.state == SDL_PRESSED) {
           head_mounted_display_input_.OnTrigger();
@@ -164,12 +210,16 @@ void InputSystem::UpdateEvents(mathfu::vec2i *window_size) {
         touch_device_ = false;
         pointers_[0].mousedelta += vec2i(event.motion.xrel, event.motion.yrel);
         pointers_[0].mousepos = vec2i(event.button.x, event.button.y);
+        AddPointerEvent(kInputEventPointerMotion, time, 0);
 #endif  // !defined(PLATFORM_MOBILE)
         break;
       }
       case SDL_MOUSEWHEEL: {
         touch_device_ = false;
         mousewheel_delta_ += vec2i(event.wheel.x, event.wheel.y);
+        AddInputEvent(kInputEventMouseWheel, time, 0, 0,
+                      static_cast<float>(event.wheel.x),
+                      static_cast<float>(event.wheel.y));
         break;
       }
       case SDL_WINDOWEVENT: {
@@ -187,6 +237,7 @@ void InputSystem::UpdateEvents(mathfu::vec2i *window_size) {
       case SDL_JOYDEVICEADDED:
       case SDL_JOYDEVICEREMOVED: {
         HandleJoystickEvent(&event);
+        AddJoystickEvent(event, time);
         break;
       }
       case SDL_TEXTEDITING:
@@ -243,6 +294,31 @@ void InputSystem::HandleJoystickEvent(Event event) {
   }
 }
 
+void InputSystem::AddJoystickEvent(Event event, double time) {
+  SDL_Event *sdl_event = static_cast<SDL_Event *>(event);
+  switch (sdl_event->type) {
+    case SDL_JOYAXISMOTION:
+      AddInputEvent(kInputEventJoystickAxis, time, sdl_event->jaxis.axis,
+                    sdl_event->jaxis.which,
+                    sdl_event->jaxis.value / kJoystickAxisRange, 0.0f);
+      break;
+    case SDL_JOYBUTTONDOWN:
+    case SDL_JOYBUTTONUP:
+      AddInputEvent(sdl_event->jbutton.state == SDL_PRESSED
+                        ? kInputEventJoystickButtonDown
+                        : kInputEventJoystickButtonUp,
+                    time, sdl_event->jbutton.button, sdl_event->jbutton.which,
+                    0.0f, 0.0f);
+      break;
+    case SDL_JOYHATMOTION: {
+      const vec2 direction = ConvertHatToVector(sdl_event->jhat.value);
+      AddInputEvent(kInputEventJoystickHat, time, sdl_event->jhat.hat,
+                    sdl_event->jhat.which, direction.x, direction.y);
+      break;
+    }
+  }
+}
+
 // Convert SDL joystick hat enum values into more generic 2d vectors.
 vec2 InputSystem::ConvertHatToVector(uint32_t hat_enum) const {
   switch (hat_enum) {
@@ -399,45 +475,57 @@ Gamepad &InputSystem::GetGamepad(AndroidInputDeviceId gamepad_device_id) {
   }
 }
 
-std::queue<AndroidInputEvent> InputSystem::unhandled_java_input_events_;
-
-const int kMaxAndroidEventsPerFrame = 100;
+SpscQueue<AndroidInputEvent, InputSystem::kMaxAndroidEvents>
+    InputSystem::unhandled_java_input_events_;
 
 void InputSystem::ReceiveGamepadEvent(AndroidInputDeviceId device_id,
                                       int event_code, int control_code, float x,
                                       float y) {
-  if (unhandled_java_input_events_.size() < kMaxAndroidEventsPerFrame) {
-    pthread_mutex_lock(&android_event_mutex);
-    unhandled_java_input_events_.push(
-        AndroidInputEvent(device_id, event_code, control_code, x, y));
-    pthread_mutex_unlock(&android_event_mutex);
-  }
+  // Timestamped here rather than when handled, which is up to a frame later.
+  unhandled_java_input_events_.Push(AndroidInputEvent(
+      device_id, event_code, control_code, x, y, SDL_GetPerformanceCounter()));
 }
 
 // Process and handle the events we have received from Java.
 void InputSystem::HandleGamepadEvents() {
   AndroidInputEvent event;
-  pthread_mutex_lock(&android_event_mutex);
-  while (unhandled_java_input_events_.size() > 0) {
-    event = unhandled_java_input_events_.front();
-    unhandled_java_input_events_.pop();
-
+  while (unhandled_java_input_events_.Pop(&event)) {
+    // A replay supplies the input, so the gamepads are ignored.
+    if (IsReplayingInput()) continue;
     Gamepad &gamepad = GetGamepad(event.device_id);
+    // On the clock of RealTime(). Signed, in case the event came before
+    // Initialize().
+    const int64_t ticks = static_cast<int64_t>(event.timestamp - start_time_);
+    const double time =
+        static_cast<double>(ticks) / static_cast<double>(time_freq_);
+    gamepad.set_last_event_time(time);
     Gamepad::GamepadInputButton button_index;
 
+    // Updates a button, and records an event if that changes it.
+    auto update = [&](Gamepad::GamepadInputButton index, bool down) {
+      Button &button = gamepad.GetButton(index);
+      if (button.is_down() != down) {
+        AddInputEvent(down ? kInputEventGamepadButtonDown
+                           : kInputEventGamepadButtonUp,
+                      time, index, static_cast<uint64_t>(event.device_id),
+                      0.0f, 0.0f);
+      }
+      button.Update(down);
+    };
+
     switch (event.event_code) {
       case AKEY_EVENT_ACTION_DOWN:
         button_index = static_cast<Gamepad::GamepadInputButton>(
             Gamepad::GetGamepadCodeFromJavaKeyCode(event.control_code));
         if (button_index != Gamepad::kInvalid) {
-          gamepad.GetButton(button_index).Update(true);
+          update(button_index, true);
         }
         break;
       case AKEY_EVENT_ACTION_UP:
         button_index = static_cast<Gamepad::GamepadInputButton>(
             Gamepad::GetGamepadCodeFromJavaKeyCode(event.control_code));
         if (button_index != Gamepad::kInvalid) {
-          gamepad.GetButton(button_index).Update(false);
+          update(button_index, false);
         }
         break;
       case AMOTION_EVENT_ACTION_MOVE:
@@ -446,16 +534,13 @@ void InputSystem::HandleGamepadEvents() {
         const bool up = event.y < -kGamepadHatThreshold;
         const bool down = event.y > kGamepadHatThreshold;
 
-        gamepad.GetButton(Gamepad::kLeft).Update(left);
-        gamepad.GetButton(Gamepad::kRight).Update(right);
-        gamepad.GetButton(Gamepad::kUp).Update(up);
-        gamepad.GetButton(Gamepad::kDown).Update(down);
+        update(Gamepad::kLeft, left);
+        update(Gamepad::kRight, right);
+        update(Gamepad::kUp, up);
+        update(Gamepad::kDown, down);
         break;
     }
   }
-  // Clear the queue
-  std::queue<AndroidInputEvent>().swap(unhandled_java_input_events_);
-  pthread_mutex_unlock(&android_event_mutex);
 }
 
 // Reset the per-frame input on all our sub-elements
@@ -476,8 +561,6 @@ struct JavaToGamepadMapping {
   int gamepad_code;
 };
 
-pthread_mutex_t InputSystem::android_event_mutex = PTHREAD_MUTEX_INITIALIZER;
-
 int Gamepad::GetGamepadCodeFromJavaKeyCode(int java_keycode) {
   // Note that DpadCenter maps onto ButtonA.  They have the same functional
   // purpose, and anyone dealing with a gamepad isn't going to want to deal with
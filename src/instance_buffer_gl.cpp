@@ -0,0 +1,81 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "fplbase/instance_buffer.h"
+#include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/renderer.h"
+
+namespace fplbase {
+
+const int InstanceBuffer::kMaxAttributes;
+
+InstanceBuffer::InstanceBuffer(const Attribute *format)
+    : instance_size_(0), buffer_(InvalidBufferHandle()), capacity_(0) {
+  assert(Mesh::IsValidInstanceFormat(format));
+  // A valid format uses each attribute at most once, so it always fits.
+  int i = 0;
+  do {
+    assert(i < kMaxAttributes);
+    format_[i] = format[i];
+  } while (format[i++] != kEND);
+  instance_size_ = Mesh::VertexSize(format_);
+}
+
+InstanceBuffer::~InstanceBuffer() {
+  if (ValidBufferHandle(buffer_)) {
+    auto buffer = GlBufferHandle(buffer_);
+    GL_CALL(glDeleteBuffers(1, &buffer));
+  }
+  RendererBase::TrackGpuMemory(kGpuMemoryMeshes, capacity_, 0);
+}
+
+void InstanceBuffer::Clear() { staging_.clear(); }
+
+void *InstanceBuffer::Add(size_t count) {
+  const size_t offset = staging_.size();
+  staging_.resize(offset + count * instance_size_);
+  return count ? &staging_[offset] : nullptr;
+}
+
+size_t InstanceBuffer::Add(const void *data, size_t count) {
+  const size_t first = this->count();
+  if (count) memcpy(Add(count), data, count * instance_size_);
+  return first;
+}
+
+void InstanceBuffer::Upload() {
+  if (staging_.empty()) return;
+  const size_t size = staging_.size();
+  if (!ValidBufferHandle(buffer_)) {
+    GLuint buffer = 0;
+    GL_CALL(glGenBuffers(1, &buffer));
+    buffer_ = BufferHandleFromGl(buffer);
+  }
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, GlBufferHandle(buffer_)));
+  if (size > capacity_) {
+    // Grow geometrically, so an instance count that creeps up frame by frame
+    // doesn't reallocate every frame.
+    const size_t capacity = std::max(size, 2 * capacity_);
+    GL_CALL(glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW));
+    RendererBase::TrackGpuMemory(kGpuMemoryMeshes, capacity_, capacity);
+    capacity_ = capacity;
+  }
+  GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, 0, size, &staging_[0]));
+  RendererBase::CountRenderWork(&RenderCounters::buffer_upload_bytes, size);
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
+}  // namespace fplbase
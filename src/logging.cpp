@@ -12,10 +12,197 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "fplbase/logging.h"
 
+#if defined(_WIN32)
+#define vsnprintf(buffer, count, format, args) \
+  _vsnprintf_s(buffer, count, _TRUNCATE, format, args)
+#endif
+
 namespace fplbase {
 
+// How often the async logging thread writes the queued messages.
+static const int kAsyncLogFlushIntervalMs = 10;
+
+static_assert((kAsyncLogQueueSize & (kAsyncLogQueueSize - 1)) == 0,
+              "kAsyncLogQueueSize must be a power of 2.");
+
+namespace {
+
+// A slot in AsyncLog's ring. `sequence` says whose turn it is: the producer
+// claiming position `pos` waits for `pos`, the writer reading it for
+// `pos + 1`.
+struct AsyncLogCell {
+  std::atomic<size_t> sequence;
+  LogCategory category;
+  bool error;
+  char text[kAsyncLogMessageSize];
+};
+
+// A bounded lock-free queue of formatted messages (Dmitry Vyukov's bounded
+// MPMC queue, with a single consumer), and the thread that writes them.
+class AsyncLog {
+ public:
+  AsyncLog()
+      : enqueue_pos_(0),
+        dequeue_pos_(0),
+        enabled_(false),
+        dropped_(0),
+        stop_(false) {
+    for (size_t i = 0; i < kAsyncLogQueueSize; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+  ~AsyncLog() { SetEnabled(false); }
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+  size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  void SetEnabled(bool enabled) {
+    if (enabled == this->enabled()) return;
+    if (enabled) {
+      stop_ = false;
+      thread_ = std::thread(&AsyncLog::WriterThread, this);
+      enabled_.store(true, std::memory_order_relaxed);
+      return;
+    }
+    enabled_.store(false, std::memory_order_relaxed);
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+      cv_.notify_all();
+    }
+    thread_.join();
+    Flush();
+  }
+
+  // Never blocks. Drops the message if the queue is full.
+  void Push(LogCategory category, bool error, const char *fmt, va_list args) {
+    AsyncLogCell *cell;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & (kAsyncLogQueueSize - 1)];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t turn =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (turn == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (turn < 0) {
+        // The writer is yet to get to the message a lap behind.
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->category = category;
+    cell->error = error;
+    vsnprintf(cell->text, kAsyncLogMessageSize, fmt, args);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+  }
+
+  // Writes the messages queued so far on the calling thread.
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Write();
+  }
+
+ private:
+  void WriterThread() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+      cv_.wait_for(lock, std::chrono::milliseconds(kAsyncLogFlushIntervalMs));
+      Write();
+    }
+  }
+
+  // Called with `mutex_` held, which makes this the only consumer. Stops at
+  // the first message still being formatted, to keep them in order.
+  void Write() {
+    for (;;) {
+      AsyncLogCell &cell = cells_[dequeue_pos_ & (kAsyncLogQueueSize - 1)];
+      if (cell.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+        return;
+      }
+      if (cell.error) {
+        WriteRaw(LogErrorRaw, cell.category, "%s", cell.text);
+      } else {
+        WriteRaw(LogInfoRaw, cell.category, "%s", cell.text);
+      }
+      cell.sequence.store(dequeue_pos_ + kAsyncLogQueueSize,
+                          std::memory_order_release);
+      ++dequeue_pos_;
+    }
+  }
+
+  static void WriteRaw(void (*log)(LogCategory, const char *, va_list),
+                       LogCategory category, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log(category, fmt, args);
+    va_end(args);
+  }
+
+  AsyncLogCell cells_[kAsyncLogQueueSize];
+  std::atomic<size_t> enqueue_pos_;
+  // Only touched with `mutex_` held.
+  size_t dequeue_pos_;
+  std::atomic<bool> enabled_;
+  std::atomic<size_t> dropped_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+  bool stop_;
+};
+
+AsyncLog g_async_log;
+
+}  // namespace
+
+void SetAsyncLogging(bool enabled) { g_async_log.SetEnabled(enabled); }
+
+bool IsAsyncLogging() { return g_async_log.enabled(); }
+
+void FlushLog() { g_async_log.Flush(); }
+
+size_t NumDroppedLogMessages() { return g_async_log.dropped(); }
+
+void LogInfo(LogCategory category, const char *fmt, va_list args) {
+  if (g_async_log.enabled()) {
+    g_async_log.Push(category, false, fmt, args);
+  } else {
+    LogInfoRaw(category, fmt, args);
+  }
+}
+
+void LogError(LogCategory category, const char *fmt, va_list args) {
+  if (g_async_log.enabled()) {
+    g_async_log.Push(category, true, fmt, args);
+  } else {
+    LogErrorRaw(category, fmt, args);
+  }
+}
+
+void LogInfo(const char *fmt, va_list args) {
+  LogInfo(kApplication, fmt, args);
+}
+
+void LogError(const char *fmt, va_list args) {
+  LogError(kApplication, fmt, args);
+}
+
 void LogInfo(LogCategory category, const char *fmt, ...) {
   va_list args;
   va_start(args, fmt);
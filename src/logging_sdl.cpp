@@ -35,20 +35,12 @@ static_assert(kInput == static_cast<LogCategory>(SDL_LOG_CATEGORY_INPUT),
 static_assert(kCustom == static_cast<LogCategory>(SDL_LOG_CATEGORY_CUSTOM),
               "update kCustom");
 
-void LogInfo(LogCategory category, const char *fmt, va_list args) {
+void LogInfoRaw(LogCategory category, const char *fmt, va_list args) {
   SDL_LogMessageV(category, SDL_LOG_PRIORITY_INFO, fmt, args);
 }
 
-void LogError(LogCategory category, const char *fmt, va_list args) {
+void LogErrorRaw(LogCategory category, const char *fmt, va_list args) {
   SDL_LogMessageV(category, SDL_LOG_PRIORITY_ERROR, fmt, args);
 }
 
-void LogInfo(const char *fmt, va_list args) {
-  LogInfo(kApplication, fmt, args);
-}
-
-void LogError(const char *fmt, va_list args) {
-  LogError(kApplication, fmt, args);
-}
-
 }  // namespace fplbase
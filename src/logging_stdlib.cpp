@@ -22,42 +22,26 @@
 namespace fplbase {
 
 #if defined(__ANDROID__)
-void LogInfo(LogCategory category, const char *fmt, va_list args) {
+void LogInfoRaw(LogCategory category, const char *fmt, va_list args) {
   (void)category;
-  LogInfo(fmt, args);
-}
-
-void LogError(LogCategory category, const char *fmt, va_list args) {
-  (void)category;
-  LogError(fmt, args);
-}
-
-void LogInfo(const char *fmt, va_list args) {
   __android_log_vprint(ANDROID_LOG_VERBOSE, "fplbase", fmt, args);
 }
 
-void LogError(const char *fmt, va_list args) {
+void LogErrorRaw(LogCategory category, const char *fmt, va_list args) {
+  (void)category;
   __android_log_vprint(ANDROID_LOG_ERROR, "fplbase", fmt, args);
 }
 
 #else
 
-void LogInfo(LogCategory category, const char *fmt, va_list args) {
+void LogInfoRaw(LogCategory category, const char *fmt, va_list args) {
   (void)category;
-  LogInfo(fmt, args);
-}
-
-void LogError(LogCategory category, const char *fmt, va_list args) {
-  (void)category;
-  LogError(fmt, args);
-}
-
-void LogInfo(const char *fmt, va_list args) {
   vprintf(fmt, args);
   printf("\n");
 }
 
-void LogError(const char *fmt, va_list args) {
+void LogErrorRaw(LogCategory category, const char *fmt, va_list args) {
+  (void)category;
   vfprintf(stderr, fmt, args);
   fprintf(stderr, "\n");
 }
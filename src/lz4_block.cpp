@@ -0,0 +1,152 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/internal/lz4_block.h"
+
+namespace fplbase {
+
+static const size_t kMinMatch = 4;
+// The format requires the last 5 bytes to be literals, and the last match to
+// start at least 12 bytes before the end.
+static const size_t kLastLiterals = 5;
+static const size_t kMatchStartLimit = 12;
+static const size_t kMaxOffset = 65535;
+static const int kHashBits = 14;
+
+static inline uint32_t Read32(const uint8_t *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint32_t Hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+// Writes the remainder of a length that didn't fit in 4 bits of the token.
+static uint8_t *WriteLength(size_t length, uint8_t *dest) {
+  for (; length >= 255; length -= 255) *dest++ = 255;
+  *dest++ = static_cast<uint8_t>(length);
+  return dest;
+}
+
+// Reads the remainder of a length, returning false when out of input.
+static bool ReadLength(const uint8_t **src, const uint8_t *end,
+                       size_t *length) {
+  uint8_t byte;
+  do {
+    if (*src >= end) return false;
+    byte = *(*src)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// Writes a sequence of literals, followed by a match unless `match_length`
+// is 0.
+static uint8_t *WriteSequence(const uint8_t *literals, size_t num_literals,
+                              size_t offset, size_t match_length,
+                              uint8_t *dest) {
+  uint8_t *token = dest++;
+  *token = static_cast<uint8_t>(std::min<size_t>(num_literals, 15) << 4);
+  if (num_literals >= 15) dest = WriteLength(num_literals - 15, dest);
+  if (num_literals) memcpy(dest, literals, num_literals);
+  dest += num_literals;
+  if (match_length == 0) return dest;
+  *dest++ = static_cast<uint8_t>(offset);
+  *dest++ = static_cast<uint8_t>(offset >> 8);
+  const size_t length = match_length - kMinMatch;
+  *token |= static_cast<uint8_t>(std::min<size_t>(length, 15));
+  if (length >= 15) dest = WriteLength(length - 15, dest);
+  return dest;
+}
+
+size_t Lz4BlockBound(size_t size) { return size + size / 255 + 16; }
+
+size_t CompressLz4Block(const uint8_t *src, size_t size, uint8_t *dest) {
+  uint8_t *out = dest;
+  size_t anchor = 0;
+  if (size > kMatchStartLimit) {
+    // Positions + 1 of the last occurrence of each hashed 4 byte sequence.
+    std::vector<uint32_t> table(1 << kHashBits, 0);
+    const size_t match_start_end = size - kMatchStartLimit;
+    for (size_t i = 0; i < match_start_end;) {
+      const uint32_t sequence = Read32(src + i);
+      uint32_t &entry = table[Hash(sequence)];
+      const size_t candidate = entry;
+      entry = static_cast<uint32_t>(i + 1);
+      if (candidate == 0 || i - (candidate - 1) > kMaxOffset ||
+          Read32(src + candidate - 1) != sequence) {
+        ++i;
+        continue;
+      }
+      const size_t match = candidate - 1;
+      const size_t max_length = size - kLastLiterals - i;
+      size_t length = kMinMatch;
+      while (length < max_length && src[match + length] == src[i + length]) {
+        ++length;
+      }
+      out = WriteSequence(src + anchor, i - anchor, i - match, length, out);
+      i += length;
+      anchor = i;
+    }
+  }
+  out = WriteSequence(src + anchor, size - anchor, 0, 0, out);
+  return static_cast<size_t>(out - dest);
+}
+
+bool DecompressLz4Block(const uint8_t *src, size_t src_size, uint8_t *dest,
+                        size_t dest_size) {
+  const uint8_t *in = src;
+  const uint8_t *in_end = src + src_size;
+  uint8_t *out = dest;
+  uint8_t *out_end = dest + dest_size;
+  while (in < in_end) {
+    const uint8_t token = *in++;
+    size_t num_literals = token >> 4;
+    if (num_literals == 15 && !ReadLength(&in, in_end, &num_literals)) {
+      return false;
+    }
+    if (num_literals > static_cast<size_t>(in_end - in) ||
+        num_literals > static_cast<size_t>(out_end - out)) {
+      return false;
+    }
+    if (num_literals) memcpy(out, in, num_literals);
+    in += num_literals;
+    out += num_literals;
+    // The last sequence has no match.
+    if (in == in_end) break;
+
+    if (in_end - in < 2) return false;
+    const size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    if (offset == 0 || offset > static_cast<size_t>(out - dest)) return false;
+    size_t length = token & 15;
+    if (length == 15 && !ReadLength(&in, in_end, &length)) return false;
+    length += kMinMatch;
+    if (length > static_cast<size_t>(out_end - out)) return false;
+    const uint8_t *match = out - offset;
+    if (offset >= length) {
+      memcpy(out, match, length);
+    } else {
+      // Overlapping, e.g. a run of a repeated byte: copy in order.
+      for (size_t i = 0; i < length; ++i) out[i] = match[i];
+    }
+    out += length;
+  }
+  return out == out_end;
+}
+
+}  // namespace fplbase
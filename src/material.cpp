@@ -51,6 +51,25 @@ static_assert(
 static_assert(kFormatCount == kFormatLuminanceAlpha + 1,
               "Please update static_assert above with new enum values.");
 
+// The format and flags to load texture `index` of `matdef` with.
+static TextureFormat TextureFormatFromMaterialDef(
+    const matdef::Material *matdef, flatbuffers::uoffset_t index) {
+  return matdef->desired_format() && index < matdef->desired_format()->size()
+             ? static_cast<TextureFormat>(matdef->desired_format()->Get(index))
+             : kFormatAuto;
+}
+
+static TextureFlags TextureFlagsFromMaterialDef(const matdef::Material *matdef,
+                                                flatbuffers::uoffset_t index) {
+  return (matdef->mipmaps() ? kTextureFlagsUseMipMaps : kTextureFlagsNone) |
+         (matdef->is_cubemap() && matdef->is_cubemap()->Get(index)
+              ? kTextureFlagsIsCubeMap
+              : kTextureFlagsNone) |
+         (matdef->wrapmode() == matdef::TextureWrap_CLAMP
+              ? kTextureFlagsClampToEdge
+              : kTextureFlagsNone);
+}
+
 void Material::Set(Renderer &renderer) {
   renderer.SetBlendMode(blend_mode_);
   for (size_t i = 0; i < textures_.size(); i++) textures_[i]->Set(i);
@@ -67,19 +86,9 @@ Material *Material::LoadFromMaterialDef(const matdef::Material *matdef,
     mat->set_blend_mode(static_cast<BlendMode>(matdef->blendmode()));
     for (size_t i = 0; i < matdef->texture_filenames()->size(); i++) {
       flatbuffers::uoffset_t index = static_cast<flatbuffers::uoffset_t>(i);
-      auto format =
-          matdef->desired_format() && i < matdef->desired_format()->size()
-              ? static_cast<TextureFormat>(matdef->desired_format()->Get(index))
-              : kFormatAuto;
-      auto tex = tlf(
-          matdef->texture_filenames()->Get(index)->c_str(), format,
-          (matdef->mipmaps() ? kTextureFlagsUseMipMaps : kTextureFlagsNone) |
-              (matdef->is_cubemap() && matdef->is_cubemap()->Get(index)
-                   ? kTextureFlagsIsCubeMap
-                   : kTextureFlagsNone) |
-              (matdef->wrapmode() == matdef::TextureWrap_CLAMP
-                   ? kTextureFlagsClampToEdge
-                   : kTextureFlagsNone));
+      auto tex = tlf(matdef->texture_filenames()->Get(index)->c_str(),
+                     TextureFormatFromMaterialDef(matdef, index),
+                     TextureFlagsFromMaterialDef(matdef, index));
       if (!tex) {
         delete mat;
         return nullptr;
@@ -96,16 +105,53 @@ Material *Material::LoadFromMaterialDef(const matdef::Material *matdef,
   return nullptr;
 }
 
+void Material::LoadTexturesFromMaterialDef(const matdef::Material *matdef,
+                                           const TextureLoaderFn &tlf) {
+  if (!matdef || !matdef->texture_filenames()) return;
+  for (flatbuffers::uoffset_t i = 0; i < matdef->texture_filenames()->size();
+       i++) {
+    tlf(matdef->texture_filenames()->Get(i)->c_str(),
+        TextureFormatFromMaterialDef(matdef, i),
+        TextureFlagsFromMaterialDef(matdef, i));
+  }
+}
+
+const matdef::Material *Material::LoadMaterialDef(const char *filename,
+                                                  FileView *file) {
+  if (!file->Load(filename)) return nullptr;
+  flatbuffers::Verifier verifier(file->data(), file->size());
+  assert(matdef::VerifyMaterialBuffer(verifier));
+  return matdef::GetMaterial(file->data());
+}
+
+// Appends the bytes of `value` to `key`.
+template <typename T>
+static void AppendToKey(T value, std::string *key) {
+  key->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+std::string Material::ContentKey(const matdef::Material *matdef) {
+  std::string key;
+  if (!matdef) return key;
+  AppendToKey(static_cast<int32_t>(matdef->blendmode()), &key);
+  if (!matdef->texture_filenames()) return key;
+  for (flatbuffers::uoffset_t i = 0; i < matdef->texture_filenames()->size();
+       i++) {
+    AppendToKey(static_cast<int32_t>(TextureFormatFromMaterialDef(matdef, i)),
+                &key);
+    AppendToKey(static_cast<int32_t>(TextureFlagsFromMaterialDef(matdef, i)),
+                &key);
+    // Including the terminating zero, so the names can't run together.
+    const flatbuffers::String *filename = matdef->texture_filenames()->Get(i);
+    key.append(filename->c_str(), filename->size() + 1);
+  }
+  return key;
+}
+
 Material *Material::LoadFromMaterialDef(const char *filename,
                                         const TextureLoaderFn &tlf) {
-  const matdef::Material *def = nullptr;
-  std::string flatbuf;
-  if (LoadFile(filename, &flatbuf)) {
-    flatbuffers::Verifier verifier(
-        reinterpret_cast<const uint8_t *>(flatbuf.c_str()), flatbuf.length());
-    assert(matdef::VerifyMaterialBuffer(verifier));
-    def = matdef::GetMaterial(flatbuf.c_str());
-  }
+  FileView flatbuf;
+  const matdef::Material *def = LoadMaterialDef(filename, &flatbuf);
   Material *mat = LoadFromMaterialDef(def, tlf);
   if (!mat) {
     RendererBase::Get()->set_last_error(std::string("Couldn\'t load: ")
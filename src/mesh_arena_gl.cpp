@@ -0,0 +1,152 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/mesh_arena.h"
+#include "fplbase/render_utils.h"
+#include "fplbase/renderer.h"
+#include "vertex_bindings_gl.h"
+
+namespace fplbase {
+
+const size_t MeshArena::kMaxPageVertices;
+
+static bool SameFormat(const Attribute *a, const Attribute *b) {
+  for (;; ++a, ++b) {
+    if (*a != *b) return false;
+    if (*a == kEND) return true;
+  }
+}
+
+MeshArena::MeshArena(const Attribute *format, size_t page_vertices,
+                     size_t page_indices)
+    : vertex_size_(Mesh::VertexSize(format)),
+      page_vertices_(std::min(page_vertices, kMaxPageVertices)),
+      page_indices_(page_indices),
+      gpu_memory_size_(0) {
+  assert(Mesh::IsValidFormat(format));
+  for (int i = 0; i < Mesh::kMaxAttributes; ++i) {
+    format_[i] = format[i];
+    if (format[i] == kEND) break;
+  }
+}
+
+MeshArena::~MeshArena() {
+  for (auto it = pages_.begin(); it != pages_.end(); ++it) {
+    assert(it->num_meshes == 0);
+    VertexBindings::DeleteVertexBuffer(GlBufferHandle(it->vbo));
+    GLuint ibo = GlBufferHandle(it->ibo);
+    GL_CALL(glDeleteBuffers(1, &ibo));
+    if (ValidBufferHandle(it->vao)) {
+      VertexBindings::DeleteVertexArray(GlBufferHandle(it->vao));
+    }
+  }
+  RendererBase::TrackGpuMemory(kGpuMemoryMeshes, gpu_memory_size_, 0);
+}
+
+void MeshArena::CreatePage() {
+  pages_.push_back(Page());
+  Page &page = pages_.back();
+
+  GLuint vbo = 0;
+  GL_CALL(glGenBuffers(1, &vbo));
+  page.vbo = BufferHandleFromGl(vbo);
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+  GL_CALL(glBufferData(GL_ARRAY_BUFFER, page_vertices_ * vertex_size_, nullptr,
+                       GL_STATIC_DRAW));
+
+  if (RendererBase::Get()->feature_level() >= kFeatureLevel30) {
+    GLuint vao = 0;
+    GL_CALL(glGenVertexArrays(1, &vao));
+    page.vao = BufferHandleFromGl(vao);
+    VertexBindings::BindVertexArrayObject(vao);
+    SetAttributes(vbo, format_, static_cast<int>(vertex_size_), nullptr);
+    VertexBindings::BindVertexArrayObject(0);
+  }
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+  GLuint ibo = 0;
+  GL_CALL(glGenBuffers(1, &ibo));
+  page.ibo = BufferHandleFromGl(ibo);
+  // Don't change the index buffer of a VAO the last draw left bound.
+  VertexBindings::FlushBindings();
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo));
+  GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                       page_indices_ * sizeof(uint16_t), nullptr,
+                       GL_STATIC_DRAW));
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+
+  const size_t size =
+      gpu_memory_size_ + page_vertices_ * vertex_size_ +
+      page_indices_ * sizeof(uint16_t);
+  RendererBase::TrackGpuMemory(kGpuMemoryMeshes, gpu_memory_size_, size);
+  gpu_memory_size_ = size;
+}
+
+bool MeshArena::AllocateVertices(const void *vertex_data, size_t count,
+                                 size_t vertex_size, const Attribute *format,
+                                 size_t *page, uint32_t *first_vertex) {
+  if (count == 0 || count > page_vertices_ || vertex_size != vertex_size_ ||
+      !SameFormat(format, format_)) {
+    return false;
+  }
+  size_t i = 0;
+  while (i < pages_.size() &&
+         pages_[i].num_vertices + count > page_vertices_) {
+    ++i;
+  }
+  if (i == pages_.size()) CreatePage();
+
+  Page &p = pages_[i];
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, GlBufferHandle(p.vbo)));
+  GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, p.num_vertices * vertex_size_,
+                          count * vertex_size_, vertex_data));
+  RendererBase::CountRenderWork(&RenderCounters::buffer_upload_bytes,
+                                count * vertex_size_);
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+  *page = i;
+  *first_vertex = static_cast<uint32_t>(p.num_vertices);
+  p.num_vertices += count;
+  p.num_meshes++;
+  return true;
+}
+
+bool MeshArena::AllocateIndices(size_t page, const uint16_t *indices,
+                                size_t count, size_t *offset) {
+  Page &p = pages_[page];
+  if (p.num_indices + count > page_indices_) return false;
+  *offset = p.num_indices * sizeof(uint16_t);
+  VertexBindings::FlushBindings();
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GlBufferHandle(p.ibo)));
+  GL_CALL(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, *offset,
+                          count * sizeof(uint16_t), indices));
+  RendererBase::CountRenderWork(&RenderCounters::buffer_upload_bytes,
+                                count * sizeof(uint16_t));
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+  p.num_indices += count;
+  return true;
+}
+
+void MeshArena::Release(size_t page) {
+  Page &p = pages_[page];
+  assert(p.num_meshes > 0);
+  if (--p.num_meshes == 0) {
+    p.num_vertices = 0;
+    p.num_indices = 0;
+  }
+}
+
+}  // namespace fplbase
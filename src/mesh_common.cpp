@@ -14,14 +14,20 @@
 
 #include "precompiled.h"
 
+#include <cfloat>
+#include <thread>
 #include <utility>
 
 #include "fplbase/flatbuffer_utils.h"
 #include "fplbase/fpl_common.h"
 #include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/internal/vertex_quantization.h"
 #include "fplbase/mesh.h"
+#include "fplbase/renderer.h"
+#include "fplbase/skinning.h"
 #include "fplbase/utilities.h"
 
+#include "materials_generated.h"
 #include "mesh_generated.h"
 
 using mathfu::mat4;
@@ -51,14 +57,24 @@ static_assert(
         kTexCoord2us ==
             static_cast<Attribute>(meshdef::Attribute_TexCoord2us) &&
         kOrientation4f ==
-            static_cast<Attribute>(meshdef::Attribute_Orientation4f),
+            static_cast<Attribute>(meshdef::Attribute_Orientation4f) &&
+        kPosition3h == static_cast<Attribute>(meshdef::Attribute_Position3h) &&
+        kNormalOct2s ==
+            static_cast<Attribute>(meshdef::Attribute_NormalOct2s) &&
+        kOrientationPacked ==
+            static_cast<Attribute>(meshdef::Attribute_OrientationPacked) &&
+        kTexCoord2h == static_cast<Attribute>(meshdef::Attribute_TexCoord2h),
     "Attribute enums in mesh.h and mesh.fbs must match.");
 
+// Copies the first `count` elements of `attr` into every `stride` bytes from
+// `*dest`, and moves `*dest` on to the next attribute of the first vertex.
 template <typename T>
-void CopyAttribute(const T *attr, uint8_t *&buf) {
-  auto dest = (T *)buf;
-  *dest = *attr;
-  buf += sizeof(T);
+void InterleaveAttribute(const flatbuffers::Vector<const T *> *attr,
+                         size_t count, size_t stride, uint8_t **dest) {
+  assert(attr->size() >= count);
+  InterleaveStructs(reinterpret_cast<const T *>(attr->Data()), count, stride,
+                    *dest);
+  *dest += sizeof(T);
 }
 
 }  // namespace
@@ -73,7 +89,13 @@ Mesh::Mesh(const char *filename, MaterialCreateFn material_create_fn,
       min_position_(mathfu::kZeros3f),
       max_position_(mathfu::kZeros3f),
       default_bone_transform_inverses_(nullptr),
-      material_create_fn_(std::move(material_create_fn)) {}
+      material_create_fn_(std::move(material_create_fn)),
+      map_file_(false),
+      arena_(nullptr),
+      arena_page_(kNoArenaPage),
+      arena_first_vertex_(0),
+      mapped_size_(0),
+      gpu_memory_size_(0) {}
 
 Mesh::Mesh(const void *vertex_data, size_t count, size_t vertex_size,
            const Attribute *format, vec3 *max_position, vec3 *min_position,
@@ -84,7 +106,13 @@ Mesh::Mesh(const void *vertex_data, size_t count, size_t vertex_size,
       num_vertices_(0),
       min_position_(mathfu::kZeros3f),
       max_position_(mathfu::kZeros3f),
-      default_bone_transform_inverses_(nullptr) {
+      default_bone_transform_inverses_(nullptr),
+      map_file_(false),
+      arena_(nullptr),
+      arena_page_(kNoArenaPage),
+      arena_first_vertex_(0),
+      mapped_size_(0),
+      gpu_memory_size_(0) {
   LoadFromMemory(vertex_data, count, vertex_size, format, max_position,
                  min_position);
 }
@@ -112,6 +140,13 @@ bool Mesh::IsValidFormat(const Attribute *attributes) {
       case kColor4ub:       index = kAttributeColor;         break;
       case kBoneIndices4ub: index = kAttributeBoneIndices;   break;
       case kBoneWeights4ub: index = kAttributeBoneWeights;   break;
+      case kPosition3h:     index = kAttributePosition;      break;
+      case kNormalOct2s:    index = kAttributeNormal;        break;
+      case kOrientationPacked: index = kAttributeOrientation; break;
+      case kTexCoord2h:     index = kAttributeTexCoord;      break;
+      case kInstanceTransform3x4f:
+      case kInstanceColor4ub:
+      case kInstancePaletteOffset1f: return false;
       case kEND:            return seen[kAttributePosition];
     }
     // clang-format on
@@ -125,6 +160,22 @@ bool Mesh::IsValidFormat(const Attribute *attributes) {
   return false;
 }
 
+bool Mesh::IsValidInstanceFormat(const Attribute *attributes) {
+  bool seen[3] = {false};
+  for (size_t count = 0;; ++count, ++attributes) {
+    size_t index = 0;
+    switch (*attributes) {
+      case kInstanceTransform3x4f:   index = 0; break;
+      case kInstanceColor4ub:        index = 1; break;
+      case kInstancePaletteOffset1f: index = 2; break;
+      case kEND: return count > 0;
+      default: return false;
+    }
+    if (seen[index]) return false;
+    seen[index] = true;
+  }
+}
+
 size_t Mesh::AttributeOffset(const Attribute *attributes, Attribute end) {
   assert(IsValidFormat(attributes));
 
@@ -146,6 +197,13 @@ size_t Mesh::AttributeOffset(const Attribute *attributes, Attribute end) {
       case kColor4ub:       size += 4;                    break;
       case kBoneIndices4ub: size += 4;                    break;
       case kBoneWeights4ub: size += 4;                    break;
+      case kPosition3h:     size += 4 * sizeof(uint16_t); break;
+      case kNormalOct2s:    size += 2 * sizeof(int16_t);  break;
+      case kOrientationPacked: size += sizeof(uint32_t);  break;
+      case kTexCoord2h:     size += 2 * sizeof(uint16_t); break;
+      case kInstanceTransform3x4f: size += 12 * sizeof(float); break;
+      case kInstanceColor4ub: size += 4;                  break;
+      case kInstancePaletteOffset1f: size += sizeof(float); break;
       case kEND:            return size;
     }
     // clang-format on
@@ -156,31 +214,133 @@ size_t Mesh::VertexSize(const Attribute *attributes) {
   return AttributeOffset(attributes, kEND);
 }
 
+// The bounds of the vertices in `ivd` that `indices` use. Returns false if
+// the vertices have no positions.
+template <typename T>
+static bool IndexedBounds(const Mesh::InterleavedVertexData &ivd,
+                          const T *indices, size_t count, vec3 *min_position,
+                          vec3 *max_position) {
+  const Attribute *format = ivd.format.data();
+  const size_t vertex_size = Mesh::VertexSize(format);
+  const size_t offset3f = Mesh::AttributeOffset(format, kPosition3f);
+  const size_t offset3h = Mesh::AttributeOffset(format, kPosition3h);
+  if (count == 0 || (offset3f == vertex_size && offset3h == vertex_size)) {
+    return false;
+  }
+  const uint8_t *vertices = static_cast<const uint8_t *>(ivd.vertex_data);
+  for (size_t i = 0; i < count; ++i) {
+    assert(indices[i] < ivd.count);
+    const uint8_t *vertex = vertices + indices[i] * ivd.vertex_size;
+    vec3 position;
+    if (offset3f != vertex_size) {
+      float xyz[3];
+      memcpy(xyz, vertex + offset3f, sizeof(xyz));
+      position = vec3(xyz);
+    } else {
+      uint16_t half[3];
+      memcpy(half, vertex + offset3h, sizeof(half));
+      position = vec3(HalfToFloat(half[0]), HalfToFloat(half[1]),
+                      HalfToFloat(half[2]));
+    }
+    *min_position = i ? vec3::Min(*min_position, position) : position;
+    *max_position = i ? vec3::Max(*max_position, position) : position;
+  }
+  return true;
+}
+
+// The space a surface's or detail level's indices take in a packed index
+// buffer, padded as Mesh::ReserveIndexBuffer() pads them.
+static size_t IndexBufferSize(const flatbuffers::Vector<uint16_t> *indices,
+                              const flatbuffers::Vector<uint32_t> *indices32) {
+  const size_t size = indices ? indices->size() * sizeof(uint16_t)
+                              : indices32 ? indices32->size() * sizeof(uint32_t)
+                                          : 0;
+  return (size + 3) & ~size_t(3);
+}
+
 void Mesh::Load() {
-  std::string *flatbuf = new std::string();
-  if (LoadFile(filename_.c_str(), flatbuf)) {
+  const double start = GetTimeInSeconds();
+  if (map_file_ && !HasCustomLoadFileFunction()) {
+    int32_t size = 0;
+    auto mapping =
+        static_cast<const uint8_t *>(MapFile(filename_.c_str(), 0, &size));
+    if (mapping) {
+      load_stats_.io_time = GetTimeInSeconds() - start;
+      load_stats_.file_bytes = static_cast<size_t>(size);
+      flatbuffers::Verifier verifier(mapping, size);
+      assert(meshdef::VerifyMeshBuffer(verifier));
+      mapped_size_ = size;
+      data_ = mapping;
+      if (prefetch_texture_fn_) PrefetchTextures();
+      return;
+    }
+    // Not a plain file (e.g. served by SetLoadFileFunction()), so copy it.
+  }
+  std::string *flatbuf = AcquireFileBuffer();
+  const bool loaded = LoadFile(filename_.c_str(), flatbuf);
+  load_stats_.io_time = GetTimeInSeconds() - start;
+  if (loaded) {
+    load_stats_.file_bytes = flatbuf->length();
     flatbuffers::Verifier verifier(
         reinterpret_cast<const uint8_t *>(flatbuf->c_str()), flatbuf->length());
     assert(meshdef::VerifyMeshBuffer(verifier));
     data_ = reinterpret_cast<const uint8_t *>(flatbuf);
+    if (prefetch_texture_fn_) PrefetchTextures();
   } else {
     LogError(kError, "Couldn\'t load: %s", filename_.c_str());
-    delete flatbuf;
+    ReleaseFileBuffer(flatbuf);
   }
 }
 
 bool Mesh::Finalize() {
   if (data_) {
-    const std::string *flatbuf = reinterpret_cast<const std::string *>(data_);
-    bool ok = InitFromMeshDef(flatbuf->c_str());
-    delete flatbuf;
-    data_ = nullptr;
+    // With a mapped file, vertex data is uploaded straight from the mapping.
+    bool ok = InitFromMeshDef(MeshDefBuffer());
+    FreeData();
     if (!ok) Clear();
   }
   CallFinalizeCallback();
   return IsValid();
 }
 
+const void *Mesh::MeshDefBuffer() const {
+  return mapped_size_ ? static_cast<const void *>(data_)
+                      : reinterpret_cast<const std::string *>(data_)->c_str();
+}
+
+void Mesh::PrefetchTextures() {
+  auto meshdef = meshdef::GetMesh(MeshDefBuffer());
+  if (!meshdef->surfaces()) return;
+  auto prefetch = [this](const char *filename, TextureFormat format,
+                         TextureFlags flags) -> Texture * {
+    Texture *tex = prefetch_texture_fn_(filename, format, flags);
+    if (tex) AddLoadDependency(tex);
+    return tex;
+  };
+  // Material files shared by several surfaces only need to be read once.
+  std::vector<std::string> material_files;
+  for (flatbuffers::uoffset_t i = 0; i < meshdef->surfaces()->size(); i++) {
+    auto surface = meshdef->surfaces()->Get(i);
+    if (surface->material_info()) {
+      Material::LoadTexturesFromMaterialDef(surface->material_info(), prefetch);
+      continue;
+    }
+    const std::string name = surface->material()->str();
+    if (std::find(material_files.begin(), material_files.end(), name) !=
+        material_files.end()) {
+      continue;
+    }
+    material_files.push_back(name);
+    PooledFileBuffer flatbuf;
+    if (!LoadFile(name.c_str(), flatbuf.get())) continue;
+    flatbuffers::Verifier verifier(
+        reinterpret_cast<const uint8_t *>(flatbuf->c_str()), flatbuf->length());
+    if (!matdef::VerifyMaterialBuffer(verifier)) continue;
+    Material::LoadTexturesFromMaterialDef(
+        matdef::GetMaterial(flatbuf->c_str()), prefetch);
+  }
+}
+
 void Mesh::ParseInterleavedVertexData(const void *meshdef_buffer,
                                       InterleavedVertexData *ivd) {
   auto meshdef = meshdef::GetMesh(meshdef_buffer);
@@ -234,23 +394,27 @@ void Mesh::ParseInterleavedVertexData(const void *meshdef_buffer,
     ivd->owned_vertex_data.resize(ivd->vertex_size * ivd->count);
     auto p = ivd->owned_vertex_data.data();
     ivd->vertex_data = p;
-    for (size_t i = 0; i < ivd->count; i++) {
-      flatbuffers::uoffset_t index = static_cast<flatbuffers::uoffset_t>(i);
-      assert(meshdef->positions());
-      CopyAttribute(meshdef->positions()->Get(index), p);
-      if (has_normals) CopyAttribute(meshdef->normals()->Get(index), p);
-      if (has_tangents) CopyAttribute(meshdef->tangents()->Get(index), p);
-      if (has_orientations) {
-        CopyAttribute(meshdef->orientations()->Get(index), p);
-      }
-      if (has_colors) CopyAttribute(meshdef->colors()->Get(index), p);
-      if (has_texcoords) CopyAttribute(meshdef->texcoords()->Get(index), p);
-      if (has_texcoords_alt)
-        CopyAttribute(meshdef->texcoords_alt()->Get(index), p);
-      if (ivd->has_skinning) {
-        CopyAttribute(meshdef->skin_indices()->Get(index), p);
-        CopyAttribute(meshdef->skin_weights()->Get(index), p);
-      }
+    // One attribute at a time, over all vertices.
+    const size_t count = ivd->count;
+    const size_t stride = ivd->vertex_size;
+    InterleaveAttribute(meshdef->positions(), count, stride, &p);
+    if (has_normals) InterleaveAttribute(meshdef->normals(), count, stride, &p);
+    if (has_tangents) {
+      InterleaveAttribute(meshdef->tangents(), count, stride, &p);
+    }
+    if (has_orientations) {
+      InterleaveAttribute(meshdef->orientations(), count, stride, &p);
+    }
+    if (has_colors) InterleaveAttribute(meshdef->colors(), count, stride, &p);
+    if (has_texcoords) {
+      InterleaveAttribute(meshdef->texcoords(), count, stride, &p);
+    }
+    if (has_texcoords_alt) {
+      InterleaveAttribute(meshdef->texcoords_alt(), count, stride, &p);
+    }
+    if (ivd->has_skinning) {
+      InterleaveAttribute(meshdef->skin_indices(), count, stride, &p);
+      InterleaveAttribute(meshdef->skin_weights(), count, stride, &p);
     }
   }
 }
@@ -274,16 +438,43 @@ bool Mesh::InitFromMeshDef(const void *meshdef_buffer) {
   for (size_t i = 0; i < meshdef->surfaces()->size(); i++) {
     flatbuffers::uoffset_t index = static_cast<flatbuffers::uoffset_t>(i);
     auto surface = meshdef->surfaces()->Get(index);
-    auto mat = material_create_fn_(surface->material()->c_str(),
-                                   surface->material_info());
+    auto mat = i < reload_materials_.size()
+                   ? reload_materials_[i]
+                   : material_create_fn_(surface->material()->c_str(),
+                                         surface->material_info());
     if (!mat) {
       LogError(kError, "Invalid material file: ", surface->material()->c_str());
       return false;
     }  // Error msg already set.
     indices_data.push_back(SurfaceMaterialPair(surface, mat));
   }
+  reload_materials_.clear();
+
+  InterleavedVertexData ivd;
+  ParseInterleavedVertexData(meshdef_buffer, &ivd);
+  vec3 max = meshdef->max_position() ? LoadVec3(meshdef->max_position())
+                                     : mathfu::kZeros3f;
+  vec3 min = meshdef->min_position() ? LoadVec3(meshdef->min_position())
+                                     : mathfu::kZeros3f;
+  LoadFromMemory(ivd.vertex_data, ivd.count, ivd.vertex_size, ivd.format.data(),
+                 meshdef->max_position() ? &max : nullptr,
+                 meshdef->min_position() ? &min : nullptr);
+
+  // Pack all surfaces and their detail levels into one index buffer.
+  size_t index_buffer_size = 0;
+  for (auto it = indices_data.begin(); it != indices_data.end(); it++) {
+    index_buffer_size += IndexBufferSize(it->first->indices(),
+                                         it->first->indices32());
+    if (!it->first->lods()) continue;
+    for (auto lod = it->first->lods()->begin();
+         lod != it->first->lods()->end(); ++lod) {
+      index_buffer_size += IndexBufferSize(lod->indices(), lod->indices32());
+    }
+  }
+  ReserveIndexBuffer(index_buffer_size);
 
-  // Load indices from surface and material.
+  // Load indices from surface and material. After the vertices, since
+  // indices in an arena are rebased onto the mesh's first vertex.
   for (auto it = indices_data.begin(); it != indices_data.end(); it++) {
     auto surface = it->first;
     auto mat = it->second;
@@ -292,17 +483,38 @@ bool Mesh::InitFromMeshDef(const void *meshdef_buffer) {
                surface->indices() ? surface->indices()->Length()
                                   : surface->indices32()->Length(),
                mat, !surface->indices());
+    vec3 submesh_min, submesh_max;
+    const bool has_bounds =
+        surface->indices()
+            ? IndexedBounds(ivd, surface->indices()->Data(),
+                            surface->indices()->Length(), &submesh_min,
+                            &submesh_max)
+            : IndexedBounds(ivd, surface->indices32()->Data(),
+                            surface->indices32()->Length(), &submesh_min,
+                            &submesh_max);
+    if (has_bounds) {
+      set_submesh_bounds(indices_.size() - 1, submesh_min, submesh_max);
+    }
+    if (!surface->lods()) continue;
+    for (auto lod = surface->lods()->begin(); lod != surface->lods()->end();
+         ++lod) {
+      if (surface->indices() ? !lod->indices() : !lod->indices32()) {
+        LogError(kError, "Mesh LOD index size differs from its surface: %s",
+                 filename_.c_str());
+        return false;
+      }
+      AddIndexLod(lod->indices() ? lod->indices()->Data()
+                                 : lod->indices32()->Data(),
+                  lod->indices() ? lod->indices()->Length()
+                                 : lod->indices32()->Length(),
+                  !lod->indices());
+    }
+  }
+  if (meshdef->lod_screen_sizes()) {
+    set_lod_screen_sizes(meshdef->lod_screen_sizes()->data(),
+                         meshdef->lod_screen_sizes()->size());
   }
 
-  InterleavedVertexData ivd;
-  ParseInterleavedVertexData(meshdef_buffer, &ivd);
-  vec3 max = meshdef->max_position() ? LoadVec3(meshdef->max_position())
-                                     : mathfu::kZeros3f;
-  vec3 min = meshdef->min_position() ? LoadVec3(meshdef->min_position())
-                                     : mathfu::kZeros3f;
-  LoadFromMemory(ivd.vertex_data, ivd.count, ivd.vertex_size, ivd.format.data(),
-                 meshdef->max_position() ? &max : nullptr,
-                 meshdef->min_position() ? &min : nullptr);
   // Load the bone information.
   if (ivd.has_skinning) {
     const size_t num_bones = meshdef->bone_parents()->Length();
@@ -310,9 +522,11 @@ bool Mesh::InitFromMeshDef(const void *meshdef_buffer) {
     std::unique_ptr<mathfu::AffineTransform[]> bone_transforms(
         new mathfu::AffineTransform[num_bones]);
     std::vector<const char *> bone_names(num_bones);
+    LoadAffines(
+        reinterpret_cast<const Mat3x4 *>(meshdef->bone_transforms()->Data()),
+        num_bones, &bone_transforms[0]);
     for (size_t i = 0; i < num_bones; ++i) {
       flatbuffers::uoffset_t index = static_cast<flatbuffers::uoffset_t>(i);
-      bone_transforms[i] = LoadAffine(meshdef->bone_transforms()->Get(index));
       bone_names[i] = meshdef->bone_names()->Get(index)->c_str();
     }
     const uint8_t *bone_parents = meshdef->bone_parents()->data();
@@ -337,8 +551,10 @@ void Mesh::SetBones(const mathfu::AffineTransform *bone_transforms,
                     const uint8_t *bone_parents, const char **bone_names,
                     size_t num_bones, const uint8_t *shader_bone_indices,
                     size_t num_shader_bones) {
-  delete[] default_bone_transform_inverses_;
-  default_bone_transform_inverses_ = new mathfu::AffineTransform[num_bones];
+  FreeAlignedMemory(default_bone_transform_inverses_, kAllocationMeshStaging);
+  default_bone_transform_inverses_ =
+      static_cast<mathfu::AffineTransform *>(AllocateAlignedMemory(
+          num_bones * sizeof(mathfu::AffineTransform), kAllocationMeshStaging));
   bone_parents_.resize(num_bones);
   shader_bone_indices_.resize(num_shader_bones);
 
@@ -363,10 +579,75 @@ void Mesh::GatherShaderTransforms(
     mathfu::AffineTransform *shader_transforms) const {
   for (size_t i = 0; i < shader_bone_indices_.size(); ++i) {
     const int bone_idx = shader_bone_indices_[i];
-    shader_transforms[i] = mat4::ToAffineTransform(
-        mat4::FromAffineTransform(bone_transforms[bone_idx]) *
-        mat4::FromAffineTransform(default_bone_transform_inverses_[bone_idx]));
+    shader_transforms[i] = MultiplyAffineTransforms(
+        bone_transforms[bone_idx], default_bone_transform_inverses_[bone_idx]);
+  }
+}
+
+void Mesh::ParallelFor(size_t count,
+                       const std::function<void(size_t, size_t)> &body) {
+  // Below this, starting threads costs more than it saves.
+  static const size_t kMinItemsPerThread = 4096;
+  const size_t num_threads = std::min<size_t>(
+      std::max(std::thread::hardware_concurrency(), 1u),
+      count / kMinItemsPerThread);
+  if (num_threads <= 1) {
+    body(0, count);
+    return;
+  }
+  const size_t per_thread = (count + num_threads - 1) / num_threads;
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (size_t i = 1; i < num_threads; ++i) {
+    const size_t begin = i * per_thread;
+    const size_t end = std::min(begin + per_thread, count);
+    threads.push_back(std::thread(body, begin, end));
+  }
+  body(0, std::min(per_thread, count));
+  for (auto it = threads.begin(); it != threads.end(); ++it) {
+    it->join();
+  }
+}
+
+void Mesh::GatherShaderDualQuaternions(
+    const mathfu::AffineTransform *bone_transforms,
+    mathfu::vec4_packed *shader_dual_quaternions) const {
+  for (size_t i = 0; i < shader_bone_indices_.size(); ++i) {
+    const int bone_idx = shader_bone_indices_[i];
+    AffineToDualQuaternion(
+        MultiplyAffineTransforms(bone_transforms[bone_idx],
+                                 default_bone_transform_inverses_[bone_idx]),
+        &shader_dual_quaternions[i * kNumVec4sInDualQuaternion]);
+  }
+}
+
+size_t Mesh::SelectLod(const mat4 &model_view_projection,
+                       float lod_bias) const {
+  if (lod_screen_sizes_.empty()) return 0;
+
+  // The extent of the bounds' corners in normalized device coordinates.
+  vec2 ndc_min(FLT_MAX, FLT_MAX);
+  vec2 ndc_max(-FLT_MAX, -FLT_MAX);
+  for (int corner = 0; corner < 8; ++corner) {
+    const vec4 position(corner & 1 ? max_position_.x : min_position_.x,
+                        corner & 2 ? max_position_.y : min_position_.y,
+                        corner & 4 ? max_position_.z : min_position_.z, 1.0f);
+    const vec4 clip = model_view_projection * position;
+    if (clip.w <= 0.0f) return 0;
+    const vec2 ndc = clip.xy() / clip.w;
+    ndc_min = vec2::Min(ndc_min, ndc);
+    ndc_max = vec2::Max(ndc_max, ndc);
+  }
+  // NDC spans 2 units across the viewport.
+  const vec2 extent = (ndc_max - ndc_min) * 0.5f;
+  const float screen_size = lod_bias * std::max(extent.x, extent.y);
+
+  size_t lod = 0;
+  while (lod < lod_screen_sizes_.size() &&
+         screen_size < lod_screen_sizes_[lod]) {
+    ++lod;
   }
+  return lod;
 }
 
 size_t Mesh::CalculateTotalNumberOfIndices() const {
@@ -377,21 +658,45 @@ size_t Mesh::CalculateTotalNumberOfIndices() const {
   return static_cast<size_t>(total);
 }
 
+void Mesh::Unload() {
+  reload_materials_.clear();
+  for (auto it = indices_.begin(); it != indices_.end(); ++it) {
+    reload_materials_.push_back(it->mat);
+  }
+  Clear();
+}
+
+void Mesh::UpdateGpuMemorySize() {
+  const size_t size = CalculateMemorySize();
+  RendererBase::TrackGpuMemory(kGpuMemoryMeshes, gpu_memory_size_, size);
+  gpu_memory_size_ = size;
+}
+
 void Mesh::Clear() {
   ClearPlatformDependent();
 
   indices_.clear();
+  lod_screen_sizes_.clear();
 
-  delete[] default_bone_transform_inverses_;
+  FreeAlignedMemory(default_bone_transform_inverses_, kAllocationMeshStaging);
   default_bone_transform_inverses_ = nullptr;
   bone_parents_.clear();
   bone_names_.clear();
   shader_bone_indices_.clear();
 
-  if (data_ != nullptr) {
-    delete reinterpret_cast<const std::string *>(data_);
-    data_ = nullptr;
+  FreeData();
+}
+
+void Mesh::FreeData() {
+  if (data_ == nullptr) return;
+  if (mapped_size_) {
+    UnmapFile(data_, mapped_size_);
+    mapped_size_ = 0;
+  } else {
+    ReleaseFileBuffer(
+        reinterpret_cast<std::string *>(const_cast<uint8_t *>(data_)));
   }
+  data_ = nullptr;
 }
 
 size_t Mesh::GetNumIndexBufferObjects() const {
@@ -19,11 +19,14 @@
 #include "fplbase/environment.h"
 #include "fplbase/flatbuffer_utils.h"
 #include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/internal/vertex_quantization.h"
 #include "fplbase/mesh.h"
+#include "fplbase/mesh_arena.h"
 #include "fplbase/render_utils.h"
 #include "fplbase/renderer.h"
 #include "fplbase/utilities.h"
 #include "mesh_impl_gl.h"
+#include "vertex_bindings_gl.h"
 
 #include "mesh_generated.h"
 
@@ -44,21 +47,59 @@ void Mesh::DestroyMeshImpl(MeshImpl *impl) { delete impl; }
 
 bool Mesh::IsValid() { return ValidBufferHandle(impl_->vbo); }
 
+size_t Mesh::CalculateMemorySize() const {
+  if (!ValidBufferHandle(impl_->vbo)) return 0;
+  // Shared buffers count towards the arena's memory instead.
+  size_t size = arena_page_ == kNoArenaPage ? num_vertices_ * vertex_size_ : 0;
+  for (auto it = indices_.begin(); it != indices_.end(); ++it) {
+    const size_t index_size =
+        it->index_type == GL_UNSIGNED_INT ? sizeof(uint32_t) : sizeof(uint16_t);
+    if (!it->shared) size += it->count * index_size;
+    for (auto lod = it->lods.begin(); lod != it->lods.end(); ++lod) {
+      if (!lod->shared) size += lod->count * index_size;
+    }
+  }
+  return size + impl_->ibo_size;
+}
+
 void Mesh::ClearPlatformDependent() {
+  if (arena_page_ != kNoArenaPage) {
+    arena_->Release(arena_page_);
+    arena_page_ = kNoArenaPage;
+    impl_->vbo = InvalidBufferHandle();
+    impl_->vao = InvalidBufferHandle();
+  }
   if (ValidBufferHandle(impl_->vbo)) {
-    auto vbo = GlBufferHandle(impl_->vbo);
-    GL_CALL(glDeleteBuffers(1, &vbo));
+    VertexBindings::DeleteVertexBuffer(GlBufferHandle(impl_->vbo));
     impl_->vbo = InvalidBufferHandle();
   }
   if (ValidBufferHandle(impl_->vao)) {
-    auto vao = GlBufferHandle(impl_->vao);
-    GL_CALL(glDeleteVertexArrays(1, &vao));
+    VertexBindings::DeleteVertexArray(GlBufferHandle(impl_->vao));
     impl_->vao = InvalidBufferHandle();
   }
   for (auto it = indices_.begin(); it != indices_.end(); ++it) {
     auto ibo = GlBufferHandle(it->ibo);
+    if (!it->shared) GL_CALL(glDeleteBuffers(1, &ibo));
+    for (auto lod = it->lods.begin(); lod != it->lods.end(); ++lod) {
+      auto lod_ibo = GlBufferHandle(lod->ibo);
+      if (!lod->shared) GL_CALL(glDeleteBuffers(1, &lod_ibo));
+    }
+  }
+  if (ValidBufferHandle(impl_->ibo)) {
+    auto ibo = GlBufferHandle(impl_->ibo);
     GL_CALL(glDeleteBuffers(1, &ibo));
+    impl_->ibo = InvalidBufferHandle();
+    impl_->ibo_size = 0;
+    impl_->ibo_used = 0;
   }
+  UpdateGpuMemorySize();
+}
+
+static bool HasAttribute(const Attribute *format, Attribute attribute) {
+  for (; *format != kEND; ++format) {
+    if (*format == attribute) return true;
+  }
+  return false;
 }
 
 void Mesh::LoadFromMemory(const void *vertex_data, size_t count,
@@ -70,28 +111,51 @@ void Mesh::LoadFromMemory(const void *vertex_data, size_t count,
   default_bone_transform_inverses_ = nullptr;
 
   set_format(format);
-  GLuint vbo = 0;
-  GL_CALL(glGenBuffers(1, &vbo));
-  impl_->vbo = BufferHandleFromGl(vbo);
-  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
-  GL_CALL(glBufferData(GL_ARRAY_BUFFER, count * vertex_size, vertex_data,
-                       GL_STATIC_DRAW));
+  if (arena_ && arena_->AllocateVertices(vertex_data, count, vertex_size,
+                                         format, &arena_page_,
+                                         &arena_first_vertex_)) {
+    impl_->vbo = arena_->page(arena_page_).vbo;
+    impl_->vao = arena_->page(arena_page_).vao;
+  } else {
+    arena_page_ = kNoArenaPage;
+    arena_first_vertex_ = 0;
+    GLuint vbo = 0;
+    GL_CALL(glGenBuffers(1, &vbo));
+    impl_->vbo = BufferHandleFromGl(vbo);
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+    GL_CALL(glBufferData(GL_ARRAY_BUFFER, count * vertex_size, vertex_data,
+                         GL_STATIC_DRAW));
+    RendererBase::CountRenderWork(&RenderCounters::buffer_upload_bytes,
+                                  count * vertex_size);
 
-  if (RendererBase::Get()->feature_level() >= kFeatureLevel30) {
-    GLuint vao = 0;
-    GL_CALL(glGenVertexArrays(1, &vao));
-    impl_->vao = BufferHandleFromGl(vao);
-    GL_CALL(glBindVertexArray(vao));
-    SetAttributes(vbo, format_, static_cast<int>(vertex_size_), nullptr);
-    GL_CALL(glBindVertexArray(0));
-  }
+    if (RendererBase::Get()->feature_level() >= kFeatureLevel30) {
+      GLuint vao = 0;
+      GL_CALL(glGenVertexArrays(1, &vao));
+      impl_->vao = BufferHandleFromGl(vao);
+      VertexBindings::BindVertexArrayObject(vao);
+      SetAttributes(vbo, format_, static_cast<int>(vertex_size_), nullptr);
+      VertexBindings::BindVertexArrayObject(0);
+    }
 
-  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+  }
+  UpdateGpuMemorySize();
 
   // Determine the min and max position
   if (max_position && min_position) {
     max_position_ = *max_position;
     min_position_ = *min_position;
+  } else if (HasAttribute(format, kPosition3h)) {
+    auto data = static_cast<const uint8_t *>(vertex_data) +
+                AttributeOffset(format, kPosition3h);
+    for (size_t vertex = 0; vertex < count; vertex++, data += vertex_size) {
+      uint16_t half[3];
+      memcpy(half, data, sizeof(half));
+      const vec3 position(HalfToFloat(half[0]), HalfToFloat(half[1]),
+                          HalfToFloat(half[2]));
+      min_position_ = vertex ? vec3::Min(min_position_, position) : position;
+      max_position_ = vertex ? vec3::Max(max_position_, position) : position;
+    }
   } else {
     auto data = static_cast<const float *>(vertex_data);
     const Attribute *attribute = format;
@@ -107,22 +171,107 @@ void Mesh::LoadFromMemory(const void *vertex_data, size_t count,
   }
 }
 
+Mesh::IndexRange Mesh::CreateIndexRange(const void *index_data, int count,
+                                         bool is_32_bit,
+                                         uint32_t *index_type) {
+  IndexRange range;
+  range.count = count;
+
+  // Arena pages hold at most 64k vertices, so rebased indices are 16 bit.
+  std::vector<uint16_t> rebased;
+  if (arena_page_ != kNoArenaPage) {
+    rebased.resize(count);
+    for (int i = 0; i < count; ++i) {
+      const uint32_t index =
+          is_32_bit ? static_cast<const uint32_t *>(index_data)[i]
+                    : static_cast<const uint16_t *>(index_data)[i];
+      assert(index < num_vertices_);
+      rebased[i] = static_cast<uint16_t>(arena_first_vertex_ + index);
+    }
+    index_data = rebased.data();
+    is_32_bit = false;
+    if (arena_->AllocateIndices(arena_page_, rebased.data(), rebased.size(),
+                                &range.offset)) {
+      range.ibo = arena_->page(arena_page_).ibo;
+      range.shared = true;
+      *index_type = GL_UNSIGNED_SHORT;
+      return range;
+    }
+  }
+
+  const size_t size =
+      count * (is_32_bit ? sizeof(uint32_t) : sizeof(uint16_t));
+  *index_type = is_32_bit ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+  // Don't change the index buffer of a VAO the last draw left bound.
+  VertexBindings::FlushBindings();
+  if (impl_->ibo_used + size <= impl_->ibo_size) {
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GlBufferHandle(impl_->ibo)));
+    GL_CALL(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, impl_->ibo_used, size,
+                            index_data));
+    RendererBase::CountRenderWork(&RenderCounters::buffer_upload_bytes, size);
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+    range.ibo = impl_->ibo;
+    range.offset = impl_->ibo_used;
+    range.shared = true;
+    impl_->ibo_used =
+        std::min((impl_->ibo_used + size + 3) & ~size_t(3), impl_->ibo_size);
+    return range;
+  }
+
+  GLuint ibo = 0;
+  GL_CALL(glGenBuffers(1, &ibo));
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo));
+  GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, index_data,
+                       GL_STATIC_DRAW));
+  RendererBase::CountRenderWork(&RenderCounters::buffer_upload_bytes, size);
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+  range.ibo = BufferHandleFromGl(ibo);
+  return range;
+}
+
+void Mesh::ReserveIndexBuffer(size_t size) {
+  // Once indices are packed into the buffer it can't be replaced.
+  if (arena_page_ != kNoArenaPage || size == 0 || impl_->ibo_used > 0) return;
+  if (!ValidBufferHandle(impl_->ibo)) {
+    GLuint ibo = 0;
+    GL_CALL(glGenBuffers(1, &ibo));
+    impl_->ibo = BufferHandleFromGl(ibo);
+  }
+  VertexBindings::FlushBindings();
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GlBufferHandle(impl_->ibo)));
+  GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, nullptr,
+                       GL_STATIC_DRAW));
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+  impl_->ibo_size = size;
+  impl_->ibo_used = 0;
+  UpdateGpuMemorySize();
+}
+
 void Mesh::AddIndices(const void *index_data, int count, Material *mat,
                       bool is_32_bit) {
   indices_.push_back(Indices());
   auto &idxs = indices_.back();
-  idxs.count = count;
-  GLuint ibo = 0;
-  GL_CALL(glGenBuffers(1, &ibo));
-  idxs.ibo = BufferHandleFromGl(ibo);
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo));
-  GL_CALL(
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                   count * (is_32_bit ? sizeof(uint32_t) : sizeof(uint16_t)),
-                   index_data, GL_STATIC_DRAW));
-  idxs.index_type = (is_32_bit ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT);
+  const IndexRange range =
+      CreateIndexRange(index_data, count, is_32_bit, &idxs.index_type);
+  idxs.count = range.count;
+  idxs.ibo = range.ibo;
+  idxs.offset = range.offset;
+  idxs.shared = range.shared;
   idxs.mat = mat;
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+  idxs.min_position = mathfu::vec3_packed(min_position_);
+  idxs.max_position = mathfu::vec3_packed(max_position_);
+  UpdateGpuMemorySize();
+}
+
+void Mesh::AddIndexLod(const void *index_data, int count, bool is_32_bit) {
+  assert(!indices_.empty());
+  auto &idxs = indices_.back();
+  uint32_t index_type = 0;
+  idxs.lods.push_back(
+      CreateIndexRange(index_data, count, is_32_bit, &index_type));
+  assert(index_type == idxs.index_type);
+  (void)index_type;
+  UpdateGpuMemorySize();
 }
 
 }  // namespace fplbase
@@ -20,10 +20,20 @@
 namespace fplbase {
 
 struct MeshImpl {
-  MeshImpl() : vbo(InvalidBufferHandle()), vao(InvalidBufferHandle()) {}
+  MeshImpl()
+      : vbo(InvalidBufferHandle()),
+        vao(InvalidBufferHandle()),
+        ibo(InvalidBufferHandle()),
+        ibo_size(0),
+        ibo_used(0) {}
 
   BufferHandle vbo;
   BufferHandle vao;
+  // The index buffer from Mesh::ReserveIndexBuffer(), and the bytes of it
+  // allocated so far.
+  BufferHandle ibo;
+  size_t ibo_size;
+  size_t ibo_used;
 };
 
 }  // namespace fplbase
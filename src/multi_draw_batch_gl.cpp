@@ -0,0 +1,214 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/material.h"
+#include "fplbase/mesh.h"
+#include "fplbase/multi_draw_batch.h"
+#include "fplbase/render_utils.h"
+#include "fplbase/renderer.h"
+#include "mesh_impl_gl.h"
+#include "vertex_bindings_gl.h"
+
+namespace fplbase {
+
+// The uint32s of a DrawElementsIndirectCommand: count, instance count, first
+// index, base vertex and base instance.
+static const size_t kCommandSize = 5;
+
+MultiDrawBatch::MultiDrawBatch(const Attribute *instance_format)
+    : instances_(instance_format),
+      indirect_buffer_(InvalidBufferHandle()),
+      indirect_capacity_(0),
+      num_draw_calls_(0) {}
+
+MultiDrawBatch::~MultiDrawBatch() {
+  if (ValidBufferHandle(indirect_buffer_)) {
+    auto buffer = GlBufferHandle(indirect_buffer_);
+    GL_CALL(glDeleteBuffers(1, &buffer));
+  }
+  RendererBase::TrackGpuMemory(kGpuMemoryMeshes, indirect_capacity_, 0);
+}
+
+void MultiDrawBatch::Clear() {
+  draws_.clear();
+  instances_.Clear();
+}
+
+void MultiDrawBatch::Add(Mesh *mesh, const void *instance_data,
+                         size_t instance_count, size_t lod) {
+  assert(!mesh->indices_.empty());
+  if (instance_count == 0) return;
+  // All surfaces draw the same instances.
+  const size_t base_instance = instances_.Add(instance_data, instance_count);
+  for (auto it = mesh->indices_.begin(); it != mesh->indices_.end(); ++it) {
+    const auto level = it->Lod(lod);
+    if (level.count == 0) continue;
+    const size_t index_size = it->index_type == GL_UNSIGNED_INT ? 4 : 2;
+    Draw draw;
+    draw.mesh = mesh;
+    draw.mat = it->mat;
+    draw.ibo = level.ibo;
+    draw.index_type = it->index_type;
+    draw.count = static_cast<uint32_t>(level.count);
+    draw.instance_count = static_cast<uint32_t>(instance_count);
+    draw.first_index = static_cast<uint32_t>(level.offset / index_size);
+    draw.base_instance = static_cast<uint32_t>(base_instance);
+    draws_.push_back(draw);
+  }
+}
+
+bool MultiDrawBatch::Compatible(const Draw &a, const Draw &b) {
+  return GlBufferHandle(a.mesh->impl_->vao) ==
+             GlBufferHandle(b.mesh->impl_->vao) &&
+         GlBufferHandle(a.mesh->impl_->vbo) ==
+             GlBufferHandle(b.mesh->impl_->vbo) &&
+         GlBufferHandle(a.ibo) == GlBufferHandle(b.ibo) &&
+         a.index_type == b.index_type &&
+         a.mesh->primitive_ == b.mesh->primitive_ && a.mat == b.mat;
+}
+
+void MultiDrawBatch::UploadCommands() {
+  commands_.resize(order_.size() * kCommandSize);
+  for (size_t i = 0; i < order_.size(); ++i) {
+    const Draw &draw = draws_[order_[i]];
+    uint32_t *command = &commands_[i * kCommandSize];
+    command[0] = draw.count;
+    command[1] = draw.instance_count;
+    command[2] = draw.first_index;
+    command[3] = 0;  // Arena indices are already rebased onto their page.
+    command[4] = draw.base_instance;
+  }
+#if FPLBASE_GL_MULTI_DRAW_INDIRECT
+  const size_t size = commands_.size() * sizeof(uint32_t);
+  if (!ValidBufferHandle(indirect_buffer_)) {
+    GLuint buffer = 0;
+    GL_CALL(glGenBuffers(1, &buffer));
+    indirect_buffer_ = BufferHandleFromGl(buffer);
+  }
+  GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER,
+                       GlBufferHandle(indirect_buffer_)));
+  if (size > indirect_capacity_) {
+    const size_t capacity = std::max(size, 2 * indirect_capacity_);
+    GL_CALL(glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity, nullptr,
+                         GL_DYNAMIC_DRAW));
+    RendererBase::TrackGpuMemory(kGpuMemoryMeshes, indirect_capacity_,
+                                 capacity);
+    indirect_capacity_ = capacity;
+  }
+  GL_CALL(glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, &commands_[0]));
+  RendererBase::CountRenderWork(&RenderCounters::buffer_upload_bytes, size);
+#endif  // FPLBASE_GL_MULTI_DRAW_INDIRECT
+}
+
+void MultiDrawBatch::Render(Renderer &renderer, bool ignore_material) {
+  num_draw_calls_ = 0;
+  if (draws_.empty()) return;
+  assert(renderer.feature_level() >= kFeatureLevel30);
+  instances_.Upload();
+
+  // Group compatible draws, keeping the order they were added in otherwise.
+  order_.resize(draws_.size());
+  for (size_t i = 0; i < order_.size(); ++i) order_[i] = i;
+  const std::vector<Draw> &draws = draws_;
+  std::stable_sort(order_.begin(), order_.end(), [&draws](size_t a,
+                                                          size_t b) {
+    const Draw &x = draws[a];
+    const Draw &y = draws[b];
+    const GLuint x_vao = GlBufferHandle(x.mesh->impl_->vao);
+    const GLuint y_vao = GlBufferHandle(y.mesh->impl_->vao);
+    if (x_vao != y_vao) return x_vao < y_vao;
+    const GLuint x_vbo = GlBufferHandle(x.mesh->impl_->vbo);
+    const GLuint y_vbo = GlBufferHandle(y.mesh->impl_->vbo);
+    if (x_vbo != y_vbo) return x_vbo < y_vbo;
+    if (GlBufferHandle(x.ibo) != GlBufferHandle(y.ibo)) {
+      return GlBufferHandle(x.ibo) < GlBufferHandle(y.ibo);
+    }
+    if (x.index_type != y.index_type) return x.index_type < y.index_type;
+    if (x.mesh->primitive_ != y.mesh->primitive_) {
+      return x.mesh->primitive_ < y.mesh->primitive_;
+    }
+    return std::less<Material *>()(x.mat, y.mat);
+  });
+
+  const bool indirect = renderer.SupportsMultiDrawIndirect();
+  if (indirect) UploadCommands();
+
+  const GLuint instance_vbo = GlBufferHandle(instances_.buffer());
+  const int instance_size = static_cast<int>(instances_.instance_size());
+  for (size_t begin = 0; begin < order_.size();) {
+    const Draw &first = draws_[order_[begin]];
+    size_t end = begin + 1;
+    while (end < order_.size() && Compatible(first, draws_[order_[end]])) {
+      ++end;
+    }
+
+    if (!ignore_material && first.mat) first.mat->Set(renderer);
+    const Mesh *mesh = first.mesh;
+    const bool has_vao = ValidBufferHandle(mesh->impl_->vao);
+    if (has_vao) {
+      VertexBindings::BindVertexArrayObject(GlBufferHandle(mesh->impl_->vao));
+    } else {
+      SetAttributes(GlBufferHandle(mesh->impl_->vbo), mesh->format_,
+                    static_cast<int>(mesh->vertex_size_), nullptr);
+    }
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GlBufferHandle(first.ibo)));
+
+    if (indirect) {
+#if FPLBASE_GL_MULTI_DRAW_INDIRECT
+      SetAttributes(instance_vbo, instances_.format(), instance_size, nullptr);
+      const size_t offset = begin * kCommandSize * sizeof(uint32_t);
+      GL_CALL(glMultiDrawElementsIndirect(
+          mesh->primitive_, first.index_type,
+          reinterpret_cast<const void *>(offset),
+          static_cast<GLsizei>(end - begin), 0));
+      ++num_draw_calls_;
+      RendererBase::CountRenderWork(&RenderCounters::draw_calls);
+#endif  // FPLBASE_GL_MULTI_DRAW_INDIRECT
+    } else {
+      // Without a base instance, point the instance attributes at each
+      // draw's first instance instead.
+      const size_t index_size = first.index_type == GL_UNSIGNED_INT ? 4 : 2;
+      for (size_t i = begin; i < end; ++i) {
+        const Draw &draw = draws_[order_[i]];
+        const size_t instance_offset = draw.base_instance * instance_size;
+        SetAttributes(instance_vbo, instances_.format(), instance_size,
+                      reinterpret_cast<const char *>(instance_offset));
+        GL_CALL(glDrawElementsInstanced(
+            mesh->primitive_, static_cast<GLsizei>(draw.count),
+            draw.index_type,
+            reinterpret_cast<const void *>(draw.first_index * index_size),
+            static_cast<GLsizei>(draw.instance_count)));
+        ++num_draw_calls_;
+        RendererBase::CountRenderWork(&RenderCounters::draw_calls);
+      }
+    }
+
+    UnSetAttributes(instances_.format());
+    if (has_vao) {
+      VertexBindings::BindVertexArrayObject(0);
+    } else {
+      UnSetAttributes(mesh->format_);
+      GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+    }
+    begin = end;
+  }
+#if FPLBASE_GL_MULTI_DRAW_INDIRECT
+  if (indirect) GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+#endif  // FPLBASE_GL_MULTI_DRAW_INDIRECT
+}
+
+}  // namespace fplbase
@@ -0,0 +1,190 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "precompiled.h"
+
+#include "fplbase/fpl_common.h"
+#include "fplbase/mesh.h"
+#include "fplbase/occlusion_culler.h"
+#include "fplbase/render_utils.h"
+#include "fplbase/renderer.h"
+#include "fplbase/shader.h"
+
+using mathfu::mat4;
+using mathfu::vec3;
+using mathfu::vec4;
+
+#ifndef GL_ANY_SAMPLES_PASSED
+#define GL_ANY_SAMPLES_PASSED 0x8C2F
+#endif
+#ifndef GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+#define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8D6A
+#endif
+
+namespace fplbase {
+
+// Conservative queries may over-report, which only costs a draw, and let
+// tiled GPUs answer without full precision depth tests. Desktop GL only has
+// them from 4.3, so it uses exact ones.
+#ifdef FPLBASE_GLES
+static const GLenum kQueryTarget = GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+#else
+static const GLenum kQueryTarget = GL_ANY_SAMPLES_PASSED;
+#endif
+
+// Boxes with a corner closer than this in clip space w are treated as
+// reaching the camera, where clipping could make them wrongly occluded.
+static const float kNearW = 1e-4f;
+
+static const char kBoxVertexShader[] =
+    "attribute vec4 aPosition;\n"
+    "uniform mat4 model_view_projection;\n"
+    "void main() {\n"
+    "  gl_Position = model_view_projection * aPosition;\n"
+    "}\n";
+
+static const char kBoxFragmentShader[] =
+    "void main() {\n"
+    "  gl_FragColor = vec4(1.0);\n"
+    "}\n";
+
+// The box's corners are numbered by their x, y and z bits.
+static const uint16_t kBoxIndices[] = {
+    0, 2, 1, 1, 2, 3,  // -z
+    4, 5, 6, 5, 7, 6,  // +z
+    0, 1, 4, 1, 5, 4,  // -y
+    2, 6, 3, 3, 6, 7,  // +y
+    0, 4, 2, 2, 4, 6,  // -x
+    1, 3, 5, 3, 7, 5,  // +x
+};
+
+static const Attribute kBoxFormat[] = {kPosition3f, kEND};
+
+OcclusionCuller::OcclusionCuller()
+    : supported_(false), shader_(nullptr), in_queries_(false),
+      num_queries_(0) {
+  const RendererBase *renderer = RendererBase::Get();
+  supported_ = renderer != nullptr && renderer->SupportsOcclusionQueries();
+}
+
+OcclusionCuller::~OcclusionCuller() {
+  for (size_t i = 0; i < objects_.size(); ++i) {
+    if (objects_[i].query != 0) {
+      GL_CALL(glDeleteQueries(1, &objects_[i].query));
+    }
+  }
+  delete shader_;
+}
+
+void OcclusionCuller::BeginFrame() {
+  assert(!in_queries_);
+  num_queries_ = 0;
+  for (size_t i = 0; i < objects_.size(); ++i) {
+    Object &object = objects_[i];
+    if (!object.pending) continue;
+    GLuint available = 0;
+    GL_CALL(glGetQueryObjectuiv(object.query, GL_QUERY_RESULT_AVAILABLE,
+                                &available));
+    if (!available) continue;
+    GLuint samples_passed = 0;
+    GL_CALL(glGetQueryObjectuiv(object.query, GL_QUERY_RESULT,
+                                &samples_passed));
+    object.visible = samples_passed != 0;
+    object.pending = false;
+  }
+}
+
+void OcclusionCuller::BeginQueries(Renderer &renderer) {
+  assert(!in_queries_);
+  in_queries_ = true;
+  if (!supported_) return;
+  if (shader_ == nullptr) {
+    shader_ =
+        renderer.CompileAndLinkShader(kBoxVertexShader, kBoxFragmentShader);
+    if (shader_ == nullptr) {
+      supported_ = false;
+      return;
+    }
+  }
+
+  // Test the boxes against the occluders' depth, from both sides in case the
+  // camera is inside one, without writing anything.
+  saved_state_ = renderer.GetRenderState();
+  RenderState state = saved_state_;
+  state.cull_state.enabled = false;
+  state.depth_state.test_enabled = true;
+  state.depth_state.write_enabled = false;
+  state.depth_state.function = kRenderLessEqual;
+  renderer.SetRenderState(state);
+  GL_CALL(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+}
+
+void OcclusionCuller::Query(Renderer &renderer, size_t id,
+                            const mat4 &model_view_projection,
+                            const vec3 &min_position,
+                            const vec3 &max_position) {
+  assert(in_queries_);
+  if (!supported_) return;
+  if (id >= objects_.size()) objects_.resize(id + 1);
+  Object &object = objects_[id];
+  if (object.pending) return;
+
+  mathfu::vec3_packed corners[8];
+  for (int i = 0; i < 8; ++i) {
+    const vec3 corner(i & 1 ? max_position.x : min_position.x,
+                      i & 2 ? max_position.y : min_position.y,
+                      i & 4 ? max_position.z : min_position.z);
+    corner.Pack(&corners[i]);
+    const vec4 clip = model_view_projection * vec4(corner, 1.0f);
+    if (clip.w <= kNearW) {
+      object.visible = true;
+      return;
+    }
+  }
+
+  if (object.query == 0) {
+    GL_CALL(glGenQueries(1, &object.query));
+  }
+  renderer.set_model_view_projection(model_view_projection);
+  renderer.SetShader(shader_);
+  GL_CALL(glBeginQuery(kQueryTarget, object.query));
+  RenderArray(Mesh::kTriangles, static_cast<int>(FPL_ARRAYSIZE(kBoxIndices)),
+              kBoxFormat, sizeof(corners[0]), corners, kBoxIndices);
+  GL_CALL(glEndQuery(kQueryTarget));
+  object.pending = true;
+  ++num_queries_;
+}
+
+void OcclusionCuller::Query(Renderer &renderer, size_t id,
+                            const mat4 &model_view_projection,
+                            const Mesh &mesh) {
+  Query(renderer, id, model_view_projection, mesh.min_position(),
+        mesh.max_position());
+}
+
+void OcclusionCuller::EndQueries(Renderer &renderer) {
+  assert(in_queries_);
+  in_queries_ = false;
+  if (!supported_) return;
+  GL_CALL(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+  renderer.SetRenderState(saved_state_);
+}
+
+void OcclusionCuller::Reset(size_t id) {
+  if (id >= objects_.size()) return;
+  // A query still in flight is left to finish; its result is ignored.
+  objects_[id].pending = false;
+  objects_[id].visible = true;
+}
+
+}  // namespace fplbase
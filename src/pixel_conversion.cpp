@@ -0,0 +1,340 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "precompiled.h"
+#include "fplbase/internal/pixel_conversion.h"
+
+// clang-format off
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define FPLBASE_PIXEL_CONVERSION_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FPLBASE_PIXEL_CONVERSION_SSE2 1
+#include <emmintrin.h>
+#endif
+// clang-format on
+
+namespace fplbase {
+
+void Convert8888To5551Scalar(const uint8_t *src, uint16_t *dest,
+                             size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; i++) {
+    auto c = &src[i * 4];
+    dest[i] = ((c[0] >> 3) << 11) | ((c[1] >> 3) << 6) | ((c[2] >> 3) << 1) |
+              ((c[3] >> 7) << 0);
+  }
+}
+
+void Convert888To565Scalar(const uint8_t *src, uint16_t *dest,
+                           size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; i++) {
+    auto c = &src[i * 3];
+    dest[i] = ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | ((c[2] >> 3) << 0);
+  }
+}
+
+void MultiplyRgbByAlphaScalar(uint8_t *rgba, size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, rgba += 4) {
+    const auto alpha = static_cast<uint16_t>(rgba[3]);
+    rgba[0] = static_cast<uint8_t>((static_cast<uint16_t>(rgba[0]) * alpha) /
+                                   255);
+    rgba[1] = static_cast<uint8_t>((static_cast<uint16_t>(rgba[1]) * alpha) /
+                                   255);
+    rgba[2] = static_cast<uint8_t>((static_cast<uint16_t>(rgba[2]) * alpha) /
+                                   255);
+  }
+}
+
+static inline uint8_t RoundedAverage(uint8_t a, uint8_t b) {
+  return static_cast<uint8_t>((a + b + 1) >> 1);
+}
+
+// Writes output pixels [begin, end) of the row halving `row0` and `row1`,
+// which are `width` pixels wide.
+static void DownsampleRowsScalar(const uint8_t *row0, const uint8_t *row1,
+                                 int width, int channels, int begin, int end,
+                                 uint8_t *dest) {
+  for (int x = begin; x < end; ++x) {
+    const int x0 = 2 * x * channels;
+    const int x1 = width > 1 ? x0 + channels : x0;
+    for (int c = 0; c < channels; ++c) {
+      dest[x * channels + c] =
+          RoundedAverage(RoundedAverage(row0[x0 + c], row0[x1 + c]),
+                         RoundedAverage(row1[x0 + c], row1[x1 + c]));
+    }
+  }
+}
+
+void DownsampleBox2x2Scalar(const uint8_t *src, int width, int height,
+                            int channels, uint8_t *dest) {
+  const int dest_width = std::max(width / 2, 1);
+  const int dest_height = std::max(height / 2, 1);
+  const size_t stride = static_cast<size_t>(width) * channels;
+  for (int y = 0; y < dest_height; ++y) {
+    const uint8_t *row0 = src + 2 * y * stride;
+    const uint8_t *row1 = height > 1 ? row0 + stride : row0;
+    DownsampleRowsScalar(row0, row1, width, channels, 0, dest_width,
+                         dest + y * dest_width * channels);
+  }
+}
+
+// The vector versions divide by 255 as (x + 1 + (x >> 8)) >> 8, which equals
+// x / 255 for all the 16-bit products of two bytes.
+
+#if FPLBASE_PIXEL_CONVERSION_NEON
+
+PixelConversionSimd GetPixelConversionSimd() { return kPixelConversionNeon; }
+
+void Convert8888To5551(const uint8_t *src, uint16_t *dest, size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8 <= num_pixels; i += 8) {
+    const uint8x8x4_t c = vld4_u8(src + i * 4);
+    uint16x8_t p = vshlq_n_u16(vmovl_u8(vshr_n_u8(c.val[0], 3)), 11);
+    p = vorrq_u16(p, vshlq_n_u16(vmovl_u8(vshr_n_u8(c.val[1], 3)), 6));
+    p = vorrq_u16(p, vshlq_n_u16(vmovl_u8(vshr_n_u8(c.val[2], 3)), 1));
+    p = vorrq_u16(p, vmovl_u8(vshr_n_u8(c.val[3], 7)));
+    vst1q_u16(dest + i, p);
+  }
+  Convert8888To5551Scalar(src + i * 4, dest + i, num_pixels - i);
+}
+
+void Convert888To565(const uint8_t *src, uint16_t *dest, size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8 <= num_pixels; i += 8) {
+    const uint8x8x3_t c = vld3_u8(src + i * 3);
+    uint16x8_t p = vshlq_n_u16(vmovl_u8(vshr_n_u8(c.val[0], 3)), 11);
+    p = vorrq_u16(p, vshlq_n_u16(vmovl_u8(vshr_n_u8(c.val[1], 2)), 5));
+    p = vorrq_u16(p, vmovl_u8(vshr_n_u8(c.val[2], 3)));
+    vst1q_u16(dest + i, p);
+  }
+  Convert888To565Scalar(src + i * 3, dest + i, num_pixels - i);
+}
+
+static inline uint8x8_t MultiplyDiv255(uint8x8_t c, uint8x8_t a) {
+  const uint16x8_t x = vmull_u8(c, a);
+  return vshrn_n_u16(vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8)),
+                     8);
+}
+
+void MultiplyRgbByAlpha(uint8_t *rgba, size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8 <= num_pixels; i += 8) {
+    uint8x8x4_t c = vld4_u8(rgba + i * 4);
+    c.val[0] = MultiplyDiv255(c.val[0], c.val[3]);
+    c.val[1] = MultiplyDiv255(c.val[1], c.val[3]);
+    c.val[2] = MultiplyDiv255(c.val[2], c.val[3]);
+    vst4_u8(rgba + i * 4, c);
+  }
+  MultiplyRgbByAlphaScalar(rgba + i * 4, num_pixels - i);
+}
+
+// Halves 16 RGBA pixels of each of `row0` and `row1` into 8.
+static inline uint8x8x4_t DownsamplePixels8888(const uint8_t *row0,
+                                               const uint8_t *row1) {
+  const uint8x16x4_t a = vld4q_u8(row0);
+  const uint8x16x4_t b = vld4q_u8(row1);
+  uint8x8x4_t out;
+  for (int c = 0; c < 4; ++c) {
+    // Split each channel into its even and odd pixels.
+    const uint8x16x2_t ha = vuzpq_u8(a.val[c], a.val[c]);
+    const uint8x16x2_t hb = vuzpq_u8(b.val[c], b.val[c]);
+    out.val[c] = vrhadd_u8(
+        vrhadd_u8(vget_low_u8(ha.val[0]), vget_low_u8(ha.val[1])),
+        vrhadd_u8(vget_low_u8(hb.val[0]), vget_low_u8(hb.val[1])));
+  }
+  return out;
+}
+
+void DownsampleBox2x2(const uint8_t *src, int width, int height, int channels,
+                      uint8_t *dest) {
+  if (channels != 4 || width < 2) {
+    DownsampleBox2x2Scalar(src, width, height, channels, dest);
+    return;
+  }
+  const int dest_width = width / 2;
+  const int dest_height = std::max(height / 2, 1);
+  const size_t stride = static_cast<size_t>(width) * 4;
+  for (int y = 0; y < dest_height; ++y) {
+    const uint8_t *row0 = src + 2 * y * stride;
+    const uint8_t *row1 = height > 1 ? row0 + stride : row0;
+    uint8_t *out = dest + y * dest_width * 4;
+    int x = 0;
+    for (; x + 8 <= dest_width; x += 8) {
+      vst4_u8(out + x * 4, DownsamplePixels8888(row0 + x * 8, row1 + x * 8));
+    }
+    DownsampleRowsScalar(row0, row1, width, 4, x, dest_width, out);
+  }
+}
+
+#elif FPLBASE_PIXEL_CONVERSION_SSE2
+
+PixelConversionSimd GetPixelConversionSimd() { return kPixelConversionSse2; }
+
+// Packs the low 16 bits of each 32-bit lane of `a` and `b` into one vector.
+static inline __m128i PackLow16(__m128i a, __m128i b) {
+  // _mm_packs_epi32 saturates, so sign extend the low halves first.
+  a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+  b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+  return _mm_packs_epi32(a, b);
+}
+
+// Converts 4 RGBA pixels, one per 32-bit lane, to 5551.
+static inline __m128i Pixels8888To5551(__m128i p) {
+  const __m128i r = _mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xF8)), 8);
+  const __m128i g =
+      _mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xF800)), 5);
+  const __m128i b =
+      _mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xF80000)), 18);
+  const __m128i a = _mm_srli_epi32(p, 31);
+  return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a));
+}
+
+// Converts 4 RGB pixels, one per 32-bit lane (the top byte is ignored), to
+// 565.
+static inline __m128i Pixels888To565(__m128i p) {
+  const __m128i r = _mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xF8)), 8);
+  const __m128i g =
+      _mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xFC00)), 5);
+  const __m128i b =
+      _mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xF80000)), 19);
+  return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+// Loads the 3 bytes of an RGB pixel into the low bytes of an int. Reads one
+// byte past the pixel, so callers must not use it on the last pixel.
+static inline int LoadRgbPixel(const uint8_t *c) {
+  uint32_t v;
+  memcpy(&v, c, sizeof(v));
+  return static_cast<int>(v);
+}
+
+void Convert8888To5551(const uint8_t *src, uint16_t *dest, size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8 <= num_pixels; i += 8) {
+    const __m128i lo =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+    const __m128i hi =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4 + 16));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i),
+                     PackLow16(Pixels8888To5551(lo), Pixels8888To5551(hi)));
+  }
+  Convert8888To5551Scalar(src + i * 4, dest + i, num_pixels - i);
+}
+
+void Convert888To565(const uint8_t *src, uint16_t *dest, size_t num_pixels) {
+  size_t i = 0;
+  // Stop one pixel early, since LoadRgbPixel() reads a byte past the pixel.
+  for (; i + 9 <= num_pixels; i += 8) {
+    const uint8_t *c = src + i * 3;
+    const __m128i lo =
+        _mm_set_epi32(LoadRgbPixel(c + 9), LoadRgbPixel(c + 6),
+                      LoadRgbPixel(c + 3), LoadRgbPixel(c));
+    const __m128i hi =
+        _mm_set_epi32(LoadRgbPixel(c + 21), LoadRgbPixel(c + 18),
+                      LoadRgbPixel(c + 15), LoadRgbPixel(c + 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i),
+                     PackLow16(Pixels888To565(lo), Pixels888To565(hi)));
+  }
+  Convert888To565Scalar(src + i * 3, dest + i, num_pixels - i);
+}
+
+// Premultiplies 2 RGBA pixels, one per 64-bit lane of 16-bit channels.
+static inline __m128i MultiplyRgbByAlpha16(__m128i p) {
+  __m128i a = _mm_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3));
+  a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+  const __m128i x = _mm_mullo_epi16(p, a);
+  const __m128i div = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)),
+      8);
+  // Keep alpha itself as is.
+  const __m128i alpha_mask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+  return _mm_or_si128(_mm_and_si128(alpha_mask, p),
+                      _mm_andnot_si128(alpha_mask, div));
+}
+
+void MultiplyRgbByAlpha(uint8_t *rgba, size_t num_pixels) {
+  size_t i = 0;
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 4 <= num_pixels; i += 4) {
+    __m128i *p = reinterpret_cast<__m128i *>(rgba + i * 4);
+    const __m128i c = _mm_loadu_si128(p);
+    const __m128i lo = MultiplyRgbByAlpha16(_mm_unpacklo_epi8(c, zero));
+    const __m128i hi = MultiplyRgbByAlpha16(_mm_unpackhi_epi8(c, zero));
+    _mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+  }
+  MultiplyRgbByAlphaScalar(rgba + i * 4, num_pixels - i);
+}
+
+// Halves 8 RGBA pixels of `row` horizontally into 4.
+static inline __m128i DownsampleRow8888(const uint8_t *row) {
+  const __m128 lo =
+      _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row)));
+  const __m128 hi = _mm_castsi128_ps(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + 16)));
+  const __m128i even =
+      _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+  const __m128i odd =
+      _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+  return _mm_avg_epu8(even, odd);
+}
+
+void DownsampleBox2x2(const uint8_t *src, int width, int height, int channels,
+                      uint8_t *dest) {
+  if (channels != 4 || width < 2) {
+    DownsampleBox2x2Scalar(src, width, height, channels, dest);
+    return;
+  }
+  const int dest_width = width / 2;
+  const int dest_height = std::max(height / 2, 1);
+  const size_t stride = static_cast<size_t>(width) * 4;
+  for (int y = 0; y < dest_height; ++y) {
+    const uint8_t *row0 = src + 2 * y * stride;
+    const uint8_t *row1 = height > 1 ? row0 + stride : row0;
+    uint8_t *out = dest + y * dest_width * 4;
+    int x = 0;
+    for (; x + 4 <= dest_width; x += 4) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4),
+                       _mm_avg_epu8(DownsampleRow8888(row0 + x * 8),
+                                    DownsampleRow8888(row1 + x * 8)));
+    }
+    DownsampleRowsScalar(row0, row1, width, 4, x, dest_width, out);
+  }
+}
+
+#else
+
+PixelConversionSimd GetPixelConversionSimd() { return kPixelConversionScalar; }
+
+void Convert8888To5551(const uint8_t *src, uint16_t *dest, size_t num_pixels) {
+  Convert8888To5551Scalar(src, dest, num_pixels);
+}
+
+void Convert888To565(const uint8_t *src, uint16_t *dest, size_t num_pixels) {
+  Convert888To565Scalar(src, dest, num_pixels);
+}
+
+void MultiplyRgbByAlpha(uint8_t *rgba, size_t num_pixels) {
+  MultiplyRgbByAlphaScalar(rgba, num_pixels);
+}
+
+void DownsampleBox2x2(const uint8_t *src, int width, int height, int channels,
+                      uint8_t *dest) {
+  DownsampleBox2x2Scalar(src, width, height, channels, dest);
+}
+
+#endif
+
+}  // namespace fplbase
@@ -0,0 +1,67 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "pixel_unpack_ring_gl.h"
+
+#include "fplbase/glplatform.h"
+#include "fplbase/internal/type_conversions_gl.h"
+
+namespace fplbase {
+
+PixelUnpackRing::PixelUnpackRing() : next_(0) {
+  for (int i = 0; i < kNumBuffers; ++i) {
+    buffers_[i] = InvalidBufferHandle();
+    capacities_[i] = 0;
+  }
+}
+
+bool PixelUnpackRing::Stage(const void *data, size_t size) {
+  if (!data || size == 0 || size > kMaxStagingSize) return false;
+
+  const int index = next_;
+  next_ = (next_ + 1) % kNumBuffers;
+  GLuint buffer = GlBufferHandle(buffers_[index]);
+  if (!buffer) {
+    GL_CALL(glGenBuffers(1, &buffer));
+    buffers_[index] = BufferHandleFromGl(buffer);
+  }
+  GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer));
+  if (capacities_[index] < size) {
+    GL_CALL(glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr,
+                         GL_STREAM_DRAW));
+    capacities_[index] = size;
+  }
+  // Invalidating lets the driver hand out fresh storage if the GPU is still
+  // reading the previous contents, rather than stalling.
+  void *dest = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (!dest) {
+    Unbind();
+    return false;
+  }
+  memcpy(dest, data, size);
+  // The contents are undefined if unmapping fails (e.g. after a mode switch).
+  if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) != GL_TRUE) {
+    Unbind();
+    return false;
+  }
+  return true;
+}
+
+void PixelUnpackRing::Unbind() {
+  GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+}
+
+}  // namespace fplbase
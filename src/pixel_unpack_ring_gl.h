@@ -0,0 +1,63 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_PIXEL_UNPACK_RING_GL_H
+#define FPLBASE_PIXEL_UNPACK_RING_GL_H
+
+#include <stddef.h>
+
+#include "fplbase/handles.h"
+
+namespace fplbase {
+
+/// @brief A small ring of pixel unpack buffers (PBOs) that texture uploads
+/// are staged through on ES3 / GL3.
+///
+/// Staging the pixels into a PBO lets glTexImage2D() and glTexSubImage2D()
+/// return without the driver having to copy (or wait on) client memory, and
+/// cycling through several buffers means a buffer that's still being copied
+/// from by the GPU isn't written to again in the same frame.
+///
+/// The buffers belong to the GL context, and are freed along with it.
+class PixelUnpackRing {
+ public:
+  PixelUnpackRing();
+
+  /// @brief Copy `size` bytes from `data` into the next buffer in the ring,
+  /// and leave it bound to GL_PIXEL_UNPACK_BUFFER.
+  /// @return Returns true if the data was staged, in which case the pixel
+  /// pointers passed to GL must be offsets into the buffer, and Unbind() must
+  /// be called after. Returns false if the data should be uploaded directly,
+  /// e.g. because it doesn't fit or the buffer couldn't be mapped.
+  bool Stage(const void *data, size_t size);
+
+  /// @brief Unbind the buffer bound by Stage().
+  void Unbind();
+
+  /// @brief Number of buffers in the ring.
+  static const int kNumBuffers = 4;
+
+  /// @brief Uploads larger than this go directly from client memory, rather
+  /// than growing the buffers to match.
+  static const size_t kMaxStagingSize = 16 * 1024 * 1024;
+
+ private:
+  BufferHandle buffers_[kNumBuffers];
+  size_t capacities_[kNumBuffers];
+  int next_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_PIXEL_UNPACK_RING_GL_H
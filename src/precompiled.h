@@ -24,6 +24,7 @@
 #include <cstdint>
 
 #include <functional>
+#include <limits>
 #include <map>
 #include <vector>
 #include <string>
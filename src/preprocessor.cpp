@@ -13,8 +13,10 @@
 // limitations under the License.
 
 #include "fplbase/preprocessor.h"
+#include <memory>
 #include <stack>
 #include "fplbase/fpl_common.h"
+#include "fplutil/mutex.h"
 #include "precompiled.h"
 
 namespace fplbase {
@@ -182,35 +184,33 @@ void AppendDefaultVersion(ShaderProfile profile, std::string *result) {
   }
 }
 
-}  // namespace
+// A file with its #include statements taken out.
+struct ParsedFile {
+  ParsedFile() : insertion_point(0) {}
+  std::string text;
+  // Where the #included files go: where the last #include statement was.
+  size_t insertion_point;
+  // The #included files, in order.
+  std::vector<std::string> includes;
+};
 
-bool LoadFileWithDirectivesHelper(
-    const char *filename, std::string *dest, std::string *error_message,
-    std::set<std::string> *all_includes,
-    const std::set<std::string> &defines) {
-  if (!LoadFile(filename, dest)) {
+// Loads `filename` into `parsed`. Copies the text between the #include
+// statements once, rather than erasing each statement from it.
+bool ParseFile(const char *filename, ParsedFile *parsed,
+               std::string *error_message) {
+  std::string source;
+  if (!LoadFile(filename, &source)) {
     *error_message = std::string("cannot load ") + filename;
     return false;
   }
 
-  // Add the #defines.
-  std::string to_insert;
-  for (auto iter = defines.begin(); iter != defines.end(); ++iter) {
-    const std::string &define = *iter;
-    if (!define.empty()) {  // Skip empty strings.
-      to_insert.append("#define ").append(define).append("\n");
-    }
-  }
-  if (to_insert != "") {
-    dest->insert(0, to_insert);
-  }
-
-  all_includes->insert(filename);
-  std::vector<std::string> includes;
-  auto cursor = dest->c_str();
+  std::string *text = &parsed->text;
+  text->reserve(source.size());
+  auto cursor = source.c_str();
+  // The start of what's not yet copied to `text`.
+  auto uncopied = cursor;
   static const char kIncludeStatement[] = "#include";
   auto include_len = sizeof(kIncludeStatement) - 1;
-  size_t insertion_point = 0;
   // Parse only lines that are include statements, skipping everything else.
   while (*cursor) {
     cursor = SkipWhitespaceInLine(cursor);
@@ -222,11 +222,12 @@ bool LoadFileWithDirectivesHelper(
         cursor++;
         auto len = strcspn(cursor, "\"\n\r");  // Filename part.
         if (cursor[len] == '\"') {             // Ending quote.
-          includes.push_back(std::string(cursor, len));
+          parsed->includes.push_back(std::string(cursor, len));
+          // Leave out the statement, up to the ending quote.
+          text->append(uncopied, start - uncopied);
+          parsed->insertion_point = text->length();
           cursor += len + 1;
-          insertion_point = start - dest->c_str();
-          dest->erase(insertion_point, cursor - start);
-          cursor = start;
+          uncopied = cursor;
           cursor += strspn(cursor, "\n\r \t");  // Skip whitespace and newline.
           continue;
         }
@@ -235,32 +236,131 @@ bool LoadFileWithDirectivesHelper(
     // Something else, skip it.
     cursor = FindNextLine(cursor);
   }
+  text->append(uncopied, cursor - uncopied);
+  return true;
+}
 
-  // Now insert the includes.
-  std::string include;
-  for (auto it = includes.begin(); it != includes.end(); ++it) {
+// The parsed files that shaders #include, by name, so that headers shared by
+// many shaders are loaded and parsed only once. Shaders load on the
+// AsyncLoader's threads, hence the lock.
+//
+// `generation` is LoadFileFunctionGeneration() from before the file was
+// looked for, since files may read differently with another load function.
+class IncludeCache {
+ public:
+  IncludeCache() : generation_(0) {}
+
+  std::shared_ptr<const ParsedFile> Find(const std::string &filename,
+                                         uint32_t generation) {
+    fplutil::MutexLock lock(mutex_);
+    if (generation != generation_) {
+      files_.clear();
+      generation_ = generation;
+    }
+    auto it = files_.find(filename);
+    return it == files_.end() ? nullptr : it->second;
+  }
+
+  void Insert(const std::string &filename, uint32_t generation,
+              const std::shared_ptr<const ParsedFile> &file) {
+    fplutil::MutexLock lock(mutex_);
+    // Files loaded with an older load function aren't kept.
+    if (generation == generation_) files_[filename] = file;
+  }
+
+  void Clear() {
+    fplutil::MutexLock lock(mutex_);
+    files_.clear();
+  }
+
+ private:
+  fplutil::Mutex mutex_;
+  uint32_t generation_;
+  std::map<std::string, std::shared_ptr<const ParsedFile>> files_;
+};
+
+IncludeCache &GetIncludeCache() {
+  static IncludeCache *cache = new IncludeCache();
+  return *cache;
+}
+
+// Appends `filename` to `dest`, with `defines` before it and the files it
+// #includes in place, unless they're already in `all_includes`. Every file
+// is appended straight to `dest`, so this is linear in the length of the
+// result.
+bool AppendFileWithDirectives(const char *filename, bool is_include,
+                              const std::set<std::string> &defines,
+                              std::set<std::string> *all_includes,
+                              std::string *dest, std::string *error_message) {
+  // The shaders themselves aren't cached, so edits to them show on reload.
+  std::shared_ptr<const ParsedFile> parsed;
+  const uint32_t generation = LoadFileFunctionGeneration();
+  if (is_include) parsed = GetIncludeCache().Find(filename, generation);
+  if (!parsed) {
+    std::shared_ptr<ParsedFile> file(new ParsedFile());
+    if (!ParseFile(filename, file.get(), error_message)) return false;
+    if (is_include) GetIncludeCache().Insert(filename, generation, file);
+    parsed = file;
+  }
+
+  // Add the #defines.
+  for (auto iter = defines.begin(); iter != defines.end(); ++iter) {
+    const std::string &define = *iter;
+    if (!define.empty()) {  // Skip empty strings.
+      dest->append("#define ").append(define).append("\n");
+    }
+  }
+  dest->append(parsed->text, 0, parsed->insertion_point);
+
+  all_includes->insert(filename);
+
+  // Now the includes, where the last #include statement was.
+  for (auto it = parsed->includes.begin(); it != parsed->includes.end();
+       ++it) {
     if (all_includes->find(*it) == all_includes->end()) {
-      if (!LoadFileWithDirectivesHelper(it->c_str(), &include, error_message,
-                                        all_includes, kEmptySet)) {
+      const size_t include_start = dest->length();
+      if (!AppendFileWithDirectives(it->c_str(), true, kEmptySet, all_includes,
+                                    dest, error_message)) {
         return false;
       }
-      dest->insert(insertion_point, include);
-      insertion_point += include.length();
       // Ensure there's a linefeed at eof.
-      if (include.size() && include.back() != '\n') {
-        dest->insert(insertion_point++, "\n");
+      if (dest->length() > include_start && dest->back() != '\n') {
+        dest->push_back('\n');
       }
     }
   }
+
+  dest->append(parsed->text, parsed->insertion_point, std::string::npos);
   return true;
 }
 
+}  // namespace
+
+void ClearShaderIncludeCache() { GetIncludeCache().Clear(); }
+
+bool LoadFileWithDirectives(const char *filename, std::string *dest,
+                            const std::set<std::string> &defines,
+                            std::string *error_message) {
+  std::set<std::string> all_includes;
+  dest->clear();
+  return AppendFileWithDirectives(filename, false, defines, &all_includes,
+                                  dest, error_message);
+}
+
 bool LoadFileWithDirectives(const char *filename, std::string *dest,
                             const std::set<std::string> &defines,
+                            std::set<std::string> *includes,
                             std::string *error_message) {
   std::set<std::string> all_includes;
-  return LoadFileWithDirectivesHelper(filename, dest, error_message,
-                                      &all_includes, defines);
+  dest->clear();
+  if (!AppendFileWithDirectives(filename, false, defines, &all_includes, dest,
+                                error_message)) {
+    return false;
+  }
+  // `all_includes` starts with the file itself.
+  all_includes.erase(filename);
+  includes->insert(all_includes.begin(), all_includes.end());
+  return true;
 }
 
 bool LoadFileWithDirectives(const char *filename, std::string *dest,
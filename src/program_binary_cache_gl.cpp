@@ -0,0 +1,164 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "program_binary_cache_gl.h"
+
+#include <string.h>
+
+#include "fplbase/file_utilities.h"
+#include "fplbase/glplatform.h"
+#include "fplbase/logging.h"
+
+namespace fplbase {
+
+namespace {
+
+// Bump when the file layout, or how programs are linked, changes.
+const uint32_t kProgramBinaryMagic = 0x42504C46;  // "FLPB"
+const uint32_t kProgramBinaryVersion = 1;
+
+struct ProgramBinaryHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t driver_hash;
+  uint32_t binary_format;
+  uint32_t binary_size;
+};
+
+// 64-bit FNV-1a, continuing from `hash`.
+uint64_t HashBytes(const void *data, size_t size, uint64_t hash) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+uint64_t HashString(const char *s, uint64_t hash) {
+  // Hash the terminator too, so "ab" + "c" and "a" + "bc" differ.
+  return s ? HashBytes(s, strlen(s) + 1, hash) : HashBytes("", 1, hash);
+}
+
+const uint64_t kHashOffsetBasis = 0xCBF29CE484222325ULL;
+
+}  // namespace
+
+ProgramBinaryCache::ProgramBinaryCache() : driver_hash_(0) {}
+
+bool ProgramBinaryCache::Initialize(const char *directory) {
+  directory_.clear();
+#if defined(GL_NUM_PROGRAM_BINARY_FORMATS) && !defined(PLATFORM_OSX)
+  // Drivers may support the entry points yet not return any binaries.
+  GLint num_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  if (glGetError() != GL_NO_ERROR || num_formats <= 0) return false;
+
+  uint64_t hash = kHashOffsetBasis;
+  hash = HashString(reinterpret_cast<const char *>(glGetString(GL_VENDOR)),
+                    hash);
+  hash = HashString(reinterpret_cast<const char *>(glGetString(GL_RENDERER)),
+                    hash);
+  hash = HashString(reinterpret_cast<const char *>(glGetString(GL_VERSION)),
+                    hash);
+  driver_hash_ = hash;
+  directory_ = directory;
+  if (!directory_.empty() && directory_[directory_.size() - 1] != '/') {
+    directory_ += '/';
+  }
+  return enabled();
+#else
+  (void)directory;
+  return false;
+#endif
+}
+
+uint64_t ProgramBinaryCache::Key(const char *vs_source, const char *ps_source,
+                                 const std::string &salt) const {
+  uint64_t hash = HashString(vs_source, kHashOffsetBasis);
+  hash = HashString(ps_source, hash);
+  return HashString(salt.c_str(), hash);
+}
+
+std::string ProgramBinaryCache::FileName(uint64_t key) const {
+  static const char kHexDigits[] = "0123456789abcdef";
+  std::string name = directory_;
+  for (int shift = 60; shift >= 0; shift -= 4) {
+    name += kHexDigits[(key >> shift) & 0xF];
+  }
+  return name + ".glprogram";
+}
+
+bool ProgramBinaryCache::Load(uint64_t key, unsigned int program) const {
+#if defined(GL_NUM_PROGRAM_BINARY_FORMATS) && !defined(PLATFORM_OSX)
+  if (!enabled()) return false;
+  std::string file;
+  if (!LoadFileRaw(FileName(key).c_str(), &file)) return false;
+  ProgramBinaryHeader header;
+  if (file.size() < sizeof(header)) return false;
+  memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != kProgramBinaryMagic ||
+      header.version != kProgramBinaryVersion ||
+      header.driver_hash != driver_hash_ ||
+      header.binary_size != file.size() - sizeof(header)) {
+    // Most likely from before a driver update. Store() replaces it.
+    return false;
+  }
+  GL_CALL(glProgramBinary(program, header.binary_format,
+                          file.data() + sizeof(header),
+                          static_cast<GLsizei>(header.binary_size)));
+  // Drivers may reject binaries for reasons of their own, which only shows
+  // in the link status.
+  GLint status = GL_FALSE;
+  GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+  return status == GL_TRUE;
+#else
+  (void)key;
+  (void)program;
+  return false;
+#endif
+}
+
+void ProgramBinaryCache::Store(uint64_t key, unsigned int program) const {
+#if defined(GL_NUM_PROGRAM_BINARY_FORMATS) && !defined(PLATFORM_OSX)
+  if (!enabled()) return;
+  GLint length = 0;
+  GL_CALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+  if (length <= 0) return;
+
+  std::string file(sizeof(ProgramBinaryHeader) + length, '\0');
+  GLenum binary_format = 0;
+  GLsizei binary_size = 0;
+  GL_CALL(glGetProgramBinary(program, length, &binary_size, &binary_format,
+                             &file[sizeof(ProgramBinaryHeader)]));
+  if (binary_size <= 0) return;
+  file.resize(sizeof(ProgramBinaryHeader) + binary_size);
+
+  ProgramBinaryHeader header;
+  header.magic = kProgramBinaryMagic;
+  header.version = kProgramBinaryVersion;
+  header.driver_hash = driver_hash_;
+  header.binary_format = binary_format;
+  header.binary_size = static_cast<uint32_t>(binary_size);
+  memcpy(&file[0], &header, sizeof(header));
+  if (!SaveFile(FileName(key).c_str(), file)) {
+    LogError("Can't save program binary %s", FileName(key).c_str());
+  }
+#else
+  (void)key;
+  (void)program;
+#endif
+}
+
+}  // namespace fplbase
@@ -0,0 +1,64 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_PROGRAM_BINARY_CACHE_GL_H
+#define FPLBASE_PROGRAM_BINARY_CACHE_GL_H
+
+#include <stdint.h>
+#include <string>
+
+namespace fplbase {
+
+/// @brief Linked shader programs saved to disk with glGetProgramBinary, so
+/// later runs can skip compiling and linking them.
+///
+/// Each program is stored in its own file, named after a hash of its sources.
+/// The file also records which driver made it: after a driver update the
+/// binary is no longer loaded, and is overwritten with a new one.
+class ProgramBinaryCache {
+ public:
+  ProgramBinaryCache();
+
+  /// @brief Start caching programs in `directory`, which must exist. Needs a
+  /// GL context. Returns false if the driver can't return program binaries.
+  bool Initialize(const char *directory);
+
+  /// @brief Whether Initialize() succeeded.
+  bool enabled() const { return !directory_.empty(); }
+
+  /// @brief The key of the program linked from these sources. The sources
+  /// include their defines, so each shader variant has its own key.
+  uint64_t Key(const char *vs_source, const char *ps_source,
+               const std::string &salt) const;
+
+  /// @brief Load the binary stored under `key` into `program`. Returns false
+  /// if there is none, or the driver rejected it, in which case `program`
+  /// has to be compiled and linked as usual.
+  bool Load(uint64_t key, unsigned int program) const;
+
+  /// @brief Store the just-linked `program` under `key`. The program should
+  /// have GL_PROGRAM_BINARY_RETRIEVABLE_HINT set before it was linked.
+  void Store(uint64_t key, unsigned int program) const;
+
+ private:
+  std::string FileName(uint64_t key) const;
+
+  std::string directory_;
+  // Hash of the GL vendor, renderer and version strings.
+  uint64_t driver_hash_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_PROGRAM_BINARY_CACHE_GL_H
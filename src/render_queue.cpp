@@ -0,0 +1,244 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/render_queue.h"
+
+#include "fplbase/material.h"
+#include "fplbase/mesh.h"
+#include "fplbase/render_target.h"
+#include "fplbase/renderer.h"
+
+using mathfu::mat4;
+using mathfu::vec4;
+
+namespace fplbase {
+
+// Widths of the sort key fields. Ids past a field's range share its largest
+// value, which only costs state changes, since Flush() compares the actual
+// state between draws.
+static const int kTargetBits = 8;
+static const int kRenderStateBits = 7;
+static const int kShaderBits = 12;
+static const int kMaterialBits = 12;
+static const int kDepthBits = 24;
+static_assert(kTargetBits + 1 + kRenderStateBits + kShaderBits +
+                      kMaterialBits + kDepthBits ==
+                  64,
+              "The sort key fields must fill 64 bits.");
+
+// Render states are deduplicated by linear search, so only this many are
+// looked for. Later ones are kept once per draw.
+static const size_t kMaxSearchedRenderStates = 1 << kRenderStateBits;
+
+static uint64_t KeyField(uint32_t value, int bits) {
+  const uint32_t max_value = (1u << bits) - 1;
+  return value < max_value ? value : max_value;
+}
+
+// Maps a float to the top `kDepthBits` bits of an unsigned int that sorts in
+// the same order.
+static uint32_t DepthKey(float depth) {
+  uint32_t bits;
+  memcpy(&bits, &depth, sizeof(bits));
+  bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+  return bits >> (32 - kDepthBits);
+}
+
+static vec4 Unpack(const mathfu::vec4_packed &v) { return vec4(v); }
+
+static mat4 Unpack(const mathfu::vec4_packed *columns) {
+  return mat4(vec4(columns[0]), vec4(columns[1]), vec4(columns[2]),
+              vec4(columns[3]));
+}
+
+static bool IsTranslucent(const RenderState &render_state,
+                          const Material *material) {
+  if (material) {
+    return material->blend_mode() != kBlendModeOff &&
+           material->blend_mode() != kBlendModeTest;
+  }
+  return render_state.blend_state.enabled;
+}
+
+// static
+uint32_t RenderQueue::Id(const void *object, IdMap *ids) {
+  auto it = ids->insert(
+      std::make_pair(object, static_cast<uint32_t>(ids->size())));
+  return it.first->second;
+}
+
+size_t RenderQueue::RenderStateIndex(const RenderState &unpacked) {
+  // Packed states compare their hashes first, so each miss is one compare.
+  const PackedRenderState render_state(unpacked);
+  // Consecutive submissions usually share a state, so check the last first.
+  if (!draws_.empty() &&
+      render_states_[draws_.back().render_state] == render_state) {
+    return draws_.back().render_state;
+  }
+  const size_t searched =
+      std::min(render_states_.size(), kMaxSearchedRenderStates);
+  for (size_t i = 0; i < searched; ++i) {
+    if (render_states_[i] == render_state) return i;
+  }
+  render_states_.push_back(render_state);
+  return render_states_.size() - 1;
+}
+
+void RenderQueue::Submit(const RenderQueueItem &item) {
+  assert(item.mesh && item.shader);
+  Draw draw;
+  draw.mesh = item.mesh;
+  draw.submesh = item.submesh;
+  draw.lod = item.lod;
+  draw.shader = item.shader;
+  draw.material = item.material;
+  if (!draw.material && item.mesh->GetNumIndexBufferObjects() > 0) {
+    draw.material = item.mesh->GetMaterial(static_cast<int>(item.submesh));
+  }
+  draw.target = item.target;
+  draw.render_state = RenderStateIndex(item.render_state);
+  item.model_view_projection.Pack(draw.model_view_projection);
+  item.model.Pack(draw.model);
+  item.color.Pack(&draw.color);
+
+  // Opaque draws are grouped by state, then drawn nearest first within each
+  // group. Translucent draws must be drawn farthest first, so depth comes
+  // before state, and only draws at the same depth are grouped.
+  const uint64_t target = KeyField(Id(draw.target, &target_ids_), kTargetBits);
+  const uint64_t state = (KeyField(static_cast<uint32_t>(draw.render_state),
+                                   kRenderStateBits)
+                          << (kShaderBits + kMaterialBits)) |
+                         (KeyField(Id(draw.shader, &shader_ids_), kShaderBits)
+                          << kMaterialBits) |
+                         KeyField(Id(draw.material, &material_ids_),
+                                  kMaterialBits);
+  const int state_bits = kRenderStateBits + kShaderBits + kMaterialBits;
+  const uint32_t depth = DepthKey(item.depth);
+  uint64_t key = target << (64 - kTargetBits);
+  if (IsTranslucent(item.render_state, draw.material)) {
+    const uint32_t far_first = ~depth & ((1u << kDepthBits) - 1);
+    key |= uint64_t(1) << (63 - kTargetBits);
+    key |= (static_cast<uint64_t>(far_first) << state_bits) | state;
+  } else {
+    key |= (state << kDepthBits) | depth;
+  }
+
+  order_.push_back(std::make_pair(key, static_cast<uint32_t>(draws_.size())));
+  draws_.push_back(draw);
+}
+
+void RenderQueue::SubmitMesh(const RenderQueueItem &item) {
+  const size_t num_submeshes =
+      std::max(item.mesh->GetNumIndexBufferObjects(), size_t(1));
+  RenderQueueItem submesh_item = item;
+  for (size_t i = 0; i < num_submeshes; ++i) {
+    submesh_item.submesh = i;
+    Submit(submesh_item);
+  }
+}
+
+void RenderQueue::Sort() {
+  // Ties keep submission order, since the index is the second half of each
+  // pair.
+  std::sort(order_.begin(), order_.end());
+}
+
+// Binds `target`, and tells the renderer about the viewport that sets.
+static void BindTarget(Renderer &renderer, const RenderTarget &target) {
+  // SetAsRenderTarget() sets the viewport behind the renderer's back.
+  target.SetAsRenderTarget();
+  RenderState cached = renderer.GetRenderState();
+  cached.viewport = Viewport(mathfu::kZeros2i, target.dimensions());
+  renderer.UpdateCachedRenderState(cached);
+}
+
+void RenderQueue::Flush(Renderer &renderer) {
+  Sort();
+
+  // What was bound when Flush() began, to go back to for untargeted draws.
+  // It's still bound when the first target is, so it's read then.
+  const Viewport viewport = renderer.GetRenderState().viewport;
+  RenderTarget original;
+  const RenderTarget *bound = nullptr;
+
+  const Draw *previous = nullptr;
+  for (auto it = order_.begin(); it != order_.end(); ++it) {
+    const Draw &draw = draws_[it->second];
+    const PackedRenderState &render_state = render_states_[draw.render_state];
+
+    // Equal states mostly share an index, and SetRenderState() makes no
+    // changes for those that don't.
+    bool state_changed =
+        !previous || draw.render_state != previous->render_state;
+    if (draw.target != bound) {
+      if (draw.target) {
+        if (!bound) original = RenderTarget::BoundRenderTarget(renderer);
+        BindTarget(renderer, *draw.target);
+      } else {
+        BindTarget(renderer, original);
+        renderer.SetViewport(viewport);
+      }
+      bound = draw.target;
+      state_changed = true;
+    }
+    if (state_changed) renderer.SetRenderState(render_state);
+
+    // Materials set the blend mode, which SetRenderState() overrides.
+    if (draw.material &&
+        (state_changed || draw.material != previous->material)) {
+      draw.material->Set(renderer);
+    }
+
+    // SetShader() only sends the uniforms that changed since the shader was
+    // last set.
+    renderer.set_model_view_projection(Unpack(draw.model_view_projection));
+    renderer.set_model(Unpack(draw.model));
+    renderer.set_color(Unpack(draw.color));
+    renderer.SetShader(draw.shader);
+
+    renderer.RenderSubMesh(draw.mesh, draw.submesh, true, 1, draw.lod);
+    previous = &draw;
+  }
+  if (bound) {
+    BindTarget(renderer, original);
+    renderer.SetViewport(viewport);
+  }
+  Clear();
+}
+
+std::vector<const RenderTarget *> RenderQueue::TargetOrder() {
+  Sort();
+  // The same switches Flush() makes.
+  std::vector<const RenderTarget *> targets;
+  const RenderTarget *bound = nullptr;
+  for (auto it = order_.begin(); it != order_.end(); ++it) {
+    const RenderTarget *target = draws_[it->second].target;
+    if (target != bound) targets.push_back(target);
+    bound = target;
+  }
+  if (bound) targets.push_back(nullptr);
+  return targets;
+}
+
+void RenderQueue::Clear() {
+  draws_.clear();
+  render_states_.clear();
+  target_ids_.clear();
+  shader_ids_.clear();
+  material_ids_.clear();
+  order_.clear();
+}
+
+}  // namespace fplbase
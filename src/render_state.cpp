@@ -0,0 +1,282 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"  // NOLINT
+
+#include "fplbase/render_state.h"
+
+namespace fplbase {
+
+namespace {
+
+// Where each part of the state lives in PackedRenderState's flags.
+enum {
+  kAlphaTestEnabledShift = 0,
+  kAlphaTestFunctionShift = 1,
+  kBlendEnabledShift = 4,
+  kBlendSrcAlphaShift = 5,
+  kBlendSrcColorShift = 9,
+  kBlendDstAlphaShift = 13,
+  kBlendDstColorShift = 17,
+  kCullFaceShift = 21,
+  kCullFrontShift = 23,
+  kCullEnabledShift = 24,
+  kDepthFunctionShift = 25,
+  kDepthTestEnabledShift = 28,
+  kDepthWriteEnabledShift = 29,
+  kPointSpriteEnabledShift = 30,
+  kProgramPointSizeEnabledShift = 31,
+  kScissorEnabledShift = 32,
+  kStencilEnabledShift = 33,
+  kStencilBackFunctionShift = 34,
+  kStencilBackOpShift = 37,
+  kStencilFrontFunctionShift = 46,
+  kStencilFrontOpShift = 49,
+  kNumFlagBits = 58
+};
+
+// Each enum gets enough bits for all of its values.
+const int kRenderFunctionBits = 3;
+const int kBlendFactorBits = 4;
+const int kCullFaceBits = 2;
+const int kStencilOpBits = 3;
+
+static_assert(kRenderCount <= (1 << kRenderFunctionBits),
+              "RenderFunction doesn't fit in its bits.");
+static_assert(BlendState::kCount <= (1 << kBlendFactorBits),
+              "BlendFactor doesn't fit in its bits.");
+static_assert(CullState::kCullFaceCount <= (1 << kCullFaceBits),
+              "CullFace doesn't fit in its bits.");
+static_assert(StencilOperation::kCount <= (1 << kStencilOpBits),
+              "StencilOperations doesn't fit in its bits.");
+static_assert(kNumFlagBits <= 64, "Render state flags don't fit in 64 bits.");
+
+uint64_t FlagMask(int begin, int end) {
+  return ((uint64_t(1) << (end - begin)) - 1) << begin;
+}
+
+// The flags of each Component, in Component order.
+const uint64_t kComponentFlags[] = {
+    FlagMask(kAlphaTestEnabledShift, kBlendEnabledShift),
+    FlagMask(kBlendEnabledShift, kCullFaceShift),
+    FlagMask(kCullFaceShift, kDepthFunctionShift),
+    FlagMask(kDepthFunctionShift, kPointSpriteEnabledShift),
+    FlagMask(kPointSpriteEnabledShift, kScissorEnabledShift),
+    FlagMask(kScissorEnabledShift, kStencilEnabledShift),
+    FlagMask(kStencilEnabledShift, kNumFlagBits),
+    0,  // The viewport is all values.
+};
+
+uint64_t Field(uint32_t value, int shift) {
+  return static_cast<uint64_t>(value) << shift;
+}
+
+uint32_t GetField(uint64_t flags, int shift, int bits) {
+  return static_cast<uint32_t>((flags >> shift) & ((uint64_t(1) << bits) - 1));
+}
+
+uint32_t FloatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float BitsFloat(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint64_t PackStencilOp(const StencilOperation &op) {
+  return Field(op.stencil_fail, 0) | Field(op.depth_fail, kStencilOpBits) |
+         Field(op.pass, 2 * kStencilOpBits);
+}
+
+StencilOperation UnpackStencilOp(uint64_t flags, int shift) {
+  StencilOperation op;
+  op.stencil_fail = static_cast<StencilOperation::StencilOperations>(
+      GetField(flags, shift, kStencilOpBits));
+  op.depth_fail = static_cast<StencilOperation::StencilOperations>(
+      GetField(flags, shift + kStencilOpBits, kStencilOpBits));
+  op.pass = static_cast<StencilOperation::StencilOperations>(
+      GetField(flags, shift + 2 * kStencilOpBits, kStencilOpBits));
+  return op;
+}
+
+void PackRect(const mathfu::recti &rect, uint32_t *values) {
+  values[0] = static_cast<uint32_t>(rect.pos.x);
+  values[1] = static_cast<uint32_t>(rect.pos.y);
+  values[2] = static_cast<uint32_t>(rect.size.x);
+  values[3] = static_cast<uint32_t>(rect.size.y);
+}
+
+mathfu::recti UnpackRect(const uint32_t *values) {
+  return mathfu::recti(
+      static_cast<int>(values[0]), static_cast<int>(values[1]),
+      static_cast<int>(values[2]), static_cast<int>(values[3]));
+}
+
+// Mixes a word into a 64 bit hash, FNV-1a style but a word at a time.
+uint64_t HashWord(uint64_t hash, uint64_t word) {
+  hash ^= word;
+  hash *= 0x100000001b3ULL;
+  return hash ^ (hash >> 29);
+}
+
+}  // namespace
+
+PackedRenderState::PackedRenderState() { Pack(RenderState()); }
+
+PackedRenderState::PackedRenderState(const RenderState &render_state) {
+  Pack(render_state);
+}
+
+void PackedRenderState::Pack(const RenderState &render_state) {
+  const AlphaTestState &alpha = render_state.alpha_test_state;
+  const BlendState &blend = render_state.blend_state;
+  const CullState &cull = render_state.cull_state;
+  const DepthState &depth = render_state.depth_state;
+  const PointState &point = render_state.point_state;
+  const StencilState &stencil = render_state.stencil_state;
+
+  flags_ =
+      Field(alpha.enabled, kAlphaTestEnabledShift) |
+      Field(alpha.function, kAlphaTestFunctionShift) |
+      Field(blend.enabled, kBlendEnabledShift) |
+      Field(blend.src_alpha, kBlendSrcAlphaShift) |
+      Field(blend.src_color, kBlendSrcColorShift) |
+      Field(blend.dst_alpha, kBlendDstAlphaShift) |
+      Field(blend.dst_color, kBlendDstColorShift) |
+      Field(cull.face, kCullFaceShift) | Field(cull.front, kCullFrontShift) |
+      Field(cull.enabled, kCullEnabledShift) |
+      Field(depth.function, kDepthFunctionShift) |
+      Field(depth.test_enabled, kDepthTestEnabledShift) |
+      Field(depth.write_enabled, kDepthWriteEnabledShift) |
+      Field(point.point_sprite_enabled, kPointSpriteEnabledShift) |
+      Field(point.program_point_size_enabled, kProgramPointSizeEnabledShift) |
+      Field(render_state.scissor_state.enabled, kScissorEnabledShift) |
+      Field(stencil.enabled, kStencilEnabledShift) |
+      Field(stencil.back_function.function, kStencilBackFunctionShift) |
+      (PackStencilOp(stencil.back_op) << kStencilBackOpShift) |
+      Field(stencil.front_function.function, kStencilFrontFunctionShift) |
+      (PackStencilOp(stencil.front_op) << kStencilFrontOpShift);
+
+  values_[kAlphaTestRefValue] = FloatBits(alpha.ref);
+  values_[kPointSizeValue] = FloatBits(point.point_size);
+  values_[kBackStencilRefValue] =
+      static_cast<uint32_t>(stencil.back_function.ref);
+  values_[kBackStencilMaskValue] = stencil.back_function.mask;
+  values_[kFrontStencilRefValue] =
+      static_cast<uint32_t>(stencil.front_function.ref);
+  values_[kFrontStencilMaskValue] = stencil.front_function.mask;
+  PackRect(render_state.scissor_state.rect, &values_[kScissorValues]);
+  PackRect(render_state.viewport, &values_[kViewportValues]);
+
+  hash_ = HashWord(0xcbf29ce484222325ULL, flags_);
+  for (int i = 0; i < kNumValues; ++i) hash_ = HashWord(hash_, values_[i]);
+}
+
+void PackedRenderState::Unpack(RenderState *render_state) const {
+  AlphaTestState &alpha = render_state->alpha_test_state;
+  alpha.enabled = GetField(flags_, kAlphaTestEnabledShift, 1) != 0;
+  alpha.function = static_cast<RenderFunction>(
+      GetField(flags_, kAlphaTestFunctionShift, kRenderFunctionBits));
+  alpha.ref = BitsFloat(values_[kAlphaTestRefValue]);
+
+  BlendState &blend = render_state->blend_state;
+  blend.enabled = GetField(flags_, kBlendEnabledShift, 1) != 0;
+  blend.src_alpha = static_cast<BlendState::BlendFactor>(
+      GetField(flags_, kBlendSrcAlphaShift, kBlendFactorBits));
+  blend.src_color = static_cast<BlendState::BlendFactor>(
+      GetField(flags_, kBlendSrcColorShift, kBlendFactorBits));
+  blend.dst_alpha = static_cast<BlendState::BlendFactor>(
+      GetField(flags_, kBlendDstAlphaShift, kBlendFactorBits));
+  blend.dst_color = static_cast<BlendState::BlendFactor>(
+      GetField(flags_, kBlendDstColorShift, kBlendFactorBits));
+
+  CullState &cull = render_state->cull_state;
+  cull.face = static_cast<CullState::CullFace>(
+      GetField(flags_, kCullFaceShift, kCullFaceBits));
+  cull.front =
+      static_cast<CullState::FrontFace>(GetField(flags_, kCullFrontShift, 1));
+  cull.enabled = GetField(flags_, kCullEnabledShift, 1) != 0;
+
+  DepthState &depth = render_state->depth_state;
+  depth.function = static_cast<RenderFunction>(
+      GetField(flags_, kDepthFunctionShift, kRenderFunctionBits));
+  depth.test_enabled = GetField(flags_, kDepthTestEnabledShift, 1) != 0;
+  depth.write_enabled = GetField(flags_, kDepthWriteEnabledShift, 1) != 0;
+
+  PointState &point = render_state->point_state;
+  point.point_sprite_enabled =
+      GetField(flags_, kPointSpriteEnabledShift, 1) != 0;
+  point.program_point_size_enabled =
+      GetField(flags_, kProgramPointSizeEnabledShift, 1) != 0;
+  point.point_size = BitsFloat(values_[kPointSizeValue]);
+
+  ScissorState &scissor = render_state->scissor_state;
+  scissor.enabled = GetField(flags_, kScissorEnabledShift, 1) != 0;
+  scissor.rect = UnpackRect(&values_[kScissorValues]);
+
+  StencilState &stencil = render_state->stencil_state;
+  stencil.enabled = GetField(flags_, kStencilEnabledShift, 1) != 0;
+  stencil.back_function.function = static_cast<RenderFunction>(
+      GetField(flags_, kStencilBackFunctionShift, kRenderFunctionBits));
+  stencil.back_function.ref = static_cast<int>(values_[kBackStencilRefValue]);
+  stencil.back_function.mask = values_[kBackStencilMaskValue];
+  stencil.back_op = UnpackStencilOp(flags_, kStencilBackOpShift);
+  stencil.front_function.function = static_cast<RenderFunction>(
+      GetField(flags_, kStencilFrontFunctionShift, kRenderFunctionBits));
+  stencil.front_function.ref =
+      static_cast<int>(values_[kFrontStencilRefValue]);
+  stencil.front_function.mask = values_[kFrontStencilMaskValue];
+  stencil.front_op = UnpackStencilOp(flags_, kStencilFrontOpShift);
+
+  render_state->viewport = UnpackRect(&values_[kViewportValues]);
+}
+
+uint32_t PackedRenderState::Diff(const PackedRenderState &other) const {
+  if (hash_ == other.hash_ && *this == other) return 0;
+
+  const uint64_t changed_flags = flags_ ^ other.flags_;
+  uint32_t changed = 0;
+  for (size_t i = 0; i < sizeof(kComponentFlags) / sizeof(kComponentFlags[0]);
+       ++i) {
+    if (changed_flags & kComponentFlags[i]) changed |= 1u << i;
+  }
+  if (!ValuesEqual(other, kAlphaTestRefValue, kAlphaTestRefValue + 1)) {
+    changed |= kAlphaTestComponent;
+  }
+  if (!ValuesEqual(other, kPointSizeValue, kPointSizeValue + 1)) {
+    changed |= kPointComponent;
+  }
+  if (!ValuesEqual(other, kBackStencilRefValue, kScissorValues)) {
+    changed |= kStencilComponent;
+  }
+  if (!ValuesEqual(other, kScissorValues, kViewportValues)) {
+    changed |= kScissorComponent;
+  }
+  if (!ValuesEqual(other, kViewportValues, kNumValues)) {
+    changed |= kViewportComponent;
+  }
+  return changed;
+}
+
+bool PackedRenderState::ValuesEqual(const PackedRenderState &other, int begin,
+                                    int end) const {
+  return memcmp(&values_[begin], &other.values_[begin],
+                (end - begin) * sizeof(values_[0])) == 0;
+}
+
+}  // namespace fplbase
@@ -23,12 +23,50 @@ void RenderTarget::Initialize(const mathfu::vec2i& dimensions) {
              kDepthStencilFormatNone);
 }
 
+// static
+size_t RenderTarget::CalculateMemorySize(
+    const mathfu::vec2i& dimensions, RenderTargetTextureFormat texture_format,
+    DepthStencilFormat depth_stencil_format) {
+  size_t texture_bytes = 0;
+  // clang-format off
+  switch (texture_format) {
+    case kRenderTargetTextureFormatA8:      texture_bytes = 1; break;
+    case kRenderTargetTextureFormatR8:      texture_bytes = 1; break;
+    case kRenderTargetTextureFormatRGB8:    texture_bytes = 3; break;
+    case kRenderTargetTextureFormatRGBA8:   texture_bytes = 4; break;
+    case kRenderTargetTextureFormatDepth16: texture_bytes = 2; break;
+    case kRenderTargetTextureFormatDepth32F: texture_bytes = 4; break;
+    default:                                                   break;
+  }
+  const bool is_depth_texture =
+      texture_format == kRenderTargetTextureFormatDepth16 ||
+      texture_format == kRenderTargetTextureFormatDepth32F;
+  size_t depth_bytes = 0;
+  if (!is_depth_texture) {
+    switch (depth_stencil_format) {
+      case kDepthStencilFormatDepth16:          depth_bytes = 2; break;
+      // Drivers pad 24 bit depth to 32 bits.
+      case kDepthStencilFormatDepth24:          depth_bytes = 4; break;
+      case kDepthStencilFormatDepth32F:         depth_bytes = 4; break;
+      case kDepthStencilFormatDepth24Stencil8:  depth_bytes = 4; break;
+      case kDepthStencilFormatDepth32FStencil8: depth_bytes = 8; break;
+      case kDepthStencilFormatStencil8:         depth_bytes = 1; break;
+      default:                                                   break;
+    }
+  }
+  // clang-format on
+  return static_cast<size_t>(dimensions.x) * dimensions.y *
+         (texture_bytes + depth_bytes);
+}
+
 // Generates a render target that represents the screen.
 RenderTarget RenderTarget::ScreenRenderTarget(Renderer& renderer) {
   RenderTarget screen_render_target = RenderTarget();
   screen_render_target.framebuffer_id_ = InvalidBufferHandle();
   screen_render_target.rendered_texture_id_ = InvalidTextureHandle();
   screen_render_target.depth_buffer_id_ = InvalidBufferHandle();
+  screen_render_target.color_buffer_id_ = InvalidBufferHandle();
+  screen_render_target.resolve_framebuffer_id_ = InvalidBufferHandle();
   mathfu::vec2i window_size = renderer.environment().GetViewportSize();
   screen_render_target.dimensions_ = window_size;
   screen_render_target.initialized_ = true;
@@ -17,13 +17,171 @@
 #include "fplbase/render_target.h"
 #include "fplbase/fpl_common.h"
 #include "fplbase/internal/type_conversions_gl.h"
+#include "texture_bindings_gl.h"
+
+#ifndef GL_TEXTURE_2D_ARRAY
+#define GL_TEXTURE_2D_ARRAY 0x8C1A
+#endif
+#ifndef GL_MAX_SAMPLES
+#define GL_MAX_SAMPLES 0x8D57
+#endif
 
 namespace fplbase {
 
+// RendererBase::SupportsMultiview() is never true on Apple platforms, whose
+// headers don't declare the entry points.
+#if defined(__APPLE__)
+
+static void FramebufferTextureMultiview(GLenum /*attachment*/,
+                                        GLuint /*texture*/,
+                                        GLsizei /*num_views*/) {
+  assert(false);
+}
+
+#elif defined(FPLBASE_GLES)
+
+// GL_OVR_multiview's entry point isn't in the ES 3.0 headers.
+typedef void(GL_APIENTRYP FramebufferTextureMultiviewProc)(
+    GLenum target, GLenum attachment, GLuint texture, GLint level,
+    GLint base_view_index, GLsizei num_views);
+
+static void FramebufferTextureMultiview(GLenum attachment, GLuint texture,
+                                        GLsizei num_views) {
+  static FramebufferTextureMultiviewProc framebuffer_texture_multiview =
+      reinterpret_cast<FramebufferTextureMultiviewProc>(
+          eglGetProcAddress("glFramebufferTextureMultiviewOVR"));
+  assert(framebuffer_texture_multiview != nullptr);
+  GL_CALL(framebuffer_texture_multiview(GL_FRAMEBUFFER, attachment, texture,
+                                        0, 0, num_views));
+}
+
+#else  // Desktop OpenGL.
+
+static void FramebufferTextureMultiview(GLenum attachment, GLuint texture,
+                                        GLsizei num_views) {
+  GL_CALL(glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, attachment, texture,
+                                           0, 0, num_views));
+}
+
+#endif  // Desktop OpenGL.
+
+// RendererBase::SupportsMultisampledRenderToTexture() is only true on
+// OpenGL ES, and never on Apple platforms.
+#if defined(FPLBASE_GLES) && !defined(__APPLE__)
+
+// GL_EXT_multisampled_render_to_texture's entry points aren't in the ES 3.0
+// headers.
+typedef void(GL_APIENTRYP FramebufferTexture2DMultisampleProc)(
+    GLenum target, GLenum attachment, GLenum textarget, GLuint texture,
+    GLint level, GLsizei samples);
+typedef void(GL_APIENTRYP RenderbufferStorageMultisampleProc)(
+    GLenum target, GLsizei samples, GLenum internalformat, GLsizei width,
+    GLsizei height);
+
+static void FramebufferTexture2DMultisample(GLuint texture, GLsizei samples) {
+  static FramebufferTexture2DMultisampleProc framebuffer_texture_2d_ms =
+      reinterpret_cast<FramebufferTexture2DMultisampleProc>(
+          eglGetProcAddress("glFramebufferTexture2DMultisampleEXT"));
+  assert(framebuffer_texture_2d_ms != nullptr);
+  GL_CALL(framebuffer_texture_2d_ms(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                    GL_TEXTURE_2D, texture, 0, samples));
+}
+
+static void RenderbufferStorageMultisampleTile(GLsizei samples,
+                                               GLenum internal_format,
+                                               const mathfu::vec2i& size) {
+  static RenderbufferStorageMultisampleProc renderbuffer_storage_ms =
+      reinterpret_cast<RenderbufferStorageMultisampleProc>(
+          eglGetProcAddress("glRenderbufferStorageMultisampleEXT"));
+  assert(renderbuffer_storage_ms != nullptr);
+  GL_CALL(renderbuffer_storage_ms(GL_RENDERBUFFER, samples, internal_format,
+                                  size.x, size.y));
+}
+
+#else
+
+static void FramebufferTexture2DMultisample(GLuint /*texture*/,
+                                            GLsizei /*samples*/) {
+  assert(false);
+}
+
+static void RenderbufferStorageMultisampleTile(
+    GLsizei /*samples*/, GLenum /*internal_format*/,
+    const mathfu::vec2i& /*size*/) {
+  assert(false);
+}
+
+#endif  // defined(FPLBASE_GLES) && !defined(__APPLE__)
+
+// Create a renderbuffer of `samples` samples per pixel, and attach it to the
+// bound framebuffer.
+static GLuint CreateMultisampledRenderbuffer(const mathfu::vec2i& size,
+                                             GLenum internal_format,
+                                             GLenum attachment, GLsizei samples,
+                                             bool on_tile) {
+  GLuint renderbuffer = 0;
+  GL_CALL(glGenRenderbuffers(1, &renderbuffer));
+  GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer));
+  if (on_tile) {
+    RenderbufferStorageMultisampleTile(samples, internal_format, size);
+  } else {
+    GL_CALL(glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples,
+                                             internal_format, size.x, size.y));
+  }
+  GL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment,
+                                    GL_RENDERBUFFER, renderbuffer));
+  return renderbuffer;
+}
+
+// Texture arrays are allocated with glTexStorage3D, and multisampled color
+// with renderbuffers, which need sized formats.
+static GLenum SizedTextureFormat(RenderTargetTextureFormat format) {
+  switch (format) {
+    case kRenderTargetTextureFormatA8:
+    case kRenderTargetTextureFormatR8:
+      return GL_R8;
+    case kRenderTargetTextureFormatRGB8:
+      return GL_RGB8;
+    case kRenderTargetTextureFormatRGBA8:
+      return GL_RGBA8;
+    default:
+      return RenderTargetTextureFormatToInternalFormatGl(format);
+  }
+}
+
+static GLenum DepthStencilAttachment(DepthStencilFormat format) {
+  switch (format) {
+    case kDepthStencilFormatDepth24Stencil8:
+    case kDepthStencilFormatDepth32FStencil8:
+      return GL_DEPTH_STENCIL_ATTACHMENT;
+    case kDepthStencilFormatStencil8:
+      return GL_STENCIL_ATTACHMENT;
+    default:
+      return GL_DEPTH_ATTACHMENT;
+  }
+}
+
+// Allocate a texture array with a layer per view and attach all of its
+// layers to the bound framebuffer.
+static GLuint CreateMultiviewAttachment(const mathfu::vec2i& dimensions,
+                                        GLenum internal_format,
+                                        GLenum attachment, GLsizei num_views) {
+  GLuint texture = 0;
+  GL_CALL(glGenTextures(1, &texture));
+  TextureBindings::BindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+  GL_CALL(glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, internal_format, dimensions.x,
+                         dimensions.y, num_views));
+  FramebufferTextureMultiview(attachment, texture, num_views);
+  return texture;
+}
+
 void RenderTarget::Initialize(const mathfu::vec2i& dimensions,
                               RenderTargetTextureFormat texture_format,
                               DepthStencilFormat depth_stencil_format) {
   assert(!initialized());
+  num_views_ = 1;
+  texture_format_ = texture_format;
+  depth_stencil_format_ = depth_stencil_format;
 
   GLint original_frame_buffer = 0;
   GLint original_render_buffer = 0;
@@ -35,6 +193,9 @@ void RenderTarget::Initialize(const mathfu::vec2i& dimensions,
   // Set up the framebuffer itself:
   framebuffer_id_ = InvalidBufferHandle();
   depth_buffer_id_ = InvalidBufferHandle();
+  color_buffer_id_ = InvalidBufferHandle();
+  resolve_framebuffer_id_ = InvalidBufferHandle();
+  samples_ = 1;
 
   // Our framebuffer object:
   GLuint framebuffer_id = 0;
@@ -58,7 +219,7 @@ void RenderTarget::Initialize(const mathfu::vec2i& dimensions,
     rendered_texture_id_ = TextureHandleFromGl(rendered_texture_id);
 
     // Set up the texture:
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, rendered_texture_id));
+    TextureBindings::BindTexture(0, GL_TEXTURE_2D, rendered_texture_id);
 
     // Give an empty image to OpenGL.  (It will allocate memory, but not bother
     // to populate it.  Which is fine, since we're going to render into it.)
@@ -116,11 +277,227 @@ void RenderTarget::Initialize(const mathfu::vec2i& dimensions,
 
   // Be good citizens and clean up:
   // Bind the framebuffer:
-  GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+  TextureBindings::BindTexture(0, GL_TEXTURE_2D, 0);
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, original_frame_buffer));
+  GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, original_render_buffer));
+
+  initialized_ = true;
+  gpu_memory_size_ =
+      CalculateMemorySize(dimensions, texture_format, depth_stencil_format);
+  RendererBase::TrackGpuMemory(kGpuMemoryRenderTargets, 0, gpu_memory_size_);
+}
+
+void RenderTarget::InitializeMultiview(
+    const mathfu::vec2i& dimensions, RenderTargetTextureFormat texture_format,
+    DepthStencilFormat depth_stencil_format, int num_views) {
+  assert(!initialized());
+  assert(RendererBase::Get()->SupportsMultiview());
+  assert(texture_format != kRenderTargetTextureFormatNone);
+  assert(num_views >= 1);
+
+  GLint original_frame_buffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &original_frame_buffer);
+
+  dimensions_ = dimensions;
+  num_views_ = num_views;
+  samples_ = 1;
+  texture_format_ = texture_format;
+  depth_stencil_format_ = depth_stencil_format;
+  depth_buffer_id_ = InvalidBufferHandle();
+  color_buffer_id_ = InvalidBufferHandle();
+  resolve_framebuffer_id_ = InvalidBufferHandle();
+
+  GLuint framebuffer_id = 0;
+  GL_CALL(glGenFramebuffers(1, &framebuffer_id));
+  framebuffer_id_ = BufferHandleFromGl(framebuffer_id);
+  assert(ValidBufferHandle(framebuffer_id_));
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id));
+
+  const bool is_depth_texture =
+      (texture_format >= kRenderTargetTextureFormatDepth16 &&
+       texture_format <= kRenderTargetTextureFormatDepth32F);
+
+  const GLuint rendered_texture_id = CreateMultiviewAttachment(
+      dimensions, SizedTextureFormat(texture_format),
+      is_depth_texture ? GL_DEPTH_ATTACHMENT : GL_COLOR_ATTACHMENT0,
+      num_views);
+  rendered_texture_id_ = TextureHandleFromGl(rendered_texture_id);
+  const GLenum filter = is_depth_texture ? GL_NEAREST : GL_LINEAR;
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S,
+                          GL_CLAMP_TO_EDGE));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T,
+                          GL_CLAMP_TO_EDGE));
+
+  if (is_depth_texture) {
+    const GLenum draw_buffers = GL_NONE;
+    GL_CALL(glDrawBuffers(1, &draw_buffers));
+    GL_CALL(glReadBuffer(GL_NONE));
+  } else if (depth_stencil_format != kDepthStencilFormatNone) {
+    const GLuint depth_buffer_id = CreateMultiviewAttachment(
+        dimensions, DepthStencilFormatToInternalFormatGl(depth_stencil_format),
+        DepthStencilAttachment(depth_stencil_format), num_views);
+    depth_buffer_id_ = BufferHandleFromGl(depth_buffer_id);
+
+    if (ValidBufferHandle(color_buffer_id_)) {
+      GLuint color_buffer_id = GlBufferHandle(color_buffer_id_);
+      GL_CALL(glDeleteRenderbuffers(1, &color_buffer_id));
+      color_buffer_id_ = InvalidBufferHandle();
+    }
+    if (ValidBufferHandle(resolve_framebuffer_id_)) {
+      GLuint resolve_framebuffer_id = GlBufferHandle(resolve_framebuffer_id_);
+      GL_CALL(glDeleteFramebuffers(1, &resolve_framebuffer_id));
+      resolve_framebuffer_id_ = InvalidBufferHandle();
+    }
+  }
+
+  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+  TextureBindings::BindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, original_frame_buffer));
+
+  initialized_ = true;
+  gpu_memory_size_ =
+      CalculateMemorySize(dimensions, texture_format, depth_stencil_format) *
+      num_views;
+  RendererBase::TrackGpuMemory(kGpuMemoryRenderTargets, 0, gpu_memory_size_);
+}
+
+void RenderTarget::InitializeMultisampled(
+    const mathfu::vec2i& dimensions, RenderTargetTextureFormat texture_format,
+    DepthStencilFormat depth_stencil_format, int samples) {
+  assert(!initialized());
+  assert(texture_format > kRenderTargetTextureFormatA8 &&
+         texture_format < kRenderTargetTextureFormatDepth16);
+  const RendererBase* renderer = RendererBase::Get();
+  const bool on_tile = renderer->SupportsMultisampledRenderToTexture();
+  if (samples > 1 &&
+      (on_tile || renderer->feature_level() >= kFeatureLevel30)) {
+    GLint max_samples = 1;
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    samples = std::min(samples, static_cast<int>(max_samples));
+  } else {
+    samples = 1;
+  }
+  if (samples <= 1) {
+    Initialize(dimensions, texture_format, depth_stencil_format);
+    return;
+  }
+
+  GLint original_frame_buffer = 0;
+  GLint original_render_buffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &original_frame_buffer);
+  glGetIntegerv(GL_RENDERBUFFER_BINDING, &original_render_buffer);
+
+  dimensions_ = dimensions;
+  num_views_ = 1;
+  samples_ = samples;
+  texture_format_ = texture_format;
+  depth_stencil_format_ = depth_stencil_format;
+  depth_buffer_id_ = InvalidBufferHandle();
+  color_buffer_id_ = InvalidBufferHandle();
+  resolve_framebuffer_id_ = InvalidBufferHandle();
+
+  // The texture the samples are resolved into.
+  GLuint rendered_texture_id = 0;
+  GL_CALL(glGenTextures(1, &rendered_texture_id));
+  rendered_texture_id_ = TextureHandleFromGl(rendered_texture_id);
+  TextureBindings::BindTexture(0, GL_TEXTURE_2D, rendered_texture_id);
+  GL_CALL(glTexImage2D(
+      GL_TEXTURE_2D, 0,
+      RenderTargetTextureFormatToInternalFormatGl(texture_format),
+      dimensions.x, dimensions.y, 0,
+      RenderTargetTextureFormatToFormatGl(texture_format),
+      RenderTargetTextureFormatToTypeGl(texture_format), nullptr));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+
+  GLuint framebuffer_id = 0;
+  GL_CALL(glGenFramebuffers(1, &framebuffer_id));
+  framebuffer_id_ = BufferHandleFromGl(framebuffer_id);
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id));
+
+  if (on_tile) {
+    // The texture is the color attachment; the samples never leave the tile.
+    FramebufferTexture2DMultisample(rendered_texture_id, samples);
+  } else {
+    // Render into multisampled renderbuffers, and blit them into the texture
+    // through a second framebuffer in Resolve().
+    color_buffer_id_ = BufferHandleFromGl(CreateMultisampledRenderbuffer(
+        dimensions, SizedTextureFormat(texture_format), GL_COLOR_ATTACHMENT0,
+        samples, false));
+  }
+  if (depth_stencil_format != kDepthStencilFormatNone) {
+    depth_buffer_id_ = BufferHandleFromGl(CreateMultisampledRenderbuffer(
+        dimensions, DepthStencilFormatToInternalFormatGl(depth_stencil_format),
+        DepthStencilAttachment(depth_stencil_format), samples, on_tile));
+  }
+  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+  if (!on_tile) {
+    GLuint resolve_framebuffer_id = 0;
+    GL_CALL(glGenFramebuffers(1, &resolve_framebuffer_id));
+    resolve_framebuffer_id_ = BufferHandleFromGl(resolve_framebuffer_id);
+    GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, resolve_framebuffer_id));
+    GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                   GL_TEXTURE_2D, rendered_texture_id, 0));
+    assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+           GL_FRAMEBUFFER_COMPLETE);
+  }
+
+  TextureBindings::BindTexture(0, GL_TEXTURE_2D, 0);
   GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, original_frame_buffer));
   GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, original_render_buffer));
 
   initialized_ = true;
+  const size_t texture_size = CalculateMemorySize(
+      dimensions, texture_format, kDepthStencilFormatNone);
+  const size_t samples_size =
+      CalculateMemorySize(dimensions, texture_format, depth_stencil_format) *
+      samples;
+  // On-tile samples only take tile memory.
+  gpu_memory_size_ = on_tile ? texture_size : texture_size + samples_size;
+  RendererBase::TrackGpuMemory(kGpuMemoryRenderTargets, 0, gpu_memory_size_);
+}
+
+void RenderTarget::Resolve() const {
+  assert(initialized_);
+  if (!ValidBufferHandle(resolve_framebuffer_id_)) return;
+  GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER,
+                            GlBufferHandle(framebuffer_id_)));
+  GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER,
+                            GlBufferHandle(resolve_framebuffer_id_)));
+  GL_CALL(glBlitFramebuffer(0, 0, dimensions_.x, dimensions_.y, 0, 0,
+                            dimensions_.x, dimensions_.y, GL_COLOR_BUFFER_BIT,
+                            GL_NEAREST));
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, GlBufferHandle(framebuffer_id_)));
+  Invalidate(true, true);
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
+void RenderTarget::BlitTo(const RenderTarget& destination,
+                          const Viewport& source_rect,
+                          const Viewport& destination_rect) const {
+  assert(initialized_ && destination.initialized_);
+  const bool scaled = source_rect.size != destination_rect.size;
+  assert(!scaled || !ValidBufferHandle(color_buffer_id_));
+  GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER,
+                            GlBufferHandle(framebuffer_id_)));
+  GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER,
+                            GlBufferHandle(destination.framebuffer_id_)));
+  const mathfu::vec2i source_end = source_rect.pos + source_rect.size;
+  const mathfu::vec2i destination_end =
+      destination_rect.pos + destination_rect.size;
+  GL_CALL(glBlitFramebuffer(source_rect.pos.x, source_rect.pos.y,
+                            source_end.x, source_end.y, destination_rect.pos.x,
+                            destination_rect.pos.y, destination_end.x,
+                            destination_end.y, GL_COLOR_BUFFER_BIT,
+                            scaled ? GL_LINEAR : GL_NEAREST));
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER,
+                            GlBufferHandle(destination.framebuffer_id_)));
 }
 
 void RenderTarget::Delete() {
@@ -130,14 +507,19 @@ void RenderTarget::Delete() {
     framebuffer_id_ = BufferHandleFromGl(framebuffer_id);
 
     GLuint depth_buffer_id = GlBufferHandle(depth_buffer_id_);
-    GL_CALL(glDeleteRenderbuffers(1, &depth_buffer_id));
+    if (IsMultiview()) {
+      TextureBindings::DeleteTexture(depth_buffer_id);
+    } else {
+      GL_CALL(glDeleteRenderbuffers(1, &depth_buffer_id));
+    }
     depth_buffer_id_ = BufferHandleFromGl(depth_buffer_id);
 
-    GLuint rendered_texture_id = GlBufferHandle(rendered_texture_id_);
-    GL_CALL(glDeleteTextures(1, &rendered_texture_id));
-    rendered_texture_id_ = TextureHandleFromGl(rendered_texture_id);
+    TextureBindings::DeleteTexture(GlTextureHandle(rendered_texture_id_));
+    rendered_texture_id_ = InvalidTextureHandle();
 
     initialized_ = false;
+    RendererBase::TrackGpuMemory(kGpuMemoryRenderTargets, gpu_memory_size_, 0);
+    gpu_memory_size_ = 0;
   }
 }
 
@@ -150,11 +532,64 @@ void RenderTarget::SetAsRenderTarget() const {
   GL_CALL(glViewport(0, 0, dimensions_.x, dimensions_.y));
 }
 
+RenderTarget RenderTarget::BoundRenderTarget(Renderer& renderer) {
+  RenderTarget bound_render_target = ScreenRenderTarget(renderer);
+  GLint framebuffer_id = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer_id);
+  bound_render_target.framebuffer_id_ =
+      BufferHandleFromGl(static_cast<GLuint>(framebuffer_id));
+  return bound_render_target;
+}
+
 void RenderTarget::BindAsTexture(int texture_number) const {
   assert(initialized_);
-  GL_CALL(glActiveTexture(GL_TEXTURE0 + texture_number));
-  GL_CALL(glBindTexture(GL_TEXTURE_2D, GlTextureHandle(rendered_texture_id_)));
+  TextureBindings::BindTexture(
+      static_cast<size_t>(texture_number),
+      IsMultiview() ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D,
+      GlTextureHandle(rendered_texture_id_));
 }
 
+void RenderTarget::Invalidate(bool color, bool depth_stencil) const {
+  assert(initialized_);
+  if (!RendererBase::Get()->SupportsInvalidateFramebuffer()) return;
+#if !defined(PLATFORM_OSX)
+  const bool is_depth_texture =
+      (texture_format_ >= kRenderTargetTextureFormatDepth16 &&
+       texture_format_ <= kRenderTargetTextureFormatDepth32F);
+  const bool has_stencil =
+      depth_stencil_format_ == kDepthStencilFormatDepth24Stencil8 ||
+      depth_stencil_format_ == kDepthStencilFormatDepth32FStencil8 ||
+      depth_stencil_format_ == kDepthStencilFormatStencil8;
+  const bool has_depth = depth_stencil_format_ != kDepthStencilFormatStencil8;
+  // The default framebuffer names its buffers differently.
+  const bool is_screen = !IsTexture();
+  GLenum attachments[3];
+  GLsizei count = 0;
+  if (color) {
+    if (is_screen) {
+      attachments[count++] = GL_COLOR;
+    } else if (texture_format_ != kRenderTargetTextureFormatNone) {
+      attachments[count++] =
+          is_depth_texture ? GL_DEPTH_ATTACHMENT : GL_COLOR_ATTACHMENT0;
+    }
+  }
+  if (depth_stencil) {
+    if (is_screen) {
+      attachments[count++] = GL_DEPTH;
+      attachments[count++] = GL_STENCIL;
+    } else if (depth_stencil_format_ != kDepthStencilFormatNone &&
+               !is_depth_texture) {
+      if (has_depth) attachments[count++] = GL_DEPTH_ATTACHMENT;
+      if (has_stencil) attachments[count++] = GL_STENCIL_ATTACHMENT;
+    }
+  }
+  if (count > 0) {
+    GL_CALL(glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments));
+  }
+#else
+  (void)color;
+  (void)depth_stencil;
+#endif  // !defined(PLATFORM_OSX)
+}
 
 }  // namespace fplbase
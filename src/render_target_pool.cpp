@@ -0,0 +1,112 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "precompiled.h"
+
+#include "fplbase/render_target_pool.h"
+
+namespace fplbase {
+
+const int RenderTargetPool::kDefaultMaxIdleFrames;
+
+RenderTargetPool::RenderTargetPool(int max_idle_frames)
+    : max_idle_frames_(max_idle_frames) {}
+
+RenderTargetPool::~RenderTargetPool() {
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    // Whoever still uses a target gets a dangling pointer either way.
+    assert(!entries_[i].in_use);
+    entries_[i].target->Delete();
+    delete entries_[i].target;
+  }
+}
+
+RenderTarget *RenderTargetPool::Acquire(
+    const mathfu::vec2i &dimensions, RenderTargetTextureFormat texture_format,
+    DepthStencilFormat depth_stencil_format, int samples) {
+  RenderTarget *target = nullptr;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    Entry &entry = entries_[i];
+    if (!entry.in_use && entry.target->dimensions() == dimensions &&
+        entry.target->texture_format() == texture_format &&
+        entry.target->depth_stencil_format() == depth_stencil_format &&
+        entry.samples == samples) {
+      entry.in_use = true;
+      target = entry.target;
+      break;
+    }
+  }
+  if (target == nullptr) {
+    target = new RenderTarget();
+    if (samples > 1) {
+      target->InitializeMultisampled(dimensions, texture_format,
+                                     depth_stencil_format, samples);
+    } else {
+      target->Initialize(dimensions, texture_format, depth_stencil_format);
+    }
+    Entry entry = {target, samples, true, 0};
+    entries_.push_back(entry);
+  }
+  target->SetAsRenderTarget();
+  target->Invalidate(true, true);
+  return target;
+}
+
+void RenderTargetPool::Release(RenderTarget *target) {
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    Entry &entry = entries_[i];
+    if (entry.target == target) {
+      assert(entry.in_use);
+      entry.in_use = false;
+      entry.idle_frames = 0;
+      return;
+    }
+  }
+  assert(false);  // Not from this pool.
+}
+
+template <typename Predicate>
+void RenderTargetPool::DeleteFree(Predicate expired) {
+  size_t kept = 0;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    Entry &entry = entries_[i];
+    if (!entry.in_use && expired(entry)) {
+      entry.target->Delete();
+      delete entry.target;
+    } else {
+      entries_[kept++] = entry;
+    }
+  }
+  entries_.resize(kept);
+}
+
+void RenderTargetPool::EndFrame() {
+  const int max_idle_frames = max_idle_frames_;
+  DeleteFree([max_idle_frames](Entry &entry) {
+    return ++entry.idle_frames > max_idle_frames;
+  });
+}
+
+void RenderTargetPool::Clear() {
+  DeleteFree([](Entry &) { return true; });
+}
+
+size_t RenderTargetPool::num_in_use() const {
+  size_t count = 0;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (entries_[i].in_use) ++count;
+  }
+  return count;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,171 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/render_thread.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "fplbase/logging.h"
+#include "fplbase/renderer.h"
+#include "fplbase/trace.h"
+
+namespace fplbase {
+
+struct RenderThreadImpl {
+  RenderThreadImpl()
+      : renderer(nullptr),
+        recording(0),
+        submitted(0),
+        completed(0),
+        minimized(false),
+        time(0),
+        busy(false),
+        quit(false) {}
+
+  void Loop() {
+    renderer->environment().MakeContextCurrent(true);
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      work_ready.wait(lock, [this] {
+        return quit || !tasks.empty() || submitted != completed;
+      });
+      std::vector<std::function<void(Renderer &)>> run;
+      run.swap(tasks);
+      const bool frame = submitted != completed;
+      if (!frame && run.empty()) break;  // Quitting, with nothing left.
+      // SubmitFrame() doesn't touch the submitted list, or these, until
+      // it's completed.
+      const CommandList &commands = lists[recording ^ 1];
+      const bool frame_minimized = minimized;
+      const double frame_time = time;
+      busy = true;
+      lock.unlock();
+
+      for (auto it = run.begin(); it != run.end(); ++it) (*it)(*renderer);
+      if (frame) {
+        FPLBASE_TRACE_SCOPE("RenderThreadFrame");
+        commands.Replay(*renderer);
+        renderer->AdvanceFrame(frame_minimized, frame_time);
+      }
+
+      lock.lock();
+      busy = false;
+      if (frame) ++completed;
+      work_done.notify_all();
+    }
+    renderer->environment().MakeContextCurrent(false);
+  }
+
+  Renderer *renderer;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable work_ready;
+  std::condition_variable work_done;
+
+  // The game thread records into lists[recording], while the render thread
+  // replays the other one.
+  CommandList lists[2];
+  int recording;
+  // Frames handed over, and frames the render thread has finished. At most
+  // one apart.
+  uint64_t submitted;
+  uint64_t completed;
+  // The AdvanceFrame() arguments of the submitted frame.
+  bool minimized;
+  double time;
+  std::vector<std::function<void(Renderer &)>> tasks;
+  // True while the render thread runs tasks or a frame.
+  bool busy;
+  bool quit;
+};
+
+RenderThread::RenderThread() : impl_(new RenderThreadImpl) {}
+
+RenderThread::~RenderThread() {
+  Stop();
+  delete impl_;
+}
+
+bool RenderThread::Start(Renderer *renderer) {
+  assert(renderer && !running());
+  if (!renderer->environment().MakeContextCurrent(false)) {
+    LogError(kApplication, "RenderThread: can't move the graphics context");
+    return false;
+  }
+  impl_->renderer = renderer;
+  impl_->quit = false;
+  impl_->thread = std::thread(&RenderThreadImpl::Loop, impl_);
+  return true;
+}
+
+void RenderThread::Stop() {
+  if (!running()) return;
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->quit = true;
+  }
+  impl_->work_ready.notify_all();
+  impl_->thread.join();
+  impl_->renderer->environment().MakeContextCurrent(true);
+  impl_->renderer = nullptr;
+  impl_->lists[0].Clear();
+  impl_->lists[1].Clear();
+}
+
+bool RenderThread::running() const { return impl_->thread.joinable(); }
+
+CommandList &RenderThread::frame_commands() {
+  return impl_->lists[impl_->recording];
+}
+
+void RenderThread::SubmitFrame(bool minimized, double time) {
+  assert(running());
+  {
+    FPLBASE_TRACE_SCOPE("WaitForRenderThread");
+    std::unique_lock<std::mutex> lock(impl_->mutex);
+    impl_->work_done.wait(
+        lock, [this] { return impl_->completed == impl_->submitted; });
+    impl_->recording ^= 1;
+    impl_->minimized = minimized;
+    impl_->time = time;
+    ++impl_->submitted;
+  }
+  impl_->work_ready.notify_all();
+  // The render thread is done with this one, from the frame before.
+  impl_->lists[impl_->recording].Clear();
+}
+
+void RenderThread::RunOnRenderThread(
+    const std::function<void(Renderer &)> &task) {
+  assert(running());
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->tasks.push_back(task);
+  }
+  impl_->work_ready.notify_all();
+}
+
+void RenderThread::WaitForIdle() {
+  if (!running()) return;
+  std::unique_lock<std::mutex> lock(impl_->mutex);
+  impl_->work_done.wait(lock, [this] {
+    return impl_->completed == impl_->submitted && impl_->tasks.empty() &&
+           !impl_->busy;
+  });
+}
+
+}  // namespace fplbase
@@ -14,8 +14,12 @@
 
 #include "precompiled.h"
 
+#include "fplbase/fpl_common.h"
 #include "fplbase/internal/type_conversions_gl.h"
 #include "fplbase/render_utils.h"
+#include "fplbase/renderer.h"
+#include "fplbase/sprite_batch.h"
+#include "renderer_impl_gl.h"
 
 using mathfu::mat4;
 using mathfu::vec2;
@@ -26,16 +30,165 @@ using mathfu::vec4i;
 
 namespace fplbase {
 
+// Vertex attributes are read as floats at worst, so this alignment suits
+// any format.
+static const size_t kVertexAlignment = sizeof(float);
+
+// Returns the buffers to stream draws through, or nullptr if buffer objects
+// aren't worth it and draws should read client memory.
+static RendererBaseImpl *StreamingBuffers() {
+  RendererBase *base = RendererBase::Get();
+  if (base->feature_level() < kFeatureLevel30 || !base->impl()) return nullptr;
+  return base->impl();
+}
+
+// Indexed draws with at most this many indices use a StreamVertexArray,
+// with the indices offset on the stack. Larger ones set up attributes, which
+// costs little next to the draw.
+static const int kMaxRebasedIndices = 256;
+
+// Whether `format` matches `saved`, both terminated by kEND.
+static bool SameFormat(const std::vector<Attribute> &saved,
+                       const Attribute *format) {
+  for (size_t i = 0; i < saved.size(); ++i) {
+    if (saved[i] != format[i]) return false;
+    if (format[i] == kEND) return true;
+  }
+  return false;
+}
+
+// Copy the vertices into the streaming buffer, starting at a whole vertex
+// where possible, so the draw can use the format's StreamVertexArray.
+static bool StreamVertices(RendererBaseImpl *streaming, const void *vertices,
+                           int vertex_size, int vertex_count, size_t *offset) {
+  const size_t alignment = vertex_size % kVertexAlignment == 0
+                               ? static_cast<size_t>(vertex_size)
+                               : kVertexAlignment;
+  return streaming->stream_vertices.Write(vertices, vertex_count * vertex_size,
+                                          alignment, offset);
+}
+
+// Bind the VAO that draws `format` from the streamed vertices, made on first
+// use. The draw picks its vertices with the first vertex rather than the
+// attribute offsets, so the VAO's attributes never change. Streamed indices
+// written while it's bound become its index buffer. Undo with
+// ReleaseStreamVertexArray().
+static void BindStreamVertexArray(RendererBaseImpl *streaming,
+                                  const Attribute *format, int vertex_size) {
+  auto &arrays = streaming->stream_vertex_arrays;
+  auto it = arrays.begin();
+  while (it != arrays.end() &&
+         (it->stride != vertex_size || !SameFormat(it->format, format))) {
+    ++it;
+  }
+  if (it != arrays.end()) {
+    streaming->vertex_bindings.BindVertexArray(it->vao);
+  } else {
+    StreamVertexArray created;
+    for (const Attribute *attribute = format;; ++attribute) {
+      created.format.push_back(*attribute);
+      if (*attribute == kEND) break;
+    }
+    created.stride = vertex_size;
+    GLuint vao = 0;
+    GL_CALL(glGenVertexArrays(1, &vao));
+    created.vao = vao;
+    streaming->vertex_bindings.BindVertexArray(vao);
+    SetAttributes(GlBufferHandle(streaming->stream_vertices.buffer()), format,
+                  vertex_size, nullptr);
+    arrays.push_back(created);
+  }
+}
+
+// Leave the VAO bound for the next draw, like a mesh draw does. Anything
+// that sets attributes unbinds it first. See VertexBindings.
+static void ReleaseStreamVertexArray(RendererBaseImpl *streaming) {
+  streaming->vertex_bindings.ReleaseMesh();
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
+// Set up the vertex attributes, reading the vertices from the streaming
+// buffer at `offset` if `streamed`, else from client memory. Undo with
+// UnbindStreamedAttributes().
+static void BindStreamedAttributes(RendererBaseImpl *streaming, bool streamed,
+                                   size_t offset, const Attribute *format,
+                                   int vertex_size, const void *vertices) {
+  if (streamed) {
+    SetAttributes(GlBufferHandle(streaming->stream_vertices.buffer()), format,
+                  vertex_size, reinterpret_cast<const char *>(offset));
+  } else {
+    SetAttributes(0 /* vbo */, format, vertex_size,
+                  reinterpret_cast<const char *>(vertices));
+  }
+}
+
+static void UnbindStreamedAttributes(const Attribute *format) {
+  UnSetAttributes(format);
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+}
+
+template <typename T>
+static int VertexCount(const T *indices, int index_count) {
+  int count = 0;
+  for (int i = 0; i < index_count; ++i) {
+    count = std::max(count, static_cast<int>(indices[i]) + 1);
+  }
+  return count;
+}
+
+template <typename T>
 static void DrawElements(Mesh::Primitive primitive, int index_count,
                          const Attribute *format, int vertex_size,
-                         const void *vertices, const void *indices,
+                         const void *vertices, const T *indices,
                          GLenum gl_index_type) {
-  SetAttributes(0 /* vbo */, format, vertex_size,
-                reinterpret_cast<const char *>(vertices));
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+  const int vertex_count = VertexCount(indices, index_count);
+  RendererBaseImpl *streaming = StreamingBuffers();
+  size_t vertex_offset = 0;
+  const bool streamed =
+      streaming && StreamVertices(streaming, vertices, vertex_size,
+                                  vertex_count, &vertex_offset);
   auto gl_primitive = GetPrimitiveTypeFlags(primitive);
-  GL_CALL(glDrawElements(gl_primitive, index_count, gl_index_type, indices));
-  UnSetAttributes(format);
+  size_t index_offset = 0;
+
+  // With the vertices at a whole vertex, offset the indices to match and
+  // draw with the format's VAO, as long as they still fit in a T.
+  const size_t first_vertex = vertex_offset / vertex_size;
+  if (streamed && vertex_offset % vertex_size == 0 &&
+      index_count <= kMaxRebasedIndices &&
+      first_vertex + vertex_count <=
+          static_cast<size_t>(std::numeric_limits<T>::max())) {
+    T rebased[kMaxRebasedIndices];
+    for (int i = 0; i < index_count; ++i) {
+      rebased[i] = static_cast<T>(indices[i] + first_vertex);
+    }
+    BindStreamVertexArray(streaming, format, vertex_size);
+    const bool indices_streamed = streaming->stream_indices.Write(
+        rebased, index_count * sizeof(T), sizeof(T), &index_offset);
+    if (indices_streamed) {
+      RendererBase::CountRenderWork(&RenderCounters::draw_calls);
+      GL_CALL(glDrawElements(gl_primitive, index_count, gl_index_type,
+                             reinterpret_cast<const void *>(index_offset)));
+    }
+    // Released either way, so that SetAttributes() below unbinds it.
+    ReleaseStreamVertexArray(streaming);
+    if (indices_streamed) return;
+  }
+
+  BindStreamedAttributes(streaming, streamed, vertex_offset, format,
+                         vertex_size, vertices);
+  const void *index_pointer = indices;
+  if (streaming &&
+      streaming->stream_indices.Write(indices, index_count * sizeof(T),
+                                      sizeof(T), &index_offset)) {
+    index_pointer = reinterpret_cast<const void *>(index_offset);
+  } else {
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+  }
+  RendererBase::CountRenderWork(&RenderCounters::draw_calls);
+  GL_CALL(glDrawElements(gl_primitive, index_count, gl_index_type,
+                         index_pointer));
+  UnbindStreamedAttributes(format);
 }
 
 void RenderArray(Mesh::Primitive primitive, int index_count,
@@ -55,132 +208,173 @@ void RenderArray(Mesh::Primitive primitive, int index_count,
 void RenderArray(Mesh::Primitive primitive, int vertex_count,
                  const Attribute *format, int vertex_size,
                  const void *vertices) {
-  SetAttributes(0 /* vbo */, format, vertex_size,
-                reinterpret_cast<const char *>(vertices));
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+  RendererBaseImpl *streaming = StreamingBuffers();
+  size_t offset = 0;
+  const bool streamed = streaming && StreamVertices(streaming, vertices,
+                                                    vertex_size, vertex_count,
+                                                    &offset);
   auto gl_primitive = GetPrimitiveTypeFlags(primitive);
+  RendererBase::CountRenderWork(&RenderCounters::draw_calls);
+  if (streamed && offset % vertex_size == 0) {
+    BindStreamVertexArray(streaming, format, vertex_size);
+    GL_CALL(glDrawArrays(gl_primitive, static_cast<GLint>(offset / vertex_size),
+                         vertex_count));
+    ReleaseStreamVertexArray(streaming);
+    return;
+  }
+  BindStreamedAttributes(streaming, streamed, offset, format, vertex_size,
+                         vertices);
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
   GL_CALL(glDrawArrays(gl_primitive, 0, vertex_count));
-  UnSetAttributes(format);
+  UnbindStreamedAttributes(format);
 }
 
 void RenderAAQuadAlongX(const vec3 &bottom_left, const vec3 &top_right,
                         const vec2 &tex_bottom_left,
                         const vec2 &tex_top_right) {
-  static const Attribute format[] = {kPosition3f, kTexCoord2f, kEND};
-  static const unsigned short indices[] = {0, 1, 2, 1, 3, 2};
-  static const int kNumIndices = 6;
-  static const int kVertexSize = sizeof(float) * 5;
+  typedef VertexFormat<kPosition3f, kTexCoord2f> Format;
 
-  // clang-format off
   // vertex format is [x, y, z] [u, v]:
-  const float vertices[] = {
-      bottom_left.x,     bottom_left.y,     bottom_left.z,
-      tex_bottom_left.x, tex_bottom_left.y,
-      bottom_left.x,     top_right.y,       top_right.z,
-      tex_bottom_left.x, tex_top_right.y,
-      top_right.x,       bottom_left.y,     bottom_left.z,
-      tex_top_right.x,   tex_bottom_left.y,
-      top_right.x,       top_right.y,       top_right.z,
-      tex_top_right.x,   tex_top_right.y};
-  // clang-format on
-  RenderArray(Mesh::kTriangles, kNumIndices, format, kVertexSize,
-              reinterpret_cast<const char *>(vertices), indices);
+  float vertices[internal::kQuadAlongXVertices * 5];
+  internal::QuadAlongXVertices(bottom_left, top_right, tex_bottom_left,
+                               tex_top_right, vertices);
+  RenderArray(Mesh::kTriangles, internal::kQuadAlongXIndices, Format(),
+              Format::kStride, reinterpret_cast<const char *>(vertices),
+              internal::kQuadAlongXIndexData);
 }
 
 void RenderAAQuadAlongXNinePatch(const vec3 &bottom_left, const vec3 &top_right,
                                  const vec2i &texture_size,
                                  const vec4 &patch_info) {
-  static const Attribute format[] = {kPosition3f, kTexCoord2f, kEND};
-  static const unsigned short indices[] = {
-      0, 2, 1,  1,  2, 3,  2, 4,  3,  3,  4,  5,  4,  6,  5,  5,  6,  7,
-      1, 3, 8,  8,  3, 9,  3, 5,  9,  9,  5,  10, 5,  7,  10, 10, 7,  11,
-      8, 9, 12, 12, 9, 13, 9, 10, 13, 13, 10, 14, 10, 11, 14, 14, 11, 15,
-  };
-  vec2 max = vec2::Max(bottom_left.xy(), top_right.xy());
-  vec2 min = vec2::Min(bottom_left.xy(), top_right.xy());
-  vec2 p0 = vec2(texture_size) * patch_info.xy() + min;
-  vec2 p1 = max - vec2(texture_size) * (mathfu::kOnes2f - patch_info.zw());
-
-  // Check if the 9 patch edges are not overwrapping.
-  // In that case, adjust 9 patch geometry locations not to overwrap.
-  if (p0.x > p1.x) {
-    p0.x = p1.x = (min.x + max.x) / 2;
+  typedef VertexFormat<kPosition3f, kTexCoord2f> Format;
+
+  // vertex format is [x, y, z] [u, v]:
+  float vertices[internal::kNinePatchAlongXVertices * 5];
+  internal::NinePatchAlongXVertices(bottom_left, top_right, vec2(texture_size),
+                                    patch_info, vec4(0.0f, 0.0f, 1.0f, 1.0f),
+                                    vertices);
+  RenderArray(Mesh::kTriangles, internal::kNinePatchAlongXIndices, Format(),
+              Format::kStride, reinterpret_cast<const char *>(vertices),
+              internal::kNinePatchAlongXIndexData);
+}
+
+// Enable or disable an attribute array through the renderer's
+// VertexBindings, which skips redundant calls.
+static void EnableAttribute(GLuint index) {
+  VertexBindings *bindings = VertexBindings::Get();
+  if (bindings) {
+    bindings->Enable(index);
+  } else {
+    GL_CALL(glEnableVertexAttribArray(index));
   }
-  if (p0.y > p1.y) {
-    p0.y = p1.y = (min.y + max.y) / 2;
+}
+
+static void DisableAttribute(GLuint index) {
+  VertexBindings *bindings = VertexBindings::Get();
+  if (bindings) {
+    bindings->Disable(index);
+  } else {
+    GL_CALL(glDisableVertexAttribArray(index));
   }
+}
 
-  // vertex format is [x, y, z] [u, v]:
-  float z = bottom_left.z;
-  // clang-format off
-  const float vertices[] = {
-      min.x, min.y, z, 0.0f,           0.0f,
-      p0.x,  min.y, z, patch_info.x, 0.0f,
-      min.x, p0.y,  z, 0.0f,           patch_info.y,
-      p0.x,  p0.y,  z, patch_info.x, patch_info.y,
-      min.x, p1.y,  z, 0.0,            patch_info.w,
-      p0.x,  p1.y,  z, patch_info.x, patch_info.w,
-      min.x, max.y, z, 0.0,            1.0,
-      p0.x,  max.y, z, patch_info.x, 1.0,
-      p1.x,  min.y, z, patch_info.z, 0.0f,
-      p1.x,  p0.y,  z, patch_info.z, patch_info.y,
-      p1.x,  p1.y,  z, patch_info.z, patch_info.w,
-      p1.x,  max.y, z, patch_info.z, 1.0f,
-      max.x, min.y, z, 1.0f,           0.0f,
-      max.x, p0.y,  z, 1.0f,           patch_info.y,
-      max.x, p1.y,  z, 1.0f,           patch_info.w,
-      max.x, max.y, z, 1.0f,           1.0f,
+// Point a per-instance attribute at `buffer`. The divisor is left at 1 after
+// the draw: these locations only ever hold per-instance attributes.
+static void SetInstanceAttribute(GLuint index, GLint size, GLenum type,
+                                 bool normalized, int stride,
+                                 const char *buffer) {
+  EnableAttribute(index);
+  GL_CALL(glVertexAttribPointer(index, size, type, normalized, stride, buffer));
+  GL_CALL(glVertexAttribDivisor(index, 1));
+}
+
+namespace internal {
+
+void BeginSetAttributes(unsigned int vbo) {
+  // Undo whatever the last mesh draw left bound.
+  VertexBindings *bindings = VertexBindings::Get();
+  if (bindings) bindings->Flush();
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+}
+
+void SetAttributeArray(unsigned int location, int components,
+                       VertexComponentType type, bool normalized, int rows,
+                       int stride, const char *pointer) {
+  // Indexed by VertexComponentType.
+  static const GLenum kGlTypes[] = {
+      GL_FLOAT,          GL_HALF_FLOAT, GL_UNSIGNED_BYTE,
+      GL_UNSIGNED_SHORT, GL_SHORT,      GL_INT_2_10_10_10_REV,
   };
-  // clang-format on
-  RenderArray(Mesh::kTriangles, 6 * 9, format, sizeof(float) * 5,
-              reinterpret_cast<const char *>(vertices), indices);
+  assert(static_cast<size_t>(type) < FPL_ARRAYSIZE(kGlTypes));
+  const GLenum gl_type = kGlTypes[type];
+  if (location >= Mesh::kAttributeInstanceTransform) {
+    // Only kInstanceTransform3x4f has several rows, each of float4.
+    const int row_size = components * static_cast<int>(sizeof(float));
+    for (int row = 0; row < rows; ++row) {
+      SetInstanceAttribute(location + row, components, gl_type, normalized,
+                           stride, pointer + row * row_size);
+    }
+    return;
+  }
+  EnableAttribute(location);
+  GL_CALL(glVertexAttribPointer(location, components, gl_type, normalized,
+                                stride, pointer));
+}
+
+void UnSetAttributeArray(unsigned int location, int rows) {
+  for (int row = 0; row < rows; ++row) {
+    DisableAttribute(location + row);
+  }
 }
 
+}  // namespace internal
+
 void SetAttributes(GLuint vbo, const Attribute *attributes, int stride,
                    const char *buffer) {
-  assert(Mesh::IsValidFormat(attributes));
-  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+  assert(Mesh::IsValidFormat(attributes) ||
+         Mesh::IsValidInstanceFormat(attributes));
+  internal::BeginSetAttributes(vbo);
   size_t offset = 0;
   for (;;) {
     switch (*attributes++) {
       case kPosition3f:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributePosition));
+        EnableAttribute(Mesh::kAttributePosition);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributePosition, 3, GL_FLOAT,
                                       false, stride, buffer + offset));
         offset += 3 * sizeof(float);
         break;
       case kPosition2f:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributePosition));
+        EnableAttribute(Mesh::kAttributePosition);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributePosition, 2, GL_FLOAT,
                                       false, stride, buffer + offset));
         offset += 2 * sizeof(float);
         break;
       case kNormal3f:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributeNormal));
+        EnableAttribute(Mesh::kAttributeNormal);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributeNormal, 3, GL_FLOAT,
                                       false, stride, buffer + offset));
         offset += 3 * sizeof(float);
         break;
       case kTangent4f:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributeTangent));
+        EnableAttribute(Mesh::kAttributeTangent);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributeTangent, 4, GL_FLOAT,
                                       false, stride, buffer + offset));
         offset += 4 * sizeof(float);
         break;
       case kOrientation4f:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributeOrientation));
+        EnableAttribute(Mesh::kAttributeOrientation);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributeOrientation, 4, GL_FLOAT,
                                       false, stride, buffer + offset));
         offset += 4 * sizeof(float);
         break;
       case kTexCoord2f:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributeTexCoord));
+        EnableAttribute(Mesh::kAttributeTexCoord);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributeTexCoord, 2, GL_FLOAT,
                                       false, stride, buffer + offset));
         offset += 2 * sizeof(float);
         break;
       case kTexCoord2us:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributeTexCoord));
+        EnableAttribute(Mesh::kAttributeTexCoord);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributeTexCoord, 2,
                                       GL_UNSIGNED_SHORT,
                                       /* normalized = */ true, stride,
@@ -188,32 +382,76 @@ void SetAttributes(GLuint vbo, const Attribute *attributes, int stride,
         offset += 2 * sizeof(uint16_t);
         break;
       case kTexCoordAlt2f:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributeTexCoordAlt));
+        EnableAttribute(Mesh::kAttributeTexCoordAlt);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributeTexCoordAlt, 2, GL_FLOAT,
                                       false, stride, buffer + offset));
         offset += 2 * sizeof(float);
         break;
       case kColor4ub:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributeColor));
+        EnableAttribute(Mesh::kAttributeColor);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributeColor, 4,
                                       GL_UNSIGNED_BYTE, true, stride,
                                       buffer + offset));
         offset += 4;
         break;
       case kBoneIndices4ub:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributeBoneIndices));
+        EnableAttribute(Mesh::kAttributeBoneIndices);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributeBoneIndices, 4,
                                       GL_UNSIGNED_BYTE, false, stride,
                                       buffer + offset));
         offset += 4;
         break;
       case kBoneWeights4ub:
-        GL_CALL(glEnableVertexAttribArray(Mesh::kAttributeBoneWeights));
+        EnableAttribute(Mesh::kAttributeBoneWeights);
         GL_CALL(glVertexAttribPointer(Mesh::kAttributeBoneWeights, 4,
                                       GL_UNSIGNED_BYTE, true, stride,
                                       buffer + offset));
         offset += 4;
         break;
+      case kPosition3h:
+        EnableAttribute(Mesh::kAttributePosition);
+        GL_CALL(glVertexAttribPointer(Mesh::kAttributePosition, 3,
+                                      GL_HALF_FLOAT, false, stride,
+                                      buffer + offset));
+        offset += 4 * sizeof(uint16_t);
+        break;
+      case kNormalOct2s:
+        EnableAttribute(Mesh::kAttributeNormal);
+        GL_CALL(glVertexAttribPointer(Mesh::kAttributeNormal, 2, GL_SHORT,
+                                      true, stride, buffer + offset));
+        offset += 2 * sizeof(int16_t);
+        break;
+      case kOrientationPacked:
+        EnableAttribute(Mesh::kAttributeOrientation);
+        GL_CALL(glVertexAttribPointer(Mesh::kAttributeOrientation, 4,
+                                      GL_INT_2_10_10_10_REV, true, stride,
+                                      buffer + offset));
+        offset += sizeof(uint32_t);
+        break;
+      case kTexCoord2h:
+        EnableAttribute(Mesh::kAttributeTexCoord);
+        GL_CALL(glVertexAttribPointer(Mesh::kAttributeTexCoord, 2,
+                                      GL_HALF_FLOAT, false, stride,
+                                      buffer + offset));
+        offset += 2 * sizeof(uint16_t);
+        break;
+      case kInstanceTransform3x4f:
+        for (GLuint row = 0; row < 3; ++row) {
+          SetInstanceAttribute(Mesh::kAttributeInstanceTransform + row, 4,
+                               GL_FLOAT, false, stride, buffer + offset);
+          offset += 4 * sizeof(float);
+        }
+        break;
+      case kInstanceColor4ub:
+        SetInstanceAttribute(Mesh::kAttributeInstanceColor, 4,
+                             GL_UNSIGNED_BYTE, true, stride, buffer + offset);
+        offset += 4;
+        break;
+      case kInstancePaletteOffset1f:
+        SetInstanceAttribute(Mesh::kAttributeInstancePaletteOffset, 1,
+                             GL_FLOAT, false, stride, buffer + offset);
+        offset += sizeof(float);
+        break;
 
       case kEND:
         return;
@@ -226,32 +464,47 @@ void UnSetAttributes(const Attribute *attributes) {
     switch (*attributes++) {
       case kPosition3f:
       case kPosition2f:
-        GL_CALL(glDisableVertexAttribArray(Mesh::kAttributePosition));
+      case kPosition3h:
+        DisableAttribute(Mesh::kAttributePosition);
         break;
       case kNormal3f:
-        GL_CALL(glDisableVertexAttribArray(Mesh::kAttributeNormal));
+      case kNormalOct2s:
+        DisableAttribute(Mesh::kAttributeNormal);
         break;
       case kTangent4f:
-        GL_CALL(glDisableVertexAttribArray(Mesh::kAttributeTangent));
+        DisableAttribute(Mesh::kAttributeTangent);
         break;
       case kOrientation4f:
-        GL_CALL(glDisableVertexAttribArray(Mesh::kAttributeOrientation));
+      case kOrientationPacked:
+        DisableAttribute(Mesh::kAttributeOrientation);
         break;
       case kTexCoord2f:
       case kTexCoord2us:
-        GL_CALL(glDisableVertexAttribArray(Mesh::kAttributeTexCoord));
+      case kTexCoord2h:
+        DisableAttribute(Mesh::kAttributeTexCoord);
         break;
       case kTexCoordAlt2f:
-        GL_CALL(glDisableVertexAttribArray(Mesh::kAttributeTexCoordAlt));
+        DisableAttribute(Mesh::kAttributeTexCoordAlt);
         break;
       case kColor4ub:
-        GL_CALL(glDisableVertexAttribArray(Mesh::kAttributeColor));
+        DisableAttribute(Mesh::kAttributeColor);
         break;
       case kBoneIndices4ub:
-        GL_CALL(glDisableVertexAttribArray(Mesh::kAttributeBoneIndices));
+        DisableAttribute(Mesh::kAttributeBoneIndices);
         break;
       case kBoneWeights4ub:
-        GL_CALL(glDisableVertexAttribArray(Mesh::kAttributeBoneWeights));
+        DisableAttribute(Mesh::kAttributeBoneWeights);
+        break;
+      case kInstanceTransform3x4f:
+        for (GLuint row = 0; row < 3; ++row) {
+          DisableAttribute(Mesh::kAttributeInstanceTransform + row);
+        }
+        break;
+      case kInstanceColor4ub:
+        DisableAttribute(Mesh::kAttributeInstanceColor);
+        break;
+      case kInstancePaletteOffset1f:
+        DisableAttribute(Mesh::kAttributeInstancePaletteOffset);
         break;
       case kEND:
         GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
@@ -19,6 +19,7 @@
 #include "fplbase/render_target.h"
 #include "fplbase/renderer.h"
 #include "fplbase/texture.h"
+#include "fplbase/trace.h"
 #include "fplbase/utilities.h"
 
 using mathfu::mat4;
@@ -27,11 +28,17 @@ using mathfu::vec2i;
 using mathfu::vec3;
 using mathfu::vec4;
 
+#ifdef _WIN32
+#define snprintf(buffer, count, format, ...) \
+  _snprintf_s(buffer, count, count, format, __VA_ARGS__)
+#endif  // _WIN32
+
 namespace fplbase {
 
 // static member variables
 std::weak_ptr<RendererBase> RendererBase::the_base_weak_;
 RendererBase* RendererBase::the_base_raw_;
+thread_local bool RendererBase::shared_context_thread_ = false;
 fplutil::Mutex RendererBase::the_base_mutex_;
 
 RendererBase::RendererBase()
@@ -40,7 +47,18 @@ RendererBase::RendererBase()
       supports_texture_format_(-1),
       supports_texture_npot_(false),
       supports_multiview_(false),
+      supports_texture_storage_(false),
       supports_instancing_(false),
+      supports_multi_draw_indirect_(false),
+      supports_timer_queries_(false),
+      supports_occlusion_queries_(false),
+      supports_invalidate_framebuffer_(false),
+      supports_multisampled_render_to_texture_(false),
+      supports_parallel_shader_compile_(false),
+      supports_program_binary_(false),
+      initialize_start_(0),
+      last_swap_end_(0),
+      swap_interval_(1),
       force_shader_(nullptr),
       force_blend_mode_(kBlendModeCount),
       max_vertex_uniform_components_(0),
@@ -65,13 +83,21 @@ Renderer::Renderer()
       camera_pos_(mathfu::kZeros3f),
       bone_transforms_(nullptr),
       num_bones_(0),
+      bone_dual_quaternions_(nullptr),
+      num_dual_quaternion_bones_(0),
+      bone_palette_(nullptr),
+      bone_palette_offset_(0),
       blend_mode_(kBlendModeUnknown),
       blend_amount_(0.0f),
       cull_mode_(kCullingModeUnknown),
       depth_function_(kDepthFunctionUnknown),
       stencil_mode_(kStencilUnknown),
       stencil_ref_(0),
-      stencil_mask_(~0u) {
+      stencil_mask_(~0u),
+      packed_render_state_valid_(false),
+      frames_since_validation_(0),
+      draw_sample_threshold_(0),
+      draw_sample_random_(0x9e3779b9u) {
   // This is the only place that the RendererBase singleton can be created,
   // so ensure it's guarded by the mutex.
   fplutil::MutexLock lock(RendererBase::the_base_mutex_);
@@ -107,12 +133,57 @@ Renderer::~Renderer() {
 bool RendererBase::Initialize(const vec2i &window_size,
                               const char *window_title,
                               WindowMode window_mode) {
-  if (!environment_.Initialize(window_size, window_title, window_mode)) {
-    last_error_ = environment_.last_error();
-    return false;
+  initialize_start_ = GetTimeInSeconds();
+  startup_times_ = StartupTimes();
+  {
+    FPLBASE_TRACE_SCOPE("CreateContext");
+    if (!environment_.Initialize(window_size, window_title, window_mode)) {
+      last_error_ = environment_.last_error();
+      return false;
+    }
   }
+  const double context_created = GetTimeInSeconds();
+  startup_times_.context_creation = context_created - initialize_start_;
+  // Query this on the main thread, so texture loads on the loader threads only
+  // ever read the cached result.
+  MipmapGeneration16bppSupported();
+  const int refresh_rate = environment_.GetRefreshRate();
+  if (refresh_rate > 0) frame_pacer_.set_vsync_period(1.0 / refresh_rate);
   // Non-environment-specific initialization continues here:
-  return InitializeRenderingState();
+  bool ok;
+  {
+    FPLBASE_TRACE_SCOPE("ProbeCapabilities");
+    ok = InitializeRenderingState();
+  }
+  startup_times_.capability_probe = GetTimeInSeconds() - context_created;
+  return ok;
+}
+
+bool RendererBase::SupportsExtension(const char *name) const {
+  return extensions_.count(name) != 0;
+}
+
+void RendererBase::RecordFirstAssetLoad() {
+  startup_times_.first_asset_load = GetTimeInSeconds() - initialize_start_;
+}
+
+void RendererBase::DumpStartupTimes(std::string *report) const {
+  const struct {
+    const char *name;
+    double seconds;
+  } phases[] = {
+      {"context_creation", startup_times_.context_creation},
+      {"capability_probe", startup_times_.capability_probe},
+      {"first_shader_compile", startup_times_.first_shader_compile},
+      {"first_asset_load", startup_times_.first_asset_load},
+      {"first_frame", startup_times_.first_frame},
+  };
+  for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); ++i) {
+    char line[64];
+    snprintf(line, sizeof(line), "%s %.3f ms\n", phases[i].name,
+             phases[i].seconds * 1000.0);
+    *report += line;
+  }
 }
 
 void Renderer::BeginRendering() {
@@ -139,6 +210,62 @@ bool RendererBase::SupportsMultiview() const {
   return supports_multiview_;
 }
 
+bool RendererBase::SupportsTextureStorage() const {
+  return supports_texture_storage_;
+}
+
+bool RendererBase::SupportsMultiDrawIndirect() const {
+  return supports_multi_draw_indirect_;
+}
+
+bool RendererBase::SupportsTimerQueries() const {
+  return supports_timer_queries_;
+}
+
+bool RendererBase::SupportsOcclusionQueries() const {
+  return supports_occlusion_queries_;
+}
+
+bool RendererBase::SupportsInvalidateFramebuffer() const {
+  return supports_invalidate_framebuffer_;
+}
+
+bool RendererBase::SupportsMultisampledRenderToTexture() const {
+  return supports_multisampled_render_to_texture_;
+}
+
+bool RendererBase::SupportsParallelShaderCompile() const {
+  return supports_parallel_shader_compile_;
+}
+
+bool RendererBase::SupportsProgramBinary() const {
+  return supports_program_binary_;
+}
+
+void RendererBase::ResetGpuMemoryPeaks() {
+  for (int i = 0; i <= kGpuMemoryCategoryCount; ++i) {
+    gpu_memory_[i].peak_bytes = gpu_memory_[i].bytes;
+  }
+}
+
+// static
+void RendererBase::TrackGpuMemory(GpuMemoryCategory category, size_t old_size,
+                                  size_t new_size) {
+  // Objects may outlive the renderer, e.g. in tests that never create one.
+  RendererBase *base = the_base_raw_;
+  if (!base || old_size == new_size) return;
+  GpuMemoryStats *stats[] = {&base->gpu_memory_[category],
+                             &base->gpu_memory_[kGpuMemoryCategoryCount]};
+  for (size_t i = 0; i < sizeof(stats) / sizeof(stats[0]); ++i) {
+    GpuMemoryStats &s = *stats[i];
+    assert(s.bytes >= old_size);
+    s.bytes = s.bytes - old_size + new_size;
+    s.peak_bytes = std::max(s.peak_bytes, s.bytes);
+    if (old_size == 0) ++s.num_objects;
+    if (new_size == 0) --s.num_objects;
+  }
+}
+
 Shader *RendererBase::CompileAndLinkShader(const char *vs_source,
                                            const char *ps_source) {
   return CompileAndLinkShaderHelper(vs_source, ps_source, nullptr);
@@ -157,16 +284,53 @@ BlendMode Renderer::GetBlendMode() {
   return blend_mode_;
 }
 
+void RendererBase::set_frame_pacing(FramePacing pacing) {
+  frame_pacer_.set_pacing(pacing);
+  frame_pacer_.Reset();
+}
+
 void Renderer::AdvanceFrame(bool minimized, double time) {
   base_->AdvanceFrame(minimized, time);
   SetDepthFunction(kDepthFunctionLess);
 
   auto viewport_size = environment().GetViewportSize();
   SetViewport(Viewport(0, 0, viewport_size.x, viewport_size.y));
+
+  if (render_state_validation_.frame_interval > 0 &&
+      ++frames_since_validation_ >= render_state_validation_.frame_interval) {
+    frames_since_validation_ = 0;
+    ValidateRenderState(render_state_,
+                        render_state_validation_.assert_on_mismatch);
+  }
+}
+
+void Renderer::set_render_state_validation(
+    const RenderStateValidation &validation) {
+  render_state_validation_ = validation;
+  frames_since_validation_ = 0;
+  const float rate = mathfu::Clamp(validation.draw_sample_rate, 0.0f, 1.0f);
+  // The generator never returns 0, so the largest threshold validates all.
+  draw_sample_threshold_ =
+      rate >= 1.0f ? 0xffffffffu
+                   : static_cast<uint32_t>(rate * 4294967296.0);
+}
+
+void Renderer::SampleRenderStateHelper() {
+  // xorshift32: cheap enough to run for every draw.
+  uint32_t x = draw_sample_random_;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  draw_sample_random_ = x;
+  if (x < draw_sample_threshold_) {
+    ValidateRenderState(render_state_,
+                        render_state_validation_.assert_on_mismatch);
+  }
 }
 
 void Renderer::UpdateCachedRenderState(const RenderState &render_state) {
   render_state_ = render_state;
+  packed_render_state_valid_ = false;
 
   const BlendMode prev_blend_mode = blend_mode_;
   const CullingMode prev_cull_mode = cull_mode_;
@@ -14,14 +14,26 @@
 
 #include "precompiled.h"  // NOLINT
 
+//#if defined(_DEBUG) || DEBUG==1
+//#define LOG_FRAMERATE
+//#endif
+
+#include "fplbase/bone_palette_buffer.h"
+#include "fplbase/instance_buffer.h"
 #include "fplbase/internal/type_conversions_gl.h"
 #include "fplbase/preprocessor.h"
 #include "fplbase/render_target.h"
 #include "fplbase/render_utils.h"
+#include "fplbase/skinning.h"
 #include "fplbase/renderer.h"
 #include "fplbase/texture.h"
+#include "fplbase/trace.h"
 #include "fplbase/utilities.h"
 #include "mesh_impl_gl.h"
+#include "renderer_impl_gl.h"
+
+#include <chrono>
+#include <thread>
 
 using mathfu::mat4;
 using mathfu::vec2;
@@ -34,33 +46,75 @@ namespace fplbase {
 // Local helper functions to help rendering.
 namespace {
 
+void CountStateChange() {
+  RendererBase::CountRenderWork(&RenderCounters::state_changes);
+}
+
 void DrawElement(int32_t count, int32_t instances, uint32_t index_type,
-                 GLenum gl_primitive, bool support_instancing) {
-  static const void *kNullIndices = nullptr;
+                 GLenum gl_primitive, bool support_instancing,
+                 size_t offset) {
+  // With an index buffer bound, the indices pointer is a byte offset into it.
+  const void *indices = reinterpret_cast<const void *>(offset);
+  RendererBase::CountRenderWork(&RenderCounters::draw_calls);
 
   if (instances == 1) {
-    GL_CALL(glDrawElements(gl_primitive, count, index_type, kNullIndices));
+    GL_CALL(glDrawElements(gl_primitive, count, index_type, indices));
   } else {
     assert(support_instancing);
     (void)support_instancing;
-    GL_CALL(glDrawElementsInstanced(gl_primitive, count, index_type,
-                                    kNullIndices, instances));
+    GL_CALL(glDrawElementsInstanced(gl_primitive, count, index_type, indices,
+                                    instances));
+  }
+}
+
+void DrawArrays(GLenum gl_primitive, size_t count, size_t instances) {
+  RendererBase::CountRenderWork(&RenderCounters::draw_calls);
+  if (instances == 1) {
+    GL_CALL(glDrawArrays(gl_primitive, 0, static_cast<int32_t>(count)));
+  } else {
+    GL_CALL(glDrawArraysInstanced(gl_primitive, 0, static_cast<int32_t>(count),
+                                  static_cast<int32_t>(instances)));
   }
 }
 
+// Mesh draws leave their VAO or attributes set for the next draw, which
+// skips setting them again if they match. See VertexBindings.
 void BindAttributes(BufferHandle vao, BufferHandle vbo,
                     const Attribute *attributes, size_t vertex_size) {
+  VertexBindings *bindings = VertexBindings::Get();
   if (ValidBufferHandle(vao)) {
-    GL_CALL(glBindVertexArray(GlBufferHandle(vao)));
+    VertexBindings::BindVertexArrayObject(GlBufferHandle(vao));
+  } else if (bindings) {
+    bindings->BindMesh(GlBufferHandle(vbo), attributes,
+                       static_cast<int>(vertex_size));
   } else {
     SetAttributes(GlBufferHandle(vbo), attributes,
                   static_cast<int>(vertex_size), nullptr);
   }
 }
 
+// Bind `ibo` unless it's the one bound by the previous call. All surfaces of
+// a mesh are usually in one buffer, so it's bound once per draw.
+void BindIndexBuffer(BufferHandle ibo, BufferHandle *bound_ibo) {
+  if (GlBufferHandle(ibo) == GlBufferHandle(*bound_ibo)) return;
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GlBufferHandle(ibo)));
+  *bound_ibo = ibo;
+}
+
+// The index buffer binding is part of a VAO's state, so with one bound it can
+// stay for next time. Without, unbind it so client-side index draws work.
+void UnbindIndexBuffer(BufferHandle vao) {
+  if (!ValidBufferHandle(vao)) {
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+  }
+}
+
 void UnbindAttributes(BufferHandle vao, const Attribute *attributes) {
-  if (ValidBufferHandle(vao)) {
-    GL_CALL(glBindVertexArray(0));  // TODO(wvo): could probably omit this?
+  VertexBindings *bindings = VertexBindings::Get();
+  if (bindings) {
+    bindings->ReleaseMesh();
+  } else if (ValidBufferHandle(vao)) {
+    GL_CALL(glBindVertexArray(0));
   } else {
     UnSetAttributes(attributes);
   }
@@ -92,54 +146,119 @@ bool ValidBufferHandle(BufferHandle handle) {
 }
 bool ValidDeviceMemoryHandle(DeviceMemoryHandle /*handle*/) { return false; }
 
-RendererBaseImpl *RendererBase::CreateRendererBaseImpl() { return nullptr; }
+RendererBaseImpl *RendererBase::CreateRendererBaseImpl() {
+  return new RendererBaseImpl();
+}
 void RendererBase::DestroyRendererBaseImpl(RendererBaseImpl *impl) {
-  (void)impl;
+  delete impl;
 }
 
 RendererImpl *Renderer::CreateRendererImpl() { return nullptr; }
 void Renderer::DestroyRendererImpl(RendererImpl *impl) { (void)impl; }
 
 void RendererBase::AdvanceFrame(bool minimized, double time) {
+  FPLBASE_TRACE_SCOPE("AdvanceFrame");
   time_ = time;
 
+  // Everything up to the swap belongs to the frame that's ending.
+  last_render_counters_ = render_counters_;
+  render_counters_ = RenderCounters();
+  const RenderCounters &counters = last_render_counters_;
+  FPLBASE_TRACE_COUNTER("DrawCalls", counters.draw_calls);
+  FPLBASE_TRACE_COUNTER("StateChanges", counters.state_changes);
+  FPLBASE_TRACE_COUNTER("TextureBinds", counters.texture_binds);
+  FPLBASE_TRACE_COUNTER("ShaderSwitches", counters.shader_switches);
+  FPLBASE_TRACE_COUNTER("UniformUploads", counters.uniform_uploads);
+  FPLBASE_TRACE_COUNTER("BufferUploadBytes", counters.buffer_upload_bytes);
+  FPLBASE_TRACE_COUNTER("TextureUploadBytes", counters.texture_upload_bytes);
+
+  const double swap_start = GetTimeInSeconds();
   environment_.AdvanceFrame(minimized);
-}
+  const double swap_end = GetTimeInSeconds();
+  if (startup_times_.first_frame == 0 && initialize_start_ > 0) {
+    startup_times_.first_frame = swap_end - initialize_start_;
+  }
+
+  // Minimized frames don't render, and the first one after would include
+  // the whole time spent minimized.
+  if (minimized) {
+    last_swap_end_ = 0;
+    frame_pacer_.Reset();
+    return;
+  }
+  if (last_swap_end_ > 0) {
+    frame_stats_.AddFrame(swap_end - last_swap_end_, swap_end - swap_start);
+#ifdef LOG_FRAMERATE
+    if (frame_stats_.total_frames() % FrameStats::kDefaultWindow == 0) {
+      const FrameStats::Summary summary = frame_stats_.Summarize();
+      LogInfo(kApplication,
+              "Frame time (ms) avg: %.1f, p50: %.1f, p95: %.1f, p99: %.1f, "
+              "max: %.1f, swap avg: %.1f, jank: %d",
+              summary.average * 1000, summary.p50 * 1000, summary.p95 * 1000,
+              summary.p99 * 1000, summary.maximum * 1000,
+              summary.average_swap * 1000,
+              static_cast<int>(summary.jank_frames));
+    }
+#endif  // LOG_FRAMERATE
+  }
+  last_swap_end_ = swap_end;
 
-static std::vector<std::string> GetExtensions() {
-  std::vector<std::string> extensions;
+#ifdef __ANDROID__
+  const double vsync_time = GetVsyncTime();
+  if (vsync_time > frame_pacer_.last_vsync_time()) {
+    frame_pacer_.OnVsync(vsync_time);
+  }
+#else
+  // The swap waits for the vsync it presents on.
+  frame_pacer_.OnVsync(swap_end);
+  const int swap_interval = frame_pacer_.swap_interval();
+  if (swap_interval != swap_interval_ &&
+      environment_.SetSwapInterval(swap_interval)) {
+    swap_interval_ = swap_interval;
+  }
+#endif  // __ANDROID__
+  const double frame_start = frame_pacer_.BeginFrame(GetTimeInSeconds());
+  const double wait = frame_start - GetTimeInSeconds();
+  if (wait > 0) {
+    FPLBASE_TRACE_SCOPE("FramePacing");
+    std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+  }
+}
 
+// Adds the context's extensions to `extensions`.
+static void GetExtensions(std::unordered_set<std::string> *extensions) {
   auto res = glGetString(GL_EXTENSIONS);
   if (glGetError() == GL_NO_ERROR && res != nullptr) {
-    std::stringstream ss(reinterpret_cast<const char *>(res));
-    std::string ext;
-    while (std::getline(ss, ext, ' ')) {
-      extensions.push_back(ext);
+    const char *ext = reinterpret_cast<const char *>(res);
+    while (*ext) {
+      const char *end = strchr(ext, ' ');
+      if (!end) end = ext + strlen(ext);
+      if (end != ext) extensions->emplace(ext, end);
+      ext = *end ? end + 1 : end;
     }
-    return extensions;
+    return;
   }
 
 #if GL_ES_VERSION_3_0 || defined(GL_VERSION_3_0)
   int num_extensions = 0;
   glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
   if (glGetError() == GL_NO_ERROR) {
-    extensions.reserve(num_extensions);
+    extensions->reserve(num_extensions);
     for (int i = 0; i < num_extensions; ++i) {
       res = glGetStringi(GL_EXTENSIONS, i);
       if (res != nullptr) {
-        extensions.push_back(reinterpret_cast<const char *>(res));
+        extensions->emplace(reinterpret_cast<const char *>(res));
       }
     }
   }
 #endif  // defined(GL_NUM_EXTENSIONS)
-  return extensions;
 }
 
 bool RendererBase::InitializeRenderingState() {
-  const auto extensions = GetExtensions();
-  auto HasGLExt = [&extensions](const char *ext) -> bool {
-    auto it = std::find(extensions.begin(), extensions.end(), std::string(ext));
-    return it != extensions.end();
+  extensions_.clear();
+  GetExtensions(&extensions_);
+  auto HasGLExt = [this](const char *ext) -> bool {
+    return SupportsExtension(ext);
   };
 
   // Check for multiview extension support.
@@ -166,6 +285,78 @@ bool RendererBase::InitializeRenderingState() {
 
   supports_instancing_ = environment_.feature_level() >= kFeatureLevel30;
 
+  // Indirect draws read their base instance, which ES 3.1 doesn't support,
+  // so this is desktop only.
+#if FPLBASE_GL_MULTI_DRAW_INDIRECT
+  supports_multi_draw_indirect_ =
+      supports_instancing_ && HasGLExt("GL_ARB_multi_draw_indirect");
+#endif
+
+  // GPU timestamps, for GpuProfiler. The ES extension's entry points are
+  // looked up by GpuProfiler itself.
+#if defined(__APPLE__)
+  supports_timer_queries_ = false;
+#elif defined(FPLBASE_GLES)
+  supports_timer_queries_ = environment_.feature_level() >= kFeatureLevel30 &&
+                            HasGLExt("GL_EXT_disjoint_timer_query");
+#else
+  supports_timer_queries_ = HasGLExt("GL_ARB_timer_query");
+#endif
+
+  // Any-samples-passed occlusion queries, for OcclusionCuller.
+#ifdef FPLBASE_GLES
+  supports_occlusion_queries_ =
+      environment_.feature_level() >= kFeatureLevel30;
+#else
+  supports_occlusion_queries_ = HasGLExt("GL_ARB_occlusion_query2");
+#endif
+
+  // Discarding attachments, which lets tiled GPUs skip loading or storing
+  // them: core in ES3, an extension on desktop. The macOS headers don't
+  // declare it.
+#if defined(PLATFORM_OSX)
+  supports_invalidate_framebuffer_ = false;
+#elif defined(FPLBASE_GLES)
+  supports_invalidate_framebuffer_ =
+      environment_.feature_level() >= kFeatureLevel30;
+#else
+  supports_invalidate_framebuffer_ = HasGLExt("GL_ARB_invalidate_subdata");
+#endif
+
+  // Multisampling resolved as tiles are written out. Its entry points are
+  // looked up by RenderTarget; Apple GPUs have their own extension instead.
+#if defined(FPLBASE_GLES) && !defined(__APPLE__)
+  supports_multisampled_render_to_texture_ =
+      HasGLExt("GL_EXT_multisampled_render_to_texture");
+#endif
+
+  // Compiles and links that don't block until their status is asked for. The
+  // ARB extension is the desktop version of the KHR one, with the same enum.
+  supports_parallel_shader_compile_ =
+      HasGLExt("GL_KHR_parallel_shader_compile") ||
+      HasGLExt("GL_ARB_parallel_shader_compile");
+
+  // Program binaries, for the binary cache: core in ES3, an extension on
+  // desktop. The macOS headers don't declare it.
+#if defined(PLATFORM_OSX)
+  supports_program_binary_ = false;
+#elif defined(FPLBASE_GLES)
+  supports_program_binary_ = environment_.feature_level() >= kFeatureLevel30;
+#else
+  supports_program_binary_ = HasGLExt("GL_ARB_get_program_binary");
+#endif
+
+  // Immutable texture storage: core in ES3, an extension on desktop. The
+  // macOS headers don't declare it.
+#if defined(PLATFORM_OSX)
+  supports_texture_storage_ = false;
+#elif defined(FPLBASE_GLES)
+  supports_texture_storage_ =
+      environment_.feature_level() >= kFeatureLevel30;
+#else
+  supports_texture_storage_ = HasGLExt("GL_ARB_texture_storage");
+#endif
+
 // Check for ETC2:
 #ifdef FPLBASE_GLES
   if (environment_.feature_level() < kFeatureLevel30) {
@@ -229,77 +420,157 @@ ShaderHandle RendererBase::CompileShader(bool is_vertex_shader,
   PlatformSanitizeShaderSource(source, defines, &platform_source);
   const char *platform_source_ptr = platform_source.c_str();
 
+  // The compile status isn't checked until after linking, since with
+  // GL_KHR_parallel_shader_compile checking it would wait for the compile.
   const GLenum stage = is_vertex_shader ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER;
   const GLuint shader_obj = glCreateShader(stage);
   GL_CALL(glShaderSource(shader_obj, 1, &platform_source_ptr, nullptr));
   GL_CALL(glCompileShader(shader_obj));
+  GL_CALL(glAttachShader(GlShaderHandle(program), shader_obj));
+  return ShaderHandleFromGl(shader_obj);
+}
+
+// If `shader` failed to compile, sets `error` to its source and log.
+static bool CompileFailed(ShaderHandle shader, std::string *error) {
+  const GLuint shader_obj = GlShaderHandle(shader);
   GLint success;
   GL_CALL(glGetShaderiv(shader_obj, GL_COMPILE_STATUS, &success));
-  if (success) {
-    GL_CALL(glAttachShader(GlShaderHandle(program), shader_obj));
-    return ShaderHandleFromGl(shader_obj);
-  } else {
-    GLint length = 0;
-    GL_CALL(glGetShaderiv(shader_obj, GL_INFO_LOG_LENGTH, &length));
-    std::string shader_error(length + 1, '\0');
-    GL_CALL(glGetShaderInfoLog(shader_obj, length, &length, &shader_error[0]));
-    last_error_ = platform_source + "\n----------\n" + shader_error;
-    GL_CALL(glDeleteShader(shader_obj));
-    return InvalidShaderHandle();
-  }
+  if (success) return false;
+  GLint length = 0;
+  GL_CALL(glGetShaderiv(shader_obj, GL_SHADER_SOURCE_LENGTH, &length));
+  std::string platform_source(length + 1, '\0');
+  GL_CALL(glGetShaderSource(shader_obj, length + 1, &length,
+                            &platform_source[0]));
+  platform_source.resize(length);
+  length = 0;
+  GL_CALL(glGetShaderiv(shader_obj, GL_INFO_LOG_LENGTH, &length));
+  std::string shader_error(length + 1, '\0');
+  GL_CALL(glGetShaderInfoLog(shader_obj, length, &length, &shader_error[0]));
+  *error = platform_source + "\n----------\n" + shader_error;
+  return true;
+}
+
+bool RendererBase::EnableProgramBinaryCache(const char *directory) {
+  return supports_program_binary_ &&
+         impl_->program_binaries.Initialize(directory);
 }
 
 Shader *RendererBase::CompileAndLinkShaderHelper(const char *vs_source,
                                                  const char *ps_source,
                                                  Shader *shader) {
+  const double start = GetTimeInSeconds();
+  shader = FinishCompileAndLinkShader(
+      StartCompileAndLinkShader(vs_source, ps_source), shader);
+  if (startup_times_.first_shader_compile == 0) {
+    startup_times_.first_shader_compile = GetTimeInSeconds() - start;
+  }
+  return shader;
+}
+
+PendingShaderLink RendererBase::StartCompileAndLinkShader(
+    const char *vs_source, const char *ps_source) {
+  PendingShaderLink link;
   auto program_gl = glCreateProgram();
-  ShaderHandle program = ShaderHandleFromGl(program_gl);
-  auto vs = CompileShader(true, program, vs_source);
-  if (ValidShaderHandle(vs)) {
-    auto ps = CompileShader(false, program, ps_source);
-    if (ValidShaderHandle(ps)) {
-      GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributePosition,
-                                   "aPosition"));
-      GL_CALL(
-          glBindAttribLocation(program_gl, Mesh::kAttributeNormal, "aNormal"));
-      GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeTangent,
-                                   "aTangent"));
-      GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeOrientation,
-                                   "aOrientation"));
-      GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeTexCoord,
-                                   "aTexCoord"));
-      GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeTexCoordAlt,
-                                   "aTexCoordAlt"));
-      GL_CALL(
-          glBindAttribLocation(program_gl, Mesh::kAttributeColor, "aColor"));
-      GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeBoneIndices,
-                                   "aBoneIndices"));
-      GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeBoneWeights,
-                                   "aBoneWeights"));
-      GL_CALL(glLinkProgram(program_gl));
-      GLint status;
-      GL_CALL(glGetProgramiv(program_gl, GL_LINK_STATUS, &status));
-      if (status == GL_TRUE) {
-        if (shader == nullptr) {
-          // Load a new shader.
-          shader = new Shader(program, vs, ps);
-        } else {
-          // Reset the old shader with the recompiled shader.
-          shader->Reset(program, vs, ps);
-        }
-        GL_CALL(glUseProgram(program_gl));
-        shader->InitializeUniforms();
-        return shader;
-      }
-      GLint length = 0;
-      GL_CALL(glGetProgramiv(program_gl, GL_INFO_LOG_LENGTH, &length));
-      last_error_.assign(length, '\0');
-      GL_CALL(
-          glGetProgramInfoLog(program_gl, length, &length, &last_error_[0]));
-      GL_CALL(glDeleteShader(GlShaderHandle(ps)));
+  link.program = ShaderHandleFromGl(program_gl);
+
+  // A program loaded from the binary cache needs no shader objects.
+  const ProgramBinaryCache &binaries = impl_->program_binaries;
+  if (binaries.enabled()) {
+    // CompileShader() adds the uniform limit to the sources, so that goes in
+    // the key too, as does the fplbase version, which decides the attribute
+    // bindings.
+    const uint64_t binary_key = binaries.Key(
+        vs_source, ps_source,
+        flatbuffers::NumToString(max_vertex_uniform_components_) + " " +
+            version_->text);
+    if (binaries.Load(binary_key, program_gl)) return link;
+    // Start over, rather than link a program a binary failed to load into.
+    GL_CALL(glDeleteProgram(program_gl));
+    program_gl = glCreateProgram();
+    link.program = ShaderHandleFromGl(program_gl);
+    link.binary_key = binary_key;
+  }
+
+  link.vs = CompileShader(true, link.program, vs_source);
+  link.ps = CompileShader(false, link.program, ps_source);
+  GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributePosition,
+                               "aPosition"));
+  GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeNormal, "aNormal"));
+  GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeTangent,
+                               "aTangent"));
+  GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeOrientation,
+                               "aOrientation"));
+  GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeTexCoord,
+                               "aTexCoord"));
+  GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeTexCoordAlt,
+                               "aTexCoordAlt"));
+  GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeColor, "aColor"));
+  GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeBoneIndices,
+                               "aBoneIndices"));
+  GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeBoneWeights,
+                               "aBoneWeights"));
+  GL_CALL(glBindAttribLocation(program_gl,
+                               Mesh::kAttributeInstanceTransform + 0,
+                               "aInstanceTransform0"));
+  GL_CALL(glBindAttribLocation(program_gl,
+                               Mesh::kAttributeInstanceTransform + 1,
+                               "aInstanceTransform1"));
+  GL_CALL(glBindAttribLocation(program_gl,
+                               Mesh::kAttributeInstanceTransform + 2,
+                               "aInstanceTransform2"));
+  GL_CALL(glBindAttribLocation(program_gl, Mesh::kAttributeInstanceColor,
+                               "aInstanceColor"));
+  GL_CALL(glBindAttribLocation(program_gl,
+                               Mesh::kAttributeInstancePaletteOffset,
+                               "aInstancePaletteOffset"));
+#if defined(GL_PROGRAM_BINARY_RETRIEVABLE_HINT) && !defined(PLATFORM_OSX)
+  if (binaries.enabled()) {
+    GL_CALL(glProgramParameteri(program_gl, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                GL_TRUE));
+  }
+#endif
+  GL_CALL(glLinkProgram(program_gl));
+  return link;
+}
+
+bool RendererBase::IsShaderLinkDone(const PendingShaderLink &link) const {
+  if (!supports_parallel_shader_compile_) return true;
+  GLint done = GL_TRUE;
+  GL_CALL(glGetProgramiv(GlShaderHandle(link.program),
+                         GL_COMPLETION_STATUS_KHR, &done));
+  return done == GL_TRUE;
+}
+
+Shader *RendererBase::FinishCompileAndLinkShader(const PendingShaderLink &link,
+                                                 Shader *shader) {
+  const GLuint program_gl = GlShaderHandle(link.program);
+  GLint status;
+  GL_CALL(glGetProgramiv(program_gl, GL_LINK_STATUS, &status));
+  if (status == GL_TRUE) {
+    if (link.binary_key) {
+      impl_->program_binaries.Store(link.binary_key, program_gl);
     }
-    GL_CALL(glDeleteShader(GlShaderHandle(vs)));
+    if (shader == nullptr) {
+      // Load a new shader.
+      shader = new Shader(link.program, link.vs, link.ps);
+    } else {
+      // Reset the old shader with the recompiled shader.
+      shader->Reset(link.program, link.vs, link.ps);
+    }
+    GL_CALL(glUseProgram(program_gl));
+    shader->InitializeUniforms();
+    return shader;
+  }
+  // A shader that failed to compile says more than the link error.
+  if (!CompileFailed(link.vs, &last_error_) &&
+      !CompileFailed(link.ps, &last_error_)) {
+    GLint length = 0;
+    GL_CALL(glGetProgramiv(program_gl, GL_INFO_LOG_LENGTH, &length));
+    last_error_.assign(length, '\0');
+    GL_CALL(glGetProgramInfoLog(program_gl, length, &length, &last_error_[0]));
   }
+  GL_CALL(glDeleteShader(GlShaderHandle(link.ps)));
+  GL_CALL(glDeleteShader(GlShaderHandle(link.vs)));
   GL_CALL(glDeleteProgram(program_gl));
   return nullptr;
 }
@@ -375,9 +646,11 @@ void Renderer::SetDepthWrite(bool enabled) {
     return;
   }
 
+  CountStateChange();
   GL_CALL(glDepthMask(enabled ? GL_TRUE : GL_FALSE));
 
   render_state_.depth_state.write_enabled = enabled;
+  packed_render_state_valid_ = false;
 }
 
 void Renderer::SetBlendMode(BlendMode blend_mode, float amount) {
@@ -476,6 +749,7 @@ static void SetStencilOp(GLenum face, const StencilOperation &set_op,
   const GLenum sfail = StencilOpToGlOp(set_op.stencil_fail);
   const GLenum dpfail = StencilOpToGlOp(set_op.depth_fail);
   const GLenum dppass = StencilOpToGlOp(set_op.pass);
+  CountStateChange();
   GL_CALL(glStencilOpSeparate(face, sfail, dpfail, dppass));
 }
 
@@ -486,6 +760,7 @@ static void SetStencilFunction(GLenum face, const StencilFunction &set_func,
   }
 
   const GLenum gl_func = RenderFunctionToGlFunction(set_func.function);
+  CountStateChange();
   GL_CALL(glStencilFuncSeparate(face, gl_func, set_func.ref, set_func.mask));
 }
 
@@ -581,63 +856,171 @@ void Renderer::SetViewport(const Viewport &viewport) {
     return;
   }
 
+  CountStateChange();
   GL_CALL(glViewport(viewport.pos.x, viewport.pos.y, viewport.size.x,
                      viewport.size.y));
   render_state_.viewport = viewport;
+  packed_render_state_valid_ = false;
+}
+
+void Renderer::InvalidateTextureBindings() {
+  TextureBindings *bindings = TextureBindings::Get();
+  if (bindings) bindings->Invalidate();
+}
+
+void Renderer::InvalidateVertexBindings() {
+  VertexBindings *bindings = VertexBindings::Get();
+  if (bindings) bindings->Invalidate();
+}
+
+// Whether the `count` floats at `value` need sending to a program whose last
+// sent values are `cached`, and `bit` of `*known`. Updates both to `value`.
+static bool BuiltinUniformChanged(const float *value, size_t count,
+                                  float *cached, unsigned int bit,
+                                  unsigned int *known) {
+  if ((*known & bit) && memcmp(cached, value, count * sizeof(float)) == 0) {
+    return false;
+  }
+  memcpy(cached, value, count * sizeof(float));
+  *known |= bit;
+  return true;
+}
+
+// As above, for the variable length bone arrays.
+static bool BuiltinUniformChanged(const float *value, size_t count,
+                                  std::vector<float> *cached, unsigned int bit,
+                                  unsigned int *known) {
+  if ((*known & bit) && cached->size() == count &&
+      memcmp(cached->data(), value, count * sizeof(float)) == 0) {
+    return false;
+  }
+  cached->assign(value, value + count);
+  *known |= bit;
+  return true;
 }
 
 void Renderer::SetShader(const Shader *shader) {
   // If the shader is dirty, ReloadIfDirty() must be called first.
   assert(!shader->IsDirty());
   const int kNumVec4InBoneTransform = 3;
+  RendererBase::CountRenderWork(&RenderCounters::shader_switches);
   GL_CALL(glUseProgram(GlShaderHandle(shader->program_)));
 
-  if (ValidUniformHandle(shader->uniform_model_view_projection_)) {
+  if (shader->uses_builtin_blocks_) {
+    base_->impl()->builtin_uniforms.Update(
+        model_view_projection(), model(), color(), light_pos(), camera_pos(),
+        static_cast<float>(time()));
+  }
+
+  // Uniforms keep their values while other programs are in use, so only
+  // send those that changed since this program was last set.
+  typedef Shader::BuiltinUniformValues Values;
+  Values &values = shader->builtin_values_;
+  if (ValidUniformHandle(shader->uniform_model_view_projection_) &&
+      BuiltinUniformChanged(&model_view_projection()[0], 16,
+                            values.model_view_projection,
+                            Values::kModelViewProjection, &values.known)) {
+    RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
     GL_CALL(glUniformMatrix4fv(
         GlUniformHandle(shader->uniform_model_view_projection_), 1, false,
-        &model_view_projection()[0]));
+        values.model_view_projection));
   }
-  if (ValidUniformHandle(shader->uniform_model_)) {
+  if (ValidUniformHandle(shader->uniform_model_) &&
+      BuiltinUniformChanged(&model()[0], 16, values.model, Values::kModel,
+                            &values.known)) {
+    RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
     GL_CALL(glUniformMatrix4fv(GlUniformHandle(shader->uniform_model_), 1,
-                               false, &model()[0]));
+                               false, values.model));
   }
-  if (ValidUniformHandle(shader->uniform_color_)) {
+  if (ValidUniformHandle(shader->uniform_color_) &&
+      BuiltinUniformChanged(&color()[0], 4, values.color, Values::kColor,
+                            &values.known)) {
+    RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
     GL_CALL(
-        glUniform4fv(GlUniformHandle(shader->uniform_color_), 1, &color()[0]));
+        glUniform4fv(GlUniformHandle(shader->uniform_color_), 1, values.color));
   }
-  if (ValidUniformHandle(shader->uniform_light_pos_)) {
+  if (ValidUniformHandle(shader->uniform_light_pos_) &&
+      BuiltinUniformChanged(&light_pos()[0], 3, values.light_pos,
+                            Values::kLightPos, &values.known)) {
+    RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
     GL_CALL(glUniform3fv(GlUniformHandle(shader->uniform_light_pos_), 1,
-                         &light_pos()[0]));
+                         values.light_pos));
   }
-  if (ValidUniformHandle(shader->uniform_camera_pos_)) {
+  if (ValidUniformHandle(shader->uniform_camera_pos_) &&
+      BuiltinUniformChanged(&camera_pos()[0], 3, values.camera_pos,
+                            Values::kCameraPos, &values.known)) {
+    RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
     GL_CALL(glUniform3fv(GlUniformHandle(shader->uniform_camera_pos_), 1,
-                         &camera_pos()[0]));
+                         values.camera_pos));
   }
-  if (ValidUniformHandle(shader->uniform_time_)) {
-    GL_CALL(glUniform1f(GlUniformHandle(shader->uniform_time_),
-                        static_cast<float>(time())));
+  const float time_value = static_cast<float>(time());
+  if (ValidUniformHandle(shader->uniform_time_) &&
+      BuiltinUniformChanged(&time_value, 1, &values.time, Values::kTime,
+                            &values.known)) {
+    RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
+    GL_CALL(glUniform1f(GlUniformHandle(shader->uniform_time_), values.time));
   }
-  if (ValidUniformHandle(shader->uniform_bone_transforms_) && num_bones() > 0) {
+  if (shader->bone_palette_block_size_ > 0 && bone_palette_ != nullptr &&
+      ValidBufferHandle(bone_palette_->buffer())) {
+    // Bind no more than the block's size, so shaders can declare the block
+    // for their largest skeleton.
+    assert(bone_palette_offset_ < bone_palette_->gpu_memory_size());
+    const size_t size = std::min(
+        static_cast<size_t>(shader->bone_palette_block_size_),
+        bone_palette_->gpu_memory_size() - bone_palette_offset_);
+    GL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, BonePaletteBuffer::kBinding,
+                              GlBufferHandle(bone_palette_->buffer()),
+                              bone_palette_offset_, size));
+  } else if (ValidUniformHandle(shader->uniform_bone_transforms_) &&
+             num_bones() > 0) {
     assert(bone_transforms_ != nullptr);
 
-    GL_CALL(glUniform4fv(GlUniformHandle(shader->uniform_bone_transforms_),
-                         num_bones() * kNumVec4InBoneTransform,
-                         &bone_transforms_[0][0]));
+    const size_t count =
+        static_cast<size_t>(num_bones() * kNumVec4InBoneTransform * 4);
+    if (BuiltinUniformChanged(&bone_transforms_[0][0], count,
+                              &values.bone_transforms, Values::kBoneTransforms,
+                              &values.known)) {
+      RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
+      GL_CALL(glUniform4fv(GlUniformHandle(shader->uniform_bone_transforms_),
+                           num_bones() * kNumVec4InBoneTransform,
+                           values.bone_transforms.data()));
+    }
+  }
+  if (ValidUniformHandle(shader->uniform_bone_dual_quaternions_) &&
+      num_dual_quaternion_bones() > 0) {
+    assert(bone_dual_quaternions_ != nullptr);
+
+    const size_t count = static_cast<size_t>(num_dual_quaternion_bones() *
+                                             kNumVec4sInDualQuaternion * 4);
+    if (BuiltinUniformChanged(
+            reinterpret_cast<const float *>(bone_dual_quaternions_), count,
+            &values.bone_dual_quaternions, Values::kBoneDualQuaternions,
+            &values.known)) {
+      RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
+      GL_CALL(glUniform4fv(
+          GlUniformHandle(shader->uniform_bone_dual_quaternions_),
+          num_dual_quaternion_bones() * kNumVec4sInDualQuaternion,
+          values.bone_dual_quaternions.data()));
+    }
   }
 }
 
 void Renderer::ScissorOn(const vec2i &pos, const vec2i &size) {
   if (!render_state_.scissor_state.enabled) {
+    CountStateChange();
     GL_CALL(glEnable(GL_SCISSOR_TEST));
     render_state_.scissor_state.enabled = true;
+    packed_render_state_valid_ = false;
   }
 
   auto viewport_size = base_->GetViewportSize();
+  CountStateChange();
   GL_CALL(glViewport(0, 0, viewport_size.x, viewport_size.y));
 
   auto scaling_ratio = vec2(viewport_size) / vec2(base_->window_size());
   auto scaled_pos = vec2(pos) * scaling_ratio;
   auto scaled_size = vec2(size) * scaling_ratio;
+  CountStateChange();
   GL_CALL(glScissor(static_cast<GLint>(scaled_pos.x),
                     static_cast<GLint>(scaled_pos.y),
                     static_cast<GLsizei>(scaled_size.x),
@@ -649,12 +1032,15 @@ void Renderer::ScissorOff() {
     return;
   }
 
+  CountStateChange();
   GL_CALL(glDisable(GL_SCISSOR_TEST));
   render_state_.scissor_state.enabled = false;
+  packed_render_state_valid_ = false;
 }
 
 void Renderer::RenderSubMeshHelper(Mesh *mesh, size_t index,
-                                   bool ignore_material, size_t instances) {
+                                   bool ignore_material, size_t instances,
+                                   size_t lod, BufferHandle *bound_ibo) {
   assert(index < mesh->indices_.size());
 
   auto submesh = mesh->indices_.begin() + index;
@@ -663,32 +1049,89 @@ void Renderer::RenderSubMeshHelper(Mesh *mesh, size_t index,
     submesh->mat->Set(*this);
   }
 
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GlBufferHandle(submesh->ibo)));
-  DrawElement(submesh->count, static_cast<int32_t>(instances), submesh->index_type,
-              mesh->primitive_, base_->supports_instancing_);
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+  const auto level = submesh->Lod(lod);
+  BindIndexBuffer(level.ibo, bound_ibo);
+  SampleRenderState();
+  DrawElement(level.count, static_cast<int32_t>(instances), submesh->index_type,
+              mesh->primitive_, base_->supports_instancing_, level.offset);
 }
 
-void Renderer::Render(Mesh *mesh, bool ignore_material, size_t instances) {
-  BindAttributes(mesh->impl_->vao, mesh->impl_->vbo, mesh->format_,
-                 mesh->vertex_size_);
+void Renderer::RenderMeshHelper(Mesh *mesh, bool ignore_material,
+                                size_t instances, size_t lod) {
   if (!mesh->indices_.empty()) {
+    BufferHandle bound_ibo = InvalidBufferHandle();
     for (size_t i = 0; i < mesh->indices_.size(); ++i) {
-      RenderSubMeshHelper(mesh, i, ignore_material, instances);
+      RenderSubMeshHelper(mesh, i, ignore_material, instances, lod,
+                          &bound_ibo);
     }
+    UnbindIndexBuffer(mesh->impl_->vao);
   } else {
-    GL_CALL(glDrawArrays(mesh->primitive_, 0,
-                         static_cast<int32_t>(mesh->num_vertices_)));
+    SampleRenderState();
+    DrawArrays(mesh->primitive_, mesh->num_vertices_, instances);
   }
+}
+
+void Renderer::Render(Mesh *mesh, bool ignore_material, size_t instances,
+                      size_t lod) {
+  FPLBASE_TRACE_SCOPE("Render");
+  BindAttributes(mesh->impl_->vao, mesh->impl_->vbo, mesh->format_,
+                 mesh->vertex_size_);
+  RenderMeshHelper(mesh, ignore_material, instances, lod);
+  UnbindAttributes(mesh->impl_->vao, mesh->format_);
+}
+
+void Renderer::Render(Mesh *mesh, const InstanceBuffer &instances,
+                      bool ignore_material, size_t lod) {
+  if (instances.count() == 0) return;
+  FPLBASE_TRACE_SCOPE("Render");
+  assert(base_->supports_instancing_);
+  BindAttributes(mesh->impl_->vao, mesh->impl_->vbo, mesh->format_,
+                 mesh->vertex_size_);
+  // With a VAO bound, this adds the instance attributes to it, so they're
+  // unset again before the VAO is unbound.
+  SetAttributes(GlBufferHandle(instances.buffer()), instances.format(),
+                static_cast<int>(instances.instance_size()), nullptr);
+  RenderMeshHelper(mesh, ignore_material, instances.count(), lod);
+  UnSetAttributes(instances.format());
   UnbindAttributes(mesh->impl_->vao, mesh->format_);
 }
 
 void Renderer::RenderStereo(Mesh *mesh, const Shader *shader,
                             const Viewport *viewport, const mat4 *mvp,
                             const vec3 *camera_position, bool ignore_material,
-                            size_t instances) {
+                            size_t instances, size_t lod) {
+  FPLBASE_TRACE_SCOPE("RenderStereo");
   BindAttributes(mesh->impl_->vao, mesh->impl_->vbo, mesh->format_,
                  mesh->vertex_size_);
+
+  // Both eyes in one draw: the views share a viewport, and the shader picks
+  // its eye's transform with gl_ViewID_OVR.
+  if (base_->supports_multiview_ && shader->multiview()) {
+    set_camera_pos(camera_position[0]);
+    set_model_view_projection(mvp[0]);
+    SetViewport(viewport[0]);
+    SetShader(shader);
+    mathfu::vec4_packed mvp_columns[8];
+    mvp[0].Pack(mvp_columns);
+    mvp[1].Pack(mvp_columns + 4);
+    RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
+    GL_CALL(glUniformMatrix4fv(
+        GlUniformHandle(shader->uniform_model_view_projection_multiview_), 2,
+        false, mvp_columns[0].data));
+    if (ValidUniformHandle(shader->uniform_camera_pos_multiview_)) {
+      const float camera_pos_data[2][3] = {
+          {camera_position[0].x, camera_position[0].y, camera_position[0].z},
+          {camera_position[1].x, camera_position[1].y, camera_position[1].z}};
+      RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
+      GL_CALL(glUniform3fv(
+          GlUniformHandle(shader->uniform_camera_pos_multiview_), 2,
+          &camera_pos_data[0][0]));
+    }
+    RenderMeshHelper(mesh, ignore_material, instances, lod);
+    UnbindAttributes(mesh->impl_->vao, mesh->format_);
+    return;
+  }
+
   auto prep_stereo = [&](size_t i) {
     set_camera_pos(camera_position[i]);
     set_model_view_projection(mvp[i]);
@@ -697,49 +1140,90 @@ void Renderer::RenderStereo(Mesh *mesh, const Shader *shader,
   };
 
   if (!mesh->indices_.empty()) {
+    BufferHandle bound_ibo = InvalidBufferHandle();
     for (auto it = mesh->indices_.begin(); it != mesh->indices_.end(); ++it) {
       if (!ignore_material) it->mat->Set(*this);
-      GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GlBufferHandle(it->ibo)));
+      const auto level = it->Lod(lod);
+      BindIndexBuffer(level.ibo, &bound_ibo);
       for (size_t i = 0; i < 2; ++i) {
         prep_stereo(i);
-        DrawElement(it->count, static_cast<int32_t>(instances), it->index_type,
-                    mesh->primitive_, base_->supports_instancing_);
+        SampleRenderState();
+        DrawElement(level.count, static_cast<int32_t>(instances),
+                    it->index_type, mesh->primitive_,
+                    base_->supports_instancing_, level.offset);
       }
-      GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
     }
+    UnbindIndexBuffer(mesh->impl_->vao);
   } else {
     for (size_t i = 0; i < 2; ++i) {
       prep_stereo(i);
-      GL_CALL(glDrawArrays(mesh->primitive_, 0,
-                           static_cast<int32_t>(mesh->num_vertices_)));
+      SampleRenderState();
+      DrawArrays(mesh->primitive_, mesh->num_vertices_, instances);
     }
   }
   UnbindAttributes(mesh->impl_->vao, mesh->format_);
 }
 
 void Renderer::RenderSubMesh(Mesh *mesh, size_t submesh, bool ignore_material,
-                             size_t instances) {
+                             size_t instances, size_t lod) {
+  FPLBASE_TRACE_SCOPE("RenderSubMesh");
   BindAttributes(mesh->impl_->vao, mesh->impl_->vbo, mesh->format_,
                  mesh->vertex_size_);
   if (!mesh->indices_.empty()) {
-    RenderSubMeshHelper(mesh, submesh, ignore_material, instances);
+    BufferHandle bound_ibo = InvalidBufferHandle();
+    RenderSubMeshHelper(mesh, submesh, ignore_material, instances, lod,
+                        &bound_ibo);
+    UnbindIndexBuffer(mesh->impl_->vao);
   } else {
     assert(submesh == 0);
-    GL_CALL(glDrawArrays(mesh->primitive_, 0,
-                         static_cast<int32_t>(mesh->num_vertices_)));
+    SampleRenderState();
+    DrawArrays(mesh->primitive_, mesh->num_vertices_, instances);
   }
   UnbindAttributes(mesh->impl_->vao, mesh->format_);
 }
 
 void Renderer::SetRenderState(const RenderState &render_state) {
-  SetAlphaTestState(render_state.alpha_test_state);
-  SetBlendState(render_state.blend_state);
-  SetCullState(render_state.cull_state);
-  SetDepthState(render_state.depth_state);
-  SetPointState(render_state.point_state);
-  SetScissorState(render_state.scissor_state);
-  SetStencilState(render_state.stencil_state);
-  SetViewport(render_state.viewport);
+  SetRenderState(PackedRenderState(render_state));
+}
+
+void Renderer::SetRenderState(const PackedRenderState &render_state) {
+  if (!packed_render_state_valid_) {
+    packed_render_state_ = PackedRenderState(render_state_);
+    packed_render_state_valid_ = true;
+  }
+  const uint32_t changed = render_state.Diff(packed_render_state_);
+  if (changed == 0) return;
+
+  RenderState state;
+  render_state.Unpack(&state);
+  if (changed & PackedRenderState::kAlphaTestComponent) {
+    SetAlphaTestState(state.alpha_test_state);
+  }
+  if (changed & PackedRenderState::kBlendComponent) {
+    SetBlendState(state.blend_state);
+  }
+  if (changed & PackedRenderState::kCullComponent) {
+    SetCullState(state.cull_state);
+  }
+  if (changed & PackedRenderState::kDepthComponent) {
+    SetDepthState(state.depth_state);
+  }
+  if (changed & PackedRenderState::kPointComponent) {
+    SetPointState(state.point_state);
+  }
+  if (changed & PackedRenderState::kScissorComponent) {
+    SetScissorState(state.scissor_state);
+  }
+  if (changed & PackedRenderState::kStencilComponent) {
+    SetStencilState(state.stencil_state);
+  }
+  if (changed & PackedRenderState::kViewportComponent) {
+    SetViewport(state.viewport);
+  }
+
+  // The setters above leave render_state_ equal to `render_state`.
+  packed_render_state_ = render_state;
+  packed_render_state_valid_ = true;
 }
 
 void Renderer::SetAlphaTestState(const AlphaTestState &alpha_test_state) {
@@ -747,8 +1231,10 @@ void Renderer::SetAlphaTestState(const AlphaTestState &alpha_test_state) {
     !defined(PLATFORM_OSX)  // Alpha test not supported in ES 2+.
   if (alpha_test_state.enabled != render_state_.alpha_test_state.enabled) {
     if (alpha_test_state.enabled) {
+      CountStateChange();
       GL_CALL(glEnable(GL_ALPHA_TEST));
     } else {
+      CountStateChange();
       GL_CALL(glDisable(GL_ALPHA_TEST));
     }
   }
@@ -757,11 +1243,13 @@ void Renderer::SetAlphaTestState(const AlphaTestState &alpha_test_state) {
       alpha_test_state.function != render_state_.alpha_test_state.function) {
     const GLenum gl_func =
         RenderFunctionToGlFunction(alpha_test_state.function);
+    CountStateChange();
     GL_CALL(glAlphaFunc(gl_func, alpha_test_state.ref));
   }
 #endif
 
   render_state_.alpha_test_state = alpha_test_state;
+  packed_render_state_valid_ = false;
 
   blend_mode_ = kBlendModeUnknown;
   blend_amount_ =  alpha_test_state.ref;
@@ -770,8 +1258,10 @@ void Renderer::SetAlphaTestState(const AlphaTestState &alpha_test_state) {
 void Renderer::SetBlendState(const BlendState &blend_state) {
   if (blend_state.enabled != render_state_.blend_state.enabled) {
     if (blend_state.enabled) {
+      CountStateChange();
       GL_CALL(glEnable(GL_BLEND));
     } else {
+      CountStateChange();
       GL_CALL(glDisable(GL_BLEND));
     }
   }
@@ -783,10 +1273,12 @@ void Renderer::SetBlendState(const BlendState &blend_state) {
     const GLenum src_factor = BlendStateFactorToGl(blend_state.src_alpha);
     const GLenum dst_factor = BlendStateFactorToGl(blend_state.dst_alpha);
 
+    CountStateChange();
     GL_CALL(glBlendFunc(src_factor, dst_factor));
   }
 
   render_state_.blend_state = blend_state;
+  packed_render_state_valid_ = false;
 
   blend_mode_ = kBlendModeUnknown;
 }
@@ -794,22 +1286,27 @@ void Renderer::SetBlendState(const BlendState &blend_state) {
 void Renderer::SetCullState(const CullState &cull_state) {
   if (cull_state.enabled != render_state_.cull_state.enabled) {
     if (cull_state.enabled) {
+      CountStateChange();
       GL_CALL(glEnable(GL_CULL_FACE));
     } else {
+      CountStateChange();
       GL_CALL(glDisable(GL_CULL_FACE));
     }
   }
 
   if (cull_state.face != render_state_.cull_state.face) {
     const GLenum cull_face = CullFaceToGl(cull_state.face);
+    CountStateChange();
     GL_CALL(glCullFace(cull_face));
   }
 
   if (cull_state.front != render_state_.cull_state.front) {
+    CountStateChange();
     GL_CALL(glFrontFace(FrontFaceToGl(cull_state.front)));
   }
 
   render_state_.cull_state = cull_state;
+  packed_render_state_valid_ = false;
 
   cull_mode_ = kCullingModeUnknown;
 }
@@ -817,8 +1314,10 @@ void Renderer::SetCullState(const CullState &cull_state) {
 void Renderer::SetDepthState(const DepthState &depth_state) {
   if (depth_state.test_enabled != render_state_.depth_state.test_enabled) {
     if (depth_state.test_enabled) {
+      CountStateChange();
       GL_CALL(glEnable(GL_DEPTH_TEST));
     } else {
+      CountStateChange();
       GL_CALL(glDisable(GL_DEPTH_TEST));
     }
   }
@@ -827,10 +1326,12 @@ void Renderer::SetDepthState(const DepthState &depth_state) {
 
   if (depth_state.function != render_state_.depth_state.function) {
     const GLenum depth_func = RenderFunctionToGlFunction(depth_state.function);
+    CountStateChange();
     GL_CALL(glDepthFunc(depth_func));
   }
 
   render_state_.depth_state = depth_state;
+  packed_render_state_valid_ = false;
 
   depth_function_ = kDepthFunctionUnknown;
 }
@@ -841,8 +1342,10 @@ void Renderer::SetPointState(const PointState &point_state) {
   if (render_state_.point_state.point_sprite_enabled !=
       point_state.point_sprite_enabled) {
     if (point_state.point_sprite_enabled) {
+      CountStateChange();
       GL_CALL(glEnable(GL_POINT_SPRITE));
     } else {
+      CountStateChange();
       GL_CALL(glDisable(GL_POINT_SPRITE));
     }
   }
@@ -852,8 +1355,10 @@ void Renderer::SetPointState(const PointState &point_state) {
   if (render_state_.point_state.program_point_size_enabled !=
       point_state.program_point_size_enabled) {
     if (point_state.program_point_size_enabled) {
+      CountStateChange();
       GL_CALL(glEnable(GL_PROGRAM_POINT_SIZE));
     } else {
+      CountStateChange();
       GL_CALL(glDisable(GL_PROGRAM_POINT_SIZE));
     }
   }
@@ -861,19 +1366,23 @@ void Renderer::SetPointState(const PointState &point_state) {
   if (render_state_.point_state.program_point_size_enabled !=
       point_state.program_point_size_enabled) {
     if (point_state.program_point_size_enabled) {
+      CountStateChange();
       GL_CALL(glEnable(GL_VERTEX_PROGRAM_POINT_SIZE));
     } else {
+      CountStateChange();
       GL_CALL(glDisable(GL_VERTEX_PROGRAM_POINT_SIZE));
     }
   }
 #endif  // GL_PROGRAM_POINT_SIZE
 
   if (render_state_.point_state.point_size != point_state.point_size) {
+    CountStateChange();
     GL_CALL(glPointSize(point_state.point_size));
   }
 #endif  // FPLBASE_GLES
 
   render_state_.point_state = point_state;
+  packed_render_state_valid_ = false;
 }
 
 void Renderer::SetScissorState(const ScissorState &scissor_state) {
@@ -882,22 +1391,28 @@ void Renderer::SetScissorState(const ScissorState &scissor_state) {
   }
 
   if (scissor_state.enabled) {
+    CountStateChange();
     GL_CALL(glEnable(GL_SCISSOR_TEST));
   } else {
+    CountStateChange();
     GL_CALL(glDisable(GL_SCISSOR_TEST));
   }
 
+  CountStateChange();
   GL_CALL(glScissor(scissor_state.rect.pos.x, scissor_state.rect.pos.y,
                     scissor_state.rect.size.x, scissor_state.rect.size.y));
 
   render_state_.scissor_state = scissor_state;
+  packed_render_state_valid_ = false;
 }
 
 void Renderer::SetStencilState(const StencilState &stencil_state) {
   if (stencil_state.enabled != render_state_.stencil_state.enabled) {
     if (stencil_state.enabled) {
+      CountStateChange();
       GL_CALL(glEnable(GL_STENCIL_TEST));
     } else {
+      CountStateChange();
       GL_CALL(glDisable(GL_STENCIL_TEST));
     }
   }
@@ -913,6 +1428,7 @@ void Renderer::SetStencilState(const StencilState &stencil_state) {
                render_state_.stencil_state.back_op);
 
   render_state_.stencil_state = stencil_state;
+  packed_render_state_valid_ = false;
 
   stencil_ref_ = stencil_state.front_function.ref;
   stencil_mask_ = stencil_state.front_function.mask;
@@ -921,10 +1437,12 @@ void Renderer::SetStencilState(const StencilState &stencil_state) {
 
 void Renderer::SetFrontFace(CullState::FrontFace front_face) {
   if (front_face != render_state_.cull_state.front) {
+    CountStateChange();
     GL_CALL(glFrontFace(FrontFaceToGl(front_face)));
   }
 
   render_state_.cull_state.front = front_face;
+  packed_render_state_valid_ = false;
 }
 
 }  // namespace fplbase
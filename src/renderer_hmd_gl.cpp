@@ -18,6 +18,7 @@
 #include "fplbase/renderer_hmd.h"
 #include "fplbase/utilities.h"
 #include "fplbase/gpu_debug.h"
+#include "texture_bindings_gl.h"
 
 using mathfu::vec2i;
 
@@ -31,36 +32,123 @@ GLuint g_undistort_framebuffer_id = 0;
 GLuint g_undistort_texture_id = 0;
 // The renderbuffer, needed for the depth
 GLuint g_undistort_renderbuffer_id = 0;
+// The size of the above, after SetUndistortFramebufferScale().
+vec2i g_undistort_size = mathfu::kZeros2i;
 
-void InitializeUndistortFramebuffer(int width, int height) {
-  // Set up a framebuffer that matches the window, such that we can render to
-  // it, and then undistort the result properly for HMDs.
-  GL_CALL(glGenTextures(1, &g_undistort_texture_id));
-  GL_CALL(glBindTexture(GL_TEXTURE_2D, g_undistort_texture_id));
+// Settings from SetUndistortFramebufferScale() and SetFixedFoveation().
+static float g_undistort_scale = 1.0f;
+static float g_fovea_size = 1.0f;
+static float g_periphery_scale = 1.0f;
+
+// The framebuffer the periphery is rendered to when GL_QCOM_texture_foveated
+// isn't available, and its color texture and depth renderbuffer.
+static GLuint g_periphery_framebuffer_id = 0;
+static GLuint g_periphery_texture_id = 0;
+static GLuint g_periphery_renderbuffer_id = 0;
+static vec2i g_periphery_size = mathfu::kZeros2i;
+
+// GL_QCOM_texture_foveated's tokens and entry point aren't in the ES 3.0
+// headers.
+static const GLenum kTextureFoveatedFeatureBitsQCOM = 0x8BFB;
+static const GLint kFoveationEnableBitQCOM = 0x1;
+static const GLint kFoveationScaledBinMethodBitQCOM = 0x2;
+typedef void(GL_APIENTRYP TextureFoveationParametersProc)(
+    GLuint texture, GLuint layer, GLuint focal_point, GLfloat focal_x,
+    GLfloat focal_y, GLfloat gain_x, GLfloat gain_y, GLfloat fovea_area);
+
+static bool FoveationEnabled() { return g_periphery_scale < 1.0f; }
+
+// Create a framebuffer with a color texture and a depth renderbuffer. If
+// `foveated`, the texture uses GL_QCOM_texture_foveated.
+static void CreateEyeFramebuffer(const vec2i& size, bool foveated,
+                                 GLuint* framebuffer_id, GLuint* texture_id,
+                                 GLuint* renderbuffer_id) {
+  GL_CALL(glGenTextures(1, texture_id));
+  TextureBindings::BindTexture(0, GL_TEXTURE_2D, *texture_id);
   GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
   GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
   GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
   GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-  GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
+  if (foveated) {
+    GL_CALL(glTexParameteri(
+        GL_TEXTURE_2D, kTextureFoveatedFeatureBitsQCOM,
+        kFoveationEnableBitQCOM | kFoveationScaledBinMethodBitQCOM));
+  }
+  GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, size.x, size.y, 0, GL_RGB,
                        GL_UNSIGNED_BYTE, nullptr));
 
-  GL_CALL(glGenRenderbuffers(1, &g_undistort_renderbuffer_id));
-  GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, g_undistort_renderbuffer_id));
-  GL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width,
-                                height));
+  GL_CALL(glGenRenderbuffers(1, renderbuffer_id));
+  GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, *renderbuffer_id));
+  GL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, size.x,
+                                size.y));
 
-  GL_CALL(glGenFramebuffers(1, &g_undistort_framebuffer_id));
-  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, g_undistort_framebuffer_id));
+  GL_CALL(glGenFramebuffers(1, framebuffer_id));
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, *framebuffer_id));
 
   GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                                 GL_TEXTURE_2D, g_undistort_texture_id, 0));
+                                 GL_TEXTURE_2D, *texture_id, 0));
   GL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                                    GL_RENDERBUFFER,
-                                    g_undistort_renderbuffer_id));
+                                    GL_RENDERBUFFER, *renderbuffer_id));
 
   GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
 }
 
+// Place a focal point at the center of each eye's half of the texture. The
+// gains put the edge of the fovea at a density of 1, falling off beyond it.
+static void SetFoveationParameters(GLuint texture_id) {
+  static TextureFoveationParametersProc texture_foveation_parameters =
+      reinterpret_cast<TextureFoveationParametersProc>(
+          eglGetProcAddress("glTextureFoveationParametersQCOM"));
+  if (texture_foveation_parameters == nullptr) return;
+  // Focal points are in [-1, 1] across the whole texture, so each eye is 1
+  // wide and 2 high.
+  const float gain_x = 2.0f / g_fovea_size;
+  const float gain_y = 1.0f / g_fovea_size;
+  GL_CALL(texture_foveation_parameters(texture_id, 0, 0, -0.5f, 0.0f, gain_x,
+                                       gain_y, 0.0f));
+  GL_CALL(texture_foveation_parameters(texture_id, 0, 1, 0.5f, 0.0f, gain_x,
+                                       gain_y, 0.0f));
+}
+
+void SetUndistortFramebufferScale(float scale) {
+  assert(scale > 0.0f && scale <= 1.0f);
+  g_undistort_scale = scale;
+}
+
+void SetFixedFoveation(float fovea_size, float periphery_scale) {
+  assert(fovea_size > 0.0f && fovea_size <= 1.0f);
+  assert(periphery_scale > 0.0f && periphery_scale <= 1.0f);
+  g_fovea_size = fovea_size;
+  g_periphery_scale = periphery_scale;
+}
+
+void InitializeUndistortFramebuffer(int width, int height) {
+  // Set up a framebuffer that matches the window, such that we can render to
+  // it, and then undistort the result properly for HMDs.
+  g_undistort_size =
+      vec2i(std::max(1, static_cast<int>(width * g_undistort_scale)),
+            std::max(1, static_cast<int>(height * g_undistort_scale)));
+  const RendererBase* renderer = RendererBase::Get();
+  const bool foveated =
+      FoveationEnabled() &&
+      renderer->SupportsExtension("GL_QCOM_texture_foveated");
+  CreateEyeFramebuffer(g_undistort_size, foveated, &g_undistort_framebuffer_id,
+                       &g_undistort_texture_id, &g_undistort_renderbuffer_id);
+  if (foveated) {
+    SetFoveationParameters(g_undistort_texture_id);
+  } else if (FoveationEnabled() &&
+             renderer->feature_level() >= kFeatureLevel30) {
+    // Without the extension, render the periphery separately and upscale it
+    // with glBlitFramebuffer().
+    g_periphery_size = vec2i(
+        std::max(1, static_cast<int>(g_undistort_size.x * g_periphery_scale)),
+        std::max(1, static_cast<int>(g_undistort_size.y * g_periphery_scale)));
+    CreateEyeFramebuffer(g_periphery_size, false, &g_periphery_framebuffer_id,
+                         &g_periphery_texture_id,
+                         &g_periphery_renderbuffer_id);
+  }
+}
+
 void BeginUndistortFramebuffer() {
   GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, g_undistort_framebuffer_id));
 }
@@ -72,6 +160,9 @@ void FinishUndistortFramebuffer() {
   jclass fpl_class = env->GetObjectClass(activity);
   jmethodID undistort = env->GetMethodID(fpl_class, "UndistortTexture", "(I)V");
   env->CallVoidMethod(activity, undistort, (jint)g_undistort_texture_id);
+  // The undistortion binds textures with GL directly.
+  TextureBindings *bindings = TextureBindings::Get();
+  if (bindings) bindings->Invalidate();
   env->DeleteLocalRef(fpl_class);
   env->DeleteLocalRef(activity);
 }
@@ -105,7 +196,8 @@ void HeadMountedDisplayRenderStart(
   renderer->set_color(mathfu::kOnes4f);
   renderer->SetDepthFunction(fplbase::kDepthFunctionLess);
 
-  const mathfu::vec2i viewport_size = renderer->GetViewportSize();
+  const mathfu::vec2i viewport_size =
+      use_undistortion ? g_undistort_size : renderer->GetViewportSize();
   int window_width = viewport_size.x;
   int window_height = viewport_size.y;
   int half_width = window_width / 2;
@@ -134,6 +226,65 @@ void HeadMountedDisplayRenderEnd(Renderer* renderer, bool use_undistortion) {
   }
 }
 
+bool HeadMountedDisplayHasPeripheryPass(bool use_undistortion) {
+  return use_undistortion && g_periphery_framebuffer_id != 0;
+}
+
+void HeadMountedDisplayBeginPeripheryPass(
+    Renderer* renderer, const mathfu::vec4& clear_color,
+    HeadMountedDisplayViewSettings* view_settings) {
+  assert(g_periphery_framebuffer_id != 0);
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, g_periphery_framebuffer_id));
+  renderer->ClearFrameBuffer(clear_color);
+  const int half_width = g_periphery_size.x / 2;
+  view_settings->viewport_extents[0] =
+      mathfu::vec4i(0, 0, half_width, g_periphery_size.y);
+  view_settings->viewport_extents[1] =
+      mathfu::vec4i(half_width, 0, half_width, g_periphery_size.y);
+}
+
+void HeadMountedDisplayEndPeripheryPass(
+    Renderer* renderer, const HeadMountedDisplayViewSettings& view_settings) {
+  // Upscale the periphery into the undistortion framebuffer.
+  GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, g_periphery_framebuffer_id));
+  GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, g_undistort_framebuffer_id));
+  GL_CALL(glBlitFramebuffer(0, 0, g_periphery_size.x, g_periphery_size.y, 0, 0,
+                            g_undistort_size.x, g_undistort_size.y,
+                            GL_COLOR_BUFFER_BIT, GL_LINEAR));
+  BeginUndistortFramebuffer();
+
+  // Clear the depth around each eye's fovea to the near plane, so the full
+  // resolution pass fails the depth test there and never shades it.
+  renderer->ScissorOff();
+  renderer->SetDepthWrite(true);
+  GL_CALL(glEnable(GL_SCISSOR_TEST));
+  GL_CALL(glClearDepthf(0.0f));
+  for (int eye = 0; eye < 2; ++eye) {
+    const mathfu::vec4i& extents = view_settings.viewport_extents[eye];
+    const int fovea_width = static_cast<int>(extents.z * g_fovea_size);
+    const int fovea_height = static_cast<int>(extents.w * g_fovea_size);
+    const int left = extents.x + (extents.z - fovea_width) / 2;
+    const int bottom = extents.y + (extents.w - fovea_height) / 2;
+    const int right = left + fovea_width;
+    const int top = bottom + fovea_height;
+    // Bands below and above the fovea, then left and right of it.
+    const mathfu::vec4i bands[] = {
+        mathfu::vec4i(extents.x, extents.y, extents.z, bottom - extents.y),
+        mathfu::vec4i(extents.x, top, extents.z, extents.y + extents.w - top),
+        mathfu::vec4i(extents.x, bottom, left - extents.x, fovea_height),
+        mathfu::vec4i(right, bottom, extents.x + extents.z - right,
+                      fovea_height),
+    };
+    for (size_t i = 0; i < sizeof(bands) / sizeof(bands[0]); ++i) {
+      if (bands[i].z <= 0 || bands[i].w <= 0) continue;
+      GL_CALL(glScissor(bands[i].x, bands[i].y, bands[i].z, bands[i].w));
+      renderer->ClearDepthBuffer();
+    }
+  }
+  GL_CALL(glClearDepthf(1.0f));
+  GL_CALL(glDisable(GL_SCISSOR_TEST));
+}
+
 #endif  // FPLBASE_ANDROID_VR
 
 }  // namespace fplbase
@@ -0,0 +1,65 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_RENDERER_IMPL_GL_H
+#define FPLBASE_RENDERER_IMPL_GL_H
+
+#include "builtin_uniform_buffer_gl.h"
+#include "fplbase/glplatform.h"
+#include "pixel_unpack_ring_gl.h"
+#include "program_binary_cache_gl.h"
+#include "streaming_buffer_gl.h"
+#include "texture_bindings_gl.h"
+#include "vertex_bindings_gl.h"
+
+namespace fplbase {
+
+// A VAO that reads one vertex format from the start of
+// RendererBaseImpl::stream_vertices, so RenderArray() draws bind it rather
+// than set up their attributes.
+struct StreamVertexArray {
+  std::vector<Attribute> format;  // Terminated by kEND.
+  int stride;
+  unsigned int vao;
+};
+
+struct RendererBaseImpl {
+  RendererBaseImpl()
+      : stream_vertices(GL_ARRAY_BUFFER),
+        stream_indices(GL_ELEMENT_ARRAY_BUFFER) {}
+
+  // Staging buffers for texture uploads. Only used at kFeatureLevel30+.
+  PixelUnpackRing pixel_unpack_ring;
+  // Buffers that RenderArray() streams through. Only used at
+  // kFeatureLevel30+.
+  StreamingBuffer stream_vertices;
+  StreamingBuffer stream_indices;
+  // One VAO per vertex format and stride streamed through them.
+  std::vector<StreamVertexArray> stream_vertex_arrays;
+  // What's bound to each texture unit, to skip redundant binds.
+  TextureBindings texture_bindings;
+  // The bound VAO and enabled attribute arrays, to skip redundant setup
+  // between draws.
+  VertexBindings vertex_bindings;
+  // The `FrameUniforms` and `ObjectUniforms` blocks. Only used at
+  // kFeatureLevel30+.
+  BuiltinUniformBuffer builtin_uniforms;
+  // Linked programs saved to disk. Only used once enabled, with
+  // RendererBase::EnableProgramBinaryCache().
+  ProgramBinaryCache program_binaries;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_RENDERER_IMPL_GL_H
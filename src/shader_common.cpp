@@ -14,6 +14,7 @@
 
 #include "precompiled.h"
 
+#include <ctype.h>
 #include <iterator>
 
 #include "fplbase/preprocessor.h"
@@ -42,6 +43,11 @@ void Shader::Init(ShaderHandle program, ShaderHandle vs, ShaderHandle ps,
   uniform_camera_pos_ = invalid;
   uniform_time_ = invalid;
   uniform_bone_transforms_ = invalid;
+  uniform_bone_dual_quaternions_ = invalid;
+  uniform_model_view_projection_multiview_ = invalid;
+  uniform_camera_pos_multiview_ = invalid;
+  bone_palette_block_size_ = 0;
+  uses_builtin_blocks_ = false;
   renderer_ = renderer;
 
   // All local defines are enabled by default.
@@ -50,8 +56,9 @@ void Shader::Init(ShaderHandle program, ShaderHandle vs, ShaderHandle ps,
   std::copy(local_defines.begin(), local_defines.end(),
             std::inserter(enabled_defines_, enabled_defines_.begin()));
 
-  // If the shader has already been loaded, it's not dirty.
-  dirty_ = !ValidShaderHandle(vs);
+  // If the shader has already been loaded, it's not dirty. Programs loaded
+  // from a binary have no shader objects, so go by the program.
+  dirty_ = !ValidShaderHandle(program);
 }
 
 // Returns the set of `local_defines` union `global_defines_to_add` less
@@ -72,16 +79,93 @@ static std::set<std::string> CalculateDefines(
   return defines;
 }
 
-void Shader::UpdateGlobalDefines(
+static bool IsIdentifierStart(char c) {
+  return isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+static bool IsIdentifierChar(char c) {
+  return isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Adds the hashes of the identifiers in `source` to `names`, except for the
+// names #defined in it: the global defines are prepended as #defines, and
+// only their uses tell whether the source depends on them.
+static void AddReferencedNames(const std::string &source,
+                               std::vector<uint64_t> *names) {
+  const char *p = source.c_str();
+  bool line_start = true;
+  bool skip_next = false;
+  std::string identifier;
+  while (*p) {
+    const char c = *p;
+    if (c == '\n') {
+      line_start = true;
+      ++p;
+    } else if (c == '#' && line_start) {
+      // Skip the name of a #define.
+      ++p;
+      while (*p == ' ' || *p == '\t') ++p;
+      skip_next = strncmp(p, "define", 6) == 0 && !IsIdentifierChar(p[6]);
+      if (skip_next) p += 6;
+      line_start = false;
+    } else if (IsIdentifierStart(c)) {
+      const char *start = p;
+      while (IsIdentifierChar(*p)) ++p;
+      if (!skip_next) {
+        identifier.assign(start, p);
+        names->push_back(internal::HashAssetName(identifier.c_str()));
+      }
+      skip_next = false;
+      line_start = false;
+    } else {
+      if (c != ' ' && c != '\t') line_start = false;
+      ++p;
+    }
+  }
+}
+
+// The name a define defines: up to a space (before its value) or a '('
+// (before the parameters of a function-like macro).
+static uint64_t DefineNameHash(const std::string &define) {
+  const std::string name = define.substr(0, define.find_first_of(" \t("));
+  return internal::HashAssetName(name.c_str());
+}
+
+bool Shader::DefinesAffectSource(const std::set<std::string> &defines) const {
+  if (referenced_names_.empty()) return true;
+  std::vector<std::string> changed;
+  std::set_symmetric_difference(enabled_defines_.begin(),
+                                enabled_defines_.end(), defines.begin(),
+                                defines.end(), std::back_inserter(changed));
+  for (auto it = changed.begin(); it != changed.end(); ++it) {
+    if (std::binary_search(referenced_names_.begin(), referenced_names_.end(),
+                           DefineNameHash(*it))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Shader::UpdateGlobalDefines(
     const std::vector<std::string> &global_defines_to_add,
     const std::vector<std::string> &global_defines_to_omit) {
   // Do nothing if new defines are the same as the existing defines.
   std::set<std::string> defines = CalculateDefines(
       local_defines_, global_defines_to_add, global_defines_to_omit);
-  if (defines == enabled_defines_) return;
+  if (defines == enabled_defines_) return false;
 
-  // If the new defines differ from the current ones, mark as dirty.
+  // If the new defines differ from the current ones in a way the source
+  // notices, mark as dirty. Shaders that aren't compiled yet will pick up
+  // the new defines anyway.
+  const bool affected =
+      !ValidShaderHandle(program_) || DefinesAffectSource(defines);
   enabled_defines_ = std::move(defines);
+  if (affected) dirty_ = true;
+  return affected;
+}
+
+void Shader::MarkDirty() {
+  ClearShaderIncludeCache();
   dirty_ = true;
 }
 
@@ -96,6 +180,7 @@ bool Shader::ReloadInternal() {
   dirty_ = false;
   if (source_pair == nullptr) return false;
 
+  referenced_names_.swap(source_pair->referenced_names);
   auto sh =
       renderer_->RecompileShader(source_pair->vertex_shader.c_str(),
                                  source_pair->fragment_shader.c_str(), this);
@@ -117,15 +202,41 @@ void Shader::Load() {
   }
 }
 
+bool Shader::PrepareFinalize() {
+  RendererBase *renderer = RendererBase::Get();
+  if (data_ == nullptr || !renderer->SupportsParallelShaderCompile()) {
+    return true;
+  }
+  if (!ValidShaderHandle(pending_link_.program)) {
+    const ShaderSourcePair *source_pair =
+        reinterpret_cast<const ShaderSourcePair *>(data_);
+    pending_link_ = renderer->StartCompileAndLinkShader(
+        source_pair->vertex_shader.c_str(),
+        source_pair->fragment_shader.c_str());
+  }
+  return renderer->IsShaderLinkDone(pending_link_);
+}
+
 bool Shader::Finalize() {
   if (data_ == nullptr) {
     return false;
   }
-  const ShaderSourcePair *source_pair =
-      reinterpret_cast<const ShaderSourcePair *>(data_);
-  auto sh =
-      renderer_->RecompileShader(source_pair->vertex_shader.c_str(),
-                                 source_pair->fragment_shader.c_str(), this);
+  referenced_names_.swap(
+      reinterpret_cast<ShaderSourcePair *>(const_cast<uint8_t *>(data_))
+          ->referenced_names);
+  Shader *sh;
+  if (ValidShaderHandle(pending_link_.program)) {
+    // Started by PrepareFinalize().
+    PendingShaderLink link = pending_link_;
+    pending_link_ = PendingShaderLink();
+    sh = RendererBase::Get()->FinishCompileAndLinkShader(link, this);
+  } else {
+    const ShaderSourcePair *source_pair =
+        reinterpret_cast<const ShaderSourcePair *>(data_);
+    sh = renderer_->RecompileShader(source_pair->vertex_shader.c_str(),
+                                    source_pair->fragment_shader.c_str(),
+                                    this);
+  }
 
   if (sh == nullptr) {
     LogError(kError, "Shader compilation error:\n%s",
@@ -138,7 +249,68 @@ bool Shader::Finalize() {
   return sh != nullptr;
 }
 
+// Whether `variant` was preprocessed with exactly `defines`.
+static bool VariantHasDefines(const shaderdef::ShaderVariant &variant,
+                              const std::set<std::string> &defines) {
+  const auto variant_defines = variant.defines();
+  const size_t num_defines = variant_defines ? variant_defines->size() : 0;
+  if (num_defines != defines.size()) return false;
+  // Both are sorted.
+  auto it = defines.begin();
+  for (size_t i = 0; i < num_defines; ++i, ++it) {
+    if (*it != variant_defines->Get(static_cast<int>(i))->c_str()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Shader::ShaderSourcePair *Shader::LoadVariant() {
+  FileView flatbuf;
+  std::string error_message;
+  if (!flatbuf.Load(filename_.c_str())) {
+    error_message = "Can't load shader file: " + filename_;
+  } else {
+    flatbuffers::Verifier verifier(flatbuf.data(), flatbuf.size());
+    assert(shaderdef::VerifyShaderBuffer(verifier));
+    const auto shaderdef = shaderdef::GetShader(flatbuf.data());
+    const auto variants = shaderdef->variants();
+    if (variants) {
+      for (int i = 0; i < static_cast<int>(variants->size()); ++i) {
+        const auto variant = variants->Get(i);
+        if (!VariantHasDefines(*variant, enabled_defines_)) continue;
+        ShaderSourcePair *source_pair = new ShaderSourcePair();
+        source_pair->vertex_shader = variant->vertex_shader()->str();
+        source_pair->fragment_shader = variant->fragment_shader()->str();
+        return source_pair;
+      }
+    } else if (enabled_defines_.empty()) {
+      ShaderSourcePair *source_pair = new ShaderSourcePair();
+      source_pair->vertex_shader = shaderdef->vertex_shader()->str();
+      source_pair->fragment_shader = shaderdef->fragment_shader()->str();
+      return source_pair;
+    }
+    error_message = "No variant of " + filename_ + " with the defines:";
+    for (auto it = enabled_defines_.begin(); it != enabled_defines_.end();
+         ++it) {
+      error_message += " " + *it;
+    }
+  }
+  LogError(kError, "%s", error_message.c_str());
+  renderer_->set_last_error(error_message.c_str());
+  return nullptr;
+}
+
 Shader::ShaderSourcePair *Shader::LoadSourceFile() {
+  // Variants preprocessed by shader_pipeline only need picking.
+  static const char kShaderDefExtension[] = ".fplshader";
+  const size_t extension_length = sizeof(kShaderDefExtension) - 1;
+  if (filename_.size() > extension_length &&
+      filename_.compare(filename_.size() - extension_length, extension_length,
+                        kShaderDefExtension) == 0) {
+    return LoadVariant();
+  }
+
   std::string filename = std::string(filename_) + ".glslv";
   std::string error_message;
 
@@ -148,6 +320,11 @@ Shader::ShaderSourcePair *Shader::LoadSourceFile() {
     filename = std::string(filename_) + ".glslf";
     if (LoadFileWithDirectives(filename.c_str(), &source_pair->fragment_shader,
                                enabled_defines_, &error_message)) {
+      std::vector<uint64_t> &names = source_pair->referenced_names;
+      AddReferencedNames(source_pair->vertex_shader, &names);
+      AddReferencedNames(source_pair->fragment_shader, &names);
+      std::sort(names.begin(), names.end());
+      names.erase(std::unique(names.begin(), names.end()), names.end());
       return source_pair;
     }
   }
@@ -173,12 +350,11 @@ static void BreakAndLogError(const char *cstr) {
 }
 
 Shader *Shader::LoadFromShaderDef(const char *filename) {
-  std::string flatbuf;
-  if (LoadFile(filename, &flatbuf)) {
-    flatbuffers::Verifier verifier(
-        reinterpret_cast<const uint8_t *>(flatbuf.c_str()), flatbuf.length());
+  FileView flatbuf;
+  if (flatbuf.Load(filename)) {
+    flatbuffers::Verifier verifier(flatbuf.data(), flatbuf.size());
     assert(shaderdef::VerifyShaderBuffer(verifier));
-    auto shaderdef = shaderdef::GetShader(flatbuf.c_str());
+    auto shaderdef = shaderdef::GetShader(flatbuf.data());
     auto shader = RendererBase::Get()->CompileAndLinkShader(
         shaderdef->vertex_shader()->c_str(),
         shaderdef->fragment_shader()->c_str());
@@ -14,6 +14,7 @@
 
 #include "precompiled.h"
 
+#include "fplbase/bone_palette_buffer.h"
 #include "fplbase/internal/type_conversions_gl.h"
 #include "fplbase/preprocessor.h"
 #include "fplbase/renderer.h"
@@ -27,6 +28,9 @@
 
 namespace fplbase {
 
+const unsigned int Shader::kFrameUniformsBinding;
+const unsigned int Shader::kObjectUniformsBinding;
+
 //static
 ShaderImpl *Shader::CreateShaderImpl() { return nullptr; }
 
@@ -46,22 +50,59 @@ void Shader::Clear() {
     GL_CALL(glDeleteProgram(GlShaderHandle(program_)));
     program_ = InvalidShaderHandle();
   }
+  ClearPendingLoad();
+}
+
+void Shader::ClearPendingLoad() {
+  // A compile PrepareFinalize() started, which Finalize() never finished.
+  if (ValidShaderHandle(pending_link_.program)) {
+    if (ValidShaderHandle(pending_link_.vs)) {
+      GL_CALL(glDeleteShader(GlShaderHandle(pending_link_.vs)));
+    }
+    if (ValidShaderHandle(pending_link_.ps)) {
+      GL_CALL(glDeleteShader(GlShaderHandle(pending_link_.ps)));
+    }
+    GL_CALL(glDeleteProgram(GlShaderHandle(pending_link_.program)));
+    pending_link_ = PendingShaderLink();
+  }
   if (data_ != nullptr) {
     delete reinterpret_cast<const ShaderSourcePair *>(data_);
     data_ = nullptr;
   }
 }
 
-UniformHandle Shader::FindUniform(const char *uniform_name) {
-  auto program = GlShaderHandle(program_);
-  GL_CALL(glUseProgram(program));
-  return UniformHandleFromGl(glGetUniformLocation(program, uniform_name));
+UniformHandle Shader::FindUniform(const AssetId &uniform_id) {
+  GL_CALL(glUseProgram(GlShaderHandle(program_)));
+  return LookUpUniform(uniform_id);
+}
+
+UniformHandle Shader::LookUpUniform(const AssetId &uniform_id) {
+  for (auto it = uniform_cache_.begin(); it != uniform_cache_.end(); ++it) {
+    if (it->hash == uniform_id.hash()) return it->handle;
+  }
+  const CachedUniform uniform = {
+      uniform_id.hash(),
+      UniformHandleFromGl(
+          glGetUniformLocation(GlShaderHandle(program_), uniform_id.name()))};
+  uniform_cache_.push_back(uniform);
+  return uniform.handle;
 }
 
 void Shader::SetUniform(UniformHandle uniform_loc, const float *value,
                         size_t num_components) {
   // clang-format off
   auto uniform_loc_gl = GlUniformHandle(uniform_loc);
+  // Renderer::SetShader() can no longer trust its copy of a built-in uniform
+  // that's set by hand.
+  if (uniform_loc_gl == GlUniformHandle(uniform_model_view_projection_) ||
+      uniform_loc_gl == GlUniformHandle(uniform_model_) ||
+      uniform_loc_gl == GlUniformHandle(uniform_color_) ||
+      uniform_loc_gl == GlUniformHandle(uniform_light_pos_) ||
+      uniform_loc_gl == GlUniformHandle(uniform_camera_pos_) ||
+      uniform_loc_gl == GlUniformHandle(uniform_time_)) {
+    builtin_values_.known = 0;
+  }
+  RendererBase::CountRenderWork(&RenderCounters::uniform_uploads);
   switch (num_components) {
     case 1: GL_CALL(glUniform1f(uniform_loc_gl, *value)); break;
     case 2: GL_CALL(glUniform2fv(uniform_loc_gl, 1, value)); break;
@@ -75,6 +116,9 @@ void Shader::SetUniform(UniformHandle uniform_loc, const float *value,
 
 void Shader::InitializeUniforms() {
   auto program = GlShaderHandle(program_);
+  builtin_values_.known = 0;
+  // Locations may change with every link.
+  uniform_cache_.clear();
 
   // Look up variables that are standard, but still optionally present in a
   // shader.
@@ -97,6 +141,51 @@ void Shader::InitializeUniforms() {
   uniform_bone_transforms_ =
       UniformHandleFromGl(glGetUniformLocation(program, "bone_transforms"));
 
+  // Or two vec4's per bone, the real and dual parts of a dual quaternion.
+  uniform_bone_dual_quaternions_ = UniformHandleFromGl(
+      glGetUniformLocation(program, "bone_dual_quaternions"));
+
+  // Per-view arrays of the above, for single pass stereo rendering into a
+  // multiview render target.
+  uniform_model_view_projection_multiview_ = UniformHandleFromGl(
+      glGetUniformLocation(program, "model_view_projection_multiview"));
+  uniform_camera_pos_multiview_ = UniformHandleFromGl(
+      glGetUniformLocation(program, "camera_pos_multiview"));
+
+  // Alternatively, a uniform block of bone transforms, read from a
+  // BonePaletteBuffer. See BonePaletteBuffer for its layout.
+  bone_palette_block_size_ = 0;
+  if (RendererBase::Get()->feature_level() >= kFeatureLevel30) {
+    const GLuint block = glGetUniformBlockIndex(program, "BonePalette");
+    if (block != GL_INVALID_INDEX) {
+      GL_CALL(
+          glUniformBlockBinding(program, block, BonePaletteBuffer::kBinding));
+      GLint size = 0;
+      GL_CALL(glGetActiveUniformBlockiv(program, block,
+                                        GL_UNIFORM_BLOCK_DATA_SIZE, &size));
+      bone_palette_block_size_ = size;
+    }
+  }
+
+  // Or the built-ins above, from the renderer's uniform buffer. See
+  // BuiltinUniformBuffer.
+  uses_builtin_blocks_ = false;
+  if (RendererBase::Get()->feature_level() >= kFeatureLevel30) {
+    const GLuint frame_block = glGetUniformBlockIndex(program, "FrameUniforms");
+    if (frame_block != GL_INVALID_INDEX) {
+      GL_CALL(glUniformBlockBinding(program, frame_block,
+                                    kFrameUniformsBinding));
+      uses_builtin_blocks_ = true;
+    }
+    const GLuint object_block =
+        glGetUniformBlockIndex(program, "ObjectUniforms");
+    if (object_block != GL_INVALID_INDEX) {
+      GL_CALL(glUniformBlockBinding(program, object_block,
+                                    kObjectUniformsBinding));
+      uses_builtin_blocks_ = true;
+    }
+  }
+
   // Set up the uniforms the shader uses for texture access.
   char texture_unit_name[] = "texture_unit_#####";
   for (int i = 0; i < kMaxTexturesPerShader; i++) {
@@ -0,0 +1,275 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/skinning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "fplbase/mesh.h"
+
+namespace fplbase {
+
+// Instances claimed by a thread at a time. Small enough to balance meshes
+// with very different bone counts, large enough to keep the atomic cold.
+static const size_t kInstancesPerJob = 4;
+
+void MultiplyAffineTransforms(const mathfu::AffineTransform *a,
+                              const mathfu::AffineTransform *b, size_t count,
+                              mathfu::AffineTransform *out) {
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = MultiplyAffineTransforms(a[i], b[i]);
+  }
+}
+
+void AffineToDualQuaternion(const mathfu::AffineTransform &transform,
+                            mathfu::vec4_packed *dual_quaternion) {
+  const mathfu::vec4 &r0 = transform.GetColumn(0);
+  const mathfu::vec4 &r1 = transform.GetColumn(1);
+  const mathfu::vec4 &r2 = transform.GetColumn(2);
+
+  // Rotation to quaternion, from the largest of w, x, y and z, so the square
+  // root is well conditioned.
+  mathfu::vec4 q;
+  const float trace = r0.x + r1.y + r2.z;
+  if (trace > 0.0f) {
+    const float s = 0.5f / sqrtf(trace + 1.0f);
+    q = mathfu::vec4((r2.y - r1.z) * s, (r0.z - r2.x) * s, (r1.x - r0.y) * s,
+                     0.25f / s);
+  } else if (r0.x > r1.y && r0.x > r2.z) {
+    const float s = 0.5f / sqrtf(1.0f + r0.x - r1.y - r2.z);
+    q = mathfu::vec4(0.25f / s, (r0.y + r1.x) * s, (r0.z + r2.x) * s,
+                     (r2.y - r1.z) * s);
+  } else if (r1.y > r2.z) {
+    const float s = 0.5f / sqrtf(1.0f + r1.y - r0.x - r2.z);
+    q = mathfu::vec4((r0.y + r1.x) * s, 0.25f / s, (r1.z + r2.y) * s,
+                     (r0.z - r2.x) * s);
+  } else {
+    const float s = 0.5f / sqrtf(1.0f + r2.z - r0.x - r1.y);
+    q = mathfu::vec4((r0.z + r2.x) * s, (r1.z + r2.y) * s, 0.25f / s,
+                     (r1.x - r0.y) * s);
+  }
+  q /= q.Length();
+
+  // The dual part is half the translation times the rotation.
+  const mathfu::vec3 t(r0.w, r1.w, r2.w);
+  const mathfu::vec3 v = q.xyz();
+  const mathfu::vec3 dual =
+      0.5f * (q.w * t + mathfu::vec3::CrossProduct(t, v));
+  dual_quaternion[0] = mathfu::vec4_packed(q);
+  dual_quaternion[1] = mathfu::vec4_packed(
+      mathfu::vec4(dual, -0.5f * mathfu::vec3::DotProduct(t, v)));
+}
+
+// The affine transform of `rotation`, a unit quaternion, then `scale`, then
+// `translation`, one row per vec4.
+static mathfu::AffineTransform LocalTransform(const mathfu::vec4 &rotation,
+                                              const mathfu::vec4 &translation,
+                                              const mathfu::vec4 &scale) {
+  const float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+  mathfu::AffineTransform transform;
+  transform.GetColumn(0) =
+      mathfu::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y - w * z),
+                   2.0f * (x * z + w * y), 0.0f) * scale +
+      mathfu::vec4(0.0f, 0.0f, 0.0f, translation.x);
+  transform.GetColumn(1) =
+      mathfu::vec4(2.0f * (x * y + w * z), 1.0f - 2.0f * (x * x + z * z),
+                   2.0f * (y * z - w * x), 0.0f) * scale +
+      mathfu::vec4(0.0f, 0.0f, 0.0f, translation.y);
+  transform.GetColumn(2) =
+      mathfu::vec4(2.0f * (x * z - w * y), 2.0f * (y * z + w * x),
+                   1.0f - 2.0f * (x * x + y * y), 0.0f) * scale +
+      mathfu::vec4(0.0f, 0.0f, 0.0f, translation.z);
+  return transform;
+}
+
+void EvaluatePose(const uint8_t *bone_parents, size_t num_bones,
+                  const LocalPose *poses, size_t num_poses,
+                  mathfu::AffineTransform *bone_transforms) {
+  float total_weight = 0.0f;
+  for (size_t p = 0; p < num_poses; ++p) total_weight += poses[p].weight;
+  const float normalize = total_weight > 0.0f ? 1.0f / total_weight : 0.0f;
+  const mathfu::vec4 kNoScale(1.0f, 1.0f, 1.0f, 0.0f);
+
+  for (size_t i = 0; i < num_bones; ++i) {
+    const mathfu::vec4 first(poses[0].rotations[i]);
+    mathfu::vec4 rotation(mathfu::kZeros4f);
+    mathfu::vec4 translation(mathfu::kZeros4f);
+    mathfu::vec4 scale(mathfu::kZeros4f);
+    for (size_t p = 0; p < num_poses; ++p) {
+      const LocalPose &pose = poses[p];
+      const float weight = pose.weight * normalize;
+      const mathfu::vec4 q(pose.rotations[i]);
+      // q and -q are the same rotation.
+      rotation += q * (mathfu::vec4::DotProduct(q, first) < 0.0f ? -weight
+                                                                 : weight);
+      translation += mathfu::vec4(mathfu::vec3(pose.translations[i]), 0.0f) *
+                     weight;
+      scale += (pose.scales
+                    ? mathfu::vec4(mathfu::vec3(pose.scales[i]), 0.0f)
+                    : kNoScale) *
+               weight;
+    }
+    const float length = rotation.Length();
+    rotation = length > 0.0f ? rotation / length
+                             : mathfu::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    const mathfu::AffineTransform local =
+        LocalTransform(rotation, translation, scale);
+    const size_t parent = bone_parents[i];
+    bone_transforms[i] =
+        parent < i ? MultiplyAffineTransforms(bone_transforms[parent], local)
+                   : local;
+  }
+}
+
+struct SkinningJobsImpl {
+  SkinningJobsImpl()
+      : job(nullptr),
+        count(0),
+        next(0),
+        generation(0),
+        busy(0),
+        quit(false) {}
+
+  // Claim and process jobs from the current batch until none are left.
+  void Work(const std::function<void(size_t)> *batch, size_t batch_count) {
+    for (;;) {
+      const size_t begin = next.fetch_add(kInstancesPerJob);
+      if (begin >= batch_count) return;
+      const size_t end = std::min(begin + kInstancesPerJob, batch_count);
+      for (size_t i = begin; i < end; ++i) (*batch)(i);
+    }
+  }
+
+  void WorkerThread() {
+    std::unique_lock<std::mutex> lock(mutex);
+    size_t seen = generation;
+    for (;;) {
+      work_ready.wait(lock, [&] { return quit || generation != seen; });
+      if (quit) return;
+      seen = generation;
+      const std::function<void(size_t)> *batch = job;
+      const size_t batch_count = count;
+      ++busy;
+      lock.unlock();
+      Work(batch, batch_count);
+      lock.lock();
+      if (--busy == 0) work_done.notify_all();
+    }
+  }
+
+  // Call `batch` for each of `batch_count` instances, on all threads, and
+  // return once they're done.
+  void Run(const std::function<void(size_t)> &batch, size_t batch_count) {
+    // Waking the workers isn't worth it for a single job.
+    if (threads.empty() || batch_count <= kInstancesPerJob) {
+      for (size_t i = 0; i < batch_count; ++i) batch(i);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &batch;
+      count = batch_count;
+      next = 0;
+      ++generation;
+    }
+    work_ready.notify_all();
+    Work(&batch, batch_count);
+
+    // Every job has been claimed, so once no worker is busy they're all done.
+    // Workers that haven't woken yet will find no jobs left.
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [&] { return busy == 0; });
+    job = nullptr;
+    count = 0;
+  }
+
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable work_ready;
+  std::condition_variable work_done;
+
+  // The current batch. Written under `mutex`, before `generation` changes.
+  const std::function<void(size_t)> *job;
+  size_t count;
+  std::atomic<size_t> next;
+  size_t generation;
+  // Number of worker threads inside Work().
+  int busy;
+  bool quit;
+};
+
+SkinningJobs::SkinningJobs(int num_threads) : impl_(new SkinningJobsImpl) {
+  if (num_threads < 0) {
+    num_threads =
+        std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0);
+  }
+  impl_->threads.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    impl_->threads.push_back(
+        std::thread(&SkinningJobsImpl::WorkerThread, impl_));
+  }
+}
+
+SkinningJobs::~SkinningJobs() {
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->quit = true;
+  }
+  impl_->work_ready.notify_all();
+  for (auto it = impl_->threads.begin(); it != impl_->threads.end(); ++it) {
+    it->join();
+  }
+  delete impl_;
+}
+
+void SkinningJobs::GatherShaderTransforms(const SkinningInstance *instances,
+                                          size_t count) {
+  impl_->Run(
+      [instances](size_t i) {
+        instances[i].mesh->GatherShaderTransforms(
+            instances[i].bone_transforms, instances[i].shader_transforms);
+      },
+      count);
+}
+
+void SkinningJobs::EvaluatePoses(const PoseInstance *instances, size_t count) {
+  impl_->Run(
+      [instances](size_t i) {
+        const PoseInstance &instance = instances[i];
+        const Mesh &mesh = *instance.mesh;
+        if (!instance.num_poses) return;
+        EvaluatePose(mesh.bone_parents(), mesh.num_bones(), instance.poses,
+                     instance.num_poses, instance.bone_transforms);
+        if (instance.shader_transforms) {
+          mesh.GatherShaderTransforms(instance.bone_transforms,
+                                      instance.shader_transforms);
+        }
+      },
+      count);
+}
+
+int SkinningJobs::num_threads() const {
+  return static_cast<int>(impl_->threads.size());
+}
+
+}  // namespace fplbase
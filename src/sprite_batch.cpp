@@ -0,0 +1,197 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "fplbase/sprite_batch.h"
+#include "fplbase/render_utils.h"
+#include "fplbase/renderer.h"
+#include "fplbase/texture.h"
+#include "fplbase/texture_atlas.h"
+#include "fplbase/vertex_format.h"
+
+using mathfu::vec2;
+using mathfu::vec2i;
+using mathfu::vec3;
+using mathfu::vec4;
+
+namespace fplbase {
+
+// Each vertex is [x, y, z] [u, v].
+typedef VertexFormat<kPosition3f, kTexCoord2f> SpriteFormat;
+static const int kFloatsPerVertex = SpriteFormat::kStride / sizeof(float);
+
+// The most vertices 16 bit indices can address.
+static const size_t kMaxBatchVertices = 1 << 16;
+
+namespace internal {
+
+const uint16_t kQuadAlongXIndexData[kQuadAlongXIndices] = {0, 1, 2, 1, 3, 2};
+
+const uint16_t kNinePatchAlongXIndexData[kNinePatchAlongXIndices] = {
+    0, 2, 1,  1,  2, 3,  2, 4,  3,  3,  4,  5,  4,  6,  5,  5,  6,  7,
+    1, 3, 8,  8,  3, 9,  3, 5,  9,  9,  5,  10, 5,  7,  10, 10, 7,  11,
+    8, 9, 12, 12, 9, 13, 9, 10, 13, 13, 10, 14, 10, 11, 14, 14, 11, 15,
+};
+
+void QuadAlongXVertices(const vec3 &bottom_left, const vec3 &top_right,
+                        const vec2 &tex_bottom_left, const vec2 &tex_top_right,
+                        float *vertices) {
+  // clang-format off
+  const float quad[] = {
+      bottom_left.x,     bottom_left.y,     bottom_left.z,
+      tex_bottom_left.x, tex_bottom_left.y,
+      bottom_left.x,     top_right.y,       top_right.z,
+      tex_bottom_left.x, tex_top_right.y,
+      top_right.x,       bottom_left.y,     bottom_left.z,
+      tex_top_right.x,   tex_bottom_left.y,
+      top_right.x,       top_right.y,       top_right.z,
+      tex_top_right.x,   tex_top_right.y};
+  // clang-format on
+  memcpy(vertices, quad, sizeof(quad));
+}
+
+void NinePatchAlongXVertices(const vec3 &bottom_left, const vec3 &top_right,
+                             const vec2 &texture_size, const vec4 &patch_info,
+                             const vec4 &tex_bounds, float *vertices) {
+  vec2 max = vec2::Max(bottom_left.xy(), top_right.xy());
+  vec2 min = vec2::Min(bottom_left.xy(), top_right.xy());
+  vec2 p0 = texture_size * patch_info.xy() + min;
+  vec2 p1 = max - texture_size * (mathfu::kOnes2f - patch_info.zw());
+
+  // Check if the 9 patch edges are not overwrapping.
+  // In that case, adjust 9 patch geometry locations not to overwrap.
+  if (p0.x > p1.x) {
+    p0.x = p1.x = (min.x + max.x) / 2;
+  }
+  if (p0.y > p1.y) {
+    p0.y = p1.y = (min.y + max.y) / 2;
+  }
+
+  // Texture coordinates of the patch edges, within `tex_bounds`.
+  const float u[] = {tex_bounds.x, tex_bounds.x + patch_info.x * tex_bounds.z,
+                     tex_bounds.x + patch_info.z * tex_bounds.z,
+                     tex_bounds.x + tex_bounds.z};
+  const float v[] = {tex_bounds.y, tex_bounds.y + patch_info.y * tex_bounds.w,
+                     tex_bounds.y + patch_info.w * tex_bounds.w,
+                     tex_bounds.y + tex_bounds.w};
+  const float x[] = {min.x, p0.x, p1.x, max.x};
+  const float y[] = {min.y, p0.y, p1.y, max.y};
+  const float z = bottom_left.z;
+
+  // The (column, row) of each vertex, in the order kNinePatchAlongXIndexData
+  // refers to them.
+  static const int kCorners[kNinePatchAlongXVertices][2] = {
+      {0, 0}, {1, 0}, {0, 1}, {1, 1}, {0, 2}, {1, 2}, {0, 3}, {1, 3},
+      {2, 0}, {2, 1}, {2, 2}, {2, 3}, {3, 0}, {3, 1}, {3, 2}, {3, 3},
+  };
+  for (int i = 0; i < kNinePatchAlongXVertices; ++i) {
+    const int column = kCorners[i][0];
+    const int row = kCorners[i][1];
+    *vertices++ = x[column];
+    *vertices++ = y[row];
+    *vertices++ = z;
+    *vertices++ = u[column];
+    *vertices++ = v[row];
+  }
+}
+
+}  // namespace internal
+
+SpriteBatch::SpriteBatch(Renderer *renderer)
+    : renderer_(renderer),
+      texture_(nullptr),
+      shader_(nullptr),
+      num_draw_calls_(0) {}
+
+float *SpriteBatch::Reserve(const Texture *texture, const Shader *shader,
+                            size_t num_vertices, const uint16_t *indices,
+                            size_t num_indices) {
+  size_t base = vertices_.size() / kFloatsPerVertex;
+  if (texture != texture_ || shader != shader_ ||
+      base + num_vertices > kMaxBatchVertices) {
+    Flush();
+    texture_ = texture;
+    shader_ = shader;
+    base = 0;
+  }
+  for (size_t i = 0; i < num_indices; ++i) {
+    indices_.push_back(static_cast<uint16_t>(base + indices[i]));
+  }
+  vertices_.resize((base + num_vertices) * kFloatsPerVertex);
+  return &vertices_[base * kFloatsPerVertex];
+}
+
+void SpriteBatch::AddQuad(const Texture *texture, const Shader *shader,
+                          const vec3 &bottom_left, const vec3 &top_right,
+                          const vec2 &tex_bottom_left,
+                          const vec2 &tex_top_right) {
+  float *vertices = Reserve(texture, shader, internal::kQuadAlongXVertices,
+                            internal::kQuadAlongXIndexData,
+                            internal::kQuadAlongXIndices);
+  internal::QuadAlongXVertices(bottom_left, top_right, tex_bottom_left,
+                               tex_top_right, vertices);
+}
+
+bool SpriteBatch::AddQuad(TextureAtlas &atlas, const AssetId &subtexture,
+                          const Shader *shader, const vec3 &bottom_left,
+                          const vec3 &top_right) {
+  const vec4 *bounds = atlas.GetBounds(subtexture);
+  if (!bounds) return false;
+  AddQuad(atlas.atlas_texture(), shader, bottom_left, top_right, bounds->xy(),
+          bounds->xy() + bounds->zw());
+  return true;
+}
+
+void SpriteBatch::AddNinePatch(const Texture *texture, const Shader *shader,
+                               const vec3 &bottom_left, const vec3 &top_right,
+                               const vec2i &texture_size,
+                               const vec4 &patch_info) {
+  float *vertices = Reserve(texture, shader, internal::kNinePatchAlongXVertices,
+                            internal::kNinePatchAlongXIndexData,
+                            internal::kNinePatchAlongXIndices);
+  internal::NinePatchAlongXVertices(bottom_left, top_right, vec2(texture_size),
+                                    patch_info, vec4(0.0f, 0.0f, 1.0f, 1.0f),
+                                    vertices);
+}
+
+bool SpriteBatch::AddNinePatch(TextureAtlas &atlas, const AssetId &subtexture,
+                               const Shader *shader, const vec3 &bottom_left,
+                               const vec3 &top_right, const vec4 &patch_info) {
+  const vec4 *bounds = atlas.GetBounds(subtexture);
+  const Texture *texture = atlas.atlas_texture();
+  if (!bounds || !texture) return false;
+  // The patches are sized by the subtexture's pixels, not the atlas'.
+  const vec2 texture_size = vec2(texture->size()) * bounds->zw();
+  float *vertices = Reserve(texture, shader, internal::kNinePatchAlongXVertices,
+                            internal::kNinePatchAlongXIndexData,
+                            internal::kNinePatchAlongXIndices);
+  internal::NinePatchAlongXVertices(bottom_left, top_right, texture_size,
+                                    patch_info, *bounds, vertices);
+  return true;
+}
+
+void SpriteBatch::Flush() {
+  if (indices_.empty()) return;
+  if (texture_) texture_->Set(0, renderer_);
+  renderer_->SetShader(shader_);
+  RenderArray(Mesh::kTriangles, static_cast<int>(indices_.size()),
+              SpriteFormat(), SpriteFormat::kStride, vertices_.data(),
+              indices_.data());
+  ++num_draw_calls_;
+  vertices_.clear();
+  indices_.clear();
+}
+
+}  // namespace fplbase
@@ -0,0 +1,70 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "streaming_buffer_gl.h"
+
+#include "fplbase/glplatform.h"
+#include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/renderer.h"
+
+namespace fplbase {
+
+const size_t StreamingBuffer::kCapacity;
+
+StreamingBuffer::StreamingBuffer(unsigned int target)
+    : target_(target), buffer_(InvalidBufferHandle()), cursor_(kCapacity) {}
+
+bool StreamingBuffer::Write(const void *data, size_t size, size_t alignment,
+                            size_t *offset) {
+  if (!data || size == 0 || size > kCapacity) return false;
+
+  GLuint buffer = GlBufferHandle(buffer_);
+  if (!buffer) {
+    GL_CALL(glGenBuffers(1, &buffer));
+    buffer_ = BufferHandleFromGl(buffer);
+  }
+  GL_CALL(glBindBuffer(target_, buffer));
+
+  size_t start = (cursor_ + alignment - 1) / alignment * alignment;
+  if (start + size > kCapacity) {
+    // Orphan the storage the GPU may still be drawing from.
+    GL_CALL(glBufferData(target_, kCapacity, nullptr, GL_STREAM_DRAW));
+    start = 0;
+  }
+  // Nothing in flight uses this range, so there's nothing to synchronize
+  // with.
+  void *dest = glMapBufferRange(
+      target_, start, size,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+          GL_MAP_UNSYNCHRONIZED_BIT);
+  if (!dest) {
+    GL_CALL(glBindBuffer(target_, 0));
+    return false;
+  }
+  memcpy(dest, data, size);
+  RendererBase::CountRenderWork(&RenderCounters::buffer_upload_bytes, size);
+  // The contents are undefined if unmapping fails (e.g. after a mode switch),
+  // so start afresh on the next write.
+  if (glUnmapBuffer(target_) != GL_TRUE) {
+    cursor_ = kCapacity;
+    GL_CALL(glBindBuffer(target_, 0));
+    return false;
+  }
+  cursor_ = start + size;
+  *offset = start;
+  return true;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,63 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_STREAMING_BUFFER_GL_H
+#define FPLBASE_STREAMING_BUFFER_GL_H
+
+#include <stddef.h>
+
+#include "fplbase/handles.h"
+
+namespace fplbase {
+
+/// @brief A buffer object that per-draw vertex or index data is streamed
+/// through on ES3 / GL3, instead of drawing from client memory.
+///
+/// Each Write() appends to the buffer, mapped unsynchronized so the driver
+/// never waits for the GPU. The GPU may still be reading earlier ranges, so
+/// they're never overwritten: once the buffer is full it's orphaned with
+/// glBufferData(), which gives it fresh storage while draws in flight keep
+/// the old, and writing starts again from the beginning.
+///
+/// The buffer belongs to the GL context, and is freed along with it.
+class StreamingBuffer {
+ public:
+  /// @param target GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER.
+  explicit StreamingBuffer(unsigned int target);
+
+  /// @brief Copy `size` bytes from `data` into the buffer, and leave it bound
+  /// to its target.
+  /// @param alignment The copy starts at a multiple of this many bytes.
+  /// @param offset Set to the byte offset of the copy in the buffer, to pass
+  ///        to GL in place of a client memory pointer.
+  /// @return Returns false if the data should be drawn from client memory
+  /// instead, because it's too large or the buffer couldn't be mapped.
+  bool Write(const void *data, size_t size, size_t alignment, size_t *offset);
+
+  /// @brief The buffer object. Invalid until the first Write().
+  BufferHandle buffer() const { return buffer_; }
+
+  /// @brief Size of the buffer. Writes larger than this draw from client
+  /// memory.
+  static const size_t kCapacity = 1024 * 1024;
+
+ private:
+  unsigned int target_;
+  BufferHandle buffer_;
+  size_t cursor_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_STREAMING_BUFFER_GL_H
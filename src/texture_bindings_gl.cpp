@@ -0,0 +1,95 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "texture_bindings_gl.h"
+
+#include "fplbase/glplatform.h"
+#include "fplbase/renderer.h"
+#include "renderer_impl_gl.h"
+
+namespace fplbase {
+
+const size_t TextureBindings::kMaxUnits;
+
+TextureBindings::TextureBindings() { Invalidate(); }
+
+void TextureBindings::Bind(size_t unit, unsigned int target,
+                           unsigned int texture) {
+  if (unit >= kMaxUnits) {
+    RendererBase::CountRenderWork(&RenderCounters::texture_binds);
+    GL_CALL(glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(unit)));
+    GL_CALL(glBindTexture(target, texture));
+    active_unit_ = kMaxUnits;
+    return;
+  }
+  if (active_unit_ != unit) {
+    GL_CALL(glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(unit)));
+    active_unit_ = unit;
+  }
+  // Binding one target of a unit leaves its other targets bound, so only a
+  // match on both says nothing needs doing. A mismatch may rebind what's
+  // already bound, which is merely redundant.
+  Binding &binding = units_[unit];
+  if (binding.target == target && binding.texture == texture) return;
+  RendererBase::CountRenderWork(&RenderCounters::texture_binds);
+  GL_CALL(glBindTexture(target, texture));
+  binding.target = target;
+  binding.texture = texture;
+}
+
+void TextureBindings::Forget(unsigned int texture) {
+  for (size_t i = 0; i < kMaxUnits; ++i) {
+    if (units_[i].texture == texture) units_[i].target = 0;
+  }
+}
+
+void TextureBindings::Invalidate() {
+  for (size_t i = 0; i < kMaxUnits; ++i) {
+    units_[i].target = 0;
+    units_[i].texture = 0;
+  }
+  active_unit_ = kMaxUnits;
+}
+
+// static
+TextureBindings *TextureBindings::Get() {
+  // The bindings are those of the renderer's context.
+  if (RendererBase::shared_context_thread()) return nullptr;
+  RendererBase *base = RendererBase::Get();
+  return base->impl() ? &base->impl()->texture_bindings : nullptr;
+}
+
+// static
+void TextureBindings::BindTexture(size_t unit, unsigned int target,
+                                  unsigned int texture) {
+  TextureBindings *bindings = Get();
+  if (bindings) {
+    bindings->Bind(unit, target, texture);
+  } else {
+    RendererBase::CountRenderWork(&RenderCounters::texture_binds);
+    GL_CALL(glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(unit)));
+    GL_CALL(glBindTexture(target, texture));
+  }
+}
+
+// static
+void TextureBindings::DeleteTexture(unsigned int texture) {
+  GLuint id = texture;
+  GL_CALL(glDeleteTextures(1, &id));
+  TextureBindings *bindings = Get();
+  if (bindings) bindings->Forget(texture);
+}
+
+}  // namespace fplbase
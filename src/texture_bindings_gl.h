@@ -0,0 +1,68 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_TEXTURE_BINDINGS_GL_H
+#define FPLBASE_TEXTURE_BINDINGS_GL_H
+
+#include <stddef.h>
+
+namespace fplbase {
+
+/// @brief The texture bound to each texture unit, and the active unit, as far
+/// as fplbase knows, so that binding what's already bound costs no GL calls.
+///
+/// Everything in fplbase that binds or deletes textures goes through here.
+/// Code that binds textures with GL directly must call Invalidate() (through
+/// Renderer::InvalidateTextureBindings()) before fplbase binds again.
+class TextureBindings {
+ public:
+  TextureBindings();
+
+  /// @brief Bind `texture` to `target` on texture unit `unit`, and leave
+  /// `unit` active, skipping whichever GL calls are redundant.
+  void Bind(size_t unit, unsigned int target, unsigned int texture);
+
+  /// @brief Record that `texture` has been deleted, which unbinds it.
+  void Forget(unsigned int texture);
+
+  /// @brief Forget everything, so the next Bind() of each unit calls GL.
+  void Invalidate();
+
+  /// @brief The renderer's bindings, or nullptr before there's a renderer.
+  static TextureBindings *Get();
+
+  /// @brief Bind() with the renderer's bindings, or straight to GL if there
+  /// are none.
+  static void BindTexture(size_t unit, unsigned int target,
+                          unsigned int texture);
+
+  /// @brief Delete `texture` and Forget() it.
+  static void DeleteTexture(unsigned int texture);
+
+  /// @brief Units past this are bound without a cache.
+  static const size_t kMaxUnits = 32;
+
+ private:
+  struct Binding {
+    unsigned int target;  // 0 when unknown.
+    unsigned int texture;
+  };
+
+  Binding units_[kMaxUnits];
+  size_t active_unit_;  // kMaxUnits when unknown.
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_TEXTURE_BINDINGS_GL_H
@@ -14,7 +14,11 @@
 
 #include "precompiled.h"
 
+#include "fplbase/allocator.h"
 #include "fplbase/flatbuffer_utils.h"
+#include "fplbase/internal/etc2_encoder.h"
+#include "fplbase/internal/lz4_block.h"
+#include "fplbase/internal/pixel_conversion.h"
 #include "fplbase/renderer.h"
 #include "fplbase/texture.h"
 #include "fplbase/texture_atlas.h"
@@ -41,6 +45,30 @@
 #define STBI_ONLY_JPEG
 #define STBI_ONLY_PNG
 #define STBI_ONLY_TGA
+// Route STB's allocations through SetAllocator(), since the images it decodes
+// are returned from the Unpack functions.
+#define STBI_MALLOC(size) \
+  fplbase::AllocateMemory(size, fplbase::kAllocationTextureStaging)
+#define STBI_REALLOC_SIZED(ptr, old_size, new_size) \
+  fplbase::StbReallocate(ptr, old_size, new_size)
+#define STBI_FREE(ptr) \
+  fplbase::FreeMemory(ptr, fplbase::kAllocationTextureStaging)
+#define STBIR_MALLOC(size, context) \
+  ((void)(context),                  \
+   fplbase::AllocateMemory(size, fplbase::kAllocationTransient))
+#define STBIR_FREE(ptr, context) \
+  ((void)(context), fplbase::FreeMemory(ptr, fplbase::kAllocationTransient))
+namespace fplbase {
+// The allocator has no realloc, so this always copies. Like realloc(), leaves
+// `ptr` alone if it fails.
+static void *StbReallocate(void *ptr, size_t old_size, size_t new_size) {
+  void *new_ptr = AllocateMemory(new_size, kAllocationTextureStaging);
+  if (!new_ptr) return nullptr;
+  if (ptr) memcpy(new_ptr, ptr, std::min(old_size, new_size));
+  FreeMemory(ptr, kAllocationTextureStaging);
+  return new_ptr;
+}
+}  // namespace fplbase
 #include "stb_image.h"
 #include "stb_image_resize.h"
 
@@ -64,17 +92,13 @@ static bool HasWebpHeader(const std::string &file) {
          file.substr(8, 4) == "WEBP";
 }
 
-static void MultiplyRgbByAlpha(uint8_t *rgba_ptr, int width, int height) {
-  const int num_pixels = width * height;
-  for (int i = 0; i < num_pixels; ++i, rgba_ptr += 4) {
-    const auto alpha = static_cast<uint16_t>(rgba_ptr[3]);
-    rgba_ptr[0] = static_cast<uint8_t>(
-        (static_cast<uint16_t>(rgba_ptr[0]) * alpha) / 255);
-    rgba_ptr[1] = static_cast<uint8_t>(
-        (static_cast<uint16_t>(rgba_ptr[1]) * alpha) / 255);
-    rgba_ptr[2] = static_cast<uint8_t>(
-        (static_cast<uint16_t>(rgba_ptr[2]) * alpha) / 255);
-  }
+// The size of mip `mip` of an image of `size`, with the 6 faces of a cube map
+// stacked in a 1x6 column like they are at level 0.
+static vec2i MipSize(const vec2i &size, int mip, TextureFlags flags) {
+  const int num_faces = flags & kTextureFlagsIsCubeMap ? 6 : 1;
+  const vec2i face = size / vec2i(1, num_faces);
+  return vec2i(std::max(face.x >> mip, 1),
+               std::max(face.y >> mip, 1) * num_faces);
 }
 
 Texture::Texture(const char *filename, TextureFormat format, TextureFlags flags)
@@ -88,11 +112,17 @@ Texture::Texture(const char *filename, TextureFormat format, TextureFlags flags)
       target_(TextureTargetFromFlags(flags)),
       desired_(format),
       flags_(flags),
-      is_external_(false) {}
+      is_external_(false),
+      num_mips_(1),
+      resident_mip_(0),
+      requested_mip_(0),
+      mip_format_(0),
+      cube_map_faces_pending_(0),
+      gpu_memory_size_(0) {}
 
 Texture::~Texture() {
   if (data_) {
-    free(const_cast<uint8_t *>(data_));
+    FreeMemory(const_cast<uint8_t *>(data_), kAllocationTextureStaging);
     data_ = nullptr;
   }
 
@@ -101,8 +131,37 @@ Texture::~Texture() {
 }
 
 void Texture::Load() {
+  const double start = GetTimeInSeconds();
   data_ = LoadAndUnpackTexture(filename_.c_str(), scale_, flags_, &size_,
-                               &texture_format_);
+                               &texture_format_, &load_stats_);
+  num_mips_ = 1;
+  resident_mip_ = 0;
+  if (data_ && ShouldEncodeETC2(texture_format_)) {
+    // The KTX data then goes through the same path as a loaded KTX file.
+    uint8_t *ktx = EncodeETC2(data_, size_, texture_format_, flags_);
+    if (ktx) {
+      FreeMemory(const_cast<uint8_t *>(data_), kAllocationTextureStaging);
+      data_ = ktx;
+      texture_format_ = kFormatKTX;
+    }
+  }
+  if (data_ && ShouldBuildMipChain()) BuildMipChain();
+  if (data_) ConvertDataToUploadFormat();
+  if (data_ && texture_format_ == kFormatKTX) {
+    // UnpackKTX() leaves out the finer mips of streamed textures, which it
+    // shows by shrinking the header to the first mip it kept.
+    const auto &header = *reinterpret_cast<const KTXHeader *>(data_);
+    const int full = std::max(size_.x, size_.y);
+    const int kept = std::max(header.width, header.height);
+    while ((full >> resident_mip_) > std::max(kept, 1)) ++resident_mip_;
+    num_mips_ = resident_mip_ + std::max(static_cast<int>(header.mip_levels), 1);
+    mip_format_ = header.internal_format;
+  }
+  load_stats_.decode_time = GetTimeInSeconds() - start - load_stats_.io_time;
+  if (data_ && BytesPerPixel(texture_format_)) {
+    load_stats_.decoded_bytes = static_cast<size_t>(size_.x) * size_.y *
+                                BytesPerPixel(texture_format_);
+  }
   SetOriginalSizeIfNotYetSet(size_);
 }
 
@@ -110,22 +169,216 @@ void Texture::LoadFromMemory(const uint8_t *data, const vec2i &size,
                              TextureFormat texture_format) {
   size_ = size;
   SetOriginalSizeIfNotYetSet(size_);
-  texture_format_ = texture_format;
-  id_ = CreateTexture(data, size_, texture_format_, desired_, flags_, impl_);
+  uint8_t *ktx = ShouldEncodeETC2(texture_format)
+                     ? EncodeETC2(data, size_, texture_format, flags_)
+                     : nullptr;
+  texture_format_ = ktx ? kFormatKTX : texture_format;
+  id_ = CreateTexture(ktx ? ktx : data, size_, texture_format_, desired_,
+                      flags_, impl_);
+  if (ktx) {
+    mip_format_ = reinterpret_cast<const KTXHeader *>(ktx)->internal_format;
+    FreeMemory(ktx, kAllocationTextureStaging);
+  }
   is_external_ = false;
+  UpdateGpuMemorySize();
 }
 
-bool Texture::Finalize() {
-  if (data_) {
-    id_ = CreateTexture(data_, size_, texture_format_, desired_, flags_, impl_);
-    is_external_ = false;
-    free(const_cast<uint8_t *>(data_));
-    data_ = nullptr;
+TextureFormat Texture::UploadFormat(TextureFormat desired,
+                                    TextureFormat texture_format) {
+  if (desired == kFormatAuto) {
+    return IsCompressed(texture_format)
+               ? texture_format
+               : HasAlpha(texture_format) ? kFormat5551 : kFormat565;
+  }
+  return desired == kFormatNative ? texture_format : desired;
+}
+
+size_t Texture::BytesPerPixel(TextureFormat format) {
+  switch (format) {
+    case kFormat8888:
+      return 4;
+    case kFormat888:
+      return 3;
+    case kFormat5551:
+    case kFormat565:
+    case kFormatLuminanceAlpha:
+      return 2;
+    case kFormatLuminance:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+void Texture::ConvertDataToUploadFormat() {
+  // Same fallback as CreateTexture(): some devices can't generate mipmaps
+  // for 16bpp textures, so those keep the 888/8888 data, unless Load()
+  // already built the mips.
+  const TextureFormat format = UploadFormat(desired_, texture_format_);
+  const bool to_5551 = format == kFormat5551 && texture_format_ == kFormat8888;
+  const bool to_565 = format == kFormat565 && texture_format_ == kFormat888;
+  if (!(to_5551 || to_565)) return;
+  if (num_mips_ == 1 && !MipmapGeneration16bppSupported()) return;
+
+  // Cube maps are stored as 6 faces in a single 1x6 image, so size_ already
+  // covers all of them. The mip levels follow each other the same way.
+  size_t num_pixels = 0;
+  for (int mip = 0; mip < num_mips_; ++mip) {
+    num_pixels += static_cast<size_t>(MipSize(size_, mip, flags_).x) *
+                  MipSize(size_, mip, flags_).y;
+  }
+  uint16_t *buffer16 = static_cast<uint16_t *>(
+      AllocateMemory(num_pixels * sizeof(uint16_t), kAllocationTextureStaging));
+  if (!buffer16) return;
+  if (to_5551) {
+    fplbase::Convert8888To5551(data_, buffer16, num_pixels);
+  } else {
+    fplbase::Convert888To565(data_, buffer16, num_pixels);
+  }
+  FreeMemory(const_cast<uint8_t *>(data_), kAllocationTextureStaging);
+  data_ = reinterpret_cast<const uint8_t *>(buffer16);
+  texture_format_ = format;
+}
+
+void Texture::UpdateGpuMemorySize() {
+  const size_t size = CalculateMemorySize();
+  RendererBase::TrackGpuMemory(kGpuMemoryTextures, gpu_memory_size_, size);
+  gpu_memory_size_ = size;
+}
+
+bool Texture::ShouldEncodeETC2(TextureFormat texture_format) const {
+  if (!(flags_ & kTextureFlagsCompressOnLoad) ||
+      (flags_ & (kTextureFlagsIsCubeMap | kTextureFlagsStreamMips)) ||
+      (texture_format != kFormat888 && texture_format != kFormat8888) ||
+      (desired_ != kFormatAuto && desired_ != kFormatKTX) || size_.x < 4 ||
+      size_.y < 4) {
+    return false;
+  }
+  // EncodeETC2() stops the mips at the 4x4 block size, which only immutable
+  // storage makes a complete texture of.
+  auto renderer = RendererBase::Get();
+  return renderer->SupportsTextureFormat(kFormatKTX) &&
+         (!(flags_ & kTextureFlagsUseMipMaps) ||
+          renderer->SupportsTextureStorage());
+}
+
+bool Texture::ShouldBuildMipChain() const {
+  if (!(flags_ & kTextureFlagsUseMipMaps) || !BytesPerPixel(texture_format_)) {
+    return false;
   }
+  if (flags_ & kTextureFlagsBuildMipsOnLoad) return true;
+  // Rather than falling back to 32bpp for glGenerateMipmap(), keep these in
+  // 16bpp with mips from here.
+  const TextureFormat format = UploadFormat(desired_, texture_format_);
+  const bool is_16bpp = format == kFormat5551 || format == kFormat565;
+  return is_16bpp && format != texture_format_ &&
+         !MipmapGeneration16bppSupported();
+}
+
+void Texture::BuildMipChain() {
+  const int bytes_per_pixel = static_cast<int>(BytesPerPixel(texture_format_));
+  const int num_faces = flags_ & kTextureFlagsIsCubeMap ? 6 : 1;
+  const vec2i face_size = size_ / vec2i(1, num_faces);
+  if (face_size.x <= 0 || face_size.y <= 0) return;
+  int num_mips = 1;
+  while ((std::max(face_size.x, face_size.y) >> num_mips) > 0) ++num_mips;
+
+  size_t chain_size = 0;
+  for (int mip = 0; mip < num_mips; ++mip) {
+    const vec2i mip_size = MipSize(size_, mip, flags_);
+    chain_size += static_cast<size_t>(mip_size.x) * mip_size.y * bytes_per_pixel;
+  }
+  auto chain = static_cast<uint8_t *>(
+      AllocateMemory(chain_size, kAllocationTextureStaging));
+  if (!chain) return;
+  const size_t base_size =
+      static_cast<size_t>(size_.x) * size_.y * bytes_per_pixel;
+  memcpy(chain, data_, base_size);
+
+  // Filter each face on its own, so the faces don't bleed into each other.
+  uint8_t *src = chain;
+  for (int mip = 1; mip < num_mips; ++mip) {
+    const vec2i src_face = MipSize(size_, mip - 1, flags_) / vec2i(1, num_faces);
+    const vec2i dest_face = MipSize(size_, mip, flags_) / vec2i(1, num_faces);
+    const size_t src_face_bytes =
+        static_cast<size_t>(src_face.x) * src_face.y * bytes_per_pixel;
+    const size_t dest_face_bytes =
+        static_cast<size_t>(dest_face.x) * dest_face.y * bytes_per_pixel;
+    uint8_t *dest = src + src_face_bytes * num_faces;
+    for (int face = 0; face < num_faces; ++face) {
+      fplbase::DownsampleBox2x2(src + face * src_face_bytes, src_face.x,
+                                src_face.y, bytes_per_pixel,
+                                dest + face * dest_face_bytes);
+    }
+    src = dest;
+  }
+  FreeMemory(const_cast<uint8_t *>(data_), kAllocationTextureStaging);
+  data_ = chain;
+  num_mips_ = num_mips;
+}
+
+void Texture::CreateFromData() {
+  // Only Load() of an uncompressed image builds more than 1 mip in data_.
+  const int data_mips = BytesPerPixel(texture_format_) ? num_mips_ : 1;
+  id_ = CreateTexture(data_, size_, texture_format_, desired_, flags_, impl_,
+                      resident_mip_, data_mips);
+  is_external_ = false;
+  FreeMemory(const_cast<uint8_t *>(data_), kAllocationTextureStaging);
+  data_ = nullptr;
+}
+
+bool Texture::Upload() {
+  if (!data_) return false;
+  CreateFromData();
+  return true;
+}
+
+bool Texture::Finalize() {
+  // Unless the upload thread already created the texture.
+  if (data_) CreateFromData();
+  UpdateGpuMemorySize();
   CallFinalizeCallback();
   return ValidTextureHandle(id_);
 }
 
+size_t Texture::CalculateMemorySize() const {
+  if (!ValidTextureHandle(id_) || is_external_) return 0;
+  // Pick the upload format the same way CreateTexture() does.
+  const TextureFormat format = UploadFormat(desired_, texture_format_);
+  size_t bits_per_pixel = 32;
+  // clang-format off
+  switch (format) {
+    case kFormat888:            bits_per_pixel = 24; break;
+    case kFormat5551:           bits_per_pixel = 16; break;
+    case kFormat565:            bits_per_pixel = 16; break;
+    case kFormatLuminanceAlpha: bits_per_pixel = 16; break;
+    case kFormatLuminance:      bits_per_pixel = 8;  break;
+    case kFormatASTC:           bits_per_pixel = 8;  break;  // 4x4 blocks.
+    case kFormatPKM:            bits_per_pixel = 4;  break;
+    case kFormatKTX:            bits_per_pixel = 4;  break;  // Assumes ETC.
+    default:                                         break;
+  }
+  // clang-format on
+  // ETC2 with EAC alpha has a second block per 4x4 pixels.
+  if (format == kFormatKTX && mip_format_ == kKTXFormatETC2RGBA8) {
+    bits_per_pixel = 8;
+  }
+  size_t size = static_cast<size_t>(size_.x) * size_.y * bits_per_pixel / 8;
+  // A full mip chain adds a third.
+  if (flags_ & kTextureFlagsUseMipMaps) size += size / 3;
+  // Each mip not streamed in yet is a quarter of what's above it.
+  return size >> (2 * resident_mip_);
+}
+
+void Texture::RequestMipForScreenSize(const vec2i &screen_size) {
+  int mip = 0;
+  while (mip + 1 < num_mips_ && (size_.x >> (mip + 1)) >= screen_size.x &&
+         (size_.y >> (mip + 1)) >= screen_size.y) {
+    ++mip;
+  }
+  requested_mip_ = mip;
+}
+
 void Texture::Set(size_t unit) { Set(unit, nullptr); }
 
 void Texture::Set(size_t unit, Renderer *) const {
@@ -135,21 +388,22 @@ void Texture::Set(size_t unit, Renderer *) const {
 void Texture::Set(size_t unit) const { const_cast<Texture *>(this)->Set(unit); }
 
 uint16_t *Texture::Convert8888To5551(const uint8_t *buffer, const vec2i &size) {
-  auto buffer16 = new uint16_t[size.x * size.y];
-  for (int i = 0; i < size.x * size.y; i++) {
-    auto c = &buffer[i * 4];
-    buffer16[i] = ((c[0] >> 3) << 11) | ((c[1] >> 3) << 6) |
-                  ((c[2] >> 3) << 1) | ((c[3] >> 7) << 0);
-  }
+  auto buffer16 = static_cast<uint16_t *>(AllocateMemory(
+      static_cast<size_t>(size.x) * size.y * sizeof(uint16_t),
+      kAllocationTransient));
+  if (!buffer16) return nullptr;
+  fplbase::Convert8888To5551(buffer, buffer16,
+                             static_cast<size_t>(size.x) * size.y);
   return buffer16;
 }
 
 uint16_t *Texture::Convert888To565(const uint8_t *buffer, const vec2i &size) {
-  auto buffer16 = new uint16_t[size.x * size.y];
-  for (int i = 0; i < size.x * size.y; i++) {
-    auto c = &buffer[i * 3];
-    buffer16[i] = ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | ((c[2] >> 3) << 0);
-  }
+  auto buffer16 = static_cast<uint16_t *>(AllocateMemory(
+      static_cast<size_t>(size.x) * size.y * sizeof(uint16_t),
+      kAllocationTransient));
+  if (!buffer16) return nullptr;
+  fplbase::Convert888To565(buffer, buffer16,
+                           static_cast<size_t>(size.x) * size.y);
   return buffer16;
 }
 
@@ -157,6 +411,7 @@ void Texture::SetTextureId(TextureTarget target, TextureHandle id) {
   target_ = target;
   id_ = id;
   is_external_ = true;
+  UpdateGpuMemorySize();
 }
 
 uint8_t *Texture::UnpackTGA(const void *tga_buf, TextureFlags flags,
@@ -174,6 +429,49 @@ uint8_t *Texture::UnpackTGA(const void *tga_buf, TextureFlags flags,
                      texture_format);
 }
 
+// Sets up the scaling and output of `config`, once its input is known.
+static void SetWebPDecodeOptions(const vec2 &scale, TextureFlags flags,
+                                 WebPDecoderConfig *config) {
+  // Apply scaling.
+  if (scale.x != 1.0f || scale.y != 1.0f) {
+    config->options.use_scaling = true;
+    config->options.scaled_width =
+        static_cast<int>(config->input.width * scale.x);
+    config->options.scaled_height =
+        static_cast<int>(config->input.height * scale.y);
+  }
+
+  if (config->input.has_alpha) {
+    if (flags & kTextureFlagsPremultiplyAlpha) {
+      config->output.colorspace = MODE_rgbA;
+    } else {
+      config->output.colorspace = MODE_RGBA;
+    }
+  }
+}
+
+// Makes `config` decode into a buffer from AllocateMemory(), so it's freed
+// like the other formats, rather than one webp allocated itself.
+static uint8_t *AllocateWebPOutput(WebPDecoderConfig *config) {
+  const int width = config->options.use_scaling ? config->options.scaled_width
+                                                : config->input.width;
+  const int height = config->options.use_scaling
+                         ? config->options.scaled_height
+                         : config->input.height;
+  const int bpp = config->input.has_alpha ? 4 : 3;
+  const size_t image_size = static_cast<size_t>(width) * height * bpp;
+  auto image = static_cast<uint8_t *>(
+      AllocateMemory(image_size, kAllocationTextureStaging));
+  if (!image) return nullptr;
+  config->output.is_external_memory = 1;
+  config->output.width = width;
+  config->output.height = height;
+  config->output.u.RGBA.rgba = image;
+  config->output.u.RGBA.stride = width * bpp;
+  config->output.u.RGBA.size = image_size;
+  return image;
+}
+
 uint8_t *Texture::UnpackWebP(const void *webp_buf, size_t size,
                              const vec2 &scale, TextureFlags flags,
                              vec2i *dimensions, TextureFormat *texture_format) {
@@ -183,28 +481,38 @@ uint8_t *Texture::UnpackWebP(const void *webp_buf, size_t size,
                                 &config.input);
   if (status != VP8_STATUS_OK) return nullptr;
 
-  // Apply scaling.
-  if (scale.x != 1.0f || scale.y != 1.0f) {
-    config.options.use_scaling = true;
-    config.options.scaled_width =
-        static_cast<int>(config.input.width * scale.x);
-    config.options.scaled_height =
-        static_cast<int>(config.input.height * scale.y);
-  }
-
-  if (config.input.has_alpha) {
-    if (flags & kTextureFlagsPremultiplyAlpha) {
-      config.output.colorspace = MODE_rgbA;
-    } else {
-      config.output.colorspace = MODE_RGBA;
-    }
-  }
+  SetWebPDecodeOptions(scale, flags, &config);
+  uint8_t *image = AllocateWebPOutput(&config);
+  if (!image) return nullptr;
   status = WebPDecode(static_cast<const uint8_t *>(webp_buf), size, &config);
-  if (status != VP8_STATUS_OK) return nullptr;
+  if (status != VP8_STATUS_OK) {
+    FreeMemory(image, kAllocationTextureStaging);
+    return nullptr;
+  }
 
   *dimensions = vec2i(config.output.width, config.output.height);
   *texture_format = config.input.has_alpha != 0 ? kFormat8888 : kFormat888;
-  return config.output.private_memory;  // Allocated with malloc by webp.
+  return image;
+}
+
+// Copies an ASTC or PKM file, which may hold a mip chain, and ends it with a
+// zeroed header so CreateTexture() can count the levels.
+template <typename Header>
+static uint8_t *CopyMipChain(const void *file_buf, size_t size) {
+  size_t chain_size =
+      MipChainSize<Header>(static_cast<const uint8_t *>(file_buf), size);
+  // Not even one complete level, keep loading it like before.
+  if (chain_size == 0) chain_size = size;
+  // TODO(wvo): This in theory doesn't need to be copied, but it keeps the API
+  // uniform, and should not affect load times.
+  // We use AllocateMemory to ensure that all unpacked texture formats can be
+  // freed in the same way (see also other Unpack* functions).
+  auto buf = reinterpret_cast<uint8_t *>(
+      AllocateMemory(chain_size + sizeof(Header), kAllocationTextureStaging));
+  if (!buf) return nullptr;
+  memcpy(buf, file_buf, chain_size);
+  memset(buf + chain_size, 0, sizeof(Header));
+  return buf;
 }
 
 uint8_t *Texture::UnpackASTC(const void *astc_buf, size_t size,
@@ -229,14 +537,7 @@ uint8_t *Texture::UnpackASTC(const void *astc_buf, size_t size,
 
   *dimensions = vec2i(xsize, ysize);
   *texture_format = kFormatASTC;
-
-  // TODO(wvo): This in theory doesn't need to be copied, but it keeps the API
-  // uniform, and should not affect load times.
-  // We use malloc to ensure that all unpacked texture formats can be freed
-  // in the same way (see also other Unpack* functions).
-  auto buf = reinterpret_cast<uint8_t *>(malloc(size));
-  memcpy(buf, astc_buf, size);
-  return buf;
+  return CopyMipChain<ASTCHeader>(astc_buf, size);
 }
 
 uint8_t *Texture::UnpackPKM(const void *file_buf, size_t size,
@@ -253,14 +554,52 @@ uint8_t *Texture::UnpackPKM(const void *file_buf, size_t size,
   auto ysize = (header.height[0] << 8) | header.height[1];
   *dimensions = vec2i(xsize, ysize);
   *texture_format = kFormatPKM;
+  return CopyMipChain<PKMHeader>(file_buf, size);
+}
 
-  // TODO(wvo): This in theory doesn't need to be copied, but it keeps the API
-  // uniform, and should not affect load times.
-  // We use malloc to ensure that all unpacked texture formats can be freed
-  // in the same way (see also other Unpack* functions).
-  auto buf = reinterpret_cast<uint8_t *>(malloc(size));
-  memcpy(buf, file_buf, size);
-  return buf;
+// Streamed textures initially get all mips of at most this many pixels across.
+static const uint32_t kStreamedMipTailSize = 128;
+
+// Finds mip `level` in a KTX file, laid out the way CreateTexture() reads it:
+// each level's size, followed by its data.
+static bool FindKTXMip(const uint8_t *file_buf, size_t size, int level,
+                       const uint8_t **mip, size_t *mip_size) {
+  if (size < sizeof(KTXHeader)) return false;
+  const auto &header = *reinterpret_cast<const KTXHeader *>(file_buf);
+  size_t offset = sizeof(KTXHeader) + header.keyvalue_data;
+  for (int i = 0; i < static_cast<int>(header.mip_levels); ++i) {
+    if (offset > size || size - offset < sizeof(int32_t)) return false;
+    uint32_t image_size;
+    memcpy(&image_size, file_buf + offset, sizeof(image_size));
+    offset += sizeof(int32_t);
+    if (image_size > size - offset) return false;
+    if (i == level) {
+      *mip = file_buf + offset;
+      *mip_size = image_size;
+      return true;
+    }
+    offset += image_size;
+  }
+  return false;
+}
+
+// The first mip level to upload of a KTX file loaded with `flags`. Finer
+// levels are streamed in later, see kTextureFlagsStreamMips.
+static int FirstUploadedMip(const KTXHeader &header, TextureFlags flags) {
+  // Only compressed (type 0) 2D mip chains, which UploadMip() handles.
+  if (!(flags & kTextureFlagsStreamMips) ||
+      !(flags & kTextureFlagsUseMipMaps) || (flags & kTextureFlagsIsCubeMap) ||
+      header.type != 0 ||
+      RendererBase::Get()->feature_level() < kFeatureLevel30) {
+    return 0;
+  }
+  int mip = 0;
+  while (mip + 1 < static_cast<int>(header.mip_levels) &&
+         std::max(header.width >> mip, header.height >> mip) >
+             kStreamedMipTailSize) {
+    ++mip;
+  }
+  return mip;
 }
 
 uint8_t *Texture::UnpackKTX(const void *file_buf, size_t size,
@@ -283,18 +622,147 @@ uint8_t *Texture::UnpackKTX(const void *file_buf, size_t size,
     return nullptr;
   }
 
-  *dimensions = vec2i(header.width, header.height);
+  // Six separate faces are reported as a 1x6 strip, like the other cube
+  // maps, which CreateTexture() divides back into faces.
+  *dimensions = vec2i(header.width, header.height * header.faces);
   *texture_format = kFormatKTX;
 
+  // For streamed textures, keep just the mip tail, behind a header shrunk to
+  // the first mip kept. Texture::Load() tells the mip level from that.
+  const int first_mip = FirstUploadedMip(header, flags);
+  const uint8_t *tail = nullptr;
+  size_t first_size = 0;
+  if (first_mip > 0 &&
+      FindKTXMip(static_cast<const uint8_t *>(file_buf), size, first_mip,
+                 &tail, &first_size)) {
+    tail -= sizeof(int32_t);
+    const size_t tail_size =
+        size - (tail - static_cast<const uint8_t *>(file_buf));
+    auto buf = reinterpret_cast<uint8_t *>(AllocateMemory(
+        sizeof(KTXHeader) + tail_size, kAllocationTextureStaging));
+    if (!buf) return nullptr;
+    KTXHeader tail_header = header;
+    tail_header.width = std::max(header.width >> first_mip, 1u);
+    tail_header.height = std::max(header.height >> first_mip, 1u);
+    tail_header.mip_levels = header.mip_levels - first_mip;
+    tail_header.keyvalue_data = 0;
+    memcpy(buf, &tail_header, sizeof(KTXHeader));
+    memcpy(buf + sizeof(KTXHeader), tail, tail_size);
+    return buf;
+  }
+
   // TODO(wvo): This in theory doesn't need to be copied, but it keeps the API
   // uniform, and should not affect load times.
-  // We use malloc to ensure that all unpacked texture formats can be freed
-  // in the same way (see also other Unpack* functions).
-  auto buf = reinterpret_cast<uint8_t *>(malloc(size));
+  // We use AllocateMemory to ensure that all unpacked texture formats can be
+  // freed in the same way (see also other Unpack* functions).
+  auto buf = reinterpret_cast<uint8_t *>(
+      AllocateMemory(size, kAllocationTextureStaging));
+  if (!buf) return nullptr;
   memcpy(buf, file_buf, size);
   return buf;
 }
 
+uint8_t *Texture::UnpackKTXZ(const void *file_buf, size_t size,
+                             TextureFlags flags, vec2i *dimensions,
+                             TextureFormat *texture_format) {
+  if (size < sizeof(KTXZHeader)) return nullptr;
+  auto &header = *reinterpret_cast<const KTXZHeader *>(file_buf);
+  if (memcmp(header.magic, "KTXZ", sizeof(header.magic)) != 0 ||
+      header.compressed_size > size - sizeof(KTXZHeader) ||
+      header.ktx_size < sizeof(KTXHeader)) {
+    return nullptr;
+  }
+  auto ktx = reinterpret_cast<uint8_t *>(
+      AllocateMemory(header.ktx_size, kAllocationTransient));
+  if (!ktx) return nullptr;
+  const bool ok = DecompressLz4Block(
+      static_cast<const uint8_t *>(file_buf) + sizeof(KTXZHeader),
+      header.compressed_size, ktx, header.ktx_size);
+  // TextureMipStream reads mips straight from the file, so can't stream them
+  // out of a compressed one.
+  const TextureFlags ktx_flags =
+      static_cast<TextureFlags>(flags & ~kTextureFlagsStreamMips);
+  auto buf = ok ? UnpackKTX(ktx, header.ktx_size, ktx_flags, dimensions,
+                            texture_format)
+                : nullptr;
+  FreeMemory(ktx, kAllocationTransient);
+  return buf;
+}
+
+uint8_t *Texture::EncodeETC2(const uint8_t *data, const vec2i &size,
+                             TextureFormat texture_format, TextureFlags flags) {
+  if ((texture_format != kFormat888 && texture_format != kFormat8888) ||
+      size.x < 4 || size.y < 4) {
+    return nullptr;
+  }
+  const int channels = static_cast<int>(BytesPerPixel(texture_format));
+  const size_t num_pixels = static_cast<size_t>(size.x) * size.y;
+  // Opaque images don't need the alpha blocks, which double the size.
+  bool alpha = false;
+  for (size_t i = 3; channels == 4 && !alpha && i < num_pixels * 4; i += 4) {
+    alpha = data[i] != 255;
+  }
+
+  // Mips smaller than a block can't be uploaded, see CreateTexture().
+  int num_mips = 1;
+  while ((flags & kTextureFlagsUseMipMaps) &&
+         (std::min(size.x, size.y) >> num_mips) >= 4) {
+    ++num_mips;
+  }
+  size_t ktx_size = sizeof(KTXHeader);
+  for (int mip = 0; mip < num_mips; ++mip) {
+    ktx_size += sizeof(int32_t) +
+                Etc2ImageSize(size.x >> mip, size.y >> mip, alpha);
+  }
+  auto ktx = static_cast<uint8_t *>(
+      AllocateMemory(ktx_size, kAllocationTextureStaging));
+  if (!ktx) return nullptr;
+  // Each mip is filtered from the one before, in place after the first.
+  uint8_t *scratch = nullptr;
+  if (num_mips > 1) {
+    scratch = static_cast<uint8_t *>(AllocateMemory(
+        num_pixels / 4 * channels, kAllocationTransient));
+    if (!scratch) {
+      FreeMemory(ktx, kAllocationTextureStaging);
+      return nullptr;
+    }
+  }
+
+  KTXHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.id, "\xABKTX 11\xBB\r\n\x1A\n", sizeof(header.id));
+  header.endian = 0x04030201;
+  header.type_size = 1;
+  header.internal_format = alpha ? kKTXFormatETC2RGBA8 : kKTXFormatETC2RGB8;
+  header.base_internal_format = alpha ? kKTXBaseFormatRGBA : kKTXBaseFormatRGB;
+  header.width = size.x;
+  header.height = size.y;
+  header.faces = 1;
+  header.mip_levels = num_mips;
+  memcpy(ktx, &header, sizeof(header));
+
+  uint8_t *dest = ktx + sizeof(KTXHeader);
+  const uint8_t *level = data;
+  vec2i level_size = size;
+  for (int mip = 0; mip < num_mips; ++mip) {
+    if (mip > 0) {
+      fplbase::DownsampleBox2x2(level, level_size.x, level_size.y, channels,
+                                scratch);
+      level = scratch;
+      level_size /= 2;
+    }
+    const int32_t image_size = static_cast<int32_t>(
+        Etc2ImageSize(level_size.x, level_size.y, alpha));
+    memcpy(dest, &image_size, sizeof(image_size));
+    dest += sizeof(image_size);
+    fplbase::EncodeEtc2Image(level, level_size.x, level_size.y, channels,
+                             alpha, dest);
+    dest += image_size;
+  }
+  if (scratch) FreeMemory(scratch, kAllocationTransient);
+  return ktx;
+}
+
 uint8_t *Texture::UnpackImage(const void *img_buf, size_t size,
                               const vec2 &scale, TextureFlags flags,
                               vec2i *dimensions,
@@ -310,23 +778,39 @@ uint8_t *Texture::UnpackImage(const void *img_buf, size_t size,
                                 &channels, 0);
 
   if (image && (scale.x != 1.0f || scale.y != 1.0f)) {
-    // Scale the image.
-    int32_t new_width = static_cast<int32_t>(width * scale.x);
-    int32_t new_height = static_cast<int32_t>(height * scale.y);
-    uint8_t *new_image =
-        static_cast<uint8_t *>(malloc(new_width * new_height * channels));
-    stbir_resize_uint8(image, width, height, 0, new_image, new_width,
-                       new_height, 0, channels);
-    stbi_image_free(image);
-    image = new_image;
-    width = new_width;
-    height = new_height;
+    const int32_t new_width =
+        std::max(static_cast<int32_t>(width * scale.x), 1);
+    const int32_t new_height =
+        std::max(static_cast<int32_t>(height * scale.y), 1);
+    // Halve in place while that doesn't overshoot, which is much cheaper than
+    // the general resampler and needs no second buffer. For the usual power
+    // of two texture scales, that's all there is to do.
+    while (width / 2 >= new_width && height / 2 >= new_height) {
+      DownsampleBox2x2(image, width, height, channels, image);
+      width /= 2;
+      height /= 2;
+    }
+    if (width != new_width || height != new_height) {
+      uint8_t *new_image = static_cast<uint8_t *>(
+          AllocateMemory(static_cast<size_t>(new_width) * new_height * channels,
+                         kAllocationTextureStaging));
+      if (!new_image) {
+        stbi_image_free(image);
+        return nullptr;
+      }
+      stbir_resize_uint8(image, width, height, 0, new_image, new_width,
+                         new_height, 0, channels);
+      stbi_image_free(image);
+      image = new_image;
+      width = new_width;
+      height = new_height;
+    }
   }
 
   *dimensions = vec2i(width, height);
   if (channels == 4) {
     if (flags & kTextureFlagsPremultiplyAlpha) {
-      MultiplyRgbByAlpha(image, width, height);
+      MultiplyRgbByAlpha(image, static_cast<size_t>(width) * height);
     }
 
     *texture_format = kFormat8888;
@@ -340,9 +824,101 @@ uint8_t *Texture::UnpackImage(const void *img_buf, size_t size,
   return image;
 }
 
+// LoadFile(), recording the time and size in `stats` if not null.
+static bool LoadTextureFile(const char *filename, std::string *file,
+                            AssetLoadStats *stats) {
+  if (!stats) return LoadFile(filename, file);
+  const double start = GetTimeInSeconds();
+  const bool ok = LoadFile(filename, file);
+  stats->io_time += GetTimeInSeconds() - start;
+  if (ok) stats->file_bytes += file->length();
+  return ok;
+}
+
+// Like LoadTextureFile(), but maps the file where possible. For compressed
+// formats, which are copied as-is rather than decoded.
+static bool MapTextureFile(const char *filename, FileView *file,
+                           AssetLoadStats *stats) {
+  const double start = stats ? GetTimeInSeconds() : 0;
+  const bool ok = file->Load(filename);
+  if (stats) {
+    stats->io_time += GetTimeInSeconds() - start;
+    if (ok) stats->file_bytes += file->size();
+  }
+  return ok;
+}
+
+// The most bytes of a WebP file read ahead of the decoder.
+static const size_t kWebPChunkSize = 64 * 1024;
+
+// Like UnpackWebP(), but decodes `filename` while it's being read, so the
+// decoding overlaps with the I/O and the whole file is never held at once.
+static uint8_t *LoadAndUnpackWebP(const char *filename, const vec2 &scale,
+                                  TextureFlags flags, vec2i *dimensions,
+                                  TextureFormat *texture_format,
+                                  AssetLoadStats *stats) {
+  WebPDecoderConfig config;
+  memset(&config, 0, sizeof(WebPDecoderConfig));
+  WebPIDecoder *decoder = nullptr;
+  uint8_t *image = nullptr;
+  // The start of the file, until it's enough for WebPGetFeatures().
+  std::string header;
+  size_t file_bytes = 0;
+  double decode_time = 0;
+  VP8StatusCode status = VP8_STATUS_SUSPENDED;
+
+  const double start = GetTimeInSeconds();
+  ReadFileChunks(filename, kWebPChunkSize, [&](const uint8_t *data,
+                                               size_t size) {
+    const double chunk_start = GetTimeInSeconds();
+    file_bytes += size;
+    if (!decoder) {
+      header.append(reinterpret_cast<const char *>(data), size);
+      data = reinterpret_cast<const uint8_t *>(header.data());
+      size = header.size();
+      status = WebPGetFeatures(data, size, &config.input);
+      if (status == VP8_STATUS_NOT_ENOUGH_DATA) {
+        status = VP8_STATUS_SUSPENDED;
+        return true;
+      }
+      if (status != VP8_STATUS_OK) return false;
+
+      SetWebPDecodeOptions(scale, flags, &config);
+      image = AllocateWebPOutput(&config);
+      if (!image) {
+        status = VP8_STATUS_OUT_OF_MEMORY;
+        return false;
+      }
+      decoder = WebPIDecode(nullptr, 0, &config);
+      if (!decoder) {
+        status = VP8_STATUS_OUT_OF_MEMORY;
+        return false;
+      }
+    }
+    // Returns VP8_STATUS_OK once the image is complete.
+    status = WebPIAppend(decoder, data, size);
+    decode_time += GetTimeInSeconds() - chunk_start;
+    return status == VP8_STATUS_SUSPENDED;
+  });
+  if (decoder) WebPIDelete(decoder);
+  if (stats) {
+    stats->io_time += GetTimeInSeconds() - start - decode_time;
+    stats->file_bytes += file_bytes;
+  }
+
+  if (status != VP8_STATUS_OK) {
+    FreeMemory(image, kAllocationTextureStaging);
+    return nullptr;
+  }
+  *dimensions = vec2i(config.output.width, config.output.height);
+  *texture_format = config.input.has_alpha != 0 ? kFormat8888 : kFormat888;
+  return image;
+}
+
 uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
                                        TextureFlags flags, vec2i *dimensions,
-                                       TextureFormat *texture_format) {
+                                       TextureFormat *texture_format,
+                                       AssetLoadStats *stats) {
   std::string ext;
   std::string basename = filename;
   size_t ext_pos = basename.find_last_of(".");
@@ -351,13 +927,14 @@ uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
     basename = basename.substr(0, ext_pos);
   }
 
-  std::string file;
+  // Compressed formats are read straight from a mapping where possible.
+  FileView view;
 
   // Try to load ASTC, but default to WebP if not available or not supported.
   if (ext == "astc") {
     if (RendererBase::Get()->SupportsTextureFormat(kFormatASTC) &&
-        LoadFile(filename, &file)) {
-      auto buf = UnpackASTC(file.c_str(), file.length(), flags, dimensions,
+        MapTextureFile(filename, &view, stats)) {
+      auto buf = UnpackASTC(view.data(), view.size(), flags, dimensions,
                             texture_format);
       if (!buf) LogError(kApplication, "ASTC format problem: %s", filename);
       return buf;
@@ -369,8 +946,8 @@ uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
   // Try to load PKM, but default to WebP if not available or not supported.
   if (ext == "pkm") {
     if (RendererBase::Get()->SupportsTextureFormat(kFormatPKM) &&
-        LoadFile(filename, &file)) {
-      auto buf = UnpackPKM(file.c_str(), file.length(), flags, dimensions,
+        MapTextureFile(filename, &view, stats)) {
+      auto buf = UnpackPKM(view.data(), view.size(), flags, dimensions,
                            texture_format);
       if (!buf) LogError(kApplication, "PKM format problem: %s", filename);
       return buf;
@@ -382,8 +959,8 @@ uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
   // Try to load KTX, but default to WebP if not available or not supported.
   if (ext == "ktx") {
     if (RendererBase::Get()->SupportsTextureFormat(kFormatKTX) &&
-        LoadFile(filename, &file)) {
-      auto buf = UnpackKTX(file.c_str(), file.length(), flags, dimensions,
+        MapTextureFile(filename, &view, stats)) {
+      auto buf = UnpackKTX(view.data(), view.size(), flags, dimensions,
                            texture_format);
       if (!buf) LogError(kApplication, "KTX format problem: %s", filename);
       return buf;
@@ -392,10 +969,35 @@ uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
     }
   }
 
+  // KTXZ is decompressed here on the loader thread, leaving the same upload
+  // as KTX for the main thread.
+  if (ext == "ktxz") {
+    if (RendererBase::Get()->SupportsTextureFormat(kFormatKTX) &&
+        MapTextureFile(filename, &view, stats)) {
+      auto buf = UnpackKTXZ(view.data(), view.size(), flags, dimensions,
+                            texture_format);
+      if (!buf) LogError(kApplication, "KTXZ format problem: %s", filename);
+      return buf;
+    } else {
+      ext = "webp";
+    }
+  }
+
   std::string altfilename = basename;
   if (ext.length()) altfilename += "." + ext;
 
-  if (!LoadFile(altfilename.c_str(), &file)) {
+  if (ext == "webp") {
+    auto buf = LoadAndUnpackWebP(altfilename.c_str(), scale, flags, dimensions,
+                                 texture_format, stats);
+    if (!buf) LogError(kApplication, "WebP format problem: %s", filename);
+    return buf;
+  }
+
+  // Reuse a buffer, rather than allocate one the size of every file.
+  PooledFileBuffer pooled_file;
+  std::string &file = *pooled_file;
+
+  if (!LoadTextureFile(altfilename.c_str(), &file, stats)) {
     LogError(kApplication, "Couldn\'t load: %s", filename);
     return nullptr;
   }
@@ -405,7 +1007,7 @@ uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
                            dimensions, texture_format);
     if (!buf) LogError(kApplication, "Image format problem: %s", filename);
     return buf;
-  } else if (ext == "webp" || HasWebpHeader(file)) {
+  } else if (HasWebpHeader(file)) {
     auto buf = UnpackWebP(file.c_str(), file.length(), scale, flags, dimensions,
                           texture_format);
     if (!buf) LogError(kApplication, "WebP format problem: %s", filename);
@@ -417,6 +1019,89 @@ uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
   }
 }
 
+TextureMipStream::TextureMipStream(Texture *texture, int mip)
+    : AsyncAsset(texture->filename().c_str()),
+      texture_(texture),
+      mip_(mip),
+      size_(0),
+      uploaded_(false) {}
+
+TextureMipStream::~TextureMipStream() {
+  if (data_) {
+    FreeMemory(const_cast<uint8_t *>(data_), kAllocationTextureStaging);
+    data_ = nullptr;
+  }
+}
+
+void TextureMipStream::Load() {
+  // Only reads the file, since the texture may be unloaded meanwhile.
+  const double start = GetTimeInSeconds();
+  FileView file;
+  if (!file.Load(filename_.c_str())) return;
+  const uint8_t *mip = nullptr;
+  if (!FindKTXMip(file.data(), file.size(), mip_, &mip, &size_)) {
+    LogError(kApplication, "KTX file has no mip %d: %s", mip_,
+             filename_.c_str());
+    return;
+  }
+  auto buf = reinterpret_cast<uint8_t *>(
+      AllocateMemory(size_, kAllocationTextureStaging));
+  if (!buf) return;
+  memcpy(buf, mip, size_);
+  data_ = buf;
+  load_stats_.io_time = GetTimeInSeconds() - start;
+  load_stats_.file_bytes = size_;
+}
+
+bool TextureMipStream::Finalize() {
+  if (data_) {
+    uploaded_ = texture_->UploadMip(mip_, data_, size_);
+    FreeMemory(const_cast<uint8_t *>(data_), kAllocationTextureStaging);
+    data_ = nullptr;
+  }
+  CallFinalizeCallback();
+  return uploaded_;
+}
+
+TextureCubeMapFace::TextureCubeMapFace(Texture *texture, int face,
+                                       const char *filename)
+    : AsyncAsset(filename),
+      texture_(texture),
+      face_(face),
+      image_(new Texture(filename, texture->desired_,
+                         static_cast<TextureFlags>(
+                             texture->flags_ & ~(kTextureFlagsIsCubeMap |
+                                                 kTextureFlagsStreamMips)))),
+      uploaded_(false) {
+  ++texture->cube_map_faces_pending_;
+}
+
+TextureCubeMapFace::~TextureCubeMapFace() { delete image_; }
+
+void TextureCubeMapFace::Load() {
+  // Only decodes the face, since the cube map may be unloaded meanwhile.
+  image_->Load();
+  const AssetLoadStats &stats = image_->load_stats();
+  load_stats_.io_time = stats.io_time;
+  load_stats_.decode_time = stats.decode_time;
+  load_stats_.file_bytes = stats.file_bytes;
+  load_stats_.decoded_bytes = stats.decoded_bytes;
+}
+
+bool TextureCubeMapFace::Finalize() {
+  if (image_->data_) {
+    uploaded_ = texture_->UploadCubeMapFace(face_, *image_);
+    FreeMemory(const_cast<uint8_t *>(image_->data_),
+               kAllocationTextureStaging);
+    image_->data_ = nullptr;
+  }
+  if (--texture_->cube_map_faces_pending_ == 0) texture_->FinishCubeMap();
+  CallFinalizeCallback();
+  return uploaded_;
+}
+
+const size_t TextureAtlas::kInvalidSubtextureIndex;
+
 TextureAtlas *TextureAtlas::LoadTextureAtlas(const char *filename,
                                              TextureFormat format,
                                              TextureFlags flags,
@@ -433,12 +1118,10 @@ TextureAtlas *TextureAtlas::LoadTextureAtlas(const char *filename,
     atlas->set_atlas_texture(atlas_texture);
     for (size_t i = 0; i < atlasdef->entries()->Length(); ++i) {
       flatbuffers::uoffset_t index = static_cast<flatbuffers::uoffset_t>(i);
-      atlas->index_map().insert(std::make_pair(
-          atlasdef->entries()->Get(index)->name()->str(), index));
       vec2 size = LoadVec2(atlasdef->entries()->Get(index)->size());
       vec2 location = LoadVec2(atlasdef->entries()->Get(index)->location());
-      atlas->subtexture_bounds().push_back(
-          vec4(location.x, location.y, size.x, size.y));
+      atlas->AddSubtexture(atlasdef->entries()->Get(index)->name()->str(),
+                           vec4(location.x, location.y, size.x, size.y));
     }
     return atlas;
   }
@@ -15,6 +15,7 @@
 #include <cmath>
 #include "precompiled.h"
 
+#include "fplbase/allocator.h"
 #include "fplbase/flatbuffer_utils.h"
 #include "fplbase/internal/type_conversions_gl.h"
 #include "fplbase/renderer.h"
@@ -22,6 +23,7 @@
 #include "fplbase/texture_atlas.h"
 #include "fplbase/utilities.h"
 #include "mathfu/glsl_mappings.h"
+#include "renderer_impl_gl.h"
 #include "texture_atlas_generated.h"
 #include "texture_headers.h"
 #include "webp/decode.h"
@@ -30,6 +32,16 @@ using mathfu::vec2i;
 
 namespace fplbase {
 
+// Returns the ring to stage texture uploads through, or nullptr if pixel
+// unpack buffers aren't available and uploads should read client memory.
+static PixelUnpackRing *UnpackRing() {
+  // The ring's buffers belong to the renderer's context, and thread.
+  if (RendererBase::shared_context_thread()) return nullptr;
+  RendererBase *base = RendererBase::Get();
+  if (base->feature_level() < kFeatureLevel30 || !base->impl()) return nullptr;
+  return &base->impl()->pixel_unpack_ring;
+}
+
 // static
 TextureImpl *Texture::CreateTextureImpl() { return nullptr; }
 
@@ -37,18 +49,18 @@ TextureImpl *Texture::CreateTextureImpl() { return nullptr; }
 void Texture::DestroyTextureImpl(TextureImpl *impl) { (void)impl; }
 
 void Texture::Set(size_t unit, Renderer *) {
-  GL_CALL(glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(unit)));
-  GL_CALL(glBindTexture(GlTextureTarget(target_), GlTextureHandle(id_)));
+  TextureBindings::BindTexture(unit, GlTextureTarget(target_),
+                               GlTextureHandle(id_));
 }
 
 void Texture::Delete() {
   if (ValidTextureHandle(id_)) {
     if (!is_external_) {
-      auto id = GlTextureHandle(id_);
-      GL_CALL(glDeleteTextures(1, &id));
+      TextureBindings::DeleteTexture(GlTextureHandle(id_));
     }
     id_ = InvalidTextureHandle();
   }
+  UpdateGpuMemorySize();
 }
 
 // Returns the block size for compressed texture formats, else 1x1.
@@ -113,11 +125,45 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
   return CreateTexture(buffer, size, texture_format, desired, flags, nullptr);
 }
 
+// The sized internal format glTexStorage2D() needs for an uncompressed
+// format and type, or 0 if there is none.
+static GLenum SizedInternalFormat(GLenum format, GLenum type) {
+  switch (type) {
+    case GL_UNSIGNED_BYTE:
+      return format == GL_RGBA ? GL_RGBA8 : format == GL_RGB ? GL_RGB8 : 0;
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+      return format == GL_RGBA ? GL_RGB5_A1 : 0;
+    case GL_UNSIGNED_SHORT_5_6_5:
+      return format == GL_RGB ? GL_RGB565 : 0;
+    default:
+      return 0;
+  }
+}
+
+// Uploads the first `num_mips` levels of the ASTC or PKM mip chain in
+// `buffer`, as left by UnpackASTC() or UnpackPKM().
+template <typename Header, typename UploadFunc>
+static void UploadMipChain(const uint8_t *buffer, const vec2i &tex_size,
+                           int num_mips, int num_faces,
+                           const UploadFunc &gl_tex_image) {
+  for (int i = 0; i < num_mips; i++) {
+    const auto &header = *reinterpret_cast<const Header *>(buffer);
+    const int data_size = static_cast<int>(ImageSize(header));
+    // TODO(wvo): cubemaps in ASTC may not work for block sizes that straddle
+    // the face boundaries.
+    gl_tex_image(buffer + sizeof(Header),
+                 vec2i::Max(mathfu::kOnes2i, tex_size / (1 << i)), i,
+                 data_size / num_faces, true);
+    buffer += sizeof(Header) + data_size;
+  }
+}
+
 // static
 TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
                                      TextureFormat texture_format,
                                      TextureFormat desired,
-                                     TextureFlags flags, TextureImpl *impl) {
+                                     TextureFlags flags, TextureImpl *impl,
+                                     int base_mip, int num_mips) {
   (void)impl;
   GLenum tex_type = GL_TEXTURE_2D;
   GLenum tex_imagetype = GL_TEXTURE_2D;
@@ -152,13 +198,32 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
 
   bool generate_mips = (flags & kTextureFlagsUseMipMaps) != 0;
   bool have_mips = generate_mips;
+  // The number of mip levels stored in `buffer`.
+  int num_chained_mips = 1;
 
-  if (generate_mips && IsCompressed(texture_format)) {
+  // Mips built by Texture::Load() can be uploaded as is, as long as they're
+  // already in the format they're uploaded in.
+  const bool has_built_mips =
+      generate_mips && buffer && num_mips > 1 &&
+      BytesPerPixel(texture_format) &&
+      UploadFormat(desired, texture_format) == texture_format;
+  if (has_built_mips) {
+    num_chained_mips = num_mips;
+    generate_mips = false;
+  }
+
+  const bool block_compressed = texture_format == kFormatASTC ||
+                                texture_format == kFormatPKM ||
+                                texture_format == kFormatKTX;
+  if (generate_mips && block_compressed) {
     if (texture_format == kFormatKTX) {
       const auto &header = *reinterpret_cast<const KTXHeader *>(buffer);
       have_mips = (header.mip_levels > 1);
     } else {
-      have_mips = false;
+      num_chained_mips = texture_format == kFormatASTC
+                             ? CountMipChain<ASTCHeader>(buffer)
+                             : CountMipChain<PKMHeader>(buffer);
+      have_mips = num_chained_mips > 1;
     }
 
     if (!have_mips) {
@@ -167,6 +232,28 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
     generate_mips = false;
   }
 
+  // Allocate all levels at once as immutable storage where available, which
+  // spares the driver from validating and reallocating the chain per level.
+  // Streamed textures later add finer mips below their base level, which
+  // immutable storage doesn't allow.
+  GLsizei storage_levels = 0;
+  if (buffer && base_mip == 0 &&
+      RendererBase::Get()->SupportsTextureStorage()) {
+    const int max_levels =
+        static_cast<int>(std::log2(std::max(tex_size.x, tex_size.y))) + 1;
+    if (generate_mips) {
+      storage_levels = max_levels;
+    } else if (!have_mips) {
+      storage_levels = 1;
+    } else if (texture_format == kFormatKTX) {
+      const auto &header = *reinterpret_cast<const KTXHeader *>(buffer);
+      storage_levels = std::min(static_cast<int>(header.mip_levels), max_levels);
+    } else {
+      storage_levels = std::min(num_chained_mips, max_levels);
+    }
+  }
+  bool storage_allocated = false;
+
   // In some Android devices (particulary Galaxy Nexus), there is an issue
   // of glGenerateMipmap() with 16BPP texture format.
   // In that case, we are going to fallback to 888/8888 textures
@@ -177,8 +264,7 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
   // TODO(wvo): support default args for mipmap/wrap/trilinear
   GLuint texture_id;
   GL_CALL(glGenTextures(1, &texture_id));
-  GL_CALL(glActiveTexture(GL_TEXTURE0));
-  GL_CALL(glBindTexture(tex_type, texture_id));
+  TextureBindings::BindTexture(0, tex_type, texture_id);
   GL_CALL(glTexParameteri(tex_type, GL_TEXTURE_WRAP_S, wrap_mode));
   GL_CALL(glTexParameteri(tex_type, GL_TEXTURE_WRAP_T, wrap_mode));
   if (flags & kTextureFlagsIsCubeMap) {
@@ -190,27 +276,58 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
 
   auto format = GL_RGBA;
   auto type = GL_UNSIGNED_BYTE;
-  if (desired == kFormatAuto) {
-    desired = IsCompressed(texture_format)
-                  ? texture_format
-                  : HasAlpha(texture_format) ? kFormat5551 : kFormat565;
-  } else if (desired == kFormatNative) {
-    desired = texture_format;
-  }
+  // When set, the internal format to pass to glTexImage2D(), if not `format`.
+  GLenum internal_format = 0;
+  desired = UploadFormat(desired, texture_format);
 
+  PixelUnpackRing *unpack_ring = UnpackRing();
   auto gl_tex_image = [&](const uint8_t *buf, const vec2i &mip_size,
                           int mip_level, int buf_size, bool compressed) {
+    // Stage all faces at once, and pass GL offsets into the staging buffer.
+    const bool staged =
+        unpack_ring &&
+        unpack_ring->Stage(buf, static_cast<size_t>(buf_size) * tex_num_faces);
+    if (storage_levels > 0 && !storage_allocated) {
+      storage_allocated = true;
+      const GLenum sized_format =
+          compressed ? format : SizedInternalFormat(format, type);
+      if (sized_format) {
+        GL_CALL(glTexStorage2D(tex_type, storage_levels, sized_format,
+                               tex_size.x, tex_size.y));
+      } else {
+        // E.g. luminance, which has no sized format on ES3.
+        storage_levels = 0;
+      }
+    }
+    if (buf) {
+      RendererBase::CountRenderWork(
+          &RenderCounters::texture_upload_bytes,
+          static_cast<size_t>(buf_size) * tex_num_faces);
+    }
+    size_t offset = 0;
     for (int i = 0; i < tex_num_faces; i++) {
-      if (compressed) {
+      const uint8_t *src =
+          staged ? reinterpret_cast<const uint8_t *>(offset) : buf;
+      if (storage_levels > 0 && compressed) {
+        GL_CALL(glCompressedTexSubImage2D(tex_imagetype + i, mip_level, 0, 0,
+                                          mip_size.x, mip_size.y, format,
+                                          buf_size, src));
+      } else if (storage_levels > 0) {
+        GL_CALL(glTexSubImage2D(tex_imagetype + i, mip_level, 0, 0,
+                                mip_size.x, mip_size.y, format, type, src));
+      } else if (compressed) {
         GL_CALL(glCompressedTexImage2D(tex_imagetype + i, mip_level, format,
                                        mip_size.x, mip_size.y, 0, buf_size,
-                                       buf));
+                                       src));
       } else {
-        GL_CALL(glTexImage2D(tex_imagetype + i, mip_level, format, mip_size.x,
-                             mip_size.y, 0, format, type, buf));
+        GL_CALL(glTexImage2D(tex_imagetype + i, mip_level,
+                             internal_format ? internal_format : format,
+                             mip_size.x, mip_size.y, 0, format, type, src));
       }
+      offset += buf_size;
       if (buf) buf += buf_size;
     }
+    if (staged) unpack_ring->Unbind();
   };
 
   int num_pixels = tex_size.x * tex_size.y;
@@ -224,14 +341,15 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
             type = GL_UNSIGNED_SHORT_5_5_5_1;
             gl_tex_image(reinterpret_cast<const uint8_t *>(buffer16), tex_size,
                          0, num_pixels * 2, false);
-            delete[] buffer16;
+            FreeMemory(buffer16, kAllocationTransient);
           } else {
             // Fallback to 8888
             gl_tex_image(buffer, tex_size, 0, num_pixels * 4, false);
           }
           break;
         case kFormat5551:
-          // Nothing coversion.
+          // No conversion, typically already done by Load().
+          type = GL_UNSIGNED_SHORT_5_5_5_1;
           gl_tex_image(buffer, tex_size, 0, num_pixels * 2, false);
           break;
         default:
@@ -250,14 +368,14 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
             type = GL_UNSIGNED_SHORT_5_6_5;
             gl_tex_image(reinterpret_cast<const uint8_t *>(buffer16), tex_size,
                          0, num_pixels * 2, false);
-            delete[] buffer16;
+            FreeMemory(buffer16, kAllocationTransient);
           } else {
             // Fallback to 888
             gl_tex_image(buffer, tex_size, 0, num_pixels * 3, false);
           }
           break;
         case kFormat565:
-          // No conversion.
+          // No conversion, typically already done by Load().
           type = GL_UNSIGNED_SHORT_5_6_5;
           gl_tex_image(buffer, tex_size, 0, num_pixels * 2, false);
           break;
@@ -294,10 +412,6 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
     case kFormatASTC: {
       assert(texture_format == kFormatASTC);
       auto &header = *reinterpret_cast<const ASTCHeader *>(buffer);
-      auto xblocks = (size.x + header.blockdim_x - 1) / header.blockdim_x;
-      auto yblocks = (size.y + header.blockdim_y - 1) / header.blockdim_y;
-      auto zblocks = (1 + header.blockdim_z - 1) / header.blockdim_z;
-      auto data_size = xblocks * yblocks * zblocks << 4;
       // Convert the block dimensions into the correct GL constant.
       switch (header.blockdim_x) {
         case 4:
@@ -353,21 +467,15 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
         default:
           assert(false);
       }
-      // TODO(wvo): cubemaps in ASTC may not work for block sizes that straddle
-      // the face boundaries.
-      gl_tex_image(buffer + sizeof(ASTCHeader), tex_size, 0,
-                   data_size / tex_num_faces, true);
+      UploadMipChain<ASTCHeader>(buffer, tex_size, num_chained_mips,
+                                 tex_num_faces, gl_tex_image);
       break;
     }
     case kFormatPKM: {
       assert(texture_format == kFormatPKM);
-      auto &header = *reinterpret_cast<const PKMHeader *>(buffer);
-      auto ext_xsize = (header.ext_width[0] << 8) | header.ext_width[1];
-      auto ext_ysize = (header.ext_height[0] << 8) | header.ext_height[1];
-      auto data_size = (ext_xsize / 4) * (ext_ysize / 4) * 8;
       format = GL_COMPRESSED_RGB8_ETC2;
-      gl_tex_image(buffer + sizeof(PKMHeader), tex_size, 0,
-                   data_size / tex_num_faces, true);
+      UploadMipChain<PKMHeader>(buffer, tex_size, num_chained_mips,
+                                tex_num_faces, gl_tex_image);
       break;
     }
     case kFormatKTX: {
@@ -375,9 +483,17 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
       auto &header = *reinterpret_cast<const KTXHeader *>(buffer);
       format = header.internal_format;
       auto data = buffer + sizeof(KTXHeader) + header.keyvalue_data;
-      auto cur_size = tex_size;
+      // Streamed textures start with only the mips from base_mip down.
+      auto cur_size = tex_size / (1 << base_mip);
       const vec2i block_size = GetBlockSize(format);
       bool compressed = std::max(block_size[0], block_size[1]) > 1;
+      if (!compressed && header.type != 0) {
+        // Uncompressed, e.g. from texture_pipeline. The unsized base format
+        // is valid as an internal format on ES2 as well.
+        internal_format = header.base_internal_format;
+        format = header.format;
+        type = header.type;
+      }
       for (uint32_t i = 0; i < header.mip_levels; i++) {
         // Guard against extra mip levels in the ktx.
         if (cur_size.x < block_size.x || cur_size.y < block_size.y) {
@@ -388,39 +504,68 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
           // Some GL drivers need to be explicitly told that we don't have a
           // full mip chain (down to 1x1).
           assert(i > 0);
-          GL_CALL(glTexParameteri(tex_type, GL_TEXTURE_MAX_LEVEL, i - 1));
+          GL_CALL(glTexParameteri(tex_type, GL_TEXTURE_MAX_LEVEL,
+                                  base_mip + i - 1));
           break;
         }
         auto data_size = *(reinterpret_cast<const int32_t *>(data));
         data += sizeof(int32_t);
+        // A 1x6 strip gives the size of all faces, six separate faces that of
+        // one, each following the other in the level. Their padding to 4
+        // bytes is always 0 for block compressed and 32bpp faces.
+        const int face_size =
+            header.faces == 6 ? data_size : data_size / tex_num_faces;
         // Keep loading mip data even if one of our calculated dimensions goes
         // to 0, but maintain a min size of 1.  This is needed to get non-square
         // mip chains to work using ETC2 (eg a 256x512 needs 10 mips defined).
-        gl_tex_image(data, vec2i::Max(mathfu::kOnes2i, cur_size), i,
-                     data_size / tex_num_faces, compressed);
+        gl_tex_image(data, vec2i::Max(mathfu::kOnes2i, cur_size), base_mip + i,
+                     face_size, compressed);
         cur_size /= 2;
-        data += data_size;
+        data += face_size * tex_num_faces;
         // If the file has mips but the caller doesn't want them, stop here.
         if (!have_mips) break;
       }
+      if (base_mip > 0) {
+        GL_CALL(glTexParameteri(tex_type, GL_TEXTURE_BASE_LEVEL, base_mip));
+      }
       break;
     }
     default:
       assert(false);
   }
 
+  if (has_built_mips) {
+    // The levels follow level 0 tightly packed, so even rows of 1 or 3 bytes
+    // can't be padded to the default alignment.
+    const int bytes_per_pixel = static_cast<int>(BytesPerPixel(texture_format));
+    GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    const uint8_t *level = buffer;
+    vec2i mip_size = tex_size;
+    for (int i = 1; i < num_chained_mips; i++) {
+      level += mip_size.x * mip_size.y * bytes_per_pixel * tex_num_faces;
+      mip_size = vec2i::Max(mathfu::kOnes2i, mip_size / 2);
+      gl_tex_image(level, mip_size, i, mip_size.x * mip_size.y * bytes_per_pixel,
+                   false);
+    }
+    GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+  }
+
   if (generate_mips && buffer != nullptr) {
     // Work around for some Android devices to correctly generate miplevels.
     // NOTE:  If client creates a texture with buffer == nullptr (i.e. to
     // render into later), and wants mipmapping, and is on a phone requiring
     // this workaround, the client will need to do this preallocation
     // workaround themselves.
-    auto min_dimension = static_cast<float>(std::min(tex_size.x, tex_size.y));
-    auto levels = std::ceil(std::log(min_dimension) / std::log(2.0f));
-    auto mip_size = tex_size / 2;
-    for (auto i = 1; i < levels; ++i) {
-      gl_tex_image(nullptr, mip_size, i, 0, false);
-      mip_size /= 2;
+    // Immutable storage already has all its levels allocated.
+    if (storage_levels == 0) {
+      auto min_dimension =
+          static_cast<float>(std::min(tex_size.x, tex_size.y));
+      auto levels = std::ceil(std::log(min_dimension) / std::log(2.0f));
+      auto mip_size = tex_size / 2;
+      for (auto i = 1; i < levels; ++i) {
+        gl_tex_image(nullptr, mip_size, i, 0, false);
+        mip_size /= 2;
+      }
     }
 
     GL_CALL(glGenerateMipmap(tex_type));
@@ -438,26 +583,207 @@ void Texture::UpdateTexture(size_t unit, TextureFormat format, int xoffset,
   // TODO(wvo): Optimize glTexSubImage2D call in ES3.0 capable platform.
   auto texture_format = GL_RGBA;
   auto pixel_format = GL_UNSIGNED_BYTE;
+  size_t bytes_per_pixel = 4;
   switch (format) {
     case kFormatLuminance:
       texture_format = GL_LUMINANCE;
+      bytes_per_pixel = 1;
       break;
     case kFormat888:
       texture_format = GL_RGB;
+      bytes_per_pixel = 3;
       break;
     case kFormat5551:
       pixel_format = GL_UNSIGNED_SHORT_5_5_5_1;
+      bytes_per_pixel = 2;
       break;
     case kFormat565:
       pixel_format = GL_UNSIGNED_SHORT_5_6_5;
+      bytes_per_pixel = 2;
       break;
     case kFormat8888:
       break;
     default:
       assert(false);  // TODO(wvo): not implemented.
   }
+
+  // Streaming textures (e.g. video) are updated every frame, so on ES3 go
+  // through the staging ring rather than having the driver copy `data`.
+  // Rows are padded to the default GL_UNPACK_ALIGNMENT of 4, except the last.
+  PixelUnpackRing *unpack_ring = UnpackRing();
+  const size_t row_size = static_cast<size_t>(width) * bytes_per_pixel;
+  const size_t data_size =
+      height > 0 ? ((row_size + 3) & ~size_t(3)) * (height - 1) + row_size : 0;
+  const bool staged = unpack_ring && unpack_ring->Stage(data, data_size);
+  RendererBase::CountRenderWork(&RenderCounters::texture_upload_bytes,
+                                data_size);
   GL_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, xoffset, yoffset, width, height,
-                          texture_format, pixel_format, data));
+                          texture_format, pixel_format,
+                          staged ? nullptr : data));
+  if (staged) unpack_ring->Unbind();
+}
+
+bool Texture::UploadMip(int mip, const uint8_t *data, size_t size) {
+  if (!ValidTextureHandle(id_) || mip < 0 || mip != resident_mip_ - 1) {
+    return false;
+  }
+  const vec2i mip_size = vec2i::Max(mathfu::kOnes2i, size_ / (1 << mip));
+  TextureBindings::BindTexture(0, GL_TEXTURE_2D, GlTextureHandle(id_));
+  PixelUnpackRing *unpack_ring = UnpackRing();
+  const bool staged = unpack_ring && unpack_ring->Stage(data, size);
+  RendererBase::CountRenderWork(&RenderCounters::texture_upload_bytes, size);
+  GL_CALL(glCompressedTexImage2D(GL_TEXTURE_2D, mip, mip_format_, mip_size.x,
+                                 mip_size.y, 0, static_cast<GLsizei>(size),
+                                 staged ? nullptr : data));
+  if (staged) unpack_ring->Unbind();
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, mip));
+  resident_mip_ = mip;
+  UpdateGpuMemorySize();
+  return true;
+}
+
+bool Texture::UploadCubeMapFace(int face, const Texture &image) {
+  const uint8_t *buffer = image.data_;
+  const vec2i face_size = image.size_;
+  if (!buffer || face < 0 || face >= 6) return false;
+  if (face_size.x != face_size.y) {
+    LogError(kError, "Cube map face not square: %s (%d,%d)",
+             image.filename().c_str(), face_size.x, face_size.y);
+    return false;
+  }
+  if (ValidTextureHandle(id_)) {
+    // Each face must be specified with the same size and format.
+    if (face_size.x != size_.x || image.texture_format_ != texture_format_ ||
+        image.mip_format_ != mip_format_) {
+      LogError(kError, "Cube map face doesn't match the others: %s",
+               image.filename().c_str());
+      return false;
+    }
+    TextureBindings::BindTexture(0, GL_TEXTURE_CUBE_MAP, GlTextureHandle(id_));
+  } else {
+    size_ = face_size * vec2i(1, 6);
+    SetOriginalSizeIfNotYetSet(size_);
+    texture_format_ = image.texture_format_;
+    mip_format_ = image.mip_format_;
+    num_mips_ = 0;
+    const GLint wrap_mode =
+        flags_ & kTextureFlagsClampToEdge ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    GLuint texture_id;
+    GL_CALL(glGenTextures(1, &texture_id));
+    TextureBindings::BindTexture(0, GL_TEXTURE_CUBE_MAP, texture_id);
+    GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, wrap_mode));
+    GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, wrap_mode));
+    GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, wrap_mode));
+    GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER,
+                            GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                            flags_ & kTextureFlagsUseMipMaps
+                                ? GL_LINEAR_MIPMAP_LINEAR
+                                : GL_LINEAR));
+    id_ = TextureHandleFromGl(texture_id);
+    is_external_ = false;
+  }
+
+  // Faces can arrive in any order, so each level of each face is specified
+  // on its own, rather than allocating immutable storage up front.
+  const GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+  const bool use_mips = (flags_ & kTextureFlagsUseMipMaps) != 0;
+  vec2i mip_size = face_size;
+  size_t uploaded_bytes = 0;
+  int levels = 0;
+  if (texture_format_ == kFormatKTX) {
+    const auto &header = *reinterpret_cast<const KTXHeader *>(buffer);
+    const vec2i block_size = GetBlockSize(header.internal_format);
+    const bool compressed = std::max(block_size.x, block_size.y) > 1;
+    const uint8_t *data = buffer + sizeof(KTXHeader) + header.keyvalue_data;
+    for (uint32_t i = 0; i < header.mip_levels; ++i) {
+      // Mips smaller than a block end the chain, see FinishCubeMap().
+      if (mip_size.x < block_size.x || mip_size.y < block_size.y) break;
+      const int32_t data_size = *reinterpret_cast<const int32_t *>(data);
+      data += sizeof(int32_t);
+      if (compressed) {
+        GL_CALL(glCompressedTexImage2D(target, levels, header.internal_format,
+                                       mip_size.x, mip_size.y, 0, data_size,
+                                       data));
+      } else {
+        GL_CALL(glTexImage2D(target, levels,
+                             static_cast<GLint>(header.base_internal_format),
+                             mip_size.x, mip_size.y, 0, header.format,
+                             header.type, data));
+      }
+      data += data_size;
+      uploaded_bytes += data_size;
+      ++levels;
+      mip_size = vec2i::Max(mathfu::kOnes2i, mip_size / 2);
+      if (!use_mips) break;
+    }
+  } else {
+    // The faces come in the format Load() left them in, with any mips it
+    // built packed after the first level.
+    GLenum format = GL_RGBA;
+    GLenum type = GL_UNSIGNED_BYTE;
+    // clang-format off
+    switch (texture_format_) {
+      case kFormat8888:                                               break;
+      case kFormat888:            format = GL_RGB;                    break;
+      case kFormat5551:           type = GL_UNSIGNED_SHORT_5_5_5_1;   break;
+      case kFormat565:            format = GL_RGB;
+                                  type = GL_UNSIGNED_SHORT_5_6_5;     break;
+      case kFormatLuminance:      format = GL_LUMINANCE;              break;
+      case kFormatLuminanceAlpha: format = GL_LUMINANCE_ALPHA;        break;
+      default:
+        LogError(kError, "Cube map faces can't be in this format: %s",
+                 image.filename().c_str());
+        return false;
+    }
+    // clang-format on
+    const size_t bytes_per_pixel = BytesPerPixel(texture_format_);
+    GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    const uint8_t *level = buffer;
+    for (; levels < std::max(image.num_mips_, 1); ++levels) {
+      GL_CALL(glTexImage2D(target, levels, format, mip_size.x, mip_size.y, 0,
+                           format, type, level));
+      const size_t level_size =
+          static_cast<size_t>(mip_size.x) * mip_size.y * bytes_per_pixel;
+      level += level_size;
+      uploaded_bytes += level_size;
+      mip_size = vec2i::Max(mathfu::kOnes2i, mip_size / 2);
+    }
+    GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+  }
+  RendererBase::CountRenderWork(&RenderCounters::texture_upload_bytes,
+                                uploaded_bytes);
+  if (num_mips_ == 0) num_mips_ = levels;
+  if (levels != num_mips_) {
+    LogError(kError, "Cube map face has %d mips, the others %d: %s", levels,
+             num_mips_, image.filename().c_str());
+  }
+  return true;
+}
+
+void Texture::FinishCubeMap() {
+  if (ValidTextureHandle(id_)) {
+    TextureBindings::BindTexture(0, GL_TEXTURE_CUBE_MAP, GlTextureHandle(id_));
+    const int full_mips = static_cast<int>(std::log2(size_.x)) + 1;
+    const bool compressed =
+        texture_format_ == kFormatKTX &&
+        std::max(GetBlockSize(mip_format_).x, GetBlockSize(mip_format_).y) > 1;
+    if (!(flags_ & kTextureFlagsUseMipMaps) || num_mips_ >= full_mips) {
+      // Complete as is.
+    } else if (num_mips_ > 1) {
+      // E.g. compressed faces, whose mips stop at the block size.
+      GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL,
+                              num_mips_ - 1));
+    } else if (compressed) {
+      LogError(kError, "Can't generate mipmaps for compressed textures");
+      GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                              GL_LINEAR));
+    } else {
+      GL_CALL(glGenerateMipmap(GL_TEXTURE_CUBE_MAP));
+    }
+  }
+  UpdateGpuMemorySize();
+  CallFinalizeCallback();
 }
 
 // static
@@ -15,6 +15,8 @@
 #ifndef FPLBASE_TEXTURE_HEADERS_H
 #define FPLBASE_TEXTURE_HEADERS_H
 
+#include <string.h>
+#include <algorithm>
 #include <cstdint>
 
 namespace fplbase {
@@ -57,6 +59,106 @@ struct KTXHeader {
   uint32_t keyvalue_data;
 };
 
+// The GL internal formats of ETC2 KTX files, as Texture::EncodeETC2() writes.
+static const uint32_t kKTXFormatETC2RGB8 = 0x9274;   // COMPRESSED_RGB8_ETC2
+static const uint32_t kKTXFormatETC2RGBA8 = 0x9278;  // ..._RGBA8_ETC2_EAC
+static const uint32_t kKTXBaseFormatRGB = 0x1907;     // RGB
+static const uint32_t kKTXBaseFormatRGBA = 0x1908;    // RGBA
+
+// A KTX file compressed as one LZ4 block, see lz4_block.h.
+struct KTXZHeader {
+  char magic[4];             // "KTXZ"
+  uint32_t ktx_size;         // Size of the KTX file once decompressed.
+  uint32_t compressed_size;  // Size of the LZ4 block following the header.
+  uint32_t reserved;
+};
+
+// Header accessors, overloaded so MipChainSize() and CountMipChain() work with
+// both ASTC and PKM.
+inline bool IsValidHeader(const ASTCHeader &header) {
+  static const uint8_t magic[] = {0x13, 0xab, 0xa1, 0x5c};
+  return memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+         header.blockdim_x != 0 && header.blockdim_y != 0 &&
+         header.blockdim_z != 0;
+}
+inline int ImageWidth(const ASTCHeader &header) {
+  return header.xsize[0] | (header.xsize[1] << 8) | (header.xsize[2] << 16);
+}
+inline int ImageHeight(const ASTCHeader &header) {
+  return header.ysize[0] | (header.ysize[1] << 8) | (header.ysize[2] << 16);
+}
+// The size of the (2D) image data following the header.
+inline size_t ImageSize(const ASTCHeader &header) {
+  const int xblocks =
+      (ImageWidth(header) + header.blockdim_x - 1) / header.blockdim_x;
+  const int yblocks =
+      (ImageHeight(header) + header.blockdim_y - 1) / header.blockdim_y;
+  const int zblocks = (1 + header.blockdim_z - 1) / header.blockdim_z;
+  return static_cast<size_t>(xblocks * yblocks * zblocks) << 4;
+}
+
+inline bool IsValidHeader(const PKMHeader &header) {
+  return memcmp(header.magic, "PKM ", 4) == 0;
+}
+inline int ImageWidth(const PKMHeader &header) {
+  return (header.width[0] << 8) | header.width[1];
+}
+inline int ImageHeight(const PKMHeader &header) {
+  return (header.height[0] << 8) | header.height[1];
+}
+inline size_t ImageSize(const PKMHeader &header) {
+  const int ext_xsize = (header.ext_width[0] << 8) | header.ext_width[1];
+  const int ext_ysize = (header.ext_height[0] << 8) | header.ext_height[1];
+  return static_cast<size_t>((ext_xsize / 4) * (ext_ysize / 4) * 8);
+}
+
+// Mipped ASTC and PKM files are the files of each level back to back, from
+// the full size down, each level half the size of the one before.
+
+// Whether `header` can follow a level 0 of the given size as level `mip`.
+template <typename Header>
+bool IsMipOf(const Header &header, int mip, int width, int height) {
+  return IsValidHeader(header) &&
+         ImageWidth(header) == std::max(width >> mip, 1) &&
+         ImageHeight(header) == std::max(height >> mip, 1);
+}
+
+// Returns how many of the `size` bytes in `buf` are a valid mip chain, or 0
+// if not even the first level is complete.
+template <typename Header>
+size_t MipChainSize(const uint8_t *buf, size_t size) {
+  if (size < sizeof(Header)) return 0;
+  const Header &first = *reinterpret_cast<const Header *>(buf);
+  const int width = ImageWidth(first);
+  const int height = ImageHeight(first);
+  size_t offset = 0;
+  for (int mip = 0; size - offset >= sizeof(Header); ++mip) {
+    const Header &header = *reinterpret_cast<const Header *>(buf + offset);
+    if (!IsMipOf(header, mip, width, height)) break;
+    const size_t level_size = sizeof(Header) + ImageSize(header);
+    if (level_size > size - offset) break;
+    offset += level_size;
+  }
+  return offset;
+}
+
+// Counts the levels of a mip chain that is followed by a zeroed header, as
+// left by Texture::UnpackASTC() and Texture::UnpackPKM().
+template <typename Header>
+int CountMipChain(const uint8_t *buf) {
+  const Header &first = *reinterpret_cast<const Header *>(buf);
+  const int width = ImageWidth(first);
+  const int height = ImageHeight(first);
+  int mip = 0;
+  for (;;) {
+    const Header &header = *reinterpret_cast<const Header *>(buf);
+    if (!IsMipOf(header, mip, width, height)) break;
+    buf += sizeof(Header) + ImageSize(header);
+    ++mip;
+  }
+  return std::max(mip, 1);
+}
+
 }  // namespace fplbase
 
 #endif  // FPLBASE_TEXTURE_HEADERS_H
@@ -0,0 +1,328 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "precompiled.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "fplbase/trace.h"
+#include "fplbase/utilities.h"
+
+#if defined(__ANDROID__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace fplbase {
+
+static std::atomic<TraceBackend *> g_trace_backend(nullptr);
+
+void SetTraceBackend(TraceBackend *backend) {
+  g_trace_backend.store(backend, std::memory_order_release);
+}
+
+TraceBackend *GetTraceBackend() {
+  return g_trace_backend.load(std::memory_order_acquire);
+}
+
+const size_t TraceEventFileBackend::kDefaultEventsPerThread;
+
+namespace {
+
+struct TraceRecord {
+  double timestamp;
+  // Names are string literals, so a pointer identifies them.
+  const char *name;
+  int64_t value;
+  char phase;
+};
+
+// A single producer, single consumer queue of one thread's events.
+struct TraceRing {
+  TraceRing(size_t size, unsigned long long thread_id)
+      : records(size), mask(size - 1), thread_id(thread_id), head(0), tail(0),
+        dropped(0) {}
+
+  std::vector<TraceRecord> records;
+  const size_t mask;
+  const unsigned long long thread_id;
+  // Written by the producer only.
+  std::atomic<size_t> head;
+  // Written by the consumer only.
+  std::atomic<size_t> tail;
+  std::atomic<size_t> dropped;
+};
+
+// Each thread's ring of the backend it last traced to. Backends are told
+// apart by a generation number rather than their address, which a later
+// backend may reuse.
+struct ThreadTraceRing {
+  uint64_t generation;
+  TraceRing *ring;
+};
+
+thread_local ThreadTraceRing t_trace_ring = {0, nullptr};
+std::atomic<uint64_t> g_next_generation(1);
+
+// How long the writer thread sleeps between writes.
+const int kTraceFlushIntervalMs = 20;
+
+}  // namespace
+
+struct TraceEventFileBackendImpl {
+  explicit TraceEventFileBackendImpl(size_t events_per_thread)
+      : generation(g_next_generation++),
+        ring_size(1),
+        file(nullptr),
+        num_events(0),
+        stop(false),
+        flushes_requested(0),
+        flushes_done(0) {
+    while (ring_size < events_per_thread) ring_size <<= 1;
+  }
+
+  void WriterThread();
+  // Writes the records of all rings. Called with `mutex` held.
+  void WriteRings();
+  void Write(const TraceRecord &record, unsigned long long thread_id);
+
+  const uint64_t generation;
+  size_t ring_size;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  // Rings live as long as the backend, even after their thread exits.
+  std::vector<std::unique_ptr<TraceRing>> rings;
+  FILE *file;
+  size_t num_events;
+  std::thread writer;
+  bool stop;
+  // Flush() requests that the writer has yet to finish.
+  uint64_t flushes_requested;
+  uint64_t flushes_done;
+};
+
+void TraceEventFileBackendImpl::WriterThread() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stop) {
+    cv.wait_for(lock, std::chrono::milliseconds(kTraceFlushIntervalMs));
+    const uint64_t requested = flushes_requested;
+    WriteRings();
+    if (flushes_done != requested) {
+      flushes_done = requested;
+      cv.notify_all();
+    }
+  }
+}
+
+void TraceEventFileBackendImpl::WriteRings() {
+  for (auto it = rings.begin(); it != rings.end(); ++it) {
+    TraceRing &ring = **it;
+    const size_t head = ring.head.load(std::memory_order_acquire);
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    for (; tail != head; ++tail) {
+      if (file) Write(ring.records[tail & ring.mask], ring.thread_id);
+    }
+    ring.tail.store(tail, std::memory_order_release);
+  }
+  if (file) fflush(file);
+}
+
+void TraceEventFileBackendImpl::Write(const TraceRecord &record,
+                                      unsigned long long thread_id) {
+  // Microseconds, the unit of the format.
+  fprintf(file, "%s{\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%llu",
+          num_events ? ",\n" : "", record.phase, record.timestamp * 1e6,
+          thread_id);
+  if (record.name) {
+    fputs(",\"name\":\"", file);
+    for (const char *c = record.name; *c; ++c) {
+      if (*c == '"' || *c == '\\') fputc('\\', file);
+      fputc(*c, file);
+    }
+    fputc('"', file);
+  }
+  switch (record.phase) {
+    case 'C':
+      fprintf(file, ",\"args\":{\"value\":%lld}",
+              static_cast<long long>(record.value));
+      break;
+    case 'b':
+    case 'e':
+      fprintf(file, ",\"cat\":\"async\",\"id\":%lld",
+              static_cast<long long>(record.value));
+      break;
+  }
+  fputc('}', file);
+  ++num_events;
+}
+
+TraceEventFileBackend::TraceEventFileBackend(size_t events_per_thread)
+    : impl_(new TraceEventFileBackendImpl(events_per_thread)) {}
+
+TraceEventFileBackend::~TraceEventFileBackend() {
+  Close();
+  delete impl_;
+}
+
+bool TraceEventFileBackend::Open(const char *filename) {
+  Close();
+  std::unique_lock<std::mutex> lock(impl_->mutex);
+  // Drop whatever was traced while no file was open.
+  impl_->WriteRings();
+  impl_->file = fopen(filename, "w");
+  if (!impl_->file) return false;
+  impl_->num_events = 0;
+  fputs("{\"traceEvents\":[\n", impl_->file);
+  impl_->stop = false;
+  impl_->writer =
+      std::thread(&TraceEventFileBackendImpl::WriterThread, impl_);
+  return true;
+}
+
+void TraceEventFileBackend::Close() {
+  {
+    std::unique_lock<std::mutex> lock(impl_->mutex);
+    if (!impl_->file) return;
+    impl_->stop = true;
+    impl_->cv.notify_all();
+  }
+  impl_->writer.join();
+  std::unique_lock<std::mutex> lock(impl_->mutex);
+  impl_->WriteRings();
+  fputs("\n]}\n", impl_->file);
+  fclose(impl_->file);
+  impl_->file = nullptr;
+  impl_->flushes_done = impl_->flushes_requested;
+  impl_->cv.notify_all();
+}
+
+void TraceEventFileBackend::Flush() {
+  std::unique_lock<std::mutex> lock(impl_->mutex);
+  if (!impl_->file) return;
+  const uint64_t request = ++impl_->flushes_requested;
+  impl_->cv.notify_all();
+  while (impl_->flushes_done < request) impl_->cv.wait(lock);
+}
+
+size_t TraceEventFileBackend::num_dropped_events() const {
+  std::unique_lock<std::mutex> lock(impl_->mutex);
+  size_t dropped = 0;
+  for (auto it = impl_->rings.begin(); it != impl_->rings.end(); ++it) {
+    dropped += (*it)->dropped.load(std::memory_order_relaxed);
+  }
+  return dropped;
+}
+
+void TraceEventFileBackend::Add(char phase, const char *name, int64_t value) {
+  ThreadTraceRing &cached = t_trace_ring;
+  if (cached.generation != impl_->generation) {
+    // The first event of this thread on this backend.
+    const unsigned long long thread_id = static_cast<unsigned long long>(
+        std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::unique_lock<std::mutex> lock(impl_->mutex);
+    cached.ring = nullptr;
+    // It may have traced to this backend before it traced to another one.
+    for (auto it = impl_->rings.begin(); it != impl_->rings.end(); ++it) {
+      if ((*it)->thread_id == thread_id) cached.ring = it->get();
+    }
+    if (!cached.ring) {
+      impl_->rings.emplace_back(new TraceRing(impl_->ring_size, thread_id));
+      cached.ring = impl_->rings.back().get();
+    }
+    cached.generation = impl_->generation;
+  }
+  TraceRing &ring = *cached.ring;
+  const size_t head = ring.head.load(std::memory_order_relaxed);
+  if (head - ring.tail.load(std::memory_order_acquire) > ring.mask) {
+    ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  TraceRecord &record = ring.records[head & ring.mask];
+  record.timestamp = GetTimeInSeconds();
+  record.name = name;
+  record.value = value;
+  record.phase = phase;
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+void TraceEventFileBackend::Begin(const char *name) { Add('B', name, 0); }
+
+void TraceEventFileBackend::End() { Add('E', nullptr, 0); }
+
+void TraceEventFileBackend::Counter(const char *name, int64_t value) {
+  Add('C', name, value);
+}
+
+void TraceEventFileBackend::AsyncBegin(const char *name, int32_t cookie) {
+  Add('b', name, cookie);
+}
+
+void TraceEventFileBackend::AsyncEnd(const char *name, int32_t cookie) {
+  Add('e', name, cookie);
+}
+
+#if defined(__ANDROID__)
+static const size_t kMaxSystraceLength = 256;
+
+SystraceBackend::SystraceBackend()
+    : trace_marker_(
+          open("/sys/kernel/debug/tracing/trace_marker", O_WRONLY)) {}
+
+SystraceBackend::~SystraceBackend() {
+  if (trace_marker_ >= 0) close(trace_marker_);
+}
+
+void SystraceBackend::Write(const char *format, const char *name,
+                            int64_t value) {
+  if (trace_marker_ < 0) return;
+  char buf[kMaxSystraceLength];
+  int len = snprintf(buf, sizeof(buf), format, getpid(), name,
+                     static_cast<long long>(value));
+  if (len <= 0) return;
+  if (len >= static_cast<int>(sizeof(buf))) len = sizeof(buf) - 1;
+  // A single write() per event keeps events from different threads whole.
+  ssize_t written = write(trace_marker_, buf, len);
+  (void)written;
+}
+
+void SystraceBackend::Begin(const char *name) { Write("B|%d|%s", name, 0); }
+
+void SystraceBackend::End() {
+  if (trace_marker_ < 0) return;
+  const char c = 'E';
+  ssize_t written = write(trace_marker_, &c, 1);
+  (void)written;
+}
+
+void SystraceBackend::Counter(const char *name, int64_t value) {
+  Write("C|%d|%s|%lld", name, value);
+}
+
+void SystraceBackend::AsyncBegin(const char *name, int32_t cookie) {
+  Write("S|%d|%s|%lld", name, cookie);
+}
+
+void SystraceBackend::AsyncEnd(const char *name, int32_t cookie) {
+  Write("F|%d|%s|%lld", name, cookie);
+}
+#endif  // defined(__ANDROID__)
+
+}  // namespace fplbase
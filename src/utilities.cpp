@@ -16,6 +16,7 @@
 #include "precompiled.h"
 #include "fplbase/utilities.h"
 #include "fplutil/mutex.h"
+#include "write_behind.h"
 // clang-format on
 
 // Header files for mmap API.
@@ -33,7 +34,45 @@
 
 namespace fplbase {
 
+#if defined(__ANDROID__)
+// Maps an APK entry, if it is stored uncompressed.
+static const void *MapAAsset(AAssetManager *manager, const char *filename,
+                             int32_t offset, int32_t *size) {
+  AAsset *asset = AAssetManager_open(manager, filename, AASSET_MODE_UNKNOWN);
+  if (!asset) return nullptr;
+  off_t start = 0;
+  off_t length = 0;
+  // Fails for compressed entries.
+  int fd = AAsset_openFileDescriptor(asset, &start, &length);
+  AAsset_close(asset);
+  if (fd < 0) return nullptr;
+  if (offset < 0 || offset >= length) {
+    close(fd);
+    return nullptr;
+  }
+  off_t map_size = length - offset;
+  if (*size && *size < map_size) map_size = *size;
+  // mmap wants a page aligned offset, but the entry can start anywhere in the
+  // APK. UnmapFile() finds the page start again from the pointer.
+  const off_t file_offset = start + offset;
+  const off_t page_offset = file_offset % sysconf(_SC_PAGESIZE);
+  void *p = mmap(0, map_size + page_offset, PROT_READ, MAP_PRIVATE, fd,
+                 file_offset - page_offset);
+  close(fd);
+  if (p == MAP_FAILED) return nullptr;
+  *size = static_cast<int32_t>(map_size);
+  return static_cast<const uint8_t *>(p) + page_offset;
+}
+#endif  // defined(__ANDROID__)
+
 const void *MapFile(const char *filename, int32_t offset, int32_t *size) {
+#if defined(__ANDROID__)
+  AAssetManager *manager = GetAAssetManager();
+  if (manager && filename[0] != '/') {
+    // Compressed entries are expected, so don't log an error for them.
+    return MapAAsset(manager, filename, offset, size);
+  }
+#endif  // defined(__ANDROID__)
 #ifdef _WIN32
   (void)filename;
   (void)offset;
@@ -72,10 +111,51 @@ void UnmapFile(const void *file, int32_t size) {
   (void)size;
   LogError(kError, "UnmapFile unimplemented on Win32.");
 #else
-  munmap(const_cast<void *>(file), size);
+  // Mappings of APK entries may start part way into a page, see MapAAsset().
+  const uintptr_t page_offset = reinterpret_cast<uintptr_t>(file) %
+                                static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  munmap(const_cast<uint8_t *>(static_cast<const uint8_t *>(file)) -
+             page_offset,
+         size + page_offset);
 #endif // _WIN32
 }
 
+bool FileView::Load(const char *filename) {
+  Reset();
+  buffer_ = AcquireFileBuffer();
+  // A queued write is newer than the file, as in LoadFile().
+  const bool queued = FindQueuedFileWrite(filename, buffer_);
+#ifndef _WIN32
+  if (!queued && !HasCustomLoadFileFunction()) {
+    int32_t size = 0;
+    data_ = static_cast<const uint8_t *>(MapFile(filename, 0, &size));
+    if (data_) {
+      ReleaseFileBuffer(buffer_);
+      buffer_ = nullptr;
+      mapped_size_ = size;
+      size_ = static_cast<size_t>(size);
+      return true;
+    }
+  }
+#endif  // _WIN32
+  if (!queued && !LoadFile(filename, buffer_)) {
+    Reset();
+    return false;
+  }
+  data_ = reinterpret_cast<const uint8_t *>(buffer_->c_str());
+  size_ = buffer_->length();
+  return true;
+}
+
+void FileView::Reset() {
+  if (mapped_size_) UnmapFile(data_, mapped_size_);
+  ReleaseFileBuffer(buffer_);
+  data_ = nullptr;
+  size_ = 0;
+  mapped_size_ = 0;
+  buffer_ = nullptr;
+}
+
 #if defined(__ANDROID__)
 static jobject GetSharedPreference(JNIEnv *env, jobject activity) {
   jclass activity_class = env->GetObjectClass(activity);
@@ -93,6 +173,7 @@ static jobject GetSharedPreference(JNIEnv *env, jobject activity) {
 #endif
 
 bool LoadPreferences(const char *filename, std::string *dest) {
+  if (FindQueuedPreferencesWrite(filename, dest)) return true;
 #if defined(__ANDROID__)
   jobject activity = AndroidGetActivity(true);
   if (!activity)
@@ -137,6 +218,8 @@ bool LoadPreferences(const char *filename, std::string *dest) {
 }
 
 int32_t LoadPreference(const char *key, int32_t initial_value) {
+  int32_t queued_value;
+  if (FindQueuedPreferenceWrite(key, &queued_value)) return queued_value;
 #ifdef __ANDROID__
   // Use Android preference API to store an integer value.
   JNIEnv *env = AndroidGetJNIEnv();
@@ -163,10 +246,15 @@ int32_t LoadPreference(const char *key, int32_t initial_value) {
 }
 
 bool SavePreferences(const char *filename, const void *data, size_t size) {
+  if (QueuePreferencesWrite(filename, data, size)) return true;
+  return SavePreferencesRaw(filename, data, size);
+}
+
+bool SavePreferencesRaw(const char *filename, const void *data, size_t size) {
 #if defined(__ANDROID__)
   jobject activity = AndroidGetActivity(true);
   if (!activity)
-    return SaveFile(filename, data, size);
+    return SaveFileRaw(filename, data, size);
   // Use Android preference API to store blob as a Java String.
   JNIEnv *env = AndroidGetJNIEnv();
   jobject preference = GetSharedPreference(env, activity);
@@ -204,11 +292,19 @@ bool SavePreferences(const char *filename, const void *data, size_t size) {
 
   return ret;
 #else
-  return SaveFile(filename, data, size);
+  return SaveFileRaw(filename, data, size);
 #endif
 }
 
 bool SavePreference(const char *key, int32_t value) {
+#ifdef __ANDROID__
+  // Elsewhere there's nowhere to save it, so it fails straight away.
+  if (QueuePreferenceWrite(key, value)) return true;
+#endif
+  return SavePreferenceRaw(key, value);
+}
+
+bool SavePreferenceRaw(const char *key, int32_t value) {
 #ifdef __ANDROID__
   // Use Android preference API to store an integer value.
   JNIEnv *env = AndroidGetJNIEnv();
@@ -430,6 +526,32 @@ bool IsTvDevice() {
 #endif  // __ANDROID
 }
 
+ThermalStatus GetThermalStatus() {
+#ifdef __ANDROID__
+  JNIEnv *env = AndroidGetJNIEnv();
+  jobject activity = AndroidGetActivity(true);
+  if (!env || !activity) return kThermalStatusNone;
+  jclass fpl_class = env->GetObjectClass(activity);
+  jmethodID get_thermal_status =
+      env->GetMethodID(fpl_class, "GetThermalStatus", "()I");
+  jint status = get_thermal_status
+                    ? env->CallIntMethod(activity, get_thermal_status)
+                    : 0;
+  if (env->ExceptionCheck()) {
+    // E.g. an activity that doesn't derive from FPLActivity.
+    env->ExceptionClear();
+    status = 0;
+  }
+  env->DeleteLocalRef(fpl_class);
+  env->DeleteLocalRef(activity);
+  return status >= kThermalStatusNone && status <= kThermalStatusShutdown
+             ? static_cast<ThermalStatus>(status)
+             : kThermalStatusNone;
+#else
+  return kThermalStatusNone;
+#endif  // __ANDROID__
+}
+
 #if defined(__ANDROID__)
 // Get the name of the current activity class.
 std::string AndroidGetActivityName() {
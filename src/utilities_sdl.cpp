@@ -18,12 +18,22 @@
 #include "fplutil/mutex.h"
 // clang-format on
 
+#ifdef __ANDROID__
+#include <time.h>
+#endif
+
 namespace fplbase {
 
 int32_t GetSystemRamSize() {
   return SDL_GetSystemRAM();
 }
 
+double GetTimeInSeconds() {
+  static const double kSecondsPerTick =
+      1.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+  return static_cast<double>(SDL_GetPerformanceCounter()) * kSecondsPerTick;
+}
+
 #if defined(__ANDROID__)
 // This function always returns a pointer to a jobject, but we are returning a
 // void* for the same reason SDL does - to avoid having to include the jni
@@ -61,6 +71,7 @@ SDL_mutex *frame_id_mutex;
 SDL_mutex *vsync_cv_mutex;
 SDL_cond *android_vsync_cv;
 int vsync_frame_id = 0;
+double vsync_time = 0;
 
 // Initialize the Vsync mutexes.  Called by android lifecycle events.
 extern "C" JNIEXPORT void JNICALL
@@ -112,13 +123,21 @@ void WaitForVsync() {
 // needs to be thread-safe.
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_fpl_fplbase_FPLActivity_nativeOnVsync(JNIEnv *env, jobject thiz,
-                                                      jobject activity) {
+                                                      jlong frame_time_nanos) {
   (void)env;
   (void)thiz;
-  (void)activity;
+  // The choreographer's timestamp is on the clock of System.nanoTime(), which
+  // is CLOCK_MONOTONIC. Move it onto the clock of GetTimeInSeconds().
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  const int64_t now_nanos =
+      static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+  const double time =
+      GetTimeInSeconds() - (now_nanos - frame_time_nanos) * 1e-9;
   CallVsyncCallback();
   SDL_LockMutex(frame_id_mutex);
   vsync_frame_id++;
+  vsync_time = time;
   SDL_UnlockMutex(frame_id_mutex);
   SDL_CondBroadcast(android_vsync_cv);
 }
@@ -130,6 +149,13 @@ int GetVsyncFrameId() {
   return return_value;
 }
 
+double GetVsyncTime() {
+  SDL_LockMutex(frame_id_mutex);
+  double return_value = vsync_time;
+  SDL_UnlockMutex(frame_id_mutex);
+  return return_value;
+}
+
 #endif  // __ANDROID__
 
 }  // namespace fplbase
@@ -24,6 +24,8 @@
 
 #include <fcntl.h>
 #include <stdarg.h>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 
 namespace fplbase {
@@ -32,6 +34,11 @@ int32_t GetSystemRamSize() {
   return 0;
 }
 
+double GetTimeInSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 bool GetStoragePath(const char *app_name, std::string *path_string) {
   (void)app_name;
   *path_string = "/";
@@ -128,6 +135,9 @@ Java_com_google_fpl_fplbase_FPLActivity_nativeCleanupVsync(JNIEnv *env,
   (void)activity;
 }
 
+// The time of the latest vsync, on the clock of GetTimeInSeconds().
+static std::atomic<double> g_vsync_time(0.0);
+
 // Blocks until the next time a VSync event occurs.
 void WaitForVsync() {
   // TODO: Write STDLIB version
@@ -139,10 +149,12 @@ void WaitForVsync() {
 // needs to be thread-safe.
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_fpl_fplbase_FPLActivity_nativeOnVsync(JNIEnv *env, jobject thiz,
-                                                      jobject activity) {
+                                                      jlong frame_time_nanos) {
   (void)env;
   (void)thiz;
-  (void)activity;
+  // The choreographer's timestamp is on the clock of System.nanoTime(), which
+  // is CLOCK_MONOTONIC, as is steady_clock on Android.
+  g_vsync_time.store(frame_time_nanos * 1e-9);
   CallVsyncCallback();
 }
 
@@ -151,6 +163,8 @@ int GetVsyncFrameId() {
   return 0;
 }
 
+double GetVsyncTime() { return g_vsync_time.load(); }
+
 #endif  // __ANDROID__
 
 }  // namespace fplbase
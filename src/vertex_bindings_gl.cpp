@@ -0,0 +1,246 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "precompiled.h"
+#include "vertex_bindings_gl.h"
+
+#include "fplbase/glplatform.h"
+#include "fplbase/render_utils.h"
+#include "fplbase/renderer.h"
+#include "renderer_impl_gl.h"
+
+namespace fplbase {
+
+const unsigned int VertexBindings::kMaxLocations;
+
+// Whether `format` matches `saved`, both terminated by kEND.
+static bool SameFormat(const std::vector<Attribute> &saved,
+                       const Attribute *format) {
+  for (size_t i = 0; i < saved.size(); ++i) {
+    if (saved[i] != format[i]) return false;
+    if (format[i] == kEND) return true;
+  }
+  return false;
+}
+
+VertexBindings::VertexBindings()
+    : vao_(0),
+      vao_known_(false),
+      vao_left_(false),
+      enabled_(0),
+      known_(0),
+      mesh_vbo_(0),
+      mesh_stride_(0),
+      mesh_set_(false),
+      mesh_left_(false),
+      num_locations_(0) {}
+
+void VertexBindings::BindVertexArray(unsigned int vao) {
+  vao_left_ = false;
+  if (vao_known_ && vao_ == vao) return;
+  GL_CALL(glBindVertexArray(vao));
+  vao_ = vao;
+  vao_known_ = true;
+}
+
+void VertexBindings::BindMesh(unsigned int vbo, const Attribute *format,
+                              int stride) {
+  BindVertexArray(0);
+  mesh_left_ = false;
+  if (mesh_set_ && mesh_vbo_ == vbo && mesh_stride_ == stride &&
+      SameFormat(mesh_format_, format)) {
+    return;
+  }
+  // Arrays both formats use stay enabled; SetAttributes() only repoints
+  // them.
+  DisableAllBut(LocationMask(format));
+  SetAttributes(vbo, format, stride, nullptr);
+  mesh_vbo_ = vbo;
+  mesh_stride_ = stride;
+  mesh_format_.clear();
+  for (const Attribute *attribute = format;; ++attribute) {
+    mesh_format_.push_back(*attribute);
+    if (*attribute == kEND) break;
+  }
+  mesh_set_ = true;
+}
+
+void VertexBindings::ReleaseMesh() {
+  if (vao_ != 0) {
+    vao_left_ = true;
+  } else {
+    mesh_left_ = true;
+  }
+}
+
+void VertexBindings::Flush() {
+  if (vao_left_) BindVertexArray(0);
+  // A VAO bound on purpose, e.g. to set one up, keeps VAO 0's arrays for
+  // a later Flush().
+  if (mesh_left_ && vao_known_ && vao_ == 0) {
+    DisableAllBut(0);
+    mesh_set_ = false;
+    mesh_left_ = false;
+  }
+}
+
+void VertexBindings::Enable(unsigned int location) {
+  const bool cached = vao_known_ && vao_ == 0 && location < kMaxLocations;
+  const uint32_t bit = cached ? 1u << location : 0;
+  if (cached && (known_ & enabled_ & bit)) return;
+  GL_CALL(glEnableVertexAttribArray(location));
+  known_ |= bit;
+  enabled_ |= bit;
+}
+
+void VertexBindings::Disable(unsigned int location) {
+  const bool cached = vao_known_ && vao_ == 0 && location < kMaxLocations;
+  const uint32_t bit = cached ? 1u << location : 0;
+  if (cached && (known_ & ~enabled_ & bit)) return;
+  GL_CALL(glDisableVertexAttribArray(location));
+  known_ |= bit;
+  enabled_ &= ~bit;
+}
+
+void VertexBindings::ForgetBuffer(unsigned int vbo) {
+  // Its arrays now read buffer 0, so they're set up again next time, and
+  // still disabled by Flush().
+  if (mesh_vbo_ == vbo) mesh_set_ = false;
+}
+
+void VertexBindings::ForgetVertexArray(unsigned int vao) {
+  if (vao_known_ && vao_ == vao) {
+    vao_ = 0;
+    vao_left_ = false;
+  }
+}
+
+void VertexBindings::Invalidate() {
+  Flush();
+  vao_known_ = false;
+  vao_left_ = false;
+  known_ = 0;
+  mesh_set_ = false;
+  mesh_left_ = false;
+}
+
+// static
+uint32_t VertexBindings::LocationMask(const Attribute *format) {
+  uint32_t mask = 0;
+  for (;; ++format) {
+    switch (*format) {
+      case kPosition3f:
+      case kPosition2f:
+      case kPosition3h:
+        mask |= 1u << Mesh::kAttributePosition;
+        break;
+      case kNormal3f:
+      case kNormalOct2s:
+        mask |= 1u << Mesh::kAttributeNormal;
+        break;
+      case kTangent4f:
+        mask |= 1u << Mesh::kAttributeTangent;
+        break;
+      case kOrientation4f:
+      case kOrientationPacked:
+        mask |= 1u << Mesh::kAttributeOrientation;
+        break;
+      case kTexCoord2f:
+      case kTexCoord2us:
+      case kTexCoord2h:
+        mask |= 1u << Mesh::kAttributeTexCoord;
+        break;
+      case kTexCoordAlt2f:
+        mask |= 1u << Mesh::kAttributeTexCoordAlt;
+        break;
+      case kColor4ub:
+        mask |= 1u << Mesh::kAttributeColor;
+        break;
+      case kBoneIndices4ub:
+        mask |= 1u << Mesh::kAttributeBoneIndices;
+        break;
+      case kBoneWeights4ub:
+        mask |= 1u << Mesh::kAttributeBoneWeights;
+        break;
+      case kInstanceTransform3x4f:
+        mask |= 7u << Mesh::kAttributeInstanceTransform;
+        break;
+      case kInstanceColor4ub:
+        mask |= 1u << Mesh::kAttributeInstanceColor;
+        break;
+      case kInstancePaletteOffset1f:
+        mask |= 1u << Mesh::kAttributeInstancePaletteOffset;
+        break;
+      case kEND:
+        return mask;
+    }
+  }
+}
+
+void VertexBindings::DisableAllBut(uint32_t keep) {
+  assert(vao_known_ && vao_ == 0);
+  if (num_locations_ == 0) {
+    // ES2 GPUs may have as few as 8.
+    GLint max_attribs = 0;
+    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &max_attribs);
+    num_locations_ = std::min(static_cast<unsigned int>(max_attribs),
+                              kMaxLocations);
+  }
+  for (unsigned int location = 0; location < num_locations_; ++location) {
+    const uint32_t bit = 1u << location;
+    if ((keep & bit) || (known_ & ~enabled_ & bit)) continue;
+    GL_CALL(glDisableVertexAttribArray(location));
+    known_ |= bit;
+    enabled_ &= ~bit;
+  }
+}
+
+// static
+VertexBindings *VertexBindings::Get() {
+  RendererBase *base = RendererBase::Get();
+  return base->impl() ? &base->impl()->vertex_bindings : nullptr;
+}
+
+// static
+void VertexBindings::BindVertexArrayObject(unsigned int vao) {
+  VertexBindings *bindings = Get();
+  if (bindings) {
+    bindings->BindVertexArray(vao);
+  } else {
+    GL_CALL(glBindVertexArray(vao));
+  }
+}
+
+// static
+void VertexBindings::FlushBindings() {
+  VertexBindings *bindings = Get();
+  if (bindings) bindings->Flush();
+}
+
+// static
+void VertexBindings::DeleteVertexBuffer(unsigned int vbo) {
+  GLuint id = vbo;
+  GL_CALL(glDeleteBuffers(1, &id));
+  VertexBindings *bindings = Get();
+  if (bindings) bindings->ForgetBuffer(vbo);
+}
+
+// static
+void VertexBindings::DeleteVertexArray(unsigned int vao) {
+  GLuint id = vao;
+  GL_CALL(glDeleteVertexArrays(1, &id));
+  VertexBindings *bindings = Get();
+  if (bindings) bindings->ForgetVertexArray(vao);
+}
+
+}  // namespace fplbase
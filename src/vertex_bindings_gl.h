@@ -0,0 +1,118 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef FPLBASE_VERTEX_BINDINGS_GL_H
+#define FPLBASE_VERTEX_BINDINGS_GL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "fplbase/mesh.h"
+
+namespace fplbase {
+
+/// @brief The bound vertex array object and the enabled vertex attribute
+/// arrays, as far as fplbase knows, so that consecutive draws of meshes with
+/// the same vertex buffer and format cost no attribute setup.
+///
+/// Renderer's mesh draws leave their VAO, or without VAOs their attributes,
+/// set after the draw, as do RenderArray()'s draws with their format's VAO.
+/// The next mesh draw skips everything if it's the same mesh, and otherwise
+/// only disables the arrays the new format doesn't use. Anything else that
+/// sets attributes or binds buffers to GL_ELEMENT_ARRAY_BUFFER first calls
+/// Flush() (SetAttributes() and FlushBindings() do), which puts back the
+/// state the rest of fplbase expects: no VAO, no arrays enabled. Code that
+/// does so with GL directly must call Invalidate() (through
+/// Renderer::InvalidateVertexBindings()) first.
+class VertexBindings {
+ public:
+  VertexBindings();
+
+  /// @brief Bind `vao`, or 0 for none, skipping the call if it's bound.
+  void BindVertexArray(unsigned int vao);
+
+  /// @brief Set up the attributes of a mesh without a VAO, skipping
+  /// everything if they're still set by the previous BindMesh().
+  void BindMesh(unsigned int vbo, const Attribute *format, int stride);
+
+  /// @brief End a mesh draw started with BindMesh() or BindVertexArray(),
+  /// leaving its state for the next one.
+  void ReleaseMesh();
+
+  /// @brief Undo what ReleaseMesh() left set: unbind the VAO and disable the
+  /// mesh's attribute arrays.
+  void Flush();
+
+  /// @brief Enable or disable an attribute array of the bound VAO, skipping
+  /// the call if it's already so.
+  void Enable(unsigned int location);
+  void Disable(unsigned int location);
+
+  /// @brief Record that `vbo` has been deleted.
+  void ForgetBuffer(unsigned int vbo);
+
+  /// @brief Record that `vao` has been deleted, which unbinds it.
+  void ForgetVertexArray(unsigned int vao);
+
+  /// @brief Flush(), then forget everything, so the next calls go to GL.
+  void Invalidate();
+
+  /// @brief The renderer's bindings, or nullptr before there's a renderer.
+  static VertexBindings *Get();
+
+  /// @brief BindVertexArray() with the renderer's bindings, or straight to
+  /// GL if there are none.
+  static void BindVertexArrayObject(unsigned int vao);
+
+  /// @brief Flush() the renderer's bindings, if there are any, e.g. before
+  /// binding an index buffer to upload to it.
+  static void FlushBindings();
+
+  /// @brief Delete vertex buffer `vbo` and ForgetBuffer() it.
+  static void DeleteVertexBuffer(unsigned int vbo);
+
+  /// @brief Delete `vao` and ForgetVertexArray() it.
+  static void DeleteVertexArray(unsigned int vao);
+
+  /// @brief Attribute locations past this are set without a cache.
+  static const unsigned int kMaxLocations = 16;
+
+ private:
+  // The attribute locations `format` uses.
+  static uint32_t LocationMask(const Attribute *format);
+  // Disable the arrays of VAO 0 that may be enabled and aren't in `keep`.
+  void DisableAllBut(uint32_t keep);
+
+  unsigned int vao_;
+  bool vao_known_;
+  // Whether a mesh draw left vao_ bound.
+  bool vao_left_;
+  // Enabled attribute arrays of VAO 0, trusted where `known_` has a bit set.
+  uint32_t enabled_;
+  uint32_t known_;
+  // The mesh whose attributes the last BindMesh() set, if they still are.
+  unsigned int mesh_vbo_;
+  std::vector<Attribute> mesh_format_;
+  int mesh_stride_;
+  bool mesh_set_;
+  // Whether a mesh draw left its attribute arrays enabled on VAO 0.
+  bool mesh_left_;
+  // How many locations DisableAllBut() covers: GL_MAX_VERTEX_ATTRIBS, up to
+  // kMaxLocations. 0 until queried.
+  unsigned int num_locations_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_VERTEX_BINDINGS_GL_H
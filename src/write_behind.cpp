@@ -0,0 +1,198 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "precompiled.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "fplbase/file_utilities.h"
+#include "fplbase/utilities.h"
+#include "write_behind.h"
+
+namespace fplbase {
+
+namespace {
+
+// The writes for each kind of destination, by file name or key. Writing the
+// same one again only replaces the data, so is free until it's written.
+struct WriteBatch {
+  std::map<std::string, std::string> files;
+  std::map<std::string, std::string> preferences;
+  std::map<std::string, int32_t> preference_values;
+
+  bool empty() const {
+    return files.empty() && preferences.empty() && preference_values.empty();
+  }
+  void clear() {
+    files.clear();
+    preferences.clear();
+    preference_values.clear();
+  }
+};
+
+class WriteBehindQueue {
+ public:
+  WriteBehindQueue()
+      : enabled_(false), stop_(false), writing_(false), failed_(false) {}
+  ~WriteBehindQueue() { SetEnabled(false); }
+
+  void SetEnabled(bool enabled) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (enabled == enabled_) return;
+    enabled_ = enabled;
+    if (enabled) {
+      stop_ = false;
+      thread_ = std::thread(&WriteBehindQueue::WriterThread, this);
+      return;
+    }
+    // The thread writes whatever is still queued before it exits.
+    stop_ = true;
+    cv_.notify_all();
+    lock.unlock();
+    thread_.join();
+  }
+
+  bool Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!queued_.empty() || writing_) cv_.wait(lock);
+    const bool ok = !failed_;
+    failed_ = false;
+    return ok;
+  }
+
+  // Runs `queue` on the queued batch with the lock held, if enabled.
+  template <typename F>
+  bool Queue(const F &queue) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!enabled_) return false;
+    queue(&queued_);
+    cv_.notify_all();
+    return true;
+  }
+
+  // Runs `find` on the queued batch, then the one being written, until it
+  // returns true. The queued one is newer.
+  template <typename F>
+  bool Find(const F &find) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return find(queued_) || find(writing_batch_);
+  }
+
+ private:
+  void WriterThread() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      while (!stop_ && queued_.empty()) cv_.wait(lock);
+      if (queued_.empty()) break;
+      std::swap(queued_, writing_batch_);
+      writing_ = true;
+      lock.unlock();
+      const bool ok = Write(writing_batch_);
+      lock.lock();
+      writing_batch_.clear();
+      writing_ = false;
+      if (!ok) failed_ = true;
+      cv_.notify_all();
+    }
+  }
+
+  // Writes `batch` without the lock held. It's left alone by other threads
+  // while `writing_` is set, other than to be read by Find().
+  static bool Write(const WriteBatch &batch) {
+    bool ok = true;
+    for (auto it = batch.files.begin(); it != batch.files.end(); ++it) {
+      ok &= SaveFileRaw(it->first.c_str(), it->second.data(),
+                        it->second.size());
+    }
+    for (auto it = batch.preferences.begin(); it != batch.preferences.end();
+         ++it) {
+      ok &= SavePreferencesRaw(it->first.c_str(), it->second.data(),
+                               it->second.size());
+    }
+    for (auto it = batch.preference_values.begin();
+         it != batch.preference_values.end(); ++it) {
+      ok &= SavePreferenceRaw(it->first.c_str(), it->second);
+    }
+    return ok;
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+  bool enabled_;
+  bool stop_;
+  // The writes yet to be started.
+  WriteBatch queued_;
+  // The writes the thread is doing now, if `writing_`.
+  WriteBatch writing_batch_;
+  bool writing_;
+  // Whether a write failed since the last Flush().
+  bool failed_;
+};
+
+WriteBehindQueue g_write_behind;
+
+}  // namespace
+
+void SetWriteBehind(bool enabled) { g_write_behind.SetEnabled(enabled); }
+
+bool FlushWrites() { return g_write_behind.Flush(); }
+
+bool QueueFileWrite(const char *filename, const void *data, size_t size) {
+  return g_write_behind.Queue([=](WriteBatch *batch) {
+    batch->files[filename].assign(static_cast<const char *>(data), size);
+  });
+}
+
+bool QueuePreferencesWrite(const char *filename, const void *data,
+                           size_t size) {
+  return g_write_behind.Queue([=](WriteBatch *batch) {
+    batch->preferences[filename].assign(static_cast<const char *>(data), size);
+  });
+}
+
+bool QueuePreferenceWrite(const char *key, int32_t value) {
+  return g_write_behind.Queue(
+      [=](WriteBatch *batch) { batch->preference_values[key] = value; });
+}
+
+bool FindQueuedFileWrite(const char *filename, std::string *dest) {
+  return g_write_behind.Find([=](const WriteBatch &batch) {
+    auto it = batch.files.find(filename);
+    if (it == batch.files.end()) return false;
+    *dest = it->second;
+    return true;
+  });
+}
+
+bool FindQueuedPreferencesWrite(const char *filename, std::string *dest) {
+  return g_write_behind.Find([=](const WriteBatch &batch) {
+    auto it = batch.preferences.find(filename);
+    if (it == batch.preferences.end()) return false;
+    *dest = it->second;
+    return true;
+  });
+}
+
+bool FindQueuedPreferenceWrite(const char *key, int32_t *value) {
+  return g_write_behind.Find([=](const WriteBatch &batch) {
+    auto it = batch.preference_values.find(key);
+    if (it == batch.preference_values.end()) return false;
+    *value = it->second;
+    return true;
+  });
+}
+
+}  // namespace fplbase
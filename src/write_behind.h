@@ -0,0 +1,44 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef FPLBASE_WRITE_BEHIND_H
+#define FPLBASE_WRITE_BEHIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace fplbase {
+
+// The writes SavePreferences() and SavePreference() queue, done straight away
+// on the calling thread. Defined in utilities.cpp.
+bool SavePreferencesRaw(const char *filename, const void *data, size_t size);
+bool SavePreferenceRaw(const char *key, int32_t value);
+
+// Queue a write for the write-behind thread, replacing any queued write to the
+// same file or key. Return false, queueing nothing, if write-behind is off, in
+// which case the caller writes it itself.
+bool QueueFileWrite(const char *filename, const void *data, size_t size);
+bool QueuePreferencesWrite(const char *filename, const void *data,
+                           size_t size);
+bool QueuePreferenceWrite(const char *key, int32_t value);
+
+// The data of a queued write that's yet to complete, so loads see it.
+// Return false if there's none.
+bool FindQueuedFileWrite(const char *filename, std::string *dest);
+bool FindQueuedPreferencesWrite(const char *filename, std::string *dest);
+bool FindQueuedPreferenceWrite(const char *key, int32_t *value);
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_WRITE_BEHIND_H
@@ -66,6 +66,7 @@ import com.google.vrtoolkit.cardboard.ScreenParams;
 import com.google.vrtoolkit.cardboard.sensors.MagnetSensor;
 import com.google.vrtoolkit.cardboard.sensors.NfcSensor;
 import org.libsdl.app.SDLActivity;
+import java.lang.reflect.Method;
 
 public class FPLActivity extends SDLActivity implements
     MagnetSensor.OnCardboardTriggerListener, NfcSensor.OnCardboardNfcListener,
@@ -447,6 +448,21 @@ public class FPLActivity extends SDLActivity implements
     return uiModeManager.getCurrentModeType() == Configuration.UI_MODE_TYPE_TELEVISION;
   }
 
+  // Returns PowerManager.getCurrentThermalStatus(), or 0 (none) where it's
+  // not available. Looked up by reflection, so this builds with older SDKs.
+  public int GetThermalStatus() {
+    final int BUILD_VERSION_Q = 29;
+    if (android.os.Build.VERSION.SDK_INT < BUILD_VERSION_Q) return 0;
+    try {
+      Object powerManager = getSystemService(Context.POWER_SERVICE);
+      Method getStatus =
+          powerManager.getClass().getMethod("getCurrentThermalStatus");
+      return (Integer)getStatus.invoke(powerManager);
+    } catch (Exception e) {
+      return 0;
+    }
+  }
+
   // Function to access the transforms of the eyes, which includes head tracking
   public void GetEyeViews(float[] headView, float[] leftTransform, float[] rightTransform) {
     if (cardboardView == null) return;
@@ -533,7 +549,7 @@ public class FPLActivity extends SDLActivity implements
 
   public void doFrame(long frameTimeNanos) {
     // Respond to event:
-    nativeOnVsync();
+    nativeOnVsync(frameTimeNanos);
     // Renew our callback:
     Choreographer.getInstance().postFrameCallback(this);
   }
@@ -556,7 +572,7 @@ public class FPLActivity extends SDLActivity implements
   private static native void nativeCleanupVsync();
 
   // Implemented in C++. (utilities.cpp)
-  private static native void nativeOnVsync();
+  private static native void nativeOnVsync(long frameTimeNanos);
 
   // Implemented in C++. (gpg_manager.cpp)
   private static native void nativeOnActivityResult(
@@ -0,0 +1,82 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "fplbase/culling.h"
+#include "fplbase/mesh.h"
+#include "gtest/gtest.h"
+#include "mathfu/glsl_mappings.h"
+
+using fplbase::CullInstance;
+using fplbase::Frustum;
+using fplbase::Mesh;
+using fplbase::VisibleSubmesh;
+using mathfu::mat4;
+using mathfu::vec3;
+
+class CullingTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+// With an identity transform the frustum is the clip space cube.
+TEST_F(CullingTests, ClipSpaceCube) {
+  const Frustum frustum(mat4::Identity());
+  EXPECT_TRUE(frustum.IntersectsBox(vec3(-0.5f), vec3(0.5f)));
+  EXPECT_TRUE(frustum.IntersectsBox(vec3(-2.0f), vec3(2.0f)));
+  EXPECT_TRUE(frustum.IntersectsBox(vec3(0.9f), vec3(1.5f)));
+  EXPECT_FALSE(frustum.IntersectsBox(vec3(1.1f), vec3(1.5f)));
+  EXPECT_FALSE(frustum.IntersectsBox(vec3(-3.0f, 0.0f, 0.0f),
+                                     vec3(-2.0f, 1.0f, 1.0f)));
+  EXPECT_FALSE(frustum.IntersectsBox(vec3(0.0f, 0.0f, -3.0f),
+                                     vec3(0.5f, 0.5f, -1.5f)));
+}
+
+// Boxes are tested in the space the transform takes into clip space.
+TEST_F(CullingTests, Perspective) {
+  const mat4 projection = mat4::Perspective(1.0f, 1.0f, 1.0f, 100.0f);
+  const Frustum frustum(projection);
+  // The camera looks down -z.
+  EXPECT_TRUE(frustum.IntersectsBox(vec3(-1.0f, -1.0f, -11.0f),
+                                    vec3(1.0f, 1.0f, -9.0f)));
+  EXPECT_FALSE(frustum.IntersectsBox(vec3(-1.0f, -1.0f, 9.0f),
+                                     vec3(1.0f, 1.0f, 11.0f)));
+  // Beyond the far plane.
+  EXPECT_FALSE(frustum.IntersectsBox(vec3(-1.0f, -1.0f, -210.0f),
+                                     vec3(1.0f, 1.0f, -200.0f)));
+  // Off to the side.
+  EXPECT_FALSE(frustum.IntersectsBox(vec3(40.0f, -1.0f, -11.0f),
+                                     vec3(42.0f, 1.0f, -9.0f)));
+  EXPECT_TRUE(frustum.IntersectsBox(vec3(3.0f, -1.0f, -11.0f),
+                                    vec3(50.0f, 1.0f, -9.0f)));
+}
+
+// Meshes that aren't loaded are skipped rather than drawn.
+TEST_F(CullingTests, SkipsUnloadedMeshes) {
+  Mesh mesh;
+  const mat4 world = mat4::Identity();
+  const CullInstance instances[] = {CullInstance(&mesh, &world),
+                                    CullInstance(nullptr, &world)};
+  std::vector<VisibleSubmesh> visible(1);
+  EXPECT_EQ(0u, fplbase::CullSubmeshes(mat4::Identity(), instances, 2,
+                                       &visible));
+  EXPECT_TRUE(visible.empty());
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,92 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fplbase/dynamic_resolution.h"
+#include "gtest/gtest.h"
+
+using fplbase::DynamicResolution;
+
+static const double kTarget = 1.0 / 60.0;
+
+class DynamicResolutionTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() { resolution_.set_poll_thermal_status(false); }
+  virtual void TearDown() {}
+
+  // Run `frames` frames whose full-resolution GPU time is `full_time`, with
+  // the GPU time following the number of pixels rendered.
+  void Run(double full_time, int frames) {
+    for (int i = 0; i < frames; ++i) {
+      const double scale = resolution_.scale();
+      resolution_.Update(full_time * scale * scale, i * kTarget);
+    }
+  }
+
+  DynamicResolution resolution_;
+};
+
+// Frames within budget stay at full resolution.
+TEST_F(DynamicResolutionTests, WithinBudget) {
+  Run(0.8 * kTarget, 100);
+  EXPECT_FLOAT_EQ(1.0f, resolution_.scale());
+}
+
+// An overloaded GPU lowers the scale until the frames fit, and it recovers
+// once the load goes away.
+TEST_F(DynamicResolutionTests, ScalesDownAndUp) {
+  Run(1.6 * kTarget, 300);
+  const float scale = resolution_.scale();
+  EXPECT_LT(scale, 0.85f);
+  EXPECT_GT(scale, resolution_.min_scale());
+  const double time = 1.6 * kTarget * scale * scale;
+  EXPECT_LT(time, kTarget);
+  EXPECT_GT(time, 0.7 * kTarget);
+
+  Run(0.5 * kTarget, 300);
+  EXPECT_FLOAT_EQ(1.0f, resolution_.scale());
+}
+
+// The scale never leaves the range it's given.
+TEST_F(DynamicResolutionTests, ClampsToRange) {
+  resolution_.set_scale_range(0.6f, 0.9f);
+  Run(10.0 * kTarget, 300);
+  EXPECT_FLOAT_EQ(0.6f, resolution_.scale());
+  Run(0.1 * kTarget, 300);
+  EXPECT_FLOAT_EQ(0.9f, resolution_.scale());
+}
+
+// Throttling caps the scale, however fast the frames are.
+TEST_F(DynamicResolutionTests, ThermalCap) {
+  resolution_.set_thermal_status(fplbase::kThermalStatusSevere);
+  Run(0.1 * kTarget, 100);
+  EXPECT_FLOAT_EQ(resolution_.scale_cap(), resolution_.scale());
+  EXPECT_LT(resolution_.scale(), 0.7f);
+  resolution_.set_thermal_status(fplbase::kThermalStatusCritical);
+  Run(0.1 * kTarget, 1);
+  EXPECT_FLOAT_EQ(resolution_.min_scale(), resolution_.scale());
+}
+
+// Scaled sizes are whole blocks of 8 pixels, within the screen.
+TEST_F(DynamicResolutionTests, ScaledSize) {
+  const mathfu::vec2i screen(1920, 1083);
+  EXPECT_EQ(mathfu::vec2i(1920, 1083), DynamicResolution::ScaledSize(screen, 1));
+  EXPECT_EQ(mathfu::vec2i(1440, 816),
+            DynamicResolution::ScaledSize(screen, 0.75f));
+  EXPECT_EQ(mathfu::vec2i(8, 8), DynamicResolution::ScaledSize(screen, 0));
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,244 @@
+// Copyright 2026 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include "fplbase/internal/etc2_encoder.h"
+#include "gtest/gtest.h"
+
+class Etc2EncoderTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+static const int kEtcModifiers[8][2] = {
+    {2, 8},   {5, 17},  {9, 29},   {13, 42},
+    {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+static const int kEacModifiers[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12}, {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},  {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},  {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},  {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},   {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+static int Clamp255(int v) { return std::min(std::max(v, 0), 255); }
+
+static uint64_t LoadBigEndian(const uint8_t *block) {
+  uint64_t bits = 0;
+  for (int i = 0; i < 8; ++i) bits = (bits << 8) | block[i];
+  return bits;
+}
+
+// Decodes an ETC2 color block into rows of RGBA pixels. Fails the test on
+// the ETC2-only modes, which the encoder doesn't write.
+static void DecodeColorBlock(const uint8_t *block, uint8_t *rgba) {
+  const uint64_t bits = LoadBigEndian(block);
+  const bool differential = (bits >> 33) & 1;
+  const bool flip = (bits >> 32) & 1;
+  int base[2][3];
+  for (int c = 0; c < 3; ++c) {
+    const int shift = 56 - c * 8;
+    if (differential) {
+      const int first = (bits >> (shift + 3)) & 31;
+      int delta = (bits >> shift) & 7;
+      if (delta >= 4) delta -= 8;
+      const int second = first + delta;
+      ASSERT_TRUE(second >= 0 && second <= 31);
+      base[0][c] = (first << 3) | (first >> 2);
+      base[1][c] = (second << 3) | (second >> 2);
+    } else {
+      base[0][c] = ((bits >> (shift + 4)) & 15) * 17;
+      base[1][c] = ((bits >> shift) & 15) * 17;
+    }
+  }
+  const int tables[2] = {static_cast<int>((bits >> 37) & 7),
+                         static_cast<int>((bits >> 34) & 7)};
+  for (int y = 0; y < 4; ++y) {
+    for (int x = 0; x < 4; ++x) {
+      const int half = flip ? y / 2 : x / 2;
+      const int bit = x * 4 + y;
+      const int index = static_cast<int>(((bits >> (16 + bit)) & 1) << 1 |
+                                         ((bits >> bit) & 1));
+      const int *table = kEtcModifiers[tables[half]];
+      const int modifier = index & 1 ? table[1] : table[0];
+      const int signed_modifier = index & 2 ? -modifier : modifier;
+      for (int c = 0; c < 3; ++c) {
+        rgba[(y * 4 + x) * 4 + c] =
+            static_cast<uint8_t>(Clamp255(base[half][c] + signed_modifier));
+      }
+    }
+  }
+}
+
+static void DecodeAlphaBlock(const uint8_t *block, uint8_t *rgba) {
+  const uint64_t bits = LoadBigEndian(block);
+  const int base = static_cast<int>(bits >> 56);
+  const int multiplier = static_cast<int>((bits >> 52) & 15);
+  const int *table = kEacModifiers[(bits >> 48) & 15];
+  for (int x = 0; x < 4; ++x) {
+    for (int y = 0; y < 4; ++y) {
+      const int index = static_cast<int>((bits >> (45 - 3 * (x * 4 + y))) & 7);
+      rgba[(y * 4 + x) * 4 + 3] =
+          static_cast<uint8_t>(Clamp255(base + table[index] * multiplier));
+    }
+  }
+}
+
+// Encodes and decodes a `width` x `height` RGBA image.
+static std::vector<uint8_t> RoundTrip(const std::vector<uint8_t> &image,
+                                      int width, int height, bool alpha) {
+  std::vector<uint8_t> encoded(fplbase::Etc2ImageSize(width, height, alpha));
+  fplbase::EncodeEtc2Image(image.data(), width, height, 4, alpha,
+                           encoded.data());
+  std::vector<uint8_t> decoded(image.size(), 255);
+  const uint8_t *block = encoded.data();
+  for (int block_y = 0; block_y < height; block_y += 4) {
+    for (int block_x = 0; block_x < width; block_x += 4) {
+      uint8_t pixels[16 * 4];
+      std::fill(pixels, pixels + sizeof(pixels), 255);
+      if (alpha) {
+        DecodeAlphaBlock(block, pixels);
+        block += 8;
+      }
+      DecodeColorBlock(block, pixels);
+      block += 8;
+      for (int y = 0; y < 4 && block_y + y < height; ++y) {
+        for (int x = 0; x < 4 && block_x + x < width; ++x) {
+          std::copy(pixels + (y * 4 + x) * 4, pixels + (y * 4 + x) * 4 + 4,
+                    decoded.begin() + ((block_y + y) * width + block_x + x) * 4);
+        }
+      }
+    }
+  }
+  return decoded;
+}
+
+static int MaxError(const std::vector<uint8_t> &a,
+                    const std::vector<uint8_t> &b, int channel) {
+  int error = 0;
+  for (size_t i = channel; i < a.size(); i += 4) {
+    error = std::max(error, abs(a[i] - b[i]));
+  }
+  return error;
+}
+
+static double MeanSquaredError(const std::vector<uint8_t> &a,
+                               const std::vector<uint8_t> &b) {
+  double sum = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    const int error = a[i] - b[i];
+    sum += error * error;
+  }
+  return sum / static_cast<double>(a.size());
+}
+
+TEST_F(Etc2EncoderTests, ImageSize) {
+  EXPECT_EQ(8u, fplbase::Etc2ImageSize(4, 4, false));
+  EXPECT_EQ(16u, fplbase::Etc2ImageSize(4, 4, true));
+  EXPECT_EQ(4u * 8u, fplbase::Etc2ImageSize(5, 8, false));
+  EXPECT_EQ(32u * 16u * 16u, fplbase::Etc2ImageSize(128, 64, true));
+}
+
+TEST_F(Etc2EncoderTests, SolidColors) {
+  const uint8_t colors[][4] = {{0, 0, 0, 255},     {255, 255, 255, 0},
+                               {255, 0, 0, 128},   {12, 200, 99, 17},
+                               {128, 128, 128, 1}, {3, 250, 7, 254}};
+  for (size_t i = 0; i < sizeof(colors) / sizeof(colors[0]); ++i) {
+    std::vector<uint8_t> image(4 * 4 * 4);
+    for (size_t p = 0; p < image.size(); ++p) image[p] = colors[i][p % 4];
+    const std::vector<uint8_t> decoded = RoundTrip(image, 4, 4, true);
+    for (int c = 0; c < 3; ++c) EXPECT_LE(MaxError(image, decoded, c), 6);
+    EXPECT_EQ(0, MaxError(image, decoded, 3));
+  }
+}
+
+TEST_F(Etc2EncoderTests, Gradient) {
+  const int width = 64;
+  const int height = 32;
+  std::vector<uint8_t> image(width * height * 4);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8_t *p = &image[(y * width + x) * 4];
+      p[0] = static_cast<uint8_t>(x * 4);
+      p[1] = static_cast<uint8_t>(y * 8);
+      p[2] = static_cast<uint8_t>(255 - x * 2 - y * 2);
+      p[3] = static_cast<uint8_t>((x + y) * 255 / (width + height - 2));
+    }
+  }
+  const std::vector<uint8_t> decoded = RoundTrip(image, width, height, true);
+  // About 36dB PSNR.
+  EXPECT_LT(MeanSquaredError(image, decoded), 16.0);
+  EXPECT_LE(MaxError(image, decoded, 3), 4);
+}
+
+// Halves too far apart for differential mode fall back to individual colors.
+TEST_F(Etc2EncoderTests, SplitBlocks) {
+  for (int flip = 0; flip < 2; ++flip) {
+    std::vector<uint8_t> image(4 * 4 * 4, 255);
+    for (int y = 0; y < 4; ++y) {
+      for (int x = 0; x < 4; ++x) {
+        const bool first = (flip ? y : x) < 2;
+        uint8_t *p = &image[(y * 4 + x) * 4];
+        p[0] = first ? 250 : 10;
+        p[1] = first ? 20 : 60;
+        p[2] = first ? 40 : 230;
+      }
+    }
+    const std::vector<uint8_t> decoded = RoundTrip(image, 4, 4, false);
+    for (int c = 0; c < 3; ++c) EXPECT_LE(MaxError(image, decoded, c), 10);
+  }
+}
+
+// Noise exercises every mode and table, and must always decode as ETC1.
+TEST_F(Etc2EncoderTests, Noise) {
+  const int width = 36;
+  const int height = 20;
+  std::vector<uint8_t> image(width * height * 4);
+  uint32_t state = 12345;
+  for (size_t i = 0; i < image.size(); ++i) {
+    state = state * 1664525u + 1013904223u;
+    image[i] = static_cast<uint8_t>(state >> 24);
+  }
+  const std::vector<uint8_t> decoded = RoundTrip(image, width, height, true);
+  EXPECT_LT(MeanSquaredError(image, decoded), 3000.0);
+}
+
+// The last partial blocks repeat the edge pixels.
+TEST_F(Etc2EncoderTests, PartialBlocks) {
+  const int width = 6;
+  const int height = 5;
+  std::vector<uint8_t> image(width * height * 4);
+  for (int i = 0; i < width * height; ++i) {
+    image[i * 4 + 0] = 200;
+    image[i * 4 + 1] = 100;
+    image[i * 4 + 2] = 50;
+    image[i * 4 + 3] = 255;
+  }
+  const std::vector<uint8_t> decoded = RoundTrip(image, width, height, false);
+  for (int c = 0; c < 3; ++c) EXPECT_LE(MaxError(image, decoded, c), 6);
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,91 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fplbase/frame_pacer.h"
+#include "gtest/gtest.h"
+
+using fplbase::FramePacer;
+
+static const double kPeriod = 1.0 / 60.0;
+static const double kEpsilon = 1e-6;
+
+class FramePacerTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+// Without any vsyncs, frames start straight away.
+TEST_F(FramePacerTests, NoVsyncStartsNow) {
+  FramePacer pacer;
+  pacer.set_pacing(fplbase::kFramePacing30Hz);
+  EXPECT_DOUBLE_EQ(1.5, pacer.BeginFrame(1.5));
+}
+
+// The period is measured, even with vsyncs missing in between.
+TEST_F(FramePacerTests, MeasuresPeriod) {
+  FramePacer pacer;
+  const double period = 1.0 / 62.0;
+  double time = 1.0;
+  for (int i = 0; i < 200; ++i) {
+    time += (i % 3 == 0 ? 2 : 1) * period;
+    pacer.OnVsync(time);
+  }
+  EXPECT_NEAR(period, pacer.vsync_period(), kEpsilon);
+}
+
+// Unpaced frames start when asked, and present a vsync after the next.
+TEST_F(FramePacerTests, Unpaced) {
+  FramePacer pacer;
+  pacer.OnVsync(1.0);
+  const double now = 1.0 + 0.6 * kPeriod;
+  EXPECT_DOUBLE_EQ(now, pacer.BeginFrame(now));
+  EXPECT_EQ(1, pacer.swap_interval());
+  EXPECT_NEAR(1.0 + 2 * kPeriod, pacer.predicted_present_time(), kEpsilon);
+}
+
+// At 30Hz on a 60Hz display, a frame that finishes early waits for its
+// second vsync, and one that finishes late starts on the next vsync.
+TEST_F(FramePacerTests, Paced30Hz) {
+  FramePacer pacer;
+  pacer.set_pacing(fplbase::kFramePacing30Hz);
+  EXPECT_EQ(2, pacer.swap_interval());
+  pacer.OnVsync(1.0);
+  EXPECT_NEAR(1.0, pacer.BeginFrame(1.0 + 0.1 * kPeriod), kEpsilon);
+  EXPECT_NEAR(1.0 + 3 * kPeriod, pacer.predicted_present_time(), kEpsilon);
+
+  pacer.OnVsync(1.0 + kPeriod);
+  EXPECT_NEAR(1.0 + 2 * kPeriod, pacer.BeginFrame(1.0 + 1.2 * kPeriod),
+              kEpsilon);
+
+  pacer.OnVsync(1.0 + 4 * kPeriod);
+  EXPECT_NEAR(1.0 + 5 * kPeriod, pacer.BeginFrame(1.0 + 4.5 * kPeriod),
+              kEpsilon);
+}
+
+// Rates the display can't reach run at its refresh rate.
+TEST_F(FramePacerTests, RateAboveRefresh) {
+  FramePacer pacer;
+  pacer.set_pacing(fplbase::kFramePacing90Hz);
+  EXPECT_EQ(1, pacer.swap_interval());
+  pacer.set_vsync_period(1.0 / 90.0);
+  EXPECT_EQ(1, pacer.swap_interval());
+  pacer.set_pacing(fplbase::kFramePacing30Hz);
+  EXPECT_EQ(3, pacer.swap_interval());
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
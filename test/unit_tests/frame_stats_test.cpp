@@ -0,0 +1,85 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fplbase/frame_stats.h"
+#include "gtest/gtest.h"
+
+using fplbase::FrameStats;
+
+class FrameStatsTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+TEST_F(FrameStatsTests, EmptyIsZero) {
+  FrameStats stats;
+  const FrameStats::Summary summary = stats.Summarize();
+  EXPECT_EQ(0u, summary.num_frames);
+  EXPECT_EQ(0.0, summary.p99);
+  EXPECT_EQ(0.0, stats.FramePercentile(50));
+  EXPECT_EQ(0.0, stats.last_frame_time());
+}
+
+// Percentiles are by nearest rank over the frames in the window.
+TEST_F(FrameStatsTests, Percentiles) {
+  FrameStats stats(100);
+  // Frame times 1..100ms, out of order.
+  for (int i = 0; i < 100; ++i) {
+    const int ms = (i * 37) % 100 + 1;
+    stats.AddFrame(ms / 1000.0, ms / 2000.0);
+  }
+  const FrameStats::Summary summary = stats.Summarize();
+  EXPECT_EQ(100u, summary.num_frames);
+  EXPECT_DOUBLE_EQ(0.001, summary.minimum);
+  EXPECT_DOUBLE_EQ(0.100, summary.maximum);
+  EXPECT_DOUBLE_EQ(0.050, summary.p50);
+  EXPECT_DOUBLE_EQ(0.095, summary.p95);
+  EXPECT_DOUBLE_EQ(0.099, summary.p99);
+  EXPECT_DOUBLE_EQ(0.0505, summary.average);
+  EXPECT_DOUBLE_EQ(0.0475, summary.p95_swap);
+  EXPECT_DOUBLE_EQ(0.100, stats.FramePercentile(100));
+  EXPECT_DOUBLE_EQ(0.001, stats.FramePercentile(0));
+  // Every frame over 25ms is jank.
+  EXPECT_EQ(75u, summary.jank_frames);
+}
+
+// Only the most recent frames count towards the window, but all of them
+// count towards the totals.
+TEST_F(FrameStatsTests, Window) {
+  FrameStats stats(4);
+  stats.set_jank_threshold(0.030);
+  const double times[] = {0.1, 0.1, 0.1, 0.010, 0.020, 0.015, 0.040};
+  for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); ++i) {
+    stats.AddFrame(times[i], 0);
+  }
+  EXPECT_EQ(4u, stats.num_frames());
+  EXPECT_EQ(7u, stats.total_frames());
+  EXPECT_EQ(4u, stats.total_jank_frames());
+  EXPECT_DOUBLE_EQ(0.040, stats.last_frame_time());
+  const FrameStats::Summary summary = stats.Summarize();
+  EXPECT_DOUBLE_EQ(0.010, summary.minimum);
+  EXPECT_DOUBLE_EQ(0.040, summary.maximum);
+  EXPECT_EQ(1u, summary.jank_frames);
+
+  stats.Reset();
+  EXPECT_EQ(0u, stats.num_frames());
+  EXPECT_EQ(0u, stats.total_frames());
+  EXPECT_EQ(0u, stats.total_jank_frames());
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
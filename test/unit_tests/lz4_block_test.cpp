@@ -0,0 +1,93 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include <vector>
+
+#include "fplbase/internal/lz4_block.h"
+#include "gtest/gtest.h"
+
+class Lz4BlockTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+// Bytes drawn from `num_symbols` values, so the data ranges from runs of one
+// byte to incompressible noise.
+static std::vector<uint8_t> TestBytes(size_t size, uint32_t num_symbols) {
+  std::vector<uint8_t> bytes(size);
+  uint32_t state = 12345;
+  for (size_t i = 0; i < size; ++i) {
+    state = state * 1664525u + 1013904223u;
+    bytes[i] = static_cast<uint8_t>((state >> 16) % num_symbols);
+  }
+  return bytes;
+}
+
+static std::vector<uint8_t> Compress(const std::vector<uint8_t> &src) {
+  std::vector<uint8_t> dest(fplbase::Lz4BlockBound(src.size()));
+  dest.resize(fplbase::CompressLz4Block(src.data(), src.size(), dest.data()));
+  return dest;
+}
+
+static const size_t kSizes[] = {0, 1, 5, 12, 13, 17, 100, 4096, 100000};
+static const uint32_t kNumSymbols[] = {1, 2, 16, 256};
+
+// Check data of every size and entropy survives a roundtrip.
+TEST_F(Lz4BlockTests, Roundtrip) {
+  for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i) {
+    for (size_t j = 0; j < sizeof(kNumSymbols) / sizeof(kNumSymbols[0]); ++j) {
+      const std::vector<uint8_t> src = TestBytes(kSizes[i], kNumSymbols[j]);
+      const std::vector<uint8_t> compressed = Compress(src);
+      EXPECT_LE(compressed.size(), fplbase::Lz4BlockBound(src.size()));
+      std::vector<uint8_t> dest(src.size());
+      EXPECT_TRUE(fplbase::DecompressLz4Block(
+          compressed.data(), compressed.size(), dest.data(), dest.size()));
+      EXPECT_EQ(src, dest) << kSizes[i] << " bytes, " << kNumSymbols[j]
+                           << " symbols";
+    }
+  }
+}
+
+// Check repetitive data, like the flat areas of a texture, gets smaller.
+TEST_F(Lz4BlockTests, Compresses) {
+  std::vector<uint8_t> src(100000);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<uint8_t>(i / 256);
+  }
+  EXPECT_LT(Compress(src).size(), src.size() / 2);
+}
+
+// Check truncated blocks and wrong sizes are rejected rather than overrun.
+TEST_F(Lz4BlockTests, RejectsBadInput) {
+  const std::vector<uint8_t> src = TestBytes(4096, 16);
+  const std::vector<uint8_t> compressed = Compress(src);
+  std::vector<uint8_t> dest(src.size() + 1);
+  EXPECT_FALSE(fplbase::DecompressLz4Block(
+      compressed.data(), compressed.size() - 1, dest.data(), src.size()));
+  EXPECT_FALSE(fplbase::DecompressLz4Block(
+      compressed.data(), compressed.size(), dest.data(), src.size() - 1));
+  EXPECT_FALSE(fplbase::DecompressLz4Block(
+      compressed.data(), compressed.size(), dest.data(), src.size() + 1));
+  // A match reaching back before the start of the output.
+  const uint8_t bad_offset[] = {0x10, 'a', 0x02, 0x00, 0x00};
+  EXPECT_FALSE(fplbase::DecompressLz4Block(bad_offset, sizeof(bad_offset),
+                                           dest.data(), 5));
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
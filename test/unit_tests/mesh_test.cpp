@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "fplbase/mesh.h"
+#include "fplbase/vertex_format.h"
 #include "gtest/gtest.h"
 
 namespace fplbase {
@@ -27,6 +28,10 @@ const Attribute kPIW[] = {kPosition3f, kBoneIndices4ub, kBoneWeights4ub, kEND};
 const Attribute kPUvC[] = {kPosition3f, kTexCoord2f, kColor4ub, kEND};
 const Attribute kPNTIW[] = {kPosition3f,     kNormal3f,       kTangent4f,
                             kBoneIndices4ub, kBoneWeights4ub, kEND};
+const Attribute kQuantizedPNUv[] = {kPosition3h, kNormalOct2s, kTexCoord2h,
+                                    kEND};
+const Attribute kQuantizedPQUv[] = {kPosition3h, kOrientationPacked,
+                                    kTexCoord2h, kEND};
 
 }  // namespace
 
@@ -54,6 +59,14 @@ TEST_F(MeshTests, IsValidFormat) {
   const Attribute kBadUvs[] = {kTexCoord2f, kTexCoord2us, kEND};
   EXPECT_FALSE(Mesh::IsValidFormat(kBadUvs));
 
+  EXPECT_TRUE(Mesh::IsValidFormat(kQuantizedPNUv));
+  EXPECT_TRUE(Mesh::IsValidFormat(kQuantizedPQUv));
+  const Attribute kBadQuantizedPositions[] = {kPosition3f, kPosition3h, kEND};
+  EXPECT_FALSE(Mesh::IsValidFormat(kBadQuantizedPositions));
+  const Attribute kBadQuantizedNormals[] = {kPosition3h, kNormal3f,
+                                            kNormalOct2s, kEND};
+  EXPECT_FALSE(Mesh::IsValidFormat(kBadQuantizedNormals));
+
   // Simulate uninitialized memory by filling it with 0xff, which isn't kEND.
   Attribute unterminated[100];
   memset(unterminated, 0xff, sizeof unterminated);
@@ -86,6 +99,12 @@ TEST_F(MeshTests, VertexSize) {
 
   // KPNTIW = (3 + 3 + 4) floats + (4 + 4) bytes = 48 bytes
   EXPECT_EQ(Mesh::VertexSize(kPNTIW), 48U);
+
+  // kQuantizedPNUv = 4 halfs (one padding) + 2 shorts + 2 halfs = 16 bytes
+  EXPECT_EQ(Mesh::VertexSize(kQuantizedPNUv), 16U);
+
+  // kQuantizedPQUv = 4 halfs (one padding) + 4 bytes + 2 halfs = 16 bytes
+  EXPECT_EQ(Mesh::VertexSize(kQuantizedPQUv), 16U);
 }
 
 TEST_F(MeshTests, AttributeOffset) {
@@ -98,6 +117,89 @@ TEST_F(MeshTests, AttributeOffset) {
   EXPECT_EQ(Mesh::AttributeOffset(kPNTIW, kTangent4f), 24U);
   EXPECT_EQ(Mesh::AttributeOffset(kPNTIW, kBoneIndices4ub), 40U);
   EXPECT_EQ(Mesh::AttributeOffset(kPNTIW, kBoneWeights4ub), 44U);
+
+  EXPECT_EQ(Mesh::AttributeOffset(kQuantizedPNUv, kNormalOct2s), 8U);
+  EXPECT_EQ(Mesh::AttributeOffset(kQuantizedPNUv, kTexCoord2h), 12U);
+}
+
+// Compile-time formats lay out vertices as their runtime arrays do.
+TEST_F(MeshTests, VertexFormat) {
+  typedef VertexFormat<kPosition3f, kNormal3f, kTangent4f, kBoneIndices4ub,
+                       kBoneWeights4ub>
+      PNTIW;
+  static_assert(PNTIW::kStride == 48, "PNTIW stride");
+  static_assert(PNTIW::Offset<kBoneIndices4ub>() == 40, "PNTIW offset");
+  static_assert(PNTIW::Has<kTangent4f>() && !PNTIW::Has<kColor4ub>(),
+                "PNTIW attributes");
+  EXPECT_EQ(PNTIW::kNumAttributes, 5U);
+  EXPECT_EQ(PNTIW::kStride, Mesh::VertexSize(kPNTIW));
+  EXPECT_EQ(PNTIW::Offset<kNormal3f>(),
+            Mesh::AttributeOffset(kPNTIW, kNormal3f));
+  EXPECT_EQ(PNTIW::Offset<kBoneWeights4ub>(),
+            Mesh::AttributeOffset(kPNTIW, kBoneWeights4ub));
+  const Attribute *pntiw = PNTIW();
+  for (size_t i = 0; i <= PNTIW::kNumAttributes; ++i) {
+    EXPECT_EQ(pntiw[i], kPNTIW[i]);
+  }
+
+  typedef VertexFormat<kPosition3h, kOrientationPacked, kTexCoord2h> PQUv;
+  EXPECT_EQ(PQUv::kStride, Mesh::VertexSize(kQuantizedPQUv));
+  EXPECT_EQ(PQUv::Offset<kTexCoord2h>(),
+            Mesh::AttributeOffset(kQuantizedPQUv, kTexCoord2h));
+  EXPECT_TRUE(Mesh::IsValidFormat(PQUv()));
+
+  typedef VertexFormat<kInstanceTransform3x4f, kInstanceColor4ub> Instances;
+  EXPECT_EQ(Instances::kStride, 52U);
+  EXPECT_EQ(Instances::Offset<kInstanceColor4ub>(), 48U);
+  EXPECT_TRUE(Mesh::IsValidInstanceFormat(Instances()));
+}
+
+struct TangentSpaceVertex {
+  mathfu::vec3_packed pos;
+  mathfu::vec2_packed tc;
+  mathfu::vec3_packed norm;
+  mathfu::vec4_packed tangent;
+};
+
+// A flat grid large enough to be split across threads gives the same tangent
+// space with 16 and 32 bit indices.
+TEST_F(MeshTests, ComputeNormalsTangents) {
+  static const int kSize = 100;
+  std::vector<TangentSpaceVertex> vertices(kSize * kSize);
+  for (int y = 0; y < kSize; ++y) {
+    for (int x = 0; x < kSize; ++x) {
+      TangentSpaceVertex &v = vertices[y * kSize + x];
+      v.pos = mathfu::vec3(static_cast<float>(x), static_cast<float>(y), 0.0f);
+      v.tc = mathfu::vec2(x / (kSize - 1.0f), y / (kSize - 1.0f));
+    }
+  }
+  std::vector<uint32_t> indices32;
+  for (int y = 0; y + 1 < kSize; ++y) {
+    for (int x = 0; x + 1 < kSize; ++x) {
+      const uint32_t i = y * kSize + x;
+      const uint32_t quad[] = {i, i + 1, i + kSize, i + 1, i + kSize + 1,
+                               i + kSize};
+      indices32.insert(indices32.end(), quad, quad + 6);
+    }
+  }
+  const std::vector<uint16_t> indices16(indices32.begin(), indices32.end());
+  std::vector<TangentSpaceVertex> vertices16 = vertices;
+
+  Mesh::ComputeNormalsTangents(&vertices[0], &indices32[0],
+                               static_cast<int>(vertices.size()),
+                               static_cast<int>(indices32.size()));
+  Mesh::ComputeNormalsTangents(&vertices16[0], &indices16[0],
+                               static_cast<int>(vertices16.size()),
+                               static_cast<int>(indices16.size()));
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    const mathfu::vec3 norm(vertices[i].norm);
+    const mathfu::vec4 tangent(vertices[i].tangent);
+    EXPECT_NEAR(1.0f, norm.z, 1e-5f);
+    EXPECT_NEAR(1.0f, tangent.x, 1e-5f);
+    EXPECT_NEAR(1.0f, tangent.w, 1e-5f);
+    EXPECT_EQ(norm, mathfu::vec3(vertices16[i].norm));
+    EXPECT_EQ(tangent, mathfu::vec4(vertices16[i].tangent));
+  }
 }
 
 }  // namespace fplbase
@@ -0,0 +1,181 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "fplbase/internal/pixel_conversion.h"
+#include "gtest/gtest.h"
+
+class PixelConversionTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+// Deterministic pseudo random bytes, so failures are reproducible.
+static std::vector<uint8_t> RandomBytes(size_t size) {
+  std::vector<uint8_t> bytes(size);
+  uint32_t state = 12345;
+  for (size_t i = 0; i < size; ++i) {
+    state = state * 1664525u + 1013904223u;
+    bytes[i] = static_cast<uint8_t>(state >> 24);
+  }
+  return bytes;
+}
+
+// Pixel counts around the vector widths, to cover the scalar tails.
+static const size_t kNumPixels[] = {0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 33, 1027};
+
+// Check the vectorized 8888 -> 5551 conversion matches the reference.
+TEST_F(PixelConversionTests, Convert8888To5551) {
+  for (size_t i = 0; i < sizeof(kNumPixels) / sizeof(kNumPixels[0]); ++i) {
+    const size_t n = kNumPixels[i];
+    const std::vector<uint8_t> src = RandomBytes(n * 4);
+    std::vector<uint16_t> expected(n), actual(n);
+    fplbase::Convert8888To5551Scalar(src.data(), expected.data(), n);
+    fplbase::Convert8888To5551(src.data(), actual.data(), n);
+    EXPECT_EQ(expected, actual) << n << " pixels";
+  }
+}
+
+// Check the vectorized 888 -> 565 conversion matches the reference.
+TEST_F(PixelConversionTests, Convert888To565) {
+  for (size_t i = 0; i < sizeof(kNumPixels) / sizeof(kNumPixels[0]); ++i) {
+    const size_t n = kNumPixels[i];
+    const std::vector<uint8_t> src = RandomBytes(n * 3);
+    std::vector<uint16_t> expected(n), actual(n);
+    fplbase::Convert888To565Scalar(src.data(), expected.data(), n);
+    fplbase::Convert888To565(src.data(), actual.data(), n);
+    EXPECT_EQ(expected, actual) << n << " pixels";
+  }
+}
+
+// Check the reference conversions against a few known values.
+TEST_F(PixelConversionTests, ReferenceValues) {
+  const uint8_t rgba[] = {0xFF, 0x00, 0x00, 0xFF, 0x08, 0x10, 0x18, 0x7F};
+  uint16_t out[2];
+  fplbase::Convert8888To5551Scalar(rgba, out, 2);
+  EXPECT_EQ(0xF801, out[0]);
+  EXPECT_EQ((1 << 11) | (2 << 6) | (3 << 1), out[1]);
+  const uint8_t rgb[] = {0x00, 0xFF, 0x00, 0x08, 0x04, 0x08};
+  fplbase::Convert888To565Scalar(rgb, out, 2);
+  EXPECT_EQ(0x07E0, out[0]);
+  EXPECT_EQ((1 << 11) | (1 << 5) | 1, out[1]);
+}
+
+// Check premultiplying matches the reference for every color and alpha.
+TEST_F(PixelConversionTests, MultiplyRgbByAlphaExhaustive) {
+  std::vector<uint8_t> expected(256 * 256 * 4);
+  for (int c = 0; c < 256; ++c) {
+    for (int a = 0; a < 256; ++a) {
+      uint8_t *p = &expected[(c * 256 + a) * 4];
+      p[0] = static_cast<uint8_t>(c);
+      p[1] = static_cast<uint8_t>(255 - c);
+      p[2] = static_cast<uint8_t>(c ^ a);
+      p[3] = static_cast<uint8_t>(a);
+    }
+  }
+  std::vector<uint8_t> actual = expected;
+  fplbase::MultiplyRgbByAlphaScalar(expected.data(), 256 * 256);
+  fplbase::MultiplyRgbByAlpha(actual.data(), 256 * 256);
+  EXPECT_EQ(expected, actual);
+}
+
+// Check premultiplying odd pixel counts leaves the pixels after them alone.
+TEST_F(PixelConversionTests, MultiplyRgbByAlphaTail) {
+  for (size_t i = 0; i < sizeof(kNumPixels) / sizeof(kNumPixels[0]); ++i) {
+    const size_t n = kNumPixels[i];
+    std::vector<uint8_t> expected = RandomBytes((n + 1) * 4);
+    std::vector<uint8_t> actual = expected;
+    fplbase::MultiplyRgbByAlphaScalar(expected.data(), n);
+    fplbase::MultiplyRgbByAlpha(actual.data(), n);
+    EXPECT_EQ(expected, actual) << n << " pixels";
+  }
+}
+
+// Check the vectorized box filter matches the reference, for odd sizes and
+// images only 1 pixel wide or high.
+TEST_F(PixelConversionTests, DownsampleBox2x2) {
+  static const int kSizes[] = {1, 2, 3, 7, 8, 9, 16, 17, 33, 64};
+  for (int channels = 1; channels <= 4; ++channels) {
+    for (size_t w = 0; w < sizeof(kSizes) / sizeof(kSizes[0]); ++w) {
+      for (size_t h = 0; h < sizeof(kSizes) / sizeof(kSizes[0]); ++h) {
+        const int width = kSizes[w];
+        const int height = kSizes[h];
+        const std::vector<uint8_t> src =
+            RandomBytes(static_cast<size_t>(width) * height * channels);
+        const size_t dest_size = static_cast<size_t>(std::max(width / 2, 1)) *
+                                 std::max(height / 2, 1) * channels;
+        std::vector<uint8_t> expected(dest_size), actual(dest_size);
+        fplbase::DownsampleBox2x2Scalar(src.data(), width, height, channels,
+                                        expected.data());
+        fplbase::DownsampleBox2x2(src.data(), width, height, channels,
+                                  actual.data());
+        EXPECT_EQ(expected, actual)
+            << width << "x" << height << "x" << channels;
+      }
+    }
+  }
+}
+
+// Check halving in place, as UnpackImage() does, matches a separate output.
+TEST_F(PixelConversionTests, DownsampleBox2x2InPlace) {
+  static const int kSizes[] = {1, 2, 7, 16, 33, 64};
+  for (int channels = 1; channels <= 4; ++channels) {
+    for (size_t w = 0; w < sizeof(kSizes) / sizeof(kSizes[0]); ++w) {
+      for (size_t h = 0; h < sizeof(kSizes) / sizeof(kSizes[0]); ++h) {
+        const int width = kSizes[w];
+        const int height = kSizes[h];
+        std::vector<uint8_t> image =
+            RandomBytes(static_cast<size_t>(width) * height * channels);
+        const size_t dest_size = static_cast<size_t>(std::max(width / 2, 1)) *
+                                 std::max(height / 2, 1) * channels;
+        std::vector<uint8_t> expected(dest_size);
+        fplbase::DownsampleBox2x2(image.data(), width, height, channels,
+                                  expected.data());
+        fplbase::DownsampleBox2x2(image.data(), width, height, channels,
+                                  image.data());
+        image.resize(dest_size);
+        EXPECT_EQ(expected, image)
+            << width << "x" << height << "x" << channels;
+      }
+    }
+  }
+}
+
+// Check the reference box filter against known values.
+TEST_F(PixelConversionTests, DownsampleBox2x2ReferenceValues) {
+  // 2x2 RGBA: rounded averages of the rows, then of those.
+  const uint8_t rgba[] = {0, 10, 255, 1, 1, 20, 255, 2,
+                          2, 30, 0,   3, 4, 40, 0,   4};
+  uint8_t out[4];
+  fplbase::DownsampleBox2x2Scalar(rgba, 2, 2, 4, out);
+  EXPECT_EQ(2, out[0]);   // avg(avg(0, 1), avg(2, 4)) = avg(1, 3)
+  EXPECT_EQ(25, out[1]);  // avg(15, 35)
+  EXPECT_EQ(128, out[2]);
+  EXPECT_EQ(3, out[3]);   // avg(2, 4)
+  // A 1 pixel wide column keeps its width.
+  const uint8_t column[] = {10, 20, 30, 41};
+  fplbase::DownsampleBox2x2Scalar(column, 1, 4, 1, out);
+  EXPECT_EQ(15, out[0]);
+  EXPECT_EQ(36, out[1]);
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
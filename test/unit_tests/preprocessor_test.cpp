@@ -12,8 +12,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <map>
 #include <string>
 #include "fplbase/preprocessor.h"
+#include "fplbase/shader.h"
 #include "gtest/gtest.h"
 
 // The value of preprocessor.cpp's kDefaultDefines as a raw string so it can be
@@ -53,7 +55,21 @@ bool LoadFile(const char* file, std::string* dest) {
   return true;
 }
 
-void PreprocessorTests::SetUp() { fplbase::SetLoadFileFunction(LoadFile); }
+// Files for the #include tests, by name.
+static std::map<std::string, std::string> include_test_files;
+
+// Load a file from include_test_files.
+bool LoadIncludeTestFile(const char* file, std::string* dest) {
+  auto it = include_test_files.find(file);
+  if (it == include_test_files.end()) return false;
+  *dest = it->second;
+  return true;
+}
+
+void PreprocessorTests::SetUp() {
+  // This also drops whatever the last test #included.
+  fplbase::SetLoadFileFunction(LoadFile);
+}
 
 void PreprocessorTests::TearDown() {
   error_message_ = "";
@@ -61,6 +77,7 @@ void PreprocessorTests::TearDown() {
   all_define_.clear();
 
   file_ = "";
+  include_test_files.clear();
 }
 
 // #defines should just be passed through.
@@ -133,6 +150,122 @@ TEST_F(PreprocessorTests, ValuePassthrough) {
   EXPECT_EQ(file_, std::string(file));
 }
 
+// #included files should replace the #include statement.
+TEST_F(PreprocessorTests, IncludeInserted) {
+  fplbase::SetLoadFileFunction(LoadIncludeTestFile);
+  include_test_files["main"] = "a\n#include \"inc\"\nb\n";
+  include_test_files["inc"] = "i";
+  bool result = fplbase::LoadFileWithDirectives("main", &file_, kEmptyDefines,
+                                                &error_message_);
+  EXPECT_TRUE(result);
+  EXPECT_EQ(file_, std::string("a\ni\n\nb\n"));
+}
+
+// Passed-in #defines should come before any #included files.
+TEST_F(PreprocessorTests, DefinesBeforeIncludes) {
+  fplbase::SetLoadFileFunction(LoadIncludeTestFile);
+  include_test_files["main"] = "a\n#include \"inc\"\nb\n";
+  include_test_files["inc"] = "i\n";
+  std::set<std::string> defines;
+  defines.insert("foo");
+  bool result =
+      fplbase::LoadFileWithDirectives("main", &file_, defines, &error_message_);
+  EXPECT_TRUE(result);
+  EXPECT_EQ(file_, std::string("#define foo\na\ni\n\nb\n"));
+}
+
+// #includes within #included files should be followed.
+TEST_F(PreprocessorTests, NestedIncludes) {
+  fplbase::SetLoadFileFunction(LoadIncludeTestFile);
+  include_test_files["outer"] = "o\n#include \"middle\"\n";
+  include_test_files["middle"] = "#include \"inner\"\nm\n";
+  include_test_files["inner"] = "n\n";
+  bool result = fplbase::LoadFileWithDirectives("outer", &file_, kEmptyDefines,
+                                                &error_message_);
+  EXPECT_TRUE(result);
+  EXPECT_EQ(file_, std::string("o\nn\n\nm\n\n"));
+}
+
+// A file should be #included only once, even when it includes itself.
+TEST_F(PreprocessorTests, IncludedOnce) {
+  fplbase::SetLoadFileFunction(LoadIncludeTestFile);
+  include_test_files["twice"] = "#include \"inc\"\n#include \"inc\"\nb\n";
+  include_test_files["inc"] = "i";
+  include_test_files["cycle"] = "#include \"cycle\"\nc\n";
+  bool result = fplbase::LoadFileWithDirectives("twice", &file_, kEmptyDefines,
+                                                &error_message_);
+  EXPECT_TRUE(result);
+  EXPECT_EQ(file_, std::string("\ni\n\nb\n"));
+  result = fplbase::LoadFileWithDirectives("cycle", &file_, kEmptyDefines,
+                                           &error_message_);
+  EXPECT_TRUE(result);
+  EXPECT_EQ(file_, std::string("\nc\n"));
+}
+
+// An #include of a missing file should fail, and name the file.
+TEST_F(PreprocessorTests, MissingInclude) {
+  fplbase::SetLoadFileFunction(LoadIncludeTestFile);
+  include_test_files["main"] = "#include \"missing\"\n";
+  bool result = fplbase::LoadFileWithDirectives("main", &file_, kEmptyDefines,
+                                                &error_message_);
+  EXPECT_FALSE(result);
+  EXPECT_EQ(error_message_, std::string("cannot load missing"));
+}
+
+// #included files should be reused until the cache is cleared, unlike the
+// files that include them.
+TEST_F(PreprocessorTests, IncludeCache) {
+  fplbase::SetLoadFileFunction(LoadIncludeTestFile);
+  include_test_files["main"] = "#include \"inc\"\n";
+  include_test_files["inc"] = "i\n";
+  fplbase::LoadFileWithDirectives("main", &file_, kEmptyDefines,
+                                  &error_message_);
+  include_test_files["main"] = "m\n#include \"inc\"\n";
+  include_test_files["inc"] = "changed\n";
+  bool result = fplbase::LoadFileWithDirectives("main", &file_, kEmptyDefines,
+                                                &error_message_);
+  EXPECT_TRUE(result);
+  EXPECT_EQ(file_, std::string("m\ni\n\n"));
+  fplbase::ClearShaderIncludeCache();
+  result = fplbase::LoadFileWithDirectives("main", &file_, kEmptyDefines,
+                                           &error_message_);
+  EXPECT_TRUE(result);
+  EXPECT_EQ(file_, std::string("m\nchanged\n\n"));
+}
+
+// Switching the load function, e.g. to an archive, drops the #included
+// files the last one loaded.
+TEST_F(PreprocessorTests, IncludeCacheClearedBySetLoadFileFunction) {
+  fplbase::SetLoadFileFunction(LoadIncludeTestFile);
+  include_test_files["main"] = "#include \"inc\"\n";
+  include_test_files["inc"] = "i\n";
+  fplbase::LoadFileWithDirectives("main", &file_, kEmptyDefines,
+                                  &error_message_);
+  include_test_files["inc"] = "changed\n";
+  fplbase::SetLoadFileFunction(LoadIncludeTestFile);
+  const bool result = fplbase::LoadFileWithDirectives(
+      "main", &file_, kEmptyDefines, &error_message_);
+  EXPECT_TRUE(result);
+  EXPECT_EQ(file_, std::string("changed\n\n"));
+}
+
+// Marking a shader dirty after an edit to a file it #includes makes its
+// reload preprocess the edited file.
+TEST_F(PreprocessorTests, IncludeCacheClearedByShaderReload) {
+  fplbase::SetLoadFileFunction(LoadIncludeTestFile);
+  include_test_files["shader.glslv"] = "#include \"inc\"\nvoid main() {}\n";
+  include_test_files["shader.glslf"] = "void main() {}\n";
+  include_test_files["inc"] = "a\n";
+  fplbase::Shader shader("shader", std::vector<std::string>(), nullptr);
+  shader.Load();
+  include_test_files["inc"] = "b\n";
+  shader.MarkDirty();
+  const bool result = fplbase::LoadFileWithDirectives(
+      "shader.glslv", &file_, kEmptyDefines, &error_message_);
+  EXPECT_TRUE(result);
+  EXPECT_EQ(file_, std::string("b\n\nvoid main() {}\n"));
+}
+
 TEST_F(PreprocessorTests, SanitizeCheckPrecisionSpecifiers) {
   const char* simple_file = "void main() { gl_FragColor = something; }";
   std::string result;
@@ -0,0 +1,88 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fplbase/render_queue.h"
+#include "fplbase/mesh.h"
+#include "fplbase/render_target.h"
+#include "fplbase/shader.h"
+#include "gtest/gtest.h"
+
+using fplbase::InvalidShaderHandle;
+using fplbase::Mesh;
+using fplbase::RenderQueue;
+using fplbase::RenderQueueItem;
+using fplbase::RenderTarget;
+using fplbase::Shader;
+
+class RenderQueueTests : public ::testing::Test {
+ protected:
+  RenderQueueTests()
+      : shader_(InvalidShaderHandle(), InvalidShaderHandle(),
+                InvalidShaderHandle()) {}
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+
+  RenderQueueItem Item(const RenderTarget *target) {
+    RenderQueueItem item;
+    item.mesh = &mesh_;
+    item.shader = &shader_;
+    item.target = target;
+    return item;
+  }
+
+  Mesh mesh_;
+  Shader shader_;
+};
+
+// Nothing is bound when no draw has a target.
+TEST_F(RenderQueueTests, UntargetedOnly) {
+  RenderQueue queue;
+  queue.Submit(Item(nullptr));
+  queue.Submit(Item(nullptr));
+  EXPECT_TRUE(queue.TargetOrder().empty());
+}
+
+TEST_F(RenderQueueTests, TargetedThenUntargeted) {
+  RenderTarget target;
+  RenderQueue queue;
+  queue.Submit(Item(&target));
+  queue.Submit(Item(nullptr));
+  const std::vector<const RenderTarget *> order = queue.TargetOrder();
+  ASSERT_EQ(2U, order.size());
+  EXPECT_EQ(&target, order[0]);
+  EXPECT_TRUE(order[1] == nullptr);
+}
+
+// Targets are drawn in the order they're first submitted, and the original
+// framebuffer is bound again at the end.
+TEST_F(RenderQueueTests, UntargetedThenTargeted) {
+  RenderTarget first;
+  RenderTarget second;
+  RenderQueue queue;
+  queue.Submit(Item(nullptr));
+  queue.Submit(Item(&first));
+  queue.Submit(Item(&second));
+  queue.Submit(Item(&first));
+  queue.Submit(Item(nullptr));
+  const std::vector<const RenderTarget *> order = queue.TargetOrder();
+  ASSERT_EQ(3U, order.size());
+  EXPECT_EQ(&first, order[0]);
+  EXPECT_EQ(&second, order[1]);
+  EXPECT_TRUE(order[2] == nullptr);
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
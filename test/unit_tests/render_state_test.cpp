@@ -0,0 +1,140 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fplbase/render_state.h"
+#include "gtest/gtest.h"
+
+using fplbase::PackedRenderState;
+using fplbase::RenderState;
+
+class RenderStateTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+// A state with every part set away from its default.
+static RenderState NonDefaultState() {
+  RenderState state;
+  state.alpha_test_state.enabled = true;
+  state.alpha_test_state.function = fplbase::kRenderGreater;
+  state.alpha_test_state.ref = 0.5f;
+  state.blend_state.enabled = true;
+  state.blend_state.src_alpha = fplbase::BlendState::kSrcAlpha;
+  state.blend_state.src_color = fplbase::BlendState::kSrcAlphaSaturate;
+  state.blend_state.dst_alpha = fplbase::BlendState::kOneMinusSrcAlpha;
+  state.blend_state.dst_color = fplbase::BlendState::kOneMinusConstantAlpha;
+  state.cull_state.enabled = true;
+  state.cull_state.face = fplbase::CullState::kFrontAndBack;
+  state.cull_state.front = fplbase::CullState::kClockWise;
+  state.depth_state.test_enabled = true;
+  state.depth_state.write_enabled = false;
+  state.depth_state.function = fplbase::kRenderNotEqual;
+  state.point_state.point_sprite_enabled = true;
+  state.point_state.program_point_size_enabled = true;
+  state.point_state.point_size = 4.0f;
+  state.scissor_state.enabled = true;
+  state.scissor_state.rect = mathfu::recti(1, 2, 3, 4);
+  state.stencil_state.enabled = true;
+  state.stencil_state.back_function.function = fplbase::kRenderLessEqual;
+  state.stencil_state.back_function.ref = -3;
+  state.stencil_state.back_function.mask = 0xffffffffu;
+  state.stencil_state.back_op.stencil_fail =
+      fplbase::StencilOperation::kInvert;
+  state.stencil_state.back_op.pass = fplbase::StencilOperation::kReplace;
+  state.stencil_state.front_function.function = fplbase::kRenderNever;
+  state.stencil_state.front_function.ref = 7;
+  state.stencil_state.front_op.depth_fail =
+      fplbase::StencilOperation::kDecrementAndWrap;
+  state.viewport = fplbase::Viewport(5, 6, 640, 480);
+  return state;
+}
+
+TEST_F(RenderStateTests, UnpackReturnsPackedState) {
+  const RenderState defaults;
+  RenderState unpacked = NonDefaultState();
+  PackedRenderState().Unpack(&unpacked);
+  EXPECT_TRUE(unpacked == defaults);
+
+  const RenderState state = NonDefaultState();
+  PackedRenderState(state).Unpack(&unpacked);
+  EXPECT_TRUE(unpacked == state);
+}
+
+TEST_F(RenderStateTests, EqualStatesMatch) {
+  const PackedRenderState a(NonDefaultState());
+  const PackedRenderState b(NonDefaultState());
+  EXPECT_TRUE(a == b);
+  EXPECT_EQ(a.hash(), b.hash());
+  EXPECT_EQ(0u, a.Diff(b));
+  EXPECT_TRUE(a != PackedRenderState());
+}
+
+TEST_F(RenderStateTests, DiffFindsChangedParts) {
+  const RenderState state = NonDefaultState();
+  const PackedRenderState packed(state);
+
+  RenderState changed = state;
+  changed.alpha_test_state.ref = 0.25f;
+  EXPECT_EQ(static_cast<uint32_t>(PackedRenderState::kAlphaTestComponent),
+            PackedRenderState(changed).Diff(packed));
+
+  changed = state;
+  changed.blend_state.dst_color = fplbase::BlendState::kZero;
+  EXPECT_EQ(static_cast<uint32_t>(PackedRenderState::kBlendComponent),
+            PackedRenderState(changed).Diff(packed));
+
+  changed = state;
+  changed.cull_state.front = fplbase::CullState::kCounterClockWise;
+  EXPECT_EQ(static_cast<uint32_t>(PackedRenderState::kCullComponent),
+            PackedRenderState(changed).Diff(packed));
+
+  changed = state;
+  changed.depth_state.write_enabled = true;
+  EXPECT_EQ(static_cast<uint32_t>(PackedRenderState::kDepthComponent),
+            PackedRenderState(changed).Diff(packed));
+
+  changed = state;
+  changed.point_state.point_size = 2.0f;
+  EXPECT_EQ(static_cast<uint32_t>(PackedRenderState::kPointComponent),
+            PackedRenderState(changed).Diff(packed));
+
+  changed = state;
+  changed.scissor_state.rect.size.y = 40;
+  EXPECT_EQ(static_cast<uint32_t>(PackedRenderState::kScissorComponent),
+            PackedRenderState(changed).Diff(packed));
+
+  changed = state;
+  changed.stencil_state.front_op.pass = fplbase::StencilOperation::kZero;
+  EXPECT_EQ(static_cast<uint32_t>(PackedRenderState::kStencilComponent),
+            PackedRenderState(changed).Diff(packed));
+
+  changed = state;
+  changed.stencil_state.back_function.mask = 1;
+  EXPECT_EQ(static_cast<uint32_t>(PackedRenderState::kStencilComponent),
+            PackedRenderState(changed).Diff(packed));
+
+  changed = state;
+  changed.viewport.pos.x = 0;
+  EXPECT_EQ(static_cast<uint32_t>(PackedRenderState::kViewportComponent),
+            PackedRenderState(changed).Diff(packed));
+
+  EXPECT_EQ(static_cast<uint32_t>(PackedRenderState::kAllComponents),
+            PackedRenderState().Diff(packed));
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
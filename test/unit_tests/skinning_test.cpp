@@ -0,0 +1,272 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "fplbase/mesh.h"
+#include "fplbase/skinning.h"
+#include "gtest/gtest.h"
+#include "mathfu/glsl_mappings.h"
+
+using fplbase::LocalPose;
+using fplbase::Mesh;
+using fplbase::PoseInstance;
+using fplbase::SkinningInstance;
+using fplbase::SkinningJobs;
+using mathfu::AffineTransform;
+using mathfu::mat4;
+using mathfu::quat;
+using mathfu::vec3;
+
+class SkinningTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+static AffineTransform TestTransform(int i) {
+  const float f = static_cast<float>(i);
+  return mat4::ToAffineTransform(
+      mat4::FromTranslationVector(vec3(f, -2.0f * f, 0.5f)) *
+      mat4::FromRotationMatrix(
+          quat::FromAngleAxis(0.3f * f, vec3(1.0f, 2.0f, 3.0f).Normalized())
+              .ToMatrix()) *
+      mat4::FromScaleVector(vec3(1.0f + 0.1f * f, 2.0f, 0.5f)));
+}
+
+static void ExpectNear(const AffineTransform &expected,
+                       const AffineTransform &actual) {
+  for (int i = 0; i < 12; ++i) {
+    EXPECT_NEAR(expected[i], actual[i], 1e-4f);
+  }
+}
+
+// The affine kernel must match the 4x4 multiply it replaces.
+TEST_F(SkinningTests, MultiplyMatchesMat4) {
+  static const size_t kCount = 9;
+  std::vector<AffineTransform> a(kCount), b(kCount), products(kCount);
+  for (size_t i = 0; i < kCount; ++i) {
+    a[i] = TestTransform(static_cast<int>(i));
+    b[i] = TestTransform(static_cast<int>(kCount - i));
+  }
+  fplbase::MultiplyAffineTransforms(&a[0], &b[0], kCount, &products[0]);
+  for (size_t i = 0; i < kCount; ++i) {
+    ExpectNear(mat4::ToAffineTransform(mat4::FromAffineTransform(a[i]) *
+                                       mat4::FromAffineTransform(b[i])),
+               products[i]);
+  }
+}
+
+// Computing palettes across threads gives the same result as one at a time.
+TEST_F(SkinningTests, JobsMatchSerial) {
+  static const size_t kNumBones = 5;
+  static const size_t kNumShaderBones = 3;
+  static const size_t kNumInstances = 37;
+  AffineTransform defaults[kNumBones];
+  for (size_t i = 0; i < kNumBones; ++i) {
+    defaults[i] = TestTransform(static_cast<int>(i) + 1);
+  }
+  const uint8_t parents[kNumBones] = {0xFF, 0, 1, 1, 3};
+  const uint8_t shader_bones[kNumShaderBones] = {1, 3, 4};
+  Mesh mesh;
+  mesh.SetBones(defaults, parents, nullptr, kNumBones, shader_bones,
+                kNumShaderBones);
+
+  std::vector<AffineTransform> bones(kNumInstances * kNumBones);
+  for (size_t i = 0; i < bones.size(); ++i) {
+    bones[i] = TestTransform(static_cast<int>(i % 11));
+  }
+  std::vector<AffineTransform> expected(kNumInstances * kNumShaderBones);
+  std::vector<AffineTransform> actual(expected.size());
+  std::vector<SkinningInstance> instances(kNumInstances);
+  for (size_t i = 0; i < kNumInstances; ++i) {
+    mesh.GatherShaderTransforms(&bones[i * kNumBones],
+                                &expected[i * kNumShaderBones]);
+    instances[i] = SkinningInstance(&mesh, &bones[i * kNumBones],
+                                    &actual[i * kNumShaderBones]);
+  }
+
+  SkinningJobs jobs(3);
+  EXPECT_EQ(3, jobs.num_threads());
+  for (int pass = 0; pass < 3; ++pass) {
+    for (size_t i = 0; i < actual.size(); ++i) actual[i] = AffineTransform(0.0f);
+    jobs.GatherShaderTransforms(&instances[0], kNumInstances);
+    for (size_t i = 0; i < expected.size(); ++i) {
+      ExpectNear(expected[i], actual[i]);
+    }
+  }
+}
+
+// Dual quaternions move points the same way as the rigid transforms they
+// were made from, including rotations near 180 degrees.
+TEST_F(SkinningTests, DualQuaternionMatchesAffine) {
+  const vec3 point(1.5f, -2.0f, 0.7f);
+  for (int i = 0; i < 12; ++i) {
+    const mat4 rigid =
+        mat4::FromTranslationVector(vec3(3.0f - i, 0.5f * i, -1.0f)) *
+        mat4::FromRotationMatrix(
+            quat::FromAngleAxis(0.28f * i, vec3(i - 5.0f, 1.0f, 2.0f)
+                                               .Normalized())
+                .ToMatrix());
+    mathfu::vec4_packed dual_quaternion[fplbase::kNumVec4sInDualQuaternion];
+    fplbase::AffineToDualQuaternion(mat4::ToAffineTransform(rigid),
+                                    dual_quaternion);
+
+    // Same as DualQuaternionTransform() in skinning_dual_quaternion.glslv_h.
+    const mathfu::vec4 real(dual_quaternion[0]);
+    const mathfu::vec4 dual(dual_quaternion[1]);
+    const vec3 rotated =
+        point + 2.0f * vec3::CrossProduct(real.xyz(),
+                                          vec3::CrossProduct(real.xyz(),
+                                                             point) +
+                                              real.w * point);
+    const vec3 translation =
+        2.0f * (real.w * dual.xyz() - dual.w * real.xyz() +
+                vec3::CrossProduct(real.xyz(), dual.xyz()));
+    const vec3 expected = rigid * point;
+    const vec3 actual = rotated + translation;
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_NEAR(expected[j], actual[j], 1e-4f);
+    }
+  }
+}
+
+// A test pose of `num_bones` bones, varied by `seed`.
+struct TestPose {
+  TestPose(size_t num_bones, int seed)
+      : rotations(num_bones), translations(num_bones), scales(num_bones) {
+    for (size_t i = 0; i < num_bones; ++i) {
+      const float f = static_cast<float>(i) + 0.37f * seed;
+      const quat q =
+          quat::FromAngleAxis(0.4f * f, vec3(1.0f, f, 2.0f).Normalized());
+      rotations[i] = mathfu::vec4_packed(mathfu::vec4(q.vector(), q.scalar()));
+      translations[i] = mathfu::vec3_packed(vec3(f, 1.0f - f, 0.25f * f));
+      scales[i] = mathfu::vec3_packed(vec3(1.0f + 0.1f * f, 1.0f, 0.9f));
+    }
+  }
+
+  mat4 Local(size_t i) const {
+    const mathfu::vec4 r(rotations[i]);
+    return mat4::FromTranslationVector(vec3(translations[i])) *
+           mat4::FromRotationMatrix(quat(r.w, r.xyz()).ToMatrix()) *
+           mat4::FromScaleVector(vec3(scales[i]));
+  }
+
+  LocalPose Pose(float weight) const {
+    return LocalPose(&rotations[0], &translations[0], &scales[0], weight);
+  }
+
+  std::vector<mathfu::vec4_packed> rotations;
+  std::vector<mathfu::vec3_packed> translations;
+  std::vector<mathfu::vec3_packed> scales;
+};
+
+// A single pose evaluates to the product of the local transforms of each
+// bone's ancestors.
+TEST_F(SkinningTests, EvaluatePoseMatchesHierarchy) {
+  static const size_t kNumBones = 6;
+  const uint8_t parents[kNumBones] = {fplbase::kInvalidBoneIdx, 0, 1, 1, 3,
+                                      fplbase::kInvalidBoneIdx};
+  const TestPose test_pose(kNumBones, 1);
+  const LocalPose pose = test_pose.Pose(0.5f);
+  AffineTransform bones[kNumBones];
+  fplbase::EvaluatePose(parents, kNumBones, &pose, 1, bones);
+
+  mat4 expected[kNumBones];
+  for (size_t i = 0; i < kNumBones; ++i) {
+    expected[i] = parents[i] < i ? expected[parents[i]] * test_pose.Local(i)
+                                 : test_pose.Local(i);
+    ExpectNear(mat4::ToAffineTransform(expected[i]), bones[i]);
+  }
+}
+
+// Blending takes the shorter way between rotations, whatever the sign of
+// their quaternions, and averages translations and scales by weight.
+TEST_F(SkinningTests, EvaluatePoseBlends) {
+  static const size_t kNumBones = 3;
+  const uint8_t parents[kNumBones] = {fplbase::kInvalidBoneIdx,
+                                      fplbase::kInvalidBoneIdx,
+                                      fplbase::kInvalidBoneIdx};
+  const TestPose a(kNumBones, 0);
+  TestPose b(kNumBones, 0);
+  for (size_t i = 0; i < kNumBones; ++i) {
+    b.rotations[i] = mathfu::vec4_packed(-mathfu::vec4(a.rotations[i]));
+    b.translations[i] = mathfu::vec3_packed(vec3(a.translations[i]) + 4.0f);
+    b.scales[i] = mathfu::vec3_packed(vec3(2.0f, 2.0f, 2.0f));
+  }
+  const LocalPose poses[] = {a.Pose(3.0f), b.Pose(1.0f)};
+  AffineTransform bones[kNumBones];
+  fplbase::EvaluatePose(parents, kNumBones, poses, 2, bones);
+
+  for (size_t i = 0; i < kNumBones; ++i) {
+    const mathfu::vec4 r(a.rotations[i]);
+    const vec3 scale = vec3(a.scales[i]) * 0.75f + vec3(0.5f, 0.5f, 0.5f);
+    const mat4 expected =
+        mat4::FromTranslationVector(vec3(a.translations[i]) + 1.0f) *
+        mat4::FromRotationMatrix(quat(r.w, r.xyz()).ToMatrix()) *
+        mat4::FromScaleVector(scale);
+    ExpectNear(mat4::ToAffineTransform(expected), bones[i]);
+  }
+}
+
+// Evaluating and gathering across threads gives the same result as one
+// instance at a time.
+TEST_F(SkinningTests, EvaluatePosesMatchSerial) {
+  static const size_t kNumBones = 5;
+  static const size_t kNumShaderBones = 3;
+  static const size_t kNumInstances = 23;
+  AffineTransform defaults[kNumBones];
+  for (size_t i = 0; i < kNumBones; ++i) {
+    defaults[i] = TestTransform(static_cast<int>(i) + 1);
+  }
+  const uint8_t parents[kNumBones] = {fplbase::kInvalidBoneIdx, 0, 1, 1, 3};
+  const uint8_t shader_bones[kNumShaderBones] = {1, 3, 4};
+  Mesh mesh;
+  mesh.SetBones(defaults, parents, nullptr, kNumBones, shader_bones,
+                kNumShaderBones);
+
+  const TestPose walk(kNumBones, 2);
+  const TestPose run(kNumBones, 5);
+  std::vector<LocalPose> poses;
+  for (size_t i = 0; i < kNumInstances; ++i) {
+    const float blend = static_cast<float>(i) / kNumInstances;
+    poses.push_back(walk.Pose(1.0f - blend));
+    poses.push_back(run.Pose(blend));
+  }
+
+  std::vector<AffineTransform> bones(kNumInstances * kNumBones);
+  std::vector<AffineTransform> expected(kNumInstances * kNumShaderBones);
+  std::vector<AffineTransform> actual(expected.size());
+  std::vector<PoseInstance> instances(kNumInstances);
+  for (size_t i = 0; i < kNumInstances; ++i) {
+    fplbase::EvaluatePose(parents, kNumBones, &poses[i * 2], 2,
+                          &bones[i * kNumBones]);
+    mesh.GatherShaderTransforms(&bones[i * kNumBones],
+                                &expected[i * kNumShaderBones]);
+    instances[i] = PoseInstance(&mesh, &poses[i * 2], 2, &bones[i * kNumBones],
+                                &actual[i * kNumShaderBones]);
+  }
+
+  SkinningJobs jobs(3);
+  for (size_t i = 0; i < bones.size(); ++i) bones[i] = AffineTransform(0.0f);
+  jobs.EvaluatePoses(&instances[0], kNumInstances);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ExpectNear(expected[i], actual[i]);
+  }
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
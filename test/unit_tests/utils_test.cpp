@@ -12,7 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdlib.h>
+#include <vector>
+
 #include "common_generated.h"
+#include "fplbase/allocator.h"
 #include "fplbase/flatbuffer_utils.h"
 #include "fplbase/preprocessor.h"
 #include "gtest/gtest.h"
@@ -118,12 +122,84 @@ TEST_F(UtilsTests, LoadAffine) {
   EXPECT_EQ(flat.c2().w(), m.GetColumn(2).w);
 }
 
+// Check that the bulk conversion matches LoadAffine() on each element.
+TEST_F(UtilsTests, LoadAffines) {
+  fplbase::Mat3x4 flat[3];
+  for (int i = 0; i < 3; ++i) {
+    const float f = static_cast<float>(12 * i);
+    flat[i] = fplbase::Mat3x4(fplbase::Vec4(f + 1, f + 2, f + 3, f + 4),
+                              fplbase::Vec4(f + 5, f + 6, f + 7, f + 8),
+                              fplbase::Vec4(f + 9, f + 10, f + 11, f + 12));
+  }
+  mathfu::AffineTransform m[3];
+  fplbase::LoadAffines(flat, 3, m);
+  for (int i = 0; i < 3; ++i) {
+    const mathfu::AffineTransform expected = fplbase::LoadAffine(&flat[i]);
+    for (int c = 0; c < 3; ++c) {
+      for (int r = 0; r < 4; ++r) {
+        EXPECT_EQ(expected.GetColumn(c)[r], m[i].GetColumn(c)[r]);
+      }
+    }
+  }
+}
+
+// Check that structs land every `stride` bytes, leaving the rest alone.
+TEST_F(UtilsTests, InterleaveStructs) {
+  const fplbase::Vec2 flat[] = {fplbase::Vec2(1.0f, 2.0f),
+                                fplbase::Vec2(3.0f, 4.0f),
+                                fplbase::Vec2(5.0f, 6.0f)};
+  const size_t kStride = 3 * sizeof(float);
+  float interleaved[9] = {0};
+  fplbase::InterleaveStructs(flat, 3, kStride,
+                             reinterpret_cast<uint8_t *>(interleaved) + 4);
+  const float expected[9] = {0, 1, 2, 0, 3, 4, 0, 5, 6};
+  for (int i = 0; i < 9; ++i) EXPECT_EQ(expected[i], interleaved[i]);
+}
+
 TEST_F(UtilsTests, LoadAxis) {
   EXPECT_TRUE(fplbase::LoadAxis(fplbase::Axis_X) == mathfu::kAxisX3f);
   EXPECT_TRUE(fplbase::LoadAxis(fplbase::Axis_Y) == mathfu::kAxisY3f);
   EXPECT_TRUE(fplbase::LoadAxis(fplbase::Axis_Z) == mathfu::kAxisZ3f);
 }
 
+// Check the allocator hook sees every allocation, under its category.
+TEST_F(UtilsTests, SetAllocator) {
+  int live[fplbase::kAllocationCategoryCount] = {0};
+  fplbase::SetAllocator(
+      [&live](size_t size, fplbase::AllocationCategory category) {
+        ++live[category];
+        return malloc(size);
+      },
+      [&live](void *ptr, fplbase::AllocationCategory category) {
+        --live[category];
+        free(ptr);
+      });
+  EXPECT_TRUE(fplbase::HasCustomAllocator());
+
+  void *staging =
+      fplbase::AllocateMemory(64, fplbase::kAllocationTextureStaging);
+  void *aligned =
+      fplbase::AllocateAlignedMemory(24, fplbase::kAllocationMeshStaging);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(aligned) %
+                    fplbase::kAllocationAlignment);
+  EXPECT_EQ(1, live[fplbase::kAllocationTextureStaging]);
+  EXPECT_EQ(1, live[fplbase::kAllocationMeshStaging]);
+  {
+    std::vector<uint8_t, fplbase::CategoryAllocator<
+                             uint8_t, fplbase::kAllocationTransient>>
+        bytes(100);
+    EXPECT_EQ(1, live[fplbase::kAllocationTransient]);
+  }
+  EXPECT_EQ(0, live[fplbase::kAllocationTransient]);
+  fplbase::FreeMemory(staging, fplbase::kAllocationTextureStaging);
+  fplbase::FreeAlignedMemory(aligned, fplbase::kAllocationMeshStaging);
+  EXPECT_EQ(0, live[fplbase::kAllocationTextureStaging]);
+  EXPECT_EQ(0, live[fplbase::kAllocationMeshStaging]);
+
+  fplbase::SetAllocator(nullptr, nullptr);
+  EXPECT_FALSE(fplbase::HasCustomAllocator());
+}
+
 extern "C" int FPL_main(int argc, char *argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,93 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include <stdint.h>
+
+#include "fplbase/internal/vertex_quantization.h"
+#include "gtest/gtest.h"
+
+class VertexQuantizationTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+// Check every half that isn't a NaN survives a roundtrip through float.
+TEST_F(VertexQuantizationTests, HalfRoundtrip) {
+  for (uint32_t half = 0; half <= 0xffff; ++half) {
+    if ((half & 0x7c00) == 0x7c00 && (half & 0x3ff)) continue;
+    const uint16_t h = static_cast<uint16_t>(half);
+    EXPECT_EQ(h, fplbase::FloatToHalf(fplbase::HalfToFloat(h))) << half;
+  }
+}
+
+// Check rounding to the nearest half, with ties to even.
+TEST_F(VertexQuantizationTests, FloatToHalfRounding) {
+  EXPECT_EQ(0x3c00, fplbase::FloatToHalf(1.0f));
+  EXPECT_EQ(0xc000, fplbase::FloatToHalf(-2.0f));
+  EXPECT_EQ(0x7bff, fplbase::FloatToHalf(65504.0f));
+  EXPECT_EQ(0x7c00, fplbase::FloatToHalf(65536.0f));
+  EXPECT_EQ(0x0001, fplbase::FloatToHalf(5.96046448e-8f));
+  EXPECT_EQ(0x0000, fplbase::FloatToHalf(2.9e-8f));
+  // 1 + 2^-11 is halfway between 1 and the next half, and rounds to even.
+  EXPECT_EQ(0x3c00, fplbase::FloatToHalf(1.0f + 1.0f / 2048));
+  EXPECT_EQ(0x3c02, fplbase::FloatToHalf(1.0f + 3.0f / 2048));
+  EXPECT_EQ(0x3c01, fplbase::FloatToHalf(1.0f + 1.0f / 2048 + 1.0f / 8192));
+}
+
+// Check octahedral normals stay within a small angle of the original, over
+// both hemispheres and the folded edges.
+TEST_F(VertexQuantizationTests, OctahedralNormals) {
+  for (int i = 0; i <= 64; ++i) {
+    for (int j = 0; j < 64; ++j) {
+      const float theta = 3.14159265f * i / 64;
+      const float phi = 2 * 3.14159265f * j / 64;
+      const float normal[] = {sinf(theta) * cosf(phi), sinf(theta) * sinf(phi),
+                              cosf(theta)};
+      int16_t encoded[2];
+      fplbase::EncodeOctahedralNormal(normal, encoded);
+      float decoded[3];
+      fplbase::DecodeOctahedralNormal(encoded, decoded);
+      const float dot = normal[0] * decoded[0] + normal[1] * decoded[1] +
+                        normal[2] * decoded[2];
+      EXPECT_GT(dot, 0.99999f) << theta << ", " << phi;
+    }
+  }
+}
+
+// Check packed orientations keep the rotation and the handedness.
+TEST_F(VertexQuantizationTests, PackedOrientations) {
+  const float kHalfSqrt2 = 0.70710678f;
+  const float kOrientations[][4] = {
+      {0, 0, 0, 1},
+      {0, 0, 0, -1},
+      {kHalfSqrt2, 0, 0, kHalfSqrt2},
+      {0, kHalfSqrt2, 0, -kHalfSqrt2},
+      {0.5f, 0.5f, 0.5f, 0.5f},
+      {-0.5f, 0.5f, -0.5f, -0.5f},
+  };
+  for (size_t i = 0; i < sizeof(kOrientations) / sizeof(kOrientations[0]);
+       ++i) {
+    const float *q = kOrientations[i];
+    float unpacked[4];
+    fplbase::UnpackOrientation(fplbase::PackOrientation(q), unpacked);
+    for (int c = 0; c < 4; ++c) EXPECT_NEAR(q[c], unpacked[c], 0.01f) << i;
+  }
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
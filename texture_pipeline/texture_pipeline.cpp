@@ -0,0 +1,278 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "texture_pipeline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "fplbase/file_utilities.h"
+#include "fplbase/internal/lz4_block.h"
+#include "fplbase/internal/pixel_conversion.h"
+#include "stb_image.h"
+#include "stb_image_resize.h"
+#include "texture_headers.h"
+#include "webp/decode.h"
+
+namespace fplbase {
+
+// The GL enums written to the KTX header, so this doesn't need GL headers.
+static const uint32_t kGlUnsignedByte = 0x1401;
+static const uint32_t kGlUnsignedShort5551 = 0x8034;
+static const uint32_t kGlUnsignedShort565 = 0x8363;
+static const uint32_t kGlRgb = 0x1907;
+static const uint32_t kGlRgba = 0x1908;
+static const uint32_t kGlLuminance = 0x1909;
+static const uint32_t kGlRgb8 = 0x8051;
+static const uint32_t kGlRgba8 = 0x8058;
+static const uint32_t kGlRgb5A1 = 0x8057;
+static const uint32_t kGlRgb565 = 0x8D62;
+static const uint32_t kGlLuminance8 = 0x8040;
+
+// How each output format is stored.
+struct OutputFormat {
+  const char* name;
+  int channels;  // Of the pixels before packing into 16 bits, if at all.
+  uint32_t type;
+  uint32_t type_size;
+  uint32_t format;
+  uint32_t internal_format;
+  int bytes_per_pixel;
+};
+
+static const OutputFormat kOutputFormats[] = {
+    {"8888", 4, kGlUnsignedByte, 1, kGlRgba, kGlRgba8, 4},
+    {"888", 3, kGlUnsignedByte, 1, kGlRgb, kGlRgb8, 3},
+    {"5551", 4, kGlUnsignedShort5551, 2, kGlRgba, kGlRgb5A1, 2},
+    {"565", 3, kGlUnsignedShort565, 2, kGlRgb, kGlRgb565, 2},
+    {"luminance", 1, kGlUnsignedByte, 1, kGlLuminance, kGlLuminance8, 1},
+};
+
+static const OutputFormat* FindOutputFormat(const std::string& name) {
+  for (size_t i = 0; i < sizeof(kOutputFormats) / sizeof(kOutputFormats[0]);
+       ++i) {
+    if (name == kOutputFormats[i].name) return &kOutputFormats[i];
+  }
+  return nullptr;
+}
+
+// An uncompressed image, with 1, 3 or 4 channels.
+struct Image {
+  Image() : width(0), height(0), channels(0) {}
+  int width;
+  int height;
+  int channels;
+  std::vector<uint8_t> pixels;
+};
+
+static bool DecodeImage(const std::string& file, Image* image) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(file.data());
+  WebPBitstreamFeatures features;
+  if (WebPGetFeatures(data, file.size(), &features) == VP8_STATUS_OK) {
+    image->channels = features.has_alpha ? 4 : 3;
+    uint8_t* pixels =
+        features.has_alpha
+            ? WebPDecodeRGBA(data, file.size(), &image->width, &image->height)
+            : WebPDecodeRGB(data, file.size(), &image->width, &image->height);
+    if (!pixels) return false;
+    image->pixels.assign(pixels, pixels + static_cast<size_t>(image->width) *
+                                              image->height * image->channels);
+    free(pixels);
+    return true;
+  }
+  int channels = 0;
+  uint8_t* pixels =
+      stbi_load_from_memory(data, static_cast<int>(file.size()), &image->width,
+                            &image->height, &channels, 0);
+  if (!pixels) return false;
+  // Treat luminance + alpha as RGBA, since there's no format to keep it in.
+  const int desired = channels == 2 ? 4 : channels;
+  if (desired != channels) {
+    stbi_image_free(pixels);
+    pixels = stbi_load_from_memory(data, static_cast<int>(file.size()),
+                                   &image->width, &image->height, &channels,
+                                   desired);
+    if (!pixels) return false;
+  }
+  image->channels = desired;
+  image->pixels.assign(pixels, pixels + static_cast<size_t>(image->width) *
+                                            image->height * desired);
+  stbi_image_free(pixels);
+  return true;
+}
+
+// Adds or drops channels, e.g. an opaque alpha for 5551, or the alpha for
+// 565. Luminance is replicated into RGB.
+static void ConvertChannels(Image* image, int channels) {
+  if (image->channels == channels) return;
+  const size_t num_pixels = static_cast<size_t>(image->width) * image->height;
+  std::vector<uint8_t> pixels(num_pixels * channels);
+  for (size_t i = 0; i < num_pixels; ++i) {
+    const uint8_t* src = &image->pixels[i * image->channels];
+    uint8_t* dest = &pixels[i * channels];
+    for (int c = 0; c < channels; ++c) {
+      if (c == 3) {
+        dest[c] = image->channels == 4 ? src[3] : 255;
+      } else {
+        dest[c] = image->channels == 1 ? src[0] : src[c];
+      }
+    }
+  }
+  image->pixels.swap(pixels);
+  image->channels = channels;
+}
+
+// Packs `image` into `format`, with rows padded to 4 bytes as KTX requires.
+static std::string PackImage(const Image& image, const OutputFormat& format) {
+  const size_t row_size =
+      static_cast<size_t>(image.width) * format.bytes_per_pixel;
+  const size_t row_pitch = (row_size + 3) & ~static_cast<size_t>(3);
+  std::string packed(row_pitch * image.height, '\0');
+  std::vector<uint16_t> row16(image.width);
+  for (int y = 0; y < image.height; ++y) {
+    const uint8_t* src = &image.pixels[static_cast<size_t>(y) * image.width *
+                                       image.channels];
+    char* dest = &packed[y * row_pitch];
+    if (format.type == kGlUnsignedShort5551) {
+      Convert8888To5551(src, row16.data(), image.width);
+      memcpy(dest, row16.data(), row_size);
+    } else if (format.type == kGlUnsignedShort565) {
+      Convert888To565(src, row16.data(), image.width);
+      memcpy(dest, row16.data(), row_size);
+    } else {
+      memcpy(dest, src, row_size);
+    }
+  }
+  return packed;
+}
+
+static void AppendUint32(uint32_t value, std::string* ktx) {
+  ktx->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static bool IsKTXZFile(const std::string& filename) {
+  static const char kExtension[] = ".ktxz";
+  const size_t length = sizeof(kExtension) - 1;
+  return filename.size() >= length &&
+         filename.compare(filename.size() - length, length, kExtension) == 0;
+}
+
+// Wraps a ktx file in the KTXZ container Texture::UnpackKTXZ() reads.
+static std::string CompressKTX(const std::string& ktx) {
+  KTXZHeader header;
+  memcpy(header.magic, "KTXZ", sizeof(header.magic));
+  header.ktx_size = static_cast<uint32_t>(ktx.size());
+  header.reserved = 0;
+  std::vector<uint8_t> block(Lz4BlockBound(ktx.size()));
+  header.compressed_size = static_cast<uint32_t>(
+      CompressLz4Block(reinterpret_cast<const uint8_t*>(ktx.data()),
+                       ktx.size(), block.data()));
+  std::string ktxz(reinterpret_cast<const char*>(&header), sizeof(header));
+  ktxz.append(reinterpret_cast<const char*>(block.data()),
+              header.compressed_size);
+  return ktxz;
+}
+
+int RunTexturePipeline(const TexturePipelineArgs& args) {
+  std::string file;
+  if (!LoadFileRaw(args.input_file.c_str(), &file)) {
+    printf("Unable to load file: %s\n", args.input_file.c_str());
+    return 1;
+  }
+  Image image;
+  if (!DecodeImage(file, &image)) {
+    printf("Unable to decode image: %s\n", args.input_file.c_str());
+    return 1;
+  }
+
+  std::string format_name = args.format;
+  if (format_name.empty() || format_name == "auto") {
+    format_name = image.channels == 4 ? "5551" : "565";
+  }
+  const OutputFormat* format = FindOutputFormat(format_name);
+  if (!format) {
+    printf("Unknown format: %s\n", format_name.c_str());
+    return 1;
+  }
+  if (format->channels == 1 && image.channels != 1) {
+    printf("Luminance output needs a single channel image: %s\n",
+           args.input_file.c_str());
+    return 1;
+  }
+  ConvertChannels(&image, format->channels);
+
+  // Premultiply before filtering, so the mips blend correctly.
+  if (args.premultiply_alpha && image.channels == 4) {
+    MultiplyRgbByAlpha(image.pixels.data(),
+                       static_cast<size_t>(image.width) * image.height);
+  }
+
+  // The same chain CreateTexture() uploads: halving down to 1x1.
+  uint32_t num_mips = 1;
+  if (args.mips) {
+    while ((std::max(image.width, image.height) >> num_mips) > 0) ++num_mips;
+  }
+
+  KTXHeader header;
+  memcpy(header.id, "\xABKTX 11\xBB\r\n\x1A\n", sizeof(header.id));
+  header.endian = 0x04030201;
+  header.type = format->type;
+  header.type_size = format->type_size;
+  header.format = format->format;
+  header.internal_format = format->internal_format;
+  header.base_internal_format = format->format;
+  header.width = image.width;
+  header.height = image.height;
+  header.depth = 0;
+  header.array_elements = 0;
+  header.faces = 1;
+  header.mip_levels = num_mips;
+  header.keyvalue_data = 0;
+  std::string ktx(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  for (uint32_t mip = 0; mip < num_mips; ++mip) {
+    Image level;
+    if (mip == 0) {
+      level = image;
+    } else {
+      // Resample each level from the full image, for the best quality.
+      level.width = std::max(image.width >> mip, 1);
+      level.height = std::max(image.height >> mip, 1);
+      level.channels = image.channels;
+      level.pixels.resize(static_cast<size_t>(level.width) * level.height *
+                          level.channels);
+      stbir_resize_uint8(image.pixels.data(), image.width, image.height, 0,
+                         level.pixels.data(), level.width, level.height, 0,
+                         image.channels);
+    }
+    const std::string packed = PackImage(level, *format);
+    AppendUint32(static_cast<uint32_t>(packed.size()), &ktx);
+    ktx.append(packed);
+  }
+
+  if (IsKTXZFile(args.output_file)) ktx = CompressKTX(ktx);
+
+  if (!SaveFile(args.output_file.c_str(), ktx)) {
+    printf("Could not open %s for writing.\n", args.output_file.c_str());
+    return 1;
+  }
+
+  // Success.
+  return 0;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,36 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_TEXTURE_PIPELINE_H_
+#define FPLBASE_TEXTURE_PIPELINE_H_
+
+#include <string>
+
+namespace fplbase {
+
+struct TexturePipelineArgs {
+  TexturePipelineArgs() : premultiply_alpha(false), mips(true) {}
+
+  std::string input_file;   /// The source PNG, JPEG, TGA or WebP image.
+  std::string output_file;  /// The output ktx or ktxz file.
+  std::string format;       /// auto, 8888, 888, 5551, 565 or luminance.
+  bool premultiply_alpha;   /// Multiply RGB by alpha, before making mips.
+  bool mips;                /// Include a full mip chain.
+};
+
+int RunTexturePipeline(const TexturePipelineArgs& args);
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_TEXTURE_PIPELINE_H_
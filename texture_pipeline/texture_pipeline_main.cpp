@@ -0,0 +1,93 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+
+#include "texture_pipeline.h"
+
+static bool ParseTexturePipelineArgs(int argc, char** argv,
+                                     fplbase::TexturePipelineArgs* args) {
+  bool valid_args = true;
+
+  // The last two parameters are the input and output files.
+  if (argc > 2) {
+    args->input_file = std::string(argv[argc - 2]);
+    args->output_file = std::string(argv[argc - 1]);
+  } else {
+    valid_args = false;
+  }
+
+  // Parse switches.
+  for (int i = 1; i < argc - 2; ++i) {
+    const std::string arg = argv[i];
+
+    // -f switch
+    if (arg == "-f" || arg == "--format") {
+      if (i < argc - 3) {
+        ++i;
+        args->format = std::string(argv[i]);
+      } else {
+        valid_args = false;
+      }
+
+      // -p switch
+    } else if (arg == "-p" || arg == "--premultiply-alpha") {
+      args->premultiply_alpha = true;
+
+      // --no-mips switch
+    } else if (arg == "--no-mips") {
+      args->mips = false;
+
+      // all other (non-empty) arguments
+    } else if (arg != "") {
+      printf("Unknown parameter: %s\n", arg.c_str());
+      valid_args = false;
+    }
+
+    if (!valid_args) break;
+  }
+
+  // Print usage.
+  if (!valid_args) {
+    printf(
+        "Usage: texture_pipeline [-f FORMAT] [-p] [--no-mips]\n"
+        "                        INPUT_FILE OUTPUT_FILE\n"
+        "\n"
+        "Pipeline to convert PNG, JPEG, TGA and WebP images into ktx files\n"
+        "that are uploaded as-is, with a precomputed mip chain. Load them\n"
+        "with kTextureFlagsUseMipMaps to use the mips. An OUTPUT_FILE\n"
+        "ending in .ktxz is compressed with LZ4, for smaller downloads that\n"
+        "still decompress quickly at load time.\n"
+        "\n"
+        "Options:\n"
+        "  -f, --format FORMAT       auto, 8888, 888, 5551, 565 or luminance.\n"
+        "                            auto (the default) picks 5551 for images\n"
+        "                            with alpha and 565 otherwise, like\n"
+        "                            kFormatAuto does at runtime.\n"
+        "  -p, --premultiply-alpha   Multiply RGB by alpha, before making\n"
+        "                            the mips.\n"
+        "      --no-mips             Only store the full size image.\n");
+  }
+
+  return valid_args;
+}
+
+int main(int argc, char** argv) {
+  // Parse the command line arguments.
+  fplbase::TexturePipelineArgs args;
+  if (!ParseTexturePipelineArgs(argc, argv, &args)) {
+    return 1;
+  }
+  return fplbase::RunTexturePipeline(args);
+}